@@ -30,6 +30,7 @@
 #include <sys/vdev_raidz.h>
 #include <sys/vdev_raidz_impl.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #include "raidz_test.h"
 
@@ -39,83 +40,193 @@
 #define	MIN_CS_SHIFT		BENCH_ASHIFT
 #define	MAX_CS_SHIFT		SPA_MAXBLOCKSHIFT
 
-static zio_t zio_bench;
-static raidz_map_t *rm_bench;
+static const int rec_tgt[RAIDZ_REC_NUM][3] = {
+	{1, 2, 3},	/* rec_p:   bad QR & D[0]	*/
+	{0, 2, 3},	/* rec_q:   bad PR & D[0]	*/
+	{0, 1, 3},	/* rec_r:   bad PQ & D[0]	*/
+	{2, 3, 4},	/* rec_pq:  bad R  & D[0][1]	*/
+	{1, 3, 4},	/* rec_pr:  bad Q  & D[0][1]	*/
+	{0, 3, 4},	/* rec_qr:  bad P  & D[0][1]	*/
+	{3, 4, 5}	/* rec_pqr: bad    & D[0][1][2] */
+};
+
+/*
+ * Each benchmark thread has its own zio and raidz map, so that with -n
+ * the threads only share memory bandwidth and the math implementation.
+ */
+typedef struct bench_thread {
+	pthread_t	bt_tid;
+	zio_t		bt_zio;
+	raidz_map_t	*bt_rm;
+	int		bt_fn;		/* reconstruction method, or -1 */
+	int		bt_nbad;
+	uint64_t	bt_iter_cnt;
+} bench_thread_t;
+
+static bench_thread_t *bench_threads;
 static size_t max_data_size = SPA_MAXBLOCKSIZE;
 
 static void
 bench_init_raidz_map(void)
 {
-	zio_bench.io_offset = 0;
-	zio_bench.io_size = max_data_size;
+	bench_threads = umem_zalloc(rto_opts.rto_bench_threads *
+	    sizeof (bench_thread_t), UMEM_NOFAIL);
+
+	for (size_t t = 0; t < rto_opts.rto_bench_threads; t++) {
+		zio_t *zio = &bench_threads[t].bt_zio;
 
-	/*
-	 * To permit larger column sizes these have to be done
-	 * allocated using aligned alloc instead of zio_abd_buf_alloc
-	 */
-	zio_bench.io_abd = raidz_alloc(max_data_size);
+		zio->io_offset = 0;
+		zio->io_size = max_data_size;
 
-	init_zio_abd(&zio_bench);
+		/*
+		 * To permit larger column sizes these have to be done
+		 * allocated using aligned alloc instead of zio_abd_buf_alloc
+		 */
+		zio->io_abd = raidz_alloc(max_data_size);
+
+		init_zio_abd(zio);
+	}
 }
 
 static void
 bench_fini_raidz_maps(void)
 {
 	/* tear down golden zio */
-	raidz_free(zio_bench.io_abd, max_data_size);
-	memset(&zio_bench, 0, sizeof (zio_t));
+	for (size_t t = 0; t < rto_opts.rto_bench_threads; t++)
+		raidz_free(bench_threads[t].bt_zio.io_abd, max_data_size);
+	umem_free(bench_threads, rto_opts.rto_bench_threads *
+	    sizeof (bench_thread_t));
+	bench_threads = NULL;
+}
+
+static void *
+bench_thread(void *arg)
+{
+	bench_thread_t *bt = arg;
+
+	for (uint64_t iter = 0; iter < bt->bt_iter_cnt; iter++) {
+		if (bt->bt_fn < 0) {
+			vdev_raidz_generate_parity(bt->bt_rm);
+		} else {
+			vdev_raidz_reconstruct(bt->bt_rm, rec_tgt[bt->bt_fn],
+			    bt->bt_nbad);
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * Run one configuration on all benchmark threads, splitting the iterations
+ * between them, and return the per data disk bandwidth in MiB/s.  The maps
+ * are allocated before and freed after the timed section.
+ */
+static double
+run_bench_threads(int fn, int ashift, int ncols, int nparity,
+    uint64_t size, uint64_t memory, uint64_t *iter_cnt)
+{
+	size_t nthreads = rto_opts.rto_bench_threads;
+	uint64_t disksize;
+	hrtime_t start;
+	double elapsed, d_bw;
+	size_t t;
+
+	*iter_cnt = MAX(memory / size / nthreads, 1);
+
+	for (t = 0; t < nthreads; t++) {
+		bench_thread_t *bt = &bench_threads[t];
+
+		bt->bt_zio.io_size = size;
+		if (rto_opts.rto_expand) {
+			bt->bt_rm = vdev_raidz_map_alloc_expanded(&bt->bt_zio,
+			    ashift, ncols + 1, ncols, nparity,
+			    rto_opts.rto_expand_offset, 0, B_FALSE);
+		} else {
+			bt->bt_rm = vdev_raidz_map_alloc(&bt->bt_zio,
+			    ashift, ncols, nparity);
+		}
+		bt->bt_fn = fn;
+		bt->bt_iter_cnt = *iter_cnt;
+
+		/* calculate how many bad columns there are */
+		bt->bt_nbad = MIN(3, raidz_ncols(bt->bt_rm) -
+		    raidz_parity(bt->bt_rm));
+	}
+
+	start = gethrtime();
+	for (t = 0; t < nthreads; t++) {
+		VERIFY0(pthread_create(&bench_threads[t].bt_tid, NULL,
+		    bench_thread, &bench_threads[t]));
+	}
+	for (t = 0; t < nthreads; t++)
+		VERIFY0(pthread_join(bench_threads[t].bt_tid, NULL));
+	elapsed = NSEC2SEC((double)(gethrtime() - start));
+
+	for (t = 0; t < nthreads; t++)
+		vdev_raidz_map_free(bench_threads[t].bt_rm);
+
+	*iter_cnt *= nthreads;
+	disksize = size / rto_opts.rto_dcols;
+	d_bw = (double)*iter_cnt * (double)disksize;
+	d_bw /= (1024.0 * 1024.0 * elapsed);
+
+	return (d_bw);
+}
+
+static void
+bench_report_header(void)
+{
+	if (rto_opts.rto_bench_json)
+		return;
+
+	LOG(D_ALL, "impl, math, dcols, iosize, disk_bw, total_bw, iter, "
+	    "threads\n");
+}
+
+static void
+bench_report(const char *impl, const char *math, int ncols, uint64_t size,
+    double d_bw, uint64_t iter_cnt)
+{
+	if (rto_opts.rto_bench_json) {
+		(void) fprintf(stdout, "{\"impl\": \"%s\", \"math\": \"%s\", "
+		    "\"dcols\": %zu, \"iosize\": %llu, \"disk_bw\": %lf, "
+		    "\"total_bw\": %lf, \"iter\": %llu, \"threads\": %zu, "
+		    "\"expanded\": %s}\n", impl, math, rto_opts.rto_dcols,
+		    (u_longlong_t)size, d_bw, d_bw * (double)ncols,
+		    (u_longlong_t)iter_cnt, rto_opts.rto_bench_threads,
+		    rto_opts.rto_expand ? "true" : "false");
+		return;
+	}
+
+	LOG(D_ALL, "%10s, %8s, %zu, %10llu, %lf, %lf, %u, %zu\n",
+	    impl,
+	    math,
+	    rto_opts.rto_dcols,
+	    (u_longlong_t)size,
+	    d_bw,
+	    d_bw * (double)ncols,
+	    (unsigned)iter_cnt,
+	    rto_opts.rto_bench_threads);
 }
 
 static inline void
 run_gen_bench_impl(const char *impl)
 {
 	int fn, ncols;
-	uint64_t ds, iter_cnt, iter, disksize;
-	hrtime_t start;
-	double elapsed, d_bw;
+	uint64_t ds, iter_cnt;
+	double d_bw;
 
 	/* Benchmark generate functions */
 	for (fn = 0; fn < RAIDZ_GEN_NUM; fn++) {
 
 		for (ds = MIN_CS_SHIFT; ds <= MAX_CS_SHIFT; ds++) {
-			/* create suitable raidz_map */
 			ncols = rto_opts.rto_dcols + fn + 1;
-			zio_bench.io_size = 1ULL << ds;
-
-			if (rto_opts.rto_expand) {
-				rm_bench = vdev_raidz_map_alloc_expanded(
-				    &zio_bench,
-				    rto_opts.rto_ashift, ncols+1, ncols,
-				    fn+1, rto_opts.rto_expand_offset,
-				    0, B_FALSE);
-			} else {
-				rm_bench = vdev_raidz_map_alloc(&zio_bench,
-				    BENCH_ASHIFT, ncols, fn+1);
-			}
-
-			/* estimate iteration count */
-			iter_cnt = GEN_BENCH_MEMORY;
-			iter_cnt /= zio_bench.io_size;
-
-			start = gethrtime();
-			for (iter = 0; iter < iter_cnt; iter++)
-				vdev_raidz_generate_parity(rm_bench);
-			elapsed = NSEC2SEC((double)(gethrtime() - start));
-
-			disksize = (1ULL << ds) / rto_opts.rto_dcols;
-			d_bw = (double)iter_cnt * (double)disksize;
-			d_bw /= (1024.0 * 1024.0 * elapsed);
-
-			LOG(D_ALL, "%10s, %8s, %zu, %10llu, %lf, %lf, %u\n",
-			    impl,
-			    raidz_gen_name[fn],
-			    rto_opts.rto_dcols,
-			    (1ULL<<ds),
-			    d_bw,
-			    d_bw * (double)(ncols),
-			    (unsigned)iter_cnt);
-
-			vdev_raidz_map_free(rm_bench);
+			d_bw = run_bench_threads(-1, rto_opts.rto_expand ?
+			    rto_opts.rto_ashift : BENCH_ASHIFT, ncols, fn + 1,
+			    1ULL << ds, GEN_BENCH_MEMORY, &iter_cnt);
+
+			bench_report(impl, raidz_gen_name[fn], ncols,
+			    1ULL << ds, d_bw, iter_cnt);
 		}
 	}
 }
@@ -126,7 +237,7 @@ run_gen_bench(void)
 	char **impl_name;
 
 	LOG(D_INFO, DBLSEP "\nBenchmarking parity generation...\n\n");
-	LOG(D_ALL, "impl, math, dcols, iosize, disk_bw, total_bw, iter\n");
+	bench_report_header();
 
 	for (impl_name = (char **)raidz_impl_names; *impl_name != NULL;
 	    impl_name++) {
@@ -141,73 +252,28 @@ run_gen_bench(void)
 static void
 run_rec_bench_impl(const char *impl)
 {
-	int fn, ncols, nbad;
-	uint64_t ds, iter_cnt, iter, disksize;
-	hrtime_t start;
-	double elapsed, d_bw;
-	static const int tgt[7][3] = {
-		{1, 2, 3},	/* rec_p:   bad QR & D[0]	*/
-		{0, 2, 3},	/* rec_q:   bad PR & D[0]	*/
-		{0, 1, 3},	/* rec_r:   bad PQ & D[0]	*/
-		{2, 3, 4},	/* rec_pq:  bad R  & D[0][1]	*/
-		{1, 3, 4},	/* rec_pr:  bad Q  & D[0][1]	*/
-		{0, 3, 4},	/* rec_qr:  bad P  & D[0][1]	*/
-		{3, 4, 5}	/* rec_pqr: bad    & D[0][1][2] */
-	};
+	int fn, ncols;
+	uint64_t ds, iter_cnt;
+	double d_bw;
 
 	for (fn = 0; fn < RAIDZ_REC_NUM; fn++) {
 		for (ds = MIN_CS_SHIFT; ds <= MAX_CS_SHIFT; ds++) {
-
-			/* create suitable raidz_map */
 			ncols = rto_opts.rto_dcols + PARITY_PQR;
-			zio_bench.io_size = 1ULL << ds;
 
 			/*
 			 * raidz block is too short to test
 			 * the requested method
 			 */
-			if (zio_bench.io_size / rto_opts.rto_dcols <
+			if ((1ULL << ds) / rto_opts.rto_dcols <
 			    (1ULL << BENCH_ASHIFT))
 				continue;
 
-			if (rto_opts.rto_expand) {
-				rm_bench = vdev_raidz_map_alloc_expanded(
-				    &zio_bench,
-				    BENCH_ASHIFT, ncols+1, ncols,
-				    PARITY_PQR,
-				    rto_opts.rto_expand_offset, 0, B_FALSE);
-			} else {
-				rm_bench = vdev_raidz_map_alloc(&zio_bench,
-				    BENCH_ASHIFT, ncols, PARITY_PQR);
-			}
-
-			/* estimate iteration count */
-			iter_cnt = (REC_BENCH_MEMORY);
-			iter_cnt /= zio_bench.io_size;
-
-			/* calculate how many bad columns there are */
-			nbad = MIN(3, raidz_ncols(rm_bench) -
-			    raidz_parity(rm_bench));
-
-			start = gethrtime();
-			for (iter = 0; iter < iter_cnt; iter++)
-				vdev_raidz_reconstruct(rm_bench, tgt[fn], nbad);
-			elapsed = NSEC2SEC((double)(gethrtime() - start));
-
-			disksize = (1ULL << ds) / rto_opts.rto_dcols;
-			d_bw = (double)iter_cnt * (double)(disksize);
-			d_bw /= (1024.0 * 1024.0 * elapsed);
-
-			LOG(D_ALL, "%10s, %8s, %zu, %10llu, %lf, %lf, %u\n",
-			    impl,
-			    raidz_rec_name[fn],
-			    rto_opts.rto_dcols,
-			    (1ULL<<ds),
-			    d_bw,
-			    d_bw * (double)ncols,
-			    (unsigned)iter_cnt);
-
-			vdev_raidz_map_free(rm_bench);
+			d_bw = run_bench_threads(fn, BENCH_ASHIFT, ncols,
+			    PARITY_PQR, 1ULL << ds, REC_BENCH_MEMORY,
+			    &iter_cnt);
+
+			bench_report(impl, raidz_rec_name[fn], ncols,
+			    1ULL << ds, d_bw, iter_cnt);
 		}
 	}
 }
@@ -218,7 +284,7 @@ run_rec_bench(void)
 	char **impl_name;
 
 	LOG(D_INFO, DBLSEP "\nBenchmarking data reconstruction...\n\n");
-	LOG(D_ALL, "impl, math, dcols, iosize, disk_bw, total_bw, iter\n");
+	bench_report_header();
 
 	for (impl_name = (char **)raidz_impl_names; *impl_name != NULL;
 	    impl_name++) {
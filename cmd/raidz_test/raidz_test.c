@@ -118,6 +118,8 @@ static void usage(boolean_t requested)
 	    "\t[-S parameter sweep (default: %s)]\n"
 	    "\t[-t timeout for parameter sweep test]\n"
 	    "\t[-B benchmark all raidz implementations]\n"
+	    "\t[-n number of benchmark threads (default: %zu)]\n"
+	    "\t[-j print benchmark results as JSON]\n"
 	    "\t[-e use expanded raidz map (default: %s)]\n"
 	    "\t[-r expanded raidz map reflow offset (default: %llx)]\n"
 	    "\t[-v increase verbosity (default: %d)]\n"
@@ -130,6 +132,7 @@ static void usage(boolean_t requested)
 	    o->rto_dcols,				/* -d */
 	    ilog2(o->rto_dsize),			/* -s */
 	    rto_opts.rto_sweep ? "yes" : "no",		/* -S */
+	    o->rto_bench_threads,			/* -n */
 	    rto_opts.rto_expand ? "yes" : "no",		/* -e */
 	    (u_longlong_t)o->rto_expand_offset,		/* -r */
 	    o->rto_v);					/* -v */
@@ -145,7 +148,7 @@ static void process_options(int argc, char **argv)
 
 	memcpy(o, &rto_opts_defaults, sizeof (*o));
 
-	while ((opt = getopt(argc, argv, "TDBSvha:er:o:d:s:t:")) != -1) {
+	while ((opt = getopt(argc, argv, "TDBSjvha:er:o:d:n:s:t:")) != -1) {
 		switch (opt) {
 		case 'a':
 			value = strtoull(optarg, NULL, 0);
@@ -183,6 +186,13 @@ static void process_options(int argc, char **argv)
 		case 'B':
 			o->rto_benchmark = 1;
 			break;
+		case 'n':
+			value = strtoull(optarg, NULL, 0);
+			o->rto_bench_threads = MIN(1024, MAX(1, value));
+			break;
+		case 'j':
+			o->rto_bench_json = 1;
+			break;
 		case 'D':
 			o->rto_gdb = 1;
 			break;
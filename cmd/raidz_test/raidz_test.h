@@ -57,6 +57,8 @@ typedef struct raidz_test_opts {
 	size_t rto_sweep;
 	size_t rto_sweep_timeout;
 	size_t rto_benchmark;
+	size_t rto_bench_threads;
+	size_t rto_bench_json;
 	size_t rto_expand;
 	uint64_t rto_expand_offset;
 	size_t rto_sanity;
@@ -77,6 +79,8 @@ static const raidz_test_opts_t rto_opts_defaults = {
 	.rto_v = D_ALL,
 	.rto_sweep = 0,
 	.rto_benchmark = 0,
+	.rto_bench_threads = 1,
+	.rto_bench_json = 0,
 	.rto_expand = 0,
 	.rto_expand_offset = -1ULL,
 	.rto_sanity = 0,
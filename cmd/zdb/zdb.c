@@ -88,6 +88,7 @@
 #include <sys/backtrace.h>
 
 #include <libnvpair.h>
+#include <cityhash.h>
 #include <libzutil.h>
 #include <libzfs_core.h>
 
@@ -120,6 +121,10 @@ static int flagbits[256];
 
 
 static uint64_t max_inflight_bytes = 256 * 1024 * 1024; /* 256MB */
+static boolean_t max_inflight_set = B_FALSE;
+static int zdb_threads = 0;
+static uint64_t dedup_sample_count = 0;
+static uint_t simulate_sample_shift = 0;
 static int leaked_objects = 0;
 static range_tree_t *mos_refd_objs;
 static spa_t *spa;
@@ -692,8 +697,9 @@ usage(void)
 	(void) fprintf(stderr,
 	    "Usage:\t%s [-AbcdDFGhikLMPsvXy] [-e [-V] [-p <path> ...]] "
 	    "[-I <inflight I/Os>]\n"
-	    "\t\t[-o <var>=<value>]... [-t <txg>] [-U <cache>] [-x <dumpdir>]\n"
-	    "\t\t[-K <key>]\n"
+	    "\t\t[-j <threads>] [-J <samples>] [-o <var>=<value>]... "
+	    "[-t <txg>]\n"
+	    "\t\t[-U <cache>] [-x <dumpdir>] [-K <key>]\n"
 	    "\t\t[<poolname>[/<dataset | objset id>] [<object | range> ...]]\n"
 	    "\t%s [-AdiPv] [-e [-V] [-p <path> ...]] [-U <cache>] [-K <key>]\n"
 	    "\t\t[<poolname>[/<dataset | objset id>] [<object | range> ...]\n"
@@ -793,6 +799,12 @@ usage(void)
 	(void) fprintf(stderr, "        -I --inflight=INTEGER        "
 	    "specify the maximum number of checksumming I/Os "
 	    "[default is 200]\n");
+	(void) fprintf(stderr, "        -j --threads=INTEGER         "
+	    "number of block traversal threads [default is the number "
+	    "of CPUs, up to 8]\n");
+	(void) fprintf(stderr, "        -J --dedup-sample=INTEGER    "
+	    "estimate DDT and BRT histograms from this many entries, "
+	    "as JSON\n");
 	(void) fprintf(stderr, "        -K --key=KEY                 "
 	    "decryption key for encrypted dataset\n");
 	(void) fprintf(stderr, "        -o --option=\"OPTION=INTEGER\" "
@@ -801,6 +813,8 @@ usage(void)
 	    "use one or more with -e to specify path to vdev dir\n");
 	(void) fprintf(stderr, "        -P --parseable               "
 	    "print numbers in parseable form\n");
+	(void) fprintf(stderr, "        -Q --simulate-sample=INTEGER "
+	    "with -S, count only 1 in 2^INTEGER unique blocks\n");
 	(void) fprintf(stderr, "        -q --skip-label              "
 	    "don't print label contents\n");
 	(void) fprintf(stderr, "        -t --txg=INTEGER             "
@@ -1987,6 +2001,25 @@ dump_ddt(ddt_t *ddt, ddt_type_t type, ddt_class_t class)
 	(void) printf("\n");
 }
 
+static void
+dump_ddt_log(ddt_t *ddt)
+{
+	if (!ddt_log_exists(ddt))
+		return;
+
+	ddt_log_t *addl = ddt->ddt_log_active;
+	ddt_log_t *fddl = ddt->ddt_log_flushing;
+
+	(void) printf("DDT-log-%s: %llu active entries (%llu bytes), "
+	    "%llu flushing entries (%llu bytes), %llu bytes in core\n",
+	    zio_checksum_table[ddt->ddt_checksum].ci_name,
+	    (u_longlong_t)avl_numnodes(&addl->ddl_tree),
+	    (u_longlong_t)addl->ddl_length,
+	    (u_longlong_t)avl_numnodes(&fddl->ddl_tree),
+	    (u_longlong_t)fddl->ddl_length,
+	    (u_longlong_t)ddt_log_memused(ddt));
+}
+
 static void
 dump_all_ddts(spa_t *spa)
 {
@@ -2003,6 +2036,7 @@ dump_all_ddts(spa_t *spa)
 				dump_ddt(ddt, type, class);
 			}
 		}
+		dump_ddt_log(ddt);
 	}
 
 	ddt_get_dedup_stats(spa, &dds_total);
@@ -2023,6 +2057,43 @@ dump_all_ddts(spa_t *spa)
 	dump_dedup_ratio(&dds_total);
 }
 
+/*
+ * Print the DDT and BRT histograms estimated from a random sample of their
+ * entries as JSON, laid out as by ZFS_IOC_DEDUP_SAMPLE.
+ */
+static void
+dump_dedup_sample(spa_t *spa)
+{
+	nvlist_t *nvl = fnvlist_alloc();
+	nvlist_t *tnvl;
+	int error;
+
+	tnvl = fnvlist_alloc();
+	error = ddt_get_sample_stats(spa, dedup_sample_count, tnvl);
+	if (error == 0)
+		fnvlist_add_nvlist(nvl, DEDUP_SAMPLE_DDT, tnvl);
+	fnvlist_free(tnvl);
+
+	if (error == 0 &&
+	    spa_feature_is_active(spa, SPA_FEATURE_BLOCK_CLONING)) {
+		tnvl = fnvlist_alloc();
+		error = brt_get_sample_stats(spa, dedup_sample_count, tnvl);
+		if (error == 0)
+			fnvlist_add_nvlist(nvl, DEDUP_SAMPLE_BRT, tnvl);
+		fnvlist_free(tnvl);
+	}
+
+	if (error != 0) {
+		(void) printf("failed to sample dedup tables: %s\n",
+		    strerror(error));
+	} else {
+		(void) nvlist_print_json(stdout, nvl);
+		(void) printf("\n");
+	}
+
+	fnvlist_free(nvl);
+}
+
 static void
 dump_brt(spa_t *spa)
 {
@@ -5424,6 +5495,14 @@ typedef struct zdb_cb {
 	uint32_t	**zcb_vd_obsolete_counts;
 	avl_tree_t	zcb_brt;
 	boolean_t	zcb_brt_is_active;
+	kmutex_t	zcb_brt_lock;
+	/*
+	 * Each block traversal thread accumulates into its own zdb_cb_t,
+	 * all of which point at the one that the totals are merged into.
+	 * The in-memory BRT and the progress counters live only there.
+	 */
+	struct zdb_cb	*zcb_shared;
+	uint64_t	zcb_traversed_asize;
 } zdb_cb_t;
 
 /* test if two DVA offsets from same vdev are within the same metaslab */
@@ -5719,6 +5798,7 @@ zdb_count_block(zdb_cb_t *zcb, zilog_t *zilog, const blkptr_t *bp,
 	zcb->zcb_asize_total += BP_GET_ASIZE(bp);
 
 	if (zcb->zcb_brt_is_active && brt_maybe_exists(zcb->zcb_spa, bp)) {
+		zdb_cb_t *szcb = zcb->zcb_shared;
 		/*
 		 * Cloned blocks are special. We need to count them, so we can
 		 * later uncount them when reporting leaked space, and we must
@@ -5734,16 +5814,18 @@ zdb_count_block(zdb_cb_t *zcb, zilog_t *zilog, const blkptr_t *bp,
 		avl_index_t where;
 
 		zbre_search.zbre_dva = bp->blk_dva[0];
-		zbre = avl_find(&zcb->zcb_brt, &zbre_search, &where);
+		mutex_enter(&szcb->zcb_brt_lock);
+		zbre = avl_find(&szcb->zcb_brt, &zbre_search, &where);
 		if (zbre != NULL) {
 			zcb->zcb_clone_asize += BP_GET_ASIZE(bp);
 			zcb->zcb_clone_blocks++;
 
 			zbre->zbre_refcount--;
 			if (zbre->zbre_refcount == 0) {
-				avl_remove(&zcb->zcb_brt, zbre);
+				avl_remove(&szcb->zcb_brt, zbre);
 				umem_free(zbre, sizeof (zdb_brt_entry_t));
 			}
+			mutex_exit(&szcb->zcb_brt_lock);
 			return;
 		}
 
@@ -5753,8 +5835,9 @@ zdb_count_block(zdb_cb_t *zcb, zilog_t *zilog, const blkptr_t *bp,
 			    UMEM_NOFAIL);
 			zbre->zbre_dva = bp->blk_dva[0];
 			zbre->zbre_refcount = crefcnt;
-			avl_insert(&zcb->zcb_brt, zbre, where);
+			avl_insert(&szcb->zcb_brt, zbre, where);
 		}
+		mutex_exit(&szcb->zcb_brt_lock);
 	}
 
 	if (dump_opt['L'])
@@ -5762,22 +5845,28 @@ zdb_count_block(zdb_cb_t *zcb, zilog_t *zilog, const blkptr_t *bp,
 
 	if (BP_GET_DEDUP(bp)) {
 		ddt_t *ddt;
+		ddt_shard_t *dds;
 		ddt_entry_t *dde;
 
 		ddt = ddt_select(zcb->zcb_spa, bp);
-		ddt_enter(ddt);
+		dds = ddt_shard_select(ddt, bp);
+		ddt_shard_enter(dds);
 		dde = ddt_lookup(ddt, bp, B_FALSE);
 
-		if (dde == NULL) {
+		/*
+		 * A pruned block has no entry, or, if the same data has been
+		 * written again since, an entry whose phys doesn't match it.
+		 */
+		ddt_phys_t *ddp = dde != NULL ? ddt_phys_select(dde, bp) : NULL;
+		if (ddp == NULL) {
 			refcnt = 0;
 		} else {
-			ddt_phys_t *ddp = ddt_phys_select(dde, bp);
 			ddt_phys_decref(ddp);
 			refcnt = ddp->ddp_refcnt;
 			if (ddt_phys_total_refcnt(dde) == 0)
 				ddt_remove(ddt, dde);
 		}
-		ddt_exit(ddt);
+		ddt_shard_exit(dds);
 	}
 
 	VERIFY3U(zio_wait(zio_claim(NULL, zcb->zcb_spa,
@@ -5854,6 +5943,7 @@ zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 
 	zdb_count_block(zcb, zilog, bp,
 	    (type & DMU_OT_NEWTYPE) ? ZDB_OT_OTHER : type);
+	atomic_add_64(&zcb->zcb_shared->zcb_traversed_asize, BP_GET_ASIZE(bp));
 
 	is_metadata = (BP_GET_LEVEL(bp) != 0 || DMU_OT_IS_METADATA(type));
 
@@ -5886,14 +5976,16 @@ zdb_blkptr_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 	else
 		return (0);
 
+	zcb = zcb->zcb_shared;
 	if (dump_opt['b'] < 5 && gethrtime() > zcb->zcb_lastprint + NANOSEC) {
 		uint64_t now = gethrtime();
 		char buf[10];
-		uint64_t bytes = zcb->zcb_type[ZB_TOTAL][ZDB_OT_TOTAL].zb_asize;
+		uint64_t bytes = atomic_load_64(&zcb->zcb_traversed_asize);
 		uint64_t kb_per_sec =
 		    1 + bytes / (1 + ((now - zcb->zcb_start) / 1000 / 1000));
 		uint64_t sec_remaining =
-		    (zcb->zcb_totalasize - bytes) / 1024 / kb_per_sec;
+		    (zcb->zcb_totalasize - MIN(bytes, zcb->zcb_totalasize)) /
+		    1024 / kb_per_sec;
 
 		/* make sure nicenum has enough space */
 		_Static_assert(sizeof (buf) >= NN_NUMBUF_SZ, "buf truncated");
@@ -6093,47 +6185,102 @@ zdb_load_obsolete_counts(vdev_t *vd)
 	return (counts);
 }
 
+static void
+zdb_ddt_leak_entry(spa_t *spa, zdb_cb_t *zcb, enum zio_checksum checksum,
+    const ddt_key_t *ddk, const ddt_phys_t *phys)
+{
+	blkptr_t blk;
+	const ddt_phys_t *ddp = phys;
+	int p;
+
+	ddt_t *ddt = spa->spa_ddt[checksum];
+	VERIFY(ddt);
+
+	for (p = 0; p < DDT_PHYS_TYPES; p++, ddp++) {
+		if (ddp->ddp_phys_birth == 0)
+			continue;
+		ddt_bp_create(checksum, ddk, ddp, &blk);
+		if (p == DDT_PHYS_DITTO) {
+			zdb_count_block(zcb, NULL, &blk, ZDB_OT_DITTO);
+		} else {
+			zcb->zcb_dedup_asize +=
+			    BP_GET_ASIZE(&blk) * (ddp->ddp_refcnt - 1);
+			zcb->zcb_dedup_blocks++;
+		}
+	}
+
+	ddt_shard_t *dds = ddt_shard_select(ddt, &blk);
+	ddt_shard_enter(dds);
+	VERIFY(ddt_lookup(ddt, &blk, B_TRUE) != NULL);
+	ddt_shard_exit(dds);
+}
+
+/*
+ * Count the duplicate entries in a dedup log, skipping any that are also in
+ * the skip log.
+ */
+static void
+zdb_ddt_leak_log(spa_t *spa, zdb_cb_t *zcb, enum zio_checksum checksum,
+    ddt_log_t *ddl, ddt_log_t *skip)
+{
+	for (ddt_log_entry_t *ddle = avl_first(&ddl->ddl_tree);
+	    ddle != NULL; ddle = AVL_NEXT(&ddl->ddl_tree, ddle)) {
+		uint64_t refcnt = 0;
+
+		if (skip != NULL &&
+		    avl_find(&skip->ddl_tree, &ddle->ddle_key, NULL) != NULL)
+			continue;
+
+		for (int p = DDT_PHYS_SINGLE; p <= DDT_PHYS_TRIPLE; p++)
+			refcnt += ddle->ddle_phys[p].ddp_refcnt;
+		if (refcnt <= 1)
+			continue;
+
+		zdb_ddt_leak_entry(spa, zcb, checksum,
+		    &ddle->ddle_key, ddle->ddle_phys);
+	}
+}
+
 static void
 zdb_ddt_leak_init(spa_t *spa, zdb_cb_t *zcb)
 {
 	ddt_bookmark_t ddb = {0};
 	ddt_entry_t dde;
 	int error;
-	int p;
 
 	ASSERT(!dump_opt['L']);
 
 	while ((error = ddt_walk(spa, &ddb, &dde)) == 0) {
-		blkptr_t blk;
-		ddt_phys_t *ddp = dde.dde_phys;
-
 		if (ddb.ddb_class == DDT_CLASS_UNIQUE)
-			return;
+			break;
 
 		ASSERT(ddt_phys_total_refcnt(&dde) > 1);
 		ddt_t *ddt = spa->spa_ddt[ddb.ddb_checksum];
 		VERIFY(ddt);
 
-		for (p = 0; p < DDT_PHYS_TYPES; p++, ddp++) {
-			if (ddp->ddp_phys_birth == 0)
-				continue;
-			ddt_bp_create(ddb.ddb_checksum,
-			    &dde.dde_key, ddp, &blk);
-			if (p == DDT_PHYS_DITTO) {
-				zdb_count_block(zcb, NULL, &blk, ZDB_OT_DITTO);
-			} else {
-				zcb->zcb_dedup_asize +=
-				    BP_GET_ASIZE(&blk) * (ddp->ddp_refcnt - 1);
-				zcb->zcb_dedup_blocks++;
-			}
-		}
-
+		/* The logged copy, if any, is more recent; count it below. */
 		ddt_enter(ddt);
-		VERIFY(ddt_lookup(ddt, &blk, B_TRUE) != NULL);
+		boolean_t logged = ddt_log_find_key(ddt, &dde.dde_key, NULL);
 		ddt_exit(ddt);
+		if (logged)
+			continue;
+
+		zdb_ddt_leak_entry(spa, zcb, ddb.ddb_checksum,
+		    &dde.dde_key, dde.dde_phys);
 	}
 
-	ASSERT(error == ENOENT);
+	ASSERT(error == 0 || error == ENOENT);
+
+	for (enum zio_checksum c = 0; c < ZIO_CHECKSUM_FUNCTIONS; c++) {
+		ddt_t *ddt = spa->spa_ddt[c];
+		if (ddt == NULL || !ddt_log_exists(ddt))
+			continue;
+
+		/* The active copy of an entry supersedes the flushing one. */
+		zdb_ddt_leak_log(spa, zcb, c, ddt->ddt_log_active, NULL);
+		zdb_ddt_leak_log(spa, zcb, c, ddt->ddt_log_flushing,
+		    ddt->ddt_log_active);
+	}
 }
 
 typedef struct checkpoint_sm_exclude_entry_arg {
@@ -6775,6 +6922,70 @@ zdb_brt_entry_compare(const void *zcn1, const void *zcn2)
 	return (cmp);
 }
 
+/*
+ * Number of datasets to traverse at once, see -j.
+ */
+static int
+zdb_nthreads(void)
+{
+	if (zdb_threads != 0)
+		return (zdb_threads);
+
+	return (MIN(max_ncpus, 8));
+}
+
+/*
+ * Fold the counters of a block traversal thread into the main zdb_cb_t.
+ */
+static void
+zdb_cb_merge(zdb_cb_t *zcb, const zdb_cb_t *tzcb)
+{
+	for (int l = 0; l <= ZB_TOTAL; l++) {
+		for (int t = 0; t <= ZDB_OT_TOTAL; t++) {
+			zdb_blkstats_t *zb = &zcb->zcb_type[l][t];
+			const zdb_blkstats_t *tzb = &tzcb->zcb_type[l][t];
+
+			zb->zb_asize += tzb->zb_asize;
+			zb->zb_lsize += tzb->zb_lsize;
+			zb->zb_psize += tzb->zb_psize;
+			zb->zb_count += tzb->zb_count;
+			zb->zb_gangs += tzb->zb_gangs;
+			zb->zb_ditto_samevdev += tzb->zb_ditto_samevdev;
+			zb->zb_ditto_same_ms += tzb->zb_ditto_same_ms;
+			for (int i = 0; i < PSIZE_HISTO_SIZE; i++) {
+				zb->zb_psize_histogram[i] +=
+				    tzb->zb_psize_histogram[i];
+			}
+		}
+	}
+
+	zcb->zcb_dedup_asize += tzcb->zcb_dedup_asize;
+	zcb->zcb_dedup_blocks += tzcb->zcb_dedup_blocks;
+	zcb->zcb_clone_asize += tzcb->zcb_clone_asize;
+	zcb->zcb_clone_blocks += tzcb->zcb_clone_blocks;
+	for (int i = 0; i < SPA_MAX_FOR_16M; i++) {
+		zcb->zcb_psize_count[i] += tzcb->zcb_psize_count[i];
+		zcb->zcb_lsize_count[i] += tzcb->zcb_lsize_count[i];
+		zcb->zcb_asize_count[i] += tzcb->zcb_asize_count[i];
+		zcb->zcb_psize_len[i] += tzcb->zcb_psize_len[i];
+		zcb->zcb_lsize_len[i] += tzcb->zcb_lsize_len[i];
+		zcb->zcb_asize_len[i] += tzcb->zcb_asize_len[i];
+	}
+	zcb->zcb_psize_total += tzcb->zcb_psize_total;
+	zcb->zcb_lsize_total += tzcb->zcb_lsize_total;
+	zcb->zcb_asize_total += tzcb->zcb_asize_total;
+	for (int i = 0; i < NUM_BP_EMBEDDED_TYPES; i++) {
+		zcb->zcb_embedded_blocks[i] += tzcb->zcb_embedded_blocks[i];
+		for (int j = 0; j <= BPE_PAYLOAD_SIZE; j++) {
+			zcb->zcb_embedded_histogram[i][j] +=
+			    tzcb->zcb_embedded_histogram[i][j];
+		}
+	}
+	for (int e = 0; e < 256; e++)
+		zcb->zcb_errors[e] += tzcb->zcb_errors[e];
+	zcb->zcb_haderrors |= tzcb->zcb_haderrors;
+}
+
 static int
 dump_block_stats(spa_t *spa)
 {
@@ -6784,10 +6995,14 @@ dump_block_stats(spa_t *spa)
 	int flags = TRAVERSE_PRE | TRAVERSE_PREFETCH_METADATA |
 	    TRAVERSE_NO_DECRYPT | TRAVERSE_HARD;
 	boolean_t leaks = B_FALSE;
-	int e, c, err;
+	zdb_cb_t **tzcbs;
+	void **args;
+	int e, c, err, nthreads;
 	bp_embedded_type_t i;
 
 	zcb = umem_zalloc(sizeof (zdb_cb_t), UMEM_NOFAIL);
+	zcb->zcb_shared = zcb;
+	mutex_init(&zcb->zcb_brt_lock, NULL, MUTEX_DEFAULT, NULL);
 
 	if (spa_feature_is_active(spa, SPA_FEATURE_BLOCK_CLONING)) {
 		avl_create(&zcb->zcb_brt, zdb_brt_entry_compare,
@@ -6841,13 +7056,46 @@ dump_block_stats(spa_t *spa)
 	if (dump_opt['c'] > 1)
 		flags |= TRAVERSE_PREFETCH_DATA;
 
+	/*
+	 * Unless limited with -I, keep enough checksum reads in flight to
+	 * keep every leaf vdev busy, within an eighth of memory.
+	 */
+	if (dump_opt['c'] && !max_inflight_set) {
+		uint64_t leaves = vdev_count_leaves(spa);
+
+		max_inflight_bytes = MAX(max_inflight_bytes,
+		    MIN(leaves * 16 * 1024 * 1024, physmem * PAGESIZE / 8));
+	}
+
 	zcb->zcb_totalasize = metaslab_class_get_alloc(spa_normal_class(spa));
 	zcb->zcb_totalasize += metaslab_class_get_alloc(spa_special_class(spa));
 	zcb->zcb_totalasize += metaslab_class_get_alloc(spa_dedup_class(spa));
 	zcb->zcb_totalasize +=
 	    metaslab_class_get_alloc(spa_embedded_log_class(spa));
 	zcb->zcb_start = zcb->zcb_lastprint = gethrtime();
-	err = traverse_pool(spa, 0, flags, zdb_blkptr_cb, zcb);
+
+	/*
+	 * Datasets are traversed concurrently, each traversal thread counting
+	 * into its own zdb_cb_t.  Blocks are printed in traversal order at
+	 * -bbbbb, so that stays single threaded.
+	 */
+	nthreads = zdb_nthreads();
+	if (dump_opt['b'] >= 5)
+		nthreads = 1;
+
+	tzcbs = umem_zalloc(nthreads * sizeof (zdb_cb_t *), UMEM_NOFAIL);
+	args = umem_zalloc(nthreads * sizeof (void *), UMEM_NOFAIL);
+	args[0] = tzcbs[0] = zcb;
+	for (c = 1; c < nthreads; c++) {
+		tzcbs[c] = umem_zalloc(sizeof (zdb_cb_t), UMEM_NOFAIL);
+		tzcbs[c]->zcb_spa = spa;
+		tzcbs[c]->zcb_brt_is_active = zcb->zcb_brt_is_active;
+		tzcbs[c]->zcb_shared = zcb;
+		args[c] = tzcbs[c];
+	}
+
+	err = traverse_pool_parallel(spa, 0, flags, zdb_blkptr_cb, args,
+	    nthreads);
 
 	/*
 	 * If we've traversed the data blocks then we need to wait for those
@@ -6865,9 +7113,17 @@ dump_block_stats(spa_t *spa)
 	ASSERT0(spa->spa_load_verify_bytes);
 
 	/*
-	 * Done after zio_wait() since zcb_haderrors is modified in
-	 * zdb_blkptr_done()
+	 * Done after zio_wait() since zcb_haderrors and zcb_errors are
+	 * modified in zdb_blkptr_done()
 	 */
+	for (c = 1; c < nthreads; c++) {
+		zdb_cb_merge(zcb, tzcbs[c]);
+		umem_free(tzcbs[c], sizeof (zdb_cb_t));
+	}
+	umem_free(tzcbs, nthreads * sizeof (zdb_cb_t *));
+	umem_free(args, nthreads * sizeof (void *));
+	mutex_destroy(&zcb->zcb_brt_lock);
+
 	zcb->zcb_haderrors |= err;
 
 	if (zcb->zcb_haderrors) {
@@ -7172,9 +7428,23 @@ dump_block_stats(spa_t *spa)
 	return (0);
 }
 
+/*
+ * The simulated DDT for -S is a hash table sharded by the high bits of a
+ * hash of the block checksum, so that datasets can be traversed in
+ * parallel.  Its size is bounded by sampling: only blocks whose checksum
+ * hash has zdt_shift low zero bits are counted, which picks 1 in
+ * 2^zdt_shift of the unique blocks together with all of their references.
+ * Whenever the table grows past zdt_max_entries the shift is raised and
+ * the entries that no longer qualify are dropped, and the final histogram
+ * is scaled back up by 2^zdt_shift.
+ */
+#define	ZDB_DDT_SHARDS_SHIFT	6
+#define	ZDB_DDT_SHARDS		(1 << ZDB_DDT_SHARDS_SHIFT)
+
 typedef struct zdb_ddt_entry {
 	/* key must be first for ddt_key_compare */
 	ddt_key_t	zdde_key;
+	uint64_t	zdde_hash;
 	uint64_t	zdde_ref_blocks;
 	uint64_t	zdde_ref_lsize;
 	uint64_t	zdde_ref_psize;
@@ -7182,14 +7452,74 @@ typedef struct zdb_ddt_entry {
 	avl_node_t	zdde_node;
 } zdb_ddt_entry_t;
 
+typedef struct zdb_ddt_shard {
+	kmutex_t	zds_lock;
+	avl_tree_t	zds_tree;
+} zdb_ddt_shard_t;
+
+typedef struct zdb_ddt {
+	zdb_ddt_shard_t	zdt_shard[ZDB_DDT_SHARDS];
+	uint64_t	zdt_nentries;
+	uint64_t	zdt_max_entries;
+	/* Only raised with all shard locks held. */
+	uint_t		zdt_shift;
+} zdb_ddt_t;
+
+static inline boolean_t
+zdb_ddt_sampled(zdb_ddt_t *zdt, uint64_t hash)
+{
+	return ((hash & ((1ULL << zdt->zdt_shift) - 1)) == 0);
+}
+
+/*
+ * Raise the sampling shift until the table fits, dropping the entries that
+ * are no longer sampled.
+ */
+static void
+zdb_ddt_shrink(zdb_ddt_t *zdt)
+{
+	for (int i = 0; i < ZDB_DDT_SHARDS; i++)
+		mutex_enter(&zdt->zdt_shard[i].zds_lock);
+
+	while (zdt->zdt_nentries > zdt->zdt_max_entries &&
+	    zdt->zdt_shift < 63) {
+		zdt->zdt_shift++;
+
+		for (int i = 0; i < ZDB_DDT_SHARDS; i++) {
+			avl_tree_t *t = &zdt->zdt_shard[i].zds_tree;
+			zdb_ddt_entry_t *zdde, *next;
+
+			for (zdde = avl_first(t); zdde != NULL; zdde = next) {
+				next = AVL_NEXT(t, zdde);
+				if (zdb_ddt_sampled(zdt, zdde->zdde_hash))
+					continue;
+				avl_remove(t, zdde);
+				umem_free(zdde, sizeof (*zdde));
+				zdt->zdt_nentries--;
+			}
+		}
+
+		if (dump_opt['S'] > 1) {
+			(void) printf("simulated DDT full, now sampling 1 in "
+			    "%llu blocks\n", (u_longlong_t)1 << zdt->zdt_shift);
+		}
+	}
+
+	for (int i = ZDB_DDT_SHARDS - 1; i >= 0; i--)
+		mutex_exit(&zdt->zdt_shard[i].zds_lock);
+}
+
 static int
 zdb_ddt_add_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
     const zbookmark_phys_t *zb, const dnode_phys_t *dnp, void *arg)
 {
 	(void) zilog, (void) dnp;
-	avl_tree_t *t = arg;
+	zdb_ddt_t *zdt = arg;
+	zdb_ddt_shard_t *zds;
 	avl_index_t where;
 	zdb_ddt_entry_t *zdde, zdde_search;
+	boolean_t added = B_FALSE;
+	uint64_t hash;
 
 	if (zb->zb_level == ZB_DNODE_LEVEL || BP_IS_HOLE(bp) ||
 	    BP_IS_EMBEDDED(bp))
@@ -7197,10 +7527,10 @@ zdb_ddt_add_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 
 	if (dump_opt['S'] > 1 && zb->zb_level == ZB_ROOT_LEVEL) {
 		(void) printf("traversing objset %llu, %llu objects, "
-		    "%lu blocks so far\n",
+		    "%llu blocks so far\n",
 		    (u_longlong_t)zb->zb_objset,
 		    (u_longlong_t)BP_GET_FILL(bp),
-		    avl_numnodes(t));
+		    (u_longlong_t)atomic_load_64(&zdt->zdt_nentries));
 	}
 
 	if (BP_IS_HOLE(bp) || BP_GET_CHECKSUM(bp) == ZIO_CHECKSUM_OFF ||
@@ -7209,12 +7539,33 @@ zdb_ddt_add_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 
 	ddt_key_fill(&zdde_search.zdde_key, bp);
 
-	zdde = avl_find(t, &zdde_search, &where);
+	/*
+	 * Not every checksum is well distributed, so hash it.  A stale
+	 * zdt_shift only lets the block through to the check under the lock.
+	 */
+	hash = cityhash4(zdde_search.zdde_key.ddk_cksum.zc_word[0],
+	    zdde_search.zdde_key.ddk_cksum.zc_word[1],
+	    zdde_search.zdde_key.ddk_cksum.zc_word[2],
+	    zdde_search.zdde_key.ddk_cksum.zc_word[3]);
+	if (!zdb_ddt_sampled(zdt, hash))
+		return (0);
+
+	zds = &zdt->zdt_shard[hash >> (64 - ZDB_DDT_SHARDS_SHIFT)];
+	mutex_enter(&zds->zds_lock);
+
+	if (!zdb_ddt_sampled(zdt, hash)) {
+		mutex_exit(&zds->zds_lock);
+		return (0);
+	}
+
+	zdde = avl_find(&zds->zds_tree, &zdde_search, &where);
 
 	if (zdde == NULL) {
 		zdde = umem_zalloc(sizeof (*zdde), UMEM_NOFAIL);
 		zdde->zdde_key = zdde_search.zdde_key;
-		avl_insert(t, zdde, where);
+		zdde->zdde_hash = hash;
+		avl_insert(&zds->zds_tree, zdde, where);
+		added = B_TRUE;
 	}
 
 	zdde->zdde_ref_blocks += 1;
@@ -7222,58 +7573,104 @@ zdb_ddt_add_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
 	zdde->zdde_ref_psize += BP_GET_PSIZE(bp);
 	zdde->zdde_ref_dsize += bp_get_dsize_sync(spa, bp);
 
+	mutex_exit(&zds->zds_lock);
+
+	if (added && atomic_inc_64_nv(&zdt->zdt_nentries) >
+	    zdt->zdt_max_entries)
+		zdb_ddt_shrink(zdt);
+
 	return (0);
 }
 
 static void
 dump_simulated_ddt(spa_t *spa)
 {
-	avl_tree_t t;
-	void *cookie = NULL;
+	zdb_ddt_t *zdt;
 	zdb_ddt_entry_t *zdde;
 	ddt_histogram_t ddh_total = {{{0}}};
 	ddt_stat_t dds_total = {0};
-
-	avl_create(&t, ddt_key_compare,
-	    sizeof (zdb_ddt_entry_t), offsetof(zdb_ddt_entry_t, zdde_node));
+	void **args;
+	int nthreads = zdb_nthreads();
+
+	zdt = umem_zalloc(sizeof (zdb_ddt_t), UMEM_NOFAIL);
+	for (int i = 0; i < ZDB_DDT_SHARDS; i++) {
+		mutex_init(&zdt->zdt_shard[i].zds_lock, NULL, MUTEX_DEFAULT,
+		    NULL);
+		avl_create(&zdt->zdt_shard[i].zds_tree, ddt_key_compare,
+		    sizeof (zdb_ddt_entry_t),
+		    offsetof(zdb_ddt_entry_t, zdde_node));
+	}
+	zdt->zdt_shift = simulate_sample_shift;
+	/* Leave most of memory to the ARC and the traversal. */
+	zdt->zdt_max_entries = physmem * PAGESIZE / 4 /
+	    (sizeof (zdb_ddt_entry_t) + 16);
+
+	args = umem_alloc(nthreads * sizeof (void *), UMEM_NOFAIL);
+	for (int i = 0; i < nthreads; i++)
+		args[i] = zdt;
 
 	spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
 
-	(void) traverse_pool(spa, 0, TRAVERSE_PRE | TRAVERSE_PREFETCH_METADATA |
-	    TRAVERSE_NO_DECRYPT, zdb_ddt_add_cb, &t);
+	(void) traverse_pool_parallel(spa, 0, TRAVERSE_PRE |
+	    TRAVERSE_PREFETCH_METADATA | TRAVERSE_NO_DECRYPT, zdb_ddt_add_cb,
+	    args, nthreads);
 
 	spa_config_exit(spa, SCL_CONFIG, FTAG);
 
-	while ((zdde = avl_destroy_nodes(&t, &cookie)) != NULL) {
-		ddt_stat_t dds;
-		uint64_t refcnt = zdde->zdde_ref_blocks;
-		ASSERT(refcnt != 0);
+	umem_free(args, nthreads * sizeof (void *));
+
+	for (int i = 0; i < ZDB_DDT_SHARDS; i++) {
+		avl_tree_t *t = &zdt->zdt_shard[i].zds_tree;
+		void *cookie = NULL;
 
-		dds.dds_blocks = zdde->zdde_ref_blocks / refcnt;
-		dds.dds_lsize = zdde->zdde_ref_lsize / refcnt;
-		dds.dds_psize = zdde->zdde_ref_psize / refcnt;
-		dds.dds_dsize = zdde->zdde_ref_dsize / refcnt;
+		while ((zdde = avl_destroy_nodes(t, &cookie)) != NULL) {
+			ddt_stat_t dds;
+			uint64_t refcnt = zdde->zdde_ref_blocks;
+			ASSERT(refcnt != 0);
 
-		dds.dds_ref_blocks = zdde->zdde_ref_blocks;
-		dds.dds_ref_lsize = zdde->zdde_ref_lsize;
-		dds.dds_ref_psize = zdde->zdde_ref_psize;
-		dds.dds_ref_dsize = zdde->zdde_ref_dsize;
+			dds.dds_blocks = zdde->zdde_ref_blocks / refcnt;
+			dds.dds_lsize = zdde->zdde_ref_lsize / refcnt;
+			dds.dds_psize = zdde->zdde_ref_psize / refcnt;
+			dds.dds_dsize = zdde->zdde_ref_dsize / refcnt;
 
-		ddt_stat_add(&ddh_total.ddh_stat[highbit64(refcnt) - 1],
-		    &dds, 0);
+			dds.dds_ref_blocks = zdde->zdde_ref_blocks;
+			dds.dds_ref_lsize = zdde->zdde_ref_lsize;
+			dds.dds_ref_psize = zdde->zdde_ref_psize;
+			dds.dds_ref_dsize = zdde->zdde_ref_dsize;
 
-		umem_free(zdde, sizeof (*zdde));
+			ddt_stat_add(&ddh_total.ddh_stat[highbit64(refcnt) - 1],
+			    &dds, 0);
+
+			umem_free(zdde, sizeof (*zdde));
+		}
+
+		avl_destroy(t);
+		mutex_destroy(&zdt->zdt_shard[i].zds_lock);
 	}
 
-	avl_destroy(&t);
+	/* Scale the sampled blocks up to the whole pool. */
+	if (zdt->zdt_shift != 0) {
+		uint64_t *s = (uint64_t *)&ddh_total;
+		uint64_t *s_end = (uint64_t *)(&ddh_total + 1);
+
+		while (s < s_end)
+			*s++ <<= zdt->zdt_shift;
+	}
 
 	ddt_histogram_stat(&dds_total, &ddh_total);
 
-	(void) printf("Simulated DDT histogram:\n");
+	if (zdt->zdt_shift != 0) {
+		(void) printf("Simulated DDT histogram (estimated from 1 in "
+		    "%llu blocks):\n", (u_longlong_t)1 << zdt->zdt_shift);
+	} else {
+		(void) printf("Simulated DDT histogram:\n");
+	}
 
 	zpool_dump_ddt(&dds_total, &ddh_total);
 
 	dump_dedup_ratio(&dds_total);
+
+	umem_free(zdt, sizeof (zdb_ddt_t));
 }
 
 static int
@@ -7955,6 +8352,11 @@ dump_mos_leaks(spa_t *spa)
 	mos_obj_refd(spa->spa_l2cache.sav_object);
 	mos_obj_refd(spa->spa_spares.sav_object);
 
+	uint64_t arc_warm_obj;
+	if (zap_lookup(mos, DMU_POOL_DIRECTORY_OBJECT, DMU_POOL_ARC_WARM,
+	    sizeof (uint64_t), 1, &arc_warm_obj) == 0)
+		mos_obj_refd(arc_warm_obj);
+
 	if (spa->spa_syncing_log_sm != NULL)
 		mos_obj_refd(spa->spa_syncing_log_sm->sm_object);
 	mos_leak_log_spacemaps(spa);
@@ -8007,6 +8409,14 @@ dump_mos_leaks(spa_t *spa)
 		}
 	}
 
+	for (enum zio_checksum c = 0; c < ZIO_CHECKSUM_FUNCTIONS; c++) {
+		ddt_t *ddt = spa->spa_ddt[c];
+		if (ddt == NULL)
+			continue;
+		mos_obj_refd(ddt->ddt_log[0].ddl_object);
+		mos_obj_refd(ddt->ddt_log[1].ddl_object);
+	}
+
 	if (spa->spa_brt != NULL) {
 		brt_t *brt = spa->spa_brt;
 		for (uint64_t vdevid = 0; vdevid < brt->brt_nvdevs; vdevid++) {
@@ -8014,6 +8424,7 @@ dump_mos_leaks(spa_t *spa)
 			if (brtvd != NULL && brtvd->bv_initiated) {
 				mos_obj_refd(brtvd->bv_mos_brtvdev);
 				mos_obj_refd(brtvd->bv_mos_entries);
+				mos_obj_refd(brtvd->bv_mos_bloom);
 			}
 		}
 	}
@@ -8157,6 +8568,9 @@ dump_zpool(spa_t *spa)
 	if (dump_opt['T'])
 		dump_brt(spa);
 
+	if (dump_opt['J'])
+		dump_dedup_sample(spa);
+
 	if (dump_opt['d'] > 2 || dump_opt['m'])
 		dump_metaslabs(spa);
 	if (dump_opt['M'])
@@ -8979,6 +9393,8 @@ main(int argc, char **argv)
 		{"history",		no_argument,		NULL, 'h'},
 		{"intent-logs",		no_argument,		NULL, 'i'},
 		{"inflight",		required_argument,	NULL, 'I'},
+		{"threads",		required_argument,	NULL, 'j'},
+		{"dedup-sample",	required_argument,	NULL, 'J'},
 		{"checkpointed-state",	no_argument,		NULL, 'k'},
 		{"key",			required_argument,	NULL, 'K'},
 		{"label",		no_argument,		NULL, 'l'},
@@ -8990,6 +9406,7 @@ main(int argc, char **argv)
 		{"object-lookups",	no_argument,		NULL, 'O'},
 		{"path",		required_argument,	NULL, 'p'},
 		{"parseable",		no_argument,		NULL, 'P'},
+		{"simulate-sample",	required_argument,	NULL, 'Q'},
 		{"skip-label",		no_argument,		NULL, 'q'},
 		{"copy-object",		no_argument,		NULL, 'r'},
 		{"read-block",		no_argument,		NULL, 'R'},
@@ -9010,7 +9427,7 @@ main(int argc, char **argv)
 	};
 
 	while ((c = getopt_long(argc, argv,
-	    "AbBcCdDeEFGhiI:kK:lLmMNo:Op:PqrRsSt:TuU:vVx:XYyZ",
+	    "AbBcCdDeEFGhiI:j:J:kK:lLmMNo:Op:PQ:qrRsSt:TuU:vVx:XYyZ",
 	    long_options, NULL)) != -1) {
 		switch (c) {
 		case 'b':
@@ -9062,6 +9479,27 @@ main(int argc, char **argv)
 				    "than 0\n");
 				usage();
 			}
+			max_inflight_set = B_TRUE;
+			break;
+		case 'j':
+			zdb_threads = atoi(optarg);
+			if (zdb_threads <= 0) {
+				(void) fprintf(stderr, "number of traversal "
+				    "threads must be greater than 0\n");
+				usage();
+			}
+			break;
+		case 'J':
+			dump_opt[c]++;
+			dump_all = 0;
+			dedup_sample_count = strtoull(optarg, NULL, 0);
+			if (dedup_sample_count == 0 ||
+			    dedup_sample_count > DDT_SAMPLE_MAX) {
+				(void) fprintf(stderr, "dedup sample count "
+				    "must be between 1 and %llu\n",
+				    (u_longlong_t)DDT_SAMPLE_MAX);
+				usage();
+			}
 			break;
 		case 'K':
 			dump_opt[c]++;
@@ -9069,6 +9507,14 @@ main(int argc, char **argv)
 			/* redact key material in process table */
 			while (*optarg != '\0') { *optarg++ = '*'; }
 			break;
+		case 'Q':
+			simulate_sample_shift = atoi(optarg);
+			if (simulate_sample_shift > 32) {
+				(void) fprintf(stderr, "simulated dedup "
+				    "sample shift must be at most 32\n");
+				usage();
+			}
+			break;
 		case 'o':
 			error = set_global_var(optarg);
 			if (error != 0)
@@ -25,6 +25,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/uio.h>
+#include <sys/zfs_ioctl.h>
 #include <unistd.h>
 #include "zed.h"
 #include "zed_conf.h"
@@ -49,6 +50,7 @@ zed_conf_init(struct zed_conf *zcp)
 
 	zcp->max_jobs = 16;
 	zcp->max_zevent_buf_len = 1 << 20;
+	zcp->max_batch = 64;
 
 	if (!(zcp->pid_file = strdup(ZED_PID_FILE)) ||
 	    !(zcp->zedlet_dir = strdup(ZED_ZEDLET_DIR)) ||
@@ -144,6 +146,8 @@ _zed_conf_display_help(const char *prog, boolean_t got_err)
 		    .v = "16" },
 		{ .o = "-b LEN", .d = "Cap kernel event buffer at LEN entries.",
 		    .v = "1048576" },
+		{ .o = "-e EVENTS", .d = "Read at most EVENTS zevents at once.",
+		    .v = "64" },
 		{},
 	};
 
@@ -233,7 +237,7 @@ _zed_conf_parse_path(char **resultp, const char *path)
 void
 zed_conf_parse_opts(struct zed_conf *zcp, int argc, char **argv)
 {
-	const char * const opts = ":hLVd:p:P:s:vfFMZIj:b:";
+	const char * const opts = ":hLVd:p:P:s:vfFMZIj:b:e:";
 	int opt;
 	unsigned long raw;
 
@@ -305,6 +309,17 @@ zed_conf_parse_opts(struct zed_conf *zcp, int argc, char **argv)
 				zcp->max_zevent_buf_len = raw;
 			}
 			break;
+		case 'e':
+			errno = 0;
+			raw = strtoul(optarg, NULL, 0);
+			if (errno == ERANGE || raw > ZEVENT_BATCH_MAX) {
+				zed_log_die("%lu is too many events", raw);
+			} if (raw == 0) {
+				zed_log_die("0 events makes no sense");
+			} else {
+				zcp->max_batch = raw;
+			}
+			break;
 		case '?':
 		default:
 			if (optopt == '?')
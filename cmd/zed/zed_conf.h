@@ -34,6 +34,7 @@ struct zed_conf {
 
 	int16_t max_jobs;		/* max zedlets to run at one time */
 	int32_t max_zevent_buf_len;	/* max size of kernel event list */
+	uint16_t max_batch;		/* max zevents to read at once */
 
 	boolean_t	do_force:1;		/* true if force enabled */
 	boolean_t	do_foreground:1;	/* true if run in foreground */
@@ -943,38 +943,70 @@ _zed_event_update_enc_sysfs_path(nvlist_t *nvl)
 }
 
 /*
- * Service the next zevent, blocking until one is available.
+ * Return B_TRUE if the zevents 'a' and 'b' are ereports of the same class
+ * about the same vdev, which ZEDLETs only need to hear about once.
  */
-int
-zed_event_service(struct zed_conf *zcp)
+static boolean_t
+_zed_event_same_ereport(nvlist_t *a, nvlist_t *b)
+{
+	const char *class_a, *class_b;
+	uint64_t pool_a, pool_b, vdev_a, vdev_b;
+
+	if (nvlist_lookup_string(a, "class", &class_a) != 0 ||
+	    nvlist_lookup_string(b, "class", &class_b) != 0 ||
+	    strncmp(class_a, "ereport.", 8) != 0 ||
+	    strcmp(class_a, class_b) != 0)
+		return (B_FALSE);
+
+	if (nvlist_lookup_uint64(a, FM_EREPORT_PAYLOAD_ZFS_POOL_GUID,
+	    &pool_a) != 0 ||
+	    nvlist_lookup_uint64(b, FM_EREPORT_PAYLOAD_ZFS_POOL_GUID,
+	    &pool_b) != 0 ||
+	    nvlist_lookup_uint64(a, FM_EREPORT_PAYLOAD_ZFS_VDEV_GUID,
+	    &vdev_a) != 0 ||
+	    nvlist_lookup_uint64(b, FM_EREPORT_PAYLOAD_ZFS_VDEV_GUID,
+	    &vdev_b) != 0)
+		return (B_FALSE);
+
+	return (pool_a == pool_b && vdev_a == vdev_b);
+}
+
+/*
+ * Coalesce the repeated ereports in a batch of zevents.  On return
+ * 'coalesced[i]' is the number of events the i'th one stands in for,
+ * including itself, or 0 if it was folded into an earlier one.
+ */
+static void
+_zed_event_coalesce(nvlist_t **events, uint_t nevents, uint_t *coalesced)
+{
+	for (uint_t i = 0; i < nevents; i++) {
+		coalesced[i] = 1;
+		for (uint_t j = 0; j < i; j++) {
+			if (coalesced[j] != 0 &&
+			    _zed_event_same_ereport(events[j], events[i])) {
+				coalesced[j]++;
+				coalesced[i] = 0;
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Handle a single zevent.  The internal agents see every event, while the
+ * ZEDLETs are skipped for those coalesced into an earlier one.
+ */
+static void
+_zed_event_handle(struct zed_conf *zcp, nvlist_t *nvl, uint_t coalesced)
 {
-	nvlist_t *nvl;
 	nvpair_t *nvp;
-	int n_dropped;
 	zed_strings_t *zsp;
 	uint64_t eid;
 	int64_t *etime;
 	uint_t nelem;
 	const char *class;
 	const char *subclass;
-	int rv;
 
-	if (!zcp) {
-		errno = EINVAL;
-		zed_log_msg(LOG_ERR, "Failed to service zevent: %s",
-		    strerror(errno));
-		return (EINVAL);
-	}
-	rv = zpool_events_next(zcp->zfs_hdl, &nvl, &n_dropped, ZEVENT_NONE,
-	    zcp->zevent_fd);
-
-	if ((rv != 0) || !nvl)
-		return (errno);
-
-	if (n_dropped > 0) {
-		zed_log_msg(LOG_WARNING, "Missed %d events", n_dropped);
-		_bump_event_queue_length();
-	}
 	if (nvlist_lookup_uint64(nvl, "eid", &eid) != 0) {
 		zed_log_msg(LOG_WARNING, "Failed to lookup zevent eid");
 	} else if (nvlist_lookup_int64_array(
@@ -1003,6 +1035,11 @@ zed_event_service(struct zed_conf *zcp)
 		/* let internal modules see this event first */
 		zfs_agent_post_event(class, NULL, nvl);
 
+		if (coalesced == 0) {
+			zed_conf_write_state(zcp, eid, etime);
+			return;
+		}
+
 		zsp = zed_strings_create();
 
 		nvp = NULL;
@@ -1019,6 +1056,9 @@ zed_event_service(struct zed_conf *zcp)
 		subclass = _zed_event_get_subclass(class);
 		_zed_event_add_var(eid, zsp, ZEVENT_VAR_PREFIX, "SUBCLASS",
 		    "%s", (subclass ? subclass : class));
+		if (coalesced > 1)
+			_zed_event_add_var(eid, zsp, ZEVENT_VAR_PREFIX,
+			    "COALESCED", "%u", coalesced);
 
 		_zed_event_add_time_strings(eid, zsp, etime);
 
@@ -1028,6 +1068,54 @@ zed_event_service(struct zed_conf *zcp)
 
 		zed_strings_destroy(zsp);
 	}
-	nvlist_free(nvl);
+}
+
+/*
+ * Service the next batch of zevents, blocking until one is available.
+ */
+int
+zed_event_service(struct zed_conf *zcp)
+{
+	nvlist_t *batch;
+	nvlist_t **events;
+	uint_t nevents;
+	uint_t *coalesced;
+	int n_dropped;
+	int rv;
+
+	if (!zcp) {
+		errno = EINVAL;
+		zed_log_msg(LOG_ERR, "Failed to service zevent: %s",
+		    strerror(errno));
+		return (EINVAL);
+	}
+	rv = zpool_events_next_batch(zcp->zfs_hdl, &batch, &n_dropped,
+	    ZEVENT_NONE, zcp->max_batch, zcp->zevent_fd);
+
+	if ((rv != 0) || !batch)
+		return (errno);
+
+	if (n_dropped > 0) {
+		zed_log_msg(LOG_WARNING, "Missed %d events", n_dropped);
+		_bump_event_queue_length();
+	}
+	if (nvlist_lookup_nvlist_array(batch, ZEVENT_BATCH_EVENTS,
+	    &events, &nevents) != 0) {
+		zed_log_msg(LOG_WARNING, "Failed to lookup zevent batch");
+		nvlist_free(batch);
+		return (0);
+	}
+
+	/* Without memory to coalesce, every event gets its ZEDLETs run */
+	coalesced = calloc(nevents, sizeof (uint_t));
+	if (coalesced != NULL)
+		_zed_event_coalesce(events, nevents, coalesced);
+
+	for (uint_t i = 0; i < nevents; i++)
+		_zed_event_handle(zcp, events[i],
+		    coalesced != NULL ? coalesced[i] : 1);
+
+	free(coalesced);
+	nvlist_free(batch);
 	return (0);
 }
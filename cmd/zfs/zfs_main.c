@@ -320,6 +320,7 @@ get_usage(zfs_help_t idx)
 		    "\treceive [-vMnsFhu] [-o <property>=<value>] ... "
 		    "[-x <property>] ... \n"
 		    "\t    [-d | -e] <filesystem>\n"
+		    "\treceive ... [-T fd[,fd]...]\n"
 		    "\treceive -A <filesystem|volume>\n"));
 	case HELP_RENAME:
 		return (gettext("\trename [-f] <filesystem|volume|snapshot> "
@@ -338,7 +339,8 @@ get_usage(zfs_help_t idx)
 		    "\tsend [-DnPpVvLec] [-i bookmark|snapshot] "
 		    "--redact <bookmark> <snapshot>\n"
 		    "\tsend [-nVvPe] -t <receive_resume_token>\n"
-		    "\tsend [-PnVv] --saved filesystem\n"));
+		    "\tsend [-PnVv] --saved filesystem\n"
+		    "\tsend ... [-T fd[,fd]...]\n"));
 	case HELP_SET:
 		return (gettext("\tset [-u] <property=value> ... "
 		    "<filesystem|volume|snapshot> ...\n"));
@@ -4464,10 +4466,46 @@ zfs_do_send_exclude(zfs_handle_t *zhp, void *context)
 }
 
 /*
- * Send a backup stream to stdout.
+ * Parse the comma-separated list of file descriptors given to -T.
+ */
+static void
+parse_stripe_fds(char *arg, int **fdsp, uint_t *nfdsp)
+{
+	for (char *fd; (fd = strsep(&arg, ",")) != NULL; ) {
+		char *end;
+		long val = strtol(fd, &end, 10);
+
+		if (*fd == '\0' || *end != '\0' || val < 0 ||
+		    val > INT_MAX || fcntl(val, F_GETFD) == -1) {
+			(void) fprintf(stderr, gettext("-T %s: not an open "
+			    "file descriptor\n"), fd);
+			usage(B_FALSE);
+		}
+		*fdsp = safe_realloc(*fdsp, sizeof (int) * (*nfdsp + 1));
+		(*fdsp)[(*nfdsp)++] = (int)val;
+	}
+}
+
+static int zfs_do_send_impl(int, char **, zfs_stripe_t **);
+
+/*
+ * Send a backup stream to stdout, or striped over the descriptors given
+ * with -T.
  */
 static int
 zfs_do_send(int argc, char **argv)
+{
+	zfs_stripe_t *stripe = NULL;
+	int err;
+
+	err = zfs_do_send_impl(argc, argv, &stripe);
+	if (stripe != NULL && zfs_stripe_finish(stripe) != 0)
+		err = 1;
+	return (err);
+}
+
+static int
+zfs_do_send_impl(int argc, char **argv, zfs_stripe_t **stripep)
 {
 	char *fromname = NULL;
 	char *toname = NULL;
@@ -4479,6 +4517,8 @@ zfs_do_send(int argc, char **argv)
 	nvlist_t *dbgnv = NULL;
 	char *redactbook = NULL;
 	zfs_send_exclude_arg_t excludes = { 0 };
+	int *stripes = NULL;
+	uint_t nstripes = 0;
 
 	struct option long_options[] = {
 		{"replicate",	no_argument,		NULL, 'R'},
@@ -4499,11 +4539,12 @@ zfs_do_send(int argc, char **argv)
 		{"holds",	no_argument,		NULL, 'h'},
 		{"saved",	no_argument,		NULL, 'S'},
 		{"exclude",	required_argument,	NULL, 'X'},
+		{"stripe",	required_argument,	NULL, 'T'},
 		{0, 0, 0, 0}
 	};
 
 	/* check options */
-	while ((c = getopt_long(argc, argv, ":i:I:RsDpVvnPLeht:cwbd:SX:",
+	while ((c = getopt_long(argc, argv, ":i:I:RsDpVvnPLeht:cwbd:SX:T:",
 	    long_options, NULL)) != -1) {
 		switch (c) {
 		case 'X':
@@ -4589,6 +4630,9 @@ zfs_do_send(int argc, char **argv)
 		case 'S':
 			flags.saved = B_TRUE;
 			break;
+		case 'T':
+			parse_stripe_fds(optarg, &stripes, &nstripes);
+			break;
 		case ':':
 			/*
 			 * If a parameter was not passed, optopt contains the
@@ -4701,7 +4745,7 @@ zfs_do_send(int argc, char **argv)
 		return (1);
 	}
 
-	if (!flags.dryrun && isatty(STDOUT_FILENO)) {
+	if (!flags.dryrun && nstripes == 0 && isatty(STDOUT_FILENO)) {
 		free(excludes.list);
 		(void) fprintf(stderr,
 		    gettext("Error: Stream can not be written to a terminal.\n"
@@ -4709,6 +4753,18 @@ zfs_do_send(int argc, char **argv)
 		return (1);
 	}
 
+	if (!flags.dryrun && nstripes != 0) {
+		err = zfs_stripe_start(g_zfs, STDOUT_FILENO, stripes,
+		    nstripes, B_FALSE, stripep);
+		free(stripes);
+		if (err != 0) {
+			free(excludes.list);
+			return (1);
+		}
+	} else {
+		free(stripes);
+	}
+
 	if (flags.saved) {
 		zhp = zfs_open(g_zfs, argv[0], ZFS_TYPE_DATASET);
 		if (zhp == NULL) {
@@ -4881,12 +4937,15 @@ zfs_do_receive(int argc, char **argv)
 	recvflags_t flags = { 0 };
 	boolean_t abort_resumable = B_FALSE;
 	nvlist_t *props;
+	int *stripes = NULL;
+	uint_t nstripes = 0;
+	zfs_stripe_t *stripe = NULL;
 
 	if (nvlist_alloc(&props, NV_UNIQUE_NAME, 0) != 0)
 		nomem();
 
 	/* check options */
-	while ((c = getopt(argc, argv, ":o:x:dehMnuvFsAc")) != -1) {
+	while ((c = getopt(argc, argv, ":o:x:dehMnuvFsAcT:")) != -1) {
 		switch (c) {
 		case 'o':
 			if (!parseprop(props, optarg)) {
@@ -4945,6 +5004,9 @@ zfs_do_receive(int argc, char **argv)
 		case 'c':
 			flags.heal = B_TRUE;
 			break;
+		case 'T':
+			parse_stripe_fds(optarg, &stripes, &nstripes);
+			break;
 		case ':':
 			(void) fprintf(stderr, gettext("missing argument for "
 			    "'%c' option\n"), optopt);
@@ -4976,7 +5038,7 @@ zfs_do_receive(int argc, char **argv)
 
 	if (abort_resumable) {
 		if (flags.isprefix || flags.istail || flags.dryrun ||
-		    flags.resumable || flags.nomount) {
+		    flags.resumable || flags.nomount || nstripes != 0) {
 			(void) fprintf(stderr, gettext("invalid option\n"));
 			usage(B_FALSE);
 		}
@@ -5018,7 +5080,15 @@ zfs_do_receive(int argc, char **argv)
 		return (err != 0);
 	}
 
-	if (isatty(STDIN_FILENO)) {
+	if (nstripes != 0) {
+		err = zfs_stripe_start(g_zfs, STDIN_FILENO, stripes, nstripes,
+		    B_TRUE, &stripe);
+		free(stripes);
+		if (err != 0) {
+			nvlist_free(props);
+			return (1);
+		}
+	} else if (isatty(STDIN_FILENO)) {
 		(void) fprintf(stderr,
 		    gettext("Error: Backup stream can not be read "
 		    "from a terminal.\n"
@@ -5028,6 +5098,8 @@ zfs_do_receive(int argc, char **argv)
 	}
 	err = zfs_receive(g_zfs, argv[0], props, &flags, STDIN_FILENO, NULL);
 	nvlist_free(props);
+	if (stripe != NULL && zfs_stripe_finish(stripe) != 0)
+		err = 1;
 
 	return (err != 0);
 }
@@ -6792,6 +6864,13 @@ get_one_dataset(zfs_handle_t *zhp, void *data)
 		}
 	}
 
+	/*
+	 * Before walking a whole pool, have the kernel prefetch the
+	 * properties and objset blocks of all of its datasets in parallel.
+	 */
+	if (strchr(zfs_get_name(zhp), '/') == NULL)
+		(void) lzc_mount_prefetch(zfs_get_name(zhp));
+
 	/*
 	 * Iterate over any nested datasets.
 	 */
@@ -7183,6 +7262,61 @@ sa_protocol_decode(const char *protocol)
 	usage(B_FALSE);
 }
 
+/*
+ * For 'zfs mount -a -l', load the keys of all the encryption roots of the
+ * datasets to mount up front, in parallel where they needn't be prompted
+ * for. Returns B_TRUE if every key is now loaded, in which case the mounts
+ * no longer have to be serialized for the sake of key prompts.
+ */
+static boolean_t
+share_mount_load_keys(zfs_handle_t **handles, size_t count)
+{
+	nvlist_t *encroots = fnvlist_alloc();
+	char encroot[ZFS_MAX_DATASET_NAME_LEN];
+	boolean_t is_encroot;
+	boolean_t loaded = B_TRUE;
+
+	for (size_t i = 0; i < count; i++) {
+		zfs_handle_t *zhp = handles[i];
+
+		if (zfs_prop_get_int(zhp, ZFS_PROP_ENCRYPTION) ==
+		    ZIO_CRYPT_OFF || zfs_prop_get_int(zhp,
+		    ZFS_PROP_KEYSTATUS) != ZFS_KEYSTATUS_UNAVAILABLE)
+			continue;
+		if (zfs_crypto_get_encryption_root(zhp, &is_encroot,
+		    encroot) != 0) {
+			loaded = B_FALSE;
+			continue;
+		}
+		fnvlist_add_boolean(encroots, is_encroot ?
+		    zfs_get_name(zhp) : encroot);
+	}
+
+	size_t nroots = 0;
+	zfs_handle_t **roots = safe_malloc(MAX(fnvlist_num_pairs(encroots), 1) *
+	    sizeof (zfs_handle_t *));
+	for (nvpair_t *pair = nvlist_next_nvpair(encroots, NULL); pair != NULL;
+	    pair = nvlist_next_nvpair(encroots, pair)) {
+		zfs_handle_t *zhp = zfs_open(g_zfs, nvpair_name(pair),
+		    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME);
+		if (zhp == NULL)
+			loaded = B_FALSE;
+		else
+			roots[nroots++] = zhp;
+	}
+	fnvlist_free(encroots);
+
+	if (zfs_crypto_load_keys(roots, nroots, B_FALSE, NULL,
+	    sysconf(_SC_NPROCESSORS_ONLN)) != 0)
+		loaded = B_FALSE;
+
+	for (size_t i = 0; i < nroots; i++)
+		zfs_close(roots[i]);
+	free(roots);
+
+	return (loaded);
+}
+
 static int
 share_mount(int op, int argc, char **argv)
 {
@@ -7310,9 +7444,12 @@ share_mount(int op, int argc, char **argv)
 		 * libshare isn't mt-safe, so only do the operation in parallel
 		 * if we're mounting. Additionally, the key-loading option must
 		 * be serialized so that we can prompt the user for their keys
-		 * in a consistent manner.
+		 * in a consistent manner, unless all the keys could be loaded
+		 * beforehand.
 		 */
-		nthr = op == OP_MOUNT && !(flags & MS_CRYPT) ? mount_nthr : 1;
+		nthr = op == OP_MOUNT && (!(flags & MS_CRYPT) ||
+		    share_mount_load_keys(cb.cb_handles, cb.cb_used)) ?
+		    mount_nthr : 1;
 		zfs_foreach_mountpoint(g_zfs, cb.cb_handles, cb.cb_used,
 		    share_mount_one_cb, &share_mount_state, nthr);
 		zfs_commit_shares(NULL);
@@ -8302,6 +8439,8 @@ typedef struct loadkey_cbdata {
 	char *cb_keylocation;
 	uint64_t cb_numfailed;
 	uint64_t cb_numattempted;
+	zfs_handle_t **cb_handles;
+	size_t cb_alloc;
 } loadkey_cbdata_t;
 
 static int
@@ -8329,6 +8468,20 @@ load_key_callback(zfs_handle_t *zhp, void *data)
 			return (0);
 	}
 
+	/*
+	 * When loading many keys, collect the encryption roots to load
+	 * them all at once with zfs_crypto_load_keys().
+	 */
+	if (cb->cb_loadkey && cb->cb_recursive) {
+		if (cb->cb_numattempted == cb->cb_alloc) {
+			cb->cb_alloc = MAX(cb->cb_alloc * 2, 64);
+			cb->cb_handles = safe_realloc(cb->cb_handles,
+			    cb->cb_alloc * sizeof (zfs_handle_t *));
+		}
+		cb->cb_handles[cb->cb_numattempted++] = zfs_handle_dup(zhp);
+		return (0);
+	}
+
 	cb->cb_numattempted++;
 
 	if (cb->cb_loadkey)
@@ -8410,6 +8563,15 @@ load_unload_keys(int argc, char **argv, boolean_t loadkey)
 	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME, NULL, NULL, 0,
 	    load_key_callback, &cb);
 
+	if (cb.cb_handles != NULL) {
+		cb.cb_numfailed += zfs_crypto_load_keys(cb.cb_handles,
+		    cb.cb_numattempted, cb.cb_noop, cb.cb_keylocation,
+		    sysconf(_SC_NPROCESSORS_ONLN));
+		for (uint64_t i = 0; i < cb.cb_numattempted; i++)
+			zfs_close(cb.cb_handles[i]);
+		free(cb.cb_handles);
+	}
+
 	if (cb.cb_noop || (cb.cb_recursive && cb.cb_numattempted != 0)) {
 		(void) printf(gettext("%llu / %llu key(s) successfully %s\n"),
 		    (u_longlong_t)(cb.cb_numattempted - cb.cb_numfailed),
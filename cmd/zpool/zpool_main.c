@@ -101,6 +101,7 @@ static int zpool_do_clear(int, char **);
 static int zpool_do_reopen(int, char **);
 
 static int zpool_do_reguid(int, char **);
+static int zpool_do_ddt_prune(int, char **);
 
 static int zpool_do_attach(int, char **);
 static int zpool_do_detach(int, char **);
@@ -190,6 +191,7 @@ typedef enum {
 	HELP_SPLIT,
 	HELP_SYNC,
 	HELP_REGUID,
+	HELP_DDTPRUNE,
 	HELP_REOPEN,
 	HELP_VERSION,
 	HELP_WAIT
@@ -331,6 +333,7 @@ static zpool_command_t command_table[] = {
 	{ "export",	zpool_do_export,	HELP_EXPORT		},
 	{ "upgrade",	zpool_do_upgrade,	HELP_UPGRADE		},
 	{ "reguid",	zpool_do_reguid,	HELP_REGUID		},
+	{ "ddtprune",	zpool_do_ddt_prune,	HELP_DDTPRUNE		},
 	{ NULL },
 	{ "history",	zpool_do_history,	HELP_HISTORY		},
 	{ "events",	zpool_do_events,	HELP_EVENTS		},
@@ -415,7 +418,8 @@ get_usage(zpool_help_t idx)
 		return (gettext("\tinitialize [-c | -s | -u] [-w] <pool> "
 		    "[<device> ...]\n"));
 	case HELP_SCRUB:
-		return (gettext("\tscrub [-s | -p] [-w] [-e] <pool> ...\n"));
+		return (gettext("\tscrub [-e | -s | -p | -C] [-w] "
+		    "<pool> ...\n"));
 	case HELP_RESILVER:
 		return (gettext("\tresilver <pool> ...\n"));
 	case HELP_TRIM:
@@ -443,6 +447,8 @@ get_usage(zpool_help_t idx)
 		    "[<device> ...]\n"));
 	case HELP_REGUID:
 		return (gettext("\treguid <pool>\n"));
+	case HELP_DDTPRUNE:
+		return (gettext("\tddtprune -d <days> <pool>\n"));
 	case HELP_SYNC:
 		return (gettext("\tsync [pool] ...\n"));
 	case HELP_VERSION:
@@ -7639,6 +7645,73 @@ zpool_do_reguid(int argc, char **argv)
 	return (ret);
 }
 
+/*
+ * zpool ddtprune -d <days> <pool>
+ *
+ *	-d <days>	Prune unique entries older than this many days.
+ *
+ * Remove old unique entries from the pool's dedup tables.
+ */
+int
+zpool_do_ddt_prune(int argc, char **argv)
+{
+	int c;
+	char *poolname, *end;
+	zpool_handle_t *zhp;
+	uint64_t days = 0;
+	boolean_t have_days = B_FALSE;
+	int ret = 0;
+
+	/* check options */
+	while ((c = getopt(argc, argv, "d:")) != -1) {
+		switch (c) {
+		case 'd':
+			errno = 0;
+			days = strtoull(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || *optarg == '\0') {
+				(void) fprintf(stderr,
+				    gettext("invalid days value '%s'\n"),
+				    optarg);
+				usage(B_FALSE);
+			}
+			have_days = B_TRUE;
+			break;
+		case '?':
+			(void) fprintf(stderr, gettext("invalid option '%c'\n"),
+			    optopt);
+			usage(B_FALSE);
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (!have_days) {
+		(void) fprintf(stderr, gettext("missing -d option\n"));
+		usage(B_FALSE);
+	}
+
+	/* get pool name and check number of arguments */
+	if (argc < 1) {
+		(void) fprintf(stderr, gettext("missing pool name\n"));
+		usage(B_FALSE);
+	}
+
+	if (argc > 1) {
+		(void) fprintf(stderr, gettext("too many arguments\n"));
+		usage(B_FALSE);
+	}
+
+	poolname = argv[0];
+	if ((zhp = zpool_open(g_zfs, poolname)) == NULL)
+		return (1);
+
+	ret = zpool_ddt_prune(zhp, days);
+
+	zpool_close(zhp);
+	return (ret);
+}
+
 
 /*
  * zpool reopen <pool>
@@ -7762,13 +7835,17 @@ zpool_do_scrub(int argc, char **argv)
 	boolean_t is_error_scrub = B_FALSE;
 	boolean_t is_pause = B_FALSE;
 	boolean_t is_stop = B_FALSE;
+	boolean_t is_txg_continue = B_FALSE;
 
 	/* check options */
-	while ((c = getopt(argc, argv, "spwe")) != -1) {
+	while ((c = getopt(argc, argv, "spweC")) != -1) {
 		switch (c) {
 		case 'e':
 			is_error_scrub = B_TRUE;
 			break;
+		case 'C':
+			is_txg_continue = B_TRUE;
+			break;
 		case 's':
 			is_stop = B_TRUE;
 			break;
@@ -7789,6 +7866,11 @@ zpool_do_scrub(int argc, char **argv)
 		(void) fprintf(stderr, gettext("invalid option "
 		    "combination :-s and -p are mutually exclusive\n"));
 		usage(B_FALSE);
+	} else if (is_txg_continue && (is_pause || is_stop ||
+	    is_error_scrub)) {
+		(void) fprintf(stderr, gettext("invalid option "
+		    "combination: -C cannot be used with -e, -p or -s\n"));
+		usage(B_FALSE);
 	} else {
 		if (is_error_scrub)
 			cb.cb_type = POOL_SCAN_ERRORSCRUB;
@@ -7797,6 +7879,8 @@ zpool_do_scrub(int argc, char **argv)
 			cb.cb_scrub_cmd = POOL_SCRUB_PAUSE;
 		} else if (is_stop) {
 			cb.cb_type = POOL_SCAN_NONE;
+		} else if (is_txg_continue) {
+			cb.cb_scrub_cmd = POOL_SCRUB_FROM_LAST_TXG;
 		} else {
 			cb.cb_scrub_cmd = POOL_SCRUB_NORMAL;
 		}
@@ -8556,10 +8640,20 @@ print_removal_status(zpool_handle_t *zhp, pool_removal_stat_t *prs)
 		total = prs->prs_to_copy;
 		fraction_done = (double)copied / total;
 
-		/* elapsed time for this pass */
-		elapsed = time(NULL) - prs->prs_start_time;
-		elapsed = elapsed > 0 ? elapsed : 1;
-		rate = copied / elapsed;
+		/*
+		 * Use the rate since the removal was last restarted, if the
+		 * kernel reports it, so time spent exported or suspended
+		 * does not count.
+		 */
+		if (prs->prs_pass_start != 0) {
+			elapsed = time(NULL) - prs->prs_pass_start;
+			elapsed = elapsed > 0 ? elapsed : 1;
+			rate = prs->prs_pass_copied / elapsed;
+		} else {
+			elapsed = time(NULL) - prs->prs_start_time;
+			elapsed = elapsed > 0 ? elapsed : 1;
+			rate = copied / elapsed;
+		}
 		rate = rate > 0 ? rate : 1;
 		mins_left = ((total - copied) / rate) / 60;
 		hours_left = mins_left / 60;
@@ -9265,9 +9359,15 @@ status_callback(zpool_handle_t *zhp, void *data)
 
 		print_scan_status(zhp, nvroot);
 
-		pool_removal_stat_t *prs = NULL;
+		pool_removal_stat_t *prs = NULL, prs_old;
 		(void) nvlist_lookup_uint64_array(nvroot,
 		    ZPOOL_CONFIG_REMOVAL_STATS, (uint64_t **)&prs, &c);
+		if (prs != NULL && c < sizeof (*prs) / sizeof (uint64_t)) {
+			/* older kernel modules lack the pass statistics */
+			memset(&prs_old, 0, sizeof (prs_old));
+			memcpy(&prs_old, prs, c * sizeof (uint64_t));
+			prs = &prs_old;
+		}
 		print_removal_status(zhp, prs);
 
 		pool_checkpoint_stat_t *pcs = NULL;
@@ -9,6 +9,8 @@
  *   --no-histograms, -n   don't print histogram data (reduces cardinality
  *                         if you don't care about histograms)
  *   --sum-histogram-buckets, -s sum histogram bucket values
+ *   --kstats, -k          also print the ARC, dbuf, zfetch, ZIL, DDT, BRT,
+ *                         txg, taskq and per-dataset kstats
  *
  * To integrate into telegraf use one of:
  * 1. the `inputs.execd` plugin with the `--execd` option
@@ -70,8 +72,16 @@
 #include <getopt.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <inttypes.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __FreeBSD__
+#include <sys/sysctl.h>
+#endif
 #include <libzfs.h>
+#include <libzfs_core.h>
 
 #define	POOL_MEASUREMENT	"zpool_stats"
 #define	SCAN_MEASUREMENT	"zpool_scan_stats"
@@ -81,11 +91,17 @@
 #define	MIN_LAT_INDEX	10  /* minimum latency index 10 = 1024ns */
 #define	POOL_IO_SIZE_MEASUREMENT	"zpool_io_size"
 #define	MIN_SIZE_INDEX	9  /* minimum size index 9 = 512 bytes */
+#define	KSTAT_MEASUREMENT_PREFIX	"zfs_"
+#define	DATASET_MEASUREMENT	"zfs_dataset"
+#define	TXG_MEASUREMENT	"zpool_txg"
+#define	TASKQ_MEASUREMENT	"zfs_taskq"
+#define	TASKQ_LATENCY_MEASUREMENT	"zfs_taskq_latency"
 
 /* global options */
 int execd_mode = 0;
 int no_histograms = 0;
 int sum_histogram_buckets = 0;
+int kstats_mode = 0;
 char metric_data_type = 'u';
 uint64_t metric_value_mask = UINT64_MAX;
 uint64_t timestamp = 0;
@@ -137,6 +153,21 @@ print_kv(const char *key, uint64_t value)
 	    (u_longlong_t)value & metric_value_mask, metric_data_type);
 }
 
+/*
+ * all lines of a sample share the timestamp taken here
+ */
+static void
+update_timestamp(void)
+{
+	struct timespec tv;
+
+	if (clock_gettime(CLOCK_REALTIME, &tv) != 0)
+		timestamp = (uint64_t)time(NULL) * 1000000000;
+	else
+		timestamp =
+		    ((uint64_t)tv.tv_sec * 1000000000) + (uint64_t)tv.tv_nsec;
+}
+
 /*
  * print_scan_status() prints the details as often seen in the "zpool status"
  * output. However, unlike the zpool command, which is intended for humans,
@@ -696,6 +727,668 @@ print_recursive_stats(stat_printer_f func, nvlist_t *nvroot,
 	return (0);
 }
 
+/*
+ * Kernel kstats, printed with --kstats.  Each kstat is pulled into
+ * kstat_buf with as few reads as its size allows and parsed in place, so
+ * a sample costs a handful of system calls per kstat rather than the
+ * process start-up and text parsing of the Python tools.
+ */
+typedef enum {
+	KF_SIGNED,
+	KF_UNSIGNED,
+	KF_STRING
+} kstat_field_type_t;
+
+/* Offsets into kstat_buf, which may move as it grows */
+typedef struct kstat_field {
+	size_t			kf_name;
+	size_t			kf_value;
+	kstat_field_type_t	kf_type;
+} kstat_field_t;
+
+#define	KSTAT_MAX_FIELDS	1024
+#define	KSTAT_READ_SIZE		(64 * 1024)
+#define	TXG_MAX_COLS		32
+#define	TASKQ_MAX_BUCKETS	64
+
+static const char *const global_kstats[] = {
+	"arcstats", "dbufstats", "dnodestats", "zfetchstats", "zil",
+	"dmu_tx", "ddt_cache", "brtstats", "abdstats", NULL
+};
+
+static char *kstat_buf = NULL;
+static size_t kstat_bufsize = 0;
+static size_t kstat_buflen = 0;
+static kstat_field_t kstat_fields[KSTAT_MAX_FIELDS];
+
+#define	KF_NAME(kf)	(kstat_buf + (kf)->kf_name)
+#define	KF_VALUE(kf)	(kstat_buf + (kf)->kf_value)
+
+/*
+ * make room for len more bytes, plus a terminating NUL, at the end of
+ * kstat_buf and return a pointer to it
+ */
+static char *
+kstat_buf_reserve(size_t len)
+{
+	if (kstat_buflen + len + 1 > kstat_bufsize) {
+		size_t size = MAX(kstat_bufsize * 2, KSTAT_READ_SIZE);
+
+		while (kstat_buflen + len + 1 > size)
+			size *= 2;
+		kstat_buf = realloc(kstat_buf, size);
+		if (kstat_buf == NULL) {
+			fprintf(stderr, "error: cannot allocate memory\n");
+			exit(1);
+		}
+		kstat_bufsize = size;
+	}
+	return (kstat_buf + kstat_buflen);
+}
+
+#ifdef __FreeBSD__
+/*
+ * FreeBSD exports every named kstat entry as a sysctl below
+ * kstat.<module>.<class>.<name>, walk them with the sysctl "next" query
+ */
+static int
+load_named_kstat(const char *module, const char *class, const char *name)
+{
+	char oidname[ZFS_MAX_DATASET_NAME_LEN * 2], *p;
+	char leaf[ZFS_MAX_DATASET_NAME_LEN * 2];
+	int base[CTL_MAXNAME], qoid[CTL_MAXNAME + 2], next[CTL_MAXNAME];
+	size_t baselen = CTL_MAXNAME, len, nextlen, size;
+	u_int fmt[64];
+	int n = 0;
+
+	(void) snprintf(oidname, sizeof (oidname), "kstat.%s.%s.%s",
+	    module, class, name);
+	for (p = oidname; *p != '\0'; p++)
+		if (*p == '/')
+			*p = '.';
+	if (sysctlnametomib(oidname, base, &baselen) != 0)
+		return (-1);
+
+	kstat_buflen = 0;
+	memcpy(qoid + 2, base, baselen * sizeof (int));
+	len = baselen;
+	while (n < KSTAT_MAX_FIELDS) {
+		union {
+			int32_t		i32;
+			uint32_t	u32;
+			int64_t		i64;
+			uint64_t	u64;
+		} val;
+		kstat_field_t *kf = &kstat_fields[n];
+
+		qoid[0] = 0;
+		qoid[1] = 2;	/* next oid */
+		nextlen = sizeof (next);
+		if (sysctl(qoid, len + 2, next, &nextlen, NULL, 0) != 0)
+			break;
+		nextlen /= sizeof (int);
+		if (nextlen <= baselen ||
+		    memcmp(next, base, baselen * sizeof (int)) != 0)
+			break;
+		memcpy(qoid + 2, next, nextlen * sizeof (int));
+		len = nextlen;
+
+		qoid[1] = 4;	/* oid format */
+		size = sizeof (fmt);
+		if (sysctl(qoid, len + 2, fmt, &size, NULL, 0) != 0)
+			continue;
+		qoid[1] = 1;	/* oid name */
+		size = sizeof (leaf);
+		if (sysctl(qoid, len + 2, leaf, &size, NULL, 0) != 0)
+			continue;
+		p = strrchr(leaf, '.');
+		p = (p == NULL) ? leaf : p + 1;
+
+		kf->kf_name = kstat_buflen;
+		size = strlen(p) + 1;
+		memcpy(kstat_buf_reserve(size), p, size);
+		kstat_buflen += size;
+		kf->kf_value = kstat_buflen;
+
+		if ((fmt[0] & CTLTYPE) == CTLTYPE_STRING) {
+			size = 0;
+			if (sysctl(qoid + 2, len, NULL, &size, NULL, 0) != 0)
+				goto skip;
+			p = kstat_buf_reserve(size);
+			if (sysctl(qoid + 2, len, p, &size, NULL, 0) != 0)
+				goto skip;
+			p[size] = '\0';
+			kstat_buflen += strlen(p) + 1;
+			kf->kf_type = KF_STRING;
+			n++;
+			continue;
+		}
+
+		size = sizeof (val);
+		if (sysctl(qoid + 2, len, &val, &size, NULL, 0) != 0)
+			goto skip;
+		p = kstat_buf_reserve(24);
+		switch (fmt[0] & CTLTYPE) {
+		case CTLTYPE_S32:
+			(void) sprintf(p, "%d", val.i32);
+			kf->kf_type = KF_SIGNED;
+			break;
+		case CTLTYPE_U32:
+			(void) sprintf(p, "%u", val.u32);
+			kf->kf_type = KF_UNSIGNED;
+			break;
+		case CTLTYPE_S64:
+			(void) sprintf(p, "%lld", (longlong_t)val.i64);
+			kf->kf_type = KF_SIGNED;
+			break;
+		case CTLTYPE_U64:
+			(void) sprintf(p, "%llu", (u_longlong_t)val.u64);
+			kf->kf_type = KF_UNSIGNED;
+			break;
+		default:
+			goto skip;
+		}
+		kstat_buflen += strlen(p) + 1;
+		n++;
+		continue;
+skip:
+		kstat_buflen = kf->kf_name;
+	}
+	return (n);
+}
+
+/*
+ * raw kstats are a single string sysctl holding the same text as on Linux
+ */
+static int
+load_raw_kstat(const char *module, const char *name)
+{
+	char oidname[ZFS_MAX_DATASET_NAME_LEN * 2], *p;
+	size_t size = 0;
+
+	(void) snprintf(oidname, sizeof (oidname), "kstat.%s.%s",
+	    module, name);
+	for (p = oidname; *p != '\0'; p++)
+		if (*p == '/')
+			*p = '.';
+
+	kstat_buflen = 0;
+	if (sysctlbyname(oidname, NULL, &size, NULL, 0) != 0)
+		return (-1);
+	/* leave some slack for entries added in the meantime */
+	size += size / 4;
+	p = kstat_buf_reserve(size);
+	if (sysctlbyname(oidname, p, &size, NULL, 0) != 0)
+		return (-1);
+	p[size] = '\0';
+	return (0);
+}
+
+/*
+ * call func() for each objset-0x... node below kstat.zfs.<pool>.dataset
+ */
+static void
+iter_objset_kstats(const char *pool, const char *pool_name,
+    void (*func)(const char *, const char *, const char *))
+{
+	char oidname[ZFS_MAX_DATASET_NAME_LEN * 2], objset[64], *p;
+	int base[CTL_MAXNAME], qoid[CTL_MAXNAME + 2], next[CTL_MAXNAME];
+	size_t baselen = CTL_MAXNAME, len, nextlen, size, prefixlen;
+
+	prefixlen = snprintf(oidname, sizeof (oidname), "kstat.zfs.%s.dataset",
+	    pool);
+	if (sysctlnametomib(oidname, base, &baselen) != 0)
+		return;
+
+	objset[0] = '\0';
+	memcpy(qoid + 2, base, baselen * sizeof (int));
+	len = baselen;
+	for (;;) {
+		qoid[0] = 0;
+		qoid[1] = 2;	/* next oid */
+		nextlen = sizeof (next);
+		if (sysctl(qoid, len + 2, next, &nextlen, NULL, 0) != 0)
+			break;
+		nextlen /= sizeof (int);
+		if (nextlen <= baselen ||
+		    memcmp(next, base, baselen * sizeof (int)) != 0)
+			break;
+		memcpy(qoid + 2, next, nextlen * sizeof (int));
+		len = nextlen;
+
+		qoid[1] = 1;	/* oid name */
+		size = sizeof (oidname);
+		if (sysctl(qoid, len + 2, oidname, &size, NULL, 0) != 0 ||
+		    strlen(oidname) <= prefixlen + 1)
+			continue;
+		p = oidname + prefixlen + 1;
+		p[strcspn(p, ".")] = '\0';
+		if (strcmp(p, objset) == 0)
+			continue;
+		(void) strlcpy(objset, p, sizeof (objset));
+		func(pool, objset, pool_name);
+	}
+}
+#else
+static int
+read_kstat_file(const char *path)
+{
+	ssize_t n;
+	int fd;
+
+	kstat_buflen = 0;
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return (-1);
+	do {
+		n = read(fd, kstat_buf_reserve(KSTAT_READ_SIZE),
+		    KSTAT_READ_SIZE);
+		if (n > 0)
+			kstat_buflen += n;
+	} while (n > 0);
+	(void) close(fd);
+	if (n < 0)
+		return (-1);
+	*kstat_buf_reserve(0) = '\0';
+	return (0);
+}
+
+/*
+ * /proc/spl/kstat/<module>/<name> holds the kstat header, the column
+ * header, then one "name type value" line per entry
+ */
+static int
+load_named_kstat(const char *module, const char *class, const char *name)
+{
+	char path[MAXPATHLEN], *line, *next, *type, *value;
+	int n = 0, lineno = 0;
+
+	(void) class;
+	(void) snprintf(path, sizeof (path), "/proc/spl/kstat/%s/%s",
+	    module, name);
+	if (read_kstat_file(path) != 0)
+		return (-1);
+
+	next = kstat_buf;
+	while ((line = strsep(&next, "\n")) != NULL &&
+	    n < KSTAT_MAX_FIELDS) {
+		kstat_field_t *kf = &kstat_fields[n];
+
+		if (lineno++ < 2)
+			continue;
+		line += strspn(line, " ");
+		type = line + strcspn(line, " ");
+		if (*type == '\0')
+			continue;
+		*type++ = '\0';
+		type += strspn(type, " ");
+		value = type + strcspn(type, " ");
+		if (*value == '\0')
+			continue;
+		*value++ = '\0';
+		value += strspn(value, " ");
+
+		/* the SPL's KSTAT_DATA_* values */
+		switch (atoi(type)) {
+		case 1: case 3: case 5:
+			kf->kf_type = KF_SIGNED;
+			break;
+		case 2: case 4: case 6:
+			kf->kf_type = KF_UNSIGNED;
+			break;
+		case 7:
+			kf->kf_type = KF_STRING;
+			break;
+		default:
+			continue;
+		}
+		kf->kf_name = line - kstat_buf;
+		kf->kf_value = value - kstat_buf;
+		n++;
+	}
+	return (n);
+}
+
+static int
+load_raw_kstat(const char *module, const char *name)
+{
+	char path[MAXPATHLEN];
+
+	(void) snprintf(path, sizeof (path), "/proc/spl/kstat/%s/%s",
+	    module, name);
+	return (read_kstat_file(path));
+}
+
+static void
+iter_objset_kstats(const char *pool, const char *pool_name,
+    void (*func)(const char *, const char *, const char *))
+{
+	char path[MAXPATHLEN];
+	struct dirent *de;
+	DIR *dir;
+
+	(void) snprintf(path, sizeof (path), "/proc/spl/kstat/zfs/%s", pool);
+	if ((dir = opendir(path)) == NULL)
+		return;
+	while ((de = readdir(dir)) != NULL) {
+		if (strncmp(de->d_name, "objset-", 7) == 0)
+			func(pool, de->d_name, pool_name);
+	}
+	(void) closedir(dir);
+}
+
+/*
+ * /proc/spl/taskq-stats has one line per taskq, followed by its wait and
+ * run time histograms once it has run any tasks
+ */
+static void
+print_taskq_latency(const char *taskq, const uint64_t *wait,
+    const uint64_t *run, int buckets)
+{
+	uint64_t wsum = 0, rsum = 0;
+
+	for (int b = 0; b < buckets; b++) {
+		if (sum_histogram_buckets) {
+			wsum += wait[b];
+			rsum += run[b];
+		} else {
+			wsum = wait[b];
+			rsum = run[b];
+		}
+		printf("%s%s,le=%0.6f,taskq=%s ", TASKQ_LATENCY_MEASUREMENT,
+		    tags, (float)(1024ULL << b) * 1e-9, taskq);
+		print_kv("wait", wsum);
+		printf(",");
+		print_kv("run", rsum);
+		printf(" %llu\n", (u_longlong_t)timestamp);
+	}
+}
+
+static void
+print_taskq_stats(void)
+{
+	uint64_t wait[TASKQ_MAX_BUCKETS], run[TASKQ_MAX_BUCKETS];
+	char *line, *next, *taskq = NULL, *f[6];
+	int i, lineno = 0, buckets = 0;
+
+	if (read_kstat_file("/proc/spl/taskq-stats") != 0)
+		return;
+
+	next = kstat_buf;
+	while ((line = strsep(&next, "\n")) != NULL) {
+		if (lineno++ < 2 || *line == '\0')
+			continue;
+
+		if (*line == '\t') {
+			uint64_t *hist;
+			char *v, *end;
+			int b;
+
+			line++;
+			if (strncmp(line, "wait:", 5) == 0)
+				hist = wait;
+			else if (strncmp(line, "run:", 4) == 0)
+				hist = run;
+			else
+				continue;
+			v = strchr(line, ':') + 1;
+			for (b = 0; b < TASKQ_MAX_BUCKETS; b++, v = end) {
+				hist[b] = strtoull(v, &end, 10);
+				if (end == v)
+					break;
+			}
+			buckets = MAX(buckets, b);
+			continue;
+		}
+
+		if (taskq != NULL && !no_histograms)
+			print_taskq_latency(taskq, wait, run, buckets);
+		memset(wait, 0, sizeof (wait));
+		memset(run, 0, sizeof (run));
+		buckets = 0;
+		taskq = NULL;
+
+		for (i = 0; i < 6 && line != NULL; i++) {
+			line += strspn(line, " ");
+			if (*line == '\0')
+				break;
+			f[i] = strsep(&line, " ");
+		}
+		if (i < 6)
+			continue;
+		taskq = f[0];
+		printf("%s%s,taskq=%s ", TASKQ_MEASUREMENT, tags, taskq);
+		print_kv("tasks", strtoull(f[1], NULL, 10));
+		printf(",");
+		print_kv("threads", strtoull(f[2], NULL, 10));
+		printf(",");
+		print_kv("busy_ms", strtoull(f[3], NULL, 10));
+		printf(",");
+		print_kv("thread_ms", strtoull(f[4], NULL, 10));
+		printf(" %llu\n", (u_longlong_t)timestamp);
+	}
+	if (taskq != NULL && !no_histograms)
+		print_taskq_latency(taskq, wait, run, buckets);
+}
+#endif
+
+static const char *
+find_kstat_string(int n, const char *name)
+{
+	for (int i = 0; i < n; i++) {
+		if (kstat_fields[i].kf_type == KF_STRING &&
+		    strcmp(KF_NAME(&kstat_fields[i]), name) == 0)
+			return (KF_VALUE(&kstat_fields[i]));
+	}
+	return (NULL);
+}
+
+/*
+ * print the numeric entries of the last loaded named kstat as one line
+ */
+static void
+print_kstat_fields(const char *measurement, const char *tagset, int n)
+{
+	int printed = 0;
+
+	for (int i = 0; i < n; i++) {
+		kstat_field_t *kf = &kstat_fields[i];
+
+		if (kf->kf_type == KF_STRING)
+			continue;
+		if (printed++ == 0)
+			printf("%s%s%s ", measurement, tags, tagset);
+		else
+			printf(",");
+		if (kf->kf_type == KF_SIGNED)
+			printf("%s=%lldi", KF_NAME(kf),
+			    strtoll(KF_VALUE(kf), NULL, 10));
+		else
+			print_kv(KF_NAME(kf), strtoull(KF_VALUE(kf), NULL, 10));
+	}
+	if (printed != 0)
+		printf(" %llu\n", (u_longlong_t)timestamp);
+}
+
+static void
+print_dataset_kstat(const char *pool, const char *objset,
+    const char *pool_name)
+{
+	char module[ZFS_MAX_DATASET_NAME_LEN + 8];
+	char tagset[ZFS_MAX_DATASET_NAME_LEN * 4 + 32];
+	const char *dataset;
+	char *dataset_name;
+	int n;
+
+	(void) snprintf(module, sizeof (module), "zfs/%s", pool);
+	if ((n = load_named_kstat(module, "dataset", objset)) <= 0)
+		return;
+	if ((dataset = find_kstat_string(n, "dataset_name")) == NULL)
+		return;
+
+	dataset_name = escape_string(dataset);
+	(void) snprintf(tagset, sizeof (tagset), ",dataset=%s,name=%s",
+	    dataset_name, pool_name);
+	print_kstat_fields(DATASET_MEASUREMENT, tagset, n);
+	free(dataset_name);
+}
+
+/*
+ * The txgs kstat lists the most recent txgs, oldest first.  Print the
+ * newest committed one, whose open, quiesce, wait and sync times and
+ * spa_sync() phase times are all final.
+ */
+static void
+print_txg_kstat(const char *pool, const char *pool_name)
+{
+	char module[ZFS_MAX_DATASET_NAME_LEN + 8];
+	char *cols[TXG_MAX_COLS], *row[TXG_MAX_COLS], *last[TXG_MAX_COLS];
+	char *line, *next;
+	int ncols = 0, found = 0;
+
+	(void) snprintf(module, sizeof (module), "zfs/%s", pool);
+	if (load_raw_kstat(module, "txgs") != 0)
+		return;
+
+	next = kstat_buf;
+	while ((line = strsep(&next, "\n")) != NULL) {
+		char **v = (ncols == 0) ? cols : row;
+		int i = 0;
+
+		while (i < TXG_MAX_COLS && line != NULL) {
+			line += strspn(line, " ");
+			if (*line == '\0')
+				break;
+			v[i++] = strsep(&line, " ");
+		}
+		if (ncols == 0) {
+			/* skip anything ahead of the column header */
+			if (i > 3 && strcmp(cols[0], "txg") == 0)
+				ncols = i;
+		} else if (i == ncols && strcmp(row[2], "C") == 0) {
+			memcpy(last, row, sizeof (row));
+			found = 1;
+		}
+	}
+	if (!found)
+		return;
+
+	printf("%s%s,name=%s ", TXG_MEASUREMENT, tags, pool_name);
+	print_kv(cols[0], strtoull(last[0], NULL, 10));
+	/* skip the birth time and state */
+	for (int i = 3; i < ncols; i++) {
+		printf(",");
+		print_kv(cols[i], strtoull(last[i], NULL, 10));
+	}
+	printf(" %llu\n", (u_longlong_t)timestamp);
+}
+
+/*
+ * fetch all objset kstats of the pool with one ZFS_IOC_KSTATS call, fails
+ * if the kernel predates it
+ */
+static int
+print_dataset_kstats_ioctl(const char *pool, const char *pool_name)
+{
+	char module[ZFS_MAX_DATASET_NAME_LEN + 8];
+	nvlist_t *out, *kstats;
+	nvpair_t *ks = NULL;
+	uint64_t version;
+
+	(void) snprintf(module, sizeof (module), "zfs/%s", pool);
+	if (lzc_kstats(module, "dataset", &out) != 0)
+		return (-1);
+	if (nvlist_lookup_uint64(out, KSTATS_VERSION, &version) != 0 ||
+	    version != ZFS_KSTATS_VERSION ||
+	    nvlist_lookup_nvlist(out, KSTATS_KSTATS, &kstats) != 0) {
+		nvlist_free(out);
+		return (-1);
+	}
+
+	while ((ks = nvlist_next_nvpair(kstats, ks)) != NULL) {
+		nvlist_t *nvl = fnvpair_value_nvlist(ks);
+		nvpair_t *elem = NULL;
+		const char *dataset;
+		char *dataset_name;
+		int printed = 0;
+
+		if (nvlist_lookup_string(nvl, "dataset_name", &dataset) != 0)
+			continue;
+		dataset_name = escape_string(dataset);
+		while ((elem = nvlist_next_nvpair(nvl, elem)) != NULL) {
+			uint64_t u;
+			int64_t i;
+
+			switch (nvpair_type(elem)) {
+			case DATA_TYPE_UINT32:
+				u = fnvpair_value_uint32(elem);
+				break;
+			case DATA_TYPE_UINT64:
+				u = fnvpair_value_uint64(elem);
+				break;
+			case DATA_TYPE_INT32:
+				i = fnvpair_value_int32(elem);
+				break;
+			case DATA_TYPE_INT64:
+				i = fnvpair_value_int64(elem);
+				break;
+			default:
+				continue;
+			}
+			if (printed++ == 0) {
+				printf("%s%s,dataset=%s,name=%s ",
+				    DATASET_MEASUREMENT, tags, dataset_name,
+				    pool_name);
+			} else {
+				printf(",");
+			}
+			switch (nvpair_type(elem)) {
+			case DATA_TYPE_UINT32:
+			case DATA_TYPE_UINT64:
+				print_kv(nvpair_name(elem), u);
+				break;
+			default:
+				printf("%s=%lldi", nvpair_name(elem),
+				    (longlong_t)i);
+				break;
+			}
+		}
+		if (printed != 0)
+			printf(" %llu\n", (u_longlong_t)timestamp);
+		free(dataset_name);
+	}
+
+	nvlist_free(out);
+	return (0);
+}
+
+static void
+print_pool_kstats(const char *pool, const char *pool_name)
+{
+	print_txg_kstat(pool, pool_name);
+	if (print_dataset_kstats_ioctl(pool, pool_name) != 0)
+		iter_objset_kstats(pool, pool_name, print_dataset_kstat);
+}
+
+static void
+print_global_kstats(void)
+{
+	char measurement[64];
+	int n;
+
+	update_timestamp();
+	for (int i = 0; global_kstats[i] != NULL; i++) {
+		n = load_named_kstat("zfs", "misc", global_kstats[i]);
+		if (n <= 0)
+			continue;
+		(void) snprintf(measurement, sizeof (measurement), "%s%s",
+		    KSTAT_MEASUREMENT_PREFIX, global_kstats[i]);
+		print_kstat_fields(measurement, "", n);
+	}
+#ifndef __FreeBSD__
+	print_taskq_stats();
+#endif
+}
+
 /*
  * call-back to print the stats from the pool config
  *
@@ -710,7 +1403,6 @@ print_stats(zpool_handle_t *zhp, void *data)
 	boolean_t missing;
 	nvlist_t *config, *nvroot;
 	vdev_stat_t *vs;
-	struct timespec tv;
 	char *pool_name;
 
 	/* if not this pool return quickly */
@@ -726,11 +1418,7 @@ print_stats(zpool_handle_t *zhp, void *data)
 	}
 
 	config = zpool_get_config(zhp, NULL);
-	if (clock_gettime(CLOCK_REALTIME, &tv) != 0)
-		timestamp = (uint64_t)time(NULL) * 1000000000;
-	else
-		timestamp =
-		    ((uint64_t)tv.tv_sec * 1000000000) + (uint64_t)tv.tv_nsec;
+	update_timestamp();
 
 	if (nvlist_lookup_nvlist(
 	    config, ZPOOL_CONFIG_VDEV_TREE, &nvroot) != 0) {
@@ -763,6 +1451,8 @@ print_stats(zpool_handle_t *zhp, void *data)
 	}
 	if (err == 0)
 		err = print_scan_status(nvroot, pool_name);
+	if (err == 0 && kstats_mode)
+		print_pool_kstats(zpool_get_name(zhp), pool_name);
 
 	free(pool_name);
 	zpool_close(zhp);
@@ -773,7 +1463,8 @@ static void
 usage(char *name)
 {
 	fprintf(stderr, "usage: %s [--execd][--no-histograms]"
-	    "[--sum-histogram-buckets] [--signed-int] [poolname]\n", name);
+	    "[--sum-histogram-buckets] [--signed-int] [--kstats] [poolname]\n",
+	    name);
 	exit(EXIT_FAILURE);
 }
 
@@ -787,6 +1478,7 @@ main(int argc, char *argv[])
 	struct option long_options[] = {
 	    {"execd", no_argument, NULL, 'e'},
 	    {"help", no_argument, NULL, 'h'},
+	    {"kstats", no_argument, NULL, 'k'},
 	    {"no-histograms", no_argument, NULL, 'n'},
 	    {"signed-int", no_argument, NULL, 'i'},
 	    {"sum-histogram-buckets", no_argument, NULL, 's'},
@@ -794,11 +1486,14 @@ main(int argc, char *argv[])
 	    {0, 0, 0, 0}
 	};
 	while ((opt = getopt_long(
-	    argc, argv, "ehinst:", long_options, NULL)) != -1) {
+	    argc, argv, "ehiknst:", long_options, NULL)) != -1) {
 		switch (opt) {
 		case 'e':
 			execd_mode = 1;
 			break;
+		case 'k':
+			kstats_mode = 1;
+			break;
 		case 'i':
 			metric_data_type = 'i';
 			metric_value_mask = INT64_MAX;
@@ -835,10 +1530,14 @@ main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 	if (execd_mode == 0) {
+		if (kstats_mode)
+			print_global_kstats();
 		ret = zpool_iter(g_zfs, print_stats, argv[optind]);
 		return (ret);
 	}
 	while (getline(&line, &len, stdin) != -1) {
+		if (kstats_mode)
+			print_global_kstats();
 		ret = zpool_iter(g_zfs, print_stats, argv[optind]);
 		fflush(stdout);
 	}
@@ -42,11 +42,12 @@ zstream_usage(void)
 	    "\n"
 	    "\tzstream decompress [-v] [OBJECT,OFFSET[,TYPE]] ...\n"
 	    "\n"
-	    "\tzstream recompress [ -l level] TYPE\n"
+	    "\tzstream recompress [-j threads] [-l level] TYPE\n"
 	    "\n"
 	    "\tzstream token resume_token\n"
 	    "\n"
-	    "\tzstream redup [-v] FILE | ...\n");
+	    "\tzstream redup [-Dv] [-d TMPDIR] FILE | ...\n"
+	    "\t... | zstream redup [-Dv] [-d TMPDIR] - | ...\n");
 	exit(1);
 }
 
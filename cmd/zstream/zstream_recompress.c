@@ -29,6 +29,7 @@
  */
 
 #include <err.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -63,19 +64,188 @@ dump_record(dmu_replay_record_t *drr, void *payload, int payload_len,
 	return (0);
 }
 
+/*
+ * Records are read into a window of slots and written out from it in stream
+ * order by the main thread, so the stream checksum is still computed in
+ * order.  WRITE records which need to be recompressed are handed to a pool
+ * of worker threads while they wait in the window.
+ */
+typedef struct rc_slot {
+	dmu_replay_record_t rs_drr;
+	char		*rs_buf;	/* payload, or NULL */
+	uint64_t	rs_size;	/* of the payload */
+	boolean_t	rs_done;	/* ready to be written out */
+	struct rc_slot	*rs_next;	/* on the work queue */
+} rc_slot_t;
+
+typedef struct rc_pool {
+	pthread_mutex_t	rp_lock;
+	pthread_cond_t	rp_work_cv;	/* work queued, or exiting */
+	pthread_cond_t	rp_done_cv;	/* a slot is done */
+	rc_slot_t	*rp_head;	/* work queue */
+	rc_slot_t	*rp_tail;
+	boolean_t	rp_exit;
+	zio_compress_info_t *rp_cinfo;
+	int		rp_type;
+	int		rp_level;
+} rc_pool_t;
+
+static void
+recompress_write(rc_pool_t *rp, rc_slot_t *rs)
+{
+	struct drr_write *drrw = &rs->rs_drr.drr_u.drr_write;
+	zio_compress_info_t *cinfo = rp->rp_cinfo;
+	zio_compress_info_t *dinfo =
+	    &zio_compress_table[drrw->drr_compressiontype];
+	uint64_t lsize = drrw->drr_logical_size;
+	char *dbuf = rs->rs_buf;
+
+	/* Decompress the payload */
+	if (dinfo->ci_decompress != NULL) {
+		dbuf = safe_calloc(lsize);
+		if (0 != dinfo->ci_decompress(rs->rs_buf, dbuf, rs->rs_size,
+		    lsize, dinfo->ci_level)) {
+			warnx("decompression type %d failed "
+			    "for ino %llu offset %llu",
+			    drrw->drr_compressiontype,
+			    (u_longlong_t)drrw->drr_object,
+			    (u_longlong_t)drrw->drr_offset);
+			exit(4);
+		}
+		free(rs->rs_buf);
+		rs->rs_buf = dbuf;
+		rs->rs_size = lsize;
+	}
+
+	/* Recompress the payload */
+	if (cinfo->ci_compress != NULL) {
+		char *cbuf = safe_calloc(lsize);
+		uint64_t csize = P2ROUNDUP(cinfo->ci_compress(dbuf, cbuf,
+		    lsize, lsize, (rp->rp_level == -1 ?
+		    cinfo->ci_level : rp->rp_level)), SPA_MINBLOCKSIZE);
+		if (csize != lsize) {
+			drrw->drr_compressiontype = rp->rp_type;
+			drrw->drr_compressed_size = csize;
+			free(dbuf);
+			rs->rs_buf = cbuf;
+			rs->rs_size = csize;
+		} else {
+			free(cbuf);
+			drrw->drr_compressiontype = 0;
+			drrw->drr_compressed_size = 0;
+		}
+	} else {
+		drrw->drr_compressiontype = rp->rp_type;
+		drrw->drr_compressed_size = 0;
+	}
+}
+
+static void *
+recompress_worker(void *arg)
+{
+	rc_pool_t *rp = arg;
+
+	pthread_mutex_lock(&rp->rp_lock);
+	for (;;) {
+		while (rp->rp_head == NULL && !rp->rp_exit)
+			pthread_cond_wait(&rp->rp_work_cv, &rp->rp_lock);
+		rc_slot_t *rs = rp->rp_head;
+		if (rs == NULL)
+			break;
+		rp->rp_head = rs->rs_next;
+		if (rp->rp_head == NULL)
+			rp->rp_tail = NULL;
+		pthread_mutex_unlock(&rp->rp_lock);
+
+		recompress_write(rp, rs);
+
+		pthread_mutex_lock(&rp->rp_lock);
+		rs->rs_done = B_TRUE;
+		pthread_cond_broadcast(&rp->rp_done_cv);
+	}
+	pthread_mutex_unlock(&rp->rp_lock);
+	return (NULL);
+}
+
+static void
+recompress_dispatch(rc_pool_t *rp, rc_slot_t *rs)
+{
+	pthread_mutex_lock(&rp->rp_lock);
+	rs->rs_next = NULL;
+	if (rp->rp_tail != NULL)
+		rp->rp_tail->rs_next = rs;
+	else
+		rp->rp_head = rs;
+	rp->rp_tail = rs;
+	pthread_cond_signal(&rp->rp_work_cv);
+	pthread_mutex_unlock(&rp->rp_lock);
+}
+
+/*
+ * Write out the oldest slot once its record is done, fixing up the stream
+ * checksum on the way.
+ */
+static int
+recompress_emit(rc_pool_t *rp, rc_slot_t *rs, zio_cksum_t *stream_cksum)
+{
+	dmu_replay_record_t *drr = &rs->rs_drr;
+	int err;
+
+	pthread_mutex_lock(&rp->rp_lock);
+	while (!rs->rs_done)
+		pthread_cond_wait(&rp->rp_done_cv, &rp->rp_lock);
+	pthread_mutex_unlock(&rp->rp_lock);
+
+	if (drr->drr_type == DRR_BEGIN) {
+		ZIO_SET_CHECKSUM(stream_cksum, 0, 0, 0, 0);
+	} else if (drr->drr_type == DRR_END) {
+		struct drr_end *drre = &drr->drr_u.drr_end;
+		/*
+		 * Use the recalculated checksum, unless this is
+		 * the END record of a stream package, which has
+		 * no checksum.
+		 */
+		if (!ZIO_CHECKSUM_IS_ZERO(&drre->drr_checksum))
+			drre->drr_checksum = *stream_cksum;
+	}
+
+	err = dump_record(drr, rs->rs_buf, rs->rs_size, stream_cksum,
+	    STDOUT_FILENO);
+	if (drr->drr_type == DRR_END) {
+		/*
+		 * Typically the END record is either the last
+		 * thing in the stream, or it is followed
+		 * by a BEGIN record (which also zeros the checksum).
+		 * However, a stream package ends with two END
+		 * records.  The last END record's checksum starts
+		 * from zero.
+		 */
+		ZIO_SET_CHECKSUM(stream_cksum, 0, 0, 0, 0);
+	}
+	free(rs->rs_buf);
+	rs->rs_buf = NULL;
+	return (err);
+}
+
 int
 zstream_do_recompress(int argc, char *argv[])
 {
-	int bufsz = SPA_MAXBLOCKSIZE;
-	char *buf = safe_malloc(bufsz);
-	dmu_replay_record_t thedrr;
-	dmu_replay_record_t *drr = &thedrr;
 	zio_cksum_t stream_cksum;
 	int c;
 	int level = -1;
+	long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
 
-	while ((c = getopt(argc, argv, "l:")) != -1) {
+	while ((c = getopt(argc, argv, "j:l:")) != -1) {
 		switch (c) {
+		case 'j':
+			if (sscanf(optarg, "%ld", &nthreads) != 1 ||
+			    nthreads < 1) {
+				fprintf(stderr,
+				    "failed to parse thread count '%s'\n",
+				    optarg);
+				zstream_usage();
+			}
+			break;
 		case 'l':
 			if (sscanf(optarg, "%d", &level) != 1) {
 				fprintf(stderr,
@@ -97,6 +267,8 @@ zstream_do_recompress(int argc, char *argv[])
 
 	if (argc != 1)
 		zstream_usage();
+	if (nthreads < 1)
+		nthreads = 1;
 	int type = 0;
 	zio_compress_info_t *cinfo = NULL;
 	if (0 == strcmp(argv[0], "off")) {
@@ -138,11 +310,48 @@ zstream_do_recompress(int argc, char *argv[])
 	fletcher_4_init();
 	zio_init();
 	zstd_init();
+
+	rc_pool_t rp = {
+		.rp_cinfo = cinfo,
+		.rp_type = type,
+		.rp_level = level,
+	};
+	pthread_mutex_init(&rp.rp_lock, NULL);
+	pthread_cond_init(&rp.rp_work_cv, NULL);
+	pthread_cond_init(&rp.rp_done_cv, NULL);
+	pthread_t *threads = safe_calloc(nthreads * sizeof (pthread_t));
+	for (long i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, recompress_worker,
+		    &rp) != 0)
+			err(1, "pthread_create");
+	}
+
+	/* Enough slots to keep every worker busy while we wait on one. */
+	uint64_t window = 4 * nthreads;
+	rc_slot_t *slots = safe_calloc(window * sizeof (rc_slot_t));
+	uint64_t head = 0, tail = 0;
+	int error = 0;
+
+	ZIO_SET_CHECKSUM(&stream_cksum, 0, 0, 0, 0);
 	int begin = 0;
 	boolean_t seen = B_FALSE;
-	while (sfread(drr, sizeof (*drr), stdin) != 0) {
+	for (;;) {
+		if (tail - head == window) {
+			error = recompress_emit(&rp, &slots[head++ % window],
+			    &stream_cksum);
+			if (error != 0)
+				break;
+		}
+
+		rc_slot_t *rs = &slots[tail % window];
+		dmu_replay_record_t *drr = &rs->rs_drr;
+		if (sfread(drr, sizeof (*drr), stdin) == 0)
+			break;
+		tail++;
+
 		struct drr_write *drrw;
 		uint64_t payload_size = 0;
+		boolean_t recompress = B_FALSE;
 
 		/*
 		 * We need to regenerate the checksum.
@@ -156,7 +365,6 @@ zstream_do_recompress(int argc, char *argv[])
 		switch (drr->drr_type) {
 		case DRR_BEGIN:
 		{
-			ZIO_SET_CHECKSUM(&stream_cksum, 0, 0, 0, 0);
 			VERIFY0(begin++);
 			seen = B_TRUE;
 
@@ -164,21 +372,11 @@ zstream_do_recompress(int argc, char *argv[])
 
 			VERIFY3U(sz, <=, 1U << 28);
 
-			if (sz != 0) {
-				if (sz > bufsz) {
-					buf = realloc(buf, sz);
-					if (buf == NULL)
-						err(1, "realloc");
-					bufsz = sz;
-				}
-				(void) sfread(buf, sz, stdin);
-			}
 			payload_size = sz;
 			break;
 		}
 		case DRR_END:
 		{
-			struct drr_end *drre = &drr->drr_u.drr_end;
 			/*
 			 * We would prefer to just check --begin == 0, but
 			 * replication streams have an end of stream END
@@ -186,13 +384,6 @@ zstream_do_recompress(int argc, char *argv[])
 			 */
 			VERIFY3B(seen, ==, B_TRUE);
 			begin--;
-			/*
-			 * Use the recalculated checksum, unless this is
-			 * the END record of a stream package, which has
-			 * no checksum.
-			 */
-			if (!ZIO_CHECKSUM_IS_ZERO(&drre->drr_checksum))
-				drre->drr_checksum = stream_cksum;
 			break;
 		}
 
@@ -201,10 +392,8 @@ zstream_do_recompress(int argc, char *argv[])
 			struct drr_object *drro = &drr->drr_u.drr_object;
 			VERIFY3S(begin, ==, 1);
 
-			if (drro->drr_bonuslen > 0) {
+			if (drro->drr_bonuslen > 0)
 				payload_size = DRR_OBJECT_PAYLOAD_SIZE(drro);
-				(void) sfread(buf, payload_size, stdin);
-			}
 			break;
 		}
 
@@ -213,7 +402,6 @@ zstream_do_recompress(int argc, char *argv[])
 			struct drr_spill *drrs = &drr->drr_u.drr_spill;
 			VERIFY3S(begin, ==, 1);
 			payload_size = DRR_SPILL_PAYLOAD_SIZE(drrs);
-			(void) sfread(buf, payload_size, stdin);
 			break;
 		}
 
@@ -227,7 +415,7 @@ zstream_do_recompress(int argc, char *argv[])
 		case DRR_WRITE:
 		{
 			VERIFY3S(begin, ==, 1);
-			drrw = &thedrr.drr_u.drr_write;
+			drrw = &drr->drr_u.drr_write;
 			payload_size = DRR_WRITE_PAYLOAD_SIZE(drrw);
 			/*
 			 * In order to recompress an encrypted block, you have
@@ -243,69 +431,15 @@ zstream_do_recompress(int argc, char *argv[])
 					break;
 				}
 			}
-			if (encrypted) {
-				(void) sfread(buf, payload_size, stdin);
+			if (encrypted)
 				break;
-			}
 			if (drrw->drr_compressiontype >=
 			    ZIO_COMPRESS_FUNCTIONS) {
 				fprintf(stderr, "Invalid compression type in "
 				    "stream: %d\n", drrw->drr_compressiontype);
 				exit(3);
 			}
-			zio_compress_info_t *dinfo =
-			    &zio_compress_table[drrw->drr_compressiontype];
-
-			/* Set up buffers to minimize memcpys */
-			char *cbuf, *dbuf;
-			if (cinfo->ci_compress == NULL)
-				dbuf = buf;
-			else
-				dbuf = safe_calloc(bufsz);
-
-			if (dinfo->ci_decompress == NULL)
-				cbuf = dbuf;
-			else
-				cbuf = safe_calloc(payload_size);
-
-			/* Read and decompress the payload */
-			(void) sfread(cbuf, payload_size, stdin);
-			if (dinfo->ci_decompress != NULL) {
-				if (0 != dinfo->ci_decompress(cbuf, dbuf,
-				    payload_size, MIN(bufsz,
-				    drrw->drr_logical_size), dinfo->ci_level)) {
-					warnx("decompression type %d failed "
-					    "for ino %llu offset %llu",
-					    type,
-					    (u_longlong_t)drrw->drr_object,
-					    (u_longlong_t)drrw->drr_offset);
-					exit(4);
-				}
-				payload_size = drrw->drr_logical_size;
-				free(cbuf);
-			}
-
-			/* Recompress the payload */
-			if (cinfo->ci_compress != NULL) {
-				payload_size = P2ROUNDUP(cinfo->ci_compress(
-				    dbuf, buf, drrw->drr_logical_size,
-				    MIN(payload_size, bufsz), (level == -1 ?
-				    cinfo->ci_level : level)),
-				    SPA_MINBLOCKSIZE);
-				if (payload_size != drrw->drr_logical_size) {
-					drrw->drr_compressiontype = type;
-					drrw->drr_compressed_size =
-					    payload_size;
-				} else {
-					memcpy(buf, dbuf, payload_size);
-					drrw->drr_compressiontype = 0;
-					drrw->drr_compressed_size = 0;
-				}
-				free(dbuf);
-			} else {
-				drrw->drr_compressiontype = type;
-				drrw->drr_compressed_size = 0;
-			}
+			recompress = B_TRUE;
 			break;
 		}
 
@@ -316,7 +450,6 @@ zstream_do_recompress(int argc, char *argv[])
 			VERIFY3S(begin, ==, 1);
 			payload_size =
 			    P2ROUNDUP((uint64_t)drrwe->drr_psize, 8);
-			(void) sfread(buf, payload_size, stdin);
 			break;
 		}
 
@@ -333,6 +466,12 @@ zstream_do_recompress(int argc, char *argv[])
 			assert(B_FALSE);
 		}
 
+		rs->rs_size = payload_size;
+		if (payload_size != 0) {
+			rs->rs_buf = safe_malloc(payload_size);
+			(void) sfread(rs->rs_buf, payload_size, stdin);
+		}
+
 		if (feof(stdout)) {
 			fprintf(stderr, "Error: unexpected end-of-file\n");
 			exit(1);
@@ -352,22 +491,30 @@ zstream_do_recompress(int argc, char *argv[])
 			memset(&drr->drr_u.drr_checksum.drr_checksum, 0,
 			    sizeof (drr->drr_u.drr_checksum.drr_checksum));
 		}
-		if (dump_record(drr, buf, payload_size,
-		    &stream_cksum, STDOUT_FILENO) != 0)
-			break;
-		if (drr->drr_type == DRR_END) {
-			/*
-			 * Typically the END record is either the last
-			 * thing in the stream, or it is followed
-			 * by a BEGIN record (which also zeros the checksum).
-			 * However, a stream package ends with two END
-			 * records.  The last END record's checksum starts
-			 * from zero.
-			 */
-			ZIO_SET_CHECKSUM(&stream_cksum, 0, 0, 0, 0);
-		}
+
+		rs->rs_done = !recompress;
+		if (recompress)
+			recompress_dispatch(&rp, rs);
 	}
-	free(buf);
+	while (error == 0 && head != tail) {
+		error = recompress_emit(&rp, &slots[head++ % window],
+		    &stream_cksum);
+	}
+
+	pthread_mutex_lock(&rp.rp_lock);
+	rp.rp_exit = B_TRUE;
+	pthread_cond_broadcast(&rp.rp_work_cv);
+	pthread_mutex_unlock(&rp.rp_lock);
+	for (long i = 0; i < nthreads; i++)
+		(void) pthread_join(threads[i], NULL);
+	while (head != tail)
+		free(slots[head++ % window].rs_buf);
+
+	free(slots);
+	free(threads);
+	pthread_cond_destroy(&rp.rp_done_cv);
+	pthread_cond_destroy(&rp.rp_work_cv);
+	pthread_mutex_destroy(&rp.rp_lock);
 	fletcher_4_fini();
 	zio_fini();
 	zstd_fini();
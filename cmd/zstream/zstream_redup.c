@@ -31,6 +31,7 @@
 #include <umem.h>
 #include <unistd.h>
 #include <sys/debug.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/zfs_ioctl.h>
 #include <sys/zio_checksum.h>
@@ -49,11 +50,29 @@ typedef struct redup_entry {
 	uint64_t rde_stream_offset;
 } redup_entry_t;
 
+/*
+ * With -d the table is an open-addressed array of these, mapped from an
+ * unlinked temporary file, so that its size is bounded by disk space rather
+ * than memory.  rdde_guid is never zero for a valid entry.
+ */
+typedef struct redup_disk_entry {
+	uint64_t rdde_guid;
+	uint64_t rdde_object;
+	uint64_t rdde_offset;
+	uint64_t rdde_stream_offset;
+} redup_disk_entry_t;
+
+#define	RDT_DISK_MIN_BUCKETS	(1ULL << 20)
+
 typedef struct redup_table {
 	redup_entry_t	**redup_hash_array;
 	umem_cache_t	*ddecache;
 	uint64_t	ddt_count;
 	int		numhashbits;
+	redup_disk_entry_t *rdt_disk;	/* on-disk table, or NULL */
+	uint64_t	rdt_disk_buckets;
+	int		rdt_disk_fd;
+	const char	*rdt_tmpdir;
 } redup_table_t;
 
 int
@@ -112,6 +131,21 @@ spread(int fd, void *buf, size_t count, off_t offset)
 	}
 }
 
+/*
+ * Safe version of pwrite(), exits on error.
+ */
+static void
+spwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+	ssize_t err = pwrite(fd, buf, count, offset);
+	if (err == -1 || err != count) {
+		(void) fprintf(stderr,
+		    "Error while writing temporary file: %s\n",
+		    err == -1 ? strerror(errno) : "short write");
+		exit(1);
+	}
+}
+
 static int
 dump_record(dmu_replay_record_t *drr, void *payload, int payload_len,
     zio_cksum_t *zc, int outfd)
@@ -137,10 +171,110 @@ dump_record(dmu_replay_record_t *drr, void *payload, int payload_len,
 	return (0);
 }
 
+/*
+ * Create an unlinked temporary file of the given size in dir.
+ */
+static int
+redup_tmpfile(const char *dir, uint64_t size)
+{
+	char *path;
+
+	if (asprintf(&path, "%s/zstream.redup.XXXXXX", dir) == -1) {
+		(void) fprintf(stderr, "Error: out of memory\n");
+		exit(1);
+	}
+	int fd = mkstemp(path);
+	if (fd == -1 || unlink(path) != 0 ||
+	    (size != 0 && ftruncate(fd, size) != 0)) {
+		(void) fprintf(stderr,
+		    "Error while creating temporary file in '%s': %s\n",
+		    dir, strerror(errno));
+		exit(1);
+	}
+	free(path);
+	return (fd);
+}
+
+static void
+rdt_disk_map(redup_table_t *rdt, uint64_t buckets)
+{
+	uint64_t size = buckets * sizeof (redup_disk_entry_t);
+
+	rdt->rdt_disk_fd = redup_tmpfile(rdt->rdt_tmpdir, size);
+	rdt->rdt_disk = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+	    rdt->rdt_disk_fd, 0);
+	if (rdt->rdt_disk == MAP_FAILED) {
+		(void) fprintf(stderr, "Error while mapping temporary file: "
+		    "%s\n", strerror(errno));
+		exit(1);
+	}
+	rdt->rdt_disk_buckets = buckets;
+	rdt->numhashbits = highbit64(buckets) - 1;
+}
+
+static void
+rdt_disk_unmap(redup_disk_entry_t *disk, uint64_t buckets, int fd)
+{
+	(void) munmap(disk, buckets * sizeof (redup_disk_entry_t));
+	(void) close(fd);
+}
+
+static redup_disk_entry_t *
+rdt_disk_find(redup_table_t *rdt, uint64_t guid, uint64_t object,
+    uint64_t offset)
+{
+	uint64_t ch = cityhash4(guid, object, offset, 0);
+	uint64_t mask = rdt->rdt_disk_buckets - 1;
+
+	for (uint64_t i = BF64_GET(ch, 0, rdt->numhashbits); ;
+	    i = (i + 1) & mask) {
+		redup_disk_entry_t *rdde = &rdt->rdt_disk[i];
+		if (rdde->rdde_guid == 0 || (rdde->rdde_guid == guid &&
+		    rdde->rdde_object == object &&
+		    rdde->rdde_offset == offset))
+			return (rdde);
+	}
+}
+
+/*
+ * Keep the on-disk table at most 3/4 full by rehashing it into a new file
+ * twice the size.
+ */
+static void
+rdt_disk_grow(redup_table_t *rdt)
+{
+	redup_disk_entry_t *old = rdt->rdt_disk;
+	uint64_t oldbuckets = rdt->rdt_disk_buckets;
+	int oldfd = rdt->rdt_disk_fd;
+
+	rdt_disk_map(rdt, oldbuckets * 2);
+	for (uint64_t i = 0; i < oldbuckets; i++) {
+		if (old[i].rdde_guid == 0)
+			continue;
+		*rdt_disk_find(rdt, old[i].rdde_guid, old[i].rdde_object,
+		    old[i].rdde_offset) = old[i];
+	}
+	rdt_disk_unmap(old, oldbuckets, oldfd);
+}
+
 static void
 rdt_insert(redup_table_t *rdt,
     uint64_t guid, uint64_t object, uint64_t offset, uint64_t stream_offset)
 {
+	if (rdt->rdt_disk != NULL) {
+		if (rdt->ddt_count >= rdt->rdt_disk_buckets / 4 * 3)
+			rdt_disk_grow(rdt);
+		redup_disk_entry_t *rdde =
+		    rdt_disk_find(rdt, guid, object, offset);
+		if (rdde->rdde_guid == 0)
+			rdt->ddt_count++;
+		rdde->rdde_guid = guid;
+		rdde->rdde_object = object;
+		rdde->rdde_offset = offset;
+		rdde->rdde_stream_offset = stream_offset;
+		return;
+	}
+
 	uint64_t ch = cityhash4(guid, object, offset, 0);
 	uint64_t hashcode = BF64_GET(ch, 0, rdt->numhashbits);
 	redup_entry_t **rdepp;
@@ -161,6 +295,14 @@ rdt_lookup(redup_table_t *rdt,
     uint64_t guid, uint64_t object, uint64_t offset,
     uint64_t *stream_offsetp)
 {
+	if (rdt->rdt_disk != NULL) {
+		redup_disk_entry_t *rdde =
+		    rdt_disk_find(rdt, guid, object, offset);
+		assert(rdde->rdde_guid != 0);
+		*stream_offsetp = rdde->rdde_stream_offset;
+		return;
+	}
+
 	uint64_t ch = cityhash4(guid, object, offset, 0);
 	uint64_t hashcode = BF64_GET(ch, 0, rdt->numhashbits);
 
@@ -179,11 +321,17 @@ rdt_lookup(redup_table_t *rdt,
 /*
  * Convert a dedup stream (generated by "zfs send -D") to a
  * non-deduplicated stream.  The entire infd will be converted, including
- * any substreams in a stream package (generated by "zfs send -RD"). The
- * infd must be seekable.
+ * any substreams in a stream package (generated by "zfs send -RD").
+ *
+ * WRITE_BYREF records are resolved by reading the referenced WRITE record
+ * again.  If infd is seekable it is read from there; otherwise every WRITE
+ * record is also copied to a temporary file in tmpdir as it streams past.
+ * If disk is set, the table of WRITE records is kept in a temporary file
+ * in tmpdir too, instead of in memory.
  */
 static void
-zfs_redup_stream(int infd, int outfd, boolean_t verbose)
+zfs_redup_stream(int infd, int outfd, boolean_t verbose, boolean_t disk,
+    const char *tmpdir)
 {
 	int bufsz = SPA_MAXBLOCKSIZE;
 	dmu_replay_record_t thedrr;
@@ -214,12 +362,24 @@ zfs_redup_stream(int infd, int outfd, boolean_t verbose)
 	if (!ISP2(numbuckets))
 		numbuckets = 1ULL << highbit64(numbuckets);
 
-	rdt.redup_hash_array =
-	    safe_calloc(numbuckets * sizeof (redup_entry_t *));
-	rdt.ddecache = umem_cache_create("rde", sizeof (redup_entry_t), 0,
-	    NULL, NULL, NULL, NULL, NULL, 0);
-	rdt.numhashbits = highbit64(numbuckets) - 1;
-	rdt.ddt_count = 0;
+	memset(&rdt, 0, sizeof (rdt));
+	rdt.rdt_tmpdir = tmpdir;
+	if (disk) {
+		rdt_disk_map(&rdt, RDT_DISK_MIN_BUCKETS);
+	} else {
+		rdt.redup_hash_array =
+		    safe_calloc(numbuckets * sizeof (redup_entry_t *));
+		rdt.ddecache = umem_cache_create("rde",
+		    sizeof (redup_entry_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
+		rdt.numhashbits = highbit64(numbuckets) - 1;
+	}
+
+	/* Where WRITE records are read back from for WRITE_BYREF. */
+	int spillfd = -1;
+	uint64_t spilloff = 0;
+	int reffd = infd;
+	if (lseek(infd, 0, SEEK_CUR) == -1)
+		spillfd = reffd = redup_tmpfile(tmpdir, 0);
 
 	char *buf = safe_calloc(bufsz);
 	FILE *ofp = fdopen(infd, "r");
@@ -332,7 +492,7 @@ zfs_redup_stream(int infd, int outfd, boolean_t verbose)
 			    drrwb.drr_refobject, drrwb.drr_refoffset,
 			    &stream_offset);
 
-			spread(infd, drr, sizeof (*drr), stream_offset);
+			spread(reffd, drr, sizeof (*drr), stream_offset);
 
 			assert(drr->drr_type == DRR_WRITE);
 			struct drr_write *drrw = &drr->drr_u.drr_write;
@@ -341,7 +501,7 @@ zfs_redup_stream(int infd, int outfd, boolean_t verbose)
 			assert(drrw->drr_offset == drrwb.drr_refoffset);
 
 			payload_size = DRR_WRITE_PAYLOAD_SIZE(drrw);
-			spread(infd, buf, payload_size,
+			spread(reffd, buf, payload_size,
 			    stream_offset + sizeof (*drr));
 
 			drrw->drr_toguid = drrwb.drr_toguid;
@@ -357,6 +517,13 @@ zfs_redup_stream(int infd, int outfd, boolean_t verbose)
 			payload_size = DRR_WRITE_PAYLOAD_SIZE(drrw);
 			(void) sfread(buf, payload_size, ofp);
 
+			if (spillfd != -1) {
+				offset = spilloff;
+				spwrite(spillfd, drr, sizeof (*drr), spilloff);
+				spilloff += sizeof (*drr);
+				spwrite(spillfd, buf, payload_size, spilloff);
+				spilloff += payload_size;
+			}
 			rdt_insert(&rdt, drrw->drr_toguid,
 			    drrw->drr_object, drrw->drr_offset, offset);
 			break;
@@ -424,17 +591,26 @@ zfs_redup_stream(int infd, int outfd, boolean_t verbose)
 
 	if (verbose) {
 		char mem_str[16];
-		zfs_nicenum(rdt.ddt_count * sizeof (redup_entry_t),
+		zfs_nicenum(disk ?
+		    rdt.rdt_disk_buckets * sizeof (redup_disk_entry_t) :
+		    rdt.ddt_count * sizeof (redup_entry_t),
 		    mem_str, sizeof (mem_str));
 		fprintf(stderr, "converted stream with %llu total records, "
-		    "including %llu dedup records, using %sB memory.\n",
+		    "including %llu dedup records, using %sB %s.\n",
 		    (long long)num_records,
 		    (long long)num_write_byref_records,
-		    mem_str);
+		    mem_str, disk ? "temporary file" : "memory");
 	}
 
-	umem_cache_destroy(rdt.ddecache);
-	free(rdt.redup_hash_array);
+	if (disk) {
+		rdt_disk_unmap(rdt.rdt_disk, rdt.rdt_disk_buckets,
+		    rdt.rdt_disk_fd);
+	} else {
+		umem_cache_destroy(rdt.ddecache);
+		free(rdt.redup_hash_array);
+	}
+	if (spillfd != -1)
+		(void) close(spillfd);
 	free(buf);
 	(void) fclose(ofp);
 }
@@ -443,10 +619,21 @@ int
 zstream_do_redup(int argc, char *argv[])
 {
 	boolean_t verbose = B_FALSE;
+	boolean_t disk = B_FALSE;
+	const char *tmpdir = getenv("TMPDIR");
 	int c;
 
-	while ((c = getopt(argc, argv, "v")) != -1) {
+	if (tmpdir == NULL)
+		tmpdir = "/var/tmp";
+
+	while ((c = getopt(argc, argv, "d:Dv")) != -1) {
 		switch (c) {
+		case 'd':
+			tmpdir = optarg;
+			break;
+		case 'D':
+			disk = B_TRUE;
+			break;
 		case 'v':
 			verbose = B_TRUE;
 			break;
@@ -473,7 +660,8 @@ zstream_do_redup(int argc, char *argv[])
 		return (1);
 	}
 
-	int fd = open(filename, O_RDONLY);
+	int fd = strcmp(filename, "-") == 0 ? dup(STDIN_FILENO) :
+	    open(filename, O_RDONLY);
 	if (fd == -1) {
 		(void) fprintf(stderr,
 		    "Error while opening file '%s': %s\n",
@@ -482,7 +670,7 @@ zstream_do_redup(int argc, char *argv[])
 	}
 
 	fletcher_4_init();
-	zfs_redup_stream(fd, STDOUT_FILENO, verbose);
+	zfs_redup_stream(fd, STDOUT_FILENO, verbose, disk, tmpdir);
 	fletcher_4_fini();
 
 	close(fd);
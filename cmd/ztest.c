@@ -117,6 +117,7 @@
 #include <sys/dsl_destroy.h>
 #include <sys/dsl_scan.h>
 #include <sys/zio_checksum.h>
+#include <sys/ddt.h>
 #include <sys/zfs_refcount.h>
 #include <sys/zfeature.h>
 #include <sys/dsl_userhold.h>
@@ -202,6 +203,7 @@ typedef struct ztest_shared_opts {
 	int zo_mmp_test;
 	int zo_special_vdevs;
 	int zo_dump_dbgmsg;
+	char zo_bench[16];
 	int zo_gvars_count;
 	char zo_gvars[ZO_GVARS_MAX_COUNT][ZO_GVARS_MAX_ARGLEN];
 } ztest_shared_opts_t;
@@ -273,6 +275,7 @@ extern uint_t dmu_object_alloc_chunk_shift;
 extern boolean_t zfs_force_some_double_word_sm_entries;
 extern unsigned long zio_decompress_fail_fraction;
 extern unsigned long zfs_reconstruct_indirect_damage_fraction;
+extern uint64_t vdev_mem_size;
 extern uint64_t raidz_expand_max_reflow_bytes;
 extern uint_t raidz_expand_pause_point;
 
@@ -426,6 +429,7 @@ ztest_func_t ztest_fault_inject;
 ztest_func_t ztest_dmu_snapshot_hold;
 ztest_func_t ztest_mmp_enable_disable;
 ztest_func_t ztest_scrub;
+ztest_func_t ztest_ddt_prune;
 ztest_func_t ztest_dsl_dataset_promote_busy;
 ztest_func_t ztest_vdev_attach_detach;
 ztest_func_t ztest_vdev_raidz_attach;
@@ -483,6 +487,7 @@ static ztest_info_t ztest_info[] = {
 	ZTI_INIT(ztest_mmp_enable_disable, 1, &zopt_sometimes),
 	ZTI_INIT(ztest_reguid, 1, &zopt_rarely),
 	ZTI_INIT(ztest_scrub, 1, &zopt_rarely),
+	ZTI_INIT(ztest_ddt_prune, 1, &zopt_rarely),
 	ZTI_INIT(ztest_spa_upgrade, 1, &zopt_rarely),
 	ZTI_INIT(ztest_dsl_dataset_promote_busy, 1, &zopt_rarely),
 	ZTI_INIT(ztest_vdev_attach_detach, 1, &zopt_sometimes),
@@ -799,6 +804,9 @@ static ztest_option_t option_table[] = {
 	{ 'X', "raidz-expansion", NULL,
 	    "Perform a dedicated raidz expansion test",
 	    NO_DEFAULT, NULL},
+	{ 'b',	"benchmark", "WORKLOAD",
+	    "Time create|write|read|arc|zio|all instead of testing",
+	    NO_DEFAULT, NULL},
 	{ 'o',	"option", "\"OPTION=INTEGER\"",
 	    "Set global variable to an unsigned 32-bit integer value",
 	    NO_DEFAULT, NULL},
@@ -1048,6 +1056,10 @@ process_options(int argc, char **argv)
 		case 'X':
 			zo->zo_raidz_expand_test = RAIDZ_EXPAND_REQUESTED;
 			break;
+		case 'b':
+			(void) strlcpy(zo->zo_bench, optarg,
+			    sizeof (zo->zo_bench));
+			break;
 		case 'E':
 			zo->zo_init = 0;
 			break;
@@ -1109,6 +1121,10 @@ process_options(int argc, char **argv)
 		raid_kind = "raidz";
 	}
 
+	/* Benchmark results are only comparable on the same layout */
+	if (*zo->zo_bench && strcmp(raid_kind, "random") == 0)
+		raid_kind = "raidz";
+
 	if (strcmp(raid_kind, "random") == 0) {
 		switch (ztest_random(3)) {
 		case 0:
@@ -1306,7 +1322,7 @@ make_vdev_file(const char *path, const char *aux, const char *pool,
 		draid_spare = ztest_is_draid_spare(path);
 	}
 
-	if (size != 0 && !draid_spare) {
+	if (size != 0 && !draid_spare && !*ztest_opts.zo_bench) {
 		int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
 		if (fd == -1)
 			fatal(B_TRUE, "can't open %s", path);
@@ -1317,7 +1333,8 @@ make_vdev_file(const char *path, const char *aux, const char *pool,
 
 	file = fnvlist_alloc();
 	fnvlist_add_string(file, ZPOOL_CONFIG_TYPE,
-	    draid_spare ? VDEV_TYPE_DRAID_SPARE : VDEV_TYPE_FILE);
+	    draid_spare ? VDEV_TYPE_DRAID_SPARE :
+	    *ztest_opts.zo_bench ? VDEV_TYPE_MEM : VDEV_TYPE_FILE);
 	fnvlist_add_string(file, ZPOOL_CONFIG_PATH, path);
 	fnvlist_add_uint64(file, ZPOOL_CONFIG_ASHIFT, ashift);
 	umem_free(pathbuf, MAXPATHLEN);
@@ -6724,6 +6741,24 @@ ztest_scrub(ztest_ds_t *zd, uint64_t id)
 	ASSERT0(error);
 }
 
+/*
+ * Prune all unique entries from the dedup tables.
+ */
+void
+ztest_ddt_prune(ztest_ds_t *zd, uint64_t id)
+{
+	(void) zd, (void) id;
+	spa_t *spa = ztest_spa;
+
+	if (!spa_feature_is_enabled(spa, SPA_FEATURE_FAST_DEDUP))
+		return;
+
+	int error = ddt_prune_unique_entries(spa, 0);
+	if (error == ENOENT)
+		error = 0;
+	ASSERT0(error);
+}
+
 /*
  * Change the guid for the pool.
  */
@@ -8591,6 +8626,315 @@ ztest_init(ztest_shared_t *zs)
 	mutex_destroy(&ztest_checkpoint_lock);
 }
 
+/*
+ * Benchmark mode (-b).
+ *
+ * Instead of stress testing, time a few hot paths through libzpool on a
+ * freshly created pool, so that the core of ZFS can be profiled and run
+ * under sanitizers without loading the kernel modules.  Each workload is
+ * run by zo_threads threads for zo_passtime seconds; every thread works
+ * on an object of its own, which is filled and synced before the clock
+ * starts:
+ *
+ *   create	allocate and free a DMU object, one tx each
+ *   write	dmu_write() whole blocks of the thread's object
+ *   read	dmu_read() whole blocks, which are normally cached
+ *   arc	arc_read() the blocks' bps, which are always ARC hits
+ *   zio	zio_read() the blocks' bps, bypassing the DMU and the ARC
+ *
+ * The pool is built on memory-backed vdevs, so that the results depend on
+ * the CPU rather than the storage.  The CPU cost reported is that of the
+ * whole process, so it includes the work done by the sync and zio taskq
+ * threads on behalf of each op.
+ */
+#define	ZTEST_BENCH_BLOCKSIZE	SPA_OLD_MAXBLOCKSIZE
+#define	ZTEST_BENCH_BLOCKS	64
+
+typedef struct ztest_bench_thread {
+	objset_t	*zbt_os;
+	uint64_t	zbt_object;
+	blkptr_t	zbt_bps[ZTEST_BENCH_BLOCKS];
+	void		*zbt_buf;
+	abd_t		*zbt_abd;
+	uint64_t	(*zbt_func)(struct ztest_bench_thread *, uint64_t);
+	hrtime_t	zbt_stop;
+	uint64_t	zbt_ops;
+	uint64_t	zbt_bytes;
+} ztest_bench_thread_t;
+
+static uint64_t
+ztest_bench_create(ztest_bench_thread_t *zbt, uint64_t i)
+{
+	(void) i;
+	objset_t *os = zbt->zbt_os;
+	uint64_t object;
+	dmu_tx_t *tx;
+
+	tx = dmu_tx_create(os);
+	dmu_tx_hold_bonus(tx, DMU_NEW_OBJECT);
+	VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+	object = dmu_object_alloc(os, DMU_OT_UINT64_OTHER, 0,
+	    DMU_OT_NONE, 0, tx);
+	dmu_tx_commit(tx);
+
+	tx = dmu_tx_create(os);
+	dmu_tx_hold_free(tx, object, 0, DMU_OBJECT_END);
+	VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+	VERIFY0(dmu_object_free(os, object, tx));
+	dmu_tx_commit(tx);
+
+	return (0);
+}
+
+static uint64_t
+ztest_bench_write(ztest_bench_thread_t *zbt, uint64_t i)
+{
+	uint64_t offset = (i % ZTEST_BENCH_BLOCKS) * ZTEST_BENCH_BLOCKSIZE;
+	dmu_tx_t *tx;
+
+	tx = dmu_tx_create(zbt->zbt_os);
+	dmu_tx_hold_write(tx, zbt->zbt_object, offset, ZTEST_BENCH_BLOCKSIZE);
+	VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+	dmu_write(zbt->zbt_os, zbt->zbt_object, offset, ZTEST_BENCH_BLOCKSIZE,
+	    zbt->zbt_buf, tx);
+	dmu_tx_commit(tx);
+
+	return (ZTEST_BENCH_BLOCKSIZE);
+}
+
+static uint64_t
+ztest_bench_read(ztest_bench_thread_t *zbt, uint64_t i)
+{
+	uint64_t offset = (i % ZTEST_BENCH_BLOCKS) * ZTEST_BENCH_BLOCKSIZE;
+
+	VERIFY0(dmu_read(zbt->zbt_os, zbt->zbt_object, offset,
+	    ZTEST_BENCH_BLOCKSIZE, zbt->zbt_buf, DMU_READ_NO_PREFETCH));
+
+	return (ZTEST_BENCH_BLOCKSIZE);
+}
+
+static uint64_t
+ztest_bench_arc(ztest_bench_thread_t *zbt, uint64_t i)
+{
+	uint64_t blkid = i % ZTEST_BENCH_BLOCKS;
+	arc_flags_t aflags = ARC_FLAG_WAIT;
+	arc_buf_t *abuf = NULL;
+	zbookmark_phys_t zb;
+
+	SET_BOOKMARK(&zb, dmu_objset_id(zbt->zbt_os), zbt->zbt_object,
+	    0, blkid);
+	VERIFY0(arc_read(NULL, dmu_objset_spa(zbt->zbt_os),
+	    &zbt->zbt_bps[blkid], arc_getbuf_func, &abuf,
+	    ZIO_PRIORITY_SYNC_READ, ZIO_FLAG_CANFAIL, &aflags, &zb));
+	arc_buf_destroy(abuf, &abuf);
+
+	return (ZTEST_BENCH_BLOCKSIZE);
+}
+
+static uint64_t
+ztest_bench_zio(ztest_bench_thread_t *zbt, uint64_t i)
+{
+	uint64_t blkid = i % ZTEST_BENCH_BLOCKS;
+	blkptr_t *bp = &zbt->zbt_bps[blkid];
+	zbookmark_phys_t zb;
+
+	SET_BOOKMARK(&zb, dmu_objset_id(zbt->zbt_os), zbt->zbt_object,
+	    0, blkid);
+	VERIFY0(zio_wait(zio_read(NULL, dmu_objset_spa(zbt->zbt_os), bp,
+	    zbt->zbt_abd, BP_GET_LSIZE(bp), NULL, NULL,
+	    ZIO_PRIORITY_SYNC_READ, ZIO_FLAG_CANFAIL, &zb)));
+
+	return (ZTEST_BENCH_BLOCKSIZE);
+}
+
+static const struct {
+	const char	*name;
+	uint64_t	(*func)(ztest_bench_thread_t *, uint64_t);
+} ztest_bench_info[] = {
+	{ "create",	ztest_bench_create },
+	{ "write",	ztest_bench_write },
+	{ "read",	ztest_bench_read },
+	{ "arc",	ztest_bench_arc },
+	{ "zio",	ztest_bench_zio },
+};
+
+static __attribute__((noreturn)) void
+ztest_bench_thread(void *arg)
+{
+	ztest_bench_thread_t *zbt = arg;
+
+	while (gethrtime() < zbt->zbt_stop)
+		zbt->zbt_bytes += zbt->zbt_func(zbt, zbt->zbt_ops++);
+
+	thread_exit();
+}
+
+/*
+ * Fill the thread's object, wait for it to be synced and note down the
+ * block pointers, so that each workload starts from the same state.
+ */
+static void
+ztest_bench_prepare(ztest_bench_thread_t *zbt)
+{
+	objset_t *os = zbt->zbt_os;
+
+	for (uint64_t i = 0; i < ZTEST_BENCH_BLOCKS; i++)
+		(void) ztest_bench_write(zbt, i);
+	txg_wait_synced(dmu_objset_pool(os), 0);
+
+	for (uint64_t i = 0; i < ZTEST_BENCH_BLOCKS; i++) {
+		dmu_buf_t *db;
+
+		VERIFY0(dmu_buf_hold(os, zbt->zbt_object,
+		    i * ZTEST_BENCH_BLOCKSIZE, FTAG, &db,
+		    DMU_READ_NO_PREFETCH));
+		zbt->zbt_bps[i] = *dmu_buf_get_blkptr(db);
+		dmu_buf_rele(db, FTAG);
+	}
+}
+
+static void
+ztest_bench_one(size_t w, ztest_bench_thread_t *zbts)
+{
+	int threads = ztest_opts.zo_threads;
+	kthread_t **tids;
+	struct rusage ru0, ru1;
+	hrtime_t start, elapsed;
+	uint64_t ops = 0, bytes = 0;
+	double secs, cpu;
+
+	for (int t = 0; t < threads; t++)
+		ztest_bench_prepare(&zbts[t]);
+
+	tids = umem_alloc(threads * sizeof (kthread_t *), UMEM_NOFAIL);
+	VERIFY0(getrusage(RUSAGE_SELF, &ru0));
+	start = gethrtime();
+	for (int t = 0; t < threads; t++) {
+		ztest_bench_thread_t *zbt = &zbts[t];
+
+		zbt->zbt_func = ztest_bench_info[w].func;
+		zbt->zbt_stop = start + ztest_opts.zo_passtime * NANOSEC;
+		zbt->zbt_ops = zbt->zbt_bytes = 0;
+		tids[t] = thread_create(NULL, 0, ztest_bench_thread, zbt, 0,
+		    NULL, TS_RUN | TS_JOINABLE, defclsyspri);
+	}
+	for (int t = 0; t < threads; t++) {
+		VERIFY0(thread_join(tids[t]));
+		ops += zbts[t].zbt_ops;
+		bytes += zbts[t].zbt_bytes;
+	}
+	elapsed = gethrtime() - start;
+	VERIFY0(getrusage(RUSAGE_SELF, &ru1));
+	umem_free(tids, threads * sizeof (kthread_t *));
+
+	secs = (double)elapsed / NANOSEC;
+	cpu = (ru1.ru_utime.tv_sec - ru0.ru_utime.tv_sec) +
+	    (ru1.ru_stime.tv_sec - ru0.ru_stime.tv_sec) +
+	    ((ru1.ru_utime.tv_usec - ru0.ru_utime.tv_usec) +
+	    (ru1.ru_stime.tv_usec - ru0.ru_stime.tv_usec)) / 1e6;
+
+	(void) printf("%-8s %7d %12"PRIu64" %12.0f %10.1f %10.2f\n",
+	    ztest_bench_info[w].name, threads, ops, ops / secs,
+	    bytes / secs / (1 << 20), ops ? cpu * 1e6 / ops : 0.0);
+}
+
+/*
+ * Create a pool laid out as for a regular run, but on memory-backed vdevs
+ * and with every feature enabled, and run the selected benchmarks against
+ * a dataset on it.
+ */
+static void
+ztest_bench(void)
+{
+	int threads = ztest_opts.zo_threads;
+	ztest_bench_thread_t *zbts;
+	char name[ZFS_MAX_DATASET_NAME_LEN];
+	nvlist_t *nvroot, *props;
+	objset_t *os;
+	spa_t *spa;
+	size_t w;
+
+	for (w = 0; w < ARRAY_SIZE(ztest_bench_info); w++) {
+		if (strcmp(ztest_opts.zo_bench, ztest_bench_info[w].name) == 0)
+			break;
+	}
+	if (w == ARRAY_SIZE(ztest_bench_info) &&
+	    strcmp(ztest_opts.zo_bench, "all") != 0) {
+		(void) fprintf(stderr, "invalid benchmark '%s'\n",
+		    ztest_opts.zo_bench);
+		usage(B_FALSE);
+	}
+
+	vdev_mem_size = ztest_opts.zo_vdev_size;
+	kernel_init(SPA_MODE_READ | SPA_MODE_WRITE);
+
+	(void) spa_destroy(ztest_opts.zo_pool);
+	ztest_shared->zs_vdev_next_leaf = 0;
+	nvroot = make_vdev_root(NULL, NULL, NULL, ztest_opts.zo_vdev_size, 0,
+	    NULL, ztest_opts.zo_raid_children, ztest_opts.zo_mirrors, 1);
+	props = fnvlist_alloc();
+	for (int i = 0; i < SPA_FEATURES; i++) {
+		char *buf;
+
+		if (!spa_feature_table[i].fi_zfs_mod_supported)
+			continue;
+		VERIFY3S(-1, !=, asprintf(&buf, "feature@%s",
+		    spa_feature_table[i].fi_uname));
+		fnvlist_add_uint64(props, buf, 0);
+		free(buf);
+	}
+	VERIFY0(spa_create(ztest_opts.zo_pool, nvroot, props, NULL, NULL));
+	fnvlist_free(nvroot);
+	fnvlist_free(props);
+
+	VERIFY0(spa_open(ztest_opts.zo_pool, &spa, FTAG));
+	ztest_spa = spa;
+
+	(void) snprintf(name, sizeof (name), "%s/bench", ztest_opts.zo_pool);
+	VERIFY0(dmu_objset_create(name, DMU_OST_OTHER, 0, NULL, NULL, NULL));
+	VERIFY0(dmu_objset_own(name, DMU_OST_OTHER, B_FALSE, B_TRUE, FTAG,
+	    &os));
+
+	zbts = umem_zalloc(threads * sizeof (ztest_bench_thread_t),
+	    UMEM_NOFAIL);
+	for (int t = 0; t < threads; t++) {
+		ztest_bench_thread_t *zbt = &zbts[t];
+		dmu_tx_t *tx;
+
+		zbt->zbt_os = os;
+		zbt->zbt_buf = umem_alloc(ZTEST_BENCH_BLOCKSIZE, UMEM_NOFAIL);
+		(void) random_get_pseudo_bytes(zbt->zbt_buf,
+		    ZTEST_BENCH_BLOCKSIZE);
+		zbt->zbt_abd = abd_alloc_linear(ZTEST_BENCH_BLOCKSIZE, B_FALSE);
+
+		tx = dmu_tx_create(os);
+		dmu_tx_hold_bonus(tx, DMU_NEW_OBJECT);
+		VERIFY0(dmu_tx_assign(tx, TXG_WAIT));
+		zbt->zbt_object = dmu_object_alloc(os, DMU_OT_UINT64_OTHER,
+		    ZTEST_BENCH_BLOCKSIZE, DMU_OT_NONE, 0, tx);
+		dmu_tx_commit(tx);
+	}
+
+	(void) printf("%-8s %7s %12s %12s %10s %10s\n", "workload",
+	    "threads", "ops", "ops/s", "MiB/s", "cpu us/op");
+	if (w < ARRAY_SIZE(ztest_bench_info)) {
+		ztest_bench_one(w, zbts);
+	} else {
+		for (w = 0; w < ARRAY_SIZE(ztest_bench_info); w++)
+			ztest_bench_one(w, zbts);
+	}
+
+	for (int t = 0; t < threads; t++) {
+		umem_free(zbts[t].zbt_buf, ZTEST_BENCH_BLOCKSIZE);
+		abd_free(zbts[t].zbt_abd);
+	}
+	umem_free(zbts, threads * sizeof (ztest_bench_thread_t));
+
+	dmu_objset_disown(os, B_TRUE, FTAG);
+	spa_close(spa, FTAG);
+	kernel_fini();
+}
+
 static void
 setup_data_fd(void)
 {
@@ -8877,6 +9221,11 @@ main(int argc, char **argv)
 	    UMEM_NOFAIL);
 	zs = ztest_shared;
 
+	if (*ztest_opts.zo_bench) {
+		ztest_bench();
+		exit(0);
+	}
+
 	if (fd_data_str) {
 		metaslab_force_ganging = ztest_opts.zo_metaslab_force_ganging;
 		metaslab_df_alloc_threshold =
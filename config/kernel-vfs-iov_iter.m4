@@ -100,6 +100,28 @@ AC_DEFUN([ZFS_AC_KERNEL_SRC_VFS_IOV_ITER], [
 		struct iov_iter iter = { 0 };
 		__attribute__((unused)) const struct iovec *iov = iter_iov(&iter);
 	])
+
+	ZFS_LINUX_TEST_SRC([iov_iter_get_pages2], [
+		#include <linux/uio.h>
+	],[
+		struct iov_iter iter = { 0 };
+		struct page *page;
+		size_t start;
+		ssize_t bytes __attribute__ ((unused));
+
+		bytes = iov_iter_get_pages2(&iter, &page, PAGE_SIZE, 1, &start);
+	])
+
+	ZFS_LINUX_TEST_SRC([iov_iter_get_pages], [
+		#include <linux/uio.h>
+	],[
+		struct iov_iter iter = { 0 };
+		struct page *page;
+		size_t start;
+		ssize_t bytes __attribute__ ((unused));
+
+		bytes = iov_iter_get_pages(&iter, &page, PAGE_SIZE, 1, &start);
+	])
 ])
 
 AC_DEFUN([ZFS_AC_KERNEL_VFS_IOV_ITER], [
@@ -223,4 +245,28 @@ AC_DEFUN([ZFS_AC_KERNEL_VFS_IOV_ITER], [
 	],[
 		AC_MSG_RESULT(no)
 	])
+
+	dnl #
+	dnl # Kernel 6.0 renamed iov_iter_get_pages() to iov_iter_get_pages2(),
+	dnl # which also advances the iov_iter, and 6.3 removed the original.
+	dnl # Neither is required; without them Direct I/O writes copy the
+	dnl # data instead of referencing the user pages.
+	dnl #
+	AC_MSG_CHECKING([whether iov_iter_get_pages2() is available])
+	ZFS_LINUX_TEST_RESULT([iov_iter_get_pages2], [
+		AC_MSG_RESULT(yes)
+		AC_DEFINE(HAVE_IOV_ITER_GET_PAGES2, 1,
+		    [iov_iter_get_pages2() is available])
+	],[
+		AC_MSG_RESULT(no)
+
+		AC_MSG_CHECKING([whether iov_iter_get_pages() is available])
+		ZFS_LINUX_TEST_RESULT([iov_iter_get_pages], [
+			AC_MSG_RESULT(yes)
+			AC_DEFINE(HAVE_IOV_ITER_GET_PAGES, 1,
+			    [iov_iter_get_pages() is available])
+		],[
+			AC_MSG_RESULT(no)
+		])
+	])
 ])
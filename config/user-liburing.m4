@@ -0,0 +1,19 @@
+dnl #
+dnl # Check for liburing, used by libzpool to issue file vdev reads
+dnl # asynchronously.
+dnl #
+AC_DEFUN([ZFS_AC_CONFIG_USER_LIBURING], [
+	AC_ARG_WITH([liburing],
+	    AS_HELP_STRING([--with-liburing],
+		[use io_uring for file vdev reads in libzpool]),
+	    [],
+	    [with_liburing=auto])
+
+	AS_IF([test "x$with_liburing" != "xno"], [
+		ZFS_AC_FIND_SYSTEM_LIBRARY(LIBURING, [liburing], [liburing.h], [], [uring], [io_uring_queue_init], [], [
+			AS_IF([test "x$with_liburing" = "xyes"], [
+				AC_MSG_FAILURE([--with-liburing was given, but liburing is not available, try installing liburing-devel])
+			])
+		])
+	])
+])
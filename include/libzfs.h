@@ -300,6 +300,7 @@ _LIBZFS_H int zpool_trim(zpool_handle_t *, pool_trim_func_t, nvlist_t *,
 
 _LIBZFS_H int zpool_clear(zpool_handle_t *, const char *, nvlist_t *);
 _LIBZFS_H int zpool_reguid(zpool_handle_t *);
+_LIBZFS_H int zpool_ddt_prune(zpool_handle_t *, uint64_t);
 _LIBZFS_H int zpool_reopen_one(zpool_handle_t *, void *);
 
 _LIBZFS_H int zpool_sync_one(zpool_handle_t *, void *);
@@ -491,6 +492,8 @@ _LIBZFS_H int zpool_get_history(zpool_handle_t *, nvlist_t **, uint64_t *,
     boolean_t *);
 _LIBZFS_H int zpool_events_next(libzfs_handle_t *, nvlist_t **, int *, unsigned,
     int);
+_LIBZFS_H int zpool_events_next_batch(libzfs_handle_t *, nvlist_t **, int *,
+    unsigned, uint_t, int);
 _LIBZFS_H int zpool_events_clear(libzfs_handle_t *, int *);
 _LIBZFS_H int zpool_events_seek(libzfs_handle_t *, uint64_t, int);
 _LIBZFS_H void zpool_obj_to_path_ds(zpool_handle_t *, uint64_t, uint64_t,
@@ -578,6 +581,8 @@ _LIBZFS_H int zfs_crypto_clone_check(libzfs_handle_t *, zfs_handle_t *, char *,
     nvlist_t *);
 _LIBZFS_H int zfs_crypto_attempt_load_keys(libzfs_handle_t *, const char *);
 _LIBZFS_H int zfs_crypto_load_key(zfs_handle_t *, boolean_t, const char *);
+_LIBZFS_H uint64_t zfs_crypto_load_keys(zfs_handle_t **, size_t, boolean_t,
+    const char *, uint_t);
 _LIBZFS_H int zfs_crypto_unload_key(zfs_handle_t *);
 _LIBZFS_H int zfs_crypto_rewrap(zfs_handle_t *, nvlist_t *, boolean_t);
 
@@ -818,6 +823,12 @@ _LIBZFS_H int zfs_send_saved(zfs_handle_t *, sendflags_t *, int, const char *);
 _LIBZFS_H nvlist_t *zfs_send_resume_token_to_nvlist(libzfs_handle_t *hdl,
     const char *token);
 
+typedef struct zfs_stripe zfs_stripe_t;
+
+_LIBZFS_H int zfs_stripe_start(libzfs_handle_t *, int, const int *, uint_t,
+    boolean_t, zfs_stripe_t **);
+_LIBZFS_H int zfs_stripe_finish(zfs_stripe_t *);
+
 _LIBZFS_H int zfs_promote(zfs_handle_t *);
 _LIBZFS_H int zfs_hold(zfs_handle_t *, const char *, const char *,
     boolean_t, int);
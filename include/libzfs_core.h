@@ -158,6 +158,15 @@ _LIBZFS_CORE_H int lzc_set_vdev_prop(const char *, nvlist_t *, nvlist_t **);
 
 _LIBZFS_CORE_H int lzc_scrub(zfs_ioc_t, const char *, nvlist_t *, nvlist_t **);
 
+_LIBZFS_CORE_H int lzc_ddt_prune(const char *, uint64_t);
+_LIBZFS_CORE_H int lzc_changed_blocks(const char *, const char *, uint64_t,
+    int);
+_LIBZFS_CORE_H int lzc_mount_prefetch(const char *);
+_LIBZFS_CORE_H int lzc_dataset_list_batch(const char *, nvlist_t *,
+    nvlist_t **);
+_LIBZFS_CORE_H int lzc_dedup_sample(const char *, uint64_t, nvlist_t **);
+_LIBZFS_CORE_H int lzc_kstats(const char *, const char *, nvlist_t **);
+
 #ifdef	__cplusplus
 }
 #endif
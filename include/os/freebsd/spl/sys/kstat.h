@@ -29,6 +29,7 @@
 #include <sys/sysctl.h>
 #endif
 struct list_head {};
+#include <sys/list.h>
 #include <sys/mutex.h>
 #include <sys/proc.h>
 
@@ -127,6 +128,7 @@ struct kstat_s {
 	kmutex_t	ks_private_lock;	/* kstat private data lock */
 	kmutex_t	*ks_lock;		/* kstat data lock */
 	struct list_head ks_list;		/* kstat linkage */
+	list_node_t	ks_node;		/* kstat_walk_named() linkage */
 	kstat_module_t	*ks_owner;		/* kstat module linkage */
 	kstat_raw_ops_t	ks_raw_ops;		/* ops table for raw type */
 	char		*ks_raw_buf;		/* buf used for raw ops */
@@ -193,6 +195,10 @@ typedef struct kstat_timer {
 int spl_kstat_init(void);
 void spl_kstat_fini(void);
 
+typedef int kstat_walk_cb_t(kstat_t *ksp, const char *name, void *arg);
+extern int kstat_walk_named(const char *module, kstat_walk_cb_t *cb,
+    void *arg);
+
 extern void __kstat_set_raw_ops(kstat_t *ksp,
     int (*headers)(char *buf, size_t size),
     int (*data)(char *buf, size_t size, void *data),
@@ -190,6 +190,32 @@ zfs_shani_available(void)
 	return (has_shani && __ymm_enabled());
 }
 
+/*
+ * Check if VAES instruction set is available
+ */
+static inline boolean_t
+zfs_vaes_available(void)
+{
+	boolean_t has_vaes;
+
+	has_vaes = (cpu_stdext_feature2 & CPUID_STDEXT2_VAES) != 0;
+
+	return (has_vaes && __ymm_enabled());
+}
+
+/*
+ * Check if VPCLMULQDQ instruction set is available
+ */
+static inline boolean_t
+zfs_vpclmulqdq_available(void)
+{
+	boolean_t has_vpclmulqdq;
+
+	has_vpclmulqdq = (cpu_stdext_feature2 & CPUID_STDEXT2_VPCLMULQDQ) != 0;
+
+	return (has_vpclmulqdq && __ymm_enabled());
+}
+
 /*
  * AVX-512 family of instruction sets:
  *
@@ -81,6 +81,13 @@ extern "C" {
 #define	kpreempt_enable() critical_exit()
 #define	CPU_SEQID curcpu
 #define	CPU_SEQID_UNSTABLE curcpu
+#ifdef _STANDALONE
+#define	max_nnodes 1
+#define	CPU_NODEID 0
+#else /* _STANDALONE */
+#define	max_nnodes MAXMEMDOM
+#define	CPU_NODEID PCPU_GET(domain)
+#endif /* _STANDALONE */
 #define	is_system_labeled()		0
 /*
  * Convert a single byte to/from binary-coded decimal (BCD).
@@ -109,6 +109,7 @@ extern void taskq_wait(taskq_t *);
 extern int taskq_cancel_id(taskq_t *, taskqid_t);
 extern int taskq_member(taskq_t *, kthread_t *);
 extern taskq_t *taskq_of_curthread(void);
+extern boolean_t taskq_busy(taskq_t *);
 void	taskq_suspend(taskq_t *);
 int	taskq_suspended(taskq_t *);
 void	taskq_resume(taskq_t *);
@@ -624,6 +624,31 @@ bdev_secure_discard_supported(struct block_device *bdev)
 #endif
 }
 
+/*
+ * Discard limits of the device, in bytes.  Discards should be aligned to
+ * and a multiple of the granularity, and no larger than the maximum.
+ */
+static inline uint64_t
+bdev_discard_granularity_bytes(struct block_device *bdev)
+{
+#if defined(HAVE_BDEV_MAX_DISCARD_SECTORS)
+	return (bdev_discard_granularity(bdev));
+#else
+	return (bdev_get_queue(bdev)->limits.discard_granularity);
+#endif
+}
+
+static inline uint64_t
+bdev_max_discard_bytes(struct block_device *bdev)
+{
+#if defined(HAVE_BDEV_MAX_DISCARD_SECTORS)
+	return ((uint64_t)bdev_max_discard_sectors(bdev) << 9);
+#else
+	return ((uint64_t)
+	    bdev_get_queue(bdev)->limits.max_discard_sectors << 9);
+#endif
+}
+
 /*
  * A common holder for vdev_bdev_open() is used to relax the exclusive open
  * semantics slightly.  Internal vdev disk callers may pass VDEV_HOLDER to
@@ -85,6 +85,8 @@ extern struct rw_semaphore spl_kmem_cache_sem;
 #else
 #define	SPL_KMEM_CACHE_MAX_SIZE		4	/* Max slab size in MB */
 #endif
+#define	SPL_MAGAZINE_MAX		1024	/* Max objects per magazine */
+#define	SPL_MAGAZINE_MAX_BYTES		(4 << 20) /* Max grown magazine */
 
 #define	SPL_MAX_ORDER			(MAX_ORDER - 3)
 #define	SPL_MAX_ORDER_NR_PAGES		(1 << (SPL_MAX_ORDER - 1))
@@ -144,6 +146,12 @@ typedef struct spl_kmem_cache {
 	spl_kmem_magazine_t	**skc_mag;	/* Per-CPU warm cache */
 	uint32_t		skc_mag_size;	/* Magazine size */
 	uint32_t		skc_mag_refill;	/* Magazine refill count */
+	uint32_t		skc_mag_size_max; /* Magazine capacity */
+	unsigned long		skc_mag_adapt;	/* Last resize check */
+	uint64_t		skc_mag_resize;	/* Magazine resizes */
+	uint64_t		skc_depot_ops;	/* Magazine refills/flushes */
+	uint64_t		skc_depot_contended; /* Depot lock contended */
+	uint64_t		skc_depot_mark;	/* Contended at last check */
 	spl_kmem_ctor_t		skc_ctor;	/* Constructor */
 	spl_kmem_dtor_t		skc_dtor;	/* Destructor */
 	void			*skc_private;	/* Private data */
@@ -101,6 +101,7 @@ typedef struct kstat_proc_entry {
 	char	kpe_name[KSTAT_STRLEN];		/* kstat name */
 	char	kpe_module[KSTAT_STRLEN];	/* provider module name */
 	kstat_module_t		*kpe_owner;	/* kstat module linkage */
+	kstat_t			*kpe_kstat;	/* kstat, if it is one */
 	struct list_head	kpe_list;	/* kstat linkage */
 	struct proc_dir_entry	*kpe_proc;	/* procfs entry */
 } kstat_proc_entry_t;
@@ -189,6 +190,10 @@ typedef struct kstat_timer {
 int spl_kstat_init(void);
 void spl_kstat_fini(void);
 
+typedef int kstat_walk_cb_t(kstat_t *ksp, const char *name, void *arg);
+extern int kstat_walk_named(const char *module, kstat_walk_cb_t *cb,
+    void *arg);
+
 extern void __kstat_set_raw_ops(kstat_t *ksp,
     int (*headers)(char *buf, size_t size),
     int (*data)(char *buf, size_t size, void *data),
@@ -32,6 +32,8 @@
  * compatibility wrapper should be used.
  *
  *   shrinker = spl_register_shrinker(name, countfunc, scanfunc, seek_cost);
+ *   shrinker = spl_register_shrinker_flags(name, countfunc, scanfunc,
+ *       seek_cost, flags);
  *   spl_unregister_shrinker(shrinker);
  *
  * spl_register_shrinker is used to create and register a shrinker with the
@@ -41,6 +43,10 @@
  * The callbacks can return SHRINK_STOP if further calls can't make any more
  * progress.  Note that a return value of SHRINK_EMPTY is currently not
  * supported.
+ * spl_register_shrinker_flags additionally takes shrinker flags; currently
+ * only SHRINKER_NUMA_AWARE is meaningful, in which case sc->nid holds the
+ * node being reclaimed and the callbacks should count and free objects on
+ * that node only.
  *
  * Example:
  *
@@ -75,6 +81,9 @@ typedef unsigned long (*spl_shrinker_cb)
 
 struct shrinker *spl_register_shrinker(const char *name,
     spl_shrinker_cb countfunc, spl_shrinker_cb scanfunc, int seek_cost);
+struct shrinker *spl_register_shrinker_flags(const char *name,
+    spl_shrinker_cb countfunc, spl_shrinker_cb scanfunc, int seek_cost,
+    unsigned int flags);
 void spl_unregister_shrinker(struct shrinker *);
 
 #ifndef SHRINK_STOP
@@ -82,4 +91,9 @@ void spl_unregister_shrinker(struct shrinker *);
 #define	SHRINK_STOP	(-1)
 #endif
 
+#ifndef SHRINKER_NUMA_AWARE
+/* 3.0-3.11 compatibility; node-aware reclaim isn't available */
+#define	SHRINKER_NUMA_AWARE	0
+#endif
+
 #endif /* SPL_SHRINKER_H */
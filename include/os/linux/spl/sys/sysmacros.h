@@ -28,6 +28,8 @@
 #include <linux/sched.h>
 #include <linux/sched/rt.h>
 #include <linux/cpumask.h>
+#include <linux/nodemask.h>
+#include <linux/topology.h>
 #include <sys/debug.h>
 #include <sys/zone.h>
 #include <sys/signal.h>
@@ -77,6 +79,8 @@
 #define	boot_ncpus			num_online_cpus()
 #define	CPU_SEQID			smp_processor_id()
 #define	CPU_SEQID_UNSTABLE		raw_smp_processor_id()
+#define	max_nnodes			nr_node_ids
+#define	CPU_NODEID			numa_node_id()
 #define	is_system_labeled()		0
 
 #ifndef RLIM64_INFINITY
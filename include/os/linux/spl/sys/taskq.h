@@ -33,6 +33,7 @@
 #include <sys/thread.h>
 #include <sys/rwlock.h>
 #include <sys/wait.h>
+#include <sys/time.h>
 
 #define	TASKQ_NAMELEN		31
 
@@ -74,6 +75,13 @@ typedef enum tq_lock_role {
 typedef unsigned long taskqid_t;
 typedef void (task_func_t)(void *);
 
+/*
+ * Number of power-of-two buckets in the per-taskq wait and run time
+ * histograms reported by /proc/spl/taskq-stats.  The first bucket counts
+ * durations below 1024ns and the last one everything from 2^33ns up.
+ */
+#define	TASKQ_STAT_BUCKETS	25
+
 typedef struct taskq {
 	spinlock_t		tq_lock;	/* protects taskq_t */
 	char			*tq_name;	/* taskq name */
@@ -105,6 +113,13 @@ typedef struct taskq {
 	struct hlist_node	tq_hp_cb_node;
 	boolean_t		tq_hp_support;
 	unsigned long		lastspawnstop;	/* when to purge dynamic */
+	/* statistics, protected by tq_lock */
+	hrtime_t		tq_stat_start;	/* creation time */
+	uint64_t		tq_stat_tasks;	/* # of tasks run */
+	hrtime_t		tq_stat_busy;	/* time spent running tasks */
+	hrtime_t		tq_stat_thread;	/* lifetime of exited threads */
+	uint64_t		tq_stat_wait[TASKQ_STAT_BUCKETS];
+	uint64_t		tq_stat_run[TASKQ_STAT_BUCKETS];
 } taskq_t;
 
 typedef struct taskq_ent {
@@ -118,6 +133,7 @@ typedef struct taskq_ent {
 	taskq_t			*tqent_taskq;
 	uintptr_t		tqent_flags;
 	unsigned long		tqent_birth;
+	hrtime_t		tqent_hrbirth;	/* when made runnable */
 } taskq_ent_t;
 
 #define	TQENT_FLAG_PREALLOC	0x1
@@ -131,6 +147,7 @@ typedef struct taskq_thread {
 	taskqid_t		tqt_id;
 	taskq_ent_t		*tqt_task;
 	uintptr_t		tqt_flags;
+	hrtime_t		tqt_born;	/* when the thread started */
 } taskq_thread_t;
 
 /* Global system-wide dynamic task queue available for all consumers */
@@ -159,6 +176,7 @@ extern void taskq_wait(taskq_t *);
 extern int taskq_cancel_id(taskq_t *, taskqid_t);
 extern int taskq_member(taskq_t *, kthread_t *);
 extern taskq_t *taskq_of_curthread(void);
+extern boolean_t taskq_busy(taskq_t *);
 
 #define	taskq_create_proc(name, nthreads, pri, min, max, proc, flags) \
     taskq_create(name, nthreads, pri, min, max, flags)
@@ -87,6 +87,9 @@ typedef struct zfs_uio {
 #define	zfs_uio_fault_move(p, n, rw, u)	zfs_uiomove((p), (n), (rw), (u))
 
 extern int zfs_uio_prefaultpages(ssize_t, zfs_uio_t *);
+extern int zfs_uio_get_pages(zfs_uio_t *, size_t, struct page **, int,
+    size_t *);
+extern void zfs_uio_put_pages(struct page **, int);
 
 static inline void
 zfs_uio_setoffset(zfs_uio_t *uio, offset_t off)
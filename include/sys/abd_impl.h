@@ -77,6 +77,9 @@ extern abd_t *abd_zero_scatter;
 abd_t *abd_gang_get_offset(abd_t *, size_t *);
 abd_t *abd_alloc_struct(size_t);
 void abd_free_struct(abd_t *);
+#if defined(__linux__) && defined(_KERNEL)
+void abd_free_from_pages(abd_t *);
+#endif
 
 /*
  * OS specific functions
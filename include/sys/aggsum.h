@@ -51,6 +51,7 @@ int64_t aggsum_lower_bound(aggsum_t *);
 uint64_t aggsum_upper_bound(aggsum_t *);
 int aggsum_compare(aggsum_t *, uint64_t);
 uint64_t aggsum_value(aggsum_t *);
+uint64_t aggsum_value_approx(aggsum_t *, uint64_t);
 void aggsum_add(aggsum_t *, int64_t);
 
 #ifdef	__cplusplus
@@ -69,6 +69,7 @@ extern "C" {
 typedef struct arc_buf_hdr arc_buf_hdr_t;
 typedef struct arc_buf arc_buf_t;
 typedef struct arc_prune arc_prune_t;
+typedef struct arc_tenant arc_tenant_t;
 
 /*
  * Because the ARC can store encrypted data, errors (not due to bugs) may arise
@@ -86,6 +87,7 @@ typedef void arc_prune_func_t(uint64_t bytes, void *priv);
 /* Shared module parameters */
 extern uint_t zfs_arc_average_blocksize;
 extern int l2arc_exclude_special;
+extern uint64_t l2arc_exclude_ot;
 
 /* generic arc_done_func_t's which you can use */
 arc_read_done_func_t arc_bcopy_func;
@@ -189,7 +191,12 @@ typedef enum arc_buf_flags {
 	 * indicates whether this arc_buf_t is encrypted, regardless of
 	 * state on-disk
 	 */
-	ARC_BUF_FLAG_ENCRYPTED		= 1 << 2
+	ARC_BUF_FLAG_ENCRYPTED		= 1 << 2,
+	/*
+	 * this arc_buf_t is held by the ARC's cache of decompressed copies,
+	 * not by a consumer
+	 */
+	ARC_BUF_FLAG_DCACHE		= 1 << 3
 } arc_buf_flags_t;
 
 struct arc_buf {
@@ -287,8 +294,10 @@ void arc_buf_info(arc_buf_t *buf, arc_buf_info_t *abi, int state_index);
 uint64_t arc_buf_size(arc_buf_t *buf);
 uint64_t arc_buf_lsize(arc_buf_t *buf);
 void arc_buf_access(arc_buf_t *buf);
+boolean_t arc_admit(spa_t *spa, const blkptr_t *bp, boolean_t count);
 void arc_release(arc_buf_t *buf, const void *tag);
 int arc_released(arc_buf_t *buf);
+boolean_t arc_buf_is_mfu(arc_buf_t *buf);
 void arc_buf_sigsegv(int sig, siginfo_t *si, void *unused);
 void arc_buf_freeze(arc_buf_t *buf);
 void arc_buf_thaw(arc_buf_t *buf);
@@ -309,6 +318,11 @@ zio_t *arc_write(zio_t *pio, spa_t *spa, uint64_t txg, blkptr_t *bp,
 
 arc_prune_t *arc_add_prune_callback(arc_prune_func_t *func, void *priv);
 void arc_remove_prune_callback(arc_prune_t *p);
+arc_tenant_t *arc_tenant_alloc(void);
+void arc_tenant_rele(arc_tenant_t *at);
+void arc_tenant_set_limits(arc_tenant_t *at, uint64_t min, uint64_t max);
+uint64_t arc_tenant_size(arc_tenant_t *at);
+void arc_buf_set_tenant(arc_buf_t *buf, arc_tenant_t *at);
 void arc_freed(spa_t *spa, const blkptr_t *bp);
 
 void arc_flush(spa_t *spa, boolean_t retry);
@@ -321,6 +335,7 @@ uint64_t arc_target_bytes(void);
 void arc_set_limits(uint64_t);
 void arc_init(void);
 void arc_fini(void);
+void arc_warm_start(spa_t *spa);
 
 /*
  * Level 2 ARC
@@ -334,8 +349,6 @@ boolean_t l2arc_range_check_overlap(uint64_t bottom, uint64_t top,
     uint64_t check);
 void l2arc_init(void);
 void l2arc_fini(void);
-void l2arc_start(void);
-void l2arc_stop(void);
 void l2arc_spa_rebuild_start(spa_t *spa);
 
 #ifndef _KERNEL
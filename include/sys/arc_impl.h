@@ -96,6 +96,17 @@ typedef struct arc_state {
 	wmsum_t arcs_hits[ARC_BUFC_NUMTYPES];
 } arc_state_t;
 
+/*
+ * Per-dataset ARC usage, see arc_buf_set_tenant().
+ */
+struct arc_tenant {
+	list_node_t	at_node;
+	uint64_t	at_refcnt;	/* one per header, plus the owner */
+	uint64_t	at_size;	/* bytes held in the MRU and MFU */
+	uint64_t	at_min;		/* protected from eviction up to this */
+	uint64_t	at_max;		/* trimmed back to this if set */
+};
+
 typedef struct arc_callback arc_callback_t;
 
 struct arc_callback {
@@ -170,6 +181,8 @@ typedef struct l1arc_buf_hdr {
 	uint32_t		b_mfu_hits;
 	uint32_t		b_mfu_ghost_hits;
 	uint8_t			b_byteswap;
+	/* NUMA node of b_pabd; fixed while on a state list */
+	uint8_t			b_node;
 	arc_buf_t		*b_buf;
 
 	/* self protecting */
@@ -178,6 +191,9 @@ typedef struct l1arc_buf_hdr {
 	arc_callback_t		*b_acb;
 	abd_t			*b_pabd;
 
+	/* protected by hash lock, set once */
+	arc_tenant_t		*b_tenant;
+
 #ifdef ZFS_DEBUG
 	zio_cksum_t		*b_freeze_cksum;
 	kmutex_t		b_freeze_lock;
@@ -364,6 +380,34 @@ typedef struct l2arc_lb_ptr_buf {
 #define	L2BLK_GET_STATE(field)		BF64_GET((field), 57, 4)
 #define	L2BLK_SET_STATE(field, x)	BF64_SET((field), 57, 4, x)
 
+/*
+ * On-disk format of the ARC warm-start object (see arc_warm_start()). A
+ * header is followed by one entry for each block that was resident in the
+ * MFU state when the object was written. Entries use the L2BLK_* macros
+ * above for awe_prop.
+ */
+typedef struct arc_warm_phys {
+	uint64_t	awp_magic;	/* ARC_WARM_MAGIC */
+	uint64_t	awp_version;	/* ARC_WARM_VERSION */
+	uint64_t	awp_byteorder;	/* ZFS_HOST_BYTEORDER of the writer */
+	uint64_t	awp_txg;	/* txg the object was written in */
+	uint64_t	awp_count;	/* number of entries that follow */
+	uint64_t	awp_pad[3];	/* pad to 64 bytes */
+} arc_warm_phys_t;
+
+typedef struct arc_warm_ent_phys {
+	dva_t		awe_dva;	/* dva of the block */
+	uint64_t	awe_birth;	/* physical birth txg */
+	uint64_t	awe_prop;	/* sizes, compression and type */
+	zio_cksum_t	awe_cksum;	/* fletcher4 of the on-disk data */
+} arc_warm_ent_phys_t;
+
+_Static_assert(sizeof (arc_warm_phys_t) == sizeof (arc_warm_ent_phys_t),
+	"arc_warm_phys_t and arc_warm_ent_phys_t differ in size");
+
+#define	ARC_WARM_MAGIC		0x4152435741524d53LLU	/* ASCII: "ARCWARMS" */
+#define	ARC_WARM_VERSION	1
+
 #define	PTR_SWAP(x, y)		\
 	do {			\
 		void *tmp = (x);\
@@ -420,6 +464,13 @@ typedef struct l2arc_dev {
 	 */
 	zfs_refcount_t		l2ad_lb_count;
 	boolean_t		l2ad_trim_all; /* TRIM whole device */
+	/*
+	 * Each device is fed by its own l2arc_feed_thread().
+	 */
+	kthread_t		*l2ad_feed_thread;
+	kmutex_t		l2ad_feed_lock;
+	kcondvar_t		l2ad_feed_cv;
+	boolean_t		l2ad_feed_exit;
 } l2arc_dev_t;
 
 /*
@@ -452,12 +503,15 @@ typedef struct arc_buf_hdr_crypt {
 	uint8_t			b_mac[ZIO_DATA_MAC_LEN];
 } arc_buf_hdr_crypt_t;
 
+/*
+ * The L2ARC hit count and ARC state of a buffer are kept in spare bytes of
+ * arc_buf_hdr_t (b_l2hits, b_l2arcs_state) rather than here, which keeps
+ * every header, and in particular the L2ARC-only ones, 8 bytes smaller.
+ */
 typedef struct l2arc_buf_hdr {
 	/* protected by arc_buf_hdr mutex */
 	l2arc_dev_t		*b_dev;		/* L2ARC device */
 	uint64_t		b_daddr;	/* disk address, offset byte */
-	uint32_t		b_hits;
-	arc_state_type_t	b_arcs_state;
 	list_node_t		b_l2node;
 } l2arc_buf_hdr_t;
 
@@ -475,8 +529,9 @@ struct arc_buf_hdr {
 
 	arc_buf_contents_t	b_type;
 	uint8_t			b_complevel;
-	uint8_t			b_reserved1; /* used for 4 byte alignment */
-	uint16_t		b_reserved2; /* used for 4 byte alignment */
+	/* L2ARC fields. Undefined when not in L2ARC. */
+	uint8_t			b_l2arcs_state;	/* arc_state_type_t */
+	uint16_t		b_l2hits;	/* saturates at UINT16_MAX */
 	arc_buf_hdr_t		*b_hash_next;
 	arc_flags_t		b_flags;
 
@@ -546,6 +601,32 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_mfu_hits;
 	kstat_named_t arcstat_mfu_ghost_hits;
 	kstat_named_t arcstat_uncached_hits;
+	/*
+	 * Reads from cacheadmit=frequent datasets not admitted to the ARC,
+	 * see arc_admit().
+	 */
+	kstat_named_t arcstat_admit_rejected;
+	/*
+	 * Number of times an uncompressed buffer was filled by copying from
+	 * a decompressed copy held by the ARC (see arc_dcache_keep()), rather
+	 * than by decompressing the header's data.
+	 */
+	kstat_named_t arcstat_dcache_hits;
+	/*
+	 * Number of times an uncompressed buffer had to be decompressed.
+	 */
+	kstat_named_t arcstat_dcache_misses;
+	/*
+	 * Bytes of decompressed copies held by the ARC.
+	 */
+	kstat_named_t arcstat_dcache_size;
+	/*
+	 * Number of blocks recorded in ARC warm-start checkpoints, and the
+	 * number of those blocks prefetched back into the ARC at import
+	 * (see arc_warm_start()).
+	 */
+	kstat_named_t arcstat_warm_saved;
+	kstat_named_t arcstat_warm_prefetched;
 	kstat_named_t arcstat_deleted;
 	/*
 	 * Number of buffers that could not be evicted because the hash lock
@@ -570,12 +651,26 @@ typedef struct arc_stats {
 	 * buffers to reach its target amount.
 	 */
 	kstat_named_t arcstat_evict_not_enough;
+	/*
+	 * Number of arc_evict_state() passes that were split between the
+	 * threads of the arc_evict taskq.
+	 */
+	kstat_named_t arcstat_evict_parallel;
 	kstat_named_t arcstat_evict_l2_cached;
 	kstat_named_t arcstat_evict_l2_eligible;
 	kstat_named_t arcstat_evict_l2_eligible_mfu;
 	kstat_named_t arcstat_evict_l2_eligible_mru;
 	kstat_named_t arcstat_evict_l2_ineligible;
 	kstat_named_t arcstat_evict_l2_skip;
+	/*
+	 * Number of buffers skipped during eviction because their dataset
+	 * was at or below its arcmin.
+	 */
+	kstat_named_t arcstat_evict_tenant_skip;
+	/*
+	 * Bytes evicted because their dataset was above its arcmax.
+	 */
+	kstat_named_t arcstat_evict_tenant_over;
 	kstat_named_t arcstat_hash_elements;
 	kstat_named_t arcstat_hash_elements_max;
 	kstat_named_t arcstat_hash_collisions;
@@ -584,6 +679,16 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_meta;
 	kstat_named_t arcstat_pd;
 	kstat_named_t arcstat_pm;
+	/*
+	 * Weights, in percent, last applied to ghost hits of each type and
+	 * state when adjusting meta, pd and pm.
+	 */
+	kstat_named_t arcstat_meta_gain;
+	kstat_named_t arcstat_data_gain;
+	kstat_named_t arcstat_mru_data_gain;
+	kstat_named_t arcstat_mfu_data_gain;
+	kstat_named_t arcstat_mru_meta_gain;
+	kstat_named_t arcstat_mfu_meta_gain;
 	kstat_named_t arcstat_c;
 	kstat_named_t arcstat_c_min;
 	kstat_named_t arcstat_c_max;
@@ -804,6 +909,16 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_l2_evict_l1cached;
 	kstat_named_t arcstat_l2_free_on_write;
 	kstat_named_t arcstat_l2_abort_lowmem;
+	/*
+	 * Number of times l2arc_exclusive held back the eviction of a buffer
+	 * so that the L2ARC feed could write it out first.
+	 */
+	kstat_named_t arcstat_l2_demote_deferred;
+	/*
+	 * Number of L2ARC copies dropped by l2arc_exclusive when the buffer
+	 * was read back into the ARC.
+	 */
+	kstat_named_t arcstat_l2_exclusive_drops;
 	kstat_named_t arcstat_l2_cksum_bad;
 	kstat_named_t arcstat_l2_io_error;
 	kstat_named_t arcstat_l2_lsize;
@@ -908,6 +1023,12 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_raw_size;
 	kstat_named_t arcstat_cached_only_in_progress;
 	kstat_named_t arcstat_abd_chunk_waste_size;
+	/*
+	 * Number of times a lock of one of the ARC states' eviction lists
+	 * was found held by another thread.  A high rate on a system with
+	 * many CPUs suggests raising zfs_multilist_num_sublists.
+	 */
+	kstat_named_t arcstat_evict_list_contended;
 } arc_stats_t;
 
 typedef struct arc_sums {
@@ -931,17 +1052,25 @@ typedef struct arc_sums {
 	wmsum_t arcstat_mfu_hits;
 	wmsum_t arcstat_mfu_ghost_hits;
 	wmsum_t arcstat_uncached_hits;
+	wmsum_t arcstat_admit_rejected;
+	wmsum_t arcstat_dcache_hits;
+	wmsum_t arcstat_dcache_misses;
+	wmsum_t arcstat_warm_saved;
+	wmsum_t arcstat_warm_prefetched;
 	wmsum_t arcstat_deleted;
 	wmsum_t arcstat_mutex_miss;
 	wmsum_t arcstat_access_skip;
 	wmsum_t arcstat_evict_skip;
 	wmsum_t arcstat_evict_not_enough;
+	wmsum_t arcstat_evict_parallel;
 	wmsum_t arcstat_evict_l2_cached;
 	wmsum_t arcstat_evict_l2_eligible;
 	wmsum_t arcstat_evict_l2_eligible_mfu;
 	wmsum_t arcstat_evict_l2_eligible_mru;
 	wmsum_t arcstat_evict_l2_ineligible;
 	wmsum_t arcstat_evict_l2_skip;
+	wmsum_t arcstat_evict_tenant_skip;
+	wmsum_t arcstat_evict_tenant_over;
 	wmsum_t arcstat_hash_collisions;
 	wmsum_t arcstat_hash_chains;
 	aggsum_t arcstat_size;
@@ -974,6 +1103,8 @@ typedef struct arc_sums {
 	wmsum_t arcstat_l2_evict_l1cached;
 	wmsum_t arcstat_l2_free_on_write;
 	wmsum_t arcstat_l2_abort_lowmem;
+	wmsum_t arcstat_l2_demote_deferred;
+	wmsum_t arcstat_l2_exclusive_drops;
 	wmsum_t arcstat_l2_cksum_bad;
 	wmsum_t arcstat_l2_io_error;
 	wmsum_t arcstat_l2_lsize;
@@ -1059,6 +1190,10 @@ extern uint64_t zfs_arc_min;
 extern uint64_t zfs_arc_max;
 
 extern void arc_reduce_target_size(int64_t to_free);
+extern uint64_t arc_size_approx(void);
+extern uint_t arc_nnodes;
+extern uint64_t arc_node_evictable(int node);
+extern uint64_t arc_evict_node(int node, uint64_t bytes);
 extern boolean_t arc_reclaim_needed(void);
 extern void arc_kmem_reap_soon(void);
 extern void arc_wait_for_eviction(uint64_t, boolean_t);
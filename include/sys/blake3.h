@@ -33,6 +33,7 @@
 #else
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/types.h>
 #endif
 
 #ifdef __cplusplus
@@ -92,6 +93,13 @@ void Blake3_Final(const BLAKE3_CTX *ctx, uint8_t *out);
 void Blake3_FinalSeek(const BLAKE3_CTX *ctx, uint64_t seek, uint8_t *out,
     size_t out_len);
 
+/*
+ * hash several messages of the same length at once, see blake3.c for the
+ * restrictions; returns B_FALSE if they can't be hashed this way
+ */
+boolean_t Blake3_HashMany(const BLAKE3_CTX *ctx, const uint8_t * const *inputs,
+    size_t n, size_t len, uint8_t *cvs, uint8_t *out);
+
 /* these are pre-allocated contexts */
 extern void **blake3_per_cpu_ctx;
 extern void blake3_per_cpu_ctx_init(void);
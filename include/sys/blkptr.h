@@ -32,6 +32,91 @@ void encode_embedded_bp_compressed(blkptr_t *, void *,
 void decode_embedded_bp_compressed(const blkptr_t *, void *);
 int decode_embedded_bp(const blkptr_t *, void *, int);
 
+/*
+ * The commonly used properties of a block pointer, decoded in a single
+ * pass by bp_view().  Each BP_GET_*() macro loads and tests blk_prop on
+ * its own, and the compiler has to reload it whenever a result is stored
+ * through a pointer which might alias the block pointer.  Code which
+ * needs several properties of the same bp can decode them all at once.
+ * The values are those the corresponding BP_GET_*() and BP_IS_*() macros
+ * would return.
+ */
+typedef struct blkptr_view {
+	uint64_t	bpv_lsize;		/* BP_GET_LSIZE() */
+	uint64_t	bpv_psize;		/* BP_GET_PSIZE() */
+	uint64_t	bpv_birth;		/* BP_GET_BIRTH() */
+	uint64_t	bpv_logical_birth;	/* BP_GET_LOGICAL_BIRTH() */
+	uint8_t		bpv_type;		/* BP_GET_TYPE() */
+	uint8_t		bpv_level;		/* BP_GET_LEVEL() */
+	uint8_t		bpv_compress;		/* BP_GET_COMPRESS() */
+	uint8_t		bpv_checksum;		/* BP_GET_CHECKSUM() */
+	uint8_t		bpv_ndvas;		/* BP_GET_NDVAS() */
+	boolean_t	bpv_embedded;		/* BP_IS_EMBEDDED() */
+	boolean_t	bpv_redacted;		/* BP_IS_REDACTED() */
+	boolean_t	bpv_hole;		/* BP_IS_HOLE() */
+	boolean_t	bpv_gang;		/* BP_IS_GANG() */
+	boolean_t	bpv_crypt;		/* BP_USES_CRYPT() */
+	boolean_t	bpv_dedup;		/* BP_GET_DEDUP() */
+} blkptr_view_t;
+
+static inline void
+bp_view(const blkptr_t *bp, blkptr_view_t *bpv)
+{
+	const uint64_t prop = bp->blk_prop;
+	const dva_t *dva = bp->blk_dva;
+
+	bpv->bpv_type = BF64_GET(prop, 48, 8);
+	bpv->bpv_level = BF64_GET(prop, 56, 5);
+	bpv->bpv_compress = BF64_GET(prop, 32, SPA_COMPRESSBITS);
+	bpv->bpv_crypt = BF64_GET(prop, 61, 1);
+	bpv->bpv_dedup = BF64_GET(prop, 62, 1);
+	bpv->bpv_embedded = BF64_GET(prop, 39, 1);
+	bpv->bpv_logical_birth = BP_GET_LOGICAL_BIRTH(bp);
+
+	if (unlikely(bpv->bpv_embedded)) {
+		uint64_t etype = BF64_GET(prop, 40, 8);
+
+		bpv->bpv_lsize = (etype == BP_EMBEDDED_TYPE_DATA) ?
+		    BF64_GET_SB(prop, 0, 25, 0, 1) : 0;
+		bpv->bpv_psize = 0;
+		bpv->bpv_birth = 0;
+		bpv->bpv_checksum = ZIO_CHECKSUM_OFF;
+		bpv->bpv_ndvas = 0;
+		bpv->bpv_redacted = (etype == BP_EMBEDDED_TYPE_REDACTED);
+		bpv->bpv_hole = B_FALSE;
+		bpv->bpv_gang = B_FALSE;
+		return;
+	}
+
+	uint64_t pbirth = BP_GET_PHYSICAL_BIRTH(bp);
+
+	bpv->bpv_lsize = BF64_GET_SB(prop, 0, SPA_LSIZEBITS,
+	    SPA_MINBLOCKSHIFT, 1);
+	bpv->bpv_psize = BF64_GET_SB(prop, 16, SPA_PSIZEBITS,
+	    SPA_MINBLOCKSHIFT, 1);
+	bpv->bpv_checksum = BF64_GET(prop, 40, 8);
+	bpv->bpv_birth = (pbirth != 0) ? pbirth : bpv->bpv_logical_birth;
+	bpv->bpv_redacted = B_FALSE;
+	bpv->bpv_hole = DVA_IS_EMPTY(&dva[0]);
+	bpv->bpv_gang = DVA_GET_GANG(&dva[0]);
+
+	/*
+	 * Most blocks have a single copy, in which case the other DVAs are
+	 * empty and there is no need to work out whether the third one
+	 * holds the salt and IV of an encrypted block.
+	 */
+	if (likely(DVA_IS_EMPTY(&dva[1]) && DVA_IS_EMPTY(&dva[2]))) {
+		bpv->bpv_ndvas = DVA_IS_VALID(&dva[0]);
+	} else {
+		boolean_t encrypted = bpv->bpv_crypt &&
+		    bpv->bpv_level == 0 && DMU_OT_IS_ENCRYPTED(bpv->bpv_type);
+
+		bpv->bpv_ndvas = DVA_IS_VALID(&dva[0]) +
+		    DVA_IS_VALID(&dva[1]) +
+		    (DVA_IS_VALID(&dva[2]) && !encrypted);
+	}
+}
+
 #ifdef	__cplusplus
 }
 #endif
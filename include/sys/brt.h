@@ -42,6 +42,7 @@ extern uint64_t brt_get_dspace(spa_t *spa);
 extern uint64_t brt_get_used(spa_t *spa);
 extern uint64_t brt_get_saved(spa_t *spa);
 extern uint64_t brt_get_ratio(spa_t *spa);
+extern int brt_get_sample_stats(spa_t *spa, uint64_t samples, nvlist_t *nvl);
 
 extern boolean_t brt_maybe_exists(spa_t *spa, const blkptr_t *bp);
 extern void brt_init(void);
@@ -33,6 +33,7 @@ extern "C" {
  * BRT - Block Reference Table.
  */
 #define	BRT_OBJECT_VDEV_PREFIX	"com.fudosecurity:brt:vdev:"
+#define	BRT_OBJECT_BLOOM_PREFIX	"org.openzfs:brt:bloom:"
 
 /*
  * We divide each VDEV into 16MB chunks. Each chunk is represented in memory
@@ -76,6 +77,35 @@ _Static_assert(BRT_RANGESIZE / SPA_MINBLOCKSIZE <= UINT16_MAX,
 #define	BRT_NON_NATIVE_BYTEORDER	BRT_LITTLE_ENDIAN
 #endif
 
+/*
+ * With the brt_filter feature, each VDEV also has a blocked Bloom filter of
+ * the offsets that have BRT entries. It is checked after bv_entcount[], and
+ * lets us skip the entries ZAP for most blocks in a region that has some
+ * cloned blocks but not this one. Each offset sets BRT_BLOOM_HASHES bits
+ * within a single 512-bit block of the filter, so a check touches only one
+ * cache line. The filter is sized for BRT_BLOOM_BITS_PER_ENTRY bits per
+ * entry (about a 2% false positive rate when full), and is rebuilt from the
+ * entries ZAP, at twice the size, once more entries have been added to it
+ * than that (removed entries are never cleared, so they count too).
+ */
+#define	BRT_BLOOM_BLOCK_WORDS		8
+#define	BRT_BLOOM_BLOCK_BITS		(BRT_BLOOM_BLOCK_WORDS * 64)
+#define	BRT_BLOOM_HASHES		6
+#define	BRT_BLOOM_BITS_PER_ENTRY	10
+#define	BRT_BLOOM_MIN_BLOCKS		\
+	(BRT_BLOCKSIZE / sizeof (uint64_t) / BRT_BLOOM_BLOCK_WORDS)
+#define	BRT_BLOOM_CAPACITY(nblocks)	\
+	((nblocks) * BRT_BLOOM_BLOCK_BITS / BRT_BLOOM_BITS_PER_ENTRY)
+#define	BRT_BLOOM_SIZE(nblocks)		\
+	((nblocks) * BRT_BLOOM_BLOCK_WORDS * sizeof (uint64_t))
+#define	BRT_BLOOM_NCHUNKS(nblocks)	\
+	((BRT_BLOOM_SIZE(nblocks) - 1) / BRT_BLOCKSIZE + 1)
+
+typedef struct brt_bloom_phys {
+	uint64_t	bbp_nblocks;	/* filter size, in 512-bit blocks */
+	uint64_t	bbp_nentries;	/* entries added since last rebuild */
+} brt_bloom_phys_t;
+
 typedef struct brt_vdev_phys {
 	uint64_t	bvp_mos_entries;
 	uint64_t	bvp_size;
@@ -153,6 +183,23 @@ typedef struct brt_vdev {
 	 */
 	ulong_t		*bv_bitmap;
 	uint64_t	bv_nblocks;
+	/*
+	 * Object number in the MOS for the Bloom filter, or 0 if there isn't
+	 * one (yet). See BRT_BLOOM_BLOCK_WORDS.
+	 */
+	uint64_t	bv_mos_bloom;
+	/*
+	 * In-memory copy of the filter, or NULL if there isn't one, in which
+	 * case only bv_entcount[] is used.
+	 */
+	uint64_t	*bv_bloom;
+	uint64_t	bv_bloom_nblocks;
+	uint64_t	bv_bloom_nentries;
+	/*
+	 * BRT_BLOCKSIZE chunks of the filter changed since the last sync.
+	 */
+	ulong_t		*bv_bloom_bitmap;
+	boolean_t	bv_bloom_dirty;
 } brt_vdev_t;
 
 /*
@@ -179,10 +226,18 @@ typedef struct brt {
 /*
  * In-core brt entry.
  * On-disk we use bre_offset as the key and bre_refcount as the value.
+ *
+ * An entry created by brt_entry_addref() for a block that may already have
+ * an on-disk entry is not read in straight away. Instead, the new references
+ * are counted in bre_pcount, and added to the on-disk refcount when it is
+ * needed (a decref) or at the latest when the table is synced. While
+ * bre_pcount is non-zero, bre_refcount is not valid.
  */
 typedef struct brt_entry {
 	uint64_t	bre_offset;
 	uint64_t	bre_refcount;
+	uint64_t	bre_pcount;	/* references not yet merged */
+	uint64_t	bre_dsize;	/* block dsize, for merged accounting */
 	avl_node_t	bre_node;
 } brt_entry_t;
 
@@ -39,6 +39,12 @@ typedef struct dataset_sum_stats_t {
 	wmsum_t dss_nread;
 	wmsum_t dss_nunlinks;
 	wmsum_t dss_nunlinked;
+	wmsum_t dss_rtime;
+	wmsum_t dss_wtime;
+	wmsum_t dss_sync_writes;
+	wmsum_t dss_sync_wtime;
+	wmsum_t dss_fsyncs;
+	wmsum_t dss_fsync_time;
 } dataset_sum_stats_t;
 
 typedef struct dataset_kstat_values {
@@ -57,16 +63,49 @@ typedef struct dataset_kstat_values {
 	 * entry is removed from the unlinked set
 	 */
 	kstat_named_t dkv_nunlinked;
+	/*
+	 * Time in nanoseconds spent in reads and writes through the ZPL,
+	 * from entry until the data was copied, or for sync writes until it
+	 * was committed to the ZIL.  The sync writes are also counted in
+	 * writes and wtime.
+	 */
+	kstat_named_t dkv_rtime;
+	kstat_named_t dkv_wtime;
+	kstat_named_t dkv_sync_writes;
+	kstat_named_t dkv_sync_wtime;
+	kstat_named_t dkv_fsyncs;
+	kstat_named_t dkv_fsync_time;
 	/*
 	 * Per dataset zil kstats
 	 */
 	zil_kstat_values_t dkv_zil_stats;
 } dataset_kstat_values_t;
 
+/*
+ * Operations with a latency histogram in the objset-0x<id>-latency kstat.
+ * Sync writes are also counted as writes.
+ */
+typedef enum dataset_lat_op {
+	DS_LAT_READ,
+	DS_LAT_WRITE,
+	DS_LAT_SYNC_WRITE,
+	DS_LAT_FSYNC,
+	DS_LAT_LOOKUP,
+	DS_LAT_GETATTR,
+	DS_LAT_OPS
+} dataset_lat_op_t;
+
 typedef struct dataset_kstats {
 	dataset_sum_stats_t dk_sums;
 	zil_sums_t dk_zil_sums;
 	kstat_t *dk_kstats;
+	/*
+	 * One row per dataset_lat_op_t: VDEV_L_HISTO_BUCKETS power-of-two
+	 * nanosecond buckets, then the op index.
+	 */
+	kstat_t *dk_lat_kstat;
+	kmutex_t dk_lat_lock;
+	uint64_t *dk_lat_histo;
 } dataset_kstats_t;
 
 int dataset_kstats_create(dataset_kstats_t *, objset_t *);
@@ -76,6 +115,13 @@ void dataset_kstats_rename(dataset_kstats_t *dk, const char *);
 void dataset_kstats_update_write_kstats(dataset_kstats_t *, int64_t);
 void dataset_kstats_update_read_kstats(dataset_kstats_t *, int64_t);
 
+void dataset_kstats_update_read_time(dataset_kstats_t *, hrtime_t);
+void dataset_kstats_update_write_time(dataset_kstats_t *, hrtime_t,
+    boolean_t);
+void dataset_kstats_update_fsync_kstats(dataset_kstats_t *, hrtime_t);
+void dataset_kstats_update_lookup_time(dataset_kstats_t *, hrtime_t);
+void dataset_kstats_update_getattr_time(dataset_kstats_t *, hrtime_t);
+
 void dataset_kstats_update_nunlinks_kstat(dataset_kstats_t *, int64_t);
 void dataset_kstats_update_nunlinked_kstat(dataset_kstats_t *, int64_t);
 
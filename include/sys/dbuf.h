@@ -57,6 +57,7 @@ extern "C" {
 #define	DB_RF_NO_DECRYPT	(1 << 6)
 #define	DB_RF_PARTIAL_FIRST	(1 << 7)
 #define	DB_RF_PARTIAL_MORE	(1 << 8)
+#define	DB_RF_UNCACHED		(1 << 9)
 
 /*
  * The simplified state transition diagram for dbufs looks like:
@@ -176,6 +177,8 @@ typedef struct dbuf_dirty_record {
 			uint8_t dr_copies;
 			boolean_t dr_nopwrite;
 			boolean_t dr_brtwrite;
+			boolean_t dr_diowrite;
+			boolean_t dr_hot;
 			boolean_t dr_has_raw_params;
 
 			/*
@@ -378,7 +381,8 @@ dmu_buf_impl_t *dbuf_find(struct objset *os, uint64_t object, uint8_t level,
     uint64_t blkid, uint64_t *hash_out);
 
 int dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags);
-void dmu_buf_will_clone(dmu_buf_t *db, dmu_tx_t *tx);
+void dmu_buf_will_clone_or_dio(dmu_buf_t *db, dmu_tx_t *tx);
+boolean_t dmu_buf_direct_bp(dmu_buf_t *db, blkptr_t *bp);
 void dmu_buf_will_not_fill(dmu_buf_t *db, dmu_tx_t *tx);
 void dmu_buf_will_fill(dmu_buf_t *db, dmu_tx_t *tx, boolean_t canfail);
 boolean_t dmu_buf_fill_done(dmu_buf_t *db, dmu_tx_t *tx, boolean_t failed);
@@ -394,6 +398,10 @@ void dmu_buf_write_embedded(dmu_buf_t *dbuf, void *data,
 
 int dmu_lightweight_write_by_dnode(dnode_t *dn, uint64_t offset, abd_t *abd,
     const struct zio_prop *zp, zio_flag_t flags, dmu_tx_t *tx);
+int dmu_write_direct_by_dnode(dnode_t *dn, uint64_t offset, uint64_t size,
+    abd_t *data, dmu_tx_t *tx);
+int dmu_write_direct(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    abd_t *data, dmu_tx_t *tx);
 
 void dmu_buf_redact(dmu_buf_t *dbuf, dmu_tx_t *tx);
 void dbuf_destroy(dmu_buf_impl_t *db);
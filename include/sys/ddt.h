@@ -41,7 +41,8 @@ struct abd;
 
 /*
  * DDT on-disk storage object types. Each one corresponds to specific
- * implementation, see ddt_ops_t. The value itself is not stored on disk.
+ * implementation, see ddt_ops_t. The value itself is only stored on disk in
+ * dedup log records, so new types must be added at the end.
  *
  * When searching for an entry, objects types will be searched in this order.
  *
@@ -50,13 +51,17 @@ struct abd;
  */
 typedef enum {
 	DDT_TYPE_ZAP = 0,	/* ZAP storage object, ddt_zap */
+	DDT_TYPE_FLAT,		/* ZAP storage object, single phys, ddt_zap */
 	DDT_TYPES
 } ddt_type_t;
 
 _Static_assert(DDT_TYPES <= UINT8_MAX,
 	"ddt_type_t must fit in a uint8_t");
 
-/* New and updated entries recieve this type, see ddt_sync_entry() */
+/*
+ * New and updated entries recieve this type, unless they can be stored in
+ * the flat type, see ddt_entry_type()
+ */
 #define	DDT_TYPE_DEFAULT	(DDT_TYPE_ZAP)
 
 /*
@@ -155,7 +160,7 @@ enum ddt_phys_type {
 
 typedef struct {
 	/* key must be first for ddt_key_compare */
-	ddt_key_t	dde_key;			/* ddt_tree key */
+	ddt_key_t	dde_key;			/* dds_tree key */
 	ddt_phys_t	dde_phys[DDT_PHYS_TYPES];	/* on-disk data */
 
 	/* in-flight update IOs */
@@ -168,26 +173,94 @@ typedef struct {
 	ddt_type_t	dde_type;
 	ddt_class_t	dde_class;
 
+	/*
+	 * Storage object the entry is currently held in. Without the dedup
+	 * log this is always the same as dde_type/dde_class; with it, the
+	 * store is only updated when the entry is flushed from the log.
+	 */
+	ddt_type_t	dde_stored_type;
+	ddt_class_t	dde_stored_class;
+
 	uint8_t		dde_flags;	/* load state flags */
 	kcondvar_t	dde_cv;		/* signaled when load completes */
 
-	avl_node_t	dde_node;	/* ddt_tree node */
+	avl_node_t	dde_node;	/* dds_tree node */
 } ddt_entry_t;
 
+/*
+ * In-core copy of an entry held in the dedup log. These are the entries
+ * that have been written to the log but not yet flushed to the storage
+ * objects. See ddt_log.c.
+ */
+typedef struct {
+	/* key must be first for ddt_key_compare */
+	ddt_key_t	ddle_key;
+	ddt_phys_t	ddle_phys[DDT_PHYS_TYPES];
+
+	/* storage type and class the entry is currently held in */
+	ddt_type_t	ddle_type;
+	ddt_class_t	ddle_class;
+
+	avl_node_t	ddle_node;	/* ddl_tree node */
+} ddt_log_entry_t;
+
+/*
+ * In-core state for one of the two dedup logs attached to a DDT.
+ */
+typedef struct {
+	uint64_t	ddl_object;	/* log object id */
+	uint64_t	ddl_flags;	/* DDL_FLAG_* */
+	uint64_t	ddl_length;	/* on-disk log length, in bytes */
+	uint64_t	ddl_first_txg;	/* txg the first entry was logged */
+	ddt_key_t	ddl_checkpoint;	/* last entry flushed, if flushing */
+	avl_tree_t	ddl_tree;	/* entries in the log, by key */
+} ddt_log_t;
+
+/*
+ * One shard of the live entry tree. Entries are spread over the shards by key
+ * hash, so that lookups for different blocks don't all contend on one lock.
+ */
+typedef struct {
+	kmutex_t	dds_lock;	/* protects dds_tree and its entries */
+	avl_tree_t	dds_tree;	/* "live" (changed) entries this txg */
+} ddt_shard_t;
+
 /*
  * In-core DDT object. This covers all entries and stats for a the whole pool
  * for a given checksum type.
  */
 typedef struct {
-	kmutex_t	ddt_lock;	/* protects changes to all fields */
+	kmutex_t	ddt_lock;	/* protects all fields but shards */
 
-	avl_tree_t	ddt_tree;	/* "live" (changed) entries this txg */
+	/* "live" (changed) entries this txg, sharded by key */
+	ddt_shard_t	*ddt_shards;
+	uint_t		ddt_num_shards;
 
 	avl_tree_t	ddt_repair_tree;	/* entries being repaired */
 
+	/*
+	 * Dedup log. New and changed entries are appended to the active log
+	 * each txg, and moved to the storage objects from the flushing log
+	 * a little at a time.
+	 */
+	ddt_log_t	ddt_log[2];
+	ddt_log_t	*ddt_log_active;	/* entries being written */
+	ddt_log_t	*ddt_log_flushing;	/* entries being flushed */
+	uint64_t	ddt_flush_rate;		/* entries flushed per txg */
+	uint64_t	ddt_flush_force_txg;	/* flush everything, see walk */
+
+	/*
+	 * Decoded copies of entries in the storage objects, in LRU order.
+	 * See ddt_cache.c.
+	 */
+	kmutex_t	ddt_cache_lock;		/* protects cache fields */
+	avl_tree_t	ddt_cache_tree;		/* cached entries, by key */
+	list_t		ddt_cache_lru;		/* cached entries, LRU first */
+
 	enum zio_checksum ddt_checksum;		/* checksum algorithm in use */
 	spa_t		*ddt_spa;		/* pool this ddt is on */
 	objset_t	*ddt_os;		/* ddt objset (always MOS) */
+	boolean_t	ddt_flat;		/* may use DDT_TYPE_FLAT */
 
 	/* per-type/per-class entry store objects */
 	uint64_t	ddt_object[DDT_TYPES][DDT_CLASSES];
@@ -231,16 +304,40 @@ extern void ddt_get_dedup_object_stats(spa_t *spa, ddt_object_t *ddo);
 extern void ddt_get_dedup_histogram(spa_t *spa, ddt_histogram_t *ddh);
 extern void ddt_get_dedup_stats(spa_t *spa, ddt_stat_t *dds_total);
 
+/*
+ * Entries read by ddt_get_sample_stats() and brt_get_sample_stats() by
+ * default and at most, and from each random position.
+ */
+#define	DDT_SAMPLE_DEFAULT	10000
+#define	DDT_SAMPLE_MAX		(1ULL << 20)
+#define	DDT_SAMPLE_RUN		32
+
+extern uint64_t ddt_sample_cursor(void);
+extern uint64_t ddt_sample_scale(uint64_t val, uint64_t count,
+    uint64_t sampled);
+extern uint64_t ddt_sample_error(uint64_t count, uint64_t sampled,
+    uint64_t hits);
+extern int ddt_get_sample_stats(spa_t *spa, uint64_t samples,
+    nvlist_t *nvl);
+
 extern uint64_t ddt_get_dedup_dspace(spa_t *spa);
 extern uint64_t ddt_get_pool_dedup_ratio(spa_t *spa);
+extern uint64_t ddt_get_ddt_dsize(spa_t *spa);
+extern boolean_t ddt_over_quota(spa_t *spa);
 
 extern ddt_t *ddt_select(spa_t *spa, const blkptr_t *bp);
 extern void ddt_enter(ddt_t *ddt);
 extern void ddt_exit(ddt_t *ddt);
+extern ddt_shard_t *ddt_shard_select(ddt_t *ddt, const blkptr_t *bp);
+extern ddt_shard_t *ddt_shard_entry(ddt_t *ddt, const ddt_entry_t *dde);
+extern void ddt_shard_enter(ddt_shard_t *dds);
+extern void ddt_shard_exit(ddt_shard_t *dds);
+extern boolean_t ddt_live_empty(ddt_t *ddt);
 extern void ddt_init(void);
 extern void ddt_fini(void);
 extern ddt_entry_t *ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t add);
 extern void ddt_prefetch(spa_t *spa, const blkptr_t *bp);
+extern boolean_t ddt_prefetch_lookup(ddt_t *ddt, const blkptr_t *bp);
 extern void ddt_remove(ddt_t *ddt, ddt_entry_t *dde);
 
 extern boolean_t ddt_class_contains(spa_t *spa, ddt_class_t max_class,
@@ -256,9 +353,13 @@ extern int ddt_load(spa_t *spa);
 extern void ddt_unload(spa_t *spa);
 extern void ddt_sync(spa_t *spa, uint64_t txg);
 extern int ddt_walk(spa_t *spa, ddt_bookmark_t *ddb, ddt_entry_t *dde);
+extern void ddt_walk_init(spa_t *spa, uint64_t txg);
+extern boolean_t ddt_walk_ready(spa_t *spa);
 
 extern boolean_t ddt_addref(spa_t *spa, const blkptr_t *bp);
 
+extern int ddt_prune_unique_entries(spa_t *spa, uint64_t days);
+
 #ifdef	__cplusplus
 }
 #endif
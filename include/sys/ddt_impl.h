@@ -58,6 +58,101 @@ typedef struct {
 } ddt_ops_t;
 
 extern const ddt_ops_t ddt_zap_ops;
+extern const ddt_ops_t ddt_flat_ops;
+
+/*
+ * Dedup log on-disk format. Each DDT has two log objects, one being appended
+ * to ("active") and one being flushed to the storage objects ("flushing").
+ * The log header is kept in the object bonus buffer; the object data is an
+ * array of ddt_log_record_t, appended to in txg order. When an entry is
+ * logged more than once, the last record wins.
+ */
+typedef struct {
+	uint64_t	dlh_info;	/* version & flags */
+	uint64_t	dlh_length;	/* log size in bytes */
+	uint64_t	dlh_first_txg;	/* txg the first entry was logged */
+	ddt_key_t	dlh_checkpoint;	/* last entry flushed */
+} ddt_log_header_t;
+
+#define	DLH_GET_VERSION(dlh)	BF64_GET((dlh)->dlh_info, 0, 8)
+#define	DLH_SET_VERSION(dlh, v)	BF64_SET((dlh)->dlh_info, 0, 8, v)
+#define	DLH_GET_FLAGS(dlh)	BF64_GET((dlh)->dlh_info, 8, 8)
+#define	DLH_SET_FLAGS(dlh, f)	BF64_SET((dlh)->dlh_info, 8, 8, f)
+
+#define	DDT_LOG_VERSION		1
+
+/* dlh/ddl flags */
+#define	DDL_FLAG_FLUSHING	(1 << 0)	/* log is being flushed */
+#define	DDL_FLAG_CHECKPOINT	(1 << 1)	/* dlh_checkpoint is valid */
+
+typedef struct {
+	ddt_key_t	dlr_key;
+	ddt_phys_t	dlr_phys[DDT_PHYS_TYPES];
+	uint64_t	dlr_info;	/* storage type & class */
+} ddt_log_record_t;
+
+#define	DLR_GET_TYPE(dlr)	BF64_GET((dlr)->dlr_info, 0, 8)
+#define	DLR_SET_TYPE(dlr, t)	BF64_SET((dlr)->dlr_info, 0, 8, t)
+#define	DLR_GET_CLASS(dlr)	BF64_GET((dlr)->dlr_info, 8, 8)
+#define	DLR_SET_CLASS(dlr, c)	BF64_SET((dlr)->dlr_info, 8, 8, c)
+
+/*
+ * Accumulates records to be appended to the active log in a single txg.
+ */
+typedef struct {
+	dmu_tx_t	*dlu_tx;
+	ddt_log_record_t *dlu_buf;	/* records not yet written */
+	uint64_t	dlu_nrecs;	/* records in dlu_buf */
+	boolean_t	dlu_written;	/* records written to the log */
+} ddt_log_update_t;
+
+extern uint64_t zfs_dedup_log_flush_entries_min;
+extern uint_t zfs_dedup_log_flush_txgs;
+extern uint_t zfs_dedup_log_txg_max;
+extern uint64_t zfs_dedup_log_mem_max;
+
+extern void ddt_log_init(void);
+extern void ddt_log_fini(void);
+
+extern void ddt_log_alloc(ddt_t *ddt);
+extern void ddt_log_free(ddt_t *ddt);
+extern int ddt_log_load(ddt_t *ddt);
+
+extern boolean_t ddt_log_exists(const ddt_t *ddt);
+extern boolean_t ddt_log_empty(const ddt_t *ddt);
+extern uint64_t ddt_log_count(const ddt_t *ddt);
+extern uint64_t ddt_log_memused(const ddt_t *ddt);
+
+extern void ddt_log_create(ddt_t *ddt, dmu_tx_t *tx);
+extern void ddt_log_destroy(ddt_t *ddt, dmu_tx_t *tx);
+
+extern boolean_t ddt_log_find_key(ddt_t *ddt, const ddt_key_t *ddk,
+    ddt_entry_t *dde);
+
+extern void ddt_log_begin(ddt_t *ddt, ddt_log_update_t *dlu, dmu_tx_t *tx);
+extern void ddt_log_entry(ddt_t *ddt, ddt_log_update_t *dlu,
+    const ddt_key_t *ddk, const ddt_phys_t *phys, ddt_type_t type,
+    ddt_class_t class);
+extern void ddt_log_commit(ddt_t *ddt, ddt_log_update_t *dlu);
+
+extern ddt_log_entry_t *ddt_log_flush_next(ddt_t *ddt);
+extern void ddt_log_flush_done(ddt_t *ddt, ddt_log_update_t *dlu,
+    ddt_log_entry_t *ddle, ddt_type_t type, ddt_class_t class);
+extern void ddt_log_checkpoint(ddt_t *ddt, const ddt_key_t *ddk,
+    dmu_tx_t *tx);
+extern void ddt_log_truncate(ddt_t *ddt, dmu_tx_t *tx);
+extern void ddt_log_swap(ddt_t *ddt, dmu_tx_t *tx);
+
+extern void ddt_cache_init(void);
+extern void ddt_cache_fini(void);
+
+extern void ddt_cache_alloc(ddt_t *ddt);
+extern void ddt_cache_free(ddt_t *ddt);
+
+extern boolean_t ddt_cache_lookup(ddt_t *ddt, const ddt_key_t *ddk,
+    ddt_entry_t *dde);
+extern void ddt_cache_insert(ddt_t *ddt, const ddt_entry_t *dde);
+extern void ddt_cache_remove(ddt_t *ddt, const ddt_key_t *ddk);
 
 extern void ddt_stat_update(ddt_t *ddt, ddt_entry_t *dde, uint64_t neg);
 
@@ -133,6 +133,11 @@ struct objset {
 	zfs_cache_type_t os_primary_cache;
 	zfs_cache_type_t os_secondary_cache;
 	zfs_prefetch_type_t os_prefetch;
+	zfs_cacheadmit_t os_cacheadmit;
+	zfs_direct_t os_direct;
+	uint64_t os_arc_min;
+	uint64_t os_arc_max;
+	arc_tenant_t *os_arc_tenant;	/* set once, see arc_buf_set_tenant() */
 	zfs_sync_type_t os_sync;
 	zfs_redundant_metadata_type_t os_redundant_metadata;
 	uint64_t os_recordsize;
@@ -183,6 +188,10 @@ struct objset {
 	multilist_t os_dirty_dnodes[TXG_SIZE];
 	list_t os_dnodes;
 	list_t os_downgraded_dbufs;
+	hrtime_t os_last_wakeup;
+
+	/* Dirty data accounted to this dataset per txg, atomic ops */
+	uint64_t os_dirty_pertxg[TXG_SIZE];
 
 	/* Protects changes to DMU_{USER,GROUP,PROJECT}USED_OBJECT */
 	kmutex_t os_userused_lock;
@@ -232,6 +241,7 @@ uint64_t dmu_objset_fsid_guid(objset_t *os);
 int dmu_objset_find_dp(struct dsl_pool *dp, uint64_t ddobj,
     int func(struct dsl_pool *, struct dsl_dataset *, void *),
     void *arg, int flags);
+int dmu_objset_prefetch_descendants(const char *name);
 void dmu_objset_evict_dbufs(objset_t *os);
 inode_timespec_t dmu_objset_snap_cmtime(objset_t *os);
 
@@ -266,6 +276,8 @@ int dmu_fsname(const char *snapname, char *buf);
 
 void dmu_objset_evict_done(objset_t *os);
 void dmu_objset_willuse_space(objset_t *os, int64_t space, dmu_tx_t *tx);
+void dmu_objset_undirty_space(objset_t *os, int64_t space, uint64_t txg);
+uint64_t dmu_objset_dirty_total(objset_t *os);
 
 void dmu_objset_init(void);
 void dmu_objset_fini(void);
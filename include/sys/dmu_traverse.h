@@ -70,6 +70,8 @@ int traverse_dataset_destroyed(spa_t *spa, blkptr_t *blkptr,
     blkptr_cb_t func, void *arg);
 int traverse_pool(spa_t *spa,
     uint64_t txg_start, int flags, blkptr_cb_t func, void *arg);
+int traverse_pool_parallel(spa_t *spa, uint64_t txg_start, int flags,
+    blkptr_cb_t func, void **args, int nargs);
 
 /*
  * Note that this calculation cannot overflow with the current maximum indirect
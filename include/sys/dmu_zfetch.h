@@ -50,13 +50,15 @@ typedef struct zsrange {
 	uint16_t	end;
 } zsrange_t;
 
-#define	ZFETCH_RANGES	9		/* Fits zstream_t into 128 bytes */
+#define	ZFETCH_RANGES	6		/* Fits zstream_t into 128 bytes */
 
 typedef struct zstream {
 	list_node_t	zs_node;	/* link for zf_stream */
 	uint64_t	zs_blkid;	/* expect next access at this blkid */
+	uint64_t	zs_start;	/* first blkid of the creating access */
 	uint_t		zs_atime;	/* time last prefetch issued */
 	zsrange_t	zs_ranges[ZFETCH_RANGES]; /* ranges from future */
+	boolean_t	zs_backward;	/* stream reads toward lower blkids */
 	unsigned int	zs_pf_dist;	/* data prefetch distance in bytes */
 	unsigned int	zs_ipf_dist;	/* L1 prefetch distance in bytes */
 	uint64_t	zs_pf_start;	/* first data block to prefetch */
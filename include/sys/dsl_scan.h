@@ -136,12 +136,18 @@ typedef struct dsl_scan {
 	boolean_t scn_async_destroying;
 	boolean_t scn_async_stalled;
 	uint64_t  scn_async_block_min_time_ms;
+	struct dsl_scan_free_batch *scn_free_batch; /* bps not yet handed off */
+	boolean_t scn_free_dispatched;	/* batches are on dp_sync_taskq */
+	int64_t   scn_free_used;	/* space freed but not yet accounted */
+	int64_t   scn_free_comp;
+	int64_t   scn_free_uncomp;
 
 	/* flags and stats for controlling scan state */
 	boolean_t scn_is_sorted;	/* doing sequential scan */
 	boolean_t scn_clearing;		/* scan is issuing sequential extents */
 	boolean_t scn_checkpointing;	/* scan is issuing all queued extents */
 	boolean_t scn_suspending;	/* scan is suspending until next txg */
+	boolean_t scn_ddt_walk_inited;	/* ddt log flush requested for walk */
 	uint64_t scn_last_checkpoint;	/* time of last checkpoint */
 
 	/* members for thread synchronization */
@@ -181,6 +187,16 @@ typedef struct dsl_scan {
 
 typedef struct dsl_scan_io_queue dsl_scan_io_queue_t;
 
+/*
+ * Argument of dsl_scan_setup_check() and dsl_scan_setup_sync(). A scrub
+ * may be limited to blocks born in [txgstart, txgend); zero means no limit.
+ */
+typedef struct setup_sync_arg {
+	pool_scan_func_t	func;
+	uint64_t		txgstart;
+	uint64_t		txgend;
+} setup_sync_arg_t;
+
 void scan_init(void);
 void scan_fini(void);
 int dsl_scan_init(struct dsl_pool *dp, uint64_t txg);
@@ -189,7 +205,7 @@ void dsl_scan_setup_sync(void *, dmu_tx_t *);
 void dsl_scan_fini(struct dsl_pool *dp);
 void dsl_scan_sync(struct dsl_pool *, dmu_tx_t *);
 int dsl_scan_cancel(struct dsl_pool *);
-int dsl_scan(struct dsl_pool *, pool_scan_func_t);
+int dsl_scan(struct dsl_pool *, pool_scan_func_t, uint64_t, uint64_t);
 void dsl_scan_assess_vdev(struct dsl_pool *dp, vdev_t *vd);
 boolean_t dsl_scan_scrubbing(const struct dsl_pool *dp);
 boolean_t dsl_errorscrubbing(const struct dsl_pool *dp);
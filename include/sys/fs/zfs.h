@@ -193,6 +193,11 @@ typedef enum {
 	ZFS_PROP_SNAPSHOTS_CHANGED,
 	ZFS_PROP_PREFETCH,
 	ZFS_PROP_VOLTHREADING,
+	ZFS_PROP_CACHEADMIT,
+	ZFS_PROP_ARCMIN,
+	ZFS_PROP_ARCMAX,
+	ZFS_PROP_ARCUSED,
+	ZFS_PROP_DIRECT,
 	ZFS_NUM_PROPS
 } zfs_prop_t;
 
@@ -258,6 +263,10 @@ typedef enum {
 	ZPOOL_PROP_BCLONEUSED,
 	ZPOOL_PROP_BCLONESAVED,
 	ZPOOL_PROP_BCLONERATIO,
+	ZPOOL_PROP_DEDUP_TABLE_SIZE,
+	ZPOOL_PROP_DEDUP_TABLE_QUOTA,
+	ZPOOL_PROP_SCRUB_RATE_LIMIT,
+	ZPOOL_PROP_SCRUB_LATENCY_TARGET,
 	ZPOOL_NUM_PROPS
 } zpool_prop_t;
 
@@ -368,9 +377,20 @@ typedef enum {
 	VDEV_PROP_RAIDZ_EXPANDING,
 	VDEV_PROP_SLOW_IO_N,
 	VDEV_PROP_SLOW_IO_T,
+	VDEV_PROP_QUEUE_BYPASS,
+	VDEV_PROP_MIRROR_READ_POLICY,
+	VDEV_PROP_NONVOLATILE_CACHE,
 	VDEV_NUM_PROPS
 } vdev_prop_t;
 
+/*
+ * Values for the mirror_read_policy vdev property.
+ */
+typedef enum vdev_mirror_read_policy {
+	VDEV_MIRROR_READ_QUEUE = 0,	/* queue length and seek hints */
+	VDEV_MIRROR_READ_LATENCY,	/* expected completion time */
+} vdev_mirror_read_policy_t;
+
 /*
  * Dataset property functions shared between libzfs and kernel.
  */
@@ -554,6 +574,17 @@ typedef enum {
 	ZFS_PREFETCH_ALL = 2
 } zfs_prefetch_type_t;
 
+typedef enum {
+	ZFS_CACHEADMIT_ALL = 0,
+	ZFS_CACHEADMIT_FREQUENT = 1
+} zfs_cacheadmit_t;
+
+typedef enum {
+	ZFS_DIRECT_DISABLED = 0,
+	ZFS_DIRECT_STANDARD = 1,
+	ZFS_DIRECT_ALWAYS = 2
+} zfs_direct_t;
+
 #define	DEFAULT_PBKDF2_ITERATIONS 350000
 #define	MIN_PBKDF2_ITERATIONS 100000
 
@@ -784,6 +815,9 @@ typedef struct zpool_load_policy {
 /* Number of slow IOs */
 #define	ZPOOL_CONFIG_VDEV_SLOW_IOS		"vdev_slow_ios"
 
+/* Missed I/O scheduler deadlines, indexed by zio_priority_t */
+#define	ZPOOL_CONFIG_VDEV_DEADLINE_MISSES	"vdev_deadline_misses"
+
 /* vdev enclosure sysfs path */
 #define	ZPOOL_CONFIG_VDEV_ENC_SYSFS_PATH	"vdev_enc_sysfs_path"
 
@@ -884,6 +918,7 @@ typedef struct zpool_load_policy {
 #define	VDEV_TYPE_DRAID_SPARE		"dspare"
 #define	VDEV_TYPE_DISK			"disk"
 #define	VDEV_TYPE_FILE			"file"
+#define	VDEV_TYPE_MEM			"mem"
 #define	VDEV_TYPE_MISSING		"missing"
 #define	VDEV_TYPE_HOLE			"hole"
 #define	VDEV_TYPE_SPARE			"spare"
@@ -1069,6 +1104,7 @@ typedef enum pool_scan_func {
 typedef enum pool_scrub_cmd {
 	POOL_SCRUB_NORMAL = 0,
 	POOL_SCRUB_PAUSE,
+	POOL_SCRUB_FROM_LAST_TXG,
 	POOL_SCRUB_FLAGS_END
 } pool_scrub_cmd_t;
 
@@ -1157,6 +1193,9 @@ typedef struct pool_removal_stat {
 	 * This includes all removed vdevs.
 	 */
 	uint64_t prs_mapping_memory;
+	/* since the removal was last (re)started, e.g. by pool import */
+	uint64_t prs_pass_start;
+	uint64_t prs_pass_copied;
 } pool_removal_stat_t;
 
 typedef struct pool_raidz_expand_stat {
@@ -1312,6 +1351,9 @@ typedef struct vdev_stat_ex {
 	uint64_t vsx_agg_histo[ZIO_PRIORITY_NUM_QUEUEABLE]
 	    [VDEV_RQ_HISTO_BUCKETS];
 
+	/* ZIOs that completed after their class deadline */
+	uint64_t vsx_deadline_miss[ZIO_PRIORITY_NUM_QUEUEABLE];
+
 } vdev_stat_ex_t;
 
 /*
@@ -1409,6 +1451,22 @@ typedef enum {
 #define	SNAP_ITER_MIN_TXG	"snap_iter_min_txg"
 #define	SNAP_ITER_MAX_TXG	"snap_iter_max_txg"
 
+/*
+ * nvlist name constants for ZFS_IOC_DATASET_LIST_BATCH, which returns the
+ * stats and properties of many child filesystems or snapshots per call.
+ * The snapshot iteration range constants above also apply.
+ */
+#define	DATASET_LIST_CURSOR	"cursor"
+#define	DATASET_LIST_COUNT	"count"
+#define	DATASET_LIST_SNAPSHOTS	"snapshots"
+#define	DATASET_LIST_SIMPLE	"simple"
+#define	DATASET_LIST_PROPS	"props"
+#define	DATASET_LIST_DATASETS	"datasets"
+#define	DATASET_LIST_STATS	"stats"
+
+#define	DATASET_LIST_DEFAULT_COUNT	256
+#define	DATASET_LIST_MAX_COUNT		4096
+
 /*
  * /dev/zfs ioctl numbers.
  *
@@ -1512,6 +1570,12 @@ typedef enum zfs_ioc {
 	ZFS_IOC_VDEV_GET_PROPS,			/* 0x5a55 */
 	ZFS_IOC_VDEV_SET_PROPS,			/* 0x5a56 */
 	ZFS_IOC_POOL_SCRUB,			/* 0x5a57 */
+	ZFS_IOC_DDT_PRUNE,			/* 0x5a58 */
+	ZFS_IOC_CHANGED_BLOCKS,			/* 0x5a59 */
+	ZFS_IOC_MOUNT_PREFETCH,			/* 0x5a5a */
+	ZFS_IOC_DATASET_LIST_BATCH,		/* 0x5a5b */
+	ZFS_IOC_DEDUP_SAMPLE,			/* 0x5a5c */
+	ZFS_IOC_KSTATS,				/* 0x5a5d */
 
 	/*
 	 * Per-platform (Optional) - 8/128 numbers reserved.
@@ -1544,6 +1608,20 @@ typedef enum zfs_ioc {
 #define	ZFS_IOC_GETDOSFLAGS	_IOR(0x83, 1, uint64_t)
 #define	ZFS_IOC_SETDOSFLAGS	_IOW(0x83, 2, uint64_t)
 
+/*
+ * IOCTL to fsync a batch of files at once.  zff_fds points to an array of
+ * zff_count int32_t file descriptors, all of which must be open on the same
+ * filesystem as the one the ioctl is issued on.  On success every file is
+ * as durable as if it had been fsync()ed, at the cost of one ZIL commit.
+ */
+typedef struct zfs_fsync_fds {
+	uint64_t	zff_count;
+	uint64_t	zff_fds;
+} zfs_fsync_fds_t;
+
+#define	ZFS_IOC_FSYNC_FDS	_IOW(0x83, 3, zfs_fsync_fds_t)
+#define	ZFS_FSYNC_FDS_MAX	1024
+
 /*
  * Additional file level attributes, that are stored
  * in the upper half of z_pflags
@@ -1695,6 +1773,47 @@ typedef enum {
 #define	ZPOOL_TRIM_RATE			"trim_rate"
 #define	ZPOOL_TRIM_SECURE		"trim_secure"
 
+/*
+ * The following are names used when invoking ZFS_IOC_DDT_PRUNE.
+ */
+#define	DDT_PRUNE_DAYS			"ddt_prune_days"
+
+/*
+ * The following are names used when invoking ZFS_IOC_CHANGED_BLOCKS.
+ */
+#define	CHANGED_BLOCKS_FD		"fd"
+#define	CHANGED_BLOCKS_FROMSNAP		"fromsnap"
+#define	CHANGED_BLOCKS_OBJECT		"object"
+
+/*
+ * The following are names used when invoking ZFS_IOC_DEDUP_SAMPLE, and in
+ * its output.  The "ddt" and "brt" nvlists each hold the number of entries
+ * in the tables, the number sampled, the estimated histogram and the error
+ * bounds on the number of entries in each of its buckets.  The DDT
+ * histogram is a ddt_histogram_t; the BRT one is the number of entries and
+ * of references in each power-of-two refcount bucket.
+ */
+#define	DEDUP_SAMPLE_COUNT		"sample_count"
+#define	DEDUP_SAMPLE_DDT		"ddt"
+#define	DEDUP_SAMPLE_BRT		"brt"
+#define	DEDUP_SAMPLE_ENTRIES		"entries"
+#define	DEDUP_SAMPLE_SAMPLED		"sampled"
+#define	DEDUP_SAMPLE_HISTOGRAM		"histogram"
+#define	DEDUP_SAMPLE_HIST_ENTRIES	"hist_entries"
+#define	DEDUP_SAMPLE_HIST_REFS		"hist_refs"
+#define	DEDUP_SAMPLE_ERROR		"error"
+
+/*
+ * The following are names used when invoking ZFS_IOC_KSTATS, and in its
+ * output.  "kstats" holds one nvlist per named kstat of the module, with
+ * an int32, uint32, int64, uint64 or string pair per entry.  The version
+ * changes whenever that layout does.
+ */
+#define	ZFS_KSTATS_VERSION		1
+#define	KSTATS_CLASS			"class"
+#define	KSTATS_VERSION			"version"
+#define	KSTATS_KSTATS			"kstats"
+
 /*
  * The following are names used when invoking ZFS_IOC_POOL_WAIT.
  */
@@ -46,6 +46,8 @@ typedef struct metaslab_ops {
 
 extern const metaslab_ops_t zfs_metaslab_ops;
 
+typedef struct metaslab_free_batch metaslab_free_batch_t;
+
 int metaslab_init(metaslab_group_t *, uint64_t, uint64_t, uint64_t,
     metaslab_t **);
 void metaslab_fini(metaslab_t *);
@@ -96,6 +98,10 @@ void metaslab_unalloc_dva(spa_t *, const dva_t *, uint64_t);
 int metaslab_claim(spa_t *, const blkptr_t *, uint64_t);
 int metaslab_claim_impl(vdev_t *, uint64_t, uint64_t, uint64_t);
 void metaslab_check_free(spa_t *, const blkptr_t *);
+metaslab_free_batch_t *metaslab_free_batch_create(spa_t *, uint64_t);
+void metaslab_free_batch_add(metaslab_free_batch_t *, const blkptr_t *);
+void metaslab_free_batch_flush(metaslab_free_batch_t *);
+void metaslab_free_batch_destroy(metaslab_free_batch_t *);
 
 void metaslab_stat_init(void);
 void metaslab_stat_fini(void);
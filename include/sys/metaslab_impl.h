@@ -211,6 +211,29 @@ struct metaslab_class {
 	metaslab_class_allocator_t	mc_allocator[];
 };
 
+/*
+ * An extent carved out of a metaslab in txg mcv_txg (see
+ * zfs_metaslab_carve_size). Allocations for that txg from the write stream
+ * mcv_stream are handed out from [mcv_start, mcv_end) under the owning
+ * allocator's mga_carve_lock alone; the rest is given back to the metaslab
+ * when it syncs. mcv_size is the size of the next extent to carve, which
+ * grows while one stream keeps using up its extents within a txg.
+ * mcv_base and mcv_count record where the extent began and how many
+ * blocks have been handed out of it, for the group's allocation counters.
+ */
+typedef struct metaslab_carve {
+	metaslab_t	*mcv_ms;
+	uint64_t	mcv_base;
+	uint64_t	mcv_count;
+	uint64_t	mcv_start;
+	uint64_t	mcv_end;
+	uint64_t	mcv_txg;
+	uint64_t	mcv_stream;
+	uint64_t	mcv_size;
+} metaslab_carve_t;
+
+#define	METASLAB_CARVE_STREAMS	4
+
 /*
  * Per-allocator data structure.
  */
@@ -219,6 +242,13 @@ typedef struct metaslab_group_allocator {
 	zfs_refcount_t	mga_alloc_queue_depth;
 	metaslab_t	*mga_primary;
 	metaslab_t	*mga_secondary;
+
+	/*
+	 * Carved extents, one slot per concurrent write stream so that
+	 * streams sharing this allocator do not interleave on disk.
+	 */
+	kmutex_t	mga_carve_lock;
+	metaslab_carve_t mga_carve[METASLAB_CARVE_STREAMS];
 } metaslab_group_allocator_t;
 
 /*
@@ -290,6 +320,21 @@ struct metaslab_group {
 	uint64_t		mg_allocations;
 	uint64_t		mg_failed_allocations;
 	uint64_t		mg_fragmentation;
+
+	/*
+	 * Allocation forecasting for metaslab_group_preload().
+	 * mg_alloc_bytes and mg_alloc_count count successful allocations
+	 * (updated atomically). Every txg, metaslab_sync_reassess() folds
+	 * what they gained since mg_forecast_bytes and mg_forecast_count
+	 * into the moving averages mg_alloc_rate (bytes per txg) and
+	 * mg_alloc_avgsize (bytes per allocation).
+	 */
+	uint64_t		mg_alloc_bytes;
+	uint64_t		mg_alloc_count;
+	uint64_t		mg_forecast_bytes;
+	uint64_t		mg_forecast_count;
+	uint64_t		mg_alloc_rate;
+	uint64_t		mg_alloc_avgsize;
 	uint64_t		mg_histogram[RANGE_TREE_HISTOGRAM_SIZE];
 
 	int			mg_ms_disabled;
@@ -43,6 +43,11 @@ struct multilist_sublist {
 	 * The actual list object containing all objects in this sublist.
 	 */
 	list_t		mls_list;
+	/*
+	 * The number of times the lock was found held by another thread,
+	 * protected by mls_lock.
+	 */
+	uint64_t	mls_contended;
 	/*
 	 * Pad to cache line, in an effort to try and prevent cache line
 	 * contention.
@@ -73,6 +78,8 @@ struct multilist {
 
 void multilist_create(multilist_t *, size_t, size_t,
     multilist_sublist_index_func_t *);
+void multilist_create_groups(multilist_t *, size_t, size_t, uint_t,
+    multilist_sublist_index_func_t *);
 void multilist_destroy(multilist_t *);
 
 void multilist_insert(multilist_t *, void *);
@@ -81,6 +88,7 @@ int  multilist_is_empty(multilist_t *);
 
 unsigned int multilist_get_num_sublists(multilist_t *);
 unsigned int multilist_get_random_index(multilist_t *);
+uint64_t multilist_get_contended(multilist_t *);
 
 void multilist_sublist_lock(multilist_sublist_t *);
 multilist_sublist_t *multilist_sublist_lock_idx(multilist_t *, unsigned int);
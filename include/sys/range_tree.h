@@ -298,6 +298,7 @@ uint64_t range_tree_max(range_tree_t *rt);
 uint64_t range_tree_span(range_tree_t *rt);
 
 void range_tree_add(void *arg, uint64_t start, uint64_t size);
+void range_tree_add_tail(range_tree_t *rt, uint64_t start, uint64_t size);
 void range_tree_remove(void *arg, uint64_t start, uint64_t size);
 void range_tree_remove_fill(range_tree_t *rt, uint64_t start, uint64_t size);
 void range_tree_adjust_fill(range_tree_t *rt, range_seg_t *rs, int64_t delta);
@@ -817,6 +817,8 @@ extern void spa_l2cache_drop(spa_t *spa);
 
 /* scanning */
 extern int spa_scan(spa_t *spa, pool_scan_func_t func);
+extern int spa_scan_range(spa_t *spa, pool_scan_func_t func, uint64_t txgstart,
+    uint64_t txgend);
 extern int spa_scan_stop(spa_t *spa);
 extern int spa_scrub_pause_resume(spa_t *spa, pool_scrub_cmd_t flag);
 
@@ -899,6 +901,12 @@ typedef struct spa_history_list {
 	procfs_list_t		procfs_list;
 } spa_history_list_t;
 
+typedef struct spa_heatmap {
+	uint64_t		size;
+	avl_tree_t		tree;
+	procfs_list_t		procfs_list;
+} spa_heatmap_t;
+
 typedef struct spa_stats {
 	spa_history_list_t	read_history;
 	spa_history_list_t	txg_history;
@@ -907,6 +915,8 @@ typedef struct spa_stats {
 	spa_history_kstat_t	state;		/* pool state */
 	spa_history_kstat_t	guid;		/* pool guid */
 	spa_history_kstat_t	iostats;
+	spa_history_kstat_t	zio_stages;	/* stage latency histograms */
+	spa_heatmap_t		heatmap;	/* hottest objects */
 } spa_stats_t;
 
 typedef enum txg_state {
@@ -945,12 +955,69 @@ typedef struct spa_iostats {
 	kstat_named_t	simple_trim_bytes_skipped;
 	kstat_named_t	simple_trim_extents_failed;
 	kstat_named_t	simple_trim_bytes_failed;
+	kstat_named_t	userquota_update_nsecs;
+	kstat_named_t	userquota_flush_nsecs;
+	kstat_named_t	sync_passes;
+	kstat_named_t	sync_pool_nsecs;
+	kstat_named_t	sync_mos_nsecs;
+	kstat_named_t	sync_frees_nsecs;
+	kstat_named_t	sync_brt_nsecs;
+	kstat_named_t	sync_ddt_nsecs;
+	kstat_named_t	sync_scan_nsecs;
+	kstat_named_t	sync_log_flush_nsecs;
+	kstat_named_t	sync_vdev_nsecs;
+	kstat_named_t	sync_deferred_frees_nsecs;
+	kstat_named_t	sync_config_nsecs;
+	kstat_named_t	special_spill_metadata_count;
+	kstat_named_t	special_spill_metadata_bytes;
+	kstat_named_t	special_spill_smallblk_count;
+	kstat_named_t	special_spill_smallblk_bytes;
+	kstat_named_t	special_spill_ddt_count;
+	kstat_named_t	special_spill_ddt_bytes;
+	kstat_named_t	log_flush_blocks_count;
+	kstat_named_t	log_flush_memory_count;
+	kstat_named_t	log_flush_all_count;
+	kstat_named_t	log_blocks;
+	kstat_named_t	log_block_limit;
+	kstat_named_t	log_replay_rate;
+	kstat_named_t	log_replay_est_ms;
+	kstat_named_t	mmp_write_count;
+	kstat_named_t	mmp_write_nsecs;
+	kstat_named_t	mmp_write_errors;
+	kstat_named_t	mmp_write_slow_count;
 } spa_iostats_t;
 
+/*
+ * Phases of spa_sync(), as accounted in spa_iostats_t and the txgs kstat.
+ * SPA_SYNC_PHASE_POOL excludes the MOS, which is accounted separately.
+ */
+typedef enum spa_sync_phase {
+	SPA_SYNC_PHASE_POOL,		/* dsl_pool_sync(), datasets */
+	SPA_SYNC_PHASE_MOS,		/* dsl_pool_sync_mos() */
+	SPA_SYNC_PHASE_FREES,		/* spa_sync_frees() */
+	SPA_SYNC_PHASE_BRT,		/* brt_sync() */
+	SPA_SYNC_PHASE_DDT,		/* ddt_sync() */
+	SPA_SYNC_PHASE_SCAN,		/* scan, removal, upgrades */
+	SPA_SYNC_PHASE_LOG_FLUSH,	/* spa_flush_metaslabs() */
+	SPA_SYNC_PHASE_VDEV,		/* vdev_sync(), metaslab_sync() */
+	SPA_SYNC_PHASE_DEFERRED_FREES,	/* spa_sync_deferred_frees() */
+	SPA_SYNC_PHASE_CONFIG,		/* labels and uberblock */
+	SPA_SYNC_NUM_PHASES
+} spa_sync_phase_t;
+
+/* Kinds of accesses counted by the per-object heatmap */
+typedef enum spa_heatmap_op {
+	SPA_HEATMAP_READ,		/* arc_read() satisfied from the ARC */
+	SPA_HEATMAP_MISS,		/* arc_read() which missed the ARC */
+	SPA_HEATMAP_WRITE,		/* arc_write() */
+} spa_heatmap_op_t;
+
 extern void spa_stats_init(spa_t *spa);
 extern void spa_stats_destroy(spa_t *spa);
 extern void spa_read_history_add(spa_t *spa, const zbookmark_phys_t *zb,
     uint32_t aflags);
+extern void spa_heatmap_add(spa_t *spa, const zbookmark_phys_t *zb,
+    spa_heatmap_op_t op);
 extern void spa_txg_history_add(spa_t *spa, uint64_t txg, hrtime_t birth_time);
 extern int spa_txg_history_set(spa_t *spa,  uint64_t txg,
     txg_state_t completed_state, hrtime_t completed_time);
@@ -958,6 +1025,8 @@ extern txg_stat_t *spa_txg_history_init_io(spa_t *, uint64_t,
     struct dsl_pool *);
 extern void spa_txg_history_fini_io(spa_t *, txg_stat_t *);
 extern void spa_tx_assign_add_nsecs(spa_t *spa, uint64_t nsecs);
+extern void spa_zio_stage_add_nsecs(spa_t *spa, uint32_t stage,
+    uint64_t nsecs);
 extern int spa_mmp_history_set_skip(spa_t *spa, uint64_t mmp_kstat_id);
 extern int spa_mmp_history_set(spa_t *spa, uint64_t mmp_kstat_id, int io_error,
     hrtime_t duration);
@@ -968,6 +1037,16 @@ extern void spa_iostats_trim_add(spa_t *spa, trim_type_t type,
     uint64_t extents_written, uint64_t bytes_written,
     uint64_t extents_skipped, uint64_t bytes_skipped,
     uint64_t extents_failed, uint64_t bytes_failed);
+extern void spa_iostats_userquota_add(spa_t *spa, uint64_t update_nsecs,
+    uint64_t flush_nsecs);
+extern void spa_iostats_sync_add(spa_t *spa, uint64_t passes,
+    const hrtime_t *phase_nsecs);
+extern void spa_iostats_special_spill_add(spa_t *spa,
+    dmu_object_type_t objtype, uint_t level, uint64_t bytes);
+extern void spa_iostats_log_flush_add(spa_t *spa, uint64_t blocks,
+    uint64_t memory, uint64_t all);
+extern void spa_iostats_mmp_write_add(spa_t *spa, hrtime_t nsecs, int error,
+    boolean_t slow);
 extern void spa_import_progress_add(spa_t *spa);
 extern void spa_import_progress_remove(uint64_t spa_guid);
 extern int spa_import_progress_set_mmp_check(uint64_t pool_guid,
@@ -1034,6 +1113,7 @@ extern uint64_t spa_last_synced_txg(spa_t *spa);
 extern uint64_t spa_first_txg(spa_t *spa);
 extern uint64_t spa_syncing_txg(spa_t *spa);
 extern uint64_t spa_final_dirty_txg(spa_t *spa);
+extern uint64_t spa_get_last_scrubbed_txg(spa_t *spa);
 extern uint64_t spa_version(spa_t *spa);
 extern pool_state_t spa_state(spa_t *spa);
 extern spa_load_state_t spa_load_state(spa_t *spa);
@@ -1115,6 +1195,7 @@ typedef void (*spa_remap_cb_t)(uint64_t vdev, uint64_t offset, uint64_t size,
 extern boolean_t spa_remap_blkptr(spa_t *spa, blkptr_t *bp,
     spa_remap_cb_t callback, void *arg);
 extern uint64_t spa_get_last_removal_txg(spa_t *spa);
+extern uint64_t spa_get_txg_at_time(spa_t *spa, uint64_t time);
 extern boolean_t spa_trust_config(spa_t *spa);
 extern uint64_t spa_missing_tvds_allowed(spa_t *spa);
 extern void spa_set_missing_tvds(spa_t *spa, uint64_t missing);
@@ -76,6 +76,21 @@ typedef struct spa_error_entry {
 	zbookmark_err_phys_t	se_zep;		/* not accounted in avl_find */
 } spa_error_entry_t;
 
+/*
+ * The txg synced at the start of each day, recorded so that block birth txgs
+ * can be converted to an approximate age. All members must be uint64_t, for
+ * byteswap purposes. The whole array is stored as a single ZAP value, so it
+ * must fit in ZAP_MAXVALUELEN.
+ */
+typedef struct spa_txg_log_time {
+	uint64_t stlt_txg;
+	uint64_t stlt_time;
+} spa_txg_log_time_t;
+
+#define	SPA_TXG_LOG_TIME_ENTRIES	\
+	(ZAP_MAXVALUELEN / sizeof (spa_txg_log_time_t))
+#define	SPA_TXG_LOG_TIME_INTERVAL	(24 * 60 * 60)
+
 typedef struct spa_history_phys {
 	uint64_t sh_pool_create_len;	/* ending offset of zpool create */
 	uint64_t sh_phys_max_off;	/* physical EOF */
@@ -190,9 +205,23 @@ typedef enum spa_proc_state {
 	SPA_PROC_GONE		/* spa_thread() is exiting, spa_proc = &p0 */
 } spa_proc_state_t;
 
+/*
+ * Small writes queued for one write issue taskq, executed back to back by a
+ * single task instead of being dispatched to the taskq one at a time.
+ */
+typedef struct spa_taskq_batch {
+	kmutex_t	stqb_lock;
+	list_t		stqb_zios;	/* queued zios, in dispatch order */
+	boolean_t	stqb_dispatched; /* stqb_tqent is queued or running */
+	taskq_t		*stqb_taskq;
+	task_func_t	*stqb_func;
+	taskq_ent_t	stqb_tqent;
+} spa_taskq_batch_t;
+
 typedef struct spa_taskqs {
 	uint_t stqs_count;
 	taskq_t **stqs_taskq;
+	spa_taskq_batch_t *stqs_batch;	/* write issue taskqs only */
 } spa_taskqs_t;
 
 /* one for each thread in the spa sync taskq */
@@ -230,6 +259,8 @@ struct spa {
 	nvlist_t	*spa_load_info;		/* info and errors from load */
 	uint64_t	spa_config_txg;		/* txg of last config change */
 	uint32_t	spa_sync_pass;		/* iterate-to-convergence */
+	/* time spent in each phase of spa_sync() for the syncing txg */
+	hrtime_t	spa_sync_phase_nsecs[SPA_SYNC_NUM_PHASES];
 	pool_state_t	spa_state;		/* pool state */
 	int		spa_inject_ref;		/* injection references */
 	uint8_t		spa_sync_on;		/* sync threads are running */
@@ -266,6 +297,7 @@ struct spa {
 	uint64_t	spa_max_ashift;		/* of vdevs in normal class */
 	uint64_t	spa_min_alloc;		/* of vdevs in normal class */
 	uint64_t	spa_gcd_alloc;		/* of vdevs in normal class */
+	uint64_t	spa_max_nparity;	/* of vdevs in normal class */
 	uint64_t	spa_config_guid;	/* config pool guid */
 	uint64_t	spa_load_guid;		/* spa_load initialized guid */
 	uint64_t	spa_last_synced_guid;	/* last synced guid */
@@ -298,6 +330,7 @@ struct spa {
 	/* checksum context templates */
 	kmutex_t	spa_cksum_tmpls_lock;
 	void		*spa_cksum_tmpls[ZIO_CHECKSUM_FUNCTIONS];
+	zio_compress_auto_t *spa_compress_auto; /* compression=auto state */
 	uberblock_t	spa_ubsync;		/* last synced uberblock */
 	uberblock_t	spa_uberblock;		/* current uberblock */
 	boolean_t	spa_extreme_rewind;	/* rewind past deferred frees */
@@ -364,6 +397,11 @@ struct spa {
 	uint64_t	spa_livelists_to_delete; /* set of livelists to free */
 	livelist_condense_entry_t	spa_to_condense; /* next to condense */
 
+	zthr_t		*spa_arc_warm_zthr;	/* ARC warm-start checkpoints */
+	uint64_t	spa_arc_warm_obj;	/* MOS object of checkpoint */
+	boolean_t	spa_arc_warm_pending;	/* prefetch at import pending */
+	hrtime_t	spa_arc_warm_last;	/* time of last checkpoint */
+
 	char		*spa_root;		/* alternate root directory */
 	uint64_t	spa_ena;		/* spa-wide ereport ENA */
 	int		spa_last_open_failed;	/* error if last open failed */
@@ -377,6 +415,7 @@ struct spa {
 	kmutex_t	spa_errlog_lock;	/* error log lock */
 	uint64_t	spa_errlog_last;	/* last error log object */
 	uint64_t	spa_errlog_scrub;	/* scrub error log object */
+	uint64_t	spa_scrubbed_last_txg;	/* max txg of last full scrub */
 	kmutex_t	spa_errlist_lock;	/* error list/ereport lock */
 	avl_tree_t	spa_errlist_last;	/* last error list */
 	avl_tree_t	spa_errlist_scrub;	/* scrub error list */
@@ -409,6 +448,10 @@ struct spa {
 	ddt_t		*spa_ddt[ZIO_CHECKSUM_FUNCTIONS]; /* in-core DDTs */
 	uint64_t	spa_ddt_stat_object;	/* DDT statistics */
 	uint64_t	spa_dedup_dspace;	/* Cache get_dedup_dspace() */
+	uint64_t	spa_dedup_table_size;	/* on-disk size of all DDTs */
+	uint64_t	spa_dedup_table_quota;	/* property DDT maximum size */
+	uint64_t	spa_scrub_rate_limit;	/* property scan bytes/s/disk */
+	uint64_t	spa_scrub_latency_target; /* property sync I/O ms */
 	uint64_t	spa_dedup_checksum;	/* default dedup checksum */
 	uint64_t	spa_dspace;		/* dspace in normal class */
 	struct brt	*spa_brt;		/* in-core BRT */
@@ -452,6 +495,8 @@ struct spa {
 	taskq_t		*spa_prefetch_taskq;	/* Taskq for prefetch threads */
 	taskq_t		*spa_upgrade_taskq;	/* Taskq for upgrade jobs */
 	uint64_t	spa_multihost;		/* multihost aware (mmp) */
+	spa_txg_log_time_t spa_txg_log_time[SPA_TXG_LOG_TIME_ENTRIES];
+	uint64_t	spa_txg_log_time_count;	/* valid spa_txg_log_time */
 	mmp_thread_t	spa_mmp;		/* multihost mmp thread */
 	list_t		spa_leaf_list;		/* list of leaf vdevs */
 	uint64_t	spa_leaf_list_gen;	/* track leaf_list changes */
@@ -45,6 +45,9 @@ typedef struct spa_unflushed_stats  {
 	/* used for block heuristic */
 	uint64_t sus_blocklimit;	/* max # of log blocks allowed */
 	uint64_t sus_nblocks;	/* # of blocks in log space maps currently */
+
+	/* used for the replay time budget */
+	uint64_t sus_replay_rate;	/* blocks/s replayed at import or 0 */
 } spa_unflushed_stats_t;
 
 typedef struct spa_log_sm {
@@ -68,6 +71,8 @@ uint64_t spa_log_sm_blocklimit(spa_t *);
 void spa_log_sm_set_blocklimit(spa_t *);
 uint64_t spa_log_sm_nblocks(spa_t *);
 uint64_t spa_log_sm_memused(spa_t *);
+uint64_t spa_log_sm_replay_rate(spa_t *);
+uint64_t spa_log_sm_replay_estimate_ms(spa_t *);
 
 void spa_log_sm_decrement_mscount(spa_t *, uint64_t);
 void spa_log_sm_increment_current_mscount(spa_t *);
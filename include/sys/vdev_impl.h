@@ -41,6 +41,7 @@
 #include <sys/vdev_rebuild.h>
 #include <sys/vdev_removal.h>
 #include <sys/zfs_ratelimit.h>
+#include <sys/wmsum.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -130,6 +131,14 @@ typedef const struct vdev_ops {
 /*
  * Virtual device properties
  */
+/*
+ * Completion latency histogram used to adapt queue depth; four buckets per
+ * power of two between 2^VDQ_LAT_MIN_SHIFT and 2^VDQ_LAT_MAX_SHIFT ns.
+ */
+#define	VDQ_LAT_MIN_SHIFT	10
+#define	VDQ_LAT_MAX_SHIFT	37
+#define	VDQ_LAT_BUCKETS		((VDQ_LAT_MAX_SHIFT - VDQ_LAT_MIN_SHIFT) * 4)
+
 typedef union vdev_queue_class {
 	struct {
 		ulong_t 	vqc_list_numnodes;
@@ -153,6 +162,18 @@ struct vdev_queue {
 	list_t		vq_active_list;	/* List of active I/Os. */
 	hrtime_t	vq_io_complete_ts; /* time last i/o completed */
 	hrtime_t	vq_io_delta_ts;
+	/* Completed I/Os that took longer than their class deadline. */
+	uint64_t	vq_deadline_miss[ZIO_PRIORITY_NUM_QUEUEABLE];
+	/* Adaptive queue depth; see vdev_queue_adapt(). */
+	uint32_t	vq_adapt_pct;	/* Current max_active scale. */
+	uint32_t	vq_adapt_count;	/* Completions in this window. */
+	uint32_t	vq_adapt_backlog; /* ... that left I/Os queued. */
+	hrtime_t	vq_adapt_base;	/* Baseline latency percentile. */
+	uint16_t	vq_adapt_histo[VDQ_LAT_BUCKETS];
+	wmsum_t		vq_bypass_active; /* Active I/Os that skipped queue. */
+	hrtime_t	vq_read_lat;	/* Moving average of read latency. */
+	hrtime_t	vq_sync_lat;	/* ... of sync read/write latency. */
+	hrtime_t	vq_sync_lat_ts;	/* Last update of vq_sync_lat. */
 	zio_t		vq_io_search; /* used as local for stack reduction */
 	kmutex_t	vq_lock;
 };
@@ -325,6 +346,9 @@ struct vdev {
 	uint64_t	vdev_trim_partial;	/* requested partial TRIM */
 	uint64_t	vdev_trim_secure;	/* requested secure TRIM */
 	uint64_t	vdev_trim_action_time;	/* start and end time */
+	uint64_t	vdev_trim_granularity;	/* device discard granularity */
+	uint64_t	vdev_trim_max_bytes;	/* device max discard size */
+	uint64_t	vdev_autotrim_delay_ms;	/* backoff between auto TRIMs */
 
 	/* Rebuild related */
 	boolean_t	vdev_rebuilding;
@@ -452,6 +476,7 @@ struct vdev {
 	zfs_ratelimit_t vdev_delay_rl;
 	zfs_ratelimit_t vdev_deadman_rl;
 	zfs_ratelimit_t vdev_checksum_rl;
+	zfs_ratelimit_t vdev_checksum_detail_rl;
 
 	/*
 	 * Vdev properties for tuning ZED or zfsd
@@ -462,6 +487,21 @@ struct vdev {
 	uint64_t	vdev_io_t;
 	uint64_t	vdev_slow_io_n;
 	uint64_t	vdev_slow_io_t;
+
+	/*
+	 * Send interactive I/O straight to the leaf, skipping the queue and
+	 * aggregation (see vdev_queue_io()).
+	 */
+	uint64_t	vdev_queue_bypass;
+
+	/* How a mirror picks the child to read from (vdev_mirror_load()). */
+	uint64_t	vdev_mirror_read_policy;
+
+	/*
+	 * The device's write cache survives power loss, so zio_flush()
+	 * doesn't need to send it cache flushes.
+	 */
+	uint64_t	vdev_nonvolatile_cache;
 };
 
 #define	VDEV_PAD_SIZE		(8 << 10)
@@ -602,6 +642,7 @@ extern vdev_ops_t vdev_draid_ops;
 extern vdev_ops_t vdev_draid_spare_ops;
 extern vdev_ops_t vdev_disk_ops;
 extern vdev_ops_t vdev_file_ops;
+extern vdev_ops_t vdev_mem_ops;
 extern vdev_ops_t vdev_missing_ops;
 extern vdev_ops_t vdev_hole_ops;
 extern vdev_ops_t vdev_spare_ops;
@@ -88,6 +88,13 @@ typedef struct vdev_indirect_mapping {
 	 */
 	vdev_indirect_mapping_entry_phys_t *vim_entries;
 
+	/*
+	 * The source offset of every VIM_INDEX_STRIDE'th entry of
+	 * vim_entries.  Lookups search this small array first, so that the
+	 * search of vim_entries only touches one stride of it.
+	 */
+	uint64_t	*vim_index;
+
 	objset_t	*vim_objset;
 
 	dmu_buf_t	*vim_dbuf;
@@ -61,6 +61,10 @@ typedef struct spa_vdev_removal {
 
 	/* List of leaf zap objects to be unlinked */
 	nvlist_t	*svr_zaplist;
+
+	/* When the removal thread started, and sr_copied at that time */
+	uint64_t	svr_pass_start;
+	uint64_t	svr_pass_copied_base;
 } spa_vdev_removal_t;
 
 typedef struct spa_condensing_indirect {
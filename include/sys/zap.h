@@ -223,6 +223,8 @@ int zap_lookup_norm(objset_t *ds, uint64_t zapobj, const char *name,
     boolean_t *normalization_conflictp);
 int zap_lookup_uint64(objset_t *os, uint64_t zapobj, const uint64_t *key,
     int key_numints, uint64_t integer_size, uint64_t num_integers, void *buf);
+int zap_lookup_uint64_by_dnode(dnode_t *dn, const uint64_t *key,
+    int key_numints, uint64_t integer_size, uint64_t num_integers, void *buf);
 int zap_contains(objset_t *ds, uint64_t zapobj, const char *name);
 int zap_prefetch(objset_t *os, uint64_t zapobj, const char *name);
 int zap_prefetch_uint64(objset_t *os, uint64_t zapobj, const uint64_t *key,
@@ -273,6 +275,9 @@ int zap_update_uint64(objset_t *os, uint64_t zapobj, const uint64_t *key,
 int zap_update_uint64_by_dnode(dnode_t *dn, const uint64_t *key,
     int key_numints,
     int integer_size, uint64_t num_integers, const void *val, dmu_tx_t *tx);
+int zap_update_uint64_batch_by_dnode(dnode_t *dn, const uint64_t *keys,
+    int key_numints, uint64_t nkeys,
+    int integer_size, uint64_t num_integers, const void *vals, dmu_tx_t *tx);
 
 /*
  * Get the length (in integers) and the integer size of the specified
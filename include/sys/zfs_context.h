@@ -368,6 +368,8 @@ extern void kstat_set_raw_ops(kstat_t *ksp,
     int (*headers)(char *buf, size_t size),
     int (*data)(char *buf, size_t size, void *data),
     void *(*addr)(kstat_t *ksp, loff_t index));
+typedef int kstat_walk_cb_t(kstat_t *ksp, const char *name, void *arg);
+extern int kstat_walk_named(const char *, kstat_walk_cb_t *, void *);
 
 /*
  * procfs list manipulation
@@ -514,6 +516,7 @@ extern void	taskq_wait_id(taskq_t *, taskqid_t);
 extern void	taskq_wait_outstanding(taskq_t *, taskqid_t);
 extern int	taskq_member(taskq_t *, kthread_t *);
 extern taskq_t	*taskq_of_curthread(void);
+extern boolean_t	taskq_busy(taskq_t *);
 extern int	taskq_cancel_id(taskq_t *, taskqid_t);
 extern void	system_taskq_init(void);
 extern void	system_taskq_fini(void);
@@ -626,6 +629,8 @@ extern void delay(clock_t ticks);
 
 #define	CPU_SEQID	((uintptr_t)pthread_self() & (max_ncpus - 1))
 #define	CPU_SEQID_UNSTABLE	CPU_SEQID
+#define	max_nnodes	1
+#define	CPU_NODEID	0
 
 #define	kcred		NULL
 #define	CRED()		NULL
@@ -61,4 +61,14 @@ zfs_file_t *zfs_file_get(int fd);
 void zfs_file_put(zfs_file_t *fp);
 void *zfs_file_private(zfs_file_t *fp);
 
+#ifndef _KERNEL
+typedef void zfs_file_io_done_t(void *arg, void *buf, int err, ssize_t resid);
+
+void zfs_file_async_init(void);
+void zfs_file_async_fini(void);
+boolean_t zfs_file_async(zfs_file_t *fp);
+void zfs_file_pread_async(zfs_file_t *fp, void *buf, size_t len, loff_t off,
+    zfs_file_io_done_t *done, void *arg);
+#endif
+
 #endif /* _SYS_ZFS_FILE_H */
@@ -407,6 +407,15 @@ typedef struct dmu_diff_record {
 	uint64_t ddr_last;
 } dmu_diff_record_t;
 
+/*
+ * ZFS_IOC_CHANGED_BLOCKS reports back byte ranges of a single object
+ * which were written or freed after the "from" snapshot.
+ */
+typedef struct dmu_changed_range {
+	uint64_t dcr_offset;
+	uint64_t dcr_length;
+} dmu_changed_range_t;
+
 typedef struct zinject_record {
 	uint64_t	zi_objset;
 	uint64_t	zi_object;
@@ -434,8 +443,16 @@ typedef struct zinject_record {
 
 #define	ZEVENT_NONE		0x0
 #define	ZEVENT_NONBLOCK		0x1
+#define	ZEVENT_BATCH		0x2
 #define	ZEVENT_SIZE		1024
 
+/*
+ * With ZEVENT_BATCH, ZFS_IOC_EVENTS_NEXT returns up to zc_obj events
+ * (at most ZEVENT_BATCH_MAX) as an nvlist array under ZEVENT_BATCH_EVENTS.
+ */
+#define	ZEVENT_BATCH_MAX	1024
+#define	ZEVENT_BATCH_EVENTS	"zevent_batch"
+
 #define	ZEVENT_SEEK_START	0
 #define	ZEVENT_SEEK_END		UINT64_MAX
 
@@ -40,6 +40,8 @@ extern int zfs_set_userquota(struct zfsvfs *, zfs_userquota_prop_t,
 
 extern boolean_t zfs_id_overobjquota(struct zfsvfs *, uint64_t, uint64_t);
 extern boolean_t zfs_id_overblockquota(struct zfsvfs *, uint64_t, uint64_t);
+extern boolean_t zfs_id_overblockquota_len(struct zfsvfs *, uint64_t,
+    uint64_t, uint64_t);
 extern boolean_t zfs_id_overquota(struct zfsvfs *, uint64_t, uint64_t);
 
 #endif
@@ -33,10 +33,12 @@ typedef struct {
 	unsigned int *burst;
 
 	unsigned int interval;	/* Interval length in seconds */
+	uint64_t suppressed;	/* Limited since last zfs_ratelimit_take() */
 	kmutex_t lock;
 } zfs_ratelimit_t;
 
 int zfs_ratelimit(zfs_ratelimit_t *rl);
+uint64_t zfs_ratelimit_take(zfs_ratelimit_t *rl);
 void zfs_ratelimit_init(zfs_ratelimit_t *rl, unsigned int *burst,
     unsigned int interval);
 void zfs_ratelimit_fini(zfs_ratelimit_t *rl);
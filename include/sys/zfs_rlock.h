@@ -50,6 +50,11 @@ typedef struct zfs_rangelock {
 	kmutex_t rl_lock;
 	zfs_rangelock_cb_t *rl_cb;
 	void *rl_arg;
+	struct zfs_rangelock *rl_segs; /* segments, once contended */
+	uint_t rl_nsegs;	/* number of segments */
+	uint_t rl_seg_shift;	/* log2 of the segment stripe size */
+	boolean_t rl_is_seg;	/* this is a segment of another rangelock */
+	boolean_t rl_draining;	/* rl_tree still holds pre-segment locks */
 } zfs_rangelock_t;
 
 typedef struct zfs_locked_range {
@@ -64,6 +69,7 @@ typedef struct zfs_locked_range {
 	uint8_t lr_proxy;	/* acting for original range */
 	uint8_t lr_write_wanted; /* writer wants to lock this range */
 	uint8_t lr_read_wanted;	/* reader wants to lock this range */
+	struct zfs_locked_range **lr_segs; /* per-segment locks, if any */
 } zfs_locked_range_t;
 
 void zfs_rangelock_init(zfs_rangelock_t *, zfs_rangelock_cb_t *, void *);
@@ -30,6 +30,7 @@
 extern int zfs_bclone_enabled;
 
 extern int zfs_fsync(znode_t *, int, cred_t *);
+extern int zfs_fsync_many(znode_t **, uint_t, int, cred_t *);
 extern int zfs_read(znode_t *, zfs_uio_t *, int, cred_t *);
 extern int zfs_write(znode_t *, zfs_uio_t *, int, cred_t *);
 extern int zfs_holey(znode_t *, ulong_t, loff_t *);
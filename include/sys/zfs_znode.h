@@ -196,6 +196,8 @@ typedef struct znode {
 	uint64_t	z_mapcnt;	/* number of pages mapped to file */
 	uint64_t	z_dnodesize;	/* dnode size */
 	uint64_t	z_size;		/* file size (cached) */
+	uint64_t	z_append_end;	/* end of reserved appends */
+	uint_t		z_append_busy;	/* # of append reservations */
 	uint64_t	z_pflags;	/* pflags (cached) */
 	uint32_t	z_sync_cnt;	/* synchronous open count */
 	uint32_t	z_sync_writes_cnt; /* synchronous write count */
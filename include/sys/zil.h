@@ -467,6 +467,19 @@ typedef struct zil_stats {
 	 */
 	kstat_named_t zil_commit_writer_count;
 
+	/*
+	 * Breakdown of commit latency, in nanoseconds summed over the
+	 * zil_commit_lwb_count commits which waited for an lwb:
+	 * "wait_time" until the lwb holding the commit was issued
+	 * (zl_issuer_lock, filling the lwb and the commit timeout),
+	 * "write_time" until the lwb write completed, and "flush_time"
+	 * until the vdev cache flushes completed and the commit returned.
+	 */
+	kstat_named_t zil_commit_lwb_count;
+	kstat_named_t zil_commit_lwb_wait_time;
+	kstat_named_t zil_commit_lwb_write_time;
+	kstat_named_t zil_commit_lwb_flush_time;
+
 	/*
 	 * Number of transactions (reads, writes, renames, etc.)
 	 * that have been committed.
@@ -505,11 +518,22 @@ typedef struct zil_stats {
 	kstat_named_t zil_itx_metaslab_slog_bytes;
 	kstat_named_t zil_itx_metaslab_slog_write;
 	kstat_named_t zil_itx_metaslab_slog_alloc;
+
+	/*
+	 * The "count" fields above are log blocks (lwbs), so they also show
+	 * how well zil_lwb_predict() sizes them: count divided by
+	 * zil_commit_writer_count is the number of lwbs written per commit,
+	 * and alloc minus write is the log space allocated but not written.
+	 */
 } zil_kstat_values_t;
 
 typedef struct zil_sums {
 	wmsum_t zil_commit_count;
 	wmsum_t zil_commit_writer_count;
+	wmsum_t zil_commit_lwb_count;
+	wmsum_t zil_commit_lwb_wait_time;
+	wmsum_t zil_commit_lwb_write_time;
+	wmsum_t zil_commit_lwb_flush_time;
 	wmsum_t zil_itx_count;
 	wmsum_t zil_itx_indirect_count;
 	wmsum_t zil_itx_indirect_bytes;
@@ -572,6 +596,8 @@ extern void	zil_itx_assign(zilog_t *zilog, itx_t *itx, dmu_tx_t *tx);
 
 extern void	zil_async_to_sync(zilog_t *zilog, uint64_t oid);
 extern void	zil_commit(zilog_t *zilog, uint64_t oid);
+extern void	zil_commit_objects(zilog_t *zilog, const uint64_t *oids,
+    uint_t noids);
 extern void	zil_commit_impl(zilog_t *zilog, uint64_t oid);
 extern void	zil_remove_async(zilog_t *zilog, uint64_t oid);
 
@@ -595,6 +621,7 @@ extern void	zil_set_sync(zilog_t *zilog, uint64_t syncval);
 extern void	zil_set_logbias(zilog_t *zilog, uint64_t slogval);
 
 extern uint64_t	zil_max_copied_data(zilog_t *zilog);
+extern boolean_t zil_slog_is_bulk(zilog_t *zilog);
 extern uint64_t	zil_max_log_data(zilog_t *zilog, size_t hdrsize);
 
 extern void zil_sums_init(zil_sums_t *zs);
@@ -115,6 +115,7 @@ typedef struct lwb {
 	zio_t		*lwb_write_zio;	/* zio for the lwb buffer */
 	zio_t		*lwb_root_zio;	/* root zio for lwb write and flushes */
 	hrtime_t	lwb_issued_timestamp; /* when was the lwb issued? */
+	hrtime_t	lwb_write_done_timestamp; /* when was it written? */
 	uint64_t	lwb_issued_txg;	/* the txg when the write is issued */
 	uint64_t	lwb_alloc_txg;	/* the txg when lwb_blk is allocated */
 	uint64_t	lwb_max_txg;	/* highest txg in this lwb */
@@ -149,6 +150,7 @@ typedef struct zil_commit_waiter {
 	lwb_t		*zcw_lwb;	/* back pointer to lwb when linked */
 	boolean_t	zcw_done;	/* B_TRUE when "done", else B_FALSE */
 	int		zcw_zio_error;	/* contains the zio io_error value */
+	hrtime_t	zcw_start;	/* when zil_commit() was called */
 } zil_commit_waiter_t;
 
 /*
@@ -219,6 +221,7 @@ struct zilog {
 	uint64_t	zl_cur_size;	/* current burst full size */
 	uint64_t	zl_cur_left;	/* current burst remaining size */
 	uint64_t	zl_cur_max;	/* biggest record in current burst */
+	boolean_t	zl_slog_bulk;	/* last burst exceeded zil_slog_bulk */
 	list_t		zl_lwb_list;	/* in-flight log write list */
 	avl_tree_t	zl_bp_tree;	/* track bps during log parse */
 	clock_t		zl_replay_time;	/* lbolt of when replay started */
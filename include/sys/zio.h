@@ -190,6 +190,7 @@ typedef uint64_t zio_flag_t;
 #define	ZIO_FLAG_SPECULATIVE	(1ULL << 8)
 #define	ZIO_FLAG_CONFIG_WRITER	(1ULL << 9)
 #define	ZIO_FLAG_DONT_RETRY	(1ULL << 10)
+#define	ZIO_FLAG_MMP		(1ULL << 11)	/* multihost, never queued */
 #define	ZIO_FLAG_NODATA		(1ULL << 12)
 #define	ZIO_FLAG_INDUCE_DAMAGE	(1ULL << 13)
 #define	ZIO_FLAG_IO_ALLOCATING	(1ULL << 14)
@@ -222,6 +223,7 @@ typedef uint64_t zio_flag_t;
 #define	ZIO_FLAG_NOPWRITE	(1ULL << 28)
 #define	ZIO_FLAG_REEXECUTED	(1ULL << 29)
 #define	ZIO_FLAG_DELEGATED	(1ULL << 30)
+#define	ZIO_FLAG_DDT_PREFETCHED	(1ULL << 31)
 
 #define	ZIO_ALLOCATOR_NONE	(-1)
 #define	ZIO_HAS_ALLOCATOR(zio)	((zio)->io_allocator != ZIO_ALLOCATOR_NONE)
@@ -367,6 +369,7 @@ typedef void zio_cksum_free_f(void *cbdata, size_t size);
 struct zio_bad_cksum;				/* defined in zio_checksum.h */
 struct dnode_phys;
 struct abd;
+struct metaslab_free_batch;			/* defined in metaslab.c */
 
 struct zio_cksum_report {
 	struct zio_cksum_report *zcr_next;
@@ -442,6 +445,7 @@ enum zio_qstate {
 	ZIO_QS_NONE = 0,
 	ZIO_QS_QUEUED,
 	ZIO_QS_ACTIVE,
+	ZIO_QS_BYPASS,
 };
 
 struct zio {
@@ -459,8 +463,6 @@ struct zio {
 	blkptr_t	*io_bp;
 	blkptr_t	*io_bp_override;
 	blkptr_t	io_bp_copy;
-	list_t		io_parent_list;
-	list_t		io_child_list;
 	zio_t		*io_logical;
 	zio_transform_t *io_transform_stack;
 
@@ -499,6 +501,7 @@ struct zio {
 	hrtime_t	io_delta;	/* vdev queue service delta */
 	hrtime_t	io_delay;	/* Device access time (disk or */
 					/* file). */
+	hrtime_t	io_stage_timestamp;	/* entered current stage */
 	zio_alloc_list_t 	io_alloc_list;
 
 	/* Internal pipeline state */
@@ -518,8 +521,6 @@ struct zio {
 	void		*io_executor;
 	void		*io_waiter;
 	void		*io_bio;
-	kmutex_t	io_lock;
-	kcondvar_t	io_cv;
 	int		io_allocator;
 
 	/* FMA state */
@@ -528,6 +529,17 @@ struct zio {
 
 	/* Taskq dispatching state */
 	taskq_ent_t	io_tqent;
+	list_node_t	io_batch_node;
+
+	/*
+	 * Initialized by the zio_cache constructor and left intact across
+	 * zio_destroy(), so must stay at the end; zio_create() clears only
+	 * the fields before io_lock.
+	 */
+	kmutex_t	io_lock;
+	kcondvar_t	io_cv;
+	list_t		io_parent_list;
+	list_t		io_child_list;
 };
 
 enum blk_verify_flag {
@@ -591,6 +603,8 @@ extern zio_t *zio_write_phys(zio_t *pio, vdev_t *vd, uint64_t offset,
 
 extern zio_t *zio_free_sync(zio_t *pio, spa_t *spa, uint64_t txg,
     const blkptr_t *bp, zio_flag_t flags);
+extern zio_t *zio_free_sync_batch(zio_t *pio, spa_t *spa, uint64_t txg,
+    const blkptr_t *bp, zio_flag_t flags, struct metaslab_free_batch *mfb);
 
 extern int zio_alloc_zil(spa_t *spa, objset_t *os, uint64_t txg,
     blkptr_t *new_bp, uint64_t size, boolean_t *slog);
@@ -649,6 +663,13 @@ extern enum zio_compress zio_compress_select(spa_t *spa,
 extern uint8_t zio_complevel_select(spa_t *spa, enum zio_compress compress,
     uint8_t child, uint8_t parent);
 
+typedef struct zio_compress_auto zio_compress_auto_t;
+extern zio_compress_auto_t *zio_compress_auto_create(void);
+extern void zio_compress_auto_destroy(zio_compress_auto_t *za);
+extern size_t zio_compress_auto(spa_t *spa, const zbookmark_phys_t *zb,
+    abd_t *src, void **dst, size_t s_len, enum zio_compress *cp,
+    uint8_t *levelp);
+
 extern void zio_suspend(spa_t *spa, zio_t *zio, zio_suspend_reason_t);
 extern int zio_resume(spa_t *spa);
 extern void zio_resume_wait(spa_t *spa);
@@ -0,0 +1,86 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef _SYS_ZIO_ACCEL_H
+#define	_SYS_ZIO_ACCEL_H
+
+#include <sys/zfs_context.h>
+#include <sys/zio_compress.h>
+#include <sys/zio_checksum.h>
+#include <sys/zio_crypt.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hardware offload providers for compression, checksums and encryption.
+ *
+ * A provider fills in the operations it supports and leaves the rest NULL.
+ * Each operation returns 0 if it handled the request, or non-zero to have
+ * the caller fall back to the next provider and finally to the software
+ * implementation. Results must be bit-for-bit identical to the software
+ * implementation, since either may be used to read the data back.
+ */
+typedef struct zio_accel_ops {
+	const char	*za_name;
+
+	/*
+	 * Compress s_len bytes from src into at most d_len bytes at dst,
+	 * setting *c_len. A *c_len greater than d_len means the data was
+	 * not compressible.
+	 */
+	int (*za_compress)(enum zio_compress c, int level, void *src,
+	    void *dst, size_t s_len, size_t d_len, size_t *c_len);
+	int (*za_decompress)(enum zio_compress c, void *src, void *dst,
+	    size_t s_len, size_t d_len, uint8_t *level);
+
+	/* Native-endian checksum of an unsalted checksum type. */
+	int (*za_checksum)(enum zio_checksum c, abd_t *abd, uint64_t size,
+	    zio_cksum_t *zcp);
+
+	/* In-place AEAD encryption or decryption of a single buffer. */
+	int (*za_crypt)(boolean_t encrypt, uint64_t crypt, uint8_t *src,
+	    uint8_t *dst, uint8_t *iv, uint8_t *mac, crypto_key_t *key,
+	    uint32_t len);
+} zio_accel_ops_t;
+
+extern void zio_accel_init(void);
+extern void zio_accel_fini(void);
+extern int zio_accel_register(const zio_accel_ops_t *ops);
+extern void zio_accel_unregister(const zio_accel_ops_t *ops);
+extern boolean_t zio_accel_enabled(void);
+
+extern int zio_accel_compress(enum zio_compress c, int level, void *src,
+    void *dst, size_t s_len, size_t d_len, size_t *c_len);
+extern int zio_accel_decompress(enum zio_compress c, void *src, void *dst,
+    size_t s_len, size_t d_len, uint8_t *level);
+extern int zio_accel_checksum(enum zio_checksum c, abd_t *abd, uint64_t size,
+    zio_cksum_t *zcp);
+extern int zio_accel_crypt(boolean_t encrypt, uint64_t crypt, uint8_t *src,
+    uint8_t *dst, uint8_t *iv, uint8_t *mac, crypto_key_t *key,
+    uint32_t len);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_ZIO_ACCEL_H */
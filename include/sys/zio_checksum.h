@@ -45,6 +45,13 @@ typedef void zio_checksum_t(struct abd *abd, uint64_t size,
     const void *ctx_template, zio_cksum_t *zcp);
 typedef void *zio_checksum_tmpl_init_t(const zio_cksum_salt_t *salt);
 typedef void zio_checksum_tmpl_free_t(void *ctx_template);
+typedef int zio_checksum_many_t(struct abd **abds, uint_t n, uint64_t size,
+    const void *ctx_template, zio_cksum_t *zcp);
+
+/*
+ * Most buffers a zio_checksum_many_t function is asked to checksum at once.
+ */
+#define	ZIO_CHECKSUM_MANY_MAX	16
 
 typedef enum zio_checksum_flags {
 	/* Strong enough for metadata? */
@@ -69,6 +76,9 @@ typedef struct zio_abd_checksum_data {
 	fletcher_4_ctx_t	*acd_ctx;
 	zio_cksum_t 		*acd_zcp;
 	void 			*acd_private;
+	/* Bytes held over for the next chunk, see abd_fletcher_4_iter() */
+	uint8_t			acd_carry[FLETCHER_MIN_SIMD_SIZE];
+	uint_t			acd_carry_len;
 } zio_abd_checksum_data_t;
 
 typedef void zio_abd_checksum_init_t(zio_abd_checksum_data_t *);
@@ -89,10 +99,21 @@ typedef const struct zio_checksum_info {
 	zio_checksum_t			*ci_func[2];
 	zio_checksum_tmpl_init_t	*ci_tmpl_init;
 	zio_checksum_tmpl_free_t	*ci_tmpl_free;
+	/* native checksum of several same-sized buffers, if supported */
+	zio_checksum_many_t		*ci_many;
 	zio_checksum_flags_t		ci_flags;
 	const char			*ci_name;	/* descriptive name */
 } zio_checksum_info_t;
 
+typedef struct zio_checksum_batch {
+	zio_t		*zcb_current;	/* zio the batch owner is running */
+	uint_t		zcb_count;
+	zio_t		*zcb_zios[ZIO_CHECKSUM_MANY_MAX];
+} zio_checksum_batch_t;
+
+extern void zio_checksum_batch_enter(zio_checksum_batch_t *zcb);
+extern void zio_checksum_batch_exit(zio_checksum_batch_t *zcb);
+
 typedef struct zio_bad_cksum {
 	const char		*zbc_checksum_name;
 	uint8_t			zbc_byteswapped;
@@ -129,6 +150,7 @@ extern zio_checksum_t abd_checksum_blake3_native;
 extern zio_checksum_t abd_checksum_blake3_byteswap;
 extern zio_checksum_tmpl_init_t abd_checksum_blake3_tmpl_init;
 extern zio_checksum_tmpl_free_t abd_checksum_blake3_tmpl_free;
+extern zio_checksum_many_t abd_checksum_blake3_many;
 
 /* Fletcher 4 */
 _SYS_ZIO_CHECKSUM_H zio_abd_checksum_func_t fletcher_4_abd_ops;
@@ -139,6 +161,7 @@ extern int zio_checksum_equal(spa_t *, blkptr_t *, enum zio_checksum,
     void *, uint64_t, uint64_t, zio_bad_cksum_t *);
 extern void zio_checksum_compute(zio_t *, enum zio_checksum,
     struct abd *, uint64_t);
+extern void zio_checksum_compute_many(zio_t **, uint_t);
 extern int zio_checksum_error_impl(spa_t *, const blkptr_t *, enum zio_checksum,
     struct abd *, uint64_t, uint64_t, zio_bad_cksum_t *);
 extern int zio_checksum_error(zio_t *zio, zio_bad_cksum_t *out);
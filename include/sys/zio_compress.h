@@ -31,6 +31,7 @@
 #define	_SYS_ZIO_COMPRESS_H
 
 #include <sys/abd.h>
+#include <sys/spa_checksum.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -114,7 +115,7 @@ enum zio_zstd_levels {
 	ZIO_ZSTD_LEVEL_FAST_500,
 	ZIO_ZSTD_LEVEL_FAST_1000,
 #define	ZIO_ZSTD_LEVEL_FAST_MAX	ZIO_ZSTD_LEVEL_FAST_1000
-	ZIO_ZSTD_LEVEL_AUTO = 251, /* Reserved for future use */
+	ZIO_ZSTD_LEVEL_AUTO = 251, /* compression=auto */
 	ZIO_ZSTD_LEVEL_LEVELS
 };
 
@@ -140,7 +141,7 @@ typedef int zio_getlevel_func_t(void *src, size_t s_len, uint8_t *level);
  * but is not a requirement for all compression algorithms.
  */
 typedef int zio_decompress_abd_func_t(abd_t *src, void *dst,
-    size_t s_len, size_t d_len, int);
+    size_t s_len, size_t d_len, uint8_t *level);
 /*
  * Information about each compression function.
  */
@@ -150,10 +151,23 @@ typedef const struct zio_compress_info {
 	zio_compress_func_t		*ci_compress;
 	zio_decompress_func_t		*ci_decompress;
 	zio_decompresslevel_func_t	*ci_decompress_level;
+	zio_decompress_abd_func_t	*ci_decompress_abd;
 } zio_compress_info_t;
 
 extern zio_compress_info_t zio_compress_table[ZIO_COMPRESS_FUNCTIONS];
 
+/*
+ * A fletcher4 checksum of compressed output, taken by the compressor as it
+ * wrote it. zcc_cksum covers the first zcc_len bytes of the output, with the
+ * first 32-bit word counted as zero; its real value is zcc_head. See
+ * zio_compress_data_cksum().
+ */
+typedef struct zio_compress_cksum {
+	zio_cksum_t	zcc_cksum;
+	uint64_t	zcc_len;
+	uint32_t	zcc_head;
+} zio_compress_cksum_t;
+
 /*
  * lz4 compression init & free
  */
@@ -179,12 +193,20 @@ extern size_t lz4_compress_zfs(void *src, void *dst, size_t s_len, size_t d_len,
     int level);
 extern int lz4_decompress_zfs(void *src, void *dst, size_t s_len, size_t d_len,
     int level);
+extern size_t lz4_compress_cksum(void *src, void *dst, size_t s_len,
+    size_t d_len, zio_compress_cksum_t *zcc);
+extern int lz4_decompress_abd(abd_t *src, void *dst, size_t s_len,
+    size_t d_len, uint8_t *level);
 
 /*
  * Compress and decompress data if necessary.
  */
 extern size_t zio_compress_data(enum zio_compress c, abd_t *src, void **dst,
     size_t s_len, uint8_t level);
+extern size_t zio_compress_data_cksum(enum zio_compress c, abd_t *src,
+    void **dst, size_t s_len, uint8_t level, zio_compress_cksum_t *zcc);
+extern void zio_compress_cksum_finish(const zio_compress_cksum_t *zcc,
+    const void *buf, size_t size, zio_cksum_t *zcp);
 extern int zio_decompress_data(enum zio_compress c, abd_t *src, void *dst,
     size_t s_len, size_t d_len, uint8_t *level);
 extern int zio_decompress_data_buf(enum zio_compress c, void *src, void *dst,
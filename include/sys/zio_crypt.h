@@ -107,6 +107,10 @@ typedef struct zio_crypt_key {
 #else
 	/* template of current encryption key for illumos crypto api */
 	crypto_ctx_template_t zk_current_tmpl;
+
+	/* per-CPU cache of keys derived from older salts, may be NULL */
+	struct zio_crypt_key_cache *zk_cache;
+	uint_t zk_cache_count;
 #endif
 
 	/* illumos crypto api current hmac key */
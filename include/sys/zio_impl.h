@@ -161,6 +161,8 @@ enum zio_stage {
 	ZIO_STAGE_DONE			= 1 << 25	/* RWFCXT */
 };
 
+#define	ZIO_STAGES	26	/* highbit64(ZIO_STAGE_DONE) */
+
 #define	ZIO_ROOT_PIPELINE			\
 	ZIO_STAGE_DONE
 
@@ -99,6 +99,8 @@ int zfs_zstd_decompress_level(void *s_start, void *d_start, size_t s_len,
     size_t d_len, uint8_t *level);
 int zfs_zstd_decompress(void *s_start, void *d_start, size_t s_len,
     size_t d_len, int n);
+int zfs_zstd_decompress_abd(struct abd *src, void *d_start, size_t s_len,
+    size_t d_len, uint8_t *level);
 void zfs_zstd_cache_reap_now(void);
 
 /*
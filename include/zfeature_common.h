@@ -82,6 +82,9 @@ typedef enum spa_feature {
 	SPA_FEATURE_AVZ_V2,
 	SPA_FEATURE_REDACTION_LIST_SPILL,
 	SPA_FEATURE_RAIDZ_EXPANSION,
+	SPA_FEATURE_FAST_DEDUP,
+	SPA_FEATURE_DEDUP_FLAT,
+	SPA_FEATURE_BRT_FILTER,
 	SPA_FEATURES
 } spa_feature_t;
 
@@ -71,6 +71,9 @@ _ZFS_FLETCHER_H void fletcher_4_fini(void);
 
 /* Internal fletcher ctx */
 
+/* SIMD implementations consume whole multiples of this many bytes */
+#define	FLETCHER_MIN_SIMD_SIZE	64
+
 typedef struct zfs_fletcher_superscalar {
 	uint64_t v[4];
 } zfs_fletcher_superscalar_t;
@@ -38,6 +38,8 @@
 #endif
 #include <libzfs.h>
 #include <libzutil.h>
+#include <pthread.h>
+#include <thread_pool.h>
 #include "libzfs_impl.h"
 #include "zfeature_common.h"
 
@@ -826,6 +828,122 @@ error:
 	return (ret);
 }
 
+/*
+ * Wrapping keys derived while loading a batch of keys, so that encryption
+ * roots which share a passphrase, salt and iteration count (as replicated
+ * ones do) only pay for PBKDF2 once. The cache only lives as long as the
+ * zfs_crypto_load_keys() call, and is zeroed before it is freed.
+ */
+typedef struct derived_key {
+	struct derived_key *dk_next;
+	uint64_t dk_salt;
+	uint64_t dk_iters;
+	size_t dk_material_len;
+	uint8_t *dk_material;
+	uint8_t dk_key[WRAPPING_KEY_LEN];
+} derived_key_t;
+
+typedef struct derived_key_cache {
+	pthread_mutex_t dkc_lock;
+	derived_key_t *dkc_head;
+} derived_key_cache_t;
+
+static void
+derived_key_cache_init(derived_key_cache_t *dkc)
+{
+	VERIFY0(pthread_mutex_init(&dkc->dkc_lock, NULL));
+	dkc->dkc_head = NULL;
+}
+
+static void
+derived_key_cache_fini(derived_key_cache_t *dkc)
+{
+	derived_key_t *dk;
+
+	while ((dk = dkc->dkc_head) != NULL) {
+		dkc->dkc_head = dk->dk_next;
+		memset(dk->dk_material, 0, dk->dk_material_len);
+		free(dk->dk_material);
+		memset(dk, 0, sizeof (*dk));
+		free(dk);
+	}
+	VERIFY0(pthread_mutex_destroy(&dkc->dkc_lock));
+}
+
+static boolean_t
+derived_key_lookup(derived_key_cache_t *dkc, uint64_t iters,
+    const uint8_t *key_material, size_t len, uint64_t salt, uint8_t *key)
+{
+	boolean_t found = B_FALSE;
+
+	VERIFY0(pthread_mutex_lock(&dkc->dkc_lock));
+	for (derived_key_t *dk = dkc->dkc_head; dk != NULL; dk = dk->dk_next) {
+		if (dk->dk_salt == salt && dk->dk_iters == iters &&
+		    dk->dk_material_len == len &&
+		    memcmp(dk->dk_material, key_material, len) == 0) {
+			memcpy(key, dk->dk_key, WRAPPING_KEY_LEN);
+			found = B_TRUE;
+			break;
+		}
+	}
+	VERIFY0(pthread_mutex_unlock(&dkc->dkc_lock));
+
+	return (found);
+}
+
+static void
+derived_key_insert(derived_key_cache_t *dkc, uint64_t iters,
+    const uint8_t *key_material, size_t len, uint64_t salt,
+    const uint8_t *key)
+{
+	derived_key_t *dk = calloc(1, sizeof (*dk));
+
+	if (dk == NULL || (dk->dk_material = malloc(len)) == NULL) {
+		free(dk);
+		return;
+	}
+	dk->dk_salt = salt;
+	dk->dk_iters = iters;
+	dk->dk_material_len = len;
+	memcpy(dk->dk_material, key_material, len);
+	memcpy(dk->dk_key, key, WRAPPING_KEY_LEN);
+
+	VERIFY0(pthread_mutex_lock(&dkc->dkc_lock));
+	dk->dk_next = dkc->dkc_head;
+	dkc->dkc_head = dk;
+	VERIFY0(pthread_mutex_unlock(&dkc->dkc_lock));
+}
+
+/*
+ * As derive_key(), but look passphrase keys up in the given cache first,
+ * and add those derived here to it.
+ */
+static int
+derive_key_cached(libzfs_handle_t *hdl, derived_key_cache_t *dkc,
+    zfs_keyformat_t format, uint64_t iters, uint8_t *key_material,
+    uint64_t salt, uint8_t **key_out)
+{
+	if (dkc == NULL || format != ZFS_KEYFORMAT_PASSPHRASE)
+		return (derive_key(hdl, format, iters, key_material, salt,
+		    key_out));
+
+	size_t len = strlen((char *)key_material);
+	uint8_t *key = zfs_alloc(hdl, WRAPPING_KEY_LEN);
+
+	if (derived_key_lookup(dkc, iters, key_material, len, salt, key)) {
+		*key_out = key;
+		return (0);
+	}
+	free(key);
+
+	int ret = derive_key(hdl, format, iters, key_material, salt, key_out);
+	if (ret == 0)
+		derived_key_insert(dkc, iters, key_material, len, salt,
+		    *key_out);
+
+	return (ret);
+}
+
 static boolean_t
 encryption_feature_is_enabled(zpool_handle_t *zph)
 {
@@ -1198,8 +1316,9 @@ zfs_crypto_clone_check(libzfs_handle_t *hdl, zfs_handle_t *origin_zhp,
 }
 
 typedef struct loadkeys_cbdata {
-	uint64_t cb_numfailed;
-	uint64_t cb_numattempted;
+	zfs_handle_t **cb_handles;
+	size_t cb_alloc;
+	size_t cb_used;
 } loadkey_cbdata_t;
 
 static int
@@ -1219,12 +1338,18 @@ load_keys_cb(zfs_handle_t *zhp, void *arg)
 	if (keystatus == ZFS_KEYSTATUS_AVAILABLE)
 		goto out;
 
-	/* Attempt to load the key. Record status in cb. */
-	cb->cb_numattempted++;
-
-	ret = zfs_crypto_load_key(zhp, B_FALSE, NULL);
-	if (ret)
-		cb->cb_numfailed++;
+	/* Collect the root, all keys are loaded together later. */
+	if (cb->cb_used == cb->cb_alloc) {
+		size_t alloc = cb->cb_alloc != 0 ? cb->cb_alloc * 2 : 64;
+		zfs_handle_t **handles = zfs_realloc(zhp->zfs_hdl,
+		    cb->cb_handles, cb->cb_alloc * sizeof (zfs_handle_t *),
+		    alloc * sizeof (zfs_handle_t *));
+		if (handles == NULL)
+			goto out;
+		cb->cb_handles = handles;
+		cb->cb_alloc = alloc;
+	}
+	cb->cb_handles[cb->cb_used++] = zfs_handle_dup(zhp);
 
 out:
 	(void) zfs_iter_filesystems_v2(zhp, 0, load_keys_cb, cb);
@@ -1255,11 +1380,16 @@ zfs_crypto_attempt_load_keys(libzfs_handle_t *hdl, const char *fsname)
 	if (ret)
 		goto error;
 
+	uint64_t numfailed = zfs_crypto_load_keys(cb.cb_handles, cb.cb_used,
+	    B_FALSE, NULL, sysconf(_SC_NPROCESSORS_ONLN));
+	for (size_t i = 0; i < cb.cb_used; i++)
+		zfs_close(cb.cb_handles[i]);
+	free(cb.cb_handles);
+
 	(void) printf(gettext("%llu / %llu keys successfully loaded\n"),
-	    (u_longlong_t)(cb.cb_numattempted - cb.cb_numfailed),
-	    (u_longlong_t)cb.cb_numattempted);
+	    (u_longlong_t)(cb.cb_used - numfailed), (u_longlong_t)cb.cb_used);
 
-	if (cb.cb_numfailed != 0) {
+	if (numfailed != 0) {
 		ret = -1;
 		goto error;
 	}
@@ -1273,9 +1403,9 @@ error:
 	return (ret);
 }
 
-int
-zfs_crypto_load_key(zfs_handle_t *zhp, boolean_t noop,
-    const char *alt_keylocation)
+static int
+zfs_crypto_load_key_impl(zfs_handle_t *zhp, boolean_t noop,
+    const char *alt_keylocation, derived_key_cache_t *dkc)
 {
 	int ret, attempts = 0;
 	char errbuf[ERRBUFLEN];
@@ -1374,8 +1504,8 @@ try_again:
 		goto error;
 
 	/* derive a key from the key material */
-	ret = derive_key(zhp->zfs_hdl, keyformat, iters, key_material, salt,
-	    &key_data);
+	ret = derive_key_cached(zhp->zfs_hdl, dkc, keyformat, iters,
+	    key_material, salt, &key_data);
 	if (ret != 0)
 		goto error;
 
@@ -1447,6 +1577,109 @@ error:
 	return (ret);
 }
 
+int
+zfs_crypto_load_key(zfs_handle_t *zhp, boolean_t noop,
+    const char *alt_keylocation)
+{
+	return (zfs_crypto_load_key_impl(zhp, noop, alt_keylocation, NULL));
+}
+
+typedef struct load_keys_arg {
+	zfs_handle_t *lka_zhp;
+	boolean_t lka_noop;
+	const char *lka_keylocation;
+	derived_key_cache_t *lka_dkc;
+	int lka_ret;
+} load_keys_arg_t;
+
+static void
+load_keys_task(void *arg)
+{
+	load_keys_arg_t *lka = arg;
+
+	lka->lka_ret = zfs_crypto_load_key_impl(lka->lka_zhp, lka->lka_noop,
+	    lka->lka_keylocation, lka->lka_dkc);
+}
+
+/*
+ * Keys read from a prompt have to be asked for one at a time, and
+ * fetching them over http(s) isn't thread safe. Only keys in files are
+ * loaded in parallel.
+ */
+static boolean_t
+load_key_is_parallel(zfs_handle_t *zhp, const char *alt_keylocation)
+{
+	char prop_keylocation[MAXNAMELEN];
+	const char *keylocation = alt_keylocation;
+
+	if (keylocation == NULL) {
+		if (zfs_prop_get(zhp, ZFS_PROP_KEYLOCATION, prop_keylocation,
+		    sizeof (prop_keylocation), NULL, NULL, 0, B_TRUE) != 0)
+			return (B_FALSE);
+		keylocation = prop_keylocation;
+	}
+
+	return (strncmp(keylocation, "file://", strlen("file://")) == 0);
+}
+
+/*
+ * Load the keys of many encryption roots at once, as zfs_crypto_load_key()
+ * would one after the other. Keys which have to be prompted for or fetched
+ * over the network are loaded first, one at a time. The others are read,
+ * derived and loaded by up to nthr threads. Wrapping keys derived from a
+ * passphrase are shared between roots with the same passphrase, salt and
+ * iteration count. Returns the number of keys which failed to load.
+ */
+uint64_t
+zfs_crypto_load_keys(zfs_handle_t **zhps, size_t count, boolean_t noop,
+    const char *alt_keylocation, uint_t nthr)
+{
+	load_keys_arg_t *lka;
+	derived_key_cache_t dkc;
+	tpool_t *tp = NULL;
+	uint64_t failed = 0;
+
+	if (count == 0)
+		return (0);
+
+	lka = zfs_alloc(zhps[0]->zfs_hdl, count * sizeof (load_keys_arg_t));
+	derived_key_cache_init(&dkc);
+
+	if (nthr > 1 && count > 1)
+		tp = tpool_create(1, MIN(nthr, count), 0, NULL);
+
+	for (size_t i = 0; i < count; i++) {
+		lka[i].lka_zhp = zhps[i];
+		lka[i].lka_noop = noop;
+		lka[i].lka_keylocation = alt_keylocation;
+		lka[i].lka_dkc = &dkc;
+		if (tp == NULL || !load_key_is_parallel(zhps[i],
+		    alt_keylocation))
+			load_keys_task(&lka[i]);
+	}
+
+	if (tp != NULL) {
+		for (size_t i = 0; i < count; i++) {
+			if (!load_key_is_parallel(zhps[i], alt_keylocation))
+				continue;
+			if (tpool_dispatch(tp, load_keys_task, &lka[i]) != 0)
+				load_keys_task(&lka[i]);
+		}
+		tpool_wait(tp);
+		tpool_destroy(tp);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (lka[i].lka_ret != 0)
+			failed++;
+	}
+
+	derived_key_cache_fini(&dkc);
+	free(lka);
+
+	return (failed);
+}
+
 int
 zfs_crypto_unload_key(zfs_handle_t *zhp)
 {
@@ -377,16 +377,13 @@ get_recvd_props_ioctl(zfs_handle_t *zhp)
 	return (0);
 }
 
+/*
+ * Store the given property nvlist in the handle, taking ownership of it.
+ */
 static int
-put_stats_zhdl(zfs_handle_t *zhp, zfs_cmd_t *zc)
+put_props_zhdl(zfs_handle_t *zhp, nvlist_t *allprops)
 {
-	nvlist_t *allprops, *userprops;
-
-	zhp->zfs_dmustats = zc->zc_objset_stats; /* structure assignment */
-
-	if (zcmd_read_dst_nvlist(zhp->zfs_hdl, zc, &allprops) != 0) {
-		return (-1);
-	}
+	nvlist_t *userprops;
 
 	/*
 	 * XXX Why do we store the user props separately, in addition to
@@ -406,6 +403,20 @@ put_stats_zhdl(zfs_handle_t *zhp, zfs_cmd_t *zc)
 	return (0);
 }
 
+static int
+put_stats_zhdl(zfs_handle_t *zhp, zfs_cmd_t *zc)
+{
+	nvlist_t *allprops;
+
+	zhp->zfs_dmustats = zc->zc_objset_stats; /* structure assignment */
+
+	if (zcmd_read_dst_nvlist(zhp->zfs_hdl, zc, &allprops) != 0) {
+		return (-1);
+	}
+
+	return (put_props_zhdl(zhp, allprops));
+}
+
 static int
 get_stats(zfs_handle_t *zhp)
 {
@@ -432,15 +443,11 @@ zfs_refresh_properties(zfs_handle_t *zhp)
 }
 
 /*
- * Makes a handle from the given dataset name.  Used by zfs_open() and
- * zfs_iter_* to create child handles on the fly.
+ * Determine the type of a handle whose stats have been filled in.
  */
 static int
-make_dataset_handle_common(zfs_handle_t *zhp, zfs_cmd_t *zc)
+make_dataset_handle_type(zfs_handle_t *zhp)
 {
-	if (put_stats_zhdl(zhp, zc) != 0)
-		return (-1);
-
 	/*
 	 * We've managed to open the dataset and gather statistics.  Determine
 	 * the high-level type.
@@ -474,6 +481,19 @@ make_dataset_handle_common(zfs_handle_t *zhp, zfs_cmd_t *zc)
 	return (0);
 }
 
+/*
+ * Makes a handle from the given dataset name.  Used by zfs_open() and
+ * zfs_iter_* to create child handles on the fly.
+ */
+static int
+make_dataset_handle_common(zfs_handle_t *zhp, zfs_cmd_t *zc)
+{
+	if (put_stats_zhdl(zhp, zc) != 0)
+		return (-1);
+
+	return (make_dataset_handle_type(zhp));
+}
+
 zfs_handle_t *
 make_dataset_handle(libzfs_handle_t *hdl, const char *path)
 {
@@ -559,6 +579,56 @@ make_dataset_simple_handle_zc(zfs_handle_t *pzhp, zfs_cmd_t *zc)
 	return (zhp);
 }
 
+/*
+ * Makes a handle from one entry of the ZFS_IOC_DATASET_LIST_BATCH output.
+ * Entries listed without properties get a simple handle, as from
+ * make_dataset_simple_handle_zc().
+ */
+zfs_handle_t *
+make_dataset_handle_nvl(zfs_handle_t *pzhp, const char *name, nvlist_t *nvl)
+{
+	zfs_handle_t *zhp;
+	nvlist_t *props;
+	uint8_t *stats;
+	uint_t len;
+
+	if (nvlist_lookup_uint8_array(nvl, DATASET_LIST_STATS, &stats,
+	    &len) != 0 || len != sizeof (zhp->zfs_dmustats))
+		return (NULL);
+
+	if ((zhp = calloc(1, sizeof (zfs_handle_t))) == NULL)
+		return (NULL);
+
+	zhp->zfs_hdl = pzhp->zfs_hdl;
+	(void) strlcpy(zhp->zfs_name, name, sizeof (zhp->zfs_name));
+	memcpy(&zhp->zfs_dmustats, stats, len);
+
+	if (nvlist_lookup_nvlist(nvl, DATASET_LIST_PROPS, &props) != 0) {
+		zhp->zfs_head_type = pzhp->zfs_type;
+		zhp->zfs_type = ZFS_TYPE_SNAPSHOT;
+		zhp->zpool_hdl = zpool_handle(zhp);
+
+		if (zhp->zfs_dmustats.dds_is_snapshot ||
+		    strchr(name, '@') != NULL)
+			zhp->zfs_type = ZFS_TYPE_SNAPSHOT;
+		else if (zhp->zfs_dmustats.dds_type == DMU_OST_ZVOL)
+			zhp->zfs_type = ZFS_TYPE_VOLUME;
+		else if (zhp->zfs_dmustats.dds_type == DMU_OST_ZFS)
+			zhp->zfs_type = ZFS_TYPE_FILESYSTEM;
+
+		return (zhp);
+	}
+
+	if (put_props_zhdl(zhp, fnvlist_dup(props)) != 0 ||
+	    make_dataset_handle_type(zhp) != 0) {
+		nvlist_free(zhp->zfs_props);
+		nvlist_free(zhp->zfs_user_props);
+		free(zhp);
+		return (NULL);
+	}
+	return (zhp);
+}
+
 zfs_handle_t *
 zfs_handle_dup(zfs_handle_t *zhp_orig)
 {
@@ -2811,6 +2881,8 @@ zfs_prop_get(zfs_handle_t *zhp, zfs_prop_t prop, char *propbuf, size_t proplen,
 	case ZFS_PROP_REFQUOTA:
 	case ZFS_PROP_RESERVATION:
 	case ZFS_PROP_REFRESERVATION:
+	case ZFS_PROP_ARCMIN:
+	case ZFS_PROP_ARCMAX:
 
 		if (get_numeric_property(zhp, prop, src, &source, &val) != 0)
 			return (-1);
@@ -2990,6 +3062,7 @@ zfs_prop_get(zfs_handle_t *zhp, zfs_prop_t prop, char *propbuf, size_t proplen,
 	case ZFS_PROP_USEDDS:
 	case ZFS_PROP_USEDREFRESERV:
 	case ZFS_PROP_USEDCHILD:
+	case ZFS_PROP_ARCUSED:
 		if (get_numeric_property(zhp, prop, src, &source, &val) != 0)
 			return (-1);
 		if (literal) {
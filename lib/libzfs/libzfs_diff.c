@@ -60,14 +60,57 @@
 #define	ZDIFF_REMOVED_COLOR  ANSI_RED
 #define	ZDIFF_RENAMED_COLOR  ANSI_BOLD_BLUE
 
+/*
+ * Objects are looked up in the snapshots by a pool of threads, since each
+ * lookup is an ioctl which walks the object's parent directories to build
+ * its path.  The results are kept in a window of these, in the order the
+ * kernel reported the objects, and printed from there in that order.
+ */
+#define	DIFF_LOOKUP_THREADS	16
+#define	DIFF_LOOKUP_WINDOW	(4 * DIFF_LOOKUP_THREADS)
+
+typedef struct differ_stat {
+	int		ds_err;		/* from get_stats_for_obj() */
+	int		ds_zerr;	/* errno of the ioctl */
+	zfs_stat_t	ds_sb;
+	char		ds_name[MAXPATHLEN];
+	char		ds_errbuf[ERRBUFLEN];
+} differ_stat_t;
+
+typedef struct differ_obj {
+	uint64_t	do_obj;
+	boolean_t	do_free;	/* only look in the from snapshot */
+	boolean_t	do_done;
+	differ_stat_t	do_from;
+	differ_stat_t	do_to;
+	struct differ_obj *do_next;	/* on the lookup queue */
+} differ_obj_t;
+
+typedef struct differ_pool {
+	differ_info_t	*dp_di;
+	pthread_mutex_t	dp_lock;
+	pthread_cond_t	dp_work_cv;
+	pthread_cond_t	dp_done_cv;
+	differ_obj_t	*dp_qhead;
+	differ_obj_t	*dp_qtail;
+	boolean_t	dp_exit;
+	pthread_t	dp_threads[DIFF_LOOKUP_THREADS];
+	int		dp_nthreads;
+	differ_obj_t	dp_window[DIFF_LOOKUP_WINDOW];
+	uint64_t	dp_head;	/* next to print */
+	uint64_t	dp_tail;	/* next free */
+} differ_pool_t;
+
 /*
  * Given a {dsname, object id}, get the object path
  */
 static int
 get_stats_for_obj(differ_info_t *di, const char *dsname, uint64_t obj,
-    char *pn, int maxlen, zfs_stat_t *sb)
+    differ_stat_t *ds)
 {
 	zfs_cmd_t zc = {"\0"};
+	char *pn = ds->ds_name;
+	int maxlen = sizeof (ds->ds_name);
 	int error;
 
 	(void) strlcpy(zc.zc_name, dsname, sizeof (zc.zc_name));
@@ -75,32 +118,32 @@ get_stats_for_obj(differ_info_t *di, const char *dsname, uint64_t obj,
 
 	errno = 0;
 	error = zfs_ioctl(di->zhp->zfs_hdl, ZFS_IOC_OBJ_TO_STATS, &zc);
-	di->zerr = errno;
+	ds->ds_zerr = errno;
 
 	/* we can get stats even if we failed to get a path */
-	(void) memcpy(sb, &zc.zc_stat, sizeof (zfs_stat_t));
+	(void) memcpy(&ds->ds_sb, &zc.zc_stat, sizeof (zfs_stat_t));
 	if (error == 0) {
-		ASSERT(di->zerr == 0);
+		ASSERT(ds->ds_zerr == 0);
 		(void) strlcpy(pn, zc.zc_value, maxlen);
 		return (0);
 	}
 
-	if (di->zerr == ESTALE) {
+	if (ds->ds_zerr == ESTALE) {
 		(void) snprintf(pn, maxlen, "(on_delete_queue)");
 		return (0);
-	} else if (di->zerr == EPERM) {
-		(void) snprintf(di->errbuf, sizeof (di->errbuf),
+	} else if (ds->ds_zerr == EPERM) {
+		(void) snprintf(ds->ds_errbuf, sizeof (ds->ds_errbuf),
 		    dgettext(TEXT_DOMAIN,
 		    "The sys_config privilege or diff delegated permission "
 		    "is needed\nto discover path names"));
 		return (-1);
-	} else if (di->zerr == EACCES) {
-		(void) snprintf(di->errbuf, sizeof (di->errbuf),
+	} else if (ds->ds_zerr == EACCES) {
+		(void) snprintf(ds->ds_errbuf, sizeof (ds->ds_errbuf),
 		    dgettext(TEXT_DOMAIN,
 		    "Key must be loaded to discover path names"));
 		return (-1);
 	} else {
-		(void) snprintf(di->errbuf, sizeof (di->errbuf),
+		(void) snprintf(ds->ds_errbuf, sizeof (ds->ds_errbuf),
 		    dgettext(TEXT_DOMAIN,
 		    "Unable to determine path or stats for "
 		    "object %lld in %s"), (longlong_t)obj, dsname);
@@ -258,19 +301,26 @@ print_file(FILE *fp, differ_info_t *di, char type, const char *file,
 		color_end();
 }
 
+static void
+report_stats_error(differ_info_t *di, differ_stat_t *ds)
+{
+	(void) strlcpy(di->errbuf, ds->ds_errbuf, sizeof (di->errbuf));
+	zfs_error_aux(di->zhp->zfs_hdl, "%s", zfs_strerror(ds->ds_zerr));
+	zfs_error(di->zhp->zfs_hdl, ds->ds_zerr, di->errbuf);
+}
+
 static int
-write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
+write_inuse_diffs_one(FILE *fp, differ_info_t *di, differ_obj_t *dob)
 {
+	differ_stat_t *from = &dob->do_from;
+	differ_stat_t *to = &dob->do_to;
 	struct zfs_stat fsb, tsb;
 	mode_t fmode, tmode;
-	char fobjname[MAXPATHLEN], tobjname[MAXPATHLEN];
+	char *fobjname = from->ds_name, *tobjname = to->ds_name;
 	boolean_t already_logged = B_FALSE;
-	int fobjerr, tobjerr;
+	int fobjerr = from->ds_err, tobjerr = to->ds_err;
 	int change;
 
-	if (dobj == di->shares)
-		return (0);
-
 	/*
 	 * Check the from and to snapshots for info on the object. If
 	 * we get ENOENT, then the object just didn't exist in that
@@ -280,11 +330,9 @@ write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
 	 * errno and continue.
 	 */
 
-	fobjerr = get_stats_for_obj(di, di->fromsnap, dobj, fobjname,
-	    MAXPATHLEN, &fsb);
-	if (fobjerr && di->zerr != ENOTSUP && di->zerr != ENOENT) {
-		zfs_error_aux(di->zhp->zfs_hdl, "%s", zfs_strerror(di->zerr));
-		zfs_error(di->zhp->zfs_hdl, di->zerr, di->errbuf);
+	fsb = from->ds_sb;
+	if (fobjerr && from->ds_zerr != ENOTSUP && from->ds_zerr != ENOENT) {
+		report_stats_error(di, from);
 		/*
 		 * Let's not print an error for the same object more than
 		 * once if it happens in both snapshots
@@ -292,15 +340,10 @@ write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
 		already_logged = B_TRUE;
 	}
 
-	tobjerr = get_stats_for_obj(di, di->tosnap, dobj, tobjname,
-	    MAXPATHLEN, &tsb);
-
-	if (tobjerr && di->zerr != ENOTSUP && di->zerr != ENOENT) {
-		if (!already_logged) {
-			zfs_error_aux(di->zhp->zfs_hdl,
-			    "%s", zfs_strerror(di->zerr));
-			zfs_error(di->zhp->zfs_hdl, di->zerr, di->errbuf);
-		}
+	tsb = to->ds_sb;
+	if (tobjerr && to->ds_zerr != ENOTSUP && to->ds_zerr != ENOENT) {
+		if (!already_logged)
+			report_stats_error(di, to);
 	}
 	/*
 	 * Unallocated object sharing the same meta dnode block
@@ -362,43 +405,188 @@ write_inuse_diffs_one(FILE *fp, differ_info_t *di, uint64_t dobj)
 }
 
 static int
-write_inuse_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
+describe_free(FILE *fp, differ_info_t *di, differ_obj_t *dob)
+{
+	differ_stat_t *from = &dob->do_from;
+
+	/* Don't print if in the delete queue on from side */
+	if (from->ds_zerr == ESTALE || from->ds_zerr == ENOENT)
+		return (0);
+
+	print_file(fp, di, ZDIFF_REMOVED, from->ds_name, &from->ds_sb);
+	if (from->ds_zerr != 0) {
+		(void) strlcpy(di->errbuf, from->ds_errbuf,
+		    sizeof (di->errbuf));
+		di->zerr = from->ds_zerr;
+	}
+	return (0);
+}
+
+static void *
+differ_lookup_thread(void *arg)
+{
+	differ_pool_t *dp = arg;
+	differ_info_t *di = dp->dp_di;
+
+	(void) pthread_mutex_lock(&dp->dp_lock);
+	for (;;) {
+		while (dp->dp_qhead == NULL && !dp->dp_exit)
+			(void) pthread_cond_wait(&dp->dp_work_cv,
+			    &dp->dp_lock);
+		differ_obj_t *dob = dp->dp_qhead;
+		if (dob == NULL)
+			break;
+		dp->dp_qhead = dob->do_next;
+		if (dp->dp_qhead == NULL)
+			dp->dp_qtail = NULL;
+		(void) pthread_mutex_unlock(&dp->dp_lock);
+
+		dob->do_from.ds_err = get_stats_for_obj(di, di->fromsnap,
+		    dob->do_obj, &dob->do_from);
+		if (!dob->do_free) {
+			dob->do_to.ds_err = get_stats_for_obj(di, di->tosnap,
+			    dob->do_obj, &dob->do_to);
+		}
+
+		(void) pthread_mutex_lock(&dp->dp_lock);
+		dob->do_done = B_TRUE;
+		(void) pthread_cond_broadcast(&dp->dp_done_cv);
+	}
+	(void) pthread_mutex_unlock(&dp->dp_lock);
+	return (NULL);
+}
+
+/*
+ * Print the oldest object in the window once it has been looked up.
+ */
+static int
+differ_print_one(FILE *fp, differ_pool_t *dp)
+{
+	differ_obj_t *dob = &dp->dp_window[dp->dp_head % DIFF_LOOKUP_WINDOW];
+
+	(void) pthread_mutex_lock(&dp->dp_lock);
+	while (!dob->do_done)
+		(void) pthread_cond_wait(&dp->dp_done_cv, &dp->dp_lock);
+	(void) pthread_mutex_unlock(&dp->dp_lock);
+	dp->dp_head++;
+
+	if (dob->do_free)
+		return (describe_free(fp, dp->dp_di, dob));
+	return (write_inuse_diffs_one(fp, dp->dp_di, dob));
+}
+
+/*
+ * Queue an object to be looked up, first printing the oldest one if the
+ * window is full.
+ */
+static int
+differ_enqueue(FILE *fp, differ_pool_t *dp, uint64_t obj, boolean_t free)
 {
-	uint64_t o;
 	int err;
 
-	for (o = dr->ddr_first; o <= dr->ddr_last; o++) {
-		if ((err = write_inuse_diffs_one(fp, di, o)) != 0)
+	if (dp->dp_tail - dp->dp_head == DIFF_LOOKUP_WINDOW) {
+		if ((err = differ_print_one(fp, dp)) != 0)
 			return (err);
+		if (dp->dp_di->zerr != 0)
+			return (-1);
 	}
+
+	differ_obj_t *dob = &dp->dp_window[dp->dp_tail++ % DIFF_LOOKUP_WINDOW];
+	dob->do_obj = obj;
+	dob->do_free = free;
+	dob->do_done = B_FALSE;
+	dob->do_next = NULL;
+
+	(void) pthread_mutex_lock(&dp->dp_lock);
+	if (dp->dp_qtail != NULL)
+		dp->dp_qtail->do_next = dob;
+	else
+		dp->dp_qhead = dob;
+	dp->dp_qtail = dob;
+	(void) pthread_cond_signal(&dp->dp_work_cv);
+	(void) pthread_mutex_unlock(&dp->dp_lock);
 	return (0);
 }
 
+/*
+ * Print everything still in the window.
+ */
 static int
-describe_free(FILE *fp, differ_info_t *di, uint64_t object, char *namebuf,
-    int maxlen)
+differ_drain(FILE *fp, differ_pool_t *dp)
 {
-	struct zfs_stat sb;
+	int err;
+
+	while (dp->dp_head != dp->dp_tail) {
+		if ((err = differ_print_one(fp, dp)) != 0)
+			return (err);
+		if (dp->dp_di->zerr != 0)
+			return (-1);
+	}
+	return (0);
+}
 
-	(void) get_stats_for_obj(di, di->fromsnap, object, namebuf,
-	    maxlen, &sb);
+static void
+differ_pool_fini(void *arg)
+{
+	differ_pool_t *dp = arg;
+
+	(void) pthread_mutex_lock(&dp->dp_lock);
+	dp->dp_exit = B_TRUE;
+	(void) pthread_cond_broadcast(&dp->dp_work_cv);
+	(void) pthread_mutex_unlock(&dp->dp_lock);
+	for (int i = 0; i < dp->dp_nthreads; i++)
+		(void) pthread_join(dp->dp_threads[i], NULL);
+	(void) pthread_cond_destroy(&dp->dp_done_cv);
+	(void) pthread_cond_destroy(&dp->dp_work_cv);
+	(void) pthread_mutex_destroy(&dp->dp_lock);
+	free(dp);
+}
 
-	/* Don't print if in the delete queue on from side */
-	if (di->zerr == ESTALE || di->zerr == ENOENT) {
-		di->zerr = 0;
-		return (0);
+static differ_pool_t *
+differ_pool_init(differ_info_t *di)
+{
+	differ_pool_t *dp = calloc(1, sizeof (*dp));
+
+	if (dp == NULL)
+		return (NULL);
+	dp->dp_di = di;
+	(void) pthread_mutex_init(&dp->dp_lock, NULL);
+	(void) pthread_cond_init(&dp->dp_work_cv, NULL);
+	(void) pthread_cond_init(&dp->dp_done_cv, NULL);
+	for (int i = 0; i < DIFF_LOOKUP_THREADS; i++) {
+		if (pthread_create(&dp->dp_threads[i], NULL,
+		    differ_lookup_thread, dp) != 0)
+			break;
+		dp->dp_nthreads++;
 	}
+	if (dp->dp_nthreads == 0) {
+		differ_pool_fini(dp);
+		return (NULL);
+	}
+	return (dp);
+}
+
+static int
+write_inuse_diffs(FILE *fp, differ_pool_t *dp, dmu_diff_record_t *dr)
+{
+	uint64_t o;
+	int err;
 
-	print_file(fp, di, ZDIFF_REMOVED, namebuf, &sb);
+	for (o = dr->ddr_first; o <= dr->ddr_last; o++) {
+		if (o == dp->dp_di->shares)
+			continue;
+		if ((err = differ_enqueue(fp, dp, o, B_FALSE)) != 0)
+			return (err);
+	}
 	return (0);
 }
 
 static int
-write_free_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
+write_free_diffs(FILE *fp, differ_pool_t *dp, dmu_diff_record_t *dr)
 {
+	differ_info_t *di = dp->dp_di;
 	zfs_cmd_t zc = {"\0"};
 	libzfs_handle_t *lhdl = di->zhp->zfs_hdl;
-	char fobjname[MAXPATHLEN];
 
 	(void) strlcpy(zc.zc_name, di->fromsnap, sizeof (zc.zc_name));
 	zc.zc_obj = dr->ddr_first - 1;
@@ -417,8 +605,8 @@ write_free_diffs(FILE *fp, differ_info_t *di, dmu_diff_record_t *dr)
 			if (zc.zc_obj > dr->ddr_last) {
 				break;
 			}
-			(void) describe_free(fp, di, zc.zc_obj, fobjname,
-			    MAXPATHLEN);
+			if (differ_enqueue(fp, dp, zc.zc_obj, B_TRUE) != 0)
+				break;
 		} else if (errno == ESRCH) {
 			break;
 		} else {
@@ -439,6 +627,7 @@ static void *
 differ(void *arg)
 {
 	differ_info_t *di = arg;
+	differ_pool_t *dp;
 	dmu_diff_record_t dr;
 	FILE *ofp;
 	int err = 0;
@@ -450,31 +639,50 @@ differ(void *arg)
 		return ((void *)-1);
 	}
 
+	if ((dp = differ_pool_init(di)) == NULL) {
+		di->zerr = errno != 0 ? errno : ENOMEM;
+		strlcpy(di->errbuf, zfs_strerror(di->zerr),
+		    sizeof (di->errbuf));
+		(void) fclose(ofp);
+		(void) close(di->datafd);
+		return ((void *)-1);
+	}
+
+	/*
+	 * We may be cancelled while waiting for data; only allow that in
+	 * read(), and stop the lookup threads if it happens.
+	 */
+	(void) pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	pthread_cleanup_push(differ_pool_fini, dp);
+
 	for (;;) {
 		char *cp = (char *)&dr;
 		int len = sizeof (dr);
 		int rv;
 
+		(void) pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
 		do {
 			rv = read(di->datafd, cp, len);
 			cp += rv;
 			len -= rv;
 		} while (len > 0 && rv > 0);
+		(void) pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
 
 		if (rv < 0 || (rv == 0 && len != sizeof (dr))) {
 			di->zerr = EPIPE;
 			break;
 		} else if (rv == 0) {
 			/* end of file at a natural breaking point */
+			err = differ_drain(ofp, dp);
 			break;
 		}
 
 		switch (dr.ddr_type) {
 		case DDR_FREE:
-			err = write_free_diffs(ofp, di, &dr);
+			err = write_free_diffs(ofp, dp, &dr);
 			break;
 		case DDR_INUSE:
-			err = write_inuse_diffs(ofp, di, &dr);
+			err = write_inuse_diffs(ofp, dp, &dr);
 			break;
 		default:
 			di->zerr = EPIPE;
@@ -485,6 +693,7 @@ differ(void *arg)
 			break;
 	}
 
+	pthread_cleanup_pop(1);
 	(void) fclose(ofp);
 	(void) close(di->datafd);
 	if (err)
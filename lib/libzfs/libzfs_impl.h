@@ -70,6 +70,7 @@ struct libzfs_handle {
 	boolean_t libzfs_prop_debug;
 	regex_t libzfs_urire;
 	uint64_t libzfs_max_nvlist;
+	boolean_t libzfs_no_list_batch;
 	void *libfetch;
 	char *libfetch_load_error;
 };
@@ -138,6 +139,8 @@ extern int zpool_standard_error_fmt(libzfs_handle_t *, int, const char *, ...)
 
 extern zfs_handle_t *make_dataset_handle_zc(libzfs_handle_t *, zfs_cmd_t *);
 extern zfs_handle_t *make_dataset_simple_handle_zc(zfs_handle_t *, zfs_cmd_t *);
+extern zfs_handle_t *make_dataset_handle_nvl(zfs_handle_t *, const char *,
+    nvlist_t *);
 
 extern int zprop_parse_value(libzfs_handle_t *, nvpair_t *, int, zfs_type_t,
     nvlist_t *, const char **, uint64_t *, const char *);
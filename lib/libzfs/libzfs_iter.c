@@ -99,6 +99,64 @@ top:
 	return (rc);
 }
 
+/*
+ * Iterate using ZFS_IOC_DATASET_LIST_BATCH, which returns many datasets
+ * per call instead of one.  Returns ZFS_ERR_IOC_CMD_UNAVAIL without
+ * calling func if the kernel module predates it, so that the caller can
+ * fall back to the single-step list ioctls.
+ */
+static int
+zfs_iter_batch(zfs_handle_t *zhp, nvlist_t *args, zfs_iter_f func,
+    void *data)
+{
+	libzfs_handle_t *hdl = zhp->zfs_hdl;
+	uint64_t cursor = 0;
+	int ret = 0;
+
+	if (hdl->libzfs_no_list_batch)
+		return (ZFS_ERR_IOC_CMD_UNAVAIL);
+
+	do {
+		nvlist_t *outnvl, *datasets;
+		int err;
+
+		fnvlist_add_uint64(args, DATASET_LIST_CURSOR, cursor);
+		err = lzc_dataset_list_batch(zhp->zfs_name, args, &outnvl);
+		if (err == ZFS_ERR_IOC_CMD_UNAVAIL && cursor == 0) {
+			hdl->libzfs_no_list_batch = B_TRUE;
+			return (err);
+		} else if (err == ENOENT) {
+			/* The dataset has been removed since we opened it. */
+			return (0);
+		} else if (err != 0) {
+			return (zfs_standard_error(hdl, err,
+			    dgettext(TEXT_DOMAIN,
+			    "cannot iterate filesystems")));
+		}
+
+		datasets = fnvlist_lookup_nvlist(outnvl, DATASET_LIST_DATASETS);
+		for (nvpair_t *pair = nvlist_next_nvpair(datasets, NULL);
+		    pair != NULL && ret == 0;
+		    pair = nvlist_next_nvpair(datasets, pair)) {
+			zfs_handle_t *nzhp = make_dataset_handle_nvl(zhp,
+			    nvpair_name(pair), fnvpair_value_nvlist(pair));
+			/*
+			 * Silently ignore errors, as in the single-step
+			 * iteration below.
+			 */
+			if (nzhp != NULL)
+				ret = func(nzhp, data);
+		}
+
+		if (nvlist_lookup_uint64(outnvl, DATASET_LIST_CURSOR,
+		    &cursor) != 0)
+			cursor = 0;
+		fnvlist_free(outnvl);
+	} while (ret == 0 && cursor != 0);
+
+	return (ret);
+}
+
 /*
  * Iterate over all child filesystems
  */
@@ -119,6 +177,14 @@ zfs_iter_filesystems_v2(zfs_handle_t *zhp, int flags, zfs_iter_f func,
 	if (zhp->zfs_type != ZFS_TYPE_FILESYSTEM)
 		return (0);
 
+	nvlist_t *args = fnvlist_alloc();
+	if ((flags & ZFS_ITER_SIMPLE) == ZFS_ITER_SIMPLE)
+		fnvlist_add_boolean(args, DATASET_LIST_SIMPLE);
+	ret = zfs_iter_batch(zhp, args, func, data);
+	fnvlist_free(args);
+	if (ret != ZFS_ERR_IOC_CMD_UNAVAIL)
+		return (ret);
+
 	zcmd_alloc_dst_nvlist(zhp->zfs_hdl, &zc, 0);
 
 	if ((flags & ZFS_ITER_SIMPLE) == ZFS_ITER_SIMPLE)
@@ -170,6 +236,19 @@ zfs_iter_snapshots_v2(zfs_handle_t *zhp, int flags, zfs_iter_f func,
 	    zhp->zfs_type == ZFS_TYPE_BOOKMARK)
 		return (0);
 
+	nvlist_t *args = fnvlist_alloc();
+	fnvlist_add_boolean(args, DATASET_LIST_SNAPSHOTS);
+	if ((flags & ZFS_ITER_SIMPLE) != 0)
+		fnvlist_add_boolean(args, DATASET_LIST_SIMPLE);
+	if (min_txg != 0)
+		fnvlist_add_uint64(args, SNAP_ITER_MIN_TXG, min_txg);
+	if (max_txg != 0)
+		fnvlist_add_uint64(args, SNAP_ITER_MAX_TXG, max_txg);
+	ret = zfs_iter_batch(zhp, args, func, data);
+	fnvlist_free(args);
+	if (ret != ZFS_ERR_IOC_CMD_UNAVAIL)
+		return (ret);
+
 	zc.zc_simple = (flags & ZFS_ITER_SIMPLE) != 0;
 
 	zcmd_alloc_dst_nvlist(zhp->zfs_hdl, &zc, 0);
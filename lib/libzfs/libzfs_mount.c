@@ -1288,6 +1288,13 @@ zpool_enable_datasets(zpool_handle_t *zhp, const char *mntopts, int flags,
 	    ZFS_TYPE_DATASET)) == NULL)
 		goto out;
 
+	/*
+	 * Have the kernel read ahead the properties and objset blocks of
+	 * every dataset in the pool in parallel, so that neither the
+	 * iteration below nor the mounts wait on those reads one by one.
+	 */
+	(void) lzc_mount_prefetch(zhp->zpool_name);
+
 	/*
 	 * Gather all non-snapshot datasets within the pool. Start by adding
 	 * the root filesystem for this pool to the list, and then iterate
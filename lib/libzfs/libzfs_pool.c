@@ -342,6 +342,7 @@ zpool_get_prop(zpool_handle_t *zhp, zpool_prop_t prop, char *buf,
 		case ZPOOL_PROP_MAXDNODESIZE:
 		case ZPOOL_PROP_BCLONESAVED:
 		case ZPOOL_PROP_BCLONEUSED:
+		case ZPOOL_PROP_DEDUP_TABLE_SIZE:
 			if (literal)
 				(void) snprintf(buf, len, "%llu",
 				    (u_longlong_t)intval);
@@ -349,6 +350,18 @@ zpool_get_prop(zpool_handle_t *zhp, zpool_prop_t prop, char *buf,
 				(void) zfs_nicenum(intval, buf, len);
 			break;
 
+		case ZPOOL_PROP_DEDUP_TABLE_QUOTA:
+		case ZPOOL_PROP_SCRUB_RATE_LIMIT:
+			if (intval == 0) {
+				(void) strlcpy(buf, "none", len);
+			} else if (literal) {
+				(void) snprintf(buf, len, "%llu",
+				    (u_longlong_t)intval);
+			} else {
+				(void) zfs_nicebytes(intval, buf, len);
+			}
+			break;
+
 		case ZPOOL_PROP_EXPANDSZ:
 		case ZPOOL_PROP_CHECKPOINT:
 			if (intval == 0) {
@@ -371,6 +384,18 @@ zpool_get_prop(zpool_handle_t *zhp, zpool_prop_t prop, char *buf,
 			}
 			break;
 
+		case ZPOOL_PROP_SCRUB_LATENCY_TARGET:
+			if (intval == 0) {
+				(void) strlcpy(buf, "none", len);
+			} else if (literal) {
+				(void) snprintf(buf, len, "%llu",
+				    (u_longlong_t)intval);
+			} else {
+				(void) snprintf(buf, len, "%llums",
+				    (u_longlong_t)intval);
+			}
+			break;
+
 		case ZPOOL_PROP_FRAGMENTATION:
 			if (intval == UINT64_MAX) {
 				(void) strlcpy(buf, "-", len);
@@ -2683,7 +2708,8 @@ zpool_scan(zpool_handle_t *zhp, pool_scan_func_t func, pool_scrub_cmd_t cmd)
 	 * 3. Error scrub is not run because of no error log.
 	 */
 	if (err == ECANCELED && (func == POOL_SCAN_SCRUB ||
-	    func == POOL_SCAN_ERRORSCRUB) && cmd == POOL_SCRUB_NORMAL)
+	    func == POOL_SCAN_ERRORSCRUB) && (cmd == POOL_SCRUB_NORMAL ||
+	    cmd == POOL_SCRUB_FROM_LAST_TXG))
 		return (0);
 	/*
 	 * The following cases have been handled here:
@@ -2703,7 +2729,8 @@ zpool_scan(zpool_handle_t *zhp, pool_scan_func_t func, pool_scrub_cmd_t cmd)
 			    dgettext(TEXT_DOMAIN, "cannot pause scrubbing %s"),
 			    zhp->zpool_name);
 		} else {
-			assert(cmd == POOL_SCRUB_NORMAL);
+			assert(cmd == POOL_SCRUB_NORMAL ||
+			    cmd == POOL_SCRUB_FROM_LAST_TXG);
 			(void) snprintf(errbuf, sizeof (errbuf),
 			    dgettext(TEXT_DOMAIN, "cannot scrub %s"),
 			    zhp->zpool_name);
@@ -2743,7 +2770,8 @@ zpool_scan(zpool_handle_t *zhp, pool_scan_func_t func, pool_scrub_cmd_t cmd)
 		    ps->pss_state == DSS_SCANNING) {
 			if (ps->pss_pass_scrub_pause == 0) {
 				/* handles case 1 */
-				assert(cmd == POOL_SCRUB_NORMAL);
+				assert(cmd == POOL_SCRUB_NORMAL ||
+				    cmd == POOL_SCRUB_FROM_LAST_TXG);
 				return (zfs_error(hdl, EZFS_SCRUBBING,
 				    errbuf));
 			} else {
@@ -2766,7 +2794,8 @@ zpool_scan(zpool_handle_t *zhp, pool_scan_func_t func, pool_scrub_cmd_t cmd)
 		    ps->pss_error_scrub_state == DSS_ERRORSCRUBBING) {
 			if (ps->pss_pass_error_scrub_pause == 0) {
 				/* handles case 4 */
-				ASSERT3U(cmd, ==, POOL_SCRUB_NORMAL);
+				ASSERT(cmd == POOL_SCRUB_NORMAL ||
+				    cmd == POOL_SCRUB_FROM_LAST_TXG);
 				return (zfs_error(hdl, EZFS_ERRORSCRUBBING,
 				    errbuf));
 			} else {
@@ -4210,6 +4239,34 @@ zpool_reguid(zpool_handle_t *zhp)
 	return (zpool_standard_error(hdl, errno, errbuf));
 }
 
+/*
+ * Prune unique entries older than the given number of days from the
+ * pool's dedup tables.
+ */
+int
+zpool_ddt_prune(zpool_handle_t *zhp, uint64_t days)
+{
+	char errbuf[ERRBUFLEN];
+	libzfs_handle_t *hdl = zhp->zpool_hdl;
+	int error;
+
+	error = lzc_ddt_prune(zhp->zpool_name, days);
+	if (error == 0)
+		return (0);
+
+	(void) snprintf(errbuf, sizeof (errbuf),
+	    dgettext(TEXT_DOMAIN, "cannot prune dedup table on '%s'"),
+	    zhp->zpool_name);
+
+	if (error == ENOTSUP) {
+		zfs_error_aux(hdl, dgettext(TEXT_DOMAIN,
+		    "the fast_dedup feature must be enabled"));
+		return (zfs_error(hdl, EZFS_BADVERSION, errbuf));
+	}
+
+	return (zpool_standard_error(hdl, error, errbuf));
+}
+
 /*
  * Reopen the pool.
  */
@@ -4696,6 +4753,78 @@ out:
 	return (error);
 }
 
+/*
+ * Like zpool_events_next(), but retrieve up to 'max' of the events already
+ * queued with a single ioctl.  On success 'nvp' holds them, oldest first,
+ * as an nvlist array under ZEVENT_BATCH_EVENTS; it is NULL when there are
+ * no new events.  A kernel without batch support returns one event at a
+ * time, which is then wrapped the same way.
+ */
+int
+zpool_events_next_batch(libzfs_handle_t *hdl, nvlist_t **nvp,
+    int *dropped, unsigned flags, uint_t max, int zevent_fd)
+{
+	zfs_cmd_t zc = {"\0"};
+	nvlist_t *nvl = NULL;
+	int error = 0;
+
+	*nvp = NULL;
+	*dropped = 0;
+	zc.zc_cleanup_fd = zevent_fd;
+	zc.zc_guid = ZEVENT_BATCH;
+	zc.zc_obj = MIN(MAX(max, 1), ZEVENT_BATCH_MAX);
+
+	if (flags & ZEVENT_NONBLOCK)
+		zc.zc_guid |= ZEVENT_NONBLOCK;
+
+	zcmd_alloc_dst_nvlist(hdl, &zc,
+	    MIN(zc.zc_obj, 64) * ZEVENT_SIZE * 2);
+
+retry:
+	if (zfs_ioctl(hdl, ZFS_IOC_EVENTS_NEXT, &zc) != 0) {
+		switch (errno) {
+		case ESHUTDOWN:
+			error = zfs_error_fmt(hdl, EZFS_POOLUNAVAIL,
+			    dgettext(TEXT_DOMAIN, "zfs shutdown"));
+			goto out;
+		case ENOENT:
+			/* Blocking error case should not occur */
+			if (!(flags & ZEVENT_NONBLOCK))
+				error = zpool_standard_error_fmt(hdl, errno,
+				    dgettext(TEXT_DOMAIN, "cannot get event"));
+
+			goto out;
+		case ENOMEM:
+			zcmd_expand_dst_nvlist(hdl, &zc);
+			goto retry;
+		default:
+			error = zpool_standard_error_fmt(hdl, errno,
+			    dgettext(TEXT_DOMAIN, "cannot get event"));
+			goto out;
+		}
+	}
+
+	error = zcmd_read_dst_nvlist(hdl, &zc, &nvl);
+	if (error != 0)
+		goto out;
+
+	if (!nvlist_exists(nvl, ZEVENT_BATCH_EVENTS)) {
+		nvlist_t *batch = fnvlist_alloc();
+
+		fnvlist_add_nvlist_array(batch, ZEVENT_BATCH_EVENTS,
+		    (const nvlist_t * const *)&nvl, 1);
+		nvlist_free(nvl);
+		nvl = batch;
+	}
+
+	*nvp = nvl;
+	*dropped = (int)zc.zc_cookie;
+out:
+	zcmd_free_nvlists(&zc);
+
+	return (error);
+}
+
 /*
  * Clear all events.
  */
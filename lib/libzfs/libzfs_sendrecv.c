@@ -67,6 +67,9 @@
 #include <sys/ddt.h>
 #include <sys/socket.h>
 #include <sys/sha2.h>
+#include <sys/byteorder.h>
+#include <arpa/inet.h>
+#include <signal.h>
 
 static int zfs_receive_impl(libzfs_handle_t *, const char *, const char *,
     recvflags_t *, int, const char *, nvlist_t *, avl_tree_t *, char **,
@@ -2864,6 +2867,284 @@ zfs_send_one(zfs_handle_t *zhp, const char *from, int fd, sendflags_t *flags,
 	return (lzc_send_wrapper(zfs_send_one_cb, fd, &zso));
 }
 
+/*
+ * Striped streams.  A send stream is cut into chunks which are written
+ * round-robin to a set of file descriptors, typically one network
+ * connection each, so that a transfer is not limited to the window of a
+ * single connection.  The receiving side reads the chunks back in the same
+ * order.  Each chunk carries its stripe number and its offset in the stream,
+ * so a lost, truncated or misordered connection is detected instead of
+ * corrupting the stream.  Striping is purely a transport: an interrupted
+ * transfer is resumed with the receive_resume_token like any other.
+ */
+#define	ZFS_STRIPE_MAGIC	0x2f7a737472697065ULL	/* "/zstripe" */
+#define	ZFS_STRIPE_CHUNK	(1024 * 1024)
+
+typedef struct zfs_stripe_hdr {
+	uint64_t zsh_magic;
+	uint64_t zsh_offset;	/* of this chunk in the stream */
+	uint32_t zsh_stripe;	/* index of the fd carrying this chunk */
+	uint32_t zsh_len;	/* 0 marks the end of the stream */
+} zfs_stripe_hdr_t;
+
+struct zfs_stripe {
+	libzfs_handle_t *zs_hdl;
+	pthread_t zs_thread;
+	int zs_fd;		/* caller's end of the pipe */
+	int zs_pipe;		/* our end of the pipe */
+	int *zs_fds;
+	uint_t zs_nfds;
+	boolean_t zs_recv;
+	int zs_err;
+};
+
+static int
+stripe_read(int fd, void *buf, size_t len, size_t *resid)
+{
+	char *cp = buf;
+
+	while (len > 0) {
+		ssize_t rv = read(fd, cp, len);
+		if (rv == -1 && errno == EINTR)
+			continue;
+		if (rv == -1)
+			return (errno);
+		if (rv == 0)
+			break;
+		cp += rv;
+		len -= rv;
+	}
+	*resid = len;
+	return (0);
+}
+
+static int
+stripe_write(int fd, const void *buf, size_t len)
+{
+	const char *cp = buf;
+
+	while (len > 0) {
+		ssize_t rv = write(fd, cp, len);
+		if (rv == -1 && errno == EINTR)
+			continue;
+		if (rv == -1)
+			return (errno);
+		cp += rv;
+		len -= rv;
+	}
+	return (0);
+}
+
+static int
+stripe_put(zfs_stripe_t *zs, uint_t stripe, uint64_t off, const void *buf,
+    uint32_t len)
+{
+	zfs_stripe_hdr_t zsh = {
+		.zsh_magic = htonll(ZFS_STRIPE_MAGIC),
+		.zsh_offset = htonll(off),
+		.zsh_stripe = htonl(stripe),
+		.zsh_len = htonl(len),
+	};
+	int err = stripe_write(zs->zs_fds[stripe], &zsh, sizeof (zsh));
+	if (err == 0 && len != 0)
+		err = stripe_write(zs->zs_fds[stripe], buf, len);
+	return (err);
+}
+
+/*
+ * Read the next chunk header of a stripe and check that it is the one we
+ * expect.  A stripe that ends before its end-of-stream marker is EPIPE.
+ */
+static int
+stripe_get(zfs_stripe_t *zs, uint_t stripe, uint64_t off, uint32_t *lenp)
+{
+	zfs_stripe_hdr_t zsh;
+	size_t resid;
+	int err;
+
+	if ((err = stripe_read(zs->zs_fds[stripe], &zsh, sizeof (zsh),
+	    &resid)) != 0)
+		return (err);
+	if (resid != 0)
+		return (EPIPE);
+	if (ntohll(zsh.zsh_magic) != ZFS_STRIPE_MAGIC ||
+	    ntohl(zsh.zsh_stripe) != stripe ||
+	    ntohll(zsh.zsh_offset) != off ||
+	    ntohl(zsh.zsh_len) > ZFS_STRIPE_CHUNK)
+		return (EINVAL);
+	*lenp = ntohl(zsh.zsh_len);
+	return (0);
+}
+
+static int
+stripe_send(zfs_stripe_t *zs, char *buf)
+{
+	uint64_t off = 0;
+	uint64_t chunk;
+	int err;
+
+	for (chunk = 0; ; chunk++) {
+		size_t resid;
+
+		if ((err = stripe_read(zs->zs_pipe, buf, ZFS_STRIPE_CHUNK,
+		    &resid)) != 0)
+			return (err);
+		uint32_t len = ZFS_STRIPE_CHUNK - resid;
+		if (len == 0)
+			break;
+		if ((err = stripe_put(zs, chunk % zs->zs_nfds, off, buf,
+		    len)) != 0)
+			return (err);
+		off += len;
+	}
+	for (uint_t i = 0; i < zs->zs_nfds; i++) {
+		if ((err = stripe_put(zs, i, off, NULL, 0)) != 0)
+			return (err);
+	}
+	return (0);
+}
+
+static int
+stripe_recv(zfs_stripe_t *zs, char *buf)
+{
+	uint64_t off = 0;
+	uint64_t chunk;
+	uint32_t len;
+	size_t resid;
+	int err;
+
+	for (chunk = 0; ; chunk++) {
+		uint_t stripe = chunk % zs->zs_nfds;
+
+		if ((err = stripe_get(zs, stripe, off, &len)) != 0)
+			return (err);
+		if (len == 0)
+			break;
+		if ((err = stripe_read(zs->zs_fds[stripe], buf, len,
+		    &resid)) != 0)
+			return (err);
+		if (resid != 0)
+			return (EPIPE);
+		if ((err = stripe_write(zs->zs_pipe, buf, len)) != 0)
+			return (err);
+		off += len;
+	}
+	for (uint_t i = 0; i < zs->zs_nfds; i++) {
+		if (i == chunk % zs->zs_nfds)
+			continue;
+		if ((err = stripe_get(zs, i, off, &len)) != 0)
+			return (err);
+		if (len != 0)
+			return (EINVAL);
+	}
+	return (0);
+}
+
+static void *
+stripe_thread(void *arg)
+{
+	zfs_stripe_t *zs = arg;
+	sigset_t set;
+
+	/* Let a closed pipe or connection show up as EPIPE. */
+	(void) sigemptyset(&set);
+	(void) sigaddset(&set, SIGPIPE);
+	(void) pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	char *buf = zfs_alloc(zs->zs_hdl, ZFS_STRIPE_CHUNK);
+	zs->zs_err = zs->zs_recv ? stripe_recv(zs, buf) : stripe_send(zs, buf);
+	free(buf);
+	(void) close(zs->zs_pipe);
+	return (NULL);
+}
+
+/*
+ * Replace "fd" with a pipe to or from a striped stream over "fds".  With
+ * "recv" set, the stream read from "fds" can then be read from "fd";
+ * otherwise whatever is written to "fd" is striped out over "fds".  The
+ * caller keeps ownership of "fds" and must call zfs_stripe_finish() once
+ * it is done with "fd".
+ */
+int
+zfs_stripe_start(libzfs_handle_t *hdl, int fd, const int *fds, uint_t nfds,
+    boolean_t recv, zfs_stripe_t **zsp)
+{
+	const char *errbuf = recv ?
+	    dgettext(TEXT_DOMAIN, "cannot receive striped stream") :
+	    dgettext(TEXT_DOMAIN, "cannot send striped stream");
+	int p[2];
+	int err;
+
+	if (nfds == 0)
+		return (zfs_standard_error(hdl, EINVAL, errbuf));
+	if (pipe2(p, O_CLOEXEC) != 0)
+		return (zfs_standard_error(hdl, errno, errbuf));
+
+	zfs_stripe_t *zs = zfs_alloc(hdl, sizeof (*zs));
+	zs->zs_hdl = hdl;
+	zs->zs_fd = fd;
+	zs->zs_pipe = recv ? p[1] : p[0];
+	zs->zs_fds = zfs_alloc(hdl, nfds * sizeof (int));
+	memcpy(zs->zs_fds, fds, nfds * sizeof (int));
+	zs->zs_nfds = nfds;
+	zs->zs_recv = recv;
+
+	int theirs = recv ? p[0] : p[1];
+	if (dup2(theirs, fd) == -1) {
+		err = errno;
+		goto fail;
+	}
+	(void) close(theirs);
+	theirs = -1;
+
+	if ((err = pthread_create(&zs->zs_thread, NULL, stripe_thread,
+	    zs)) != 0)
+		goto fail;
+
+	*zsp = zs;
+	return (0);
+
+fail:
+	if (theirs != -1)
+		(void) close(theirs);
+	(void) close(zs->zs_pipe);
+	free(zs->zs_fds);
+	free(zs);
+	return (zfs_standard_error(hdl, err, errbuf));
+}
+
+/*
+ * Close the caller's end of a striped stream and wait for the remaining
+ * data to be moved.  EPIPE means the other end of the pipe went away
+ * early, which the send or receive has already reported.
+ */
+int
+zfs_stripe_finish(zfs_stripe_t *zs)
+{
+	libzfs_handle_t *hdl = zs->zs_hdl;
+	const char *errbuf = zs->zs_recv ?
+	    dgettext(TEXT_DOMAIN, "cannot receive striped stream") :
+	    dgettext(TEXT_DOMAIN, "cannot send striped stream");
+
+	(void) close(zs->zs_fd);
+	(void) pthread_join(zs->zs_thread, NULL);
+
+	int err = zs->zs_err;
+	free(zs->zs_fds);
+	free(zs);
+
+	if (err == 0)
+		return (0);
+	if (err == EINVAL) {
+		zfs_error_aux(hdl, "%s", dgettext(TEXT_DOMAIN,
+		    "stripes are out of order or not a striped stream"));
+		return (zfs_error(hdl, EZFS_BADSTREAM, errbuf));
+	}
+	if (err != EPIPE)
+		(void) zfs_standard_error(hdl, err, errbuf);
+	return (-1);
+}
+
 /*
  * Routines specific to "zfs recv"
  */
@@ -1907,3 +1907,126 @@ lzc_get_bootenv(const char *pool, nvlist_t **outnvl)
 {
 	return (lzc_ioctl(ZFS_IOC_GET_BOOTENV, pool, NULL, outnvl));
 }
+
+/*
+ * Prune unique entries older than the given number of days from the
+ * pool's dedup tables. Zero days prunes all unique entries.
+ */
+int
+lzc_ddt_prune(const char *pool, uint64_t days)
+{
+	int error;
+
+	nvlist_t *result = NULL;
+	nvlist_t *args = fnvlist_alloc();
+
+	fnvlist_add_uint64(args, DDT_PRUNE_DAYS, days);
+
+	error = lzc_ioctl(ZFS_IOC_DDT_PRUNE, pool, args, &result);
+
+	fnvlist_free(args);
+	fnvlist_free(result);
+
+	return (error);
+}
+
+/*
+ * Write the byte ranges of object "object" in snapshot "snapname" which
+ * changed since snapshot "from" to file descriptor "fd", as a sequence of
+ * dmu_changed_range_t records sorted by offset.  Adjacent ranges are
+ * merged.  Freed ranges are included when the pool has hole_birth
+ * enabled.
+ *
+ * If "from" is NULL, all allocated ranges of the object are reported.
+ * Otherwise it must be an earlier snapshot of the same dataset (or of
+ * its origin).  This is meant for backup tools which want to copy just
+ * the changed extents of a zvol or large file without reading it all.
+ */
+int
+lzc_changed_blocks(const char *snapname, const char *from, uint64_t object,
+    int fd)
+{
+	int error;
+
+	nvlist_t *args = fnvlist_alloc();
+
+	fnvlist_add_int32(args, CHANGED_BLOCKS_FD, fd);
+	fnvlist_add_uint64(args, CHANGED_BLOCKS_OBJECT, object);
+	if (from != NULL)
+		fnvlist_add_string(args, CHANGED_BLOCKS_FROMSNAP, from);
+
+	error = lzc_ioctl(ZFS_IOC_CHANGED_BLOCKS, snapname, args, NULL);
+
+	fnvlist_free(args);
+
+	return (error);
+}
+
+/*
+ * Prefetch the metadata needed to mount "fsname" and all of its
+ * descendant filesystems: their properties and objset blocks, which hold
+ * the ZIL headers.  This only warms the caches and is meant to be issued
+ * once before mounting many datasets in parallel; errors can be ignored.
+ */
+int
+lzc_mount_prefetch(const char *fsname)
+{
+	return (lzc_ioctl(ZFS_IOC_MOUNT_PREFETCH, fsname, NULL, NULL));
+}
+
+/*
+ * List a batch of the child filesystems (or, with "snapshots" set in
+ * "args", the snapshots) of "fsname" together with their stats and
+ * properties.  See zfs_ioc_dataset_list_batch() for the arguments and
+ * the layout of "outnvl", which the caller must free.  Pass the returned
+ * "cursor" back in "args" to continue; it is absent after the last batch.
+ */
+int
+lzc_dataset_list_batch(const char *fsname, nvlist_t *args, nvlist_t **outnvl)
+{
+	return (lzc_ioctl(ZFS_IOC_DATASET_LIST_BATCH, fsname, args, outnvl));
+}
+
+/*
+ * Estimate the dedup table and block clone table histograms of "pool"
+ * from about "samples" randomly chosen entries of each, or the default
+ * number if zero.  See zfs_ioc_dedup_sample() for the layout of "outnvl",
+ * which the caller must free.
+ */
+int
+lzc_dedup_sample(const char *pool, uint64_t samples, nvlist_t **outnvl)
+{
+	int error;
+	nvlist_t *args = fnvlist_alloc();
+
+	if (samples != 0)
+		fnvlist_add_uint64(args, DEDUP_SAMPLE_COUNT, samples);
+
+	error = lzc_ioctl(ZFS_IOC_DEDUP_SAMPLE, pool, args, outnvl);
+
+	fnvlist_free(args);
+
+	return (error);
+}
+
+/*
+ * Snapshot all named kstats of the kstat "module", e.g. "zfs" or
+ * "zfs/<pool>", optionally only those of one "class" such as "dataset".
+ * See zfs_ioc_kstats() for the layout of "outnvl", which the caller must
+ * free.
+ */
+int
+lzc_kstats(const char *module, const char *class, nvlist_t **outnvl)
+{
+	int error;
+	nvlist_t *args = fnvlist_alloc();
+
+	if (class != NULL)
+		fnvlist_add_string(args, KSTATS_CLASS, class);
+
+	error = lzc_ioctl(ZFS_IOC_KSTATS, module, args, outnvl);
+
+	fnvlist_free(args);
+
+	return (error);
+}
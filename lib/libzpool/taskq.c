@@ -388,6 +388,12 @@ taskq_of_curthread(void)
 	return (pthread_getspecific(taskq_tsd));
 }
 
+boolean_t
+taskq_busy(taskq_t *tq)
+{
+	return (tq->tq_active >= tq->tq_nthreads);
+}
+
 int
 taskq_cancel_id(taskq_t *tq, taskqid_t id)
 {
@@ -1456,15 +1456,22 @@ zpool_find_import_impl(libpc_handle_t *hdl, importargs_t *iarg,
 	rdsk_node_t *slice;
 	void *cookie;
 	tpool_t *t;
+	long nthreads;
 
 	verify(iarg->poolname == NULL || iarg->guid == 0);
 
 	/*
 	 * Create a thread pool to parallelize the process of reading and
 	 * validating labels, a large number of threads can be used due to
-	 * minimal contention.
+	 * minimal contention.  The work is dominated by waiting on label
+	 * reads and device links rather than by CPU, so allow up to one
+	 * thread per device (within reason) instead of tying the pool size
+	 * to the number of CPUs; otherwise scanning hundreds of disks on a
+	 * small controller node is needlessly serialized.
 	 */
-	t = tpool_create(1, 2 * sysconf(_SC_NPROCESSORS_ONLN), 0, NULL);
+	nthreads = MAX(2 * sysconf(_SC_NPROCESSORS_ONLN),
+	    MIN(avl_numnodes(cache), ZPOOL_IMPORT_MAX_THREADS));
+	t = tpool_create(1, nthreads, 0, NULL);
 	for (slice = avl_first(cache); slice;
 	    (slice = avl_walk(cache, slice, AVL_AFTER)))
 		(void) tpool_dispatch(t, zpool_open_func, slice);
@@ -33,6 +33,9 @@
 #define	IMPORT_ORDER_SCAN_OFFSET	10
 #define	IMPORT_ORDER_DEFAULT		100
 
+/* Upper bound on label reader threads when scanning for pools. */
+#define	ZPOOL_IMPORT_MAX_THREADS	128
+
 int label_paths(libpc_handle_t *hdl, nvlist_t *label, const char **path,
     const char **devid);
 int zpool_find_import_blkid(libpc_handle_t *hdl, pthread_mutex_t *lock,
@@ -729,3 +729,90 @@ Blake3_FinalSeek(const BLAKE3_CTX *ctx, uint64_t seek, uint8_t *out,
 	}
 	output_root_bytes(ctx->ops, &output, seek, out, out_len);
 }
+
+/*
+ * Hash n independent messages of len bytes each, using the key and flags
+ * that ctx was initialized with (ctx itself is not updated). Instead of
+ * spreading the SIMD lanes of hash_many() over the chunks of one message,
+ * they are spread over the messages, so short messages and the narrow top
+ * levels of each tree still fill the vector unit.
+ *
+ * Only complete trees are handled, i.e. len must be a power-of-2 number of
+ * chunks, at least two. cvs is scratch space for the chaining values of
+ * every chunk of every message (n * len / BLAKE3_CHUNK_LEN * BLAKE3_OUT_LEN
+ * bytes) and out receives n * BLAKE3_OUT_LEN bytes. Returns B_FALSE without
+ * hashing anything if len is not suitable.
+ */
+boolean_t
+Blake3_HashMany(const BLAKE3_CTX *ctx, const uint8_t * const *inputs,
+    size_t n, size_t len, uint8_t *cvs, uint8_t *out)
+{
+	const blake3_ops_t *ops = ctx->ops;
+	const uint8_t *ptrs[MAX_SIMD_DEGREE];
+	uint8_t tmp[MAX_SIMD_DEGREE * BLAKE3_OUT_LEN];
+	size_t chunks = len / BLAKE3_CHUNK_LEN;
+	uint8_t flags = ctx->chunk.flags;
+
+	if (len % BLAKE3_CHUNK_LEN != 0 || chunks < 2 ||
+	    (chunks & (chunks - 1)) != 0)
+		return (B_FALSE);
+
+	/*
+	 * Chunk i of every message has chunk counter i, so the same chunk of
+	 * up to MAX_SIMD_DEGREE messages is hashed by one hash_many() call.
+	 */
+	for (size_t c = 0; c < chunks; c++) {
+		for (size_t m = 0; m < n; m += MAX_SIMD_DEGREE) {
+			size_t k = MIN(n - m, MAX_SIMD_DEGREE);
+
+			for (size_t j = 0; j < k; j++)
+				ptrs[j] = inputs[m + j] + c * BLAKE3_CHUNK_LEN;
+			ops->hash_many(ptrs, k, BLAKE3_CHUNK_LEN /
+			    BLAKE3_BLOCK_LEN, ctx->key, c, B_FALSE, flags,
+			    CHUNK_START, CHUNK_END, tmp);
+			for (size_t j = 0; j < k; j++) {
+				memcpy(&cvs[((m + j) * chunks + c) *
+				    BLAKE3_OUT_LEN], &tmp[j * BLAKE3_OUT_LEN],
+				    BLAKE3_OUT_LEN);
+			}
+		}
+	}
+
+	/*
+	 * Parent nodes all use counter 0, so each level of every tree can be
+	 * hashed as one flat list. Parent p of a message is written over its
+	 * own left child's slot p, which has always been consumed by then.
+	 */
+	for (size_t nodes = chunks; nodes > 2; nodes /= 2) {
+		size_t parents = n * nodes / 2;
+
+		for (size_t p = 0; p < parents; p += MAX_SIMD_DEGREE) {
+			size_t k = MIN(parents - p, MAX_SIMD_DEGREE);
+
+			for (size_t j = 0; j < k; j++) {
+				size_t m = (p + j) / (nodes / 2);
+				size_t i = (p + j) % (nodes / 2);
+				ptrs[j] = &cvs[(m * chunks + 2 * i) *
+				    BLAKE3_OUT_LEN];
+			}
+			ops->hash_many(ptrs, k, 1, ctx->key, 0, B_FALSE,
+			    flags | PARENT, 0, 0, tmp);
+			for (size_t j = 0; j < k; j++) {
+				size_t m = (p + j) / (nodes / 2);
+				size_t i = (p + j) % (nodes / 2);
+				memcpy(&cvs[(m * chunks + i) * BLAKE3_OUT_LEN],
+				    &tmp[j * BLAKE3_OUT_LEN], BLAKE3_OUT_LEN);
+			}
+		}
+	}
+
+	/* The last two chaining values of each message form its root. */
+	for (size_t m = 0; m < n; m++) {
+		output_t output = parent_output(&cvs[m * chunks *
+		    BLAKE3_OUT_LEN], ctx->key, flags);
+		output_root_bytes(ops, &output, 0, &out[m * BLAKE3_OUT_LEN],
+		    BLAKE3_OUT_LEN);
+	}
+
+	return (B_TRUE);
+}
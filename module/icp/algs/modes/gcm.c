@@ -46,6 +46,9 @@
 #ifdef CAN_USE_GCM_ASM
 #define	IMPL_AVX	(UINT32_MAX-2)
 #endif
+#ifdef CAN_USE_GCM_VAES
+#define	IMPL_VAES	(UINT32_MAX-3)
+#endif
 #define	GCM_IMPL_READ(i) (*(volatile uint32_t *) &(i))
 static uint32_t icp_gcm_impl = IMPL_FASTEST;
 static uint32_t user_sel_impl = IMPL_FASTEST;
@@ -59,13 +62,22 @@ boolean_t gcm_avx_can_use_movbe = B_FALSE;
  */
 static boolean_t gcm_use_avx = B_FALSE;
 #define	GCM_IMPL_USE_AVX	(*(volatile boolean_t *)&gcm_use_avx)
+/*
+ * Whether the avx code path does its bulk work with the 512 bit VAES and
+ * VPCLMULQDQ routines. Set if icp_gcm_impl is "vaes" or "fastest" and the
+ * CPU supports them.
+ */
+static boolean_t gcm_use_vaes = B_FALSE;
+#define	GCM_IMPL_USE_VAES	(*(volatile boolean_t *)&gcm_use_vaes)
 
 extern boolean_t ASMABI atomic_toggle_boolean_nv(volatile boolean_t *);
 
 static inline boolean_t gcm_avx_will_work(void);
 static inline void gcm_set_avx(boolean_t);
 static inline boolean_t gcm_toggle_avx(void);
-static inline size_t gcm_simd_get_htab_size(boolean_t);
+static inline void gcm_set_vaes(boolean_t);
+static inline boolean_t gcm_toggle_vaes(void);
+static inline size_t gcm_simd_get_htab_size(boolean_t, boolean_t);
 
 static int gcm_mode_encrypt_contiguous_blocks_avx(gcm_ctx_t *, char *, size_t,
     crypto_data_t *, size_t);
@@ -631,6 +643,8 @@ gcm_init_ctx(gcm_ctx_t *gcm_ctx, char *param,
 
 	if (GCM_IMPL_READ(icp_gcm_impl) != IMPL_CYCLE) {
 		gcm_ctx->gcm_use_avx = GCM_IMPL_USE_AVX;
+		gcm_ctx->gcm_use_vaes = gcm_ctx->gcm_use_avx == B_TRUE &&
+		    GCM_IMPL_USE_VAES == B_TRUE;
 	} else {
 		/*
 		 * Handle the "cycle" implementation by creating avx and
@@ -651,6 +665,9 @@ gcm_init_ctx(gcm_ctx_t *gcm_ctx, char *param,
 			(void) atomic_toggle_boolean_nv(
 			    (volatile boolean_t *)&gcm_avx_can_use_movbe);
 		}
+		/* Likewise alternate between the vaes and aesni routines. */
+		gcm_ctx->gcm_use_vaes = gcm_ctx->gcm_use_avx == B_TRUE &&
+		    gcm_toggle_vaes() == B_TRUE;
 	}
 	/*
 	 * We don't handle byte swapped key schedules in the avx code path,
@@ -659,6 +676,7 @@ gcm_init_ctx(gcm_ctx_t *gcm_ctx, char *param,
 	 */
 	if (gcm_ctx->gcm_use_avx == B_TRUE && needs_bswap == B_TRUE) {
 		gcm_ctx->gcm_use_avx = B_FALSE;
+		gcm_ctx->gcm_use_vaes = B_FALSE;
 
 		cmn_err_once(CE_WARN,
 		    "ICP: Can't use the aes generic or cycle implementations "
@@ -673,7 +691,8 @@ gcm_init_ctx(gcm_ctx_t *gcm_ctx, char *param,
 
 	/* Allocate Htab memory as needed. */
 	if (gcm_ctx->gcm_use_avx == B_TRUE) {
-		size_t htab_len = gcm_simd_get_htab_size(gcm_ctx->gcm_use_avx);
+		size_t htab_len = gcm_simd_get_htab_size(gcm_ctx->gcm_use_avx,
+		    gcm_ctx->gcm_use_vaes);
 
 		if (htab_len == 0) {
 			return (CRYPTO_MECHANISM_PARAM_INVALID);
@@ -765,6 +784,9 @@ gcm_impl_get_ops(void)
 		ops = gcm_supp_impl[idx];
 		break;
 #ifdef CAN_USE_GCM_ASM
+#ifdef CAN_USE_GCM_VAES
+	case IMPL_VAES:
+#endif
 	case IMPL_AVX:
 		/*
 		 * Make sure that we return a valid implementation while
@@ -835,6 +857,7 @@ gcm_impl_init(void)
 #endif
 		if (GCM_IMPL_READ(user_sel_impl) == IMPL_FASTEST) {
 			gcm_set_avx(B_TRUE);
+			gcm_set_vaes(B_TRUE);
 		}
 	}
 #endif
@@ -852,6 +875,9 @@ static const struct {
 #ifdef CAN_USE_GCM_ASM
 		{ "avx",	IMPL_AVX },
 #endif
+#ifdef CAN_USE_GCM_VAES
+		{ "vaes",	IMPL_VAES },
+#endif
 };
 
 /*
@@ -890,6 +916,13 @@ gcm_impl_set(const char *val)
 		if (gcm_impl_opts[i].sel == IMPL_AVX && !gcm_avx_will_work()) {
 			continue;
 		}
+#endif
+#ifdef CAN_USE_GCM_VAES
+		/* Likewise for the vaes implementation. */
+		if (gcm_impl_opts[i].sel == IMPL_VAES &&
+		    !(gcm_avx_will_work() && gcm_vaes_will_work())) {
+			continue;
+		}
 #endif
 		if (strcmp(req_name, gcm_impl_opts[i].name) == 0) {
 			impl = gcm_impl_opts[i].sel;
@@ -912,13 +945,20 @@ gcm_impl_set(const char *val)
 #ifdef CAN_USE_GCM_ASM
 	/*
 	 * Use the avx implementation if available and the requested one is
-	 * avx or fastest.
+	 * avx, vaes or fastest. The latter two also get the vaes routines if
+	 * the CPU supports them.
 	 */
+	boolean_t want_vaes = B_FALSE;
+#ifdef CAN_USE_GCM_VAES
+	want_vaes = (impl == IMPL_VAES);
+#endif
 	if (gcm_avx_will_work() == B_TRUE &&
-	    (impl == IMPL_AVX || impl == IMPL_FASTEST)) {
+	    (impl == IMPL_AVX || impl == IMPL_FASTEST || want_vaes)) {
 		gcm_set_avx(B_TRUE);
+		gcm_set_vaes(impl == IMPL_FASTEST || want_vaes);
 	} else {
 		gcm_set_avx(B_FALSE);
+		gcm_set_vaes(B_FALSE);
 	}
 #endif
 
@@ -956,6 +996,13 @@ icp_gcm_impl_get(char *buffer, zfs_kernel_param_t *kp)
 		if (gcm_impl_opts[i].sel == IMPL_AVX && !gcm_avx_will_work()) {
 			continue;
 		}
+#endif
+#ifdef CAN_USE_GCM_VAES
+		/* Likewise for the vaes implementation. */
+		if (gcm_impl_opts[i].sel == IMPL_VAES &&
+		    !(gcm_avx_will_work() && gcm_vaes_will_work())) {
+			continue;
+		}
 #endif
 		fmt = (impl == gcm_impl_opts[i].sel) ? "[%s] " : "%s ";
 		cnt += kmem_scnprintf(buffer + cnt, PAGE_SIZE - cnt, fmt,
@@ -1053,11 +1100,41 @@ gcm_toggle_avx(void)
 	}
 }
 
+static inline void
+gcm_set_vaes(boolean_t val)
+{
+#ifdef CAN_USE_GCM_VAES
+	if (gcm_vaes_will_work() == B_TRUE) {
+		atomic_swap_32(&gcm_use_vaes, val);
+	}
+#else
+	(void) val;
+#endif
+}
+
+static inline boolean_t
+gcm_toggle_vaes(void)
+{
+#ifdef CAN_USE_GCM_VAES
+	if (gcm_vaes_will_work() == B_TRUE) {
+		return (atomic_toggle_boolean_nv(&GCM_IMPL_USE_VAES));
+	}
+#endif
+	return (B_FALSE);
+}
+
 static inline size_t
-gcm_simd_get_htab_size(boolean_t simd_mode)
+gcm_simd_get_htab_size(boolean_t simd_mode, boolean_t vaes_mode)
 {
 	switch (simd_mode) {
 	case B_TRUE:
+#ifdef CAN_USE_GCM_VAES
+		/* The vaes table follows the one of the openssl routines. */
+		if (vaes_mode == B_TRUE) {
+			return (2 * 6 * 2 * sizeof (uint64_t) +
+			    GCM_VAES_HTAB_SIZE);
+		}
+#endif
 		return (2 * 6 * 2 * sizeof (uint64_t));
 
 	default:
@@ -1065,6 +1142,42 @@ gcm_simd_get_htab_size(boolean_t simd_mode)
 	}
 }
 
+#ifdef CAN_USE_GCM_VAES
+#define	GCM_VAES_HTAB(ctx)	((ctx)->gcm_Htable + 2 * 6 * 2)
+#endif
+
+/*
+ * Run the bulk encryption or decryption routine of the context. Returns
+ * the number of bytes done, which may be less than len.
+ */
+static inline size_t
+gcm_avx_bulk_encrypt(gcm_ctx_t *ctx, const uint8_t *in, uint8_t *out,
+    size_t len)
+{
+#ifdef CAN_USE_GCM_VAES
+	if (ctx->gcm_use_vaes == B_TRUE) {
+		return (gcm_vaes_encrypt(in, out, len, ctx->gcm_keysched,
+		    ctx->gcm_cb, ctx->gcm_ghash, GCM_VAES_HTAB(ctx)));
+	}
+#endif
+	return (aesni_gcm_encrypt(in, out, len, ctx->gcm_keysched,
+	    ctx->gcm_cb, ctx->gcm_ghash));
+}
+
+static inline size_t
+gcm_avx_bulk_decrypt(gcm_ctx_t *ctx, const uint8_t *in, uint8_t *out,
+    size_t len)
+{
+#ifdef CAN_USE_GCM_VAES
+	if (ctx->gcm_use_vaes == B_TRUE) {
+		return (gcm_vaes_decrypt(in, out, len, ctx->gcm_keysched,
+		    ctx->gcm_cb, ctx->gcm_ghash, GCM_VAES_HTAB(ctx)));
+	}
+#endif
+	return (aesni_gcm_decrypt(in, out, len, ctx->gcm_keysched,
+	    ctx->gcm_cb, ctx->gcm_ghash));
+}
+
 
 /* Increment the GCM counter block by n. */
 static inline void
@@ -1093,7 +1206,6 @@ gcm_mode_encrypt_contiguous_blocks_avx(gcm_ctx_t *ctx, char *data,
 	uint8_t *datap = (uint8_t *)data;
 	size_t chunk_size = (size_t)GCM_CHUNK_SIZE_READ;
 	const aes_key_t *key = ((aes_key_t *)ctx->gcm_keysched);
-	uint64_t *ghash = ctx->gcm_ghash;
 	uint64_t *cb = ctx->gcm_cb;
 	uint8_t *ct_buf = NULL;
 	uint8_t *tmp = (uint8_t *)ctx->gcm_tmp;
@@ -1157,8 +1269,7 @@ gcm_mode_encrypt_contiguous_blocks_avx(gcm_ctx_t *ctx, char *data,
 	/* Do the bulk encryption in chunk_size blocks. */
 	for (; bleft >= chunk_size; bleft -= chunk_size) {
 		kfpu_begin();
-		done = aesni_gcm_encrypt(
-		    datap, ct_buf, chunk_size, key, cb, ghash);
+		done = gcm_avx_bulk_encrypt(ctx, datap, ct_buf, chunk_size);
 
 		clear_fpu_regs();
 		kfpu_end();
@@ -1181,7 +1292,7 @@ gcm_mode_encrypt_contiguous_blocks_avx(gcm_ctx_t *ctx, char *data,
 	/* Bulk encrypt the remaining data. */
 	kfpu_begin();
 	if (bleft >= GCM_AVX_MIN_ENCRYPT_BYTES) {
-		done = aesni_gcm_encrypt(datap, ct_buf, bleft, key, cb, ghash);
+		done = gcm_avx_bulk_encrypt(ctx, datap, ct_buf, bleft);
 		if (done == 0) {
 			rv = CRYPTO_FAILED;
 			goto out;
@@ -1323,8 +1434,7 @@ gcm_decrypt_final_avx(gcm_ctx_t *ctx, crypto_data_t *out, size_t block_size)
 	 */
 	for (bleft = pt_len; bleft >= chunk_size; bleft -= chunk_size) {
 		kfpu_begin();
-		done = aesni_gcm_decrypt(datap, datap, chunk_size,
-		    (const void *)key, ctx->gcm_cb, ghash);
+		done = gcm_avx_bulk_decrypt(ctx, datap, datap, chunk_size);
 		clear_fpu_regs();
 		kfpu_end();
 		if (done != chunk_size) {
@@ -1335,8 +1445,7 @@ gcm_decrypt_final_avx(gcm_ctx_t *ctx, crypto_data_t *out, size_t block_size)
 	/* Decrypt remainder, which is less than chunk size, in one go. */
 	kfpu_begin();
 	if (bleft >= GCM_AVX_MIN_DECRYPT_BYTES) {
-		done = aesni_gcm_decrypt(datap, datap, bleft,
-		    (const void *)key, ctx->gcm_cb, ghash);
+		done = gcm_avx_bulk_decrypt(ctx, datap, datap, bleft);
 		if (done == 0) {
 			clear_fpu_regs();
 			kfpu_end();
@@ -1433,6 +1542,10 @@ gcm_init_avx(gcm_ctx_t *ctx, const uint8_t *iv, size_t iv_len,
 	    (const uint32_t *)H, (uint32_t *)H);
 
 	gcm_init_htab_avx(ctx->gcm_Htable, H);
+#ifdef CAN_USE_GCM_VAES
+	if (ctx->gcm_use_vaes == B_TRUE)
+		gcm_vaes_init_htab(GCM_VAES_HTAB(ctx), H);
+#endif
 
 	if (iv_len == 12) {
 		memcpy(cb, iv, 12);
@@ -0,0 +1,507 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * AES-GCM bulk encryption and decryption using 512 bit VAES and VPCLMULQDQ.
+ *
+ * Four counter blocks are encrypted per vaesenc and sixteen blocks are
+ * hashed per loop iteration. GHASH works on byte reflected blocks, so the
+ * carry-less products of reflected operands come out multiplied by x.
+ * The table therefore holds H^16 ... H^1 each multiplied by x^-1, which
+ * cancels that factor and lets the reduction be done with two folds by
+ * the reflected field polynomial.
+ *
+ * The routines keep their state in fixed registers across the asm
+ * statements below, like the other AVX-512 code does:
+ *
+ *	zmm0-3		AES state
+ *	zmm4-7		reflected blocks to hash
+ *	zmm8		product high halves
+ *	zmm9		scratch
+ *	zmm10		GHASH accumulator, in the lowest 128 bit lane
+ *	zmm11		reflected field polynomial
+ *	zmm12		reflected counter blocks
+ *	zmm13		counter increment
+ *	zmm14		product low halves
+ *	zmm15		product middle halves
+ *	zmm16-30	round keys, round 0 in zmm16 and the last in zmm30
+ *	zmm31		byte reflection mask
+ *	k1		byte mask of the last one to three blocks
+ */
+
+#if defined(__x86_64) && defined(HAVE_AVX512F) && \
+    defined(HAVE_AVX512BW) && defined(HAVE_VAES) && defined(HAVE_VPCLMULQDQ)
+
+#include <sys/types.h>
+#include <sys/simd.h>
+#include <sys/byteorder.h>
+#include <modes/modes.h>
+#include <modes/gcm_impl.h>
+#include <aes/aes_impl.h>
+
+#define	GCM_VAES_BLOCK_LEN	16
+#define	GCM_VAES_LANE_BYTES	(GCM_VAES_BLOCK_LEN * 4)
+#define	GCM_VAES_LOOP_BYTES	(GCM_VAES_BLOCK_LEN * 16)
+
+static const uint8_t gcm_vaes_bswap_mask[64] __attribute__((aligned(64))) = {
+	15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+	15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+	15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+	15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+};
+
+static const uint32_t gcm_vaes_ctr_lanes[16] __attribute__((aligned(64))) = {
+	0, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 3, 0, 0, 0,
+};
+
+static const uint32_t gcm_vaes_ctr_inc[4] __attribute__((aligned(16))) = {
+	4, 0, 0, 0,
+};
+
+static const uint64_t gcm_vaes_gfpoly[2] __attribute__((aligned(16))) = {
+	0x0000000000000001ULL, 0xc200000000000000ULL,
+};
+
+boolean_t
+gcm_vaes_will_work(void)
+{
+	return (kfpu_allowed() &&
+	    zfs_avx512f_available() && zfs_avx512bw_available() &&
+	    zfs_vaes_available() && zfs_vpclmulqdq_available() &&
+	    zfs_aes_available() && zfs_pclmulqdq_available());
+}
+
+/*
+ * Fill in H^16 ... H^1, each multiplied by x^-1, as reflected little
+ * endian 128 bit values. Called with the FPU owned.
+ */
+void
+gcm_vaes_init_htab(uint64_t *htab, const uint64_t H[2])
+{
+	uint64_t hi = BSWAP_64(H[0]);
+	uint64_t lo = BSWAP_64(H[1]);
+	uint64_t carry = hi >> 63;
+
+	/* Reflected H times x^-1 is a left shift by one, reduced. */
+	hi = (hi << 1) | (lo >> 63);
+	lo <<= 1;
+	if (carry) {
+		hi ^= gcm_vaes_gfpoly[1];
+		lo ^= gcm_vaes_gfpoly[0];
+	}
+	htab[30] = lo;
+	htab[31] = hi;
+
+	__asm("vmovdqu %0, %%xmm0"
+	    :: "m"(*(const uint64_t (*)[2])&htab[30]));
+	__asm("vmovdqu %0, %%xmm2" :: "m"(gcm_vaes_gfpoly));
+	__asm("vmovdqa %xmm0, %xmm1");
+
+	for (int i = 14; i >= 0; i--) {
+		__asm(
+		    "vpclmulqdq $0x00, %%xmm0, %%xmm1, %%xmm3\n"
+		    "vpclmulqdq $0x11, %%xmm0, %%xmm1, %%xmm4\n"
+		    "vpclmulqdq $0x01, %%xmm0, %%xmm1, %%xmm5\n"
+		    "vpclmulqdq $0x10, %%xmm0, %%xmm1, %%xmm6\n"
+		    "vpxor %%xmm6, %%xmm5, %%xmm5\n"
+		    "vpclmulqdq $0x01, %%xmm3, %%xmm2, %%xmm6\n"
+		    "vpshufd $0x4e, %%xmm3, %%xmm3\n"
+		    "vpxor %%xmm3, %%xmm5, %%xmm5\n"
+		    "vpxor %%xmm6, %%xmm5, %%xmm5\n"
+		    "vpclmulqdq $0x01, %%xmm5, %%xmm2, %%xmm6\n"
+		    "vpshufd $0x4e, %%xmm5, %%xmm5\n"
+		    "vpxor %%xmm5, %%xmm4, %%xmm4\n"
+		    "vpxor %%xmm6, %%xmm4, %%xmm1\n"
+		    "vmovdqu %%xmm1, %0\n"
+		    : "=m"(*(uint64_t (*)[2])&htab[2 * i]));
+	}
+}
+
+/*
+ * Broadcast the round keys so that the last one always ends up in zmm30
+ * and the rounds in between directly precede it. Shorter key schedules
+ * then just skip the first few vaesenc rounds.
+ */
+static inline void
+gcm_vaes_load_keys(const aes_key_t *key)
+{
+	const uint8_t *ks = (const uint8_t *)key->encr_ks.ks32;
+	const uintptr_t rk = (uintptr_t)ks + 16 * key->nr - 16 * 14;
+
+	if (key->nr > 12) {
+		__asm(
+		    "vbroadcasti32x4 0x10(%[rk]), %%zmm17\n"
+		    "vbroadcasti32x4 0x20(%[rk]), %%zmm18\n"
+		    :: [rk] "r"(rk) : "memory");
+	}
+	if (key->nr > 10) {
+		__asm(
+		    "vbroadcasti32x4 0x30(%[rk]), %%zmm19\n"
+		    "vbroadcasti32x4 0x40(%[rk]), %%zmm20\n"
+		    :: [rk] "r"(rk) : "memory");
+	}
+	__asm(
+	    "vbroadcasti32x4 0x00(%[ks]), %%zmm16\n"
+	    "vbroadcasti32x4 0x50(%[rk]), %%zmm21\n"
+	    "vbroadcasti32x4 0x60(%[rk]), %%zmm22\n"
+	    "vbroadcasti32x4 0x70(%[rk]), %%zmm23\n"
+	    "vbroadcasti32x4 0x80(%[rk]), %%zmm24\n"
+	    "vbroadcasti32x4 0x90(%[rk]), %%zmm25\n"
+	    "vbroadcasti32x4 0xa0(%[rk]), %%zmm26\n"
+	    "vbroadcasti32x4 0xb0(%[rk]), %%zmm27\n"
+	    "vbroadcasti32x4 0xc0(%[rk]), %%zmm28\n"
+	    "vbroadcasti32x4 0xd0(%[rk]), %%zmm29\n"
+	    "vbroadcasti32x4 0xe0(%[rk]), %%zmm30\n"
+	    :: [ks] "r"(ks), [rk] "r"(rk) : "memory");
+}
+
+static inline void
+gcm_vaes_begin(const aes_key_t *key, const uint64_t cb[2],
+    const uint64_t ghash[2])
+{
+	__asm(
+	    "vmovdqa64 %[bswap], %%zmm31\n"
+	    "vbroadcasti32x4 %[gfpoly], %%zmm11\n"
+	    "vbroadcasti32x4 %[inc], %%zmm13\n"
+	    "vbroadcasti32x4 %[cb], %%zmm12\n"
+	    "vpshufb %%zmm31, %%zmm12, %%zmm12\n"
+	    "vpaddd %[lanes], %%zmm12, %%zmm12\n"
+	    "vmovdqu %[ghash], %%xmm10\n"
+	    "vpshufb %%zmm31, %%zmm10, %%zmm10\n"
+	    :: [bswap] "m"(gcm_vaes_bswap_mask),
+	    [gfpoly] "m"(gcm_vaes_gfpoly), [inc] "m"(gcm_vaes_ctr_inc),
+	    [lanes] "m"(gcm_vaes_ctr_lanes),
+	    [cb] "m"(*(const uint64_t (*)[2])cb),
+	    [ghash] "m"(*(const uint64_t (*)[2])ghash));
+
+	gcm_vaes_load_keys(key);
+}
+
+/*
+ * Store the GHASH accumulator and wipe the key schedule. The caller
+ * clears the remaining registers together with its own state.
+ */
+static inline void
+gcm_vaes_end(uint64_t ghash[2])
+{
+	__asm(
+	    "vpshufb %%zmm31, %%zmm10, %%zmm10\n"
+	    "vmovdqu %%xmm10, %[ghash]\n"
+	    "vpxord %%zmm16, %%zmm16, %%zmm16\n"
+	    "vpxord %%zmm17, %%zmm17, %%zmm17\n"
+	    "vpxord %%zmm18, %%zmm18, %%zmm18\n"
+	    "vpxord %%zmm19, %%zmm19, %%zmm19\n"
+	    "vpxord %%zmm20, %%zmm20, %%zmm20\n"
+	    "vpxord %%zmm21, %%zmm21, %%zmm21\n"
+	    "vpxord %%zmm22, %%zmm22, %%zmm22\n"
+	    "vpxord %%zmm23, %%zmm23, %%zmm23\n"
+	    "vpxord %%zmm24, %%zmm24, %%zmm24\n"
+	    "vpxord %%zmm25, %%zmm25, %%zmm25\n"
+	    "vpxord %%zmm26, %%zmm26, %%zmm26\n"
+	    "vpxord %%zmm27, %%zmm27, %%zmm27\n"
+	    "vpxord %%zmm28, %%zmm28, %%zmm28\n"
+	    "vpxord %%zmm29, %%zmm29, %%zmm29\n"
+	    "vpxord %%zmm30, %%zmm30, %%zmm30\n"
+	    "vpxord %%zmm31, %%zmm31, %%zmm31\n"
+	    : [ghash] "=m"(*(uint64_t (*)[2])ghash));
+}
+
+#define	VAES_CTR(r)							\
+	"vpshufb %zmm31, %zmm12, %zmm" #r "\n"				\
+	"vpaddd %zmm13, %zmm12, %zmm12\n"				\
+	"vpxord %zmm16, %zmm" #r ", %zmm" #r "\n"
+
+#define	VAES_ENC1(k)							\
+	"vaesenc %zmm" #k ", %zmm0, %zmm0\n"
+
+#define	VAES_ENC4(k)							\
+	"vaesenc %zmm" #k ", %zmm0, %zmm0\n"				\
+	"vaesenc %zmm" #k ", %zmm1, %zmm1\n"				\
+	"vaesenc %zmm" #k ", %zmm2, %zmm2\n"				\
+	"vaesenc %zmm" #k ", %zmm3, %zmm3\n"
+
+#define	VAES_ENC1_LAST							\
+	VAES_ENC1(21) VAES_ENC1(22) VAES_ENC1(23) VAES_ENC1(24)		\
+	VAES_ENC1(25) VAES_ENC1(26) VAES_ENC1(27) VAES_ENC1(28)		\
+	VAES_ENC1(29)							\
+	"vaesenclast %zmm30, %zmm0, %zmm0\n"
+
+#define	VAES_ENC4_LAST							\
+	VAES_ENC4(21) VAES_ENC4(22) VAES_ENC4(23) VAES_ENC4(24)		\
+	VAES_ENC4(25) VAES_ENC4(26) VAES_ENC4(27) VAES_ENC4(28)		\
+	VAES_ENC4(29)							\
+	"vaesenclast %zmm30, %zmm0, %zmm0\n"				\
+	"vaesenclast %zmm30, %zmm1, %zmm1\n"				\
+	"vaesenclast %zmm30, %zmm2, %zmm2\n"				\
+	"vaesenclast %zmm30, %zmm3, %zmm3\n"
+
+/* Encrypt the next four counter blocks into zmm0. */
+static inline void
+gcm_vaes_ctr1(int nr)
+{
+	__asm(VAES_CTR(0));
+	if (nr > 12)
+		__asm(VAES_ENC1(17) VAES_ENC1(18));
+	if (nr > 10)
+		__asm(VAES_ENC1(19) VAES_ENC1(20));
+	__asm(VAES_ENC1_LAST);
+}
+
+/* Encrypt the next sixteen counter blocks into zmm0-3. */
+static inline void
+gcm_vaes_ctr4(int nr)
+{
+	__asm(VAES_CTR(0) VAES_CTR(1) VAES_CTR(2) VAES_CTR(3));
+	if (nr > 12)
+		__asm(VAES_ENC4(17) VAES_ENC4(18));
+	if (nr > 10)
+		__asm(VAES_ENC4(19) VAES_ENC4(20));
+	__asm(VAES_ENC4_LAST);
+}
+
+#define	VAES_MUL_FIRST(d, h)						\
+	"vpclmulqdq $0x00, " h ", %%zmm" #d ", %%zmm14\n"		\
+	"vpclmulqdq $0x11, " h ", %%zmm" #d ", %%zmm8\n"		\
+	"vpclmulqdq $0x01, " h ", %%zmm" #d ", %%zmm15\n"		\
+	"vpclmulqdq $0x10, " h ", %%zmm" #d ", %%zmm9\n"		\
+	"vpxord %%zmm9, %%zmm15, %%zmm15\n"
+
+#define	VAES_MUL_NEXT(d, h)						\
+	"vpclmulqdq $0x00, " h ", %%zmm" #d ", %%zmm9\n"		\
+	"vpxord %%zmm9, %%zmm14, %%zmm14\n"				\
+	"vpclmulqdq $0x11, " h ", %%zmm" #d ", %%zmm9\n"		\
+	"vpxord %%zmm9, %%zmm8, %%zmm8\n"				\
+	"vpclmulqdq $0x01, " h ", %%zmm" #d ", %%zmm9\n"		\
+	"vpclmulqdq $0x10, " h ", %%zmm" #d ", %%zmm" #d "\n"		\
+	"vpternlogd $0x96, %%zmm9, %%zmm" #d ", %%zmm15\n"
+
+/*
+ * Fold the low and then the middle halves into the high halves, and sum
+ * up the four lanes into the GHASH accumulator.
+ */
+#define	VAES_REDUCE							\
+	"vpclmulqdq $0x01, %%zmm14, %%zmm11, %%zmm9\n"			\
+	"vpshufd $0x4e, %%zmm14, %%zmm14\n"				\
+	"vpternlogd $0x96, %%zmm9, %%zmm14, %%zmm15\n"			\
+	"vpclmulqdq $0x01, %%zmm15, %%zmm11, %%zmm9\n"			\
+	"vpshufd $0x4e, %%zmm15, %%zmm15\n"				\
+	"vpternlogd $0x96, %%zmm9, %%zmm15, %%zmm8\n"			\
+	"vextracti64x4 $1, %%zmm8, %%ymm9\n"				\
+	"vpxor %%ymm9, %%ymm8, %%ymm8\n"				\
+	"vextracti128 $1, %%ymm8, %%xmm9\n"				\
+	"vpxor %%xmm9, %%xmm8, %%xmm10\n"
+
+/* Hash the four reflected blocks in zmm4. */
+static inline void
+gcm_vaes_ghash1(const uint64_t *htab)
+{
+	__asm(
+	    "vpxord %%zmm10, %%zmm4, %%zmm4\n"
+	    VAES_MUL_FIRST(4, "0xc0(%[h])")
+	    VAES_REDUCE
+	    :: [h] "r"(htab) : "memory");
+}
+
+/*
+ * Hash the n < 4 reflected blocks in zmm4, whose other lanes are zero.
+ * k1 holds the byte mask of the n blocks.
+ */
+static inline void
+gcm_vaes_ghash_partial(const uint64_t *htab, size_t n)
+{
+	__asm(
+	    "vmovdqu8 (%[h]), %%zmm5%{%%k1%}%{z%}\n"
+	    "vpxord %%zmm10, %%zmm4, %%zmm4\n"
+	    VAES_MUL_FIRST(4, "%%zmm5")
+	    VAES_REDUCE
+	    :: [h] "r"(htab + 2 * (16 - n)) : "memory");
+}
+
+static inline void
+gcm_vaes_set_mask(size_t n)
+{
+	uint64_t mask = (1ULL << (n * GCM_VAES_BLOCK_LEN)) - 1;
+
+	__asm("kmovq %[m], %%k1" :: [m] "r"(mask));
+}
+
+/* Hash the sixteen reflected blocks in zmm4-7. */
+static inline void
+gcm_vaes_ghash4(const uint64_t *htab)
+{
+	__asm(
+	    "vpxord %%zmm10, %%zmm4, %%zmm4\n"
+	    VAES_MUL_FIRST(4, "0x00(%[h])")
+	    VAES_MUL_NEXT(5, "0x40(%[h])")
+	    VAES_MUL_NEXT(6, "0x80(%[h])")
+	    VAES_MUL_NEXT(7, "0xc0(%[h])")
+	    VAES_REDUCE
+	    :: [h] "r"(htab) : "memory");
+}
+
+static inline void
+gcm_vaes_advance_cb(uint64_t cb[2], size_t len)
+{
+	uint32_t *ctr = (uint32_t *)cb + 3;
+
+	*ctr = htonl(ntohl(*ctr) + (uint32_t)(len / GCM_VAES_BLOCK_LEN));
+}
+
+size_t
+gcm_vaes_encrypt(const uint8_t *in, uint8_t *out, size_t len,
+    const void *key, uint64_t cb[2], uint64_t ghash[2], const uint64_t *htab)
+{
+	const int nr = ((const aes_key_t *)key)->nr;
+	size_t done;
+
+	len -= len % GCM_VAES_BLOCK_LEN;
+	if (len == 0)
+		return (0);
+
+	gcm_vaes_begin(key, cb, ghash);
+	for (done = 0; len - done >= GCM_VAES_LOOP_BYTES;
+	    done += GCM_VAES_LOOP_BYTES) {
+		gcm_vaes_ctr4(nr);
+		__asm(
+		    "vpxord 0x00(%[in]), %%zmm0, %%zmm0\n"
+		    "vpxord 0x40(%[in]), %%zmm1, %%zmm1\n"
+		    "vpxord 0x80(%[in]), %%zmm2, %%zmm2\n"
+		    "vpxord 0xc0(%[in]), %%zmm3, %%zmm3\n"
+		    "vmovdqu64 %%zmm0, 0x00(%[out])\n"
+		    "vmovdqu64 %%zmm1, 0x40(%[out])\n"
+		    "vmovdqu64 %%zmm2, 0x80(%[out])\n"
+		    "vmovdqu64 %%zmm3, 0xc0(%[out])\n"
+		    "vpshufb %%zmm31, %%zmm0, %%zmm4\n"
+		    "vpshufb %%zmm31, %%zmm1, %%zmm5\n"
+		    "vpshufb %%zmm31, %%zmm2, %%zmm6\n"
+		    "vpshufb %%zmm31, %%zmm3, %%zmm7\n"
+		    :: [in] "r"(in + done), [out] "r"(out + done)
+		    : "memory");
+		gcm_vaes_ghash4(htab);
+	}
+	for (; len - done >= GCM_VAES_LANE_BYTES; done += GCM_VAES_LANE_BYTES) {
+		gcm_vaes_ctr1(nr);
+		__asm(
+		    "vpxord (%[in]), %%zmm0, %%zmm0\n"
+		    "vmovdqu64 %%zmm0, (%[out])\n"
+		    "vpshufb %%zmm31, %%zmm0, %%zmm4\n"
+		    :: [in] "r"(in + done), [out] "r"(out + done)
+		    : "memory");
+		gcm_vaes_ghash1(htab);
+	}
+	if (done < len) {
+		size_t n = (len - done) / GCM_VAES_BLOCK_LEN;
+
+		gcm_vaes_set_mask(n);
+		gcm_vaes_ctr1(nr);
+		__asm(
+		    "vmovdqu8 (%[in]), %%zmm4%{%%k1%}%{z%}\n"
+		    "vpxord %%zmm4, %%zmm0, %%zmm0\n"
+		    "vmovdqu8 %%zmm0, %%zmm0%{%%k1%}%{z%}\n"
+		    "vmovdqu8 %%zmm0, (%[out])%{%%k1%}\n"
+		    "vpshufb %%zmm31, %%zmm0, %%zmm4\n"
+		    :: [in] "r"(in + done), [out] "r"(out + done)
+		    : "memory");
+		gcm_vaes_ghash_partial(htab, n);
+	}
+	gcm_vaes_end(ghash);
+	gcm_vaes_advance_cb(cb, len);
+
+	return (len);
+}
+
+/*
+ * The input is hashed before the output is written, so this may run in
+ * place.
+ */
+size_t
+gcm_vaes_decrypt(const uint8_t *in, uint8_t *out, size_t len,
+    const void *key, uint64_t cb[2], uint64_t ghash[2], const uint64_t *htab)
+{
+	const int nr = ((const aes_key_t *)key)->nr;
+	size_t done;
+
+	len -= len % GCM_VAES_BLOCK_LEN;
+	if (len == 0)
+		return (0);
+
+	gcm_vaes_begin(key, cb, ghash);
+	for (done = 0; len - done >= GCM_VAES_LOOP_BYTES;
+	    done += GCM_VAES_LOOP_BYTES) {
+		__asm(
+		    "vmovdqu64 0x00(%[in]), %%zmm4\n"
+		    "vmovdqu64 0x40(%[in]), %%zmm5\n"
+		    "vmovdqu64 0x80(%[in]), %%zmm6\n"
+		    "vmovdqu64 0xc0(%[in]), %%zmm7\n"
+		    "vpshufb %%zmm31, %%zmm4, %%zmm4\n"
+		    "vpshufb %%zmm31, %%zmm5, %%zmm5\n"
+		    "vpshufb %%zmm31, %%zmm6, %%zmm6\n"
+		    "vpshufb %%zmm31, %%zmm7, %%zmm7\n"
+		    :: [in] "r"(in + done) : "memory");
+		gcm_vaes_ghash4(htab);
+		gcm_vaes_ctr4(nr);
+		__asm(
+		    "vpxord 0x00(%[in]), %%zmm0, %%zmm0\n"
+		    "vpxord 0x40(%[in]), %%zmm1, %%zmm1\n"
+		    "vpxord 0x80(%[in]), %%zmm2, %%zmm2\n"
+		    "vpxord 0xc0(%[in]), %%zmm3, %%zmm3\n"
+		    "vmovdqu64 %%zmm0, 0x00(%[out])\n"
+		    "vmovdqu64 %%zmm1, 0x40(%[out])\n"
+		    "vmovdqu64 %%zmm2, 0x80(%[out])\n"
+		    "vmovdqu64 %%zmm3, 0xc0(%[out])\n"
+		    :: [in] "r"(in + done), [out] "r"(out + done)
+		    : "memory");
+	}
+	for (; len - done >= GCM_VAES_LANE_BYTES; done += GCM_VAES_LANE_BYTES) {
+		__asm(
+		    "vmovdqu64 (%[in]), %%zmm4\n"
+		    "vpshufb %%zmm31, %%zmm4, %%zmm4\n"
+		    :: [in] "r"(in + done) : "memory");
+		gcm_vaes_ghash1(htab);
+		gcm_vaes_ctr1(nr);
+		__asm(
+		    "vpxord (%[in]), %%zmm0, %%zmm0\n"
+		    "vmovdqu64 %%zmm0, (%[out])\n"
+		    :: [in] "r"(in + done), [out] "r"(out + done)
+		    : "memory");
+	}
+	if (done < len) {
+		size_t n = (len - done) / GCM_VAES_BLOCK_LEN;
+
+		gcm_vaes_set_mask(n);
+		__asm(
+		    "vmovdqu8 (%[in]), %%zmm6%{%%k1%}%{z%}\n"
+		    "vpshufb %%zmm31, %%zmm6, %%zmm4\n"
+		    :: [in] "r"(in + done) : "memory");
+		gcm_vaes_ghash_partial(htab, n);
+		gcm_vaes_ctr1(nr);
+		__asm(
+		    "vpxord %%zmm6, %%zmm0, %%zmm0\n"
+		    "vmovdqu8 %%zmm0, (%[out])%{%%k1%}\n"
+		    :: [out] "r"(out + done) : "memory");
+	}
+	gcm_vaes_end(ghash);
+	gcm_vaes_advance_cb(cb, len);
+
+	return (len);
+}
+
+#endif /* defined(__x86_64) && defined(HAVE_VAES) ... */
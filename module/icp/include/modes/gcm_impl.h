@@ -58,6 +58,22 @@ extern const gcm_impl_ops_t gcm_generic_impl;
 extern const gcm_impl_ops_t gcm_pclmulqdq_impl;
 #endif
 
+#ifdef CAN_USE_GCM_VAES
+/*
+ * 512 bit VAES and VPCLMULQDQ bulk routines used by the avx code path.
+ * They process all complete 16 byte blocks of their input and return
+ * the number of bytes done. The caller has to own the FPU.
+ */
+#define	GCM_VAES_HTAB_SIZE	(16 * 2 * sizeof (uint64_t))
+
+extern boolean_t gcm_vaes_will_work(void);
+extern void gcm_vaes_init_htab(uint64_t *, const uint64_t H[2]);
+extern size_t gcm_vaes_encrypt(const uint8_t *, uint8_t *, size_t,
+    const void *, uint64_t cb[2], uint64_t ghash[2], const uint64_t *);
+extern size_t gcm_vaes_decrypt(const uint8_t *, uint8_t *, size_t,
+    const void *, uint64_t cb[2], uint64_t ghash[2], const uint64_t *);
+#endif
+
 /*
  * Initializes fastest implementation
  */
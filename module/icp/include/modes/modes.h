@@ -43,6 +43,10 @@ extern "C" {
     defined(HAVE_AES) && defined(HAVE_PCLMULQDQ)
 #define	CAN_USE_GCM_ASM
 extern boolean_t gcm_avx_can_use_movbe;
+#if defined(HAVE_AVX512F) && defined(HAVE_AVX512BW) && \
+    defined(HAVE_VAES) && defined(HAVE_VPCLMULQDQ)
+#define	CAN_USE_GCM_VAES
+#endif
 #endif
 
 #define	CCM_MODE			0x00000010
@@ -146,7 +150,8 @@ typedef struct ccm_ctx {
  * gcm_H:		Subkey.
  *
  * gcm_Htable:		Pre-computed and pre-shifted H, H^2, ... H^6 for the
- *			Karatsuba Algorithm in host byte order.
+ *			Karatsuba Algorithm in host byte order, followed by
+ *			H^16 ... H for the vaes implementation if it's used.
  *
  * gcm_J0:		Pre-counter block generated from the IV.
  *
@@ -174,6 +179,7 @@ typedef struct gcm_ctx {
 	uint8_t *gcm_pt_buf;
 #ifdef CAN_USE_GCM_ASM
 	boolean_t gcm_use_avx;
+	boolean_t gcm_use_vaes;
 #endif
 } gcm_ctx_t;
 
@@ -40,6 +40,28 @@
 
 static MALLOC_DEFINE(M_KSTAT, "kstat_data", "Kernel statistics");
 
+/* Installed named kstats, for kstat_walk_named() */
+static kmutex_t kstat_list_lock;
+static list_t kstat_list;
+
+static void
+kstat_list_init(void *arg __unused)
+{
+	mutex_init(&kstat_list_lock, NULL, MUTEX_DEFAULT, NULL);
+	list_create(&kstat_list, sizeof (kstat_t),
+	    offsetof(kstat_t, ks_node));
+}
+
+static void
+kstat_list_fini(void *arg __unused)
+{
+	list_destroy(&kstat_list);
+	mutex_destroy(&kstat_list_lock);
+}
+
+SYSINIT(kstat_list, SI_SUB_DRIVERS, SI_ORDER_FIRST, kstat_list_init, NULL);
+SYSUNINIT(kstat_list, SI_SUB_DRIVERS, SI_ORDER_FIRST, kstat_list_fini, NULL);
+
 SYSCTL_ROOT_NODE(OID_AUTO, kstat, CTLFLAG_RW, 0, "Kernel statistics");
 
 void
@@ -297,14 +319,14 @@ __kstat_create(const char *module, int instance, const char *name,
 		class = "misc";
 
 	/*
-	 * Allocate the main structure. We don't need to keep a copy of
-	 * module in here, because it is only used for sysctl node creation
-	 * done in this function.
+	 * Allocate the main structure.  The module is kept only so that
+	 * kstat_walk_named() can match on it.
 	 */
 	ksp = malloc(sizeof (*ksp), M_KSTAT, M_WAITOK|M_ZERO);
 
 	ksp->ks_crtime = gethrtime();
 	ksp->ks_snaptime = ksp->ks_crtime;
+	(void) strlcpy(ksp->ks_module, module, KSTAT_STRLEN);
 	ksp->ks_instance = instance;
 	(void) strlcpy(ksp->ks_name, name, KSTAT_STRLEN);
 	(void) strlcpy(ksp->ks_class, class, KSTAT_STRLEN);
@@ -525,7 +547,11 @@ kstat_install(kstat_t *ksp)
 
 	switch (ksp->ks_type) {
 	case KSTAT_TYPE_NAMED:
-		return (kstat_install_named(ksp));
+		kstat_install_named(ksp);
+		mutex_enter(&kstat_list_lock);
+		list_insert_tail(&kstat_list, ksp);
+		mutex_exit(&kstat_list_lock);
+		return;
 	case KSTAT_TYPE_RAW:
 		if (ksp->ks_raw_ops.data) {
 			root = SYSCTL_ADD_PROC(&ksp->ks_sysctl_ctx,
@@ -557,10 +583,37 @@ kstat_install(kstat_t *ksp)
 	ksp->ks_sysctl_root = root;
 }
 
+/*
+ * Call cb() for each installed named kstat of the given module, e.g. "zfs"
+ * or "zfs/<pool>", stopping at the first error.  kstat_delete() waits for
+ * the walk to finish, so cb() may take the kstat's ks_lock, but it must not
+ * create or delete kstats.
+ */
+int
+kstat_walk_named(const char *module, kstat_walk_cb_t *cb, void *arg)
+{
+	int error = 0;
+
+	mutex_enter(&kstat_list_lock);
+	for (kstat_t *ksp = list_head(&kstat_list); ksp != NULL && error == 0;
+	    ksp = list_next(&kstat_list, ksp)) {
+		if (strcmp(ksp->ks_module, module) == 0)
+			error = cb(ksp, ksp->ks_name, arg);
+	}
+	mutex_exit(&kstat_list_lock);
+
+	return (error);
+}
+
 void
 kstat_delete(kstat_t *ksp)
 {
 
+	if (list_link_active(&ksp->ks_node)) {
+		mutex_enter(&kstat_list_lock);
+		list_remove(&kstat_list, ksp);
+		mutex_exit(&kstat_list_lock);
+	}
 	sysctl_ctx_free(&ksp->ks_sysctl_ctx);
 	ksp->ks_lock = NULL;
 	mutex_destroy(&ksp->ks_private_lock);
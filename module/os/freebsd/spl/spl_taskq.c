@@ -346,6 +346,17 @@ taskq_of_curthread(void)
 	return (tsd_get(taskq_tsd));
 }
 
+/*
+ * taskqueue(9) does not expose how many of its threads are idle, so
+ * never report a taskq as busy.
+ */
+boolean_t
+taskq_busy(taskq_t *tq)
+{
+	(void) tq;
+	return (B_FALSE);
+}
+
 static void
 taskq_free(taskq_ent_t *task)
 {
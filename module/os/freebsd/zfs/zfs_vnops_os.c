@@ -925,11 +925,14 @@ zfs_lookup(vnode_t *dvp, const char *nm, vnode_t **vpp,
 	 */
 	for (;;) {
 		uint64_t parent;
+		hrtime_t start = gethrtime();
 
 		error = zfs_dirlook(zdp, nm, &zp);
 		if (error == 0)
 			*vpp = ZTOV(zp);
 
+		dataset_kstats_update_lookup_time(&zfsvfs->z_kstat,
+		    gethrtime() - start);
 		zfs_exit(zfsvfs, FTAG);
 		if (error != 0)
 			break;
@@ -1727,6 +1730,7 @@ zfs_readdir(vnode_t *vp, zfs_uio_t *uio, cred_t *cr, int *eofp,
 	int		outcount;
 	int		error;
 	uint8_t		prefetch;
+	uint64_t	pfblk = UINT64_MAX;	/* dnode block prefetched */
 	uint8_t		type;
 	int		ncooks;
 	cookie_t	*cooks = NULL;
@@ -1897,8 +1901,14 @@ zfs_readdir(vnode_t *vp, zfs_uio_t *uio, cred_t *cr, int *eofp,
 
 		ASSERT3S(outcount, <=, bufsize);
 
-		if (prefetch)
+		/*
+		 * Entries created together are usually allocated in the same
+		 * dnode block, so only prefetch each block once in a row.
+		 */
+		if (prefetch && objnum >> DNODES_PER_BLOCK_SHIFT != pfblk) {
+			pfblk = objnum >> DNODES_PER_BLOCK_SHIFT;
 			dmu_prefetch_dnode(os, objnum, ZIO_PRIORITY_SYNC_READ);
+		}
 
 		/*
 		 * Move to the next entry, fill in the previous offset.
@@ -1919,7 +1929,12 @@ zfs_readdir(vnode_t *vp, zfs_uio_t *uio, cred_t *cr, int *eofp,
 			KASSERT(ncooks >= 0, ("ncookies=%d", ncooks));
 		}
 	}
-	zp->z_zn_prefetch = B_FALSE; /* a lookup will re-enable pre-fetching */
+	/*
+	 * Keep prefetching across calls until the whole directory has been
+	 * read; a lookup will re-enable pre-fetching after that.
+	 */
+	if (error == ENOENT)
+		zp->z_zn_prefetch = B_FALSE;
 
 	/* Subtract unused cookies */
 	if (ncookies != NULL)
@@ -1985,6 +2000,7 @@ zfs_getattr(vnode_t *vp, vattr_t *vap, int flags, cred_t *cr)
 	boolean_t skipaclchk = (flags & ATTR_NOACLCHECK) ? B_TRUE : B_FALSE;
 	sa_bulk_attr_t bulk[4];
 	int count = 0;
+	hrtime_t start = gethrtime();
 
 	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
 		return (error);
@@ -2165,6 +2181,8 @@ zfs_getattr(vnode_t *vp, vattr_t *vap, int flags, cred_t *cr)
 		vap->va_blksize = zfsvfs->z_max_blksz;
 	}
 
+	dataset_kstats_update_getattr_time(&zfsvfs->z_kstat,
+	    gethrtime() - start);
 	zfs_exit(zfsvfs, FTAG);
 	return (0);
 }
@@ -77,6 +77,25 @@ module_param(spl_kmem_cache_magazine_size, uint, 0444);
 MODULE_PARM_DESC(spl_kmem_cache_magazine_size,
 	"Default magazine size (2-256), set automatically (0)");
 
+/*
+ * When the magazine size is determined automatically, the magazines of a
+ * cache are grown whenever the cache's depot (the slab lists protected by
+ * skc_lock) is found contended at least spl_kmem_cache_magazine_contention
+ * times in a second.  Each resize doubles the size, up to
+ * spl_kmem_cache_magazine_grow times the initial size.  Larger magazines
+ * take the depot lock less often, at the cost of keeping more free objects
+ * cached per cpu.  Setting the growth factor to 1 keeps magazines fixed.
+ */
+static unsigned int spl_kmem_cache_magazine_grow = 4;
+module_param(spl_kmem_cache_magazine_grow, uint, 0444);
+MODULE_PARM_DESC(spl_kmem_cache_magazine_grow,
+	"Maximum factor by which magazines grow under contention");
+
+static unsigned int spl_kmem_cache_magazine_contention = 64;
+module_param(spl_kmem_cache_magazine_contention, uint, 0644);
+MODULE_PARM_DESC(spl_kmem_cache_magazine_contention,
+	"Depot lock contentions per second which grow the magazines");
+
 static unsigned int spl_kmem_cache_obj_per_slab = SPL_KMEM_CACHE_OBJ_PER_SLAB;
 module_param(spl_kmem_cache_obj_per_slab, uint, 0644);
 MODULE_PARM_DESC(spl_kmem_cache_obj_per_slab, "Number of objects per slab");
@@ -490,6 +509,53 @@ spl_emergency_free(spl_kmem_cache_t *skc, void *obj)
 	return (0);
 }
 
+/*
+ * Take the depot lock on behalf of a magazine refill or flush, counting
+ * how often it is contended.  Once a second the contention count is used
+ * to decide whether the magazines should grow.  The new size is picked up
+ * by each magazine on its next refill or flush, see spl_magazine_adapt().
+ */
+static void
+spl_depot_lock(spl_kmem_cache_t *skc)
+{
+	if (!spin_trylock(&skc->skc_lock)) {
+		spin_lock(&skc->skc_lock);
+		skc->skc_depot_contended++;
+	}
+	skc->skc_depot_ops++;
+
+	if (skc->skc_mag_size >= skc->skc_mag_size_max ||
+	    time_before(jiffies, skc->skc_mag_adapt + HZ))
+		return;
+
+	if (skc->skc_depot_contended - skc->skc_depot_mark >=
+	    spl_kmem_cache_magazine_contention) {
+		skc->skc_mag_size = MIN(skc->skc_mag_size * 2,
+		    skc->skc_mag_size_max);
+		skc->skc_mag_refill = (skc->skc_mag_size + 1) / 2;
+		skc->skc_mag_resize++;
+	}
+	skc->skc_depot_mark = skc->skc_depot_contended;
+	skc->skc_mag_adapt = jiffies;
+}
+
+/*
+ * Bring a per-cpu magazine up to the current size of the cache's
+ * magazines.  Sizes only grow, so the objects it holds always fit.
+ */
+static inline void
+spl_magazine_adapt(spl_kmem_cache_t *skc, spl_kmem_magazine_t *skm)
+{
+	uint32_t size = READ_ONCE(skc->skc_mag_size);
+
+	if (unlikely(skm->skm_size != size)) {
+		ASSERT3U(size, >, skm->skm_size);
+		ASSERT3U(size, <=, skc->skc_mag_size_max);
+		skm->skm_size = size;
+		skm->skm_refill = (size + 1) / 2;
+	}
+}
+
 /*
  * Release objects from the per-cpu magazine back to their slab.  The flush
  * argument contains the max number of entries to remove from the magazine.
@@ -497,7 +563,7 @@ spl_emergency_free(spl_kmem_cache_t *skc, void *obj)
 static void
 spl_cache_flush(spl_kmem_cache_t *skc, spl_kmem_magazine_t *skm, int flush)
 {
-	spin_lock(&skc->skc_lock);
+	spl_depot_lock(skc);
 
 	ASSERT(skc->skc_magic == SKC_MAGIC);
 	ASSERT(skm->skm_magic == SKM_MAGIC);
@@ -546,9 +612,9 @@ spl_slab_size(spl_kmem_cache_t *skc, uint32_t *objs, uint32_t *size)
 }
 
 /*
- * Make a guess at reasonable per-cpu magazine size based on the size of
- * each object and the cost of caching N of them in each magazine.  Long
- * term this should really adapt based on an observed usage heuristic.
+ * Make a guess at reasonable initial per-cpu magazine size based on the size
+ * of each object and the cost of caching N of them in each magazine.  The
+ * magazines then grow if the depot turns out to be contended.
  */
 static int
 spl_magazine_size(spl_kmem_cache_t *skc)
@@ -574,6 +640,26 @@ spl_magazine_size(spl_kmem_cache_t *skc)
 	return (size);
 }
 
+/*
+ * The largest size the magazines may grow to under depot contention.  Growth
+ * is limited to SPL_MAGAZINE_MAX_BYTES worth of objects per magazine, unless
+ * the initial size already exceeds that, and disabled when the size was set
+ * explicitly.
+ */
+static int
+spl_magazine_size_max(spl_kmem_cache_t *skc)
+{
+	uint32_t obj_size = spl_obj_size(skc);
+	int size = skc->skc_mag_size;
+
+	if (spl_kmem_cache_magazine_size > 0 ||
+	    spl_kmem_cache_magazine_grow <= 1)
+		return (size);
+
+	return (MAX(size, MIN(MIN(size * spl_kmem_cache_magazine_grow,
+	    SPL_MAGAZINE_MAX), SPL_MAGAZINE_MAX_BYTES / obj_size)));
+}
+
 /*
  * Allocate a per-cpu magazine to associate with a specific core.
  */
@@ -582,7 +668,7 @@ spl_magazine_alloc(spl_kmem_cache_t *skc, int cpu)
 {
 	spl_kmem_magazine_t *skm;
 	int size = sizeof (spl_kmem_magazine_t) +
-	    sizeof (void *) * skc->skc_mag_size;
+	    sizeof (void *) * skc->skc_mag_size_max;
 
 	skm = kmalloc_node(size, GFP_KERNEL, cpu_to_node(cpu));
 	if (skm) {
@@ -622,6 +708,8 @@ spl_magazine_create(spl_kmem_cache_t *skc)
 	    num_possible_cpus(), kmem_flags_convert(KM_SLEEP));
 	skc->skc_mag_size = spl_magazine_size(skc);
 	skc->skc_mag_refill = (skc->skc_mag_size + 1) / 2;
+	skc->skc_mag_size_max = spl_magazine_size_max(skc);
+	skc->skc_mag_adapt = jiffies;
 
 	for_each_possible_cpu(i) {
 		skc->skc_mag[i] = spl_magazine_alloc(skc, i);
@@ -1110,8 +1198,9 @@ spl_cache_refill(spl_kmem_cache_t *skc, spl_kmem_magazine_t *skm, int flags)
 	ASSERT(skc->skc_magic == SKC_MAGIC);
 	ASSERT(skm->skm_magic == SKM_MAGIC);
 
+	spl_depot_lock(skc);
+	spl_magazine_adapt(skc, skm);
 	refill = MIN(skm->skm_refill, skm->skm_size - skm->skm_avail);
-	spin_lock(&skc->skc_lock);
 
 	while (refill > 0) {
 		/* No slabs available we may need to grow the cache */
@@ -1360,8 +1449,11 @@ spl_kmem_cache_free(spl_kmem_cache_t *skc, void *obj)
 	 * interrupts are re-enabled.
 	 */
 	if (unlikely(skm->skm_avail >= skm->skm_size)) {
-		spl_cache_flush(skc, skm, skm->skm_refill);
-		do_reclaim = 1;
+		spl_magazine_adapt(skc, skm);
+		if (skm->skm_avail >= skm->skm_size) {
+			spl_cache_flush(skc, skm, skm->skm_refill);
+			do_reclaim = 1;
+		}
 	}
 
 	/* Available space in cache, use it */
@@ -478,6 +478,7 @@ kstat_proc_entry_init(kstat_proc_entry_t *kpep, const char *module,
     const char *name)
 {
 	kpep->kpe_owner = NULL;
+	kpep->kpe_kstat = NULL;
 	kpep->kpe_proc = NULL;
 	INIT_LIST_HEAD(&kpep->kpe_list);
 	strlcpy(kpep->kpe_module, module, sizeof (kpep->kpe_module));
@@ -526,6 +527,7 @@ __kstat_create(const char *ks_module, int ks_instance, const char *ks_name,
 	ksp->ks_raw_buf = NULL;
 	ksp->ks_raw_bufsize = 0;
 	kstat_proc_entry_init(&ksp->ks_proc, ks_module, ks_name);
+	ksp->ks_proc.kpe_kstat = ksp;
 
 	switch (ksp->ks_type) {
 		case KSTAT_TYPE_RAW:
@@ -685,6 +687,37 @@ kstat_proc_entry_delete(kstat_proc_entry_t *kpep)
 }
 EXPORT_SYMBOL(kstat_proc_entry_delete);
 
+/*
+ * Call cb() for each installed named kstat of the given module, e.g. "zfs"
+ * or "zfs/<pool>", stopping at the first error.  kstat_delete() waits for
+ * the walk to finish, so cb() may take the kstat's ks_lock, but it must not
+ * create or delete kstats.
+ */
+int
+kstat_walk_named(const char *module, kstat_walk_cb_t *cb, void *arg)
+{
+	kstat_module_t *ksm;
+	kstat_proc_entry_t *kpep;
+	int error = 0;
+
+	mutex_enter(&kstat_module_lock);
+	ksm = kstat_find_module((char *)module);
+	if (ksm != NULL) {
+		list_for_each_entry(kpep, &ksm->ksm_kstat_list, kpe_list) {
+			kstat_t *ksp = kpep->kpe_kstat;
+
+			if (ksp == NULL || ksp->ks_type != KSTAT_TYPE_NAMED)
+				continue;
+			if ((error = cb(ksp, kpep->kpe_name, arg)) != 0)
+				break;
+		}
+	}
+	mutex_exit(&kstat_module_lock);
+
+	return (error);
+}
+EXPORT_SYMBOL(kstat_walk_named);
+
 void
 __kstat_delete(kstat_t *ksp)
 {
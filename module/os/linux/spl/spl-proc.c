@@ -56,6 +56,7 @@ static struct proc_dir_entry *proc_spl_kmem = NULL;
 static struct proc_dir_entry *proc_spl_kmem_slab = NULL;
 static struct proc_dir_entry *proc_spl_taskq_all = NULL;
 static struct proc_dir_entry *proc_spl_taskq = NULL;
+static struct proc_dir_entry *proc_spl_taskq_stats = NULL;
 struct proc_dir_entry *proc_spl_kstat = NULL;
 
 #ifdef DEBUG_KMEM
@@ -327,15 +328,83 @@ taskq_seq_show(struct seq_file *f, void *p)
 	return (taskq_seq_show_impl(f, p, B_FALSE));
 }
 
+static void
+taskq_stats_seq_show_headers(struct seq_file *f)
+{
+	seq_printf(f, "%-25s %12s %5s %12s %12s %5s\n",
+	    "taskq", "tasks", "nthr", "busy_ms", "thread_ms", "util%");
+	seq_printf(f, "%-25s %s\n", "",
+	    "wait/run: tasks per time bucket, the first below 1024ns and "
+	    "each next one twice as wide");
+}
+
+static void
+taskq_stats_seq_show_hist(struct seq_file *f, const char *name,
+    const uint64_t *hist)
+{
+	int i, last = 0;
+
+	for (i = 0; i < TASKQ_STAT_BUCKETS; i++)
+		if (hist[i] != 0)
+			last = i;
+
+	seq_printf(f, "\t%s:", name);
+	for (i = 0; i <= last; i++)
+		seq_printf(f, " %llu", (u_longlong_t)hist[i]);
+	seq_printf(f, "\n");
+}
+
+/*
+ * Thread utilisation is the time spent running tasks over the combined
+ * lifetime of the taskq's threads, including those which have exited.
+ */
+static int
+taskq_stats_seq_show(struct seq_file *f, void *p)
+{
+	taskq_t *tq = p;
+	taskq_thread_t *tqt;
+	uint64_t wait[TASKQ_STAT_BUCKETS], run[TASKQ_STAT_BUCKETS];
+	uint64_t tasks, busy, thread;
+	hrtime_t now = gethrtime();
+	char name[100];
+	unsigned long flags;
+	int nthreads;
+
+	spin_lock_irqsave_nested(&tq->tq_lock, flags, tq->tq_lock_class);
+	tasks = tq->tq_stat_tasks;
+	busy = tq->tq_stat_busy;
+	thread = tq->tq_stat_thread;
+	list_for_each_entry(tqt, &tq->tq_thread_list, tqt_thread_list)
+		thread += now - tqt->tqt_born;
+	nthreads = tq->tq_nthreads;
+	memcpy(wait, tq->tq_stat_wait, sizeof (wait));
+	memcpy(run, tq->tq_stat_run, sizeof (run));
+	spin_unlock_irqrestore(&tq->tq_lock, flags);
+
+	snprintf(name, sizeof (name), "%s/%d", tq->tq_name, tq->tq_instance);
+	seq_printf(f, "%-25s %12llu %5d %12llu %12llu %5llu\n", name,
+	    (u_longlong_t)tasks, nthreads, (u_longlong_t)NSEC2MSEC(busy),
+	    (u_longlong_t)NSEC2MSEC(thread),
+	    (u_longlong_t)(thread ? MIN(busy, thread) * 100 / thread : 0));
+
+	if (tasks != 0) {
+		taskq_stats_seq_show_hist(f, "wait", wait);
+		taskq_stats_seq_show_hist(f, "run", run);
+	}
+
+	return (0);
+}
+
 static void *
-taskq_seq_start(struct seq_file *f, loff_t *pos)
+taskq_seq_start_impl(struct seq_file *f, loff_t *pos,
+    void (*show_headers)(struct seq_file *))
 {
 	struct list_head *p;
 	loff_t n = *pos;
 
 	down_read(&tq_list_sem);
 	if (!n)
-		taskq_seq_show_headers(f);
+		show_headers(f);
 
 	p = tq_list.next;
 	while (n--) {
@@ -347,6 +416,18 @@ taskq_seq_start(struct seq_file *f, loff_t *pos)
 	return (list_entry(p, taskq_t, tq_taskqs));
 }
 
+static void *
+taskq_seq_start(struct seq_file *f, loff_t *pos)
+{
+	return (taskq_seq_start_impl(f, pos, taskq_seq_show_headers));
+}
+
+static void *
+taskq_stats_seq_start(struct seq_file *f, loff_t *pos)
+{
+	return (taskq_seq_start_impl(f, pos, taskq_stats_seq_show_headers));
+}
+
 static void *
 taskq_seq_next(struct seq_file *f, void *p, loff_t *pos)
 {
@@ -365,13 +446,15 @@ slab_seq_show_headers(struct seq_file *f)
 	    "---------------------------------------------  "
 	    "----- slab ------  "
 	    "---- object -----  "
-	    "--- emergency ---\n");
+	    "--- emergency ---  "
+	    "---------- magazine -----------\n");
 	seq_printf(f,
 	    "name                                  "
 	    "  flags      size     alloc slabsize  objsize  "
 	    "total alloc   max  "
 	    "total alloc   max  "
-	    "dlock alloc   max\n");
+	    "dlock alloc   max  "
+	    " size resize    depot contended\n");
 }
 
 static int
@@ -394,7 +477,8 @@ slab_seq_show(struct seq_file *f, void *p)
 		    percpu_counter_sum(&skc->skc_linux_alloc);
 		seq_printf(f, "%-36s  ", skc->skc_name);
 		seq_printf(f, "0x%05lx %9s %9lu %8s %8u  "
-		    "%5s %5s %5s  %5s %5lu %5s  %5s %5s %5s\n",
+		    "%5s %5s %5s  %5s %5lu %5s  %5s %5s %5s  "
+		    "%5s %6s %8s %9s\n",
 		    (long unsigned)skc->skc_flags,
 		    "-",
 		    (long unsigned)(skc->skc_obj_size * objs_allocated),
@@ -402,6 +486,7 @@ slab_seq_show(struct seq_file *f, void *p)
 		    (unsigned)skc->skc_obj_size,
 		    "-", "-", "-", "-",
 		    (long unsigned)objs_allocated,
+		    "-", "-", "-", "-",
 		    "-", "-", "-", "-");
 		spin_unlock(&skc->skc_lock);
 		return (0);
@@ -410,7 +495,8 @@ slab_seq_show(struct seq_file *f, void *p)
 	spin_lock(&skc->skc_lock);
 	seq_printf(f, "%-36s  ", skc->skc_name);
 	seq_printf(f, "0x%05lx %9lu %9lu %8u %8u  "
-	    "%5lu %5lu %5lu  %5lu %5lu %5lu  %5lu %5lu %5lu\n",
+	    "%5lu %5lu %5lu  %5lu %5lu %5lu  %5lu %5lu %5lu  "
+	    "%5u %6lu %8lu %9lu\n",
 	    (long unsigned)skc->skc_flags,
 	    (long unsigned)(skc->skc_slab_size * skc->skc_slab_total),
 	    (long unsigned)(skc->skc_obj_size * skc->skc_obj_alloc),
@@ -424,7 +510,11 @@ slab_seq_show(struct seq_file *f, void *p)
 	    (long unsigned)skc->skc_obj_max,
 	    (long unsigned)skc->skc_obj_deadlock,
 	    (long unsigned)skc->skc_obj_emergency,
-	    (long unsigned)skc->skc_obj_emergency_max);
+	    (long unsigned)skc->skc_obj_emergency_max,
+	    (unsigned)skc->skc_mag_size,
+	    (long unsigned)skc->skc_mag_resize,
+	    (long unsigned)skc->skc_depot_ops,
+	    (long unsigned)skc->skc_depot_contended);
 	spin_unlock(&skc->skc_lock);
 	return (0);
 }
@@ -512,6 +602,13 @@ static const struct seq_operations taskq_seq_ops = {
 	.stop	= taskq_seq_stop,
 };
 
+static const struct seq_operations taskq_stats_seq_ops = {
+	.show	= taskq_stats_seq_show,
+	.start	= taskq_stats_seq_start,
+	.next	= taskq_seq_next,
+	.stop	= taskq_seq_stop,
+};
+
 static int
 proc_taskq_all_open(struct inode *inode, struct file *filp)
 {
@@ -524,6 +621,12 @@ proc_taskq_open(struct inode *inode, struct file *filp)
 	return (seq_open(filp, &taskq_seq_ops));
 }
 
+static int
+proc_taskq_stats_open(struct inode *inode, struct file *filp)
+{
+	return (seq_open(filp, &taskq_stats_seq_ops));
+}
+
 static const kstat_proc_op_t proc_taskq_all_operations = {
 #ifdef HAVE_PROC_OPS_STRUCT
 	.proc_open	= proc_taskq_all_open,
@@ -552,6 +655,20 @@ static const kstat_proc_op_t proc_taskq_operations = {
 #endif
 };
 
+static const kstat_proc_op_t proc_taskq_stats_operations = {
+#ifdef HAVE_PROC_OPS_STRUCT
+	.proc_open	= proc_taskq_stats_open,
+	.proc_read	= seq_read,
+	.proc_lseek	= seq_lseek,
+	.proc_release	= seq_release,
+#else
+	.open		= proc_taskq_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+#endif
+};
+
 static struct ctl_table spl_kmem_table[] = {
 #ifdef DEBUG_KMEM
 	{
@@ -670,6 +787,7 @@ static void spl_proc_cleanup(void)
 	remove_proc_entry("kmem", proc_spl);
 	remove_proc_entry("taskq-all", proc_spl);
 	remove_proc_entry("taskq", proc_spl);
+	remove_proc_entry("taskq-stats", proc_spl);
 	remove_proc_entry("spl", NULL);
 
 #ifndef HAVE_REGISTER_SYSCTL_TABLE
@@ -734,6 +852,13 @@ spl_proc_init(void)
 		goto out;
 	}
 
+	proc_spl_taskq_stats = proc_create_data("taskq-stats", 0444, proc_spl,
+	    &proc_taskq_stats_operations, NULL);
+	if (proc_spl_taskq_stats == NULL) {
+		rc = -EUNATCH;
+		goto out;
+	}
+
 	proc_spl_kmem = proc_mkdir("kmem", proc_spl);
 	if (proc_spl_kmem == NULL) {
 		rc = -EUNATCH;
@@ -48,13 +48,22 @@ spl_shrinker_single_cb(struct shrinker *shrinker, struct shrink_control *sc)
 struct shrinker *
 spl_register_shrinker(const char *name, spl_shrinker_cb countfunc,
     spl_shrinker_cb scanfunc, int seek_cost)
+{
+	return (spl_register_shrinker_flags(name, countfunc, scanfunc,
+	    seek_cost, 0));
+}
+EXPORT_SYMBOL(spl_register_shrinker);
+
+struct shrinker *
+spl_register_shrinker_flags(const char *name, spl_shrinker_cb countfunc,
+    spl_shrinker_cb scanfunc, int seek_cost, unsigned int flags)
 {
 	struct shrinker *shrinker;
 
 	/* allocate shrinker */
 #if defined(HAVE_SHRINKER_REGISTER)
 	/* 6.7: kernel will allocate the shrinker for us */
-	shrinker = shrinker_alloc(0, name);
+	shrinker = shrinker_alloc(flags, name);
 #elif defined(HAVE_SPLIT_SHRINKER_CALLBACK)
 	/* 3.12-6.6: we allocate the shrinker  */
 	shrinker = kmem_zalloc(sizeof (struct shrinker), KM_SLEEP);
@@ -83,6 +92,9 @@ spl_register_shrinker(const char *name, spl_shrinker_cb countfunc,
 
 	/* set params */
 	shrinker->seeks = seek_cost;
+#if !defined(HAVE_SHRINKER_REGISTER) && !defined(HAVE_SINGLE_SHRINKER_CALLBACK)
+	shrinker->flags = flags;
+#endif
 
 	/* register with kernel */
 #if defined(HAVE_SHRINKER_REGISTER)
@@ -95,7 +107,7 @@ spl_register_shrinker(const char *name, spl_shrinker_cb countfunc,
 
 	return (shrinker);
 }
-EXPORT_SYMBOL(spl_register_shrinker);
+EXPORT_SYMBOL(spl_register_shrinker_flags);
 
 void
 spl_unregister_shrinker(struct shrinker *shrinker)
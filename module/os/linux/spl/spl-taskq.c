@@ -28,6 +28,7 @@
 #include <sys/kmem.h>
 #include <sys/tsd.h>
 #include <sys/trace_spl.h>
+#include <linux/blkdev.h>
 #ifdef HAVE_CPU_HOTPLUG
 #include <linux/cpuhotplug.h>
 #endif
@@ -59,6 +60,13 @@ module_param(spl_taskq_thread_sequential, uint, 0644);
 MODULE_PARM_DESC(spl_taskq_thread_sequential,
 	"Create new taskq threads after N sequential tasks");
 
+static uint_t spl_taskq_thread_plug = 16;
+/* BEGIN CSTYLED */
+module_param(spl_taskq_thread_plug, uint, 0644);
+/* END CSTYLED */
+MODULE_PARM_DESC(spl_taskq_thread_plug,
+	"Batch block I/O submitted by up to N sequential tasks");
+
 /*
  * Global system-wide dynamic task queue available for all consumers. This
  * taskq is not intended for long-running tasks; instead, a dedicated taskq
@@ -243,6 +251,7 @@ task_expire_impl(taskq_ent_t *t)
 	}
 
 	t->tqent_birth = jiffies;
+	t->tqent_hrbirth = gethrtime();
 	DTRACE_PROBE1(taskq_ent__birth, taskq_ent_t *, t);
 
 	/*
@@ -515,6 +524,18 @@ taskq_of_curthread(void)
 }
 EXPORT_SYMBOL(taskq_of_curthread);
 
+/*
+ * Returns B_TRUE if no thread of the taskq is idle, so that a task
+ * dispatched to it would have to wait or spawn a new thread.  This is
+ * checked without tq_lock, so it is only a hint.
+ */
+boolean_t
+taskq_busy(taskq_t *tq)
+{
+	return (READ_ONCE(tq->tq_nactive) >= READ_ONCE(tq->tq_nthreads));
+}
+EXPORT_SYMBOL(taskq_busy);
+
 /*
  * Cancel an already dispatched task given the task id.  Still pending tasks
  * will be immediately canceled, and if the task is active the function will
@@ -621,6 +642,7 @@ taskq_dispatch(taskq_t *tq, task_func_t func, void *arg, uint_t flags)
 	t->tqent_timer.expires = 0;
 
 	t->tqent_birth = jiffies;
+	t->tqent_hrbirth = gethrtime();
 	DTRACE_PROBE1(taskq_ent__birth, taskq_ent_t *, t);
 
 	ASSERT(!(t->tqent_flags & TQENT_FLAG_PREALLOC));
@@ -736,6 +758,7 @@ taskq_dispatch_ent(taskq_t *tq, task_func_t func, void *arg, uint_t flags,
 	t->tqent_taskq = tq;
 
 	t->tqent_birth = jiffies;
+	t->tqent_hrbirth = gethrtime();
 	DTRACE_PROBE1(taskq_ent__birth, taskq_ent_t *, t);
 
 	spin_unlock(&t->tqent_lock);
@@ -865,6 +888,32 @@ taskq_thread_should_stop(taskq_t *tq, taskq_thread_t *tqt)
 	return (1);
 }
 
+/*
+ * Map a duration to its histogram bucket: bucket 0 counts durations below
+ * 1024ns and each following bucket covers twice the range of the previous.
+ */
+static inline int
+taskq_stat_bucket(hrtime_t ns)
+{
+	int b = (ns < 1024) ? 0 : highbit64(ns) - 10;
+
+	return (MIN(b, TASKQ_STAT_BUCKETS - 1));
+}
+
+/*
+ * Account for a completed task.  The caller holds tq_lock, which it must
+ * take after each task anyway, so keeping the statistics costs no more than
+ * two clock reads per task.
+ */
+static void
+taskq_stat_update(taskq_t *tq, hrtime_t wait, hrtime_t run)
+{
+	tq->tq_stat_tasks++;
+	tq->tq_stat_busy += run;
+	tq->tq_stat_wait[taskq_stat_bucket(wait)]++;
+	tq->tq_stat_run[taskq_stat_bucket(run)]++;
+}
+
 static int
 taskq_thread(void *args)
 {
@@ -875,7 +924,11 @@ taskq_thread(void *args)
 	taskq_ent_t *t;
 	int seq_tasks = 0;
 	unsigned long flags;
+	hrtime_t start, wait, run;
 	taskq_ent_t dup_task = {};
+	struct blk_plug plug;
+	boolean_t plugged = B_FALSE;
+	uint_t plug_tasks = 0;
 
 	ASSERT(tqt);
 	ASSERT(tqt->tqt_tq);
@@ -904,10 +957,23 @@ taskq_thread(void *args)
 		goto error;
 
 	tq->tq_nthreads++;
+	tqt->tqt_born = gethrtime();
 	list_add_tail(&tqt->tqt_thread_list, &tq->tq_thread_list);
 	wake_up(&tq->tq_wait_waitq);
 	set_current_state(TASK_INTERRUPTIBLE);
 
+	/*
+	 * Plug the block layer across consecutive tasks, so that the bios
+	 * submitted by, say, a run of zio issue tasks reach the device as one
+	 * batch.  The plug is flushed once spl_taskq_thread_plug tasks have
+	 * run, when there are no more tasks pending, and by the scheduler
+	 * whenever a task blocks.
+	 */
+	if (spl_taskq_thread_plug != 0) {
+		blk_start_plug(&plug);
+		plugged = B_TRUE;
+	}
+
 	while (!kthread_should_stop()) {
 
 		if (list_empty(&tq->tq_pend_list) &&
@@ -931,6 +997,8 @@ taskq_thread(void *args)
 
 		if ((t = taskq_next_ent(tq)) != NULL) {
 			list_del_init(&t->tqent_list);
+			start = gethrtime();
+			wait = start - t->tqent_hrbirth;
 
 			/*
 			 * A TQENT_FLAG_PREALLOC task may be reused or freed
@@ -961,12 +1029,22 @@ taskq_thread(void *args)
 			t->tqent_func(t->tqent_arg);
 
 			DTRACE_PROBE1(taskq_ent__finish, taskq_ent_t *, t);
+			run = gethrtime() - start;
+
+			if (plugged && (++plug_tasks >= spl_taskq_thread_plug ||
+			    (list_empty(&tq->tq_pend_list) &&
+			    list_empty(&tq->tq_prio_list)))) {
+				blk_finish_plug(&plug);
+				blk_start_plug(&plug);
+				plug_tasks = 0;
+			}
 
 			spin_lock_irqsave_nested(&tq->tq_lock, flags,
 			    tq->tq_lock_class);
 			tq->tq_nactive--;
 			list_del_init(&tqt->tqt_active_list);
 			tqt->tqt_task = NULL;
+			taskq_stat_update(tq, wait, run);
 
 			/* For prealloc'd tasks, we don't free anything. */
 			if (!(tqt->tqt_flags & TQENT_FLAG_PREALLOC))
@@ -997,11 +1075,15 @@ taskq_thread(void *args)
 
 	__set_current_state(TASK_RUNNING);
 	tq->tq_nthreads--;
+	tq->tq_stat_thread += gethrtime() - tqt->tqt_born;
 	list_del_init(&tqt->tqt_thread_list);
 error:
 	kmem_free(tqt, sizeof (taskq_thread_t));
 	spin_unlock_irqrestore(&tq->tq_lock, flags);
 
+	if (plugged)
+		blk_finish_plug(&plug);
+
 	tsd_set(taskq_tsd, NULL);
 	thread_exit();
 
@@ -1096,6 +1178,11 @@ taskq_create(const char *name, int threads_arg, pri_t pri,
 	tq->tq_next_id = TASKQID_INITIAL;
 	tq->tq_lowest_id = TASKQID_INITIAL;
 	tq->lastspawnstop = jiffies;
+	tq->tq_stat_tasks = 0;
+	tq->tq_stat_busy = 0;
+	tq->tq_stat_thread = 0;
+	memset(tq->tq_stat_wait, 0, sizeof (tq->tq_stat_wait));
+	memset(tq->tq_stat_run, 0, sizeof (tq->tq_stat_run));
 	INIT_LIST_HEAD(&tq->tq_free_list);
 	INIT_LIST_HEAD(&tq->tq_pend_list);
 	INIT_LIST_HEAD(&tq->tq_prio_list);
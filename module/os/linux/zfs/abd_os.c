@@ -1016,6 +1016,60 @@ abd_cache_reap_now(void)
 
 #if defined(_KERNEL)
 
+/*
+ * Allocate a scatter ABD referencing 'size' bytes of externally owned
+ * pages, such as user pages for a Direct I/O write or the pages of a bio,
+ * starting 'offset' bytes into the first page.  Every page but the first
+ * is used from its start, and every page but the last to its end.  The ABD
+ * takes its own reference on each page, which is dropped once the ABD is
+ * freed, so the pages stay valid for as long as any zio using them.
+ */
+abd_t *
+abd_alloc_from_pages(struct page **pages, unsigned long offset, uint64_t size)
+{
+	uint_t npages = abd_chunkcnt_for_bytes(offset + size);
+	struct sg_table table;
+	struct scatterlist *sg;
+	int i;
+
+	ASSERT3U(offset, <, PAGESIZE);
+	ASSERT3U(size, >, 0);
+	ASSERT3U(size, <=, SPA_MAXBLOCKSIZE);
+
+	while (sg_alloc_table(&table, npages, GFP_NOIO)) {
+		ABDSTAT_BUMP(abdstat_scatter_sg_table_retry);
+		schedule_timeout_interruptible(1);
+	}
+
+	abd_t *abd = abd_alloc_struct(size);
+	abd->abd_flags |= ABD_FLAG_FROM_PAGES;
+	abd->abd_size = size;
+	ABD_SCATTER(abd).abd_offset = offset;
+	ABD_SCATTER(abd).abd_sgl = table.sgl;
+	ABD_SCATTER(abd).abd_nents = npages;
+
+	abd_for_each_sg(abd, sg, npages, i) {
+		get_page(pages[i]);
+		sg_set_page(sg, pages[i], PAGESIZE, 0);
+	}
+
+	return (abd);
+}
+
+void
+abd_free_from_pages(abd_t *abd)
+{
+	struct scatterlist *sg = NULL;
+	int nr_pages = ABD_SCATTER(abd).abd_nents;
+	int i = 0;
+
+	ASSERT(abd->abd_flags & ABD_FLAG_FROM_PAGES);
+
+	abd_for_each_sg(abd, sg, nr_pages, i)
+		put_page(sg_page(sg));
+	abd_free_sg_table(abd);
+}
+
 /*
  * This is abd_iter_page(), the function underneath abd_iterate_page_func().
  * It yields the next page struct and data offset and size within it, without
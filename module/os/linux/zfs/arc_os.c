@@ -141,7 +141,7 @@ arc_available_memory(void)
 static uint64_t
 arc_evictable_memory(void)
 {
-	int64_t asize = aggsum_value(&arc_sums.arcstat_size);
+	int64_t asize = arc_size_approx();
 	uint64_t arc_clean =
 	    zfs_refcount_count(&arc_mru->arcs_esize[ARC_BUFC_DATA]) +
 	    zfs_refcount_count(&arc_mru->arcs_esize[ARC_BUFC_METADATA]) +
@@ -162,6 +162,20 @@ arc_evictable_memory(void)
 	return (MAX((int64_t)asize - (int64_t)min, 0));
 }
 
+/*
+ * When the ARC keeps its lists per NUMA node, the shrinker is registered
+ * node-aware and the kernel tells us which node it is reclaiming from.
+ */
+static inline int
+arc_shrinker_node(struct shrink_control *sc)
+{
+#if SHRINKER_NUMA_AWARE
+	if (arc_nnodes > 1)
+		return (sc->nid);
+#endif
+	return (-1);
+}
+
 /*
  * The _count() function returns the number of free-able objects.
  * The _scan() function returns the number of objects that were freed.
@@ -206,7 +220,11 @@ arc_shrinker_count(struct shrinker *shrink, struct shrink_control *sc)
 	 */
 	int64_t limit = zfs_arc_shrinker_limit != 0 ?
 	    zfs_arc_shrinker_limit : INT64_MAX;
-	return (MIN(limit, btop((int64_t)arc_evictable_memory())));
+	int64_t evictable = arc_evictable_memory();
+	int node = arc_shrinker_node(sc);
+	if (node >= 0)
+		evictable = MIN(evictable, arc_node_evictable(node));
+	return (MIN(limit, btop(evictable)));
 }
 
 static unsigned long
@@ -220,10 +238,19 @@ arc_shrinker_scan(struct shrinker *shrink, struct shrink_control *sc)
 
 	/*
 	 * Evict the requested number of pages by reducing arc_c and waiting
-	 * for the requested amount of data to be evicted.
+	 * for the requested amount of data to be evicted. If the kernel is
+	 * reclaiming a particular node, first evict that node's buffers
+	 * directly, since freeing memory elsewhere wouldn't help it, and
+	 * only wait for whatever that fell short of.
 	 */
-	arc_reduce_target_size(ptob(sc->nr_to_scan));
-	arc_wait_for_eviction(ptob(sc->nr_to_scan), B_FALSE);
+	uint64_t bytes = ptob(sc->nr_to_scan);
+	uint64_t evicted = 0;
+	int node = arc_shrinker_node(sc);
+	if (node >= 0)
+		evicted = arc_evict_node(node, bytes);
+	arc_reduce_target_size(bytes);
+	if (evicted < bytes)
+		arc_wait_for_eviction(bytes - evicted, B_FALSE);
 	if (current->reclaim_state != NULL)
 #ifdef	HAVE_RECLAIM_STATE_RECLAIMED
 		current->reclaim_state->reclaimed += sc->nr_to_scan;
@@ -356,8 +383,9 @@ arc_lowmem_init(void)
 	 * reclaim from the arc.  This is done to prevent kswapd from
 	 * swapping out pages when it is preferable to shrink the arc.
 	 */
-	arc_shrinker = spl_register_shrinker("zfs-arc-shrinker",
-	    arc_shrinker_count, arc_shrinker_scan, DEFAULT_SEEKS);
+	arc_shrinker = spl_register_shrinker_flags("zfs-arc-shrinker",
+	    arc_shrinker_count, arc_shrinker_scan, DEFAULT_SEEKS,
+	    arc_nnodes > 1 ? SHRINKER_NUMA_AWARE : 0);
 	VERIFY(arc_shrinker);
 
 	arc_set_sys_free(allmem);
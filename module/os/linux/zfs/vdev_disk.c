@@ -437,6 +437,10 @@ vdev_disk_open(vdev_t *v, uint64_t *psize, uint64_t *max_psize,
 
 	/* Set when device reports it supports TRIM. */
 	v->vdev_has_trim = bdev_discard_supported(bdev);
+	if (v->vdev_has_trim) {
+		v->vdev_trim_granularity = bdev_discard_granularity_bytes(bdev);
+		v->vdev_trim_max_bytes = bdev_max_discard_bytes(bdev);
+	}
 
 	/* Set when device reports it supports secure TRIM. */
 	v->vdev_has_securetrim = bdev_secure_discard_supported(bdev);
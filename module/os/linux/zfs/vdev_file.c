@@ -225,6 +225,21 @@ vdev_file_io_strategy(void *arg)
 	zio_delay_interrupt(zio);
 }
 
+#ifndef _KERNEL
+static void
+vdev_file_io_async_done(void *arg, void *buf, int err, ssize_t resid)
+{
+	zio_t *zio = arg;
+
+	abd_return_buf_copy(zio->io_abd, buf, zio->io_size);
+	zio->io_error = err;
+	if (resid != 0 && zio->io_error == 0)
+		zio->io_error = SET_ERROR(ENOSPC);
+
+	zio_delay_interrupt(zio);
+}
+#endif
+
 static void
 vdev_file_io_fsync(void *arg)
 {
@@ -288,6 +303,19 @@ vdev_file_io_start(zio_t *zio)
 
 	zio->io_target_timestamp = zio_handle_io_delay(zio);
 
+#ifndef _KERNEL
+	/*
+	 * In userspace reads may be queued directly, rather than handing
+	 * them to a taskq thread which blocks in pread().
+	 */
+	if (zio->io_type == ZIO_TYPE_READ && zfs_file_async(vf->vf_file)) {
+		zfs_file_pread_async(vf->vf_file,
+		    abd_borrow_buf(zio->io_abd, zio->io_size), zio->io_size,
+		    zio->io_offset, vdev_file_io_async_done, zio);
+		return;
+	}
+#endif
+
 	VERIFY3U(taskq_dispatch(vdev_file_taskq, vdev_file_io_strategy, zio,
 	    TQ_SLEEP), !=, TASKQID_INVALID);
 }
@@ -374,6 +374,77 @@ zfs_uio_prefaultpages(ssize_t n, zfs_uio_t *uio)
 }
 EXPORT_SYMBOL(zfs_uio_prefaultpages);
 
+/*
+ * Take a reference on each of the pages backing the next n bytes of the
+ * uio, without consuming it, so the data can be handed to the I/O pipeline
+ * in place.  The pages must be laid out as in a scatter ABD: only the first
+ * may start, and only the last may end, part way through a page.  Returns
+ * the number of pages and stores the offset into the first in *offp, or 0
+ * with no references held if the uio can't be referenced this way.
+ */
+int
+zfs_uio_get_pages(zfs_uio_t *uio, size_t n, struct page **pages,
+    int maxpages, size_t *offp)
+{
+#if defined(HAVE_VFS_IOV_ITER) && \
+	(defined(HAVE_IOV_ITER_GET_PAGES2) || defined(HAVE_IOV_ITER_GET_PAGES))
+	struct iov_iter *iter = uio->uio_iter;
+	size_t done = 0;
+	int npages = 0;
+
+	if (uio->uio_segflg != UIO_ITER || uio->uio_skip != 0 ||
+	    n > uio->uio_resid)
+		return (0);
+
+	while (done < n) {
+		size_t start;
+		ssize_t cnt;
+
+#if defined(HAVE_IOV_ITER_GET_PAGES2)
+		cnt = iov_iter_get_pages2(iter, &pages[npages], n - done,
+		    maxpages - npages, &start);
+#else
+		cnt = iov_iter_get_pages(iter, &pages[npages], n - done,
+		    maxpages - npages, &start);
+		if (cnt > 0)
+			iov_iter_advance(iter, cnt);
+#endif
+		if (cnt <= 0)
+			break;
+
+		npages += DIV_ROUND_UP(start + cnt, PAGE_SIZE);
+		done += cnt;
+
+		if (done == (size_t)cnt)
+			*offp = start;
+		else if (start != 0)
+			break;
+		if (done < n && ((start + cnt) & (PAGE_SIZE - 1)) != 0)
+			break;
+	}
+	iov_iter_revert(iter, done);
+
+	if (done != n) {
+		zfs_uio_put_pages(pages, npages);
+		return (0);
+	}
+
+	return (npages);
+#else
+	(void) uio, (void) n, (void) pages, (void) maxpages, (void) offp;
+	return (0);
+#endif
+}
+EXPORT_SYMBOL(zfs_uio_get_pages);
+
+void
+zfs_uio_put_pages(struct page **pages, int npages)
+{
+	for (int i = 0; i < npages; i++)
+		put_page(pages[i]);
+}
+EXPORT_SYMBOL(zfs_uio_put_pages);
+
 /*
  * The same as zfs_uiomove() but doesn't modify uio structure.
  * return in cbytes how many bytes were copied.
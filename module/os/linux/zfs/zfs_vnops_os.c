@@ -340,6 +340,14 @@ mappedread(znode_t *zp, int nbytes, zfs_uio_t *uio)
 
 static unsigned long zfs_delete_blocks = DMU_MAX_DELETEBLKCNT;
 
+/*
+ * Pages faulted in for a mapped file are copies of the file's blocks, and
+ * the page cache keeps them for as long as the mapping is in use.  Unless
+ * disabled, the block is dropped from the ARC once its last page has been
+ * filled, rather than being cached a second time.
+ */
+static int zfs_mmap_uncached = 1;
+
 /*
  * Write the bytes to a file.
  *
@@ -471,6 +479,7 @@ zfs_lookup(znode_t *zdp, char *nm, znode_t **zpp, int flags, cred_t *cr,
 	if ((error = zfs_enter_verify_zp(zfsvfs, zdp, FTAG)) != 0)
 		return (error);
 
+	hrtime_t start = gethrtime();
 	*zpp = NULL;
 
 	if (flags & LOOKUP_XATTR) {
@@ -527,6 +536,8 @@ zfs_lookup(znode_t *zdp, char *nm, znode_t **zpp, int flags, cred_t *cr,
 	if ((error == 0) && (*zpp))
 		zfs_znode_update_vfs(*zpp);
 
+	dataset_kstats_update_lookup_time(&zfsvfs->z_kstat,
+	    gethrtime() - start);
 	zfs_exit(zfsvfs, FTAG);
 	return (error);
 }
@@ -1515,6 +1526,7 @@ zfs_readdir(struct inode *ip, zpl_dir_context_t *ctx, cred_t *cr)
 	zap_attribute_t	zap;
 	int		error;
 	uint8_t		prefetch;
+	uint64_t	pfblk = UINT64_MAX;	/* dnode block prefetched */
 	uint8_t		type;
 	int		done = 0;
 	uint64_t	parent;
@@ -1616,8 +1628,14 @@ zfs_readdir(struct inode *ip, zpl_dir_context_t *ctx, cred_t *cr)
 		if (done)
 			break;
 
-		if (prefetch)
+		/*
+		 * Entries created together are usually allocated in the same
+		 * dnode block, so only prefetch each block once in a row.
+		 */
+		if (prefetch && objnum >> DNODES_PER_BLOCK_SHIFT != pfblk) {
+			pfblk = objnum >> DNODES_PER_BLOCK_SHIFT;
 			dmu_prefetch_dnode(os, objnum, ZIO_PRIORITY_SYNC_READ);
+		}
 
 		/*
 		 * Move to the next entry, fill in the previous offset.
@@ -1630,7 +1648,12 @@ zfs_readdir(struct inode *ip, zpl_dir_context_t *ctx, cred_t *cr)
 		}
 		ctx->pos = offset;
 	}
-	zp->z_zn_prefetch = B_FALSE; /* a lookup will re-enable pre-fetching */
+	/*
+	 * Keep prefetching across calls until the whole directory has been
+	 * read; a lookup will re-enable pre-fetching after that.
+	 */
+	if (error == ENOENT)
+		zp->z_zn_prefetch = B_FALSE;
 
 update:
 	zap_cursor_fini(&zc);
@@ -1666,6 +1689,7 @@ zfs_getattr_fast(zidmap_t *user_ns, struct inode *ip, struct kstat *sp)
 	zfsvfs_t *zfsvfs = ITOZSB(ip);
 	uint32_t blksize;
 	u_longlong_t nblocks;
+	hrtime_t start = gethrtime();
 	int error;
 
 	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
@@ -1708,6 +1732,8 @@ zfs_getattr_fast(zidmap_t *user_ns, struct inode *ip, struct kstat *sp)
 			    dmu_objset_id(zfsvfs->z_os);
 	}
 
+	dataset_kstats_update_getattr_time(&zfsvfs->z_kstat,
+	    gethrtime() - start);
 	zfs_exit(zfsvfs, FTAG);
 
 	return (0);
@@ -4000,15 +4026,25 @@ zfs_fillpage(struct inode *ip, struct page *pp)
 	loff_t i_size = i_size_read(ip);
 	u_offset_t io_off = page_offset(pp);
 	size_t io_len = PAGE_SIZE;
+	uint32_t blksz = ITOZ(ip)->z_blksz;
+	uint32_t flags = DMU_READ_PREFETCH;
 
 	ASSERT3U(io_off, <, i_size);
 
 	if (io_off + io_len > i_size)
 		io_len = i_size - io_off;
 
+	/*
+	 * Only the page which completes a block lets go of it, so that
+	 * faulting in the rest of a large block doesn't read it again.
+	 */
+	if (zfs_mmap_uncached && (io_off + io_len == i_size ||
+	    (blksz != 0 && (io_off + io_len) % blksz == 0)))
+		flags |= DMU_READ_UNCACHED;
+
 	void *va = kmap(pp);
 	int error = dmu_read(zfsvfs->z_os, ITOZ(ip)->z_id, io_off,
-	    io_len, va, DMU_READ_PREFETCH);
+	    io_len, va, flags);
 	if (io_len != PAGE_SIZE)
 		memset((char *)va + io_len, 0, PAGE_SIZE - io_len);
 	kunmap(pp);
@@ -4028,6 +4064,140 @@ zfs_fillpage(struct inode *ip, struct page *pp)
 	return (error);
 }
 
+/*
+ * Fill a run of consecutive pages, all within one block of the file, with
+ * a single hold of the dbufs they cover.
+ */
+static int
+zfs_fillpages(struct inode *ip, struct page **pl, int nr_pages)
+{
+	znode_t *zp = ITOZ(ip);
+	loff_t i_size = i_size_read(ip);
+	u_offset_t io_off = page_offset(pl[0]);
+	size_t io_len = (size_t)nr_pages << PAGE_SHIFT;
+	uint32_t blksz = zp->z_blksz;
+	uint32_t flags = DMU_READ_PREFETCH;
+	dmu_buf_t **dbp = NULL;
+	int numbufs = 0, error;
+
+	ASSERT3U(io_off, <, i_size);
+
+	if (io_off + io_len > i_size)
+		io_len = i_size - io_off;
+
+	/* See zfs_fillpage() */
+	if (zfs_mmap_uncached && (io_off + io_len == i_size ||
+	    (io_off + io_len) % blksz == 0))
+		flags |= DMU_READ_UNCACHED;
+
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)sa_get_db(zp->z_sa_hdl);
+	DB_DNODE_ENTER(db);
+	error = dmu_buf_hold_array_by_dnode(DB_DNODE(db), io_off, io_len,
+	    B_TRUE, FTAG, &numbufs, &dbp, flags);
+	DB_DNODE_EXIT(db);
+
+	for (int i = 0, b = 0; i < nr_pages; i++) {
+		struct page *pp = pl[i];
+		u_offset_t off = page_offset(pp);
+		size_t len = 0;
+
+		if (error) {
+			SetPageError(pp);
+			ClearPageUptodate(pp);
+			continue;
+		}
+
+		if (off < io_off + io_len)
+			len = MIN(PAGE_SIZE, io_off + io_len - off);
+
+		char *va = kmap(pp);
+		for (size_t done = 0; done < len; ) {
+			dmu_buf_t *dbuf = dbp[b];
+			uint64_t bufoff = off + done - dbuf->db_offset;
+
+			if (bufoff >= dbuf->db_size) {
+				b++;
+				continue;
+			}
+
+			size_t tocpy = MIN(dbuf->db_size - bufoff, len - done);
+			memcpy(va + done, (char *)dbuf->db_data + bufoff,
+			    tocpy);
+			done += tocpy;
+		}
+		if (len != PAGE_SIZE)
+			memset(va + len, 0, PAGE_SIZE - len);
+		kunmap(pp);
+
+		ClearPageError(pp);
+		SetPageUptodate(pp);
+	}
+
+	if (dbp != NULL)
+		dmu_buf_rele_array(dbp, numbufs, FTAG);
+
+	/* convert checksum errors into IO errors */
+	if (error == ECKSUM)
+		error = SET_ERROR(EIO);
+
+	return (error);
+}
+
+/*
+ * Fill a batch of locked pages, such as a readahead window, in order of
+ * their index.  Consecutive pages in the same block are read together;
+ * the rest, and files whose only block is not a power of two in size,
+ * fall back to zfs_fillpage() for each page.  Pages are left locked.
+ */
+int
+zfs_getpages(struct inode *ip, struct page **pl, int nr_pages)
+{
+	zfsvfs_t *zfsvfs = ITOZSB(ip);
+	znode_t *zp = ITOZ(ip);
+	int error = 0;
+
+	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
+		return (error);
+
+	loff_t i_size = i_size_read(ip);
+	uint32_t blksz = zp->z_blksz;
+	boolean_t batch = ISP2(blksz) && blksz > PAGE_SIZE;
+
+	for (int i = 0, n; i < nr_pages && error == 0; i += n) {
+		u_offset_t off = page_offset(pl[i]);
+
+		if (off >= i_size) {
+			/* Raced with a truncate, there is no data here. */
+			zero_user(pl[i], 0, PAGE_SIZE);
+			ClearPageError(pl[i]);
+			SetPageUptodate(pl[i]);
+			n = 1;
+			continue;
+		}
+
+		n = 1;
+		while (batch && i + n < nr_pages &&
+		    pl[i + n]->index == pl[i]->index + n &&
+		    page_offset(pl[i + n]) < i_size &&
+		    P2ALIGN_TYPED(page_offset(pl[i + n]), blksz, u_offset_t) ==
+		    P2ALIGN_TYPED(off, blksz, u_offset_t))
+			n++;
+
+		if (n == 1)
+			error = zfs_fillpage(ip, pl[i]);
+		else
+			error = zfs_fillpages(ip, &pl[i], n);
+		if (error == 0) {
+			dataset_kstats_update_read_kstats(&zfsvfs->z_kstat,
+			    (uint64_t)n << PAGE_SHIFT);
+		}
+	}
+
+	zfs_exit(zfsvfs, FTAG);
+
+	return (error);
+}
+
 /*
  * Uses zfs_fillpage to read data from the file and fill the page.
  *
@@ -4245,6 +4415,7 @@ EXPORT_SYMBOL(zfs_inactive);
 EXPORT_SYMBOL(zfs_space);
 EXPORT_SYMBOL(zfs_fid);
 EXPORT_SYMBOL(zfs_getpage);
+EXPORT_SYMBOL(zfs_getpages);
 EXPORT_SYMBOL(zfs_putpage);
 EXPORT_SYMBOL(zfs_dirty_inode);
 EXPORT_SYMBOL(zfs_map);
@@ -4252,4 +4423,8 @@ EXPORT_SYMBOL(zfs_map);
 /* CSTYLED */
 module_param(zfs_delete_blocks, ulong, 0644);
 MODULE_PARM_DESC(zfs_delete_blocks, "Delete files larger than N blocks async");
+
+module_param(zfs_mmap_uncached, int, 0644);
+MODULE_PARM_DESC(zfs_mmap_uncached,
+	"Don't keep blocks read into the page cache in the ARC");
 #endif
@@ -86,7 +86,9 @@ static int zfs_unlink_suspend_progress = 0;
  * This callback is invoked when acquiring a RL_WRITER or RL_APPEND lock on
  * z_rangelock. It will modify the offset and length of the lock to reflect
  * znode-specific information, and convert RL_APPEND to RL_WRITER.  This is
- * called with the rangelock_t's rl_lock held, which avoids races.
+ * called with the rangelock_t's rl_lock held, which avoids races.  Once the
+ * rangelock has been split into segments it is called without it, and then
+ * again with the range locked to check that the result did not change.
  */
 static void
 zfs_rangelock_cb(zfs_locked_range_t *new, void *arg)
@@ -572,6 +574,8 @@ zfs_znode_alloc(zfsvfs_t *zfsvfs, dmu_buf_t *db, int blksz,
 	zp->z_sync_cnt = 0;
 	zp->z_sync_writes_cnt = 0;
 	zp->z_async_writes_cnt = 0;
+	zp->z_append_end = 0;
+	zp->z_append_busy = 0;
 
 	zfs_znode_sa_init(zfsvfs, zp, db, obj_type, hdl);
 
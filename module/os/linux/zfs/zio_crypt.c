@@ -27,6 +27,7 @@
 #include <sys/sha2.h>
 #include <sys/hkdf.h>
 #include <sys/qat.h>
+#include <sys/zio_accel.h>
 
 /*
  * This file is responsible for handling all of the details of generating
@@ -188,6 +189,30 @@
 	(MIN(zfs_key_max_salt_uses, ZFS_KEY_MAX_SALT_USES_DEFAULT))
 static unsigned long zfs_key_max_salt_uses = ZFS_KEY_MAX_SALT_USES_DEFAULT;
 
+/*
+ * Blocks written under any salt but the current one need their encryption
+ * key derived with HKDF, and its key schedule expanded by the ICP, every
+ * time they are read. For small blocks that costs more than the actual
+ * decryption, so each key keeps a few recently derived keys and their
+ * context templates per CPU. A slot is in use for as long as its lock is
+ * held; if the lock is busy we simply derive the key as before.
+ */
+#define	ZIO_CRYPT_KEY_CACHE_SLOTS	4
+
+typedef struct zio_crypt_key_cache_slot {
+	boolean_t zkcs_valid;
+	uint8_t zkcs_salt[ZIO_DATA_SALT_LEN];
+	uint8_t zkcs_keydata[MASTER_KEY_MAX_LEN];
+	crypto_key_t zkcs_key;
+	crypto_ctx_template_t zkcs_tmpl;
+} zio_crypt_key_cache_slot_t;
+
+typedef struct zio_crypt_key_cache {
+	kmutex_t zkc_lock;
+	uint_t zkc_next;
+	zio_crypt_key_cache_slot_t zkc_slots[ZIO_CRYPT_KEY_CACHE_SLOTS];
+} zio_crypt_key_cache_t;
+
 typedef struct blkptr_auth_buf {
 	uint64_t bab_prop;			/* blk_prop - portable mask */
 	uint8_t bab_mac[ZIO_DATA_MAC_LEN];	/* MAC from blk_cksum */
@@ -206,11 +231,120 @@ const zio_crypt_info_t zio_crypt_table[ZIO_CRYPT_FUNCTIONS] = {
 	{SUN_CKM_AES_GCM,	ZC_TYPE_GCM,	32,	"aes-256-gcm"}
 };
 
+static void
+zio_crypt_key_cache_init(zio_crypt_key_t *key)
+{
+	key->zk_cache_count = boot_ncpus;
+	key->zk_cache = kmem_zalloc(key->zk_cache_count *
+	    sizeof (zio_crypt_key_cache_t), KM_SLEEP);
+	for (uint_t i = 0; i < key->zk_cache_count; i++) {
+		mutex_init(&key->zk_cache[i].zkc_lock, NULL, MUTEX_DEFAULT,
+		    NULL);
+	}
+}
+
+static void
+zio_crypt_key_cache_fini(zio_crypt_key_t *key)
+{
+	if (key->zk_cache == NULL)
+		return;
+
+	for (uint_t i = 0; i < key->zk_cache_count; i++) {
+		zio_crypt_key_cache_t *zkc = &key->zk_cache[i];
+
+		for (uint_t s = 0; s < ZIO_CRYPT_KEY_CACHE_SLOTS; s++) {
+			crypto_destroy_ctx_template(
+			    zkc->zkc_slots[s].zkcs_tmpl);
+		}
+		mutex_destroy(&zkc->zkc_lock);
+	}
+
+	/* zero out sensitive data */
+	memset(key->zk_cache, 0,
+	    key->zk_cache_count * sizeof (zio_crypt_key_cache_t));
+	kmem_free(key->zk_cache,
+	    key->zk_cache_count * sizeof (zio_crypt_key_cache_t));
+	key->zk_cache = NULL;
+}
+
+/*
+ * Look up the key for the given salt in this CPU's cache, deriving it into
+ * the next slot if it isn't there. On success the cache is returned locked
+ * and must be released with zio_crypt_key_cache_exit() once the caller is
+ * done with the key and template. Returns NULL if the cache is busy or the
+ * key could not be derived.
+ */
+static zio_crypt_key_cache_t *
+zio_crypt_key_cache_enter(zio_crypt_key_t *key, uint8_t *salt,
+    crypto_key_t **ckeyp, crypto_ctx_template_t *tmplp)
+{
+	zio_crypt_key_cache_t *zkc;
+	zio_crypt_key_cache_slot_t *zkcs;
+	crypto_mechanism_t mech = {0};
+	const zio_crypt_info_t *ci = &zio_crypt_table[key->zk_crypt];
+	uint_t keydata_len = ci->ci_keylen;
+	int ret;
+
+	if (key->zk_cache == NULL)
+		return (NULL);
+
+	zkc = &key->zk_cache[CPU_SEQID_UNSTABLE % key->zk_cache_count];
+	if (!mutex_tryenter(&zkc->zkc_lock))
+		return (NULL);
+
+	for (uint_t s = 0; s < ZIO_CRYPT_KEY_CACHE_SLOTS; s++) {
+		zkcs = &zkc->zkc_slots[s];
+		if (zkcs->zkcs_valid &&
+		    memcmp(zkcs->zkcs_salt, salt, ZIO_DATA_SALT_LEN) == 0)
+			goto out;
+	}
+
+	zkcs = &zkc->zkc_slots[zkc->zkc_next];
+	zkc->zkc_next = (zkc->zkc_next + 1) % ZIO_CRYPT_KEY_CACHE_SLOTS;
+
+	zkcs->zkcs_valid = B_FALSE;
+	crypto_destroy_ctx_template(zkcs->zkcs_tmpl);
+	zkcs->zkcs_tmpl = NULL;
+
+	ret = hkdf_sha512(key->zk_master_keydata, keydata_len, NULL, 0,
+	    salt, ZIO_DATA_SALT_LEN, zkcs->zkcs_keydata, keydata_len);
+	if (ret != 0) {
+		mutex_exit(&zkc->zkc_lock);
+		return (NULL);
+	}
+
+	memcpy(zkcs->zkcs_salt, salt, ZIO_DATA_SALT_LEN);
+	zkcs->zkcs_key.ck_data = zkcs->zkcs_keydata;
+	zkcs->zkcs_key.ck_length = CRYPTO_BYTES2BITS(keydata_len);
+
+	/* as with the current key, the template is just an optimization */
+	mech.cm_type = crypto_mech2id(ci->ci_mechname);
+	ret = crypto_create_ctx_template(&mech, &zkcs->zkcs_key,
+	    &zkcs->zkcs_tmpl);
+	if (ret != CRYPTO_SUCCESS)
+		zkcs->zkcs_tmpl = NULL;
+
+	zkcs->zkcs_valid = B_TRUE;
+
+out:
+	*ckeyp = &zkcs->zkcs_key;
+	*tmplp = zkcs->zkcs_tmpl;
+	return (zkc);
+}
+
+static void
+zio_crypt_key_cache_exit(zio_crypt_key_cache_t *zkc)
+{
+	mutex_exit(&zkc->zkc_lock);
+}
+
 void
 zio_crypt_key_destroy(zio_crypt_key_t *key)
 {
 	rw_destroy(&key->zk_salt_lock);
 
+	zio_crypt_key_cache_fini(key);
+
 	/* free crypto templates */
 	crypto_destroy_ctx_template(key->zk_current_tmpl);
 	crypto_destroy_ctx_template(key->zk_hmac_tmpl);
@@ -301,6 +435,8 @@ zio_crypt_key_init(uint64_t crypt, zio_crypt_key_t *key)
 	key->zk_version = ZIO_CRYPT_KEY_CURRENT_VERSION;
 	key->zk_salt_count = 0;
 
+	zio_crypt_key_cache_init(key);
+
 	return (0);
 
 error:
@@ -649,6 +785,8 @@ zio_crypt_key_unwrap(crypto_key_t *cwkey, uint64_t crypt, uint64_t version,
 	key->zk_guid = guid;
 	key->zk_salt_count = 0;
 
+	zio_crypt_key_cache_init(key);
+
 	return (0);
 
 error:
@@ -1847,6 +1985,77 @@ error:
 	return (ret);
 }
 
+typedef struct zio_crypt_abd_iov {
+	iovec_t	*zai_iov;
+	uint_t	zai_cnt;
+} zio_crypt_abd_iov_t;
+
+static int
+zio_crypt_abd_iov_cb(void *buf, size_t len, void *priv)
+{
+	zio_crypt_abd_iov_t *zai = priv;
+
+	if (zai->zai_iov != NULL) {
+		zai->zai_iov[zai->zai_cnt].iov_base = buf;
+		zai->zai_iov[zai->zai_cnt].iov_len = len;
+	}
+	zai->zai_cnt++;
+
+	return (0);
+}
+
+/*
+ * Allocate iovecs pointing straight at the chunks of an abd, followed by
+ * nr_extra iovecs for the caller to fill in. The chunk addresses are used
+ * after abd_iterate_func() has unmapped them again, so this must only be
+ * used when all abd pages are permanently mapped.
+ */
+static iovec_t *
+zio_crypt_abd_to_iovecs(abd_t *abd, uint_t datalen, uint_t nr_extra,
+    uint_t *nr_iovecs)
+{
+	zio_crypt_abd_iov_t zai = { NULL, 0 };
+
+	(void) abd_iterate_func(abd, 0, datalen, zio_crypt_abd_iov_cb, &zai);
+	*nr_iovecs = zai.zai_cnt + nr_extra;
+
+	zai.zai_iov = kmem_alloc(*nr_iovecs * sizeof (iovec_t), KM_SLEEP);
+	zai.zai_cnt = 0;
+	(void) abd_iterate_func(abd, 0, datalen, zio_crypt_abd_iov_cb, &zai);
+	ASSERT3U(zai.zai_cnt + nr_extra, ==, *nr_iovecs);
+
+	return (zai.zai_iov);
+}
+
+/*
+ * The abd counterpart of zio_crypt_init_uios_normal(). The uios reference
+ * the abd chunks directly, which saves copying scattered data into and out
+ * of a linear buffer around the encryption.
+ */
+static int
+zio_crypt_init_uios_abd(abd_t *pabd, abd_t *cabd, uint_t datalen,
+    uint8_t *mac, zfs_uio_t *puio, zfs_uio_t *cuio, uint_t *enc_len)
+{
+	uint_t nr_plain, nr_cipher;
+	iovec_t *mac_iov;
+
+	puio->uio_iov = zio_crypt_abd_to_iovecs(pabd, datalen, 0, &nr_plain);
+	puio->uio_iovcnt = nr_plain;
+	cuio->uio_iov = zio_crypt_abd_to_iovecs(cabd, datalen, 1, &nr_cipher);
+	cuio->uio_iovcnt = nr_cipher;
+
+	puio->uio_segflg = UIO_SYSSPACE;
+	cuio->uio_segflg = UIO_SYSSPACE;
+
+	mac_iov = ((iovec_t *)&cuio->uio_iov[cuio->uio_iovcnt - 1]);
+	mac_iov->iov_base = mac;
+	mac_iov->iov_len = ZIO_DATA_MAC_LEN;
+
+	*enc_len = datalen;
+
+	return (0);
+}
+
 /*
  * This function builds up the plaintext (puio) and ciphertext (cuio) uios so
  * that they can be used for encryption and decryption by zio_do_crypt_uio().
@@ -1905,13 +2114,15 @@ error:
 }
 
 /*
- * Primary encryption / decryption entrypoint for zio data.
+ * Common implementation of zio_do_crypt_data() and zio_do_crypt_abd().
+ * Either plainbuf and cipherbuf are linear buffers, or pabd and cabd are
+ * abds of a normal object type that are encrypted in place in software.
  */
-int
-zio_do_crypt_data(boolean_t encrypt, zio_crypt_key_t *key,
+static int
+zio_do_crypt_impl(boolean_t encrypt, zio_crypt_key_t *key,
     dmu_object_type_t ot, boolean_t byteswap, uint8_t *salt, uint8_t *iv,
     uint8_t *mac, uint_t datalen, uint8_t *plainbuf, uint8_t *cipherbuf,
-    boolean_t *no_crypt)
+    abd_t *pabd, abd_t *cabd, boolean_t *no_crypt)
 {
 	int ret;
 	boolean_t locked = B_FALSE;
@@ -1922,6 +2133,7 @@ zio_do_crypt_data(boolean_t encrypt, zio_crypt_key_t *key,
 	uint8_t enc_keydata[MASTER_KEY_MAX_LEN];
 	crypto_key_t tmp_ckey, *ckey = NULL;
 	crypto_ctx_template_t tmpl;
+	zio_crypt_key_cache_t *zkc = NULL;
 	uint8_t *authbuf = NULL;
 
 	memset(&puio, 0, sizeof (puio));
@@ -1929,9 +2141,10 @@ zio_do_crypt_data(boolean_t encrypt, zio_crypt_key_t *key,
 
 	/*
 	 * If the needed key is the current one, just use it. Otherwise we
-	 * need to generate a temporary one from the given salt + master key.
-	 * If we are encrypting, we must return a copy of the current salt
-	 * so that it can be stored in the blkptr_t.
+	 * look for it in the key cache, and failing that generate a temporary
+	 * one from the given salt + master key. If we are encrypting, we must
+	 * return a copy of the current salt so that it can be stored in the
+	 * blkptr_t.
 	 */
 	rw_enter(&key->zk_salt_lock, RW_READER);
 	locked = B_TRUE;
@@ -1943,6 +2156,10 @@ zio_do_crypt_data(boolean_t encrypt, zio_crypt_key_t *key,
 		rw_exit(&key->zk_salt_lock);
 		locked = B_FALSE;
 
+		zkc = zio_crypt_key_cache_enter(key, salt, &ckey, &tmpl);
+	}
+
+	if (ckey == NULL) {
 		ret = hkdf_sha512(key->zk_master_keydata, keydata_len, NULL, 0,
 		    salt, ZIO_DATA_SALT_LEN, enc_keydata, keydata_len);
 		if (ret != 0)
@@ -1956,13 +2173,12 @@ zio_do_crypt_data(boolean_t encrypt, zio_crypt_key_t *key,
 	}
 
 	/*
-	 * Attempt to use QAT acceleration if we can. We currently don't
+	 * Attempt to use hardware acceleration if we can. We currently don't
 	 * do this for metadnode and ZIL blocks, since they have a much
-	 * more involved buffer layout and the qat_crypt() function only
-	 * works in-place.
+	 * more involved buffer layout and the offload providers only
+	 * handle a single contiguous buffer.
 	 */
-	if (qat_crypt_use_accel(datalen) &&
-	    ot != DMU_OT_INTENT_LOG && ot != DMU_OT_DNODE) {
+	if (pabd == NULL && ot != DMU_OT_INTENT_LOG && ot != DMU_OT_DNODE) {
 		uint8_t *srcbuf, *dstbuf;
 
 		if (encrypt) {
@@ -1973,13 +2189,24 @@ zio_do_crypt_data(boolean_t encrypt, zio_crypt_key_t *key,
 			dstbuf = plainbuf;
 		}
 
-		ret = qat_crypt((encrypt) ? QAT_ENCRYPT : QAT_DECRYPT, srcbuf,
-		    dstbuf, NULL, 0, iv, mac, ckey, key->zk_crypt, datalen);
-		if (ret == CPA_STATUS_SUCCESS) {
+		if (qat_crypt_use_accel(datalen) &&
+		    qat_crypt((encrypt) ? QAT_ENCRYPT : QAT_DECRYPT, srcbuf,
+		    dstbuf, NULL, 0, iv, mac, ckey, key->zk_crypt,
+		    datalen) == CPA_STATUS_SUCCESS)
+			ret = 0;
+		else
+			ret = zio_accel_crypt(encrypt, key->zk_crypt, srcbuf,
+			    dstbuf, iv, mac, ckey, datalen);
+
+		if (ret == 0) {
 			if (locked) {
 				rw_exit(&key->zk_salt_lock);
 				locked = B_FALSE;
 			}
+			if (zkc != NULL)
+				zio_crypt_key_cache_exit(zkc);
+			if (ckey == &tmp_ckey)
+				memset(enc_keydata, 0, keydata_len);
 
 			return (0);
 		}
@@ -1987,9 +2214,16 @@ zio_do_crypt_data(boolean_t encrypt, zio_crypt_key_t *key,
 	}
 
 	/* create uios for encryption */
-	ret = zio_crypt_init_uios(encrypt, key->zk_version, ot, plainbuf,
-	    cipherbuf, datalen, byteswap, mac, &puio, &cuio, &enc_len,
-	    &authbuf, &auth_len, no_crypt);
+	if (pabd != NULL) {
+		ret = zio_crypt_init_uios_abd(pabd, cabd, datalen, mac,
+		    &puio, &cuio, &enc_len);
+		auth_len = 0;
+		*no_crypt = B_FALSE;
+	} else {
+		ret = zio_crypt_init_uios(encrypt, key->zk_version, ot,
+		    plainbuf, cipherbuf, datalen, byteswap, mac, &puio, &cuio,
+		    &enc_len, &authbuf, &auth_len, no_crypt);
+	}
 	if (ret != 0)
 		goto error;
 
@@ -2002,6 +2236,8 @@ zio_do_crypt_data(boolean_t encrypt, zio_crypt_key_t *key,
 	if (locked) {
 		rw_exit(&key->zk_salt_lock);
 	}
+	if (zkc != NULL)
+		zio_crypt_key_cache_exit(zkc);
 
 	if (authbuf != NULL)
 		zio_buf_free(authbuf, datalen);
@@ -2015,6 +2251,8 @@ zio_do_crypt_data(boolean_t encrypt, zio_crypt_key_t *key,
 error:
 	if (locked)
 		rw_exit(&key->zk_salt_lock);
+	if (zkc != NULL)
+		zio_crypt_key_cache_exit(zkc);
 	if (authbuf != NULL)
 		zio_buf_free(authbuf, datalen);
 	if (ckey == &tmp_ckey)
@@ -2026,8 +2264,45 @@ error:
 }
 
 /*
- * Simple wrapper around zio_do_crypt_data() to work with abd's instead of
- * linear buffers.
+ * Primary encryption / decryption entrypoint for zio data.
+ */
+int
+zio_do_crypt_data(boolean_t encrypt, zio_crypt_key_t *key,
+    dmu_object_type_t ot, boolean_t byteswap, uint8_t *salt, uint8_t *iv,
+    uint8_t *mac, uint_t datalen, uint8_t *plainbuf, uint8_t *cipherbuf,
+    boolean_t *no_crypt)
+{
+	return (zio_do_crypt_impl(encrypt, key, ot, byteswap, salt, iv, mac,
+	    datalen, plainbuf, cipherbuf, NULL, NULL, no_crypt));
+}
+
+/*
+ * Whether zio_do_crypt_abd() can hand the abds to the ICP as they are.
+ * This is only worth it if one of them is scattered, and only possible for
+ * object types encrypted as a single run of data, when no offload provider
+ * wants a linear buffer, and when the abd pages never need a temporary
+ * mapping.
+ */
+static boolean_t
+zio_crypt_abd_direct(dmu_object_type_t ot, uint_t datalen, abd_t *pabd,
+    abd_t *cabd)
+{
+#if defined(_KERNEL) && defined(CONFIG_HIGHMEM)
+	(void) ot, (void) datalen, (void) pabd, (void) cabd;
+	return (B_FALSE);
+#else
+	if (abd_is_linear(pabd) && abd_is_linear(cabd))
+		return (B_FALSE);
+	if (ot == DMU_OT_INTENT_LOG || ot == DMU_OT_DNODE)
+		return (B_FALSE);
+	return (!qat_crypt_use_accel(datalen) && !zio_accel_enabled());
+#endif
+}
+
+/*
+ * Wrapper around zio_do_crypt_data() to work with abd's instead of linear
+ * buffers. Scattered abds are encrypted in place where possible, otherwise
+ * they are copied through linear buffers.
  */
 int
 zio_do_crypt_abd(boolean_t encrypt, zio_crypt_key_t *key, dmu_object_type_t ot,
@@ -2037,6 +2312,11 @@ zio_do_crypt_abd(boolean_t encrypt, zio_crypt_key_t *key, dmu_object_type_t ot,
 	int ret;
 	void *ptmp, *ctmp;
 
+	if (zio_crypt_abd_direct(ot, datalen, pabd, cabd)) {
+		return (zio_do_crypt_impl(encrypt, key, ot, byteswap, salt,
+		    iv, mac, datalen, NULL, NULL, pabd, cabd, no_crypt));
+	}
+
 	if (encrypt) {
 		ptmp = abd_borrow_buf_copy(pabd, datalen);
 		ctmp = abd_borrow_buf(cabd, datalen);
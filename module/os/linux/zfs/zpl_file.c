@@ -34,6 +34,7 @@
 #include <sys/zfs_vfsops.h>
 #include <sys/zfs_vnops.h>
 #include <sys/zfs_project.h>
+#include <sys/zfs_quota.h>
 #if defined(HAVE_VFS_SET_PAGE_DIRTY_NOBUFFERS) || \
     defined(HAVE_VFS_FILEMAP_DIRTY_FOLIO)
 #include <linux/pagemap.h>
@@ -699,18 +700,37 @@ zpl_readpages(struct file *filp, struct address_space *mapping,
 	return (read_cache_pages(mapping, pages, zpl_readpage_filler, NULL));
 }
 #else
+/*
+ * Pages are taken from the readahead window in batches, so that each
+ * block they cover is only held and copied from once.
+ */
+#define	ZPL_READAHEAD_BATCH	32
+
 static void
 zpl_readahead(struct readahead_control *ractl)
 {
-	struct page *page;
+	struct inode *ip = ractl->mapping->host;
+	struct page *pl[ZPL_READAHEAD_BATCH];
+	fstrans_cookie_t cookie;
+	int error = 0;
 
-	while ((page = readahead_page(ractl)) != NULL) {
-		int ret;
+	while (error == 0) {
+		int nr_pages = 0;
 
-		ret = zpl_readpage_filler(NULL, page);
-		put_page(page);
-		if (ret)
+		while (nr_pages < ZPL_READAHEAD_BATCH &&
+		    (pl[nr_pages] = readahead_page(ractl)) != NULL)
+			nr_pages++;
+		if (nr_pages == 0)
 			break;
+
+		cookie = spl_fstrans_mark();
+		error = -zfs_getpages(ip, pl, nr_pages);
+		spl_fstrans_unmark(cookie);
+
+		for (int i = 0; i < nr_pages; i++) {
+			unlock_page(pl[i]);
+			put_page(pl[i]);
+		}
 	}
 }
 #endif
@@ -868,6 +888,8 @@ zpl_fallocate_common(struct inode *ip, int mode, loff_t offset, loff_t len)
 		error = -zfs_space(ITOZ(ip), F_FREESP, &bf, O_RDWR, offset, cr);
 	} else if ((mode & ~FALLOC_FL_KEEP_SIZE) == 0) {
 		unsigned int percent = zfs_fallocate_reserve_percent;
+		zfsvfs_t *zfsvfs = ITOZSB(ip);
+		znode_t *zp = ITOZ(ip);
 		struct kstatfs statfs;
 
 		/* Legacy mode, disable fallocate compatibility. */
@@ -893,8 +915,44 @@ zpl_fallocate_common(struct inode *ip, int mode, loff_t offset, loff_t len)
 			error = -ENOSPC;
 			goto out_unmark;
 		}
-		if (!(mode & FALLOC_FL_KEEP_SIZE) && offset + len > olen)
-			error = zfs_freesp(ITOZ(ip), offset + len, 0, 0, FALSE);
+
+		/*
+		 * The statfs check above only covers the project quota, if
+		 * any.  Also hold the request against the user and group
+		 * quotas of the file's owner, so that a database which
+		 * preallocates its files finds out about an exhausted quota
+		 * now rather than halfway through filling them.
+		 */
+		if ((error = zpl_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
+			goto out_unmark;
+		uint64_t need = (uint64_t)len / 100 * percent;
+		if (zfs_id_overblockquota_len(zfsvfs, DMU_USERUSED_OBJECT,
+		    KUID_TO_SUID(ZTOUID(zp)), need) ||
+		    zfs_id_overblockquota_len(zfsvfs, DMU_GROUPUSED_OBJECT,
+		    KGID_TO_SGID(ZTOGID(zp)), need))
+			error = -EDQUOT;
+		zpl_exit(zfsvfs, FTAG);
+		if (error)
+			goto out_unmark;
+
+		/*
+		 * Extend the file through zfs_space() so that the new size
+		 * is logged to the ZIL and survives a crash once the caller
+		 * fsyncs, as it would after writing zeros.  The new range is
+		 * left as a hole, which reads back as zeros at no cost.
+		 */
+		if (!(mode & FALLOC_FL_KEEP_SIZE) && offset + len > olen) {
+			flock64_t bf;
+
+			bf.l_type = F_WRLCK;
+			bf.l_whence = SEEK_SET;
+			bf.l_start = offset + len;
+			bf.l_len = 0;
+			bf.l_pid = 0;
+
+			error = -zfs_space(zp, F_FREESP, &bf, O_RDWR,
+			    offset, cr);
+		}
 	}
 out_unmark:
 	spl_fstrans_unmark(cookie);
@@ -958,8 +1016,24 @@ zpl_fadvise(struct file *filp, loff_t offset, loff_t len, int advice)
 		dmu_prefetch(os, zp->z_id, 0, offset, len,
 		    ZIO_PRIORITY_ASYNC_READ);
 		break;
-	case POSIX_FADV_NORMAL:
 	case POSIX_FADV_RANDOM:
+		/*
+		 * The speculative prefetcher can't help random reads, and
+		 * each of them may have to read its missing indirect blocks
+		 * one level at a time.  Prefetch the indirect blocks for the
+		 * range instead, so that later random reads need only one
+		 * I/O for the data.  dmu_prefetch_max limits this the same
+		 * way, continuing at higher levels for large files.
+		 */
+		if (len == 0)
+			len = i_size_read(ip) - offset;
+
+		if (len > 0) {
+			dmu_prefetch(os, zp->z_id, 1, offset, len,
+			    ZIO_PRIORITY_ASYNC_READ);
+		}
+		break;
+	case POSIX_FADV_NORMAL:
 	case POSIX_FADV_DONTNEED:
 	case POSIX_FADV_NOREUSE:
 		/* ignored for now */
@@ -1234,6 +1308,90 @@ zpl_ioctl_setdosflags(struct file *filp, void __user *arg)
 	return (err);
 }
 
+/*
+ * Fsync a batch of files with a single ZIL commit.  Each file's dirty
+ * pages are written back first, exactly as zpl_fsync() does, and only
+ * the log commit is shared.
+ */
+static int
+zpl_ioctl_fsync_fds(struct file *filp, void __user *arg)
+{
+	struct super_block *sb = file_inode(filp)->i_sb;
+	zfsvfs_t *zfsvfs = ITOZSB(file_inode(filp));
+	zfs_fsync_fds_t zff;
+	cred_t *cr = CRED();
+	fstrans_cookie_t cookie;
+	int error = 0;
+
+	if (copy_from_user(&zff, arg, sizeof (zff)))
+		return (-EFAULT);
+	if (zff.zff_count == 0)
+		return (0);
+	if (zff.zff_count > ZFS_FSYNC_FDS_MAX)
+		return (-EINVAL);
+
+	uint_t count = zff.zff_count;
+	int32_t *fds = kmem_alloc(count * sizeof (int32_t), KM_SLEEP);
+	struct file **files = kmem_zalloc(count * sizeof (struct file *),
+	    KM_SLEEP);
+	znode_t **zps = kmem_alloc(count * sizeof (znode_t *), KM_SLEEP);
+
+	if (copy_from_user(fds, (void __user *)(uintptr_t)zff.zff_fds,
+	    count * sizeof (int32_t))) {
+		error = -EFAULT;
+		goto out;
+	}
+
+	for (uint_t i = 0; i < count; i++) {
+		if ((files[i] = fget(fds[i])) == NULL) {
+			error = -EBADF;
+			goto out;
+		}
+
+		struct inode *ip = file_inode(files[i]);
+		if (ip->i_sb != sb) {
+			error = -EXDEV;
+			goto out;
+		}
+		zps[i] = ITOZ(ip);
+
+		/*
+		 * See zpl_fsync() for why overlapping non-sync writes are
+		 * committed before waiting for the page cache.
+		 */
+		atomic_inc_32(&zps[i]->z_sync_writes_cnt);
+		if (atomic_load_32(&zps[i]->z_async_writes_cnt) > 0) {
+			if ((error = zpl_enter(zfsvfs, FTAG)) != 0) {
+				atomic_dec_32(&zps[i]->z_sync_writes_cnt);
+				goto out;
+			}
+			zil_commit(zfsvfs->z_log, zps[i]->z_id);
+			zpl_exit(zfsvfs, FTAG);
+		}
+		error = filemap_write_and_wait(ip->i_mapping);
+		atomic_dec_32(&zps[i]->z_sync_writes_cnt);
+		if (error)
+			goto out;
+	}
+
+	crhold(cr);
+	cookie = spl_fstrans_mark();
+	error = -zfs_fsync_many(zps, count, 0, cr);
+	spl_fstrans_unmark(cookie);
+	crfree(cr);
+	ASSERT3S(error, <=, 0);
+out:
+	for (uint_t i = 0; i < count; i++) {
+		if (files[i] != NULL)
+			fput(files[i]);
+	}
+	kmem_free(zps, count * sizeof (znode_t *));
+	kmem_free(files, count * sizeof (struct file *));
+	kmem_free(fds, count * sizeof (int32_t));
+
+	return (error);
+}
+
 static long
 zpl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
@@ -1252,6 +1410,8 @@ zpl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		return (zpl_ioctl_getdosflags(filp, (void *)arg));
 	case ZFS_IOC_SETDOSFLAGS:
 		return (zpl_ioctl_setdosflags(filp, (void *)arg));
+	case ZFS_IOC_FSYNC_FDS:
+		return (zpl_ioctl_fsync_fds(filp, (void *)arg));
 	case ZFS_IOC_COMPAT_FICLONE:
 		return (zpl_ioctl_ficlone(filp, (void *)arg));
 	case ZFS_IOC_COMPAT_FICLONERANGE:
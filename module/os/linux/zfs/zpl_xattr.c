@@ -180,6 +180,32 @@ zpl_xattr_readdir(struct inode *dxip, xattr_filldir_t *xf)
 	return (error);
 }
 
+/*
+ * Most files with xattr=sa never get an xattr directory, yet every xattr
+ * which is not in the SA (e.g. a security label or DOS attribute probe for
+ * an xattr the file doesn't have) would otherwise fall back to a
+ * LOOKUP_XATTR lookup to find out.  Check the SA for the directory's
+ * object number first, which is stable while z_xattr_lock is held.
+ */
+static boolean_t
+zpl_xattr_has_dir(znode_t *zp)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	uint64_t xattr_obj = 0;
+
+	ASSERT(RW_LOCK_HELD(&zp->z_xattr_lock));
+
+	/* Leave the unusual cases to zfs_lookup() */
+	if (zp->z_sa_hdl == NULL || (zp->z_pflags & ZFS_XATTR))
+		return (B_TRUE);
+
+	if (sa_lookup(zp->z_sa_hdl, SA_ZPL_XATTR(zfsvfs), &xattr_obj,
+	    sizeof (xattr_obj)) != 0)
+		return (B_TRUE);
+
+	return (xattr_obj != 0);
+}
+
 static ssize_t
 zpl_xattr_list_dir(xattr_filldir_t *xf, cred_t *cr)
 {
@@ -188,6 +214,9 @@ zpl_xattr_list_dir(xattr_filldir_t *xf, cred_t *cr)
 	znode_t *dxzp;
 	int error;
 
+	if (!zpl_xattr_has_dir(ITOZ(ip)))
+		return (0);
+
 	/* Lookup the xattr directory */
 	error = -zfs_lookup(ITOZ(ip), NULL, &dxzp, LOOKUP_XATTR,
 	    cr, NULL, NULL);
@@ -282,6 +311,9 @@ zpl_xattr_get_dir(struct inode *ip, const char *name, void *value,
 	znode_t *xzp = NULL;
 	int error;
 
+	if (!zpl_xattr_has_dir(ITOZ(ip)))
+		return (-ENOENT);
+
 	/* Lookup the xattr directory */
 	error = -zfs_lookup(ITOZ(ip), NULL, &dxzp, LOOKUP_XATTR,
 	    cr, NULL, NULL);
@@ -55,6 +55,12 @@ static unsigned int zvol_request_sync = 0;
 static unsigned int zvol_prefetch_bytes = (128 * 1024);
 static unsigned long zvol_max_discard_blocks = 16384;
 
+/*
+ * Complete non-FUA discards once they are logged, and free the range
+ * afterwards while still holding the range lock.
+ */
+static unsigned int zvol_discard_async = 0;
+
 /*
  * Switch taskq at multiple of 512 MB offset. This can be set to a lower value
  * to utilize more threads for small files but may affect prefetch hits.
@@ -82,6 +88,16 @@ static boolean_t zvol_use_blk_mq = B_FALSE;
  * read and write tests to a zvol in an NVMe pool (with 16 CPUs).
  */
 static unsigned int zvol_blk_mq_blocks_per_thread = 8;
+
+/*
+ * When set, blk-mq requests are processed directly in the context that
+ * invoked ->queue_rq() (the submitter on direct issue, or the kblockd
+ * worker running the hardware context) instead of being handed off to
+ * the shared zvol taskqs.  This avoids a context switch and a taskq
+ * allocation per request; concurrency then comes from the number of
+ * hardware queues (zvol_blk_mq_threads) and of concurrent submitters.
+ */
+static unsigned int zvol_blk_mq_sync = 0;
 #endif
 
 static unsigned int zvol_num_taskqs = 0;
@@ -184,7 +200,7 @@ static blk_status_t zvol_mq_queue_rq(struct blk_mq_hw_ctx *hctx,
 		return (BLK_STS_IOERR);
 	}
 
-	zvol_request_impl(zv, NULL, rq, 0);
+	zvol_request_impl(zv, NULL, rq, zvol_blk_mq_sync);
 
 	/* Acknowledge to the kernel that we got this request */
 	return (BLK_STS_OK);
@@ -289,6 +305,16 @@ zvol_write(zv_request_t *zvr)
 	zfs_locked_range_t *lr = zfs_rangelock_enter(&zv->zv_rangelock,
 	    uio.uio_loffset, uio.uio_resid, RL_WRITER);
 
+	/*
+	 * Each request is written with one tx per DMU_MAX_ACCESS/2 chunk.
+	 * We deliberately do not hold back small writes to combine them
+	 * with later neighbours: that would add latency to every write,
+	 * and the savings are limited to the tx assignment, since repeated
+	 * writes to the same volblock within a txg already share a single
+	 * dirty record and are written out as one block.  Adjacent bios
+	 * are coalesced before they reach us when zvol_use_blk_mq is set,
+	 * as the block layer merges them into a single request.
+	 */
 	uint64_t volsize = zv->zv_volsize;
 	while (uio.uio_resid > 0 && uio.uio_loffset < volsize) {
 		uint64_t bytes = MIN(uio.uio_resid, DMU_MAX_ACCESS >> 1);
@@ -357,6 +383,7 @@ zvol_discard(zv_request_t *zvr)
 	struct gendisk *disk = zv->zv_zso->zvo_disk;
 	unsigned long start_time = 0;
 	boolean_t acct = B_FALSE;
+	boolean_t acked = B_FALSE;
 
 	ASSERT3P(zv, !=, NULL);
 	ASSERT3U(zv->zv_open_count, >, 0);
@@ -403,11 +430,35 @@ zvol_discard(zv_request_t *zvr)
 	} else {
 		zvol_log_truncate(zv, tx, start, size);
 		dmu_tx_commit(tx);
+
+		/*
+		 * Once the TX_TRUNCATE record has been assigned to a txg the
+		 * discard is ordered with respect to later flushes, and the
+		 * range lock we still hold orders it against later reads and
+		 * writes of the same range.  So unless the caller asked for
+		 * stable storage, it can be completed before the (possibly
+		 * lengthy) free is done.
+		 */
+		if (zvol_discard_async && !sync &&
+		    !io_is_secure_erase(bio, rq)) {
+			if (bio && acct) {
+				blk_generic_end_io_acct(q, disk, WRITE, bio,
+				    start_time);
+			}
+			END_IO(zv, bio, rq, 0);
+			acked = B_TRUE;
+		}
+
 		error = dmu_free_long_range(zv->zv_objset,
 		    ZVOL_OBJ, start, size);
 	}
 	zfs_rangelock_exit(lr);
 
+	if (acked) {
+		rw_exit(&zv->zv_suspend_lock);
+		return;
+	}
+
 	if (error == 0 && sync)
 		zil_commit(zv->zv_zilog, ZVOL_OBJ);
 
@@ -476,6 +527,14 @@ zvol_read(zv_request_t *zvr)
 		if (bytes > volsize - uio.uio_loffset)
 			bytes = volsize - uio.uio_loffset;
 
+		/*
+		 * The data is always copied into the bio's pages.  Those
+		 * pages belong to the submitter (often the guest's memory
+		 * or the page cache) and the bio completes into them, so
+		 * they cannot be swapped for ARC pages.  The ARC buffers
+		 * may also be scatter abds, compressed or encrypted, and
+		 * may be evicted or modified once the dbuf hold is dropped.
+		 */
 		error = dmu_read_uio_dnode(zv->zv_dn, &uio, bytes);
 		if (error) {
 			/* convert checksum errors into IO errors */
@@ -1832,6 +1891,10 @@ MODULE_PARM_DESC(zvol_threads, "Number of threads to handle I/O requests. Set"
 module_param(zvol_request_sync, uint, 0644);
 MODULE_PARM_DESC(zvol_request_sync, "Synchronously handle bio requests");
 
+module_param(zvol_discard_async, uint, 0644);
+MODULE_PARM_DESC(zvol_discard_async,
+    "Complete discards before the range is freed");
+
 module_param(zvol_max_discard_blocks, ulong, 0444);
 MODULE_PARM_DESC(zvol_max_discard_blocks, "Max number of blocks to discard");
 
@@ -1854,6 +1917,10 @@ MODULE_PARM_DESC(zvol_use_blk_mq, "Use the blk-mq API for zvols");
 module_param(zvol_blk_mq_blocks_per_thread, uint, 0644);
 MODULE_PARM_DESC(zvol_blk_mq_blocks_per_thread,
     "Process volblocksize blocks per thread");
+
+module_param(zvol_blk_mq_sync, uint, 0644);
+MODULE_PARM_DESC(zvol_blk_mq_sync,
+    "Process blk-mq requests in the submitting context");
 #endif
 
 #ifndef HAVE_BLKDEV_GET_ERESTARTSYS
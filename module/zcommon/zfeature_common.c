@@ -754,6 +754,30 @@ zpool_feature_init(void)
 	    "Support for raidz expansion",
 	    ZFEATURE_FLAG_MOS, ZFEATURE_TYPE_BOOLEAN, NULL, sfeatures);
 
+	zfeature_register(SPA_FEATURE_FAST_DEDUP,
+	    "com.klarasystems:fast_dedup", "fast_dedup",
+	    "Support for advanced deduplication",
+	    ZFEATURE_FLAG_READONLY_COMPAT, ZFEATURE_TYPE_BOOLEAN, NULL,
+	    sfeatures);
+
+	zfeature_register(SPA_FEATURE_DEDUP_FLAT,
+	    "com.klarasystems:dedup_flat", "dedup_flat",
+	    "Compact dedup table entries with a single phys.",
+	    ZFEATURE_FLAG_READONLY_COMPAT, ZFEATURE_TYPE_BOOLEAN, NULL,
+	    sfeatures);
+
+	{
+		static const spa_feature_t brt_filter_deps[] = {
+			SPA_FEATURE_BLOCK_CLONING,
+			SPA_FEATURE_NONE
+		};
+		zfeature_register(SPA_FEATURE_BRT_FILTER,
+		    "org.openzfs:brt_filter", "brt_filter",
+		    "Filter to skip BRT lookups for uncloned blocks.",
+		    ZFEATURE_FLAG_READONLY_COMPAT, ZFEATURE_TYPE_BOOLEAN,
+		    brt_filter_deps, sfeatures);
+	}
+
 	zfs_mod_list_supported_free(sfeatures);
 }
 
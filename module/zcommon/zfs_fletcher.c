@@ -142,8 +142,6 @@
 #include <sys/zfs_context.h>
 #include <zfs_fletcher.h>
 
-#define	FLETCHER_MIN_SIMD_SIZE	64
-
 static void fletcher_4_scalar_init(fletcher_4_ctx_t *ctx);
 static void fletcher_4_scalar_fini(fletcher_4_ctx_t *ctx, zio_cksum_t *zcp);
 static void fletcher_4_scalar_native(fletcher_4_ctx_t *ctx,
@@ -822,11 +820,20 @@ fletcher_4_fini(void)
 
 /* ABD adapters */
 
+/*
+ * The chosen implementation's state is carried in acd_ctx from one ABD chunk
+ * to the next, and the FPU is held from init to fini, so a large scatter ABD
+ * is checksummed as a single SIMD pass. A chunk that isn't a multiple of
+ * FLETCHER_MIN_SIMD_SIZE leaves its tail in acd_carry, to be completed from
+ * the start of the next chunk. Only the final tail of the ABD is checksummed
+ * by the scalar code.
+ */
 static void
 abd_fletcher_4_init(zio_abd_checksum_data_t *cdp)
 {
 	const fletcher_4_ops_t *ops = fletcher_4_impl_get();
 	cdp->acd_private = (void *) ops;
+	cdp->acd_carry_len = 0;
 
 	if (ops->uses_fpu == B_TRUE) {
 		kfpu_begin();
@@ -853,51 +860,66 @@ abd_fletcher_4_fini(zio_abd_checksum_data_t *cdp)
 	if (ops->uses_fpu == B_TRUE) {
 		kfpu_end();
 	}
-}
 
+	if (cdp->acd_carry_len > 0) {
+		ASSERT3U(cdp->acd_carry_len, <, FLETCHER_MIN_SIMD_SIZE);
+		if (cdp->acd_byteorder == ZIO_CHECKSUM_NATIVE)
+			fletcher_4_incremental_native(cdp->acd_carry,
+			    cdp->acd_carry_len, cdp->acd_zcp);
+		else
+			fletcher_4_incremental_byteswap(cdp->acd_carry,
+			    cdp->acd_carry_len, cdp->acd_zcp);
+		cdp->acd_carry_len = 0;
+	}
+}
 
-static void
-abd_fletcher_4_simd2scalar(boolean_t native, void *data, size_t size,
-    zio_abd_checksum_data_t *cdp)
+static inline void
+abd_fletcher_4_compute(zio_abd_checksum_data_t *cdp, const void *data,
+    uint64_t size)
 {
-	zio_cksum_t *zcp = cdp->acd_zcp;
-
-	ASSERT3U(size, <, FLETCHER_MIN_SIMD_SIZE);
-
-	abd_fletcher_4_fini(cdp);
-	cdp->acd_private = (void *)&fletcher_4_scalar_ops;
+	fletcher_4_ops_t *ops = (fletcher_4_ops_t *)cdp->acd_private;
 
-	if (native)
-		fletcher_4_incremental_native(data, size, zcp);
+	if (cdp->acd_byteorder == ZIO_CHECKSUM_NATIVE)
+		ops->compute_native(cdp->acd_ctx, data, size);
 	else
-		fletcher_4_incremental_byteswap(data, size, zcp);
+		ops->compute_byteswap(cdp->acd_ctx, data, size);
 }
 
 static int
 abd_fletcher_4_iter(void *data, size_t size, void *private)
 {
 	zio_abd_checksum_data_t *cdp = (zio_abd_checksum_data_t *)private;
-	fletcher_4_ctx_t *ctx = cdp->acd_ctx;
-	fletcher_4_ops_t *ops = (fletcher_4_ops_t *)cdp->acd_private;
-	boolean_t native = cdp->acd_byteorder == ZIO_CHECKSUM_NATIVE;
-	uint64_t asize = P2ALIGN_TYPED(size, FLETCHER_MIN_SIMD_SIZE, uint64_t);
 
 	ASSERT(IS_P2ALIGNED(size, sizeof (uint32_t)));
 
-	if (asize > 0) {
-		if (native)
-			ops->compute_native(ctx, data, asize);
-		else
-			ops->compute_byteswap(ctx, data, asize);
+	if (cdp->acd_carry_len > 0) {
+		size_t len = MIN(size,
+		    FLETCHER_MIN_SIMD_SIZE - cdp->acd_carry_len);
 
+		memcpy(cdp->acd_carry + cdp->acd_carry_len, data, len);
+		cdp->acd_carry_len += len;
+		size -= len;
+		data = (char *)data + len;
+
+		if (cdp->acd_carry_len < FLETCHER_MIN_SIMD_SIZE)
+			return (0);
+
+		abd_fletcher_4_compute(cdp, cdp->acd_carry,
+		    FLETCHER_MIN_SIMD_SIZE);
+		cdp->acd_carry_len = 0;
+	}
+
+	uint64_t asize = P2ALIGN_TYPED(size, FLETCHER_MIN_SIMD_SIZE, uint64_t);
+	if (asize > 0) {
+		abd_fletcher_4_compute(cdp, data, asize);
 		size -= asize;
 		data = (char *)data + asize;
 	}
 
 	if (size > 0) {
 		ASSERT3U(size, <, FLETCHER_MIN_SIMD_SIZE);
-		/* At this point we have to switch to scalar impl */
-		abd_fletcher_4_simd2scalar(native, data, size, cdp);
+		memcpy(cdp->acd_carry, data, size);
+		cdp->acd_carry_len = size;
 	}
 
 	return (0);
@@ -133,6 +133,7 @@ zfs_prop_init(void)
 		{ "zstd",	ZIO_COMPRESS_ZSTD },
 		{ "zstd-fast",
 		    ZIO_COMPLEVEL_ZSTD(ZIO_ZSTD_LEVEL_FAST_DEFAULT) },
+		{ "auto",	ZIO_COMPLEVEL_ZSTD(ZIO_ZSTD_LEVEL_AUTO) },
 
 		/*
 		 * ZSTD 1-19 are synthetic. We store the compression level in a
@@ -352,6 +353,19 @@ zfs_prop_init(void)
 		{ NULL }
 	};
 
+	static const zprop_index_t cacheadmit_table[] = {
+		{ "all",	ZFS_CACHEADMIT_ALL },
+		{ "frequent",	ZFS_CACHEADMIT_FREQUENT },
+		{ NULL }
+	};
+
+	static const zprop_index_t direct_table[] = {
+		{ "disabled",	ZFS_DIRECT_DISABLED },
+		{ "standard",	ZFS_DIRECT_STANDARD },
+		{ "always",	ZFS_DIRECT_ALWAYS },
+		{ NULL }
+	};
+
 	static const zprop_index_t sync_table[] = {
 		{ "standard",	ZFS_SYNC_STANDARD },
 		{ "always",	ZFS_SYNC_ALWAYS },
@@ -422,7 +436,7 @@ zfs_prop_init(void)
 	zprop_register_index(ZFS_PROP_COMPRESSION, "compression",
 	    ZIO_COMPRESS_DEFAULT, PROP_INHERIT,
 	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
-	    "on | off | lzjb | gzip | gzip-[1-9] | zle | lz4 | "
+	    "on | off | auto | lzjb | gzip | gzip-[1-9] | zle | lz4 | "
 	    "zstd | zstd-[1-19] | "
 	    "zstd-fast | zstd-fast-[1-10,20,30,40,50,60,70,80,90,100,500,1000]",
 	    "COMPRESS", compress_table, sfeatures);
@@ -464,6 +478,14 @@ zfs_prop_init(void)
 	    ZFS_PREFETCH_ALL, PROP_INHERIT,
 	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_SNAPSHOT | ZFS_TYPE_VOLUME,
 	    "none | metadata | all", "PREFETCH", prefetch_table, sfeatures);
+	zprop_register_index(ZFS_PROP_CACHEADMIT, "cacheadmit",
+	    ZFS_CACHEADMIT_ALL, PROP_INHERIT,
+	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_SNAPSHOT | ZFS_TYPE_VOLUME,
+	    "all | frequent", "CACHEADMIT", cacheadmit_table, sfeatures);
+	zprop_register_index(ZFS_PROP_DIRECT, "direct",
+	    ZFS_DIRECT_STANDARD, PROP_INHERIT,
+	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_SNAPSHOT,
+	    "disabled | standard | always", "DIRECT", direct_table, sfeatures);
 	zprop_register_index(ZFS_PROP_LOGBIAS, "logbias", ZFS_LOGBIAS_LATENCY,
 	    PROP_INHERIT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
 	    "latency | throughput", "LOGBIAS", logbias_table, sfeatures);
@@ -651,6 +673,9 @@ zfs_prop_init(void)
 	zprop_register_number(ZFS_PROP_LOGICALUSED, "logicalused", 0,
 	    PROP_READONLY, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME, "<size>",
 	    "LUSED", B_FALSE, sfeatures);
+	zprop_register_number(ZFS_PROP_ARCUSED, "arcused", 0,
+	    PROP_READONLY, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME, "<size>",
+	    "ARCUSED", B_FALSE, sfeatures);
 	zprop_register_number(ZFS_PROP_LOGICALREFERENCED, "logicalreferenced",
 	    0, PROP_READONLY, ZFS_TYPE_DATASET | ZFS_TYPE_BOOKMARK, "<size>",
 	    "LREFER", B_FALSE, sfeatures);
@@ -694,6 +719,12 @@ zfs_prop_init(void)
 	zprop_register_number(ZFS_PROP_SNAPSHOT_LIMIT, "snapshot_limit",
 	    UINT64_MAX, PROP_DEFAULT, ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME,
 	    "<count> | none", "SSLIMIT", B_FALSE, sfeatures);
+	zprop_register_number(ZFS_PROP_ARCMIN, "arcmin", 0, PROP_DEFAULT,
+	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME, "<size> | none", "ARCMIN",
+	    B_FALSE, sfeatures);
+	zprop_register_number(ZFS_PROP_ARCMAX, "arcmax", 0, PROP_DEFAULT,
+	    ZFS_TYPE_FILESYSTEM | ZFS_TYPE_VOLUME, "<size> | none", "ARCMAX",
+	    B_FALSE, sfeatures);
 
 	/* inherit number properties */
 	zprop_register_number(ZFS_PROP_RECORDSIZE, "recordsize",
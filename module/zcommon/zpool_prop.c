@@ -125,6 +125,9 @@ zpool_prop_init(void)
 	zprop_register_number(ZPOOL_PROP_BCLONERATIO, "bcloneratio", 0,
 	    PROP_READONLY, ZFS_TYPE_POOL, "<1.00x or higher if cloned>",
 	    "BCLONE_RATIO", B_FALSE, sfeatures);
+	zprop_register_number(ZPOOL_PROP_DEDUP_TABLE_SIZE, "dedup_table_size",
+	    0, PROP_READONLY, ZFS_TYPE_POOL, "<size>", "DDTSIZE", B_FALSE,
+	    sfeatures);
 
 	/* default number properties */
 	zprop_register_number(ZPOOL_PROP_VERSION, "version", SPA_VERSION,
@@ -133,6 +136,15 @@ zpool_prop_init(void)
 	zprop_register_number(ZPOOL_PROP_ASHIFT, "ashift", 0, PROP_DEFAULT,
 	    ZFS_TYPE_POOL, "<ashift, 9-16, or 0=default>", "ASHIFT", B_FALSE,
 	    sfeatures);
+	zprop_register_number(ZPOOL_PROP_DEDUP_TABLE_QUOTA,
+	    "dedup_table_quota", 0, PROP_DEFAULT, ZFS_TYPE_POOL,
+	    "<size> | none", "DDTQUOTA", B_FALSE, sfeatures);
+	zprop_register_number(ZPOOL_PROP_SCRUB_RATE_LIMIT,
+	    "scrub_rate_limit", 0, PROP_DEFAULT, ZFS_TYPE_POOL,
+	    "<size> | none", "SCRUBRATE", B_FALSE, sfeatures);
+	zprop_register_number(ZPOOL_PROP_SCRUB_LATENCY_TARGET,
+	    "scrub_latency_target", 0, PROP_DEFAULT, ZFS_TYPE_POOL,
+	    "<milliseconds> | none", "SCRUBLAT", B_FALSE, sfeatures);
 
 	/* default index (boolean) properties */
 	zprop_register_index(ZPOOL_PROP_DELEGATION, "delegation", 1,
@@ -312,6 +324,11 @@ vdev_prop_init(void)
 		{ "-",		2},	/* ZPROP_BOOLEAN_NA */
 		{ NULL }
 	};
+	static const zprop_index_t mirror_read_policy_table[] = {
+		{ "queue",	VDEV_MIRROR_READ_QUEUE },
+		{ "latency",	VDEV_MIRROR_READ_LATENCY },
+		{ NULL }
+	};
 
 	struct zfs_mod_supported_features *sfeatures =
 	    zfs_mod_list_supported(ZFS_SYSFS_VDEV_PROPERTIES);
@@ -453,6 +470,16 @@ vdev_prop_init(void)
 	zprop_register_index(VDEV_PROP_FAILFAST, "failfast", B_TRUE,
 	    PROP_DEFAULT, ZFS_TYPE_VDEV, "on | off", "FAILFAST", boolean_table,
 	    sfeatures);
+	zprop_register_index(VDEV_PROP_QUEUE_BYPASS, "queue_bypass", B_FALSE,
+	    PROP_DEFAULT, ZFS_TYPE_VDEV, "on | off", "QUEUE_BYPASS",
+	    boolean_table, sfeatures);
+	zprop_register_index(VDEV_PROP_MIRROR_READ_POLICY,
+	    "mirror_read_policy", VDEV_MIRROR_READ_QUEUE, PROP_DEFAULT,
+	    ZFS_TYPE_VDEV, "queue | latency", "MIRROR_READ",
+	    mirror_read_policy_table, sfeatures);
+	zprop_register_index(VDEV_PROP_NONVOLATILE_CACHE, "nonvolatile_cache",
+	    B_FALSE, PROP_DEFAULT, ZFS_TYPE_VDEV, "on | off", "NV_CACHE",
+	    boolean_table, sfeatures);
 
 	/* hidden properties */
 	zprop_register_hidden(VDEV_PROP_NAME, "name", PROP_TYPE_STRING,
@@ -54,7 +54,8 @@
  * Threads that wish to read from the counter have a slightly more challenging
  * task. It is fast to determine the upper and lower bounds of the aggum; this
  * does not require grabbing any locks. This suffices for cases where an
- * approximation of the aggsum's value is acceptable. However, if one needs to
+ * approximation of the aggsum's value is acceptable, and aggsum_value_approx()
+ * returns one whose error is bounded by the caller. However, if one needs to
  * know whether some specific value is above or below the current value in the
  * aggsum, they invoke aggsum_compare(). This function operates by repeatedly
  * comparing the target value to the upper and lower bounds of the aggsum, and
@@ -125,6 +126,31 @@ aggsum_upper_bound(aggsum_t *as)
 	return (atomic_load_64(&as->as_upper_bound));
 }
 
+/*
+ * Return an approximation of the aggsum's value without taking any locks,
+ * provided the bounds guarantee it to be within maxerr of the value; only
+ * otherwise are the buckets flushed as by aggsum_value().  The midpoint of
+ * the bounds is returned, which is off by at most half the total amount
+ * currently borrowed by the buckets.  This suits frequent readers that feed
+ * heuristics and can tolerate a known error, but not the cost of draining
+ * every bucket (and making every writer borrow again) on each read.
+ */
+uint64_t
+aggsum_value_approx(aggsum_t *as, uint64_t maxerr)
+{
+	int64_t lb = atomic_load_64((volatile uint64_t *)&as->as_lower_bound);
+	uint64_t ub = atomic_load_64(&as->as_upper_bound);
+
+	/*
+	 * The bounds are loaded separately and may be inconsistent with
+	 * each other if a bucket borrowed in between.
+	 */
+	if (lb < 0 || (uint64_t)lb > ub || (ub - lb) / 2 > maxerr)
+		return (aggsum_value(as));
+
+	return (lb + (ub - lb) / 2);
+}
+
 uint64_t
 aggsum_value(aggsum_t *as)
 {
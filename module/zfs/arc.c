@@ -293,6 +293,9 @@
 #include <sys/vdev.h>
 #include <sys/vdev_impl.h>
 #include <sys/dsl_pool.h>
+#include <sys/dsl_synctask.h>
+#include <sys/dmu_tx.h>
+#include <sys/zap.h>
 #include <sys/multilist.h>
 #include <sys/abd.h>
 #include <sys/zil.h>
@@ -365,6 +368,20 @@ static uint_t zfs_arc_eviction_pct = 200;
  */
 static uint_t zfs_arc_evict_batch_limit = 10;
 
+/*
+ * Number of threads arc_evict() may spread eviction of a single state
+ * across, with 0 meaning to pick a number based on the CPU count. A thread
+ * is only used for each ARC_EVICT_TASK_MIN bytes still to be evicted, so
+ * small eviction requests are still handled by the arc_evict thread alone.
+ */
+static uint_t zfs_arc_evict_threads = 0;
+
+/*
+ * Number of recent uses a block from a dataset with cacheadmit=frequent
+ * must have before it is admitted to the ARC. See arc_admit().
+ */
+static uint_t zfs_arc_admit_min_freq = 2;
+
 /* number of seconds before growing cache again */
 uint_t arc_grow_retry = 5;
 
@@ -376,6 +393,13 @@ static const int arc_kmem_cache_reap_retry_ms = 1000;
 /* shift of arc_c for calculating overflow limit in arc_get_data_impl */
 static int zfs_arc_overflow_shift = 8;
 
+/*
+ * log2(fraction of arc_c by which arc_size_approx() may be off).  The ARC
+ * size is read by eviction and reclaim heuristics far more often than it
+ * needs to be exact, and an exact read drains every aggsum bucket.
+ */
+static const uint_t arc_size_approx_shift = 8;
+
 /* log2(fraction of arc to reclaim) */
 uint_t arc_shrink_shift = 7;
 
@@ -446,6 +470,14 @@ int zfs_compressed_arc_enabled = B_TRUE;
  */
 static uint_t zfs_arc_meta_balance = 500;
 
+/*
+ * Maximum weight given to ghost hits on a ghost list that is smaller than
+ * the one it competes with.  Hits on a small ghost list are evidence that
+ * even a little more cache there pays off, so they move the targets faster
+ * (up to this many times); 1 treats hits on all ghost lists alike.
+ */
+static uint_t zfs_arc_ghost_gain_max = 8;
+
 /*
  * Percentage that can be consumed by dnodes of ARC meta buffers.
  */
@@ -494,17 +526,26 @@ arc_stats_t arc_stats = {
 	{ "mfu_hits",			KSTAT_DATA_UINT64 },
 	{ "mfu_ghost_hits",		KSTAT_DATA_UINT64 },
 	{ "uncached_hits",		KSTAT_DATA_UINT64 },
+	{ "admit_rejected",		KSTAT_DATA_UINT64 },
+	{ "dcache_hits",		KSTAT_DATA_UINT64 },
+	{ "dcache_misses",		KSTAT_DATA_UINT64 },
+	{ "dcache_size",		KSTAT_DATA_UINT64 },
+	{ "warm_saved",			KSTAT_DATA_UINT64 },
+	{ "warm_prefetched",		KSTAT_DATA_UINT64 },
 	{ "deleted",			KSTAT_DATA_UINT64 },
 	{ "mutex_miss",			KSTAT_DATA_UINT64 },
 	{ "access_skip",		KSTAT_DATA_UINT64 },
 	{ "evict_skip",			KSTAT_DATA_UINT64 },
 	{ "evict_not_enough",		KSTAT_DATA_UINT64 },
+	{ "evict_parallel",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_cached",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_eligible",		KSTAT_DATA_UINT64 },
 	{ "evict_l2_eligible_mfu",	KSTAT_DATA_UINT64 },
 	{ "evict_l2_eligible_mru",	KSTAT_DATA_UINT64 },
 	{ "evict_l2_ineligible",	KSTAT_DATA_UINT64 },
 	{ "evict_l2_skip",		KSTAT_DATA_UINT64 },
+	{ "evict_tenant_skip",		KSTAT_DATA_UINT64 },
+	{ "evict_tenant_over",		KSTAT_DATA_UINT64 },
 	{ "hash_elements",		KSTAT_DATA_UINT64 },
 	{ "hash_elements_max",		KSTAT_DATA_UINT64 },
 	{ "hash_collisions",		KSTAT_DATA_UINT64 },
@@ -513,6 +554,12 @@ arc_stats_t arc_stats = {
 	{ "meta",			KSTAT_DATA_UINT64 },
 	{ "pd",				KSTAT_DATA_UINT64 },
 	{ "pm",				KSTAT_DATA_UINT64 },
+	{ "meta_gain",			KSTAT_DATA_UINT64 },
+	{ "data_gain",			KSTAT_DATA_UINT64 },
+	{ "mru_data_gain",		KSTAT_DATA_UINT64 },
+	{ "mfu_data_gain",		KSTAT_DATA_UINT64 },
+	{ "mru_meta_gain",		KSTAT_DATA_UINT64 },
+	{ "mfu_meta_gain",		KSTAT_DATA_UINT64 },
 	{ "c",				KSTAT_DATA_UINT64 },
 	{ "c_min",			KSTAT_DATA_UINT64 },
 	{ "c_max",			KSTAT_DATA_UINT64 },
@@ -579,6 +626,8 @@ arc_stats_t arc_stats = {
 	{ "l2_evict_l1cached",		KSTAT_DATA_UINT64 },
 	{ "l2_free_on_write",		KSTAT_DATA_UINT64 },
 	{ "l2_abort_lowmem",		KSTAT_DATA_UINT64 },
+	{ "l2_demote_deferred",	KSTAT_DATA_UINT64 },
+	{ "l2_exclusive_drops",	KSTAT_DATA_UINT64 },
 	{ "l2_cksum_bad",		KSTAT_DATA_UINT64 },
 	{ "l2_io_error",		KSTAT_DATA_UINT64 },
 	{ "l2_size",			KSTAT_DATA_UINT64 },
@@ -624,6 +673,7 @@ arc_stats_t arc_stats = {
 	{ "arc_raw_size",		KSTAT_DATA_UINT64 },
 	{ "cached_only_in_progress",	KSTAT_DATA_UINT64 },
 	{ "abd_chunk_waste_size",	KSTAT_DATA_UINT64 },
+	{ "evict_list_contended",	KSTAT_DATA_UINT64 },
 };
 
 arc_sums_t arc_sums;
@@ -755,18 +805,33 @@ taskq_t *arc_prune_taskq;
  * Hash table routines
  */
 
-#define	BUF_LOCKS 2048
+/*
+ * The hash locks are striped over the table, and every arc_read() hit takes
+ * one, so there are enough of them that concurrent readers rarely meet on
+ * the same lock (BUF_LOCKS_PER_CPU per CPU, within the bounds below), and
+ * each has its own cache line so that neighbouring locks don't bounce.
+ */
+#define	BUF_LOCKS_MIN		2048
+#define	BUF_LOCKS_MAX		65536
+#define	BUF_LOCKS_PER_CPU	256
+
+typedef struct buf_hash_lock {
+	kmutex_t hl_lock;
+} ____cacheline_aligned buf_hash_lock_t;
+
 typedef struct buf_hash_table {
 	uint64_t ht_mask;
 	arc_buf_hdr_t **ht_table;
-	kmutex_t ht_locks[BUF_LOCKS] ____cacheline_aligned;
+	uint64_t ht_lock_mask;
+	buf_hash_lock_t *ht_locks;
 } buf_hash_table_t;
 
 static buf_hash_table_t buf_hash_table;
 
 #define	BUF_HASH_INDEX(spa, dva, birth) \
 	(buf_hash(spa, dva, birth) & buf_hash_table.ht_mask)
-#define	BUF_HASH_LOCK(idx)	(&buf_hash_table.ht_locks[idx & (BUF_LOCKS-1)])
+#define	BUF_HASH_LOCK(idx) \
+	(&buf_hash_table.ht_locks[(idx) & buf_hash_table.ht_lock_mask].hl_lock)
 #define	HDR_LOCK(hdr) \
 	(BUF_HASH_LOCK(BUF_HASH_INDEX(hdr->b_spa, &hdr->b_dva, hdr->b_birth)))
 
@@ -811,7 +876,6 @@ static uint_t l2arc_meta_percent = 33;	/* limit on headers size */
 static list_t L2ARC_dev_list;			/* device list */
 static list_t *l2arc_dev_list;			/* device list pointer */
 static kmutex_t l2arc_dev_mtx;			/* device list mutex */
-static l2arc_dev_t *l2arc_dev_last;		/* last device used */
 static list_t L2ARC_free_on_write;		/* free after write buf list */
 static list_t *l2arc_free_on_write;		/* free after write list ptr */
 static kmutex_t l2arc_free_on_write_mtx;	/* mutex for list */
@@ -827,6 +891,7 @@ typedef struct l2arc_read_callback {
 
 typedef struct l2arc_data_free {
 	/* protected by l2arc_free_on_write_mtx */
+	l2arc_dev_t	*l2df_dev;	/* device being written */
 	abd_t		*l2df_abd;
 	size_t		l2df_size;
 	arc_buf_contents_t l2df_type;
@@ -847,10 +912,6 @@ typedef enum arc_ovf_level {
 	ARC_OVF_SEVERE			/* ARC is severely overflowed. */
 } arc_ovf_level_t;
 
-static kmutex_t l2arc_feed_thr_lock;
-static kcondvar_t l2arc_feed_thr_cv;
-static uint8_t l2arc_thread_exit;
-
 static kmutex_t l2arc_rebuild_thr_lock;
 static kcondvar_t l2arc_rebuild_thr_cv;
 
@@ -881,8 +942,9 @@ static inline void arc_hdr_set_flags(arc_buf_hdr_t *hdr, arc_flags_t flags);
 static inline void arc_hdr_clear_flags(arc_buf_hdr_t *hdr, arc_flags_t flags);
 
 static boolean_t l2arc_write_eligible(uint64_t, arc_buf_hdr_t *);
+static boolean_t l2arc_demote_defer(arc_buf_hdr_t *);
 static void l2arc_read_done(zio_t *);
-static void l2arc_do_free_on_write(void);
+static void l2arc_do_free_on_write(l2arc_dev_t *);
 static void l2arc_hdr_arcstats_update(arc_buf_hdr_t *hdr, boolean_t incr,
     boolean_t state_only);
 
@@ -905,12 +967,47 @@ static void arc_prune_async(uint64_t adjust);
  */
 int l2arc_exclude_special = 0;
 
+/*
+ * l2arc_exclude_ot : A ZFS module parameter, a mask of DMU object types
+ * 		(bit n for dmu_object_type_t n) whose data blocks are not
+ * 		cached in L2ARC. Checked by the dbuf layer, which knows the
+ * 		object type. Only the legacy object types below 64 can be
+ * 		excluded.
+ *
+ * l2arc_admit_min_size, l2arc_admit_max_size : ZFS module parameters that
+ * 		restrict L2ARC caching to buffers whose logical size is in this
+ * 		range. Zero means no limit.
+ *
+ * l2arc_admit_min_hits : A ZFS module parameter that sets how many times a
+ * 		buffer must have been hit in the ARC (including ghost list
+ * 		hits) before it is written to L2ARC, keeping blocks that are
+ * 		read only once off the device.
+ */
+uint64_t l2arc_exclude_ot = 0;
+static uint64_t l2arc_admit_min_size = 0;
+static uint64_t l2arc_admit_max_size = 0;
+static uint_t l2arc_admit_min_hits = 0;
+
 /*
  * l2arc_mfuonly : A ZFS module parameter that controls whether only MFU
  * 		metadata and data are cached from ARC into L2ARC.
  */
 static int l2arc_mfuonly = 0;
 
+/*
+ * l2arc_exclusive : A ZFS module parameter that turns the L2ARC into a
+ * 		victim cache. Instead of copying buffers well ahead of their
+ * 		eviction, the feed only writes the buffers at the very tail of
+ * 		the ARC lists, and arc_evict_hdr() holds back eligible buffers
+ * 		that have not been written yet, so most of them are demoted to
+ * 		the L2ARC as they leave the ARC. When a buffer is read back from
+ * 		the L2ARC its L2ARC copy is dropped, so a block is rarely cached
+ * 		in both. Eviction is held back by at most one feed interval's
+ * 		worth of writes (l2arc_write_max per device).
+ */
+static int l2arc_exclusive = 0;
+static uint64_t l2arc_demote_pending;	/* bytes held back for the feed */
+
 /*
  * L2ARC TRIM
  * l2arc_trim_ahead : A ZFS module parameter that controls how much ahead of
@@ -1131,8 +1228,10 @@ buf_fini(void)
 	kmem_free(buf_hash_table.ht_table,
 	    (buf_hash_table.ht_mask + 1) * sizeof (void *));
 #endif
-	for (int i = 0; i < BUF_LOCKS; i++)
+	for (uint64_t i = 0; i <= buf_hash_table.ht_lock_mask; i++)
 		mutex_destroy(BUF_HASH_LOCK(i));
+	vmem_free(buf_hash_table.ht_locks,
+	    (buf_hash_table.ht_lock_mask + 1) * sizeof (buf_hash_lock_t));
 	kmem_cache_destroy(hdr_full_cache);
 	kmem_cache_destroy(hdr_l2only_cache);
 	kmem_cache_destroy(buf_cache);
@@ -1269,7 +1368,15 @@ retry:
 		for (ct = zfs_crc64_table + i, *ct = i, j = 8; j > 0; j--)
 			*ct = (*ct >> 1) ^ (-(*ct & 1) & ZFS_CRC64_POLY);
 
-	for (i = 0; i < BUF_LOCKS; i++)
+	uint64_t nlocks = BUF_LOCKS_MIN;
+	while (nlocks < (uint64_t)boot_ncpus * BUF_LOCKS_PER_CPU &&
+	    nlocks < BUF_LOCKS_MAX)
+		nlocks <<= 1;
+	nlocks = MIN(nlocks, hsize);
+	buf_hash_table.ht_lock_mask = nlocks - 1;
+	buf_hash_table.ht_locks =
+	    vmem_zalloc(nlocks * sizeof (buf_hash_lock_t), KM_SLEEP);
+	for (i = 0; i < nlocks; i++)
 		mutex_init(BUF_HASH_LOCK(i), NULL, MUTEX_DEFAULT, NULL);
 }
 
@@ -1687,6 +1794,8 @@ arc_buf_try_copy_decompressed_data(arc_buf_t *buf)
 		if (!ARC_BUF_COMPRESSED(from)) {
 			memcpy(buf->b_data, from->b_data, arc_buf_size(buf));
 			copied = B_TRUE;
+			if (from->b_flags & ARC_BUF_FLAG_DCACHE)
+				ARCSTAT_BUMP(arcstat_dcache_hits);
 			break;
 		}
 	}
@@ -1737,7 +1846,8 @@ arc_buf_alloc_l2only(size_t size, arc_buf_contents_t type, l2arc_dev_t *dev,
 
 	hdr->b_l2hdr.b_dev = dev;
 	hdr->b_l2hdr.b_daddr = daddr;
-	hdr->b_l2hdr.b_arcs_state = arcs_state;
+	hdr->b_l2arcs_state = arcs_state;
+	hdr->b_l2hits = 0;
 
 	return (hdr);
 }
@@ -2123,6 +2233,7 @@ arc_buf_fill(arc_buf_t *buf, spa_t *spa, const zbookmark_phys_t *zb,
 			/* Skip byteswapping and checksumming (already done) */
 			return (0);
 		} else {
+			ARCSTAT_BUMP(arcstat_dcache_misses);
 			error = zio_decompress_data(HDR_GET_COMPRESS(hdr),
 			    hdr->b_l1hdr.b_pabd, buf->b_data,
 			    HDR_GET_PSIZE(hdr), HDR_GET_LSIZE(hdr),
@@ -2197,6 +2308,168 @@ arc_untransform(arc_buf_t *buf, spa_t *spa, const zbookmark_phys_t *zb,
  * We account for the space used by the hdr and the arc buf individually
  * so that we can add and remove them from the refcount individually.
  */
+/*
+ * NUMA placement
+ *
+ * ARC data is allocated on the NUMA node of the thread that first reads or
+ * writes it, and its header remembers that node in b_node. The sublists of
+ * each state's multilists are split into one group per node, and a header
+ * is kept in its node's group, so that a node short of memory can evict
+ * just that node's buffers with arc_evict_node(); the Linux shrinker does
+ * that when the kernel reclaims from a particular node. Per-node sizes and
+ * local/remote hit counts are kept in the "arc_numa" kstat.
+ *
+ * With zfs_arc_numa=0, or on a single node system, there is one group and
+ * the ARC behaves as if it didn't know about nodes.
+ */
+#define	ARC_MAX_NODES	64
+
+static int zfs_arc_numa = 1;
+
+uint_t arc_nnodes = 1;
+
+typedef struct arc_node_sums {
+	wmsum_t ans_size;
+	wmsum_t ans_evictable;
+	wmsum_t ans_evicted;
+	wmsum_t ans_local_hits;
+	wmsum_t ans_remote_hits;
+} arc_node_sums_t;
+
+#define	ARC_NODE_STATS	(sizeof (arc_node_sums_t) / sizeof (wmsum_t))
+
+static const char *const arc_node_stat_names[ARC_NODE_STATS] = {
+	"size", "evictable", "evicted", "local_hits", "remote_hits"
+};
+
+static arc_node_sums_t *arc_node_sums;
+static kstat_named_t *arc_node_kstat_data;
+static kstat_t *arc_node_ksp;
+
+static inline uint_t
+arc_node_current(void)
+{
+	return (arc_nnodes > 1 ? MIN(CPU_NODEID, arc_nnodes - 1) : 0);
+}
+
+uint64_t
+arc_node_evictable(int node)
+{
+	if (node < 0 || node >= arc_nnodes)
+		return (0);
+	return (wmsum_value(&arc_node_sums[node].ans_evictable));
+}
+
+/*
+ * Account for b_pabd being set or cleared. The list index depends on
+ * b_node, so it can only follow the data to the local node while the
+ * header isn't on a list; if it is, the data is evictable.
+ */
+static void
+arc_hdr_node_charge(arc_buf_hdr_t *hdr, int64_t size)
+{
+	boolean_t linked = multilist_link_active(&hdr->b_l1hdr.b_arc_node);
+
+	if (size > 0 && !linked)
+		hdr->b_l1hdr.b_node = arc_node_current();
+
+	arc_node_sums_t *ans = &arc_node_sums[hdr->b_l1hdr.b_node];
+	wmsum_add(&ans->ans_size, size);
+	if (linked)
+		wmsum_add(&ans->ans_evictable, size);
+}
+
+static void
+arc_node_hit(arc_buf_hdr_t *hdr)
+{
+	arc_node_sums_t *ans = &arc_node_sums[hdr->b_l1hdr.b_node];
+
+	if (hdr->b_l1hdr.b_node == arc_node_current())
+		wmsum_add(&ans->ans_local_hits, 1);
+	else
+		wmsum_add(&ans->ans_remote_hits, 1);
+}
+
+static int
+arc_node_kstat_update(kstat_t *ksp, int rw)
+{
+	kstat_named_t *kn = ksp->ks_data;
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	for (uint_t n = 0; n < arc_nnodes; n++) {
+		wmsum_t *sums = (wmsum_t *)&arc_node_sums[n];
+		for (int s = 0; s < ARC_NODE_STATS; s++)
+			kn[n * ARC_NODE_STATS + s].value.ui64 =
+			    wmsum_value(&sums[s]);
+	}
+
+	return (0);
+}
+
+static void
+arc_numa_init(void)
+{
+	arc_nnodes = zfs_arc_numa ? MIN(MAX(max_nnodes, 1), ARC_MAX_NODES) : 1;
+
+	arc_node_sums = kmem_zalloc(arc_nnodes * sizeof (arc_node_sums_t),
+	    KM_SLEEP);
+	for (uint_t n = 0; n < arc_nnodes; n++) {
+		wmsum_t *sums = (wmsum_t *)&arc_node_sums[n];
+		for (int s = 0; s < ARC_NODE_STATS; s++)
+			wmsum_init(&sums[s], 0);
+	}
+}
+
+static void
+arc_numa_kstat_init(void)
+{
+	uint_t nstats = arc_nnodes * ARC_NODE_STATS;
+
+	arc_node_kstat_data = kmem_zalloc(nstats * sizeof (kstat_named_t),
+	    KM_SLEEP);
+	for (uint_t n = 0; n < arc_nnodes; n++) {
+		for (int s = 0; s < ARC_NODE_STATS; s++) {
+			kstat_named_t *kn =
+			    &arc_node_kstat_data[n * ARC_NODE_STATS + s];
+			(void) snprintf(kn->name, KSTAT_STRLEN, "node%u_%s", n,
+			    arc_node_stat_names[s]);
+			kn->data_type = KSTAT_DATA_UINT64;
+		}
+	}
+
+	arc_node_ksp = kstat_create("zfs", 0, "arc_numa", "misc",
+	    KSTAT_TYPE_NAMED, nstats, KSTAT_FLAG_VIRTUAL);
+	if (arc_node_ksp != NULL) {
+		arc_node_ksp->ks_data = arc_node_kstat_data;
+		arc_node_ksp->ks_update = arc_node_kstat_update;
+		kstat_install(arc_node_ksp);
+	}
+}
+
+static void
+arc_numa_fini(void)
+{
+	if (arc_node_ksp != NULL) {
+		kstat_delete(arc_node_ksp);
+		arc_node_ksp = NULL;
+	}
+	if (arc_node_kstat_data != NULL) {
+		kmem_free(arc_node_kstat_data,
+		    arc_nnodes * ARC_NODE_STATS * sizeof (kstat_named_t));
+		arc_node_kstat_data = NULL;
+	}
+
+	for (uint_t n = 0; n < arc_nnodes; n++) {
+		wmsum_t *sums = (wmsum_t *)&arc_node_sums[n];
+		for (int s = 0; s < ARC_NODE_STATS; s++)
+			wmsum_fini(&sums[s]);
+	}
+	kmem_free(arc_node_sums, arc_nnodes * sizeof (arc_node_sums_t));
+	arc_node_sums = NULL;
+}
+
 static void
 arc_evictable_space_increment(arc_buf_hdr_t *hdr, arc_state_t *state)
 {
@@ -2216,6 +2489,8 @@ arc_evictable_space_increment(arc_buf_hdr_t *hdr, arc_state_t *state)
 	if (hdr->b_l1hdr.b_pabd != NULL) {
 		(void) zfs_refcount_add_many(&state->arcs_esize[type],
 		    arc_hdr_size(hdr), hdr);
+		wmsum_add(&arc_node_sums[hdr->b_l1hdr.b_node].ans_evictable,
+		    arc_hdr_size(hdr));
 	}
 	if (HDR_HAS_RABD(hdr)) {
 		(void) zfs_refcount_add_many(&state->arcs_esize[type],
@@ -2255,6 +2530,8 @@ arc_evictable_space_decrement(arc_buf_hdr_t *hdr, arc_state_t *state)
 	if (hdr->b_l1hdr.b_pabd != NULL) {
 		(void) zfs_refcount_remove_many(&state->arcs_esize[type],
 		    arc_hdr_size(hdr), hdr);
+		wmsum_add(&arc_node_sums[hdr->b_l1hdr.b_node].ans_evictable,
+		    -arc_hdr_size(hdr));
 	}
 	if (HDR_HAS_RABD(hdr)) {
 		(void) zfs_refcount_remove_many(&state->arcs_esize[type],
@@ -2372,7 +2649,7 @@ arc_buf_info(arc_buf_t *ab, arc_buf_info_t *abi, int state_index)
 
 	if (l2hdr) {
 		abi->abi_l2arc_dattr = l2hdr->b_daddr;
-		abi->abi_l2arc_hits = l2hdr->b_hits;
+		abi->abi_l2arc_hits = hdr->b_l2hits;
 	}
 
 	abi->abi_state_type = state ? state->arcs_state : ARC_STATE_ANON;
@@ -2380,6 +2657,117 @@ arc_buf_info(arc_buf_t *ab, arc_buf_info_t *abi, int state_index)
 	abi->abi_size = arc_hdr_size(hdr);
 }
 
+/*
+ * Per-dataset ARC accounting
+ *
+ * A dataset with the arcmin or arcmax property set owns an arc_tenant_t,
+ * which the dbuf layer attaches to the headers of the blocks it reads and
+ * writes with arc_buf_set_tenant(). Each header holds a reference on its
+ * tenant, and while the header is in the MRU or MFU its size is charged to
+ * the tenant. A header's tenant is only set once, so a block shared by
+ * several datasets (e.g. a clone and its origin) is charged to whichever
+ * of them used it first.
+ *
+ * Eviction skips headers of tenants at or below their minimum unless
+ * nothing else can be evicted, and the eviction thread trims tenants that
+ * have grown past their maximum even if the ARC as a whole is not full
+ * (see arc_evict_tenants()). Both limits are therefore soft.
+ */
+static list_t arc_tenant_list;
+static kmutex_t arc_tenant_lock;
+static boolean_t arc_tenant_over;
+
+#define	ARC_TENANT_STATE(state)	((state) == arc_mru || (state) == arc_mfu)
+
+static void
+arc_tenant_charge(arc_tenant_t *at, int64_t delta)
+{
+	uint64_t size = atomic_add_64_nv(&at->at_size, delta);
+
+	if (delta > 0 && at->at_max != 0 && size > at->at_max)
+		arc_tenant_over = B_TRUE;
+}
+
+arc_tenant_t *
+arc_tenant_alloc(void)
+{
+	arc_tenant_t *at = kmem_zalloc(sizeof (arc_tenant_t), KM_SLEEP);
+
+	at->at_refcnt = 1;
+	mutex_enter(&arc_tenant_lock);
+	list_insert_tail(&arc_tenant_list, at);
+	mutex_exit(&arc_tenant_lock);
+
+	return (at);
+}
+
+void
+arc_tenant_rele(arc_tenant_t *at)
+{
+	if (atomic_dec_64_nv(&at->at_refcnt) != 0)
+		return;
+
+	ASSERT0(at->at_size);
+	mutex_enter(&arc_tenant_lock);
+	list_remove(&arc_tenant_list, at);
+	mutex_exit(&arc_tenant_lock);
+	kmem_free(at, sizeof (arc_tenant_t));
+}
+
+void
+arc_tenant_set_limits(arc_tenant_t *at, uint64_t min, uint64_t max)
+{
+	at->at_min = min;
+	at->at_max = max;
+	if (max != 0 && at->at_size > max)
+		arc_tenant_over = B_TRUE;
+}
+
+uint64_t
+arc_tenant_size(arc_tenant_t *at)
+{
+	return (at->at_size);
+}
+
+/*
+ * Charge the header of a buffer just read or written to the given tenant,
+ * if it isn't charged to one already.
+ */
+void
+arc_buf_set_tenant(arc_buf_t *buf, arc_tenant_t *at)
+{
+	arc_buf_hdr_t *hdr = buf->b_hdr;
+
+	if (at == NULL || hdr->b_l1hdr.b_tenant != NULL)
+		return;
+
+	kmutex_t *hash_lock = HDR_LOCK(hdr);
+	mutex_enter(hash_lock);
+	if (hdr->b_l1hdr.b_state == arc_anon || HDR_EMPTY(hdr) ||
+	    hdr->b_l1hdr.b_tenant != NULL) {
+		mutex_exit(hash_lock);
+		return;
+	}
+
+	atomic_inc_64(&at->at_refcnt);
+	hdr->b_l1hdr.b_tenant = at;
+	if (ARC_TENANT_STATE(hdr->b_l1hdr.b_state))
+		arc_tenant_charge(at, arc_hdr_size(hdr));
+	mutex_exit(hash_lock);
+}
+
+static void
+arc_hdr_tenant_rele(arc_buf_hdr_t *hdr)
+{
+	arc_tenant_t *at = hdr->b_l1hdr.b_tenant;
+
+	if (at != NULL) {
+		ASSERT(!ARC_TENANT_STATE(hdr->b_l1hdr.b_state));
+		hdr->b_l1hdr.b_tenant = NULL;
+		arc_tenant_rele(at);
+	}
+}
+
 /*
  * Move the supplied buffer to the indicated state. The hash lock
  * for the buffer must be held by the caller.
@@ -2569,11 +2957,23 @@ arc_change_state(arc_state_t *new_state, arc_buf_hdr_t *hdr)
 	}
 
 	if (HDR_HAS_L1HDR(hdr)) {
+		/*
+		 * The header's size can't change while it is in the MRU or
+		 * MFU, so the charge taken here is the one returned.
+		 */
+		arc_tenant_t *at = hdr->b_l1hdr.b_tenant;
+		boolean_t was = ARC_TENANT_STATE(old_state);
+		boolean_t is = ARC_TENANT_STATE(new_state);
+		if (at != NULL && was != is) {
+			int64_t size = arc_hdr_size(hdr);
+			arc_tenant_charge(at, is ? size : -size);
+		}
+
 		hdr->b_l1hdr.b_state = new_state;
 
 		if (HDR_HAS_L2HDR(hdr) && new_state != arc_l2c_only) {
 			l2arc_hdr_arcstats_decrement_state(hdr);
-			hdr->b_l2hdr.b_arcs_state = new_state->arcs_state;
+			hdr->b_l2arcs_state = new_state->arcs_state;
 			l2arc_hdr_arcstats_increment_state(hdr);
 		}
 	}
@@ -2897,10 +3297,12 @@ arc_loan_inuse_buf(arc_buf_t *buf, const void *tag)
 }
 
 static void
-l2arc_free_abd_on_write(abd_t *abd, size_t size, arc_buf_contents_t type)
+l2arc_free_abd_on_write(l2arc_dev_t *dev, abd_t *abd, size_t size,
+    arc_buf_contents_t type)
 {
 	l2arc_data_free_t *df = kmem_alloc(sizeof (*df), KM_SLEEP);
 
+	df->l2df_dev = dev;
 	df->l2df_abd = abd;
 	df->l2df_size = size;
 	df->l2df_type = type;
@@ -2932,10 +3334,17 @@ arc_hdr_free_on_write(arc_buf_hdr_t *hdr, boolean_t free_rdata)
 		arc_space_return(size, ARC_SPACE_DATA);
 	}
 
+	/*
+	 * The L2 header may already have been destroyed, but b_dev is left
+	 * pointing at the device the header is still being written to.
+	 */
+	l2arc_dev_t *dev = hdr->b_l2hdr.b_dev;
+	ASSERT3P(dev, !=, NULL);
 	if (free_rdata) {
-		l2arc_free_abd_on_write(hdr->b_crypt_hdr.b_rabd, size, type);
+		l2arc_free_abd_on_write(dev, hdr->b_crypt_hdr.b_rabd, size,
+		    type);
 	} else {
-		l2arc_free_abd_on_write(hdr->b_l1hdr.b_pabd, size, type);
+		l2arc_free_abd_on_write(dev, hdr->b_l1hdr.b_pabd, size, type);
 	}
 }
 
@@ -2965,6 +3374,7 @@ arc_share_buf(arc_buf_hdr_t *hdr, arc_buf_t *buf)
 	    HDR_ISTYPE_METADATA(hdr));
 	arc_hdr_set_flags(hdr, ARC_FLAG_SHARED_DATA);
 	buf->b_flags |= ARC_BUF_FLAG_SHARED;
+	arc_hdr_node_charge(hdr, arc_hdr_size(hdr));
 
 	/*
 	 * Since we've transferred ownership to the hdr we need
@@ -2995,6 +3405,7 @@ arc_unshare_buf(arc_buf_hdr_t *hdr, arc_buf_t *buf)
 	abd_free(hdr->b_l1hdr.b_pabd);
 	hdr->b_l1hdr.b_pabd = NULL;
 	buf->b_flags &= ~ARC_BUF_FLAG_SHARED;
+	arc_hdr_node_charge(hdr, -arc_hdr_size(hdr));
 
 	/*
 	 * Since the buffer is no longer shared between
@@ -3178,6 +3589,7 @@ arc_hdr_alloc_abd(arc_buf_hdr_t *hdr, int alloc_flags)
 		hdr->b_l1hdr.b_pabd = arc_get_data_abd(hdr, size, hdr,
 		    alloc_flags);
 		ASSERT3P(hdr->b_l1hdr.b_pabd, !=, NULL);
+		arc_hdr_node_charge(hdr, size);
 	}
 
 	ARCSTAT_INCR(arcstat_compressed_size, size);
@@ -3213,6 +3625,7 @@ arc_hdr_free_abd(arc_buf_hdr_t *hdr, boolean_t free_rdata)
 		ARCSTAT_INCR(arcstat_raw_size, -size);
 	} else {
 		hdr->b_l1hdr.b_pabd = NULL;
+		arc_hdr_node_charge(hdr, -size);
 	}
 
 	if (hdr->b_l1hdr.b_pabd == NULL && !HDR_HAS_RABD(hdr))
@@ -3344,6 +3757,7 @@ arc_hdr_realloc(arc_buf_hdr_t *hdr, kmem_cache_t *old, kmem_cache_t *new)
 		VERIFY3P(hdr->b_l1hdr.b_pabd, ==, NULL);
 		ASSERT(!HDR_HAS_RABD(hdr));
 
+		arc_hdr_tenant_rele(hdr);
 		arc_hdr_clear_flags(nhdr, ARC_FLAG_HAS_L1HDR);
 	}
 	/*
@@ -3548,7 +3962,7 @@ l2arc_hdr_arcstats_update(arc_buf_hdr_t *hdr, boolean_t incr,
 		 * possibly absent L1 header (apparent in buffers restored
 		 * from persistent L2ARC).
 		 */
-		switch (hdr->b_l2hdr.b_arcs_state) {
+		switch (hdr->b_l2arcs_state) {
 			case ARC_STATE_MRU_GHOST:
 			case ARC_STATE_MRU:
 				ARCSTAT_INCR(arcstat_l2_mru_asize, asize_s);
@@ -3660,6 +4074,8 @@ arc_hdr_destroy(arc_buf_hdr_t *hdr)
 
 		if (HDR_HAS_RABD(hdr))
 			arc_hdr_free_abd(hdr, B_TRUE);
+
+		arc_hdr_tenant_rele(hdr);
 	}
 
 	ASSERT3P(hdr->b_hash_next, ==, NULL);
@@ -3675,6 +4091,108 @@ arc_hdr_destroy(arc_buf_hdr_t *hdr)
 	}
 }
 
+/*
+ * Decompressed copy cache
+ *
+ * With compressed ARC, a header whose consumers have all gone keeps only
+ * its compressed data, and each later hit decompresses it again. For the
+ * hottest headers (in MFU, with at least zfs_arc_dcache_min_hits hits),
+ * arc_buf_destroy() instead hands the consumer's uncompressed buf over to
+ * this cache, which holds it (and so a reference on the header) so that
+ * arc_buf_fill() can copy from it rather than decompress. The cache is
+ * bounded by arc_dcache_target() and gives up its oldest copies first;
+ * a copy that is still hot gets back in the next time a consumer lets go
+ * of the block.
+ *
+ * Lock order is hash lock, then arc_dcache_lock; bufs are released
+ * without holding arc_dcache_lock.
+ */
+typedef struct arc_dcache_entry {
+	list_node_t	ade_node;
+	arc_buf_t	*ade_buf;
+	uint64_t	ade_size;
+} arc_dcache_entry_t;
+
+static uint64_t zfs_arc_dcache_max_bytes = UINT64_MAX;
+static uint_t zfs_arc_dcache_shift = 7;
+static uint_t zfs_arc_dcache_min_hits = 2;
+
+static kmutex_t arc_dcache_lock;
+static list_t arc_dcache_list;	/* newest first */
+static uint64_t arc_dcache_size;
+
+static uint64_t
+arc_dcache_target(void)
+{
+	return (MIN(zfs_arc_dcache_max_bytes,
+	    arc_c >> MIN(zfs_arc_dcache_shift, 63)));
+}
+
+/*
+ * Called with the hash lock held when tag is done with buf. Returns B_TRUE
+ * if the cache took over buf and the caller's reference.
+ */
+static boolean_t
+arc_dcache_keep(arc_buf_t *buf, const void *tag)
+{
+	arc_buf_hdr_t *hdr = buf->b_hdr;
+	uint64_t size = arc_buf_size(buf);
+
+	ASSERT(MUTEX_HELD(HDR_LOCK(hdr)));
+
+	if (hdr->b_l1hdr.b_state != arc_mfu ||
+	    hdr->b_l1hdr.b_mfu_hits < zfs_arc_dcache_min_hits ||
+	    arc_hdr_get_compress(hdr) == ZIO_COMPRESS_OFF ||
+	    HDR_PROTECTED(hdr) || HDR_IO_ERROR(hdr) ||
+	    (buf->b_flags & (ARC_BUF_FLAG_SHARED | ARC_BUF_FLAG_COMPRESSED |
+	    ARC_BUF_FLAG_ENCRYPTED | ARC_BUF_FLAG_DCACHE)) != 0 ||
+	    size > arc_dcache_target())
+		return (B_FALSE);
+
+	/* Another uncompressed buf will do just as well. */
+	for (arc_buf_t *b = hdr->b_l1hdr.b_buf; b != NULL; b = b->b_next) {
+		if (b != buf && !ARC_BUF_COMPRESSED(b))
+			return (B_FALSE);
+	}
+
+	arc_dcache_entry_t *ade = kmem_alloc(sizeof (*ade), KM_NOSLEEP);
+	if (ade == NULL)
+		return (B_FALSE);
+	ade->ade_buf = buf;
+	ade->ade_size = size;
+	buf->b_flags |= ARC_BUF_FLAG_DCACHE;
+	zfs_refcount_transfer_ownership(&hdr->b_l1hdr.b_refcnt, tag, ade);
+
+	mutex_enter(&arc_dcache_lock);
+	list_insert_head(&arc_dcache_list, ade);
+	arc_dcache_size += size;
+	mutex_exit(&arc_dcache_lock);
+
+	return (B_TRUE);
+}
+
+/*
+ * Release the oldest copies until the cache holds no more than target.
+ */
+static void
+arc_dcache_trim(uint64_t target)
+{
+	arc_dcache_entry_t *ade;
+
+	mutex_enter(&arc_dcache_lock);
+	while (arc_dcache_size > target &&
+	    (ade = list_remove_tail(&arc_dcache_list)) != NULL) {
+		arc_dcache_size -= ade->ade_size;
+		mutex_exit(&arc_dcache_lock);
+
+		arc_buf_destroy(ade->ade_buf, ade);
+		kmem_free(ade, sizeof (*ade));
+
+		mutex_enter(&arc_dcache_lock);
+	}
+	mutex_exit(&arc_dcache_lock);
+}
+
 void
 arc_buf_destroy(arc_buf_t *buf, const void *tag)
 {
@@ -3697,6 +4215,13 @@ arc_buf_destroy(arc_buf_t *buf, const void *tag)
 	ASSERT3P(hdr->b_l1hdr.b_state, !=, arc_anon);
 	ASSERT3P(buf->b_data, !=, NULL);
 
+	if (arc_dcache_keep(buf, tag)) {
+		mutex_exit(hash_lock);
+		if (arc_dcache_size > arc_dcache_target())
+			arc_dcache_trim(arc_dcache_target());
+		return;
+	}
+
 	arc_buf_destroy_impl(buf);
 	(void) remove_reference(hdr, tag);
 	mutex_exit(hash_lock);
@@ -3798,6 +4323,11 @@ arc_evict_hdr(arc_buf_hdr_t *hdr, uint64_t *real_evicted)
 		ARCSTAT_INCR(arcstat_evict_l2_cached, HDR_GET_LSIZE(hdr));
 	} else {
 		if (l2arc_write_eligible(hdr->b_spa, hdr)) {
+			if (l2arc_exclusive && l2arc_demote_defer(hdr)) {
+				ARCSTAT_BUMP(arcstat_l2_demote_deferred);
+				return (bytes_evicted);
+			}
+
 			ARCSTAT_INCR(arcstat_evict_l2_eligible,
 			    HDR_GET_LSIZE(hdr));
 
@@ -3861,9 +4391,34 @@ arc_set_need_free(void)
 	}
 }
 
+/*
+ * How arc_evict_state() treats per-dataset limits.
+ */
+typedef enum arc_tenant_filter {
+	ARC_TENANT_ANY,		/* ignore them */
+	ARC_TENANT_PROTECT,	/* skip tenants at or below their minimum */
+	ARC_TENANT_OVER,	/* only evict tenants above their maximum */
+} arc_tenant_filter_t;
+
+static boolean_t
+arc_tenant_evictable(arc_buf_hdr_t *hdr, arc_tenant_filter_t filter)
+{
+	arc_tenant_t *at = hdr->b_l1hdr.b_tenant;
+
+	switch (filter) {
+	case ARC_TENANT_PROTECT:
+		return (at == NULL || at->at_size > at->at_min);
+	case ARC_TENANT_OVER:
+		return (at != NULL && at->at_max != 0 &&
+		    at->at_size > at->at_max);
+	default:
+		return (B_TRUE);
+	}
+}
+
 static uint64_t
 arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
-    uint64_t spa, uint64_t bytes)
+    uint64_t spa, uint64_t bytes, arc_tenant_filter_t filter)
 {
 	multilist_sublist_t *mls;
 	uint64_t bytes_evicted = 0, real_evicted = 0;
@@ -3926,7 +4481,16 @@ arc_evict_state_impl(multilist_t *ml, int idx, arc_buf_hdr_t *marker,
 
 		if (mutex_tryenter(hash_lock)) {
 			uint64_t revicted;
-			uint64_t evicted = arc_evict_hdr(hdr, &revicted);
+			uint64_t evicted;
+
+			if (!arc_tenant_evictable(hdr, filter)) {
+				mutex_exit(hash_lock);
+				if (filter == ARC_TENANT_PROTECT)
+					ARCSTAT_BUMP(arcstat_evict_tenant_skip);
+				continue;
+			}
+
+			evicted = arc_evict_hdr(hdr, &revicted);
 			mutex_exit(hash_lock);
 
 			bytes_evicted += evicted;
@@ -4028,58 +4592,175 @@ arc_state_free_markers(arc_buf_hdr_t **markers, int count)
 	kmem_free(markers, sizeof (*markers) * count);
 }
 
+#define	ARC_EVICT_TASK_MIN	(16ULL << 20)
+
+typedef struct arc_evict_arg {
+	taskq_ent_t		eva_tqent;
+	multilist_t		*eva_ml;
+	arc_buf_hdr_t		**eva_markers;
+	int			eva_first;	/* range of sublists to use */
+	int			eva_count;
+	int			eva_start;	/* this task's first sublist */
+	int			eva_nsublists;
+	uint64_t		eva_spa;
+	uint64_t		eva_bytes;
+	arc_tenant_filter_t	eva_filter;
+	uint64_t		eva_evicted;
+} arc_evict_arg_t;
+
+static taskq_t *arc_evict_taskq;
+static arc_evict_arg_t *arc_evict_args;
+static uint_t arc_evict_nthreads;
+
 /*
- * Evict buffers from the given arc state, until we've removed the
- * specified number of bytes. Move the removed buffers to the
- * appropriate evict state.
- *
- * This function makes a "best effort". It skips over any buffers
- * it can't get a hash_lock on, and so, may not catch all candidates.
- * It may also return without evicting as much space as requested.
- *
- * If bytes is specified using the special value ARC_EVICT_ALL, this
- * will evict all available (i.e. unlocked and evictable) buffers from
- * the given arc state; which is used by arc_flush().
+ * Evict from nsublists sublists in turn, starting from start and wrapping
+ * around within [first, first + count), until bytes have been evicted.
  */
 static uint64_t
-arc_evict_state(arc_state_t *state, arc_buf_contents_t type, uint64_t spa,
-    uint64_t bytes)
+arc_evict_sublists(multilist_t *ml, arc_buf_hdr_t **markers, int first,
+    int count, int start, int nsublists, uint64_t spa, uint64_t bytes,
+    arc_tenant_filter_t filter)
 {
 	uint64_t total_evicted = 0;
-	multilist_t *ml = &state->arcs_list[type];
-	int num_sublists;
-	arc_buf_hdr_t **markers;
 
-	num_sublists = multilist_get_num_sublists(ml);
+	for (int i = 0; i < nsublists && total_evicted < bytes; i++) {
+		int idx = first + (start - first + i) % count;
 
-	/*
-	 * If we've tried to evict from each sublist, made some
-	 * progress, but still have not hit the target number of bytes
-	 * to evict, we want to keep trying. The markers allow us to
-	 * pick up where we left off for each individual sublist, rather
-	 * than starting from the tail each time.
-	 */
-	if (zthr_iscurthread(arc_evict_zthr)) {
-		markers = arc_state_evict_markers;
-		ASSERT3S(num_sublists, <=, arc_state_evict_marker_count);
-	} else {
-		markers = arc_state_alloc_markers(num_sublists);
+		total_evicted += arc_evict_state_impl(ml, idx, markers[idx],
+		    spa, bytes - total_evicted, filter);
 	}
-	for (int i = 0; i < num_sublists; i++) {
-		multilist_sublist_t *mls;
 
-		mls = multilist_sublist_lock_idx(ml, i);
-		multilist_sublist_insert_tail(mls, markers[i]);
-		multilist_sublist_unlock(mls);
-	}
+	return (total_evicted);
+}
+
+static void
+arc_evict_task(void *arg)
+{
+	arc_evict_arg_t *eva = arg;
+
+	eva->eva_evicted = arc_evict_sublists(eva->eva_ml, eva->eva_markers,
+	    eva->eva_first, eva->eva_count, eva->eva_start,
+	    eva->eva_nsublists, eva->eva_spa, eva->eva_bytes,
+	    eva->eva_filter);
+}
+
+/*
+ * Make one pass over count sublists, splitting them between up to
+ * arc_evict_nthreads tasks when there is enough to evict to make that
+ * worthwhile. Only the arc_evict thread uses the taskq, as the tasks share
+ * its markers.
+ */
+static uint64_t
+arc_evict_scan(multilist_t *ml, arc_buf_hdr_t **markers, int first,
+    int count, int start, uint64_t spa, uint64_t bytes,
+    arc_tenant_filter_t filter)
+{
+	uint64_t evicted = 0;
+	int ntasks = 1;
+
+	if (arc_evict_taskq != NULL && markers == arc_state_evict_markers) {
+		ntasks = MIN(MIN(bytes / ARC_EVICT_TASK_MIN,
+		    arc_evict_nthreads), count);
+	}
+	if (ntasks <= 1) {
+		return (arc_evict_sublists(ml, markers, first, count, start,
+		    count, spa, bytes, filter));
+	}
+
+	for (int t = 0; t < ntasks; t++) {
+		arc_evict_arg_t *eva = &arc_evict_args[t];
+
+		eva->eva_ml = ml;
+		eva->eva_markers = markers;
+		eva->eva_first = first;
+		eva->eva_count = count;
+		eva->eva_start = start;
+		eva->eva_nsublists = count / ntasks +
+		    (t < count % ntasks ? 1 : 0);
+		eva->eva_spa = spa;
+		eva->eva_bytes = bytes / ntasks;
+		eva->eva_filter = filter;
+		eva->eva_evicted = 0;
+		taskq_dispatch_ent(arc_evict_taskq, arc_evict_task, eva, 0,
+		    &eva->eva_tqent);
+
+		start = first + (start - first + eva->eva_nsublists) % count;
+	}
+	taskq_wait(arc_evict_taskq);
+
+	for (int t = 0; t < ntasks; t++)
+		evicted += arc_evict_args[t].eva_evicted;
+	ARCSTAT_BUMP(arcstat_evict_parallel);
+
+	return (evicted);
+}
+
+/*
+ * Evict buffers from the given arc state, until we've removed the
+ * specified number of bytes. Move the removed buffers to the
+ * appropriate evict state.
+ *
+ * This function makes a "best effort". It skips over any buffers
+ * it can't get a hash_lock on, and so, may not catch all candidates.
+ * It may also return without evicting as much space as requested.
+ *
+ * If bytes is specified using the special value ARC_EVICT_ALL, this
+ * will evict all available (i.e. unlocked and evictable) buffers from
+ * the given arc state; which is used by arc_flush().
+ *
+ * With ARC_TENANT_PROTECT, buffers of datasets at or below their arcmin
+ * are only evicted once a full scan finds nothing else to evict.
+ *
+ * If node is not -1, only that NUMA node's group of sublists is scanned.
+ */
+static uint64_t
+arc_evict_state(arc_state_t *state, arc_buf_contents_t type, uint64_t spa,
+    uint64_t bytes, arc_tenant_filter_t filter, int node)
+{
+	uint64_t total_evicted = 0;
+	multilist_t *ml = &state->arcs_list[type];
+	int num_sublists, first, count;
+	arc_buf_hdr_t **markers;
+
+	num_sublists = multilist_get_num_sublists(ml);
+	if (node >= 0) {
+		ASSERT3S(node, <, arc_nnodes);
+		count = num_sublists / arc_nnodes;
+		first = node * count;
+	} else {
+		count = num_sublists;
+		first = 0;
+	}
+
+	/*
+	 * If we've tried to evict from each sublist, made some
+	 * progress, but still have not hit the target number of bytes
+	 * to evict, we want to keep trying. The markers allow us to
+	 * pick up where we left off for each individual sublist, rather
+	 * than starting from the tail each time.
+	 */
+	if (zthr_iscurthread(arc_evict_zthr)) {
+		markers = arc_state_evict_markers;
+		ASSERT3S(num_sublists, <=, arc_state_evict_marker_count);
+	} else {
+		markers = arc_state_alloc_markers(num_sublists);
+	}
+	for (int i = first; i < first + count; i++) {
+		multilist_sublist_t *mls;
+
+		mls = multilist_sublist_lock_idx(ml, i);
+		multilist_sublist_insert_tail(mls, markers[i]);
+		multilist_sublist_unlock(mls);
+	}
 
 	/*
 	 * While we haven't hit our target number of bytes to evict, or
 	 * we're evicting all available buffers.
 	 */
 	while (total_evicted < bytes) {
-		int sublist_idx = multilist_get_random_index(ml);
-		uint64_t scan_evicted = 0;
+		int sublist_idx = first +
+		    multilist_get_random_index(ml) % count;
+		uint64_t scan_evicted;
 
 		/*
 		 * Start eviction using a randomly selected sublist,
@@ -4088,25 +4769,9 @@ arc_evict_state(arc_state_t *state, arc_buf_contents_t type, uint64_t spa,
 		 * (e.g. index 0) would cause evictions to favor certain
 		 * sublists over others.
 		 */
-		for (int i = 0; i < num_sublists; i++) {
-			uint64_t bytes_remaining;
-			uint64_t bytes_evicted;
-
-			if (total_evicted < bytes)
-				bytes_remaining = bytes - total_evicted;
-			else
-				break;
-
-			bytes_evicted = arc_evict_state_impl(ml, sublist_idx,
-			    markers[sublist_idx], spa, bytes_remaining);
-
-			scan_evicted += bytes_evicted;
-			total_evicted += bytes_evicted;
-
-			/* we've reached the end, wrap to the beginning */
-			if (++sublist_idx >= num_sublists)
-				sublist_idx = 0;
-		}
+		scan_evicted = arc_evict_scan(ml, markers, first, count,
+		    sublist_idx, spa, bytes - total_evicted, filter);
+		total_evicted += scan_evicted;
 
 		/*
 		 * If we didn't evict anything during this scan, we have
@@ -4117,6 +4782,25 @@ arc_evict_state(arc_state_t *state, arc_buf_contents_t type, uint64_t spa,
 			/* This isn't possible, let's make that obvious */
 			ASSERT3S(bytes, !=, 0);
 
+			/*
+			 * Everything left may be protected by arcmin; try
+			 * again from the tail, ignoring it.
+			 */
+			if (filter == ARC_TENANT_PROTECT &&
+			    !list_is_empty(&arc_tenant_list)) {
+				filter = ARC_TENANT_ANY;
+				for (int i = first; i < first + count; i++) {
+					multilist_sublist_t *mls =
+					    multilist_sublist_lock_idx(ml, i);
+					multilist_sublist_remove(mls,
+					    markers[i]);
+					multilist_sublist_insert_tail(mls,
+					    markers[i]);
+					multilist_sublist_unlock(mls);
+				}
+				continue;
+			}
+
 			/*
 			 * When bytes is ARC_EVICT_ALL, the only way to
 			 * break the loop is when scan_evicted is zero.
@@ -4132,7 +4816,7 @@ arc_evict_state(arc_state_t *state, arc_buf_contents_t type, uint64_t spa,
 		}
 	}
 
-	for (int i = 0; i < num_sublists; i++) {
+	for (int i = first; i < first + count; i++) {
 		multilist_sublist_t *mls = multilist_sublist_lock_idx(ml, i);
 		multilist_sublist_remove(mls, markers[i]);
 		multilist_sublist_unlock(mls);
@@ -4165,7 +4849,8 @@ arc_flush_state(arc_state_t *state, uint64_t spa, arc_buf_contents_t type,
 	uint64_t evicted = 0;
 
 	while (zfs_refcount_count(&state->arcs_esize[type]) != 0) {
-		evicted += arc_evict_state(state, type, spa, ARC_EVICT_ALL);
+		evicted += arc_evict_state(state, type, spa, ARC_EVICT_ALL,
+		    ARC_TENANT_ANY, -1);
 
 		if (!retry)
 			break;
@@ -4189,12 +4874,77 @@ arc_evict_impl(arc_state_t *state, arc_buf_contents_t type, int64_t bytes)
 	if (bytes > 0 && zfs_refcount_count(&state->arcs_esize[type]) > 0) {
 		delta = MIN(zfs_refcount_count(&state->arcs_esize[type]),
 		    bytes);
-		return (arc_evict_state(state, type, 0, delta));
+		return (arc_evict_state(state, type, 0, delta,
+		    GHOST_STATE(state) ? ARC_TENANT_ANY : ARC_TENANT_PROTECT,
+		    -1));
 	}
 
 	return (0);
 }
 
+/*
+ * Evict buffers of datasets that have grown beyond their arcmax.
+ */
+static uint64_t
+arc_evict_tenants(void)
+{
+	arc_state_t *states[] = { arc_mru, arc_mfu };
+	uint64_t excess = 0, total_evicted = 0;
+
+	arc_tenant_over = B_FALSE;
+
+	mutex_enter(&arc_tenant_lock);
+	for (arc_tenant_t *at = list_head(&arc_tenant_list); at != NULL;
+	    at = list_next(&arc_tenant_list, at)) {
+		if (at->at_max != 0 && at->at_size > at->at_max)
+			excess += at->at_size - at->at_max;
+	}
+	mutex_exit(&arc_tenant_lock);
+
+	for (int s = 0; s < ARRAY_SIZE(states); s++) {
+		for (int type = 0; type < ARC_BUFC_NUMTYPES; type++) {
+			if (total_evicted >= excess)
+				break;
+			total_evicted += arc_evict_state(states[s], type, 0,
+			    excess - total_evicted, ARC_TENANT_OVER, -1);
+		}
+	}
+	ARCSTAT_INCR(arcstat_evict_tenant_over, total_evicted);
+
+	return (total_evicted);
+}
+
+/*
+ * Evict up to the given number of bytes of buffers that live on the given
+ * NUMA node, oldest MRU data first. Used by the OS to relieve pressure on a
+ * single node without shrinking the whole ARC.
+ */
+uint64_t
+arc_evict_node(int node, uint64_t bytes)
+{
+	arc_state_t *states[] = { arc_mru, arc_mfu };
+	arc_buf_contents_t types[] = { ARC_BUFC_DATA, ARC_BUFC_METADATA };
+	uint64_t total_evicted = 0;
+
+	if (node < 0 || node >= arc_nnodes || arc_nnodes == 1)
+		return (0);
+
+	for (int t = 0; t < ARRAY_SIZE(types); t++) {
+		for (int s = 0; s < ARRAY_SIZE(states); s++) {
+			if (total_evicted >= bytes)
+				break;
+			if (zfs_refcount_count(
+			    &states[s]->arcs_esize[types[t]]) == 0)
+				continue;
+			total_evicted += arc_evict_state(states[s], types[t],
+			    0, bytes - total_evicted, ARC_TENANT_PROTECT, node);
+		}
+	}
+	wmsum_add(&arc_node_sums[node].ans_evicted, total_evicted);
+
+	return (total_evicted);
+}
+
 /*
  * Adjust specified fraction, taking into account initial ghost state(s) size,
  * ghost hit bytes towards increasing the fraction, ghost hit bytes towards
@@ -4235,6 +4985,24 @@ arc_evict_adj(uint64_t frac, uint64_t total, uint64_t up, uint64_t down,
 	return (frac + up - down);
 }
 
+/*
+ * Weight, in percent, for ghost hits on a ghost list of the given size
+ * that competes with one of size osize.  As in the original ARC, hits on
+ * the smaller list count for the ratio of the sizes, capped by
+ * zfs_arc_ghost_gain_max.
+ */
+static uint64_t
+arc_evict_gain(uint64_t size, uint64_t osize)
+{
+	uint64_t max = MAX(zfs_arc_ghost_gain_max, 1) * 100;
+
+	if (size >= osize)
+		return (100);
+	if (size == 0)
+		return (max);
+	return (MIN(osize / size * 100 + osize % size * 100 / size, max));
+}
+
 /*
  * Evict buffers from the cache, such that arcstat_size is capped by arc_c.
  */
@@ -4272,13 +5040,35 @@ arc_evict(void)
 	uint64_t gfm = ngfm - ogfm;
 	ogfm = ngfm;
 
+	/* Weigh ghost hits by the relative sizes of the ghost lists. */
+	uint64_t srd = zfs_refcount_count(
+	    &arc_mru_ghost->arcs_size[ARC_BUFC_DATA]);
+	uint64_t srm = zfs_refcount_count(
+	    &arc_mru_ghost->arcs_size[ARC_BUFC_METADATA]);
+	uint64_t sfd = zfs_refcount_count(
+	    &arc_mfu_ghost->arcs_size[ARC_BUFC_DATA]);
+	uint64_t sfm = zfs_refcount_count(
+	    &arc_mfu_ghost->arcs_size[ARC_BUFC_METADATA]);
+	ARCSTAT(arcstat_meta_gain) = arc_evict_gain(srm + sfm, srd + sfd);
+	ARCSTAT(arcstat_data_gain) = arc_evict_gain(srd + sfd, srm + sfm);
+	ARCSTAT(arcstat_mru_data_gain) = arc_evict_gain(srd, sfd);
+	ARCSTAT(arcstat_mfu_data_gain) = arc_evict_gain(sfd, srd);
+	ARCSTAT(arcstat_mru_meta_gain) = arc_evict_gain(srm, sfm);
+	ARCSTAT(arcstat_mfu_meta_gain) = arc_evict_gain(sfm, srm);
+
 	/* Adjust ARC states balance based on ghost hits. */
 	arc_meta = arc_evict_adj(arc_meta, gsrd + gsrm + gsfd + gsfm,
-	    grm + gfm, grd + gfd, zfs_arc_meta_balance);
-	arc_pd = arc_evict_adj(arc_pd, gsrd + gsfd, grd, gfd, 100);
-	arc_pm = arc_evict_adj(arc_pm, gsrm + gsfm, grm, gfm, 100);
-
-	asize = aggsum_value(&arc_sums.arcstat_size);
+	    (grm + gfm) * ARCSTAT(arcstat_meta_gain) / 100,
+	    (grd + gfd) * ARCSTAT(arcstat_data_gain) / 100,
+	    zfs_arc_meta_balance);
+	arc_pd = arc_evict_adj(arc_pd, gsrd + gsfd,
+	    grd * ARCSTAT(arcstat_mru_data_gain) / 100,
+	    gfd * ARCSTAT(arcstat_mfu_data_gain) / 100, 100);
+	arc_pm = arc_evict_adj(arc_pm, gsrm + gsfm,
+	    grm * ARCSTAT(arcstat_mru_meta_gain) / 100,
+	    gfm * ARCSTAT(arcstat_mfu_meta_gain) / 100, 100);
+
+	asize = arc_size_approx();
 	int64_t wt = t - (asize - arc_c);
 
 	/*
@@ -4382,6 +5172,9 @@ arc_flush(spa_t *spa, boolean_t retry)
 	if (spa != NULL)
 		guid = spa_load_guid(spa);
 
+	/* The copies keep their headers referenced; let them all go. */
+	arc_dcache_trim(0);
+
 	(void) arc_flush_state(arc_mru, guid, ARC_BUFC_DATA, retry);
 	(void) arc_flush_state(arc_mru, guid, ARC_BUFC_METADATA, retry);
 
@@ -4398,6 +5191,17 @@ arc_flush(spa_t *spa, boolean_t retry)
 	(void) arc_flush_state(arc_uncached, guid, ARC_BUFC_METADATA, retry);
 }
 
+/*
+ * The ARC size, to within arc_c >> arc_size_approx_shift, for callers which
+ * only use it for heuristics.  Exact readers use aggsum_value().
+ */
+uint64_t
+arc_size_approx(void)
+{
+	return (aggsum_value_approx(&arc_sums.arcstat_size,
+	    arc_c >> arc_size_approx_shift));
+}
+
 void
 arc_reduce_target_size(int64_t to_free)
 {
@@ -4414,7 +5218,7 @@ arc_reduce_target_size(int64_t to_free)
 	 * immediately have arc_c < arc_size and therefore the arc_evict_zthr
 	 * will evict.
 	 */
-	uint64_t asize = aggsum_value(&arc_sums.arcstat_size);
+	uint64_t asize = arc_size_approx();
 	if (asize < c)
 		to_free += c - asize;
 	arc_c = MAX((int64_t)c - to_free, (int64_t)arc_c_min);
@@ -4512,7 +5316,7 @@ arc_evict_cb_check(void *arg, zthr_t *zthr)
 	 * which is held before this function is called, and is held by
 	 * arc_wait_for_eviction() when it calls zthr_wakeup().
 	 */
-	if (arc_evict_needed)
+	if (arc_evict_needed || arc_tenant_over)
 		return (B_TRUE);
 
 	/*
@@ -4541,9 +5345,15 @@ arc_evict_cb(void *arg, zthr_t *zthr)
 	evicted += arc_flush_state(arc_uncached, 0, ARC_BUFC_DATA, B_FALSE);
 	evicted += arc_flush_state(arc_uncached, 0, ARC_BUFC_METADATA, B_FALSE);
 
+	/* Trim datasets over their arcmax, even without memory pressure. */
+	if (arc_tenant_over)
+		(void) arc_evict_tenants();
+
 	/* Evict from other states only if told to. */
-	if (arc_evict_needed)
+	if (arc_evict_needed) {
+		arc_dcache_trim(arc_dcache_target());
 		evicted += arc_evict();
+	}
 
 	/*
 	 * If evicted is zero, we couldn't evict anything
@@ -5074,9 +5884,17 @@ arc_access(arc_buf_hdr_t *hdr, arc_flags_t arc_flags, boolean_t hit)
 		/*
 		 * If the previous access was a prefetch, then it already
 		 * handled possible promotion, so nothing more to do for now.
+		 * A prefetched block whose only demand read is uncached is
+		 * not kept any longer than an uncached miss would be.
 		 */
 		if (was_prefetch) {
 			hdr->b_l1hdr.b_arc_access = now;
+			if (!now_prefetch && (arc_flags & ARC_FLAG_UNCACHED)) {
+				arc_hdr_set_flags(hdr, ARC_FLAG_UNCACHED);
+				DTRACE_PROBE1(new_state__uncached,
+				    arc_buf_hdr_t *, hdr);
+				arc_change_state(arc_uncached, hdr);
+			}
 			return;
 		}
 
@@ -5156,6 +5974,131 @@ arc_access(arc_buf_hdr_t *hdr, arc_flags_t arc_flags, boolean_t hit)
 	}
 }
 
+/*
+ * Admission filter
+ *
+ * A large one-shot scan (a backup, a send, a find) would otherwise fill the
+ * MRU with blocks that will never be read again, pushing out the working
+ * set. For datasets with cacheadmit=frequent, the dbuf layer asks
+ * arc_admit() before reading a block; if the block hasn't been used at
+ * least zfs_arc_admit_min_freq times recently, it is read as
+ * ARC_FLAG_UNCACHED and dropped once it has been used. Blocks that are
+ * still in a ghost list are always admitted by the normal ghost hit path.
+ *
+ * "Recently used" is judged by a TinyLFU-style count-min sketch: four rows
+ * of 4-bit saturating counters, indexed by different hashes of the block's
+ * identity. The estimate is the smallest of a block's four counters. To age
+ * the sketch, all counters are halved once there have been ten increments
+ * per counter in a row.
+ */
+#define	ARC_SKETCH_ROWS		4
+#define	ARC_SKETCH_MIN_SHIFT	12
+#define	ARC_SKETCH_MAX_SHIFT	22
+#define	ARC_SKETCH_WORDS	(ARC_SKETCH_ROWS * (arc_sketch_mask + 1) / 16)
+
+static uint64_t *arc_sketch;
+static uint64_t arc_sketch_mask;
+static uint64_t arc_sketch_adds;
+static kmutex_t arc_sketch_lock;
+
+static inline uint64_t
+arc_sketch_mix(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return (x);
+}
+
+static void
+arc_sketch_init(void)
+{
+	int shift = highbit64(arc_c_max >> 15);
+
+	shift = MIN(MAX(shift, ARC_SKETCH_MIN_SHIFT), ARC_SKETCH_MAX_SHIFT);
+	arc_sketch_mask = (1ULL << shift) - 1;
+	arc_sketch = vmem_zalloc(ARC_SKETCH_WORDS * sizeof (uint64_t),
+	    KM_SLEEP);
+	mutex_init(&arc_sketch_lock, NULL, MUTEX_DEFAULT, NULL);
+}
+
+static void
+arc_sketch_fini(void)
+{
+	vmem_free(arc_sketch, ARC_SKETCH_WORDS * sizeof (uint64_t));
+	mutex_destroy(&arc_sketch_lock);
+}
+
+static void
+arc_sketch_age(void)
+{
+
+	/*
+	 * Racing with a concurrent increment can only lose that increment,
+	 * which the sketch can tolerate.
+	 */
+	for (uint64_t i = 0; i < ARC_SKETCH_WORDS; i++)
+		arc_sketch[i] = (arc_sketch[i] >> 1) & 0x7777777777777777ULL;
+}
+
+/*
+ * Return B_TRUE if the block should be cached in the ARC. If count is set,
+ * this use of the block is also recorded; prefetches only ask, so that a
+ * prefetch and the read it anticipates count as one use.
+ */
+boolean_t
+arc_admit(spa_t *spa, const blkptr_t *bp, boolean_t count)
+{
+	const dva_t *dva;
+	uint64_t h1, h2;
+	uint_t freq = 15;
+
+	if (BP_IS_EMBEDDED(bp) || BP_IS_HOLE(bp))
+		return (B_TRUE);
+
+	dva = BP_IDENTITY(bp);
+	h1 = arc_sketch_mix(dva->dva_word[0] ^ spa_load_guid(spa));
+	h2 = arc_sketch_mix(dva->dva_word[1] ^ BP_GET_BIRTH(bp) ^ h1) | 1;
+
+	for (int r = 0; r < ARC_SKETCH_ROWS; r++) {
+		uint64_t idx = (h1 + r * h2) & arc_sketch_mask;
+		uint64_t *wp = &arc_sketch[(r * (arc_sketch_mask + 1) + idx) /
+		    16];
+		uint_t shift = (idx % 16) * 4;
+		uint64_t w, nw;
+		uint_t c;
+
+		do {
+			w = *wp;
+			c = (w >> shift) & 0xf;
+			if (!count || c == 0xf)
+				break;
+			nw = w + (1ULL << shift);
+		} while (atomic_cas_64(wp, w, nw) != w);
+		if (count && c < 0xf)
+			c++;
+		freq = MIN(freq, c);
+	}
+
+	if (count &&
+	    atomic_inc_64_nv(&arc_sketch_adds) >= (arc_sketch_mask + 1) * 10 &&
+	    mutex_tryenter(&arc_sketch_lock)) {
+		if (arc_sketch_adds >= (arc_sketch_mask + 1) * 10) {
+			arc_sketch_age();
+			atomic_swap_64(&arc_sketch_adds, 0);
+		}
+		mutex_exit(&arc_sketch_lock);
+	}
+
+	if (freq >= zfs_arc_admit_min_freq)
+		return (B_TRUE);
+	if (count)
+		ARCSTAT_BUMP(arcstat_admit_rejected);
+	return (B_FALSE);
+}
+
 /*
  * This routine is called by dbuf_hold() to update the arc_access() state
  * which otherwise would be skipped for entries in the dbuf cache.
@@ -5636,6 +6579,7 @@ top:
 
 		DTRACE_PROBE1(arc__hit, arc_buf_hdr_t *, hdr);
 		arc_access(hdr, *arc_flags, B_TRUE);
+		arc_node_hit(hdr);
 
 		if (done && !no_buf) {
 			ASSERT(!embedded_bp || !BP_IS_HOLE(bp));
@@ -5896,7 +6840,8 @@ top:
 
 				DTRACE_PROBE1(l2arc__hit, arc_buf_hdr_t *, hdr);
 				ARCSTAT_BUMP(arcstat_l2_hits);
-				hdr->b_l2hdr.b_hits++;
+				if (hdr->b_l2hits < UINT16_MAX)
+					hdr->b_l2hits++;
 
 				cb = kmem_zalloc(sizeof (l2arc_read_callback_t),
 				    KM_SLEEP);
@@ -6016,8 +6961,11 @@ top:
 
 out:
 	/* embedded bps don't actually go to disk */
-	if (!embedded_bp)
+	if (!embedded_bp) {
 		spa_read_history_add(spa, zb, *arc_flags);
+		spa_heatmap_add(spa, zb, (*arc_flags & ARC_FLAG_CACHED) ?
+		    SPA_HEATMAP_READ : SPA_HEATMAP_MISS);
+	}
 	spl_fstrans_unmark(cookie);
 	return (rc);
 
@@ -6375,6 +7323,17 @@ arc_released(arc_buf_t *buf)
 	    buf->b_hdr->b_l1hdr.b_state == arc_anon);
 }
 
+/*
+ * Returns B_TRUE if the buffer has been accessed more than once since it
+ * entered the cache.  This is checked without the hash lock, so it is only
+ * a hint.
+ */
+boolean_t
+arc_buf_is_mfu(arc_buf_t *buf)
+{
+	return (buf->b_hdr->b_l1hdr.b_state == arc_mfu);
+}
+
 #ifdef ZFS_DEBUG
 int
 arc_referenced(arc_buf_t *buf)
@@ -6659,6 +7618,8 @@ arc_write(zio_t *pio, spa_t *spa, uint64_t txg,
 	ASSERT(!HDR_IO_IN_PROGRESS(hdr));
 	ASSERT3P(hdr->b_l1hdr.b_acb, ==, NULL);
 	ASSERT3P(hdr->b_l1hdr.b_buf, !=, NULL);
+	if (zb != NULL)
+		spa_heatmap_add(spa, zb, SPA_HEATMAP_WRITE);
 	if (uncached)
 		arc_hdr_set_flags(hdr, ARC_FLAG_UNCACHED);
 	else if (l2arc)
@@ -6891,6 +7852,17 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_mfu_ghost_hits);
 	as->arcstat_uncached_hits.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_uncached_hits);
+	as->arcstat_admit_rejected.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_admit_rejected);
+	as->arcstat_dcache_hits.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_dcache_hits);
+	as->arcstat_dcache_misses.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_dcache_misses);
+	as->arcstat_dcache_size.value.ui64 = arc_dcache_size;
+	as->arcstat_warm_saved.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_warm_saved);
+	as->arcstat_warm_prefetched.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_warm_prefetched);
 	as->arcstat_deleted.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_deleted);
 	as->arcstat_mutex_miss.value.ui64 =
@@ -6901,6 +7873,8 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_evict_skip);
 	as->arcstat_evict_not_enough.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_evict_not_enough);
+	as->arcstat_evict_parallel.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_evict_parallel);
 	as->arcstat_evict_l2_cached.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_evict_l2_cached);
 	as->arcstat_evict_l2_eligible.value.ui64 =
@@ -6913,6 +7887,10 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_evict_l2_ineligible);
 	as->arcstat_evict_l2_skip.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_evict_l2_skip);
+	as->arcstat_evict_tenant_skip.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_evict_tenant_skip);
+	as->arcstat_evict_tenant_over.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_evict_tenant_over);
 	as->arcstat_hash_collisions.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_hash_collisions);
 	as->arcstat_hash_chains.value.ui64 =
@@ -7021,6 +7999,10 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	    wmsum_value(&arc_sums.arcstat_l2_free_on_write);
 	as->arcstat_l2_abort_lowmem.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_l2_abort_lowmem);
+	as->arcstat_l2_demote_deferred.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_l2_demote_deferred);
+	as->arcstat_l2_exclusive_drops.value.ui64 =
+	    wmsum_value(&arc_sums.arcstat_l2_exclusive_drops);
 	as->arcstat_l2_cksum_bad.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_l2_cksum_bad);
 	as->arcstat_l2_io_error.value.ui64 =
@@ -7098,6 +8080,17 @@ arc_kstat_update(kstat_t *ksp, int rw)
 	as->arcstat_abd_chunk_waste_size.value.ui64 =
 	    wmsum_value(&arc_sums.arcstat_abd_chunk_waste_size);
 
+	arc_state_t *states[] = { arc_mru, arc_mru_ghost, arc_mfu,
+	    arc_mfu_ghost, arc_uncached, arc_l2c_only };
+	uint64_t contended = 0;
+	for (int i = 0; i < ARRAY_SIZE(states); i++) {
+		for (int t = 0; t < ARC_BUFC_NUMTYPES; t++) {
+			contended += multilist_get_contended(
+			    &states[i]->arcs_list[t]);
+		}
+	}
+	as->arcstat_evict_list_contended.value.ui64 = contended;
+
 	return (0);
 }
 
@@ -7107,6 +8100,9 @@ arc_kstat_update(kstat_t *ksp, int rw)
  * code is laid out; arc_evict_state() assumes ARC buffers are evenly
  * distributed between all sublists and uses this assumption when
  * deciding which sublist to evict from and how much to evict from it.
+ *
+ * With more than one NUMA node the sublists are split into arc_nnodes
+ * equal groups, and the header goes to a sublist in its node's group.
  */
 static unsigned int
 arc_state_multilist_index_func(multilist_t *ml, void *obj)
@@ -7133,8 +8129,9 @@ arc_state_multilist_index_func(multilist_t *ml, void *obj)
 	 * would not be evenly distributed. In this context full 64bit
 	 * division would be a waste of time, so limit it to 32 bits.
 	 */
-	return ((unsigned int)buf_hash(hdr->b_spa, &hdr->b_dva, hdr->b_birth) %
-	    multilist_get_num_sublists(ml));
+	unsigned int group = multilist_get_num_sublists(ml) / arc_nnodes;
+	return (hdr->b_l1hdr.b_node * group + (unsigned int)buf_hash(
+	    hdr->b_spa, &hdr->b_dva, hdr->b_birth) % group);
 }
 
 static unsigned int
@@ -7224,8 +8221,9 @@ static void
 arc_state_multilist_init(multilist_t *ml,
     multilist_sublist_index_func_t *index_func, int *maxcountp)
 {
-	multilist_create(ml, sizeof (arc_buf_hdr_t),
-	    offsetof(arc_buf_hdr_t, b_l1hdr.b_arc_node), index_func);
+	multilist_create_groups(ml, sizeof (arc_buf_hdr_t),
+	    offsetof(arc_buf_hdr_t, b_l1hdr.b_arc_node), arc_nnodes,
+	    index_func);
 	*maxcountp = MAX(*maxcountp, multilist_get_num_sublists(ml));
 }
 
@@ -7326,17 +8324,25 @@ arc_state_init(void)
 	wmsum_init(&arc_sums.arcstat_mfu_hits, 0);
 	wmsum_init(&arc_sums.arcstat_mfu_ghost_hits, 0);
 	wmsum_init(&arc_sums.arcstat_uncached_hits, 0);
+	wmsum_init(&arc_sums.arcstat_admit_rejected, 0);
+	wmsum_init(&arc_sums.arcstat_dcache_hits, 0);
+	wmsum_init(&arc_sums.arcstat_dcache_misses, 0);
+	wmsum_init(&arc_sums.arcstat_warm_saved, 0);
+	wmsum_init(&arc_sums.arcstat_warm_prefetched, 0);
 	wmsum_init(&arc_sums.arcstat_deleted, 0);
 	wmsum_init(&arc_sums.arcstat_mutex_miss, 0);
 	wmsum_init(&arc_sums.arcstat_access_skip, 0);
 	wmsum_init(&arc_sums.arcstat_evict_skip, 0);
 	wmsum_init(&arc_sums.arcstat_evict_not_enough, 0);
+	wmsum_init(&arc_sums.arcstat_evict_parallel, 0);
 	wmsum_init(&arc_sums.arcstat_evict_l2_cached, 0);
 	wmsum_init(&arc_sums.arcstat_evict_l2_eligible, 0);
 	wmsum_init(&arc_sums.arcstat_evict_l2_eligible_mfu, 0);
 	wmsum_init(&arc_sums.arcstat_evict_l2_eligible_mru, 0);
 	wmsum_init(&arc_sums.arcstat_evict_l2_ineligible, 0);
 	wmsum_init(&arc_sums.arcstat_evict_l2_skip, 0);
+	wmsum_init(&arc_sums.arcstat_evict_tenant_skip, 0);
+	wmsum_init(&arc_sums.arcstat_evict_tenant_over, 0);
 	wmsum_init(&arc_sums.arcstat_hash_collisions, 0);
 	wmsum_init(&arc_sums.arcstat_hash_chains, 0);
 	aggsum_init(&arc_sums.arcstat_size, 0);
@@ -7369,6 +8375,8 @@ arc_state_init(void)
 	wmsum_init(&arc_sums.arcstat_l2_evict_l1cached, 0);
 	wmsum_init(&arc_sums.arcstat_l2_free_on_write, 0);
 	wmsum_init(&arc_sums.arcstat_l2_abort_lowmem, 0);
+	wmsum_init(&arc_sums.arcstat_l2_demote_deferred, 0);
+	wmsum_init(&arc_sums.arcstat_l2_exclusive_drops, 0);
 	wmsum_init(&arc_sums.arcstat_l2_cksum_bad, 0);
 	wmsum_init(&arc_sums.arcstat_l2_io_error, 0);
 	wmsum_init(&arc_sums.arcstat_l2_lsize, 0);
@@ -7484,17 +8492,25 @@ arc_state_fini(void)
 	wmsum_fini(&arc_sums.arcstat_mfu_hits);
 	wmsum_fini(&arc_sums.arcstat_mfu_ghost_hits);
 	wmsum_fini(&arc_sums.arcstat_uncached_hits);
+	wmsum_fini(&arc_sums.arcstat_admit_rejected);
+	wmsum_fini(&arc_sums.arcstat_dcache_hits);
+	wmsum_fini(&arc_sums.arcstat_dcache_misses);
+	wmsum_fini(&arc_sums.arcstat_warm_saved);
+	wmsum_fini(&arc_sums.arcstat_warm_prefetched);
 	wmsum_fini(&arc_sums.arcstat_deleted);
 	wmsum_fini(&arc_sums.arcstat_mutex_miss);
 	wmsum_fini(&arc_sums.arcstat_access_skip);
 	wmsum_fini(&arc_sums.arcstat_evict_skip);
 	wmsum_fini(&arc_sums.arcstat_evict_not_enough);
+	wmsum_fini(&arc_sums.arcstat_evict_parallel);
 	wmsum_fini(&arc_sums.arcstat_evict_l2_cached);
 	wmsum_fini(&arc_sums.arcstat_evict_l2_eligible);
 	wmsum_fini(&arc_sums.arcstat_evict_l2_eligible_mfu);
 	wmsum_fini(&arc_sums.arcstat_evict_l2_eligible_mru);
 	wmsum_fini(&arc_sums.arcstat_evict_l2_ineligible);
 	wmsum_fini(&arc_sums.arcstat_evict_l2_skip);
+	wmsum_fini(&arc_sums.arcstat_evict_tenant_skip);
+	wmsum_fini(&arc_sums.arcstat_evict_tenant_over);
 	wmsum_fini(&arc_sums.arcstat_hash_collisions);
 	wmsum_fini(&arc_sums.arcstat_hash_chains);
 	aggsum_fini(&arc_sums.arcstat_size);
@@ -7527,6 +8543,8 @@ arc_state_fini(void)
 	wmsum_fini(&arc_sums.arcstat_l2_evict_l1cached);
 	wmsum_fini(&arc_sums.arcstat_l2_free_on_write);
 	wmsum_fini(&arc_sums.arcstat_l2_abort_lowmem);
+	wmsum_fini(&arc_sums.arcstat_l2_demote_deferred);
+	wmsum_fini(&arc_sums.arcstat_l2_exclusive_drops);
 	wmsum_fini(&arc_sums.arcstat_l2_cksum_bad);
 	wmsum_fini(&arc_sums.arcstat_l2_io_error);
 	wmsum_fini(&arc_sums.arcstat_l2_lsize);
@@ -7589,6 +8607,7 @@ arc_init(void)
 	arc_min_prefetch_ms = 1000;
 	arc_min_prescient_prefetch_ms = 6000;
 
+	arc_numa_init();
 #if defined(_KERNEL)
 	arc_lowmem_init();
 #endif
@@ -7629,6 +8648,9 @@ arc_init(void)
 	arc_meta = (1ULL << 32) / 4;	/* Metadata is 25% of arc_c. */
 	arc_pd = (1ULL << 32) / 2;	/* Data MRU is 50% of data. */
 	arc_pm = (1ULL << 32) / 2;	/* Metadata MRU is 50% of metadata. */
+	ARCSTAT(arcstat_meta_gain) = ARCSTAT(arcstat_data_gain) = 100;
+	ARCSTAT(arcstat_mru_data_gain) = ARCSTAT(arcstat_mfu_data_gain) = 100;
+	ARCSTAT(arcstat_mru_meta_gain) = ARCSTAT(arcstat_mfu_meta_gain) = 100;
 
 	percent = MIN(zfs_arc_dnode_limit_percent, 100);
 	arc_dnode_limit = arc_c_max * percent / 100;
@@ -7648,6 +8670,16 @@ arc_init(void)
 
 	buf_init();
 
+	arc_sketch_init();
+
+	mutex_init(&arc_tenant_lock, NULL, MUTEX_DEFAULT, NULL);
+	list_create(&arc_tenant_list, sizeof (arc_tenant_t),
+	    offsetof(arc_tenant_t, at_node));
+
+	mutex_init(&arc_dcache_lock, NULL, MUTEX_DEFAULT, NULL);
+	list_create(&arc_dcache_list, sizeof (arc_dcache_entry_t),
+	    offsetof(arc_dcache_entry_t, ade_node));
+
 	list_create(&arc_prune_list, sizeof (arc_prune_t),
 	    offsetof(arc_prune_t, p_node));
 	mutex_init(&arc_prune_mtx, NULL, MUTEX_DEFAULT, NULL);
@@ -7663,9 +8695,25 @@ arc_init(void)
 		arc_ksp->ks_update = arc_kstat_update;
 		kstat_install(arc_ksp);
 	}
+	arc_numa_kstat_init();
 
 	arc_state_evict_markers =
 	    arc_state_alloc_markers(arc_state_evict_marker_count);
+
+	arc_evict_nthreads = zfs_arc_evict_threads;
+	if (arc_evict_nthreads == 0) {
+		arc_evict_nthreads = (max_ncpus < 6) ? 1 :
+		    (highbit64(max_ncpus) - 1) + max_ncpus / 32;
+	}
+	if (arc_evict_nthreads > 1) {
+		arc_evict_args = kmem_zalloc(arc_evict_nthreads *
+		    sizeof (arc_evict_arg_t), KM_SLEEP);
+		for (int i = 0; i < arc_evict_nthreads; i++)
+			taskq_init_ent(&arc_evict_args[i].eva_tqent);
+		arc_evict_taskq = taskq_create("arc_evict",
+		    arc_evict_nthreads, defclsyspri, arc_evict_nthreads,
+		    INT_MAX, TASKQ_PREPOPULATE);
+	}
 	arc_evict_zthr = zthr_create_timer("arc_evict",
 	    arc_evict_cb_check, arc_evict_cb, NULL, SEC2NSEC(1), defclsyspri);
 	arc_reap_zthr = zthr_create_timer("arc_reap",
@@ -7747,6 +8795,14 @@ arc_fini(void)
 	arc_state_free_markers(arc_state_evict_markers,
 	    arc_state_evict_marker_count);
 
+	if (arc_evict_taskq != NULL) {
+		taskq_destroy(arc_evict_taskq);
+		arc_evict_taskq = NULL;
+		kmem_free(arc_evict_args, arc_evict_nthreads *
+		    sizeof (arc_evict_arg_t));
+		arc_evict_args = NULL;
+	}
+
 	mutex_destroy(&arc_evict_lock);
 	list_destroy(&arc_evict_waiters);
 
@@ -7755,7 +8811,7 @@ arc_fini(void)
 	 * to occur before arc_state_fini() runs and destroys the aggsum
 	 * values which are updated when freeing scatter ABDs.
 	 */
-	l2arc_do_free_on_write();
+	l2arc_do_free_on_write(NULL);
 
 	/*
 	 * buf_fini() must proceed arc_state_fini() because buf_fin() may
@@ -7764,6 +8820,15 @@ arc_fini(void)
 	 */
 	buf_fini();
 	arc_state_fini();
+	arc_sketch_fini();
+	arc_numa_fini();
+
+	list_destroy(&arc_tenant_list);
+	mutex_destroy(&arc_tenant_lock);
+
+	ASSERT0(arc_dcache_size);
+	list_destroy(&arc_dcache_list);
+	mutex_destroy(&arc_dcache_lock);
 
 	arc_unregister_hotplug();
 
@@ -7778,6 +8843,346 @@ arc_fini(void)
 	ASSERT0(arc_loaned_bytes);
 }
 
+/*
+ * Persistent ARC warm-start
+ *
+ * When zfs_arc_warm_interval is non-zero, each writeable pool periodically
+ * records the blocks it has in the MFU state to an object in the MOS. That
+ * object holds no data, only enough of each block's identity (DVA, birth,
+ * sizes, compression and type) to read it back, plus a fletcher4 checksum
+ * of the block as it exists on disk. The ARC does not keep the block
+ * pointers of cached blocks, so the checksum is computed from the ARC's own
+ * copy, which is why only blocks held with their on-disk layout (same
+ * compression, no encryption, native byte order, no gang) are recorded.
+ *
+ * When the pool is next imported, the blocks are prefetched back into the
+ * ARC in the background, with the stored checksum taking the place of the
+ * one in the original block pointer. Entries that have since been freed
+ * and overwritten fail that check and are silently dropped, as the reads
+ * are speculative. Prefetching stops once the ARC reaches its target size.
+ *
+ * Both halves run in the pool's arc_warm zthr, which is cancelled along
+ * with the pool's other auxiliary threads.
+ */
+static uint_t zfs_arc_warm_interval = 0;
+static uint_t zfs_arc_warm_max_blocks = 256 * 1024;
+static int zfs_arc_warm_prefetch = 1;
+
+/* Number of reads issued at import before waiting for them to complete. */
+#define	ARC_WARM_BATCH	1024
+
+typedef struct arc_warm_write_arg {
+	arc_warm_phys_t		*awa_buf;	/* header, then entries */
+	uint64_t		awa_size;
+} arc_warm_write_arg_t;
+
+/*
+ * A block is only recorded if the ARC holds exactly the bytes that are on
+ * disk, so that we can checksum them.
+ */
+static boolean_t
+arc_warm_eligible(uint64_t guid, arc_buf_hdr_t *hdr)
+{
+	if (hdr->b_spa != guid || !HDR_HAS_L1HDR(hdr) ||
+	    hdr->b_l1hdr.b_state != arc_mfu ||
+	    hdr->b_l1hdr.b_pabd == NULL || HDR_IO_IN_PROGRESS(hdr) ||
+	    HDR_PROTECTED(hdr) || HDR_IO_ERROR(hdr) ||
+	    DVA_GET_GANG(&hdr->b_dva) ||
+	    hdr->b_l1hdr.b_byteswap != DMU_BSWAP_NUMFUNCS)
+		return (B_FALSE);
+
+	return (HDR_COMPRESSION_ENABLED(hdr) ||
+	    HDR_GET_COMPRESS(hdr) == ZIO_COMPRESS_OFF);
+}
+
+static void
+arc_warm_record(arc_buf_hdr_t *hdr, arc_warm_ent_phys_t *ent)
+{
+	ent->awe_dva = hdr->b_dva;
+	ent->awe_birth = hdr->b_birth;
+	ent->awe_prop = 0;
+	L2BLK_SET_LSIZE(ent->awe_prop, HDR_GET_LSIZE(hdr));
+	L2BLK_SET_PSIZE(ent->awe_prop, HDR_GET_PSIZE(hdr));
+	L2BLK_SET_COMPRESS(ent->awe_prop, HDR_GET_COMPRESS(hdr));
+	L2BLK_SET_TYPE(ent->awe_prop, arc_buf_type(hdr));
+	abd_fletcher_4_native(hdr->b_l1hdr.b_pabd, HDR_GET_PSIZE(hdr),
+	    NULL, &ent->awe_cksum);
+}
+
+/*
+ * Fill ents with up to max blocks of this pool from the MFU state,
+ * metadata first and most recently used first. Each sublist gets an even
+ * share of what is left so that the result is not skewed towards
+ * whichever sublists happen to be walked first.
+ */
+static uint64_t
+arc_warm_collect(spa_t *spa, zthr_t *zthr, arc_warm_ent_phys_t *ents,
+    uint64_t max)
+{
+	const arc_buf_contents_t types[] = { ARC_BUFC_METADATA, ARC_BUFC_DATA };
+	uint64_t guid = spa_load_guid(spa);
+	arc_buf_hdr_t *marker = arc_state_alloc_marker();
+	uint64_t count = 0;
+
+	for (int t = 0; t < ARRAY_SIZE(types); t++) {
+		multilist_t *ml = &arc_mfu->arcs_list[types[t]];
+		int num_sublists = multilist_get_num_sublists(ml);
+
+		for (int i = 0; i < num_sublists && count < max; i++) {
+			uint64_t left = num_sublists - i;
+			uint64_t limit =
+			    count + (max - count + left - 1) / left;
+
+			if (zthr_iscancelled(zthr))
+				goto out;
+
+			multilist_sublist_t *mls =
+			    multilist_sublist_lock_idx(ml, i);
+			arc_buf_hdr_t *hdr = multilist_sublist_head(mls);
+			while (hdr != NULL && count < limit) {
+				kmutex_t *hash_lock;
+
+				/* Markers have a b_spa of 0. */
+				if (hdr->b_spa != guid) {
+					hdr = multilist_sublist_next(mls, hdr);
+					continue;
+				}
+
+				hash_lock = HDR_LOCK(hdr);
+				if (!mutex_tryenter(hash_lock)) {
+					hdr = multilist_sublist_next(mls, hdr);
+					continue;
+				}
+
+				if (!arc_warm_eligible(guid, hdr)) {
+					mutex_exit(hash_lock);
+					hdr = multilist_sublist_next(mls, hdr);
+					continue;
+				}
+
+				/*
+				 * Don't checksum the data with the sublist
+				 * lock held, as that would hold up eviction;
+				 * the hash lock keeps the header in place.
+				 */
+				multilist_sublist_insert_after(mls, hdr,
+				    marker);
+				multilist_sublist_unlock(mls);
+
+				arc_warm_record(hdr, &ents[count++]);
+				mutex_exit(hash_lock);
+
+				mls = multilist_sublist_lock_idx(ml, i);
+				hdr = multilist_sublist_next(mls, marker);
+				multilist_sublist_remove(mls, marker);
+			}
+			multilist_sublist_unlock(mls);
+		}
+	}
+out:
+	arc_state_free_marker(marker);
+	return (count);
+}
+
+static void
+arc_warm_write_sync(void *arg, dmu_tx_t *tx)
+{
+	arc_warm_write_arg_t *awa = arg;
+	spa_t *spa = dmu_tx_pool(tx)->dp_spa;
+	objset_t *mos = spa->spa_meta_objset;
+	uint64_t obj;
+
+	if (spa->spa_arc_warm_obj != 0) {
+		VERIFY0(dmu_object_free(mos, spa->spa_arc_warm_obj, tx));
+		spa->spa_arc_warm_obj = 0;
+	}
+
+	obj = dmu_object_alloc(mos, DMU_OTN_UINT64_METADATA,
+	    SPA_OLD_MAXBLOCKSIZE, DMU_OT_NONE, 0, tx);
+
+	awa->awa_buf->awp_txg = dmu_tx_get_txg(tx);
+	for (uint64_t off = 0; off < awa->awa_size; ) {
+		uint64_t len = MIN(awa->awa_size - off, DMU_MAX_ACCESS / 2);
+		dmu_write(mos, obj, off, len, (char *)awa->awa_buf + off, tx);
+		off += len;
+	}
+
+	VERIFY0(zap_update(mos, DMU_POOL_DIRECTORY_OBJECT, DMU_POOL_ARC_WARM,
+	    sizeof (uint64_t), 1, &obj, tx));
+	spa->spa_arc_warm_obj = obj;
+}
+
+static void
+arc_warm_checkpoint(spa_t *spa, zthr_t *zthr)
+{
+	uint64_t max = zfs_arc_warm_max_blocks;
+	arc_warm_write_arg_t awa;
+	uint64_t count;
+
+	if (max == 0 || spa_suspended(spa))
+		return;
+
+	/* The header takes the place of the first entry. */
+	arc_warm_ent_phys_t *buf = vmem_zalloc((max + 1) * sizeof (*buf),
+	    KM_SLEEP);
+	count = arc_warm_collect(spa, zthr, &buf[1], max);
+	if (count == 0 || zthr_iscancelled(zthr))
+		goto out;
+
+	awa.awa_buf = (arc_warm_phys_t *)buf;
+	awa.awa_buf->awp_magic = ARC_WARM_MAGIC;
+	awa.awa_buf->awp_version = ARC_WARM_VERSION;
+	awa.awa_buf->awp_byteorder = ZFS_HOST_BYTEORDER;
+	awa.awa_buf->awp_count = count;
+	awa.awa_size = (count + 1) * sizeof (*buf);
+
+	if (dsl_sync_task(spa_name(spa), NULL, arc_warm_write_sync, &awa,
+	    1 + (awa.awa_size >> SPA_OLD_MAXBLOCKSHIFT),
+	    ZFS_SPACE_CHECK_NORMAL) == 0)
+		ARCSTAT_INCR(arcstat_warm_saved, count);
+out:
+	vmem_free(buf, (max + 1) * sizeof (*buf));
+}
+
+/*
+ * Turn a stored entry back into a block pointer that can be handed to
+ * arc_read(). Returns B_FALSE if the entry no longer looks readable.
+ */
+static boolean_t
+arc_warm_entry_to_bp(spa_t *spa, const arc_warm_ent_phys_t *ent,
+    blkptr_t *bp)
+{
+	uint64_t compress = L2BLK_GET_COMPRESS(ent->awe_prop);
+	arc_buf_contents_t type = L2BLK_GET_TYPE(ent->awe_prop);
+
+	if (ent->awe_birth == 0 || ent->awe_birth > spa_last_synced_txg(spa) ||
+	    compress >= ZIO_COMPRESS_FUNCTIONS ||
+	    (type != ARC_BUFC_DATA && type != ARC_BUFC_METADATA) ||
+	    DVA_GET_GANG(&ent->awe_dva) ||
+	    !zfs_dva_valid(spa, &ent->awe_dva, NULL))
+		return (B_FALSE);
+
+	BP_ZERO(bp);
+	bp->blk_dva[0] = ent->awe_dva;
+	BP_SET_BIRTH(bp, ent->awe_birth, ent->awe_birth);
+	BP_SET_LSIZE(bp, L2BLK_GET_LSIZE(ent->awe_prop));
+	BP_SET_PSIZE(bp, L2BLK_GET_PSIZE(ent->awe_prop));
+	BP_SET_COMPRESS(bp, compress);
+	BP_SET_CHECKSUM(bp, ZIO_CHECKSUM_FLETCHER_4);
+	BP_SET_TYPE(bp, type == ARC_BUFC_METADATA ?
+	    DMU_OTN_UINT64_METADATA : DMU_OTN_UINT64_DATA);
+	BP_SET_LEVEL(bp, 0);
+	BP_SET_BYTEORDER(bp, ZFS_HOST_BYTEORDER);
+	BP_SET_FILL(bp, 1);
+	bp->blk_cksum = ent->awe_cksum;
+
+	return (B_TRUE);
+}
+
+static void
+arc_warm_prefetch(spa_t *spa, zthr_t *zthr)
+{
+	objset_t *mos = spa->spa_meta_objset;
+	uint64_t obj = spa->spa_arc_warm_obj;
+	arc_warm_phys_t awp;
+	arc_warm_ent_phys_t *ents;
+	zbookmark_phys_t zb;
+	uint64_t issued = 0;
+
+	if (dmu_read(mos, obj, 0, sizeof (awp), &awp, DMU_READ_PREFETCH) != 0 ||
+	    awp.awp_magic != ARC_WARM_MAGIC ||
+	    awp.awp_version != ARC_WARM_VERSION ||
+	    awp.awp_byteorder != ZFS_HOST_BYTEORDER)
+		return;
+
+	SET_BOOKMARK(&zb, 0, 0, 0, 0);
+	ents = vmem_alloc(ARC_WARM_BATCH * sizeof (*ents), KM_SLEEP);
+
+	for (uint64_t i = 0; i < awp.awp_count; i += ARC_WARM_BATCH) {
+		uint64_t n = MIN(awp.awp_count - i, ARC_WARM_BATCH);
+
+		if (zthr_iscancelled(zthr) ||
+		    aggsum_upper_bound(&arc_sums.arcstat_size) >= arc_c)
+			break;
+
+		if (dmu_read(mos, obj, (i + 1) * sizeof (*ents),
+		    n * sizeof (*ents), ents, DMU_READ_PREFETCH) != 0)
+			break;
+
+		zio_t *pio = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+		spa_config_enter(spa, SCL_VDEV, FTAG, RW_READER);
+		for (uint64_t j = 0; j < n; j++) {
+			arc_flags_t aflags = ARC_FLAG_NOWAIT |
+			    ARC_FLAG_PREFETCH | ARC_FLAG_NO_BUF;
+			blkptr_t bp;
+
+			if (!arc_warm_entry_to_bp(spa, &ents[j], &bp))
+				continue;
+
+			(void) arc_read(pio, spa, &bp, NULL, NULL,
+			    ZIO_PRIORITY_ASYNC_READ,
+			    ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE, &aflags,
+			    &zb);
+			issued++;
+		}
+		spa_config_exit(spa, SCL_VDEV, FTAG);
+		(void) zio_wait(pio);
+	}
+
+	vmem_free(ents, ARC_WARM_BATCH * sizeof (*ents));
+	ARCSTAT_INCR(arcstat_warm_prefetched, issued);
+}
+
+static boolean_t
+arc_warm_cb_check(void *arg, zthr_t *zthr)
+{
+	(void) zthr;
+	spa_t *spa = arg;
+
+	if (spa->spa_arc_warm_pending)
+		return (B_TRUE);
+
+	return (zfs_arc_warm_interval != 0 && gethrtime() -
+	    spa->spa_arc_warm_last >= SEC2NSEC(zfs_arc_warm_interval));
+}
+
+static void
+arc_warm_cb(void *arg, zthr_t *zthr)
+{
+	spa_t *spa = arg;
+
+	if (spa->spa_arc_warm_pending) {
+		arc_warm_prefetch(spa, zthr);
+		spa->spa_arc_warm_pending = B_FALSE;
+	} else {
+		arc_warm_checkpoint(spa, zthr);
+	}
+	spa->spa_arc_warm_last = gethrtime();
+}
+
+/*
+ * Called once a writeable pool has finished loading, to prefetch the blocks
+ * recorded by the last checkpoint and to start taking new ones.
+ */
+void
+arc_warm_start(spa_t *spa)
+{
+	uint64_t obj = 0;
+	int err;
+
+	ASSERT(spa_writeable(spa));
+	ASSERT3P(spa->spa_arc_warm_zthr, ==, NULL);
+
+	err = zap_lookup(spa->spa_meta_objset, DMU_POOL_DIRECTORY_OBJECT,
+	    DMU_POOL_ARC_WARM, sizeof (uint64_t), 1, &obj);
+	spa->spa_arc_warm_obj = (err == 0) ? obj : 0;
+	spa->spa_arc_warm_pending = (obj != 0 && zfs_arc_warm_prefetch != 0);
+	spa->spa_arc_warm_last = gethrtime();
+
+	spa->spa_arc_warm_zthr = zthr_create_timer("arc_warm",
+	    arc_warm_cb_check, arc_warm_cb, spa, SEC2NSEC(1), minclsyspri);
+}
+
 /*
  * Level 2 ARC
  *
@@ -7887,8 +9292,9 @@ arc_fini(void)
  *
  * 6. Writes to the L2ARC devices are grouped and sent in-sequence, so that
  * the vdev queue can aggregate them into larger and fewer writes.  Each
- * device is written to in a rotor fashion, sweeping writes through
- * available space then repeating.
+ * device has its own feed thread, so devices are written in parallel, and is
+ * written to in a rotor fashion, sweeping writes through available space
+ * then repeating.
  *
  * 7. The L2ARC does not store dirty content.  It never needs to flush
  * write buffers back to disk based storage.
@@ -8029,11 +9435,51 @@ l2arc_write_eligible(uint64_t spa_guid, arc_buf_hdr_t *hdr)
 	 * 2. is already cached on the L2ARC.
 	 * 3. has an I/O in progress (it may be an incomplete read).
 	 * 4. is flagged not eligible (zfs property).
+	 * 5. has a logical size outside the admitted range.
+	 * 6. has not been hit often enough in the ARC.
 	 */
 	if (hdr->b_spa != spa_guid || HDR_HAS_L2HDR(hdr) ||
 	    HDR_IO_IN_PROGRESS(hdr) || !HDR_L2CACHE(hdr))
 		return (B_FALSE);
 
+	uint64_t lsize = HDR_GET_LSIZE(hdr);
+	if ((l2arc_admit_min_size != 0 && lsize < l2arc_admit_min_size) ||
+	    (l2arc_admit_max_size != 0 && lsize > l2arc_admit_max_size))
+		return (B_FALSE);
+
+	if (l2arc_admit_min_hits != 0 && HDR_HAS_L1HDR(hdr)) {
+		l1arc_buf_hdr_t *l1hdr = &hdr->b_l1hdr;
+		uint64_t hits = (uint64_t)l1hdr->b_mru_hits +
+		    l1hdr->b_mru_ghost_hits + l1hdr->b_mfu_hits +
+		    l1hdr->b_mfu_ghost_hits;
+		if (hits < l2arc_admit_min_hits)
+			return (B_FALSE);
+	}
+
+	return (B_TRUE);
+}
+
+/*
+ * Called by arc_evict_hdr() in exclusive mode for an L2ARC-eligible buffer
+ * that is about to be evicted.  Returns B_TRUE if the buffer should be left
+ * in the ARC for the feed to write out, as long as the bytes held back this
+ * feed interval fit in what the devices can write in one.
+ */
+static boolean_t
+l2arc_demote_defer(arc_buf_hdr_t *hdr)
+{
+	uint64_t ndev = l2arc_ndev;
+	uint64_t size = arc_hdr_size(hdr);
+
+	if (ndev == 0 || (l2arc_mfuonly && hdr->b_l1hdr.b_state != arc_mfu))
+		return (B_FALSE);
+
+	if (atomic_add_64_nv(&l2arc_demote_pending, size) >
+	    l2arc_write_max * ndev) {
+		atomic_add_64(&l2arc_demote_pending, -size);
+		return (B_FALSE);
+	}
+
 	return (B_TRUE);
 }
 
@@ -8103,79 +9549,21 @@ l2arc_write_interval(clock_t began, uint64_t wanted, uint64_t wrote)
 }
 
 /*
- * Cycle through L2ARC devices.  This is how L2ARC load balances.
- * If a device is returned, this also returns holding the spa config lock.
- */
-static l2arc_dev_t *
-l2arc_dev_get_next(void)
-{
-	l2arc_dev_t *first, *next = NULL;
-
-	/*
-	 * Lock out the removal of spas (spa_namespace_lock), then removal
-	 * of cache devices (l2arc_dev_mtx).  Once a device has been selected,
-	 * both locks will be dropped and a spa config lock held instead.
-	 */
-	mutex_enter(&spa_namespace_lock);
-	mutex_enter(&l2arc_dev_mtx);
-
-	/* if there are no vdevs, there is nothing to do */
-	if (l2arc_ndev == 0)
-		goto out;
-
-	first = NULL;
-	next = l2arc_dev_last;
-	do {
-		/* loop around the list looking for a non-faulted vdev */
-		if (next == NULL) {
-			next = list_head(l2arc_dev_list);
-		} else {
-			next = list_next(l2arc_dev_list, next);
-			if (next == NULL)
-				next = list_head(l2arc_dev_list);
-		}
-
-		/* if we have come back to the start, bail out */
-		if (first == NULL)
-			first = next;
-		else if (next == first)
-			break;
-
-		ASSERT3P(next, !=, NULL);
-	} while (vdev_is_dead(next->l2ad_vdev) || next->l2ad_rebuild ||
-	    next->l2ad_trim_all || next->l2ad_spa->spa_is_exporting);
-
-	/* if we were unable to find any usable vdevs, return NULL */
-	if (vdev_is_dead(next->l2ad_vdev) || next->l2ad_rebuild ||
-	    next->l2ad_trim_all || next->l2ad_spa->spa_is_exporting)
-		next = NULL;
-
-	l2arc_dev_last = next;
-
-out:
-	mutex_exit(&l2arc_dev_mtx);
-
-	/*
-	 * Grab the config lock to prevent the 'next' device from being
-	 * removed while we are writing to it.
-	 */
-	if (next != NULL)
-		spa_config_enter(next->l2ad_spa, SCL_L2ARC, next, RW_READER);
-	mutex_exit(&spa_namespace_lock);
-
-	return (next);
-}
-
-/*
- * Free buffers that were tagged for destruction.
+ * Free buffers that were tagged for destruction once their write to dev
+ * completed (or all of them, if dev is NULL). Each device has its own feed
+ * thread, so other devices may still have writes of their buffers in flight.
  */
 static void
-l2arc_do_free_on_write(void)
+l2arc_do_free_on_write(l2arc_dev_t *dev)
 {
-	l2arc_data_free_t *df;
+	l2arc_data_free_t *df, *df_next;
 
 	mutex_enter(&l2arc_free_on_write_mtx);
-	while ((df = list_remove_head(l2arc_free_on_write)) != NULL) {
+	for (df = list_head(l2arc_free_on_write); df != NULL; df = df_next) {
+		df_next = list_next(l2arc_free_on_write, df);
+		if (dev != NULL && df->l2df_dev != dev)
+			continue;
+		list_remove(l2arc_free_on_write, df);
 		ASSERT3P(df->l2df_abd, !=, NULL);
 		abd_free(df->l2df_abd);
 		kmem_free(df, sizeof (l2arc_data_free_t));
@@ -8364,7 +9752,7 @@ top:
 	ASSERT(dev->l2ad_vdev != NULL);
 	vdev_space_update(dev->l2ad_vdev, -bytes_dropped, 0, 0);
 
-	l2arc_do_free_on_write();
+	l2arc_do_free_on_write(dev);
 
 	kmem_free(cb, sizeof (l2arc_write_callback_t));
 }
@@ -8461,6 +9849,27 @@ error:
 }
 
 
+/*
+ * In exclusive mode, a buffer read back into the ARC gives up its L2ARC
+ * copy; it will be demoted again when it is next evicted.
+ */
+static void
+l2arc_exclusive_drop(arc_buf_hdr_t *hdr)
+{
+	ASSERT(MUTEX_HELD(HDR_LOCK(hdr)));
+
+	if (!HDR_HAS_L2HDR(hdr) || HDR_L2_WRITING(hdr))
+		return;
+
+	l2arc_dev_t *dev = hdr->b_l2hdr.b_dev;
+	mutex_enter(&dev->l2ad_mtx);
+	if (HDR_HAS_L2HDR(hdr)) {
+		arc_hdr_l2hdr_destroy(hdr);
+		ARCSTAT_BUMP(arcstat_l2_exclusive_drops);
+	}
+	mutex_exit(&dev->l2ad_mtx);
+}
+
 /*
  * A read to a cache device completed.  Validate buffer contents before
  * handing over to the regular ARC routines.
@@ -8552,6 +9961,8 @@ l2arc_read_done(zio_t *zio)
 
 	if (valid_cksum && tfm_error == 0 && zio->io_error == 0 &&
 	    !HDR_L2_EVICTED(hdr)) {
+		if (l2arc_exclusive)
+			l2arc_exclusive_drop(hdr);
 		mutex_exit(hash_lock);
 		zio->io_private = hdr;
 		arc_read_done(zio);
@@ -9042,7 +10453,7 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 {
 	arc_buf_hdr_t 		*hdr, *head, *marker;
 	uint64_t 		write_asize, write_psize, headroom;
-	boolean_t		full, from_head = !arc_warm;
+	boolean_t		full, from_head = !arc_warm && !l2arc_exclusive;
 	l2arc_write_callback_t	*cb = NULL;
 	zio_t 			*pio, *wzio;
 	uint64_t 		guid = spa_load_guid(spa);
@@ -9075,6 +10486,12 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 		if (zfs_compressed_arc_enabled)
 			headroom = (headroom * l2arc_headroom_boost) / 100;
 
+		/*
+		 * An exclusive L2ARC only takes what is about to be evicted.
+		 */
+		if (l2arc_exclusive)
+			headroom = target_sz;
+
 		/*
 		 * Until the ARC is warm and starts to evict, read from the
 		 * head of the ARC lists rather than the tail.
@@ -9184,13 +10601,14 @@ skip:
 					goto next;
 				}
 
-				l2arc_free_abd_on_write(to_write, asize, type);
+				l2arc_free_abd_on_write(dev, to_write, asize,
+				    type);
 			}
 
 			hdr->b_l2hdr.b_dev = dev;
 			hdr->b_l2hdr.b_daddr = dev->l2ad_hand;
-			hdr->b_l2hdr.b_hits = 0;
-			hdr->b_l2hdr.b_arcs_state =
+			hdr->b_l2hits = 0;
+			hdr->b_l2arcs_state =
 			    hdr->b_l1hdr.b_state->arcs_state;
 			mutex_enter(&dev->l2ad_mtx);
 			if (pio == NULL) {
@@ -9311,57 +10729,49 @@ l2arc_hdr_limit_reached(void)
 
 /*
  * This thread feeds the L2ARC at regular intervals.  This is the beating
- * heart of the L2ARC.
+ * heart of the L2ARC.  There is one per cache device, so that several
+ * devices are filled in parallel, each scanning the ARC lists on its own.
  */
 static  __attribute__((noreturn)) void
-l2arc_feed_thread(void *unused)
+l2arc_feed_thread(void *arg)
 {
-	(void) unused;
+	l2arc_dev_t *dev = arg;
+	spa_t *spa = dev->l2ad_spa;
 	callb_cpr_t cpr;
-	l2arc_dev_t *dev;
-	spa_t *spa;
 	uint64_t size, wrote;
 	clock_t begin, next = ddi_get_lbolt();
 	fstrans_cookie_t cookie;
 
-	CALLB_CPR_INIT(&cpr, &l2arc_feed_thr_lock, callb_generic_cpr, FTAG);
+	CALLB_CPR_INIT(&cpr, &dev->l2ad_feed_lock, callb_generic_cpr, FTAG);
 
-	mutex_enter(&l2arc_feed_thr_lock);
+	mutex_enter(&dev->l2ad_feed_lock);
 
 	cookie = spl_fstrans_mark();
-	while (l2arc_thread_exit == 0) {
+	while (!dev->l2ad_feed_exit) {
 		CALLB_CPR_SAFE_BEGIN(&cpr);
-		(void) cv_timedwait_idle(&l2arc_feed_thr_cv,
-		    &l2arc_feed_thr_lock, next);
-		CALLB_CPR_SAFE_END(&cpr, &l2arc_feed_thr_lock);
+		(void) cv_timedwait_idle(&dev->l2ad_feed_cv,
+		    &dev->l2ad_feed_lock, next);
+		CALLB_CPR_SAFE_END(&cpr, &dev->l2ad_feed_lock);
 		next = ddi_get_lbolt() + hz;
 
-		/*
-		 * Quick check for L2ARC devices.
-		 */
-		mutex_enter(&l2arc_dev_mtx);
-		if (l2arc_ndev == 0) {
-			mutex_exit(&l2arc_dev_mtx);
-			continue;
-		}
-		mutex_exit(&l2arc_dev_mtx);
+		if (dev->l2ad_feed_exit)
+			break;
 		begin = ddi_get_lbolt();
 
 		/*
-		 * This selects the next l2arc device to write to, and in
-		 * doing so the next spa to feed from: dev->l2ad_spa.   This
-		 * will return NULL if there are now no l2arc devices or if
-		 * they are all faulted.
-		 *
-		 * If a device is returned, its spa's config lock is also
-		 * held to prevent device removal.  l2arc_dev_get_next()
-		 * will grab and release l2arc_dev_mtx.
+		 * Hold the config lock to prevent the device from being
+		 * removed while we are writing to it.  Removal holds it as
+		 * writer while waiting for this thread to exit, so only try
+		 * for it, and come back later if it is taken.
 		 */
-		if ((dev = l2arc_dev_get_next()) == NULL)
+		if (!spa_config_tryenter(spa, SCL_L2ARC, dev, RW_READER))
 			continue;
 
-		spa = dev->l2ad_spa;
-		ASSERT3P(spa, !=, NULL);
+		if (vdev_is_dead(dev->l2ad_vdev) || dev->l2ad_rebuild ||
+		    dev->l2ad_trim_all || spa->spa_is_exporting) {
+			spa_config_exit(spa, SCL_L2ARC, dev);
+			continue;
+		}
 
 		/*
 		 * If the pool is read-only then force the feed thread to
@@ -9396,6 +10806,13 @@ l2arc_feed_thread(void *unused)
 		 */
 		wrote = l2arc_write_buffers(spa, dev, size);
 
+		/*
+		 * Whatever eviction held back for us has had its chance to
+		 * be written; let it hold back another interval's worth.
+		 */
+		if (l2arc_exclusive)
+			atomic_swap_64(&l2arc_demote_pending, 0);
+
 		/*
 		 * Calculate interval between writes.
 		 */
@@ -9404,12 +10821,31 @@ l2arc_feed_thread(void *unused)
 	}
 	spl_fstrans_unmark(cookie);
 
-	l2arc_thread_exit = 0;
-	cv_broadcast(&l2arc_feed_thr_cv);
-	CALLB_CPR_EXIT(&cpr);		/* drops l2arc_feed_thr_lock */
+	dev->l2ad_feed_exit = B_FALSE;
+	cv_broadcast(&dev->l2ad_feed_cv);
+	CALLB_CPR_EXIT(&cpr);		/* drops l2ad_feed_lock */
 	thread_exit();
 }
 
+/*
+ * Stop the feed thread of a device that is about to be removed.  The caller
+ * may hold the spa config lock as writer; the feed thread never blocks on it.
+ */
+static void
+l2arc_feed_stop(l2arc_dev_t *dev)
+{
+	if (dev->l2ad_feed_thread == NULL)
+		return;
+
+	mutex_enter(&dev->l2ad_feed_lock);
+	dev->l2ad_feed_exit = B_TRUE;
+	cv_signal(&dev->l2ad_feed_cv);
+	while (dev->l2ad_feed_exit)
+		cv_wait(&dev->l2ad_feed_cv, &dev->l2ad_feed_lock);
+	mutex_exit(&dev->l2ad_feed_lock);
+	dev->l2ad_feed_thread = NULL;
+}
+
 boolean_t
 l2arc_vdev_present(vdev_t *vd)
 {
@@ -9543,6 +10979,8 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	adddev->l2ad_dev_hdr = kmem_zalloc(l2dhdr_asize, KM_SLEEP);
 
 	mutex_init(&adddev->l2ad_mtx, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&adddev->l2ad_feed_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&adddev->l2ad_feed_cv, NULL, CV_DEFAULT, NULL);
 	/*
 	 * This is a list of all ARC buffers that are still valid on the
 	 * device.
@@ -9565,7 +11003,7 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	/*
 	 * Decide if dev is eligible for L2ARC rebuild or whole device
 	 * trimming. This has to happen before the device is added in the
-	 * cache device list and l2arc_dev_mtx is released. Otherwise
+	 * cache device list and its feed thread is started. Otherwise
 	 * l2arc_feed_thread() might already start writing on the
 	 * device.
 	 */
@@ -9578,6 +11016,11 @@ l2arc_add_vdev(spa_t *spa, vdev_t *vd)
 	list_insert_head(l2arc_dev_list, adddev);
 	atomic_inc_64(&l2arc_ndev);
 	mutex_exit(&l2arc_dev_mtx);
+
+	if (spa_mode_global & SPA_MODE_WRITE) {
+		adddev->l2ad_feed_thread = thread_create(NULL, 0,
+		    l2arc_feed_thread, adddev, 0, &p0, TS_RUN, defclsyspri);
+	}
 }
 
 /*
@@ -9635,12 +11078,16 @@ l2arc_remove_vdev(vdev_t *vd)
 	}
 	mutex_exit(&l2arc_rebuild_thr_lock);
 
+	/*
+	 * Stop feeding it.
+	 */
+	l2arc_feed_stop(remdev);
+
 	/*
 	 * Remove device from global list
 	 */
 	mutex_enter(&l2arc_dev_mtx);
 	list_remove(l2arc_dev_list, remdev);
-	l2arc_dev_last = NULL;		/* may have been invalidated */
 	atomic_dec_64(&l2arc_ndev);
 	mutex_exit(&l2arc_dev_mtx);
 
@@ -9652,6 +11099,8 @@ l2arc_remove_vdev(vdev_t *vd)
 	ASSERT(list_is_empty(&remdev->l2ad_lbptr_list));
 	list_destroy(&remdev->l2ad_lbptr_list);
 	mutex_destroy(&remdev->l2ad_mtx);
+	mutex_destroy(&remdev->l2ad_feed_lock);
+	cv_destroy(&remdev->l2ad_feed_cv);
 	zfs_refcount_destroy(&remdev->l2ad_alloc);
 	zfs_refcount_destroy(&remdev->l2ad_lb_asize);
 	zfs_refcount_destroy(&remdev->l2ad_lb_count);
@@ -9662,11 +11111,8 @@ l2arc_remove_vdev(vdev_t *vd)
 void
 l2arc_init(void)
 {
-	l2arc_thread_exit = 0;
 	l2arc_ndev = 0;
 
-	mutex_init(&l2arc_feed_thr_lock, NULL, MUTEX_DEFAULT, NULL);
-	cv_init(&l2arc_feed_thr_cv, NULL, CV_DEFAULT, NULL);
 	mutex_init(&l2arc_rebuild_thr_lock, NULL, MUTEX_DEFAULT, NULL);
 	cv_init(&l2arc_rebuild_thr_cv, NULL, CV_DEFAULT, NULL);
 	mutex_init(&l2arc_dev_mtx, NULL, MUTEX_DEFAULT, NULL);
@@ -9683,8 +11129,6 @@ l2arc_init(void)
 void
 l2arc_fini(void)
 {
-	mutex_destroy(&l2arc_feed_thr_lock);
-	cv_destroy(&l2arc_feed_thr_cv);
 	mutex_destroy(&l2arc_rebuild_thr_lock);
 	cv_destroy(&l2arc_rebuild_thr_cv);
 	mutex_destroy(&l2arc_dev_mtx);
@@ -9694,30 +11138,6 @@ l2arc_fini(void)
 	list_destroy(l2arc_free_on_write);
 }
 
-void
-l2arc_start(void)
-{
-	if (!(spa_mode_global & SPA_MODE_WRITE))
-		return;
-
-	(void) thread_create(NULL, 0, l2arc_feed_thread, NULL, 0, &p0,
-	    TS_RUN, defclsyspri);
-}
-
-void
-l2arc_stop(void)
-{
-	if (!(spa_mode_global & SPA_MODE_WRITE))
-		return;
-
-	mutex_enter(&l2arc_feed_thr_lock);
-	cv_signal(&l2arc_feed_thr_cv);	/* kick thread out of startup */
-	l2arc_thread_exit = 1;
-	while (l2arc_thread_exit != 0)
-		cv_wait(&l2arc_feed_thr_cv, &l2arc_feed_thr_lock);
-	mutex_exit(&l2arc_feed_thr_lock);
-}
-
 /*
  * Punches out rebuild threads for the L2ARC devices in a spa. This should
  * be called after pool import from the spa async thread, since starting
@@ -10289,8 +11709,9 @@ l2arc_hdr_restore(const l2arc_log_ent_phys_t *le, l2arc_dev_t *dev)
 			arc_hdr_set_flags(exists, ARC_FLAG_HAS_L2HDR);
 			exists->b_l2hdr.b_dev = dev;
 			exists->b_l2hdr.b_daddr = le->le_daddr;
-			exists->b_l2hdr.b_arcs_state =
+			exists->b_l2arcs_state =
 			    L2BLK_GET_STATE((le)->le_prop);
+			exists->b_l2hits = 0;
 			mutex_enter(&dev->l2ad_mtx);
 			list_insert_tail(&dev->l2ad_buflist, exists);
 			(void) zfs_refcount_add_many(&dev->l2ad_alloc,
@@ -10593,7 +12014,7 @@ l2arc_log_blk_insert(l2arc_dev_t *dev, const arc_buf_hdr_t *hdr)
 	L2BLK_SET_TYPE((le)->le_prop, hdr->b_type);
 	L2BLK_SET_PROTECTED((le)->le_prop, !!(HDR_PROTECTED(hdr)));
 	L2BLK_SET_PREFETCH((le)->le_prop, !!(HDR_PREFETCH(hdr)));
-	L2BLK_SET_STATE((le)->le_prop, hdr->b_l2hdr.b_arcs_state);
+	L2BLK_SET_STATE((le)->le_prop, hdr->b_l2arcs_state);
 
 	dev->l2ad_log_blk_payload_asize += vdev_psize_to_asize(dev->l2ad_vdev,
 	    HDR_GET_PSIZE(hdr));
@@ -10655,6 +12076,9 @@ ZFS_MODULE_PARAM_CALL(zfs_arc, zfs_arc_, min, param_set_arc_min,
 ZFS_MODULE_PARAM_CALL(zfs_arc, zfs_arc_, max, param_set_arc_max,
 	spl_param_get_u64, ZMOD_RW, "Maximum ARC size in bytes");
 
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, ghost_gain_max, UINT, ZMOD_RW,
+	"Max weight of ghost hits on a relatively small ghost list");
+
 ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, meta_balance, UINT, ZMOD_RW,
 	"Balance between metadata and data on ghost hits.");
 
@@ -10719,12 +12143,27 @@ ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, rebuild_enabled, INT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, rebuild_blocks_min_l2size, U64, ZMOD_RW,
 	"Min size in bytes to write rebuild log blocks in L2ARC");
 
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, exclusive, INT, ZMOD_RW,
+	"Use the L2ARC as a victim cache of buffers evicted from the ARC");
+
 ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, mfuonly, INT, ZMOD_RW,
 	"Cache only MFU data from ARC into L2ARC");
 
 ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, exclude_special, INT, ZMOD_RW,
 	"Exclude dbufs on special vdevs from being cached to L2ARC if set.");
 
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, exclude_ot, U64, ZMOD_RW,
+	"Mask of DMU object types whose data is not cached to L2ARC");
+
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, admit_min_size, U64, ZMOD_RW,
+	"Smallest logical block size cached to L2ARC (0 = no limit)");
+
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, admit_max_size, U64, ZMOD_RW,
+	"Largest logical block size cached to L2ARC (0 = no limit)");
+
+ZFS_MODULE_PARAM(zfs_l2arc, l2arc_, admit_min_hits, UINT, ZMOD_RW,
+	"ARC hits a buffer needs before it is cached to L2ARC");
+
 ZFS_MODULE_PARAM_CALL(zfs_arc, zfs_arc_, lotsfree_percent, param_set_arc_int,
 	param_get_uint, ZMOD_RW, "System free memory I/O throttle in bytes");
 
@@ -10744,6 +12183,33 @@ ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, dnode_reduce_percent, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, eviction_pct, UINT, ZMOD_RW,
 	"When full, ARC allocation waits for eviction of this % of alloc size");
 
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, admit_min_freq, UINT, ZMOD_RW,
+	"Recent uses needed to cache blocks of cacheadmit=frequent datasets");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, dcache_max_bytes, U64, ZMOD_RW,
+	"Max bytes of decompressed copies of hot compressed blocks");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, dcache_shift, UINT, ZMOD_RW,
+	"Limit decompressed copies to this log2 fraction of the ARC target");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, dcache_min_hits, UINT, ZMOD_RW,
+	"MFU hits needed before a decompressed copy of a block is kept");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, warm_interval, UINT, ZMOD_RW,
+	"Seconds between checkpoints of the MFU block set, 0 to disable");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, warm_max_blocks, UINT, ZMOD_RW,
+	"Max blocks recorded in each ARC warm-start checkpoint");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, warm_prefetch, INT, ZMOD_RW,
+	"Prefetch the last checkpointed MFU block set at import");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, numa, INT, ZMOD_RD,
+	"Keep ARC eviction lists per NUMA node");
+
+ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, evict_threads, UINT, ZMOD_RD,
+	"Max threads to evict from the ARC with, 0 to size by CPU count");
+
 ZFS_MODULE_PARAM(zfs_arc, zfs_arc_, evict_batch_limit, UINT, ZMOD_RW,
 	"The number of headers to evict per sublist before moving to the next");
 
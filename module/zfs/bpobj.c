@@ -31,6 +31,16 @@
 #include <sys/zfeature.h>
 #include <sys/zap.h>
 
+/*
+ * When a bpobj is enqueued as a subobj of another (e.g. when deadlists are
+ * merged on snapshot destroy), its block pointers and its own subobj list
+ * are copied into the parent instead if they span at most this many data
+ * blocks. This keeps chains of small subobjs from building up, so that a
+ * later bpobj_iterate() reads a few long, sequential objects rather than
+ * many tiny ones, at the cost of reading the small ones once now.
+ */
+static uint_t zfs_bpobj_copy_max_blocks = 4;
+
 /*
  * Return an empty bpobj, preferably the empty dummy one (dp_empty_bpobj).
  */
@@ -668,6 +678,35 @@ livelist_bpobj_iterate_from_nofree(bpobj_t *bpo, bpobj_itor_t func, void *arg,
  * | bp | bp | bp | bp |   ...   | bp |
  * +----+----+----+----+---------+----+
  */
+static boolean_t
+bpobj_copy_fits(const dmu_object_info_t *doi)
+{
+	return (doi->doi_max_offset <= doi->doi_data_block_size *
+	    MAX(zfs_bpobj_copy_max_blocks, 1));
+}
+
+/*
+ * Append the first len bytes of srcobj to dstobj at dstoff.
+ */
+static void
+bpobj_copy_range(objset_t *os, uint64_t srcobj, uint64_t dstobj,
+    uint64_t dstoff, uint64_t len, dmu_tx_t *tx)
+{
+	uint64_t off = 0;
+
+	while (off < len) {
+		dmu_buf_t *db;
+		uint64_t n;
+
+		VERIFY0(dmu_buf_hold(os, srcobj, off, FTAG, &db, 0));
+		n = MIN(len - off, db->db_offset + db->db_size - off);
+		dmu_write(os, dstobj, dstoff + off, n,
+		    (char *)db->db_data + (off - db->db_offset), tx);
+		dmu_buf_rele(db, FTAG);
+		off += n;
+	}
+}
+
 void
 bpobj_enqueue_subobj(bpobj_t *bpo, uint64_t subobj, dmu_tx_t *tx)
 {
@@ -708,51 +747,43 @@ bpobj_enqueue_subobj(bpobj_t *bpo, uint64_t subobj, dmu_tx_t *tx)
 	}
 
 	/*
-	 * If subobj has only one block of subobjs, then move subobj's
-	 * subobjs to bpo's subobj list directly.  This reduces recursion in
-	 * bpobj_iterate due to nested subobjs.
+	 * If subobj has only a few blocks of subobjs (see
+	 * zfs_bpobj_copy_max_blocks), then move subobj's subobjs to bpo's
+	 * subobj list directly.  This reduces recursion in bpobj_iterate
+	 * due to nested subobjs.
 	 */
 	subsubobjs = subbpo.bpo_phys->bpo_subobjs;
 	if (subsubobjs != 0) {
 		VERIFY0(dmu_object_info(bpo->bpo_os, subsubobjs, &doi));
-		if (doi.doi_max_offset > doi.doi_data_block_size) {
+		if (!bpobj_copy_fits(&doi)) {
 			copy_subsub = B_FALSE;
 		}
 	}
 
 	/*
-	 * If, in addition to having only one block of subobj's, subobj has
-	 * only one block of bp's, then move subobj's bp's to bpo's bp list
-	 * directly. This reduces recursion in bpobj_iterate due to nested
-	 * subobjs.
+	 * If, in addition to having only a few blocks of subobj's, subobj
+	 * has only a few blocks of bp's, then move subobj's bp's to bpo's bp
+	 * list directly. This reduces recursion in bpobj_iterate due to
+	 * nested subobjs.
 	 */
 	VERIFY3U(0, ==, dmu_object_info(bpo->bpo_os, subobj, &doi));
-	if (doi.doi_max_offset > doi.doi_data_block_size || !copy_subsub) {
+	if (!bpobj_copy_fits(&doi) || !copy_subsub) {
 		copy_bps = B_FALSE;
 	}
 
 	if (copy_subsub && subsubobjs != 0) {
-		dmu_buf_t *subdb;
 		uint64_t numsubsub = subbpo.bpo_phys->bpo_num_subobjs;
 
-		VERIFY0(dmu_buf_hold(bpo->bpo_os, subsubobjs,
-		    0, FTAG, &subdb, 0));
-		/*
-		 * Make sure that we are not asking dmu_write()
-		 * to write more data than we have in our buffer.
-		 */
-		VERIFY3U(subdb->db_size, >=,
-		    numsubsub * sizeof (subobj));
 		if (bpo->bpo_phys->bpo_subobjs == 0) {
 			bpo->bpo_phys->bpo_subobjs =
 			    dmu_object_alloc(bpo->bpo_os,
 			    DMU_OT_BPOBJ_SUBOBJ, SPA_OLD_MAXBLOCKSIZE,
 			    DMU_OT_NONE, 0, tx);
 		}
-		dmu_write(bpo->bpo_os, bpo->bpo_phys->bpo_subobjs,
+		bpobj_copy_range(bpo->bpo_os, subsubobjs,
+		    bpo->bpo_phys->bpo_subobjs,
 		    bpo->bpo_phys->bpo_num_subobjs * sizeof (subobj),
-		    numsubsub * sizeof (subobj), subdb->db_data, tx);
-		dmu_buf_rele(subdb, FTAG);
+		    numsubsub * sizeof (subobj), tx);
 		bpo->bpo_phys->bpo_num_subobjs += numsubsub;
 
 		dmu_buf_will_dirty(subbpo.bpo_dbuf, tx);
@@ -761,23 +792,12 @@ bpobj_enqueue_subobj(bpobj_t *bpo, uint64_t subobj, dmu_tx_t *tx)
 	}
 
 	if (copy_bps) {
-		dmu_buf_t *bps;
 		uint64_t numbps = subbpo.bpo_phys->bpo_num_blkptrs;
 
 		ASSERT(copy_subsub);
-		VERIFY0(dmu_buf_hold(bpo->bpo_os, subobj,
-		    0, FTAG, &bps, 0));
-
-		/*
-		 * Make sure that we are not asking dmu_write()
-		 * to write more data than we have in our buffer.
-		 */
-		VERIFY3U(bps->db_size, >=, numbps * sizeof (blkptr_t));
-		dmu_write(bpo->bpo_os, bpo->bpo_object,
+		bpobj_copy_range(bpo->bpo_os, subobj, bpo->bpo_object,
 		    bpo->bpo_phys->bpo_num_blkptrs * sizeof (blkptr_t),
-		    numbps * sizeof (blkptr_t),
-		    bps->db_data, tx);
-		dmu_buf_rele(bps, FTAG);
+		    numbps * sizeof (blkptr_t), tx);
 		bpo->bpo_phys->bpo_num_blkptrs += numbps;
 
 		bpobj_close(&subbpo);
@@ -812,7 +832,7 @@ bpobj_prefetch_subobj(bpobj_t *bpo, uint64_t subobj)
 {
 	dmu_object_info_t doi;
 	bpobj_t subbpo;
-	uint64_t subsubobjs;
+	uint64_t subsubobjs, subsublen = 0;
 	boolean_t copy_subsub = B_TRUE;
 	boolean_t copy_bps = B_TRUE;
 
@@ -834,13 +854,14 @@ bpobj_prefetch_subobj(bpobj_t *bpo, uint64_t subobj)
 	if (subsubobjs != 0) {
 		if (dmu_object_info(bpo->bpo_os, subsubobjs, &doi) != 0)
 			return;
-		if (doi.doi_max_offset > doi.doi_data_block_size)
+		if (!bpobj_copy_fits(&doi))
 			copy_subsub = B_FALSE;
+		subsublen = doi.doi_max_offset;
 	}
 
 	if (dmu_object_info(bpo->bpo_os, subobj, &doi) != 0)
 		return;
-	if (doi.doi_max_offset > doi.doi_data_block_size || !copy_subsub)
+	if (!bpobj_copy_fits(&doi) || !copy_subsub)
 		copy_bps = B_FALSE;
 
 	if (copy_subsub && subsubobjs != 0) {
@@ -849,7 +870,7 @@ bpobj_prefetch_subobj(bpobj_t *bpo, uint64_t subobj)
 			    bpo->bpo_phys->bpo_num_subobjs * sizeof (subobj), 1,
 			    ZIO_PRIORITY_ASYNC_READ);
 		}
-		dmu_prefetch(bpo->bpo_os, subsubobjs, 0, 0, 1,
+		dmu_prefetch(bpo->bpo_os, subsubobjs, 0, 0, subsublen,
 		    ZIO_PRIORITY_ASYNC_READ);
 	}
 
@@ -857,7 +878,7 @@ bpobj_prefetch_subobj(bpobj_t *bpo, uint64_t subobj)
 		dmu_prefetch(bpo->bpo_os, bpo->bpo_object, 0,
 		    bpo->bpo_phys->bpo_num_blkptrs * sizeof (blkptr_t), 1,
 		    ZIO_PRIORITY_ASYNC_READ);
-		dmu_prefetch(bpo->bpo_os, subobj, 0, 0, 1,
+		dmu_prefetch(bpo->bpo_os, subobj, 0, 0, doi.doi_max_offset,
 		    ZIO_PRIORITY_ASYNC_READ);
 	} else if (bpo->bpo_phys->bpo_subobjs) {
 		dmu_prefetch(bpo->bpo_os, bpo->bpo_phys->bpo_subobjs, 0,
@@ -1029,3 +1050,6 @@ bplist_append_cb(void *arg, const blkptr_t *bp, boolean_t bp_freed,
 	bplist_append(bpl, bp);
 	return (0);
 }
+
+ZFS_MODULE_PARAM(zfs, zfs_, bpobj_copy_max_blocks, UINT, ZMOD_RW,
+	"Max blocks of a bpobj to copy into its parent instead of linking it");
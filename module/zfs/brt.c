@@ -250,6 +250,11 @@ static kmem_cache_t *brt_pending_entry_cache;
  */
 static int brt_zap_prefetch = 1;
 
+/*
+ * Write out BRT entry changes for different vdevs in parallel.
+ */
+static int brt_sync_parallel = 1;
+
 #ifdef ZFS_DEBUG
 #define	BRT_DEBUG(...)	do {						\
 	if ((zfs_flags & ZFS_DEBUG_BRT) != 0) {				\
@@ -269,7 +274,7 @@ typedef struct brt_stats {
 	kstat_named_t brt_addref_entry_in_memory;
 	kstat_named_t brt_addref_entry_not_on_disk;
 	kstat_named_t brt_addref_entry_on_disk;
-	kstat_named_t brt_addref_entry_read_lost_race;
+	kstat_named_t brt_addref_entry_deferred;
 	kstat_named_t brt_decref_entry_in_memory;
 	kstat_named_t brt_decref_entry_loaded_from_disk;
 	kstat_named_t brt_decref_entry_not_in_memory;
@@ -285,7 +290,7 @@ static brt_stats_t brt_stats = {
 	{ "addref_entry_in_memory",		KSTAT_DATA_UINT64 },
 	{ "addref_entry_not_on_disk",		KSTAT_DATA_UINT64 },
 	{ "addref_entry_on_disk",		KSTAT_DATA_UINT64 },
-	{ "addref_entry_read_lost_race",	KSTAT_DATA_UINT64 },
+	{ "addref_entry_deferred",		KSTAT_DATA_UINT64 },
 	{ "decref_entry_in_memory",		KSTAT_DATA_UINT64 },
 	{ "decref_entry_loaded_from_disk",	KSTAT_DATA_UINT64 },
 	{ "decref_entry_not_in_memory",		KSTAT_DATA_UINT64 },
@@ -301,7 +306,7 @@ struct {
 	wmsum_t brt_addref_entry_in_memory;
 	wmsum_t brt_addref_entry_not_on_disk;
 	wmsum_t brt_addref_entry_on_disk;
-	wmsum_t brt_addref_entry_read_lost_race;
+	wmsum_t brt_addref_entry_deferred;
 	wmsum_t brt_decref_entry_in_memory;
 	wmsum_t brt_decref_entry_loaded_from_disk;
 	wmsum_t brt_decref_entry_not_in_memory;
@@ -388,6 +393,269 @@ brt_vdev_entcount_dec(brt_vdev_t *brtvd, uint64_t idx)
 	brt_vdev_entcount_set(brtvd, idx, entcnt - 1);
 }
 
+static inline uint64_t
+brt_bloom_mix(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return (x);
+}
+
+/*
+ * Find the filter block for an offset, and the bits within it. Each of the
+ * BRT_BLOOM_HASHES bit numbers is 9 bits of a second hash.
+ */
+static uint64_t *
+brt_bloom_block(const brt_vdev_t *brtvd, uint64_t offset, uint64_t *bitsp)
+{
+	uint64_t h = brt_bloom_mix(offset);
+
+	*bitsp = brt_bloom_mix(h ^ offset);
+	return (&brtvd->bv_bloom[(h % brtvd->bv_bloom_nblocks) *
+	    BRT_BLOOM_BLOCK_WORDS]);
+}
+
+static void
+brt_bloom_add(brt_vdev_t *brtvd, uint64_t offset)
+{
+	uint64_t *blk, bits;
+
+	if (brtvd->bv_bloom == NULL)
+		return;
+
+	blk = brt_bloom_block(brtvd, offset, &bits);
+	for (int i = 0; i < BRT_BLOOM_HASHES; i++, bits >>= 9) {
+		uint_t bit = bits % BRT_BLOOM_BLOCK_BITS;
+		blk[bit / 64] |= 1ULL << (bit % 64);
+	}
+
+	BT_SET(brtvd->bv_bloom_bitmap,
+	    (blk - brtvd->bv_bloom) * sizeof (uint64_t) / BRT_BLOCKSIZE);
+	brtvd->bv_bloom_nentries++;
+	brtvd->bv_bloom_dirty = TRUE;
+}
+
+/*
+ * Returns B_FALSE if the offset definitely has no BRT entry.
+ */
+static boolean_t
+brt_bloom_check(const brt_vdev_t *brtvd, uint64_t offset)
+{
+	uint64_t *blk, bits;
+
+	if (brtvd->bv_bloom == NULL)
+		return (B_TRUE);
+
+	blk = brt_bloom_block(brtvd, offset, &bits);
+	for (int i = 0; i < BRT_BLOOM_HASHES; i++, bits >>= 9) {
+		uint_t bit = bits % BRT_BLOOM_BLOCK_BITS;
+		if (!(blk[bit / 64] & (1ULL << (bit % 64))))
+			return (B_FALSE);
+	}
+
+	return (B_TRUE);
+}
+
+static void
+brt_bloom_alloc(brt_vdev_t *brtvd, uint64_t nblocks)
+{
+	ASSERT3P(brtvd->bv_bloom, ==, NULL);
+	ASSERT3U(nblocks, >=, BRT_BLOOM_MIN_BLOCKS);
+
+	brtvd->bv_bloom = vmem_zalloc(BRT_BLOOM_SIZE(nblocks), KM_SLEEP);
+	brtvd->bv_bloom_bitmap =
+	    kmem_zalloc(BT_SIZEOFMAP(BRT_BLOOM_NCHUNKS(nblocks)), KM_SLEEP);
+	brtvd->bv_bloom_nblocks = nblocks;
+	brtvd->bv_bloom_nentries = 0;
+	brtvd->bv_bloom_dirty = FALSE;
+}
+
+static void
+brt_bloom_free(brt_vdev_t *brtvd)
+{
+	if (brtvd->bv_bloom == NULL)
+		return;
+
+	vmem_free(brtvd->bv_bloom, BRT_BLOOM_SIZE(brtvd->bv_bloom_nblocks));
+	kmem_free(brtvd->bv_bloom_bitmap,
+	    BT_SIZEOFMAP(BRT_BLOOM_NCHUNKS(brtvd->bv_bloom_nblocks)));
+	brtvd->bv_bloom = NULL;
+	brtvd->bv_bloom_bitmap = NULL;
+	brtvd->bv_bloom_nblocks = 0;
+	brtvd->bv_bloom_nentries = 0;
+	brtvd->bv_bloom_dirty = FALSE;
+}
+
+static void
+brt_bloom_name(const brt_vdev_t *brtvd, char *name, size_t len)
+{
+	snprintf(name, len, "%s%llu", BRT_OBJECT_BLOOM_PREFIX,
+	    (u_longlong_t)brtvd->bv_vdevid);
+}
+
+/*
+ * Load the filter, if there is one. Without it, we just carry on using
+ * bv_entcount[] alone.
+ */
+static void
+brt_bloom_load(brt_t *brt, brt_vdev_t *brtvd)
+{
+	char name[64];
+	dmu_buf_t *db;
+	brt_bloom_phys_t *bbphys;
+	int error;
+
+	brt_bloom_name(brtvd, name, sizeof (name));
+	error = zap_lookup(brt->brt_mos, DMU_POOL_DIRECTORY_OBJECT, name,
+	    sizeof (uint64_t), 1, &brtvd->bv_mos_bloom);
+	if (error != 0)
+		return;
+
+	error = dmu_bonus_hold(brt->brt_mos, brtvd->bv_mos_bloom, FTAG, &db);
+	ASSERT0(error);
+	if (error != 0)
+		return;
+
+	bbphys = db->db_data;
+	brt_bloom_alloc(brtvd, bbphys->bbp_nblocks);
+	brtvd->bv_bloom_nentries = bbphys->bbp_nentries;
+	dmu_buf_rele(db, FTAG);
+
+	error = dmu_read(brt->brt_mos, brtvd->bv_mos_bloom, 0,
+	    BRT_BLOOM_SIZE(brtvd->bv_bloom_nblocks), brtvd->bv_bloom,
+	    DMU_READ_PREFETCH);
+	if (error != 0) {
+		/* Can't trust a partial filter; do without. */
+		brt_bloom_free(brtvd);
+	}
+}
+
+/*
+ * (Re)build the filter from the entries ZAP, sized for twice the number of
+ * entries it has now.
+ */
+static void
+brt_bloom_build(brt_t *brt, brt_vdev_t *brtvd)
+{
+	zap_cursor_t zc;
+	zap_attribute_t *za;
+	uint64_t count, nblocks;
+
+	VERIFY0(zap_count(brt->brt_mos, brtvd->bv_mos_entries, &count));
+
+	nblocks = MAX(BRT_BLOOM_MIN_BLOCKS, (count * 2 *
+	    BRT_BLOOM_BITS_PER_ENTRY - 1) / BRT_BLOOM_BLOCK_BITS + 1);
+
+	brt_bloom_free(brtvd);
+	brt_bloom_alloc(brtvd, nblocks);
+
+	za = kmem_alloc(sizeof (*za), KM_SLEEP);
+	for (zap_cursor_init(&zc, brt->brt_mos, brtvd->bv_mos_entries);
+	    zap_cursor_retrieve(&zc, za) == 0;
+	    zap_cursor_advance(&zc)) {
+		brt_bloom_add(brtvd, *(uint64_t *)za->za_name);
+	}
+	zap_cursor_fini(&zc);
+	kmem_free(za, sizeof (*za));
+
+	memset(brtvd->bv_bloom_bitmap, 0xff,
+	    BT_SIZEOFMAP(BRT_BLOOM_NCHUNKS(nblocks)));
+	BRT_DEBUG("BRT VDEV %llu filter built: nblocks=%llu entries=%llu",
+	    (u_longlong_t)brtvd->bv_vdevid, (u_longlong_t)nblocks,
+	    (u_longlong_t)count);
+}
+
+/*
+ * Called once the VDEV's entries have been synced. Creates the filter if the
+ * feature is enabled and there isn't one yet, rebuilds it if it's full, and
+ * writes out whatever changed.
+ */
+static void
+brt_bloom_sync(brt_t *brt, brt_vdev_t *brtvd, dmu_tx_t *tx)
+{
+	char name[64];
+	dmu_buf_t *db;
+	brt_bloom_phys_t *bbphys;
+	uint64_t oldsize = 0;
+
+	ASSERT(RW_WRITE_HELD(&brt->brt_lock));
+	ASSERT(brtvd->bv_mos_entries != 0);
+
+	if (brtvd->bv_mos_bloom == 0) {
+		if (!spa_feature_is_enabled(brt->brt_spa,
+		    SPA_FEATURE_BRT_FILTER))
+			return;
+
+		brtvd->bv_mos_bloom = dmu_object_alloc(brt->brt_mos,
+		    DMU_OTN_UINT64_METADATA, BRT_BLOCKSIZE,
+		    DMU_OTN_UINT64_METADATA, sizeof (brt_bloom_phys_t), tx);
+		VERIFY(brtvd->bv_mos_bloom != 0);
+
+		brt_bloom_name(brtvd, name, sizeof (name));
+		VERIFY0(zap_add(brt->brt_mos, DMU_POOL_DIRECTORY_OBJECT, name,
+		    sizeof (uint64_t), 1, &brtvd->bv_mos_bloom, tx));
+		spa_feature_incr(brt->brt_spa, SPA_FEATURE_BRT_FILTER, tx);
+
+		brt_bloom_build(brt, brtvd);
+	} else if (brtvd->bv_bloom == NULL ||
+	    brtvd->bv_bloom_nentries >
+	    BRT_BLOOM_CAPACITY(brtvd->bv_bloom_nblocks)) {
+		if (brtvd->bv_bloom != NULL)
+			oldsize = BRT_BLOOM_SIZE(brtvd->bv_bloom_nblocks);
+		brt_bloom_build(brt, brtvd);
+	}
+
+	if (!brtvd->bv_bloom_dirty)
+		return;
+
+	uint64_t nchunks = BRT_BLOOM_NCHUNKS(brtvd->bv_bloom_nblocks);
+	uint64_t size = BRT_BLOOM_SIZE(brtvd->bv_bloom_nblocks);
+	for (uint64_t c = 0; c < nchunks; c++) {
+		if (!BT_TEST(brtvd->bv_bloom_bitmap, c))
+			continue;
+		uint64_t off = c * BRT_BLOCKSIZE;
+		dmu_write(brt->brt_mos, brtvd->bv_mos_bloom, off,
+		    MIN(BRT_BLOCKSIZE, size - off),
+		    (char *)brtvd->bv_bloom + off, tx);
+	}
+	memset(brtvd->bv_bloom_bitmap, 0, BT_SIZEOFMAP(nchunks));
+	if (oldsize > size) {
+		VERIFY0(dmu_free_range(brt->brt_mos, brtvd->bv_mos_bloom,
+		    size, oldsize - size, tx));
+	}
+
+	VERIFY0(dmu_bonus_hold(brt->brt_mos, brtvd->bv_mos_bloom, FTAG, &db));
+	dmu_buf_will_dirty(db, tx);
+	bbphys = db->db_data;
+	bbphys->bbp_nblocks = brtvd->bv_bloom_nblocks;
+	bbphys->bbp_nentries = brtvd->bv_bloom_nentries;
+	dmu_buf_rele(db, FTAG);
+
+	brtvd->bv_bloom_dirty = FALSE;
+}
+
+static void
+brt_bloom_destroy(brt_t *brt, brt_vdev_t *brtvd, dmu_tx_t *tx)
+{
+	char name[64];
+
+	ASSERT(RW_WRITE_HELD(&brt->brt_lock));
+
+	if (brtvd->bv_mos_bloom == 0)
+		return;
+
+	VERIFY0(dmu_object_free(brt->brt_mos, brtvd->bv_mos_bloom, tx));
+	brtvd->bv_mos_bloom = 0;
+
+	brt_bloom_name(brtvd, name, sizeof (name));
+	VERIFY0(zap_remove(brt->brt_mos, DMU_POOL_DIRECTORY_OBJECT, name, tx));
+
+	spa_feature_decr(brt->brt_spa, SPA_FEATURE_BRT_FILTER, tx);
+}
+
 #ifdef ZFS_DEBUG
 static void
 brt_vdev_dump(brt_vdev_t *brtvd)
@@ -599,6 +867,8 @@ brt_vdev_load(brt_t *brt, brt_vdev_t *brtvd)
 
 	dmu_buf_rele(db, FTAG);
 
+	brt_bloom_load(brt, brtvd);
+
 	BRT_DEBUG("MOS BRT VDEV %s loaded: mos_brtvdev=%llu, mos_entries=%llu",
 	    name, (u_longlong_t)brtvd->bv_mos_brtvdev,
 	    (u_longlong_t)brtvd->bv_mos_entries);
@@ -615,6 +885,7 @@ brt_vdev_dealloc(brt_t *brt, brt_vdev_t *brtvd)
 	brtvd->bv_entcount = NULL;
 	kmem_free(brtvd->bv_bitmap, BT_SIZEOFMAP(brtvd->bv_nblocks));
 	brtvd->bv_bitmap = NULL;
+	brt_bloom_free(brtvd);
 	ASSERT0(avl_numnodes(&brtvd->bv_tree));
 	avl_destroy(&brtvd->bv_tree);
 
@@ -661,6 +932,8 @@ brt_vdev_destroy(brt_t *brt, brt_vdev_t *brtvd, dmu_tx_t *tx)
 	VERIFY0(zap_remove(brt->brt_mos, DMU_POOL_DIRECTORY_OBJECT, name, tx));
 	BRT_DEBUG("Pool directory object removed, object=%s", name);
 
+	brt_bloom_destroy(brt, brtvd, tx);
+
 	brt_vdev_dealloc(brt, brtvd);
 
 	spa_feature_decr(brt->brt_spa, SPA_FEATURE_BLOCK_CLONING, tx);
@@ -708,29 +981,23 @@ brt_vdev_lookup(brt_t *brt, brt_vdev_t *brtvd, const brt_entry_t *bre)
 	idx = bre->bre_offset / brt->brt_rangesize;
 	if (brtvd->bv_entcount != NULL && idx < brtvd->bv_size) {
 		/* VDEV wasn't expanded. */
-		return (brt_vdev_entcount_get(brtvd, idx) > 0);
+		return (brt_vdev_entcount_get(brtvd, idx) > 0 &&
+		    brt_bloom_check(brtvd, bre->bre_offset));
 	}
 
 	return (FALSE);
 }
 
+/*
+ * Account for a block getting its first BRT reference.
+ */
 static void
-brt_vdev_addref(brt_t *brt, brt_vdev_t *brtvd, const brt_entry_t *bre,
+brt_vdev_addentry(brt_t *brt, brt_vdev_t *brtvd, const brt_entry_t *bre,
     uint64_t dsize)
 {
 	uint64_t idx;
 
 	ASSERT(RW_LOCK_HELD(&brt->brt_lock));
-	ASSERT(brtvd != NULL);
-	ASSERT(brtvd->bv_entcount != NULL);
-
-	brt->brt_savedspace += dsize;
-	brtvd->bv_savedspace += dsize;
-	brtvd->bv_meta_dirty = TRUE;
-
-	if (bre->bre_refcount > 1) {
-		return;
-	}
 
 	brt->brt_usedspace += dsize;
 	brtvd->bv_usedspace += dsize;
@@ -749,12 +1016,37 @@ brt_vdev_addref(brt_t *brt, brt_vdev_t *brtvd, const brt_entry_t *bre,
 	idx = idx / BRT_BLOCKSIZE / 8;
 	BT_SET(brtvd->bv_bitmap, idx);
 
+	brt_bloom_add(brtvd, bre->bre_offset);
+
 #ifdef ZFS_DEBUG
 	if (zfs_flags & ZFS_DEBUG_BRT)
 		brt_vdev_dump(brtvd);
 #endif
 }
 
+static void
+brt_vdev_addref(brt_t *brt, brt_vdev_t *brtvd, const brt_entry_t *bre,
+    uint64_t dsize)
+{
+	ASSERT(RW_LOCK_HELD(&brt->brt_lock));
+	ASSERT(brtvd != NULL);
+	ASSERT(brtvd->bv_entcount != NULL);
+
+	brt->brt_savedspace += dsize;
+	brtvd->bv_savedspace += dsize;
+	brtvd->bv_meta_dirty = TRUE;
+
+	/*
+	 * If the on-disk refcount isn't known yet, we can't tell if this is
+	 * the first reference; brt_entry_merge() will sort it out.
+	 */
+	if (bre->bre_pcount > 0 || bre->bre_refcount > 1) {
+		return;
+	}
+
+	brt_vdev_addentry(brt, brtvd, bre, dsize);
+}
+
 static void
 brt_vdev_decref(brt_t *brt, brt_vdev_t *brtvd, const brt_entry_t *bre,
     uint64_t dsize)
@@ -883,6 +1175,8 @@ brt_entry_fill(const blkptr_t *bp, brt_entry_t *bre, uint64_t *vdevidp)
 
 	bre->bre_offset = DVA_GET_OFFSET(&bp->blk_dva[0]);
 	bre->bre_refcount = 0;
+	bre->bre_pcount = 0;
+	bre->bre_dsize = 0;
 
 	*vdevidp = DVA_GET_VDEV(&bp->blk_dva[0]);
 }
@@ -1020,6 +1314,138 @@ brt_get_ratio(spa_t *spa)
 	    brt->brt_usedspace);
 }
 
+/*
+ * Sample about 'want' entries of the block clone table of one vdev, adding
+ * the estimated numbers of entries and references per power-of-two
+ * refcount bucket to 'ents' and 'refs', and the error bounds on the former
+ * to 'error'.  See ddt_get_sample_stats().
+ */
+static int
+brt_sample_vdev(brt_t *brt, brt_vdev_t *brtvd, uint64_t want, uint64_t *ents,
+    uint64_t *refs, uint64_t *error, uint64_t *seenp)
+{
+	uint64_t hits[64] = { 0 }, srefs[64] = { 0 };
+	uint64_t count, nread = 0, nseen = 0;
+	zap_attribute_t za;
+	zap_cursor_t zc;
+	boolean_t full;
+	int err;
+
+	*seenp = 0;
+
+	err = zap_count(brt->brt_mos, brtvd->bv_mos_entries, &count);
+	if (err != 0 || count == 0)
+		return (err);
+
+	full = (count <= want);
+	if (full) {
+		want = count;
+		zap_cursor_init(&zc, brt->brt_mos, brtvd->bv_mos_entries);
+	}
+
+	while (nread < want) {
+		if (!full && nread % DDT_SAMPLE_RUN == 0) {
+			if (nread != 0)
+				zap_cursor_fini(&zc);
+			zap_cursor_init_serialized(&zc, brt->brt_mos,
+			    brtvd->bv_mos_entries, ddt_sample_cursor());
+		}
+
+		err = zap_cursor_retrieve(&zc, &za);
+		if (err == ENOENT && !full) {
+			/* Ran off the end of the table; start a new run. */
+			nread = P2ROUNDUP(nread + 1, DDT_SAMPLE_RUN);
+			continue;
+		}
+		if (err != 0)
+			break;
+		nread++;
+		nseen++;
+
+		ASSERT3U(za.za_integer_length, ==, sizeof (uint64_t));
+		int bucket = highbit64(za.za_first_integer) - 1;
+		if (bucket >= 0) {
+			hits[bucket]++;
+			srefs[bucket] += za.za_first_integer;
+		}
+		zap_cursor_advance(&zc);
+	}
+	zap_cursor_fini(&zc);
+	if (err == ENOENT)
+		err = 0;
+	if (err != 0 || nseen == 0)
+		return (err);
+
+	if (full)
+		count = nseen;
+
+	for (int h = 0; h < 64; h++) {
+		ents[h] += ddt_sample_scale(hits[h], count, nseen);
+		refs[h] += ddt_sample_scale(srefs[h], count, nseen);
+		error[h] += ddt_sample_error(count, nseen, hits[h]);
+	}
+	*seenp = nseen;
+
+	return (0);
+}
+
+/*
+ * Sample about 'samples' entries of the block clone tables and add the
+ * estimated refcount histogram to 'nvl'.
+ */
+int
+brt_get_sample_stats(spa_t *spa, uint64_t samples, nvlist_t *nvl)
+{
+	brt_t *brt = spa->spa_brt;
+	uint64_t ents[64] = { 0 }, refs[64] = { 0 }, error[64] = { 0 };
+	uint64_t total = 0, sampled = 0;
+	int err = 0;
+
+	if (brt == NULL)
+		return (SET_ERROR(ENOTSUP));
+
+	samples = MIN(samples, DDT_SAMPLE_MAX);
+
+	brt_rlock(brt);
+	for (uint64_t vdevid = 0; vdevid < brt->brt_nvdevs; vdevid++) {
+		brt_vdev_t *brtvd = &brt->brt_vdevs[vdevid];
+		uint64_t count;
+
+		if (brtvd->bv_initiated && brtvd->bv_mos_entries != 0 &&
+		    zap_count(brt->brt_mos, brtvd->bv_mos_entries,
+		    &count) == 0)
+			total += count;
+	}
+
+	for (uint64_t vdevid = 0; vdevid < brt->brt_nvdevs; vdevid++) {
+		brt_vdev_t *brtvd = &brt->brt_vdevs[vdevid];
+		uint64_t count, seen;
+
+		if (!brtvd->bv_initiated || brtvd->bv_mos_entries == 0 ||
+		    zap_count(brt->brt_mos, brtvd->bv_mos_entries,
+		    &count) != 0)
+			continue;
+
+		err = brt_sample_vdev(brt, brtvd,
+		    MAX(count * samples / total, 1), ents, refs, error, &seen);
+		if (err != 0)
+			break;
+		sampled += seen;
+	}
+	brt_unlock(brt);
+
+	if (err != 0)
+		return (err);
+
+	fnvlist_add_uint64(nvl, DEDUP_SAMPLE_ENTRIES, total);
+	fnvlist_add_uint64(nvl, DEDUP_SAMPLE_SAMPLED, sampled);
+	fnvlist_add_uint64_array(nvl, DEDUP_SAMPLE_HIST_ENTRIES, ents, 64);
+	fnvlist_add_uint64_array(nvl, DEDUP_SAMPLE_HIST_REFS, refs, 64);
+	fnvlist_add_uint64_array(nvl, DEDUP_SAMPLE_ERROR, error, 64);
+
+	return (0);
+}
+
 static int
 brt_kstats_update(kstat_t *ksp, int rw)
 {
@@ -1034,8 +1460,8 @@ brt_kstats_update(kstat_t *ksp, int rw)
 	    wmsum_value(&brt_sums.brt_addref_entry_not_on_disk);
 	bs->brt_addref_entry_on_disk.value.ui64 =
 	    wmsum_value(&brt_sums.brt_addref_entry_on_disk);
-	bs->brt_addref_entry_read_lost_race.value.ui64 =
-	    wmsum_value(&brt_sums.brt_addref_entry_read_lost_race);
+	bs->brt_addref_entry_deferred.value.ui64 =
+	    wmsum_value(&brt_sums.brt_addref_entry_deferred);
 	bs->brt_decref_entry_in_memory.value.ui64 =
 	    wmsum_value(&brt_sums.brt_decref_entry_in_memory);
 	bs->brt_decref_entry_loaded_from_disk.value.ui64 =
@@ -1065,7 +1491,7 @@ brt_stat_init(void)
 	wmsum_init(&brt_sums.brt_addref_entry_in_memory, 0);
 	wmsum_init(&brt_sums.brt_addref_entry_not_on_disk, 0);
 	wmsum_init(&brt_sums.brt_addref_entry_on_disk, 0);
-	wmsum_init(&brt_sums.brt_addref_entry_read_lost_race, 0);
+	wmsum_init(&brt_sums.brt_addref_entry_deferred, 0);
 	wmsum_init(&brt_sums.brt_decref_entry_in_memory, 0);
 	wmsum_init(&brt_sums.brt_decref_entry_loaded_from_disk, 0);
 	wmsum_init(&brt_sums.brt_decref_entry_not_in_memory, 0);
@@ -1096,7 +1522,7 @@ brt_stat_fini(void)
 	wmsum_fini(&brt_sums.brt_addref_entry_in_memory);
 	wmsum_fini(&brt_sums.brt_addref_entry_not_on_disk);
 	wmsum_fini(&brt_sums.brt_addref_entry_on_disk);
-	wmsum_fini(&brt_sums.brt_addref_entry_read_lost_race);
+	wmsum_fini(&brt_sums.brt_addref_entry_deferred);
 	wmsum_fini(&brt_sums.brt_decref_entry_in_memory);
 	wmsum_fini(&brt_sums.brt_decref_entry_loaded_from_disk);
 	wmsum_fini(&brt_sums.brt_decref_entry_not_in_memory);
@@ -1136,6 +1562,8 @@ brt_entry_alloc(const brt_entry_t *bre_init)
 	bre = kmem_cache_alloc(brt_entry_cache, KM_SLEEP);
 	bre->bre_offset = bre_init->bre_offset;
 	bre->bre_refcount = bre_init->bre_refcount;
+	bre->bre_pcount = bre_init->bre_pcount;
+	bre->bre_dsize = bre_init->bre_dsize;
 
 	return (bre);
 }
@@ -1147,19 +1575,42 @@ brt_entry_free(brt_entry_t *bre)
 	kmem_cache_free(brt_entry_cache, bre);
 }
 
+/*
+ * Fold the pending references on an entry into its on-disk refcount, which
+ * the caller has just looked up, and do the accounting brt_vdev_addref()
+ * had to skip.
+ */
+static void
+brt_entry_merge(brt_t *brt, brt_vdev_t *brtvd, brt_entry_t *bre,
+    uint64_t refcnt)
+{
+	ASSERT(RW_WRITE_HELD(&brt->brt_lock));
+	ASSERT3U(bre->bre_pcount, >, 0);
+
+	bre->bre_refcount = refcnt + bre->bre_pcount;
+	bre->bre_pcount = 0;
+
+	if (refcnt == 0) {
+		BRTSTAT_BUMP(brt_addref_entry_not_on_disk);
+		brt_vdev_addentry(brt, brtvd, bre, bre->bre_dsize);
+	} else {
+		BRTSTAT_BUMP(brt_addref_entry_on_disk);
+	}
+}
+
 static void
 brt_entry_addref(brt_t *brt, const blkptr_t *bp)
 {
 	brt_vdev_t *brtvd;
-	brt_entry_t *bre, *racebre;
+	brt_entry_t *bre;
 	brt_entry_t bre_search;
 	avl_index_t where;
-	uint64_t vdevid;
-	int error;
+	uint64_t vdevid, dsize;
 
 	ASSERT(!RW_WRITE_HELD(&brt->brt_lock));
 
 	brt_entry_fill(bp, &bre_search, &vdevid);
+	dsize = bp_get_dsize(brt->brt_spa, bp);
 
 	brt_wlock(brt);
 
@@ -1175,45 +1626,40 @@ brt_entry_addref(brt_t *brt, const blkptr_t *bp)
 	if (!brtvd->bv_initiated)
 		brt_vdev_realloc(brt, brtvd);
 
-	bre = avl_find(&brtvd->bv_tree, &bre_search, NULL);
+	bre = avl_find(&brtvd->bv_tree, &bre_search, &where);
 	if (bre != NULL) {
 		BRTSTAT_BUMP(brt_addref_entry_in_memory);
-	} else {
-		/*
-		 * brt_entry_lookup() may drop the BRT (read) lock and
-		 * reacquire it (write).
-		 */
-		error = brt_entry_lookup(brt, brtvd, &bre_search);
-		/* bre_search now contains correct bre_refcount */
-		ASSERT(error == 0 || error == ENOENT);
-		if (error == 0)
-			BRTSTAT_BUMP(brt_addref_entry_on_disk);
+		if (bre->bre_pcount > 0)
+			bre->bre_pcount++;
 		else
-			BRTSTAT_BUMP(brt_addref_entry_not_on_disk);
+			bre->bre_refcount++;
+	} else if (brtvd->bv_mos_entries != 0 &&
+	    brt_vdev_lookup(brt, brtvd, &bre_search)) {
 		/*
-		 * When the BRT lock was dropped, brt_vdevs[] may have been
-		 * expanded and reallocated, we need to update brtvd's pointer.
+		 * There may be an on-disk entry for this block. Rather than
+		 * stop to read it now, just count the new reference, and
+		 * merge it with the on-disk refcount later. A clone of a
+		 * large file can add millions of references in a txg, and
+		 * this way they cost one ZAP lookup each, in order, in
+		 * brt_sync_table() (and the lookup was already prefetched
+		 * by brt_pending_add()), instead of one under the BRT lock
+		 * here.
 		 */
-		brtvd = brt_vdev(brt, vdevid);
-		ASSERT(brtvd != NULL);
-
-		racebre = avl_find(&brtvd->bv_tree, &bre_search, &where);
-		if (racebre == NULL) {
-			bre = brt_entry_alloc(&bre_search);
-			ASSERT(RW_WRITE_HELD(&brt->brt_lock));
-			avl_insert(&brtvd->bv_tree, bre, where);
-			brt->brt_nentries++;
-		} else {
-			/*
-			 * The entry was added when the BRT lock was dropped in
-			 * brt_entry_lookup().
-			 */
-			BRTSTAT_BUMP(brt_addref_entry_read_lost_race);
-			bre = racebre;
-		}
+		BRTSTAT_BUMP(brt_addref_entry_deferred);
+		bre_search.bre_pcount = 1;
+		bre_search.bre_dsize = dsize;
+		bre = brt_entry_alloc(&bre_search);
+		avl_insert(&brtvd->bv_tree, bre, where);
+		brt->brt_nentries++;
+	} else {
+		/* Nothing on disk in this region, so this is a new entry. */
+		BRTSTAT_BUMP(brt_addref_entry_not_on_disk);
+		bre_search.bre_refcount = 1;
+		bre = brt_entry_alloc(&bre_search);
+		avl_insert(&brtvd->bv_tree, bre, where);
+		brt->brt_nentries++;
 	}
-	bre->bre_refcount++;
-	brt_vdev_addref(brt, brtvd, bre, bp_get_dsize(brt->brt_spa, bp));
+	brt_vdev_addref(brt, brtvd, bre, dsize);
 
 	brt_unlock(brt);
 }
@@ -1240,7 +1686,12 @@ brt_entry_decref(spa_t *spa, const blkptr_t *bp)
 	bre = avl_find(&brtvd->bv_tree, &bre_search, NULL);
 	if (bre != NULL) {
 		BRTSTAT_BUMP(brt_decref_entry_in_memory);
-		goto out;
+		/*
+		 * If it still has pending references, we need the on-disk
+		 * refcount to know where this one leaves it.
+		 */
+		if (bre->bre_pcount == 0)
+			goto out;
 	} else {
 		BRTSTAT_BUMP(brt_decref_entry_not_in_memory);
 	}
@@ -1258,23 +1709,28 @@ brt_entry_decref(spa_t *spa, const blkptr_t *bp)
 	brtvd = brt_vdev(brt, vdevid);
 	ASSERT(brtvd != NULL);
 
-	if (error == ENOENT) {
-		BRTSTAT_BUMP(brt_decref_entry_not_on_disk);
-		bre = NULL;
-		goto out;
-	}
-
 	racebre = avl_find(&brtvd->bv_tree, &bre_search, &where);
 	if (racebre != NULL) {
-		/*
-		 * The entry was added when the BRT lock was dropped in
-		 * brt_entry_lookup().
-		 */
-		BRTSTAT_BUMP(brt_decref_entry_read_lost_race);
+		if (racebre->bre_pcount > 0) {
+			brt_entry_merge(brt, brtvd, racebre,
+			    error == 0 ? bre_search.bre_refcount : 0);
+		} else if (bre == NULL) {
+			/*
+			 * The entry was added when the BRT lock was dropped
+			 * in brt_entry_lookup().
+			 */
+			BRTSTAT_BUMP(brt_decref_entry_read_lost_race);
+		}
 		bre = racebre;
 		goto out;
 	}
 
+	if (error == ENOENT) {
+		BRTSTAT_BUMP(brt_decref_entry_not_on_disk);
+		bre = NULL;
+		goto out;
+	}
+
 	BRTSTAT_BUMP(brt_decref_entry_loaded_from_disk);
 	bre = brt_entry_alloc(&bre_search);
 	ASSERT(RW_WRITE_HELD(&brt->brt_lock));
@@ -1326,13 +1782,21 @@ brt_entry_get_refcount(spa_t *spa, const blkptr_t *bp)
 	ASSERT(brtvd != NULL);
 
 	bre = avl_find(&brtvd->bv_tree, &bre_search, NULL);
-	if (bre == NULL) {
+	if (bre == NULL || bre->bre_pcount > 0) {
 		error = brt_entry_lookup(brt, brtvd, &bre_search);
 		ASSERT(error == 0 || error == ENOENT);
 		if (error == ENOENT)
 			refcnt = 0;
 		else
 			refcnt = bre_search.bre_refcount;
+
+		/* Add any pending references, if it's still in memory. */
+		brtvd = brt_vdev(brt, vdevid);
+		bre = avl_find(&brtvd->bv_tree, &bre_search, NULL);
+		if (bre != NULL && bre->bre_pcount > 0)
+			refcnt += bre->bre_pcount;
+		else if (bre != NULL)
+			refcnt = bre->bre_refcount;
 	} else
 		refcnt = bre->bre_refcount;
 
@@ -1494,31 +1958,88 @@ brt_pending_apply(spa_t *spa, uint64_t txg)
 	}
 }
 
+typedef struct brt_sync_arg {
+	brt_t		*bsa_brt;
+	brt_vdev_t	*bsa_brtvd;
+	dmu_tx_t	*bsa_tx;
+} brt_sync_arg_t;
+
+/*
+ * Write out all changed entries for one vdev. This only touches the vdev's
+ * own entries ZAP and entry tree, so it can run for many vdevs at once. The
+ * caller holds the BRT lock as writer for the duration, and does all the
+ * shared accounting afterwards.
+ *
+ * Entries with pending references get their on-disk refcount stashed in
+ * bre_refcount, for brt_entry_merge() to finish off.
+ */
 static void
-brt_sync_entry(dnode_t *dn, brt_entry_t *bre, dmu_tx_t *tx)
+brt_sync_vdev_entries(void *arg)
 {
-	if (bre->bre_refcount == 0) {
-		int error = zap_remove_uint64_by_dnode(dn, &bre->bre_offset,
-		    BRT_KEY_WORDS, tx);
-		VERIFY(error == 0 || error == ENOENT);
-	} else {
-		VERIFY0(zap_update_uint64_by_dnode(dn, &bre->bre_offset,
-		    BRT_KEY_WORDS, 1, sizeof (bre->bre_refcount),
-		    &bre->bre_refcount, tx));
+	brt_sync_arg_t *bsa = arg;
+	brt_vdev_t *brtvd = bsa->bsa_brtvd;
+	dmu_tx_t *tx = bsa->bsa_tx;
+	brt_entry_t *bre;
+	dnode_t *dn;
+	uint64_t nents = avl_numnodes(&brtvd->bv_tree);
+	uint64_t *keys, *refcnts, nupdates = 0;
+
+	VERIFY0(dnode_hold(bsa->bsa_brt->brt_mos, brtvd->bv_mos_entries,
+	    FTAG, &dn));
+
+	/*
+	 * Removals are done as we go, while the updates are collected and
+	 * written with a single batch call, which locks the ZAP only once.
+	 */
+	keys = vmem_alloc(nents * sizeof (uint64_t), KM_SLEEP);
+	refcnts = vmem_alloc(nents * sizeof (uint64_t), KM_SLEEP);
+
+	for (bre = avl_first(&brtvd->bv_tree); bre != NULL;
+	    bre = AVL_NEXT(&brtvd->bv_tree, bre)) {
+		uint64_t refcnt = bre->bre_refcount;
+		if (bre->bre_pcount > 0) {
+			int error = zap_lookup_uint64_by_dnode(dn,
+			    &bre->bre_offset, BRT_KEY_WORDS, 1,
+			    sizeof (refcnt), &refcnt);
+			VERIFY(error == 0 || error == ENOENT);
+			if (error == ENOENT)
+				refcnt = 0;
+			bre->bre_refcount = refcnt;
+			refcnt += bre->bre_pcount;
+		}
+		if (refcnt == 0) {
+			int error = zap_remove_uint64_by_dnode(dn,
+			    &bre->bre_offset, BRT_KEY_WORDS, tx);
+			VERIFY(error == 0 || error == ENOENT);
+		} else {
+			keys[nupdates] = bre->bre_offset;
+			refcnts[nupdates] = refcnt;
+			nupdates++;
+		}
 	}
+
+	VERIFY0(zap_update_uint64_batch_by_dnode(dn, keys, BRT_KEY_WORDS,
+	    nupdates, 1, sizeof (uint64_t), refcnts, tx));
+
+	vmem_free(keys, nents * sizeof (uint64_t));
+	vmem_free(refcnts, nents * sizeof (uint64_t));
+	dnode_rele(dn, FTAG);
 }
 
 static void
 brt_sync_table(brt_t *brt, dmu_tx_t *tx)
 {
+	dsl_pool_t *dp = brt->brt_spa->spa_dsl_pool;
+	brt_sync_arg_t *bsa;
 	brt_vdev_t *brtvd;
 	brt_entry_t *bre;
-	dnode_t *dn;
-	uint64_t vdevid;
+	uint64_t vdevid, ndirty = 0;
 	void *c;
 
 	brt_wlock(brt);
 
+	bsa = kmem_zalloc(brt->brt_nvdevs * sizeof (brt_sync_arg_t), KM_SLEEP);
+
 	for (vdevid = 0; vdevid < brt->brt_nvdevs; vdevid++) {
 		brtvd = &brt->brt_vdevs[vdevid];
 
@@ -1537,27 +2058,60 @@ brt_sync_table(brt_t *brt, dmu_tx_t *tx)
 		if (brtvd->bv_mos_brtvdev == 0)
 			brt_vdev_create(brt, brtvd, tx);
 
-		VERIFY0(dnode_hold(brt->brt_mos, brtvd->bv_mos_entries,
-		    FTAG, &dn));
+		bsa[vdevid].bsa_brt = brt;
+		bsa[vdevid].bsa_brtvd = brtvd;
+		bsa[vdevid].bsa_tx = tx;
+		if (avl_numnodes(&brtvd->bv_tree) > 0)
+			ndirty++;
+	}
+
+	/*
+	 * The entry updates for each vdev are independent, so if there are
+	 * several vdevs with changes, write them out in parallel on the sync
+	 * taskq, rather than one vdev after another.
+	 */
+	for (vdevid = 0; vdevid < brt->brt_nvdevs; vdevid++) {
+		if (bsa[vdevid].bsa_brtvd == NULL ||
+		    avl_numnodes(&bsa[vdevid].bsa_brtvd->bv_tree) == 0)
+			continue;
+		if (ndirty > 1 && brt_sync_parallel) {
+			VERIFY3U(taskq_dispatch(dp->dp_sync_taskq,
+			    brt_sync_vdev_entries, &bsa[vdevid], TQ_SLEEP), !=,
+			    TASKQID_INVALID);
+		} else {
+			brt_sync_vdev_entries(&bsa[vdevid]);
+		}
+	}
+	if (ndirty > 1 && brt_sync_parallel)
+		taskq_wait(dp->dp_sync_taskq);
+
+	for (vdevid = 0; vdevid < brt->brt_nvdevs; vdevid++) {
+		brtvd = bsa[vdevid].bsa_brtvd;
+		if (brtvd == NULL)
+			continue;
 
 		c = NULL;
 		while ((bre = avl_destroy_nodes(&brtvd->bv_tree, &c)) != NULL) {
-			brt_sync_entry(dn, bre, tx);
+			if (bre->bre_pcount > 0)
+				brt_entry_merge(brt, brtvd, bre,
+				    bre->bre_refcount);
 			brt_entry_free(bre);
 			ASSERT(brt->brt_nentries > 0);
 			brt->brt_nentries--;
 		}
 
-		dnode_rele(dn, FTAG);
-
 		brt_vdev_sync(brt, brtvd, tx);
 
 		if (brtvd->bv_totalcount == 0)
 			brt_vdev_destroy(brt, brtvd, tx);
+		else
+			brt_bloom_sync(brt, brtvd, tx);
 	}
 
 	ASSERT0(brt->brt_nentries);
 
+	kmem_free(bsa, brt->brt_nvdevs * sizeof (brt_sync_arg_t));
+
 	brt_unlock(brt);
 }
 
@@ -1666,6 +2220,8 @@ brt_unload(spa_t *spa)
 /* BEGIN CSTYLED */
 ZFS_MODULE_PARAM(zfs_brt, , brt_zap_prefetch, INT, ZMOD_RW,
 	"Enable prefetching of BRT ZAP entries");
+ZFS_MODULE_PARAM(zfs_brt, , brt_sync_parallel, INT, ZMOD_RW,
+	"Sync BRT entries for different vdevs in parallel");
 ZFS_MODULE_PARAM(zfs_brt, , brt_zap_default_bs, UINT, ZMOD_RW,
 	"BRT ZAP leaf blockshift");
 ZFS_MODULE_PARAM(zfs_brt, , brt_zap_default_ibs, UINT, ZMOD_RW,
@@ -37,9 +37,19 @@ static dataset_kstat_values_t empty_dataset_kstats = {
 	{ "nread",	KSTAT_DATA_UINT64 },
 	{ "nunlinks",	KSTAT_DATA_UINT64 },
 	{ "nunlinked",	KSTAT_DATA_UINT64 },
+	{ "rtime",	KSTAT_DATA_UINT64 },
+	{ "wtime",	KSTAT_DATA_UINT64 },
+	{ "sync_writes",	KSTAT_DATA_UINT64 },
+	{ "sync_wtime",	KSTAT_DATA_UINT64 },
+	{ "fsyncs",	KSTAT_DATA_UINT64 },
+	{ "fsync_time",	KSTAT_DATA_UINT64 },
 	{
 	{ "zil_commit_count",			KSTAT_DATA_UINT64 },
 	{ "zil_commit_writer_count",		KSTAT_DATA_UINT64 },
+	{ "zil_commit_lwb_count",		KSTAT_DATA_UINT64 },
+	{ "zil_commit_lwb_wait_time",		KSTAT_DATA_UINT64 },
+	{ "zil_commit_lwb_write_time",		KSTAT_DATA_UINT64 },
+	{ "zil_commit_lwb_flush_time",		KSTAT_DATA_UINT64 },
 	{ "zil_itx_count",			KSTAT_DATA_UINT64 },
 	{ "zil_itx_indirect_count",		KSTAT_DATA_UINT64 },
 	{ "zil_itx_indirect_bytes",		KSTAT_DATA_UINT64 },
@@ -58,6 +68,12 @@ static dataset_kstat_values_t empty_dataset_kstats = {
 	}
 };
 
+static const char *const dataset_lat_op_names[DS_LAT_OPS] = {
+	"read", "write", "sync_write", "fsync", "lookup", "getattr",
+};
+
+#define	DS_LAT_ROW	(VDEV_L_HISTO_BUCKETS + 1)
+
 static int
 dataset_kstats_update(kstat_t *ksp, int rw)
 {
@@ -80,12 +96,124 @@ dataset_kstats_update(kstat_t *ksp, int rw)
 	    wmsum_value(&dk->dk_sums.dss_nunlinks);
 	dkv->dkv_nunlinked.value.ui64 =
 	    wmsum_value(&dk->dk_sums.dss_nunlinked);
+	dkv->dkv_rtime.value.ui64 =
+	    wmsum_value(&dk->dk_sums.dss_rtime);
+	dkv->dkv_wtime.value.ui64 =
+	    wmsum_value(&dk->dk_sums.dss_wtime);
+	dkv->dkv_sync_writes.value.ui64 =
+	    wmsum_value(&dk->dk_sums.dss_sync_writes);
+	dkv->dkv_sync_wtime.value.ui64 =
+	    wmsum_value(&dk->dk_sums.dss_sync_wtime);
+	dkv->dkv_fsyncs.value.ui64 =
+	    wmsum_value(&dk->dk_sums.dss_fsyncs);
+	dkv->dkv_fsync_time.value.ui64 =
+	    wmsum_value(&dk->dk_sums.dss_fsync_time);
 
 	zil_kstat_values_update(&dkv->dkv_zil_stats, &dk->dk_zil_sums);
 
 	return (0);
 }
 
+static int
+dataset_lat_headers(char *buf, size_t size)
+{
+	int n = snprintf(buf, size, "%-10s", "op");
+
+	for (int i = 0; i < VDEV_L_HISTO_BUCKETS && n < size; i++)
+		n += snprintf(buf + n, size - n, " %llu",
+		    (u_longlong_t)1 << i);
+	if (n < size)
+		(void) snprintf(buf + n, size - n, "\n");
+
+	return (0);
+}
+
+static int
+dataset_lat_data(char *buf, size_t size, void *data)
+{
+	uint64_t *histo = data;
+	uint64_t op = histo[VDEV_L_HISTO_BUCKETS];
+	int n = snprintf(buf, size, "%-10s", dataset_lat_op_names[op]);
+
+	for (int i = 0; i < VDEV_L_HISTO_BUCKETS && n < size; i++)
+		n += snprintf(buf + n, size - n, " %llu",
+		    (u_longlong_t)histo[i]);
+	if (n < size)
+		(void) snprintf(buf + n, size - n, "\n");
+
+	return (0);
+}
+
+static void *
+dataset_lat_addr(kstat_t *ksp, loff_t n)
+{
+	dataset_kstats_t *dk = ksp->ks_private;
+
+	if (n >= 0 && n < DS_LAT_OPS)
+		return (dk->dk_lat_histo + n * DS_LAT_ROW);
+	return (NULL);
+}
+
+/*
+ * The latency histograms are a raw kstat of their own, next to the named
+ * dataset kstat, with one row per operation in the same layout as the
+ * pool's zio_stages kstat.  The buckets are bumped with plain atomics,
+ * which costs about as much as the wmsum updates of the totals.
+ */
+static void
+dataset_lat_kstat_create(dataset_kstats_t *dk, const char *module,
+    objset_t *objset)
+{
+	char kstat_name[KSTAT_STRLEN];
+	int n = snprintf(kstat_name, sizeof (kstat_name),
+	    "objset-0x%llx-latency", (unsigned long long)dmu_objset_id(objset));
+	if (n < 0 || n >= KSTAT_STRLEN)
+		return;
+
+	dk->dk_lat_histo = kmem_zalloc(DS_LAT_OPS * DS_LAT_ROW *
+	    sizeof (uint64_t), KM_SLEEP);
+	for (int op = 0; op < DS_LAT_OPS; op++)
+		dk->dk_lat_histo[op * DS_LAT_ROW + VDEV_L_HISTO_BUCKETS] = op;
+	mutex_init(&dk->dk_lat_lock, NULL, MUTEX_DEFAULT, NULL);
+
+	kstat_t *ksp = kstat_create(module, 0, kstat_name, "dataset",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+	dk->dk_lat_kstat = ksp;
+	if (ksp != NULL) {
+		ksp->ks_lock = &dk->dk_lat_lock;
+		ksp->ks_data = NULL;
+		ksp->ks_private = dk;
+		kstat_set_raw_ops(ksp, dataset_lat_headers,
+		    dataset_lat_data, dataset_lat_addr);
+		kstat_install(ksp);
+	}
+}
+
+static void
+dataset_lat_kstat_destroy(dataset_kstats_t *dk)
+{
+	if (dk->dk_lat_histo == NULL)
+		return;
+
+	if (dk->dk_lat_kstat != NULL) {
+		kstat_delete(dk->dk_lat_kstat);
+		dk->dk_lat_kstat = NULL;
+	}
+	mutex_destroy(&dk->dk_lat_lock);
+	kmem_free(dk->dk_lat_histo, DS_LAT_OPS * DS_LAT_ROW *
+	    sizeof (uint64_t));
+	dk->dk_lat_histo = NULL;
+}
+
+static inline void
+dataset_lat_add(dataset_kstats_t *dk, dataset_lat_op_t op, hrtime_t delta)
+{
+	if (dk->dk_lat_histo != NULL) {
+		atomic_inc_64(dk->dk_lat_histo + op * DS_LAT_ROW +
+		    L_HISTO(delta));
+	}
+}
+
 int
 dataset_kstats_create(dataset_kstats_t *dk, objset_t *objset)
 {
@@ -169,10 +297,18 @@ dataset_kstats_create(dataset_kstats_t *dk, objset_t *objset)
 	wmsum_init(&dk->dk_sums.dss_nread, 0);
 	wmsum_init(&dk->dk_sums.dss_nunlinks, 0);
 	wmsum_init(&dk->dk_sums.dss_nunlinked, 0);
+	wmsum_init(&dk->dk_sums.dss_rtime, 0);
+	wmsum_init(&dk->dk_sums.dss_wtime, 0);
+	wmsum_init(&dk->dk_sums.dss_sync_writes, 0);
+	wmsum_init(&dk->dk_sums.dss_sync_wtime, 0);
+	wmsum_init(&dk->dk_sums.dss_fsyncs, 0);
+	wmsum_init(&dk->dk_sums.dss_fsync_time, 0);
 	zil_sums_init(&dk->dk_zil_sums);
 
 	dk->dk_kstats = kstat;
 	kstat_install(kstat);
+
+	dataset_lat_kstat_create(dk, kstat_module_name, objset);
 	return (0);
 }
 
@@ -182,6 +318,8 @@ dataset_kstats_destroy(dataset_kstats_t *dk)
 	if (dk->dk_kstats == NULL)
 		return;
 
+	dataset_lat_kstat_destroy(dk);
+
 	dataset_kstat_values_t *dkv = dk->dk_kstats->ks_data;
 	kstat_delete(dk->dk_kstats);
 	dk->dk_kstats = NULL;
@@ -195,6 +333,12 @@ dataset_kstats_destroy(dataset_kstats_t *dk)
 	wmsum_fini(&dk->dk_sums.dss_nread);
 	wmsum_fini(&dk->dk_sums.dss_nunlinks);
 	wmsum_fini(&dk->dk_sums.dss_nunlinked);
+	wmsum_fini(&dk->dk_sums.dss_rtime);
+	wmsum_fini(&dk->dk_sums.dss_wtime);
+	wmsum_fini(&dk->dk_sums.dss_sync_writes);
+	wmsum_fini(&dk->dk_sums.dss_sync_wtime);
+	wmsum_fini(&dk->dk_sums.dss_fsyncs);
+	wmsum_fini(&dk->dk_sums.dss_fsync_time);
 	zil_sums_fini(&dk->dk_zil_sums);
 }
 
@@ -236,6 +380,61 @@ dataset_kstats_update_read_kstats(dataset_kstats_t *dk,
 	wmsum_add(&dk->dk_sums.dss_nread, nread);
 }
 
+void
+dataset_kstats_update_read_time(dataset_kstats_t *dk, hrtime_t delta)
+{
+	if (dk->dk_kstats == NULL)
+		return;
+
+	wmsum_add(&dk->dk_sums.dss_rtime, delta);
+	dataset_lat_add(dk, DS_LAT_READ, delta);
+}
+
+void
+dataset_kstats_update_write_time(dataset_kstats_t *dk, hrtime_t delta,
+    boolean_t sync)
+{
+	if (dk->dk_kstats == NULL)
+		return;
+
+	wmsum_add(&dk->dk_sums.dss_wtime, delta);
+	dataset_lat_add(dk, DS_LAT_WRITE, delta);
+	if (sync) {
+		wmsum_add(&dk->dk_sums.dss_sync_writes, 1);
+		wmsum_add(&dk->dk_sums.dss_sync_wtime, delta);
+		dataset_lat_add(dk, DS_LAT_SYNC_WRITE, delta);
+	}
+}
+
+void
+dataset_kstats_update_fsync_kstats(dataset_kstats_t *dk, hrtime_t delta)
+{
+	if (dk->dk_kstats == NULL)
+		return;
+
+	wmsum_add(&dk->dk_sums.dss_fsyncs, 1);
+	wmsum_add(&dk->dk_sums.dss_fsync_time, delta);
+	dataset_lat_add(dk, DS_LAT_FSYNC, delta);
+}
+
+void
+dataset_kstats_update_lookup_time(dataset_kstats_t *dk, hrtime_t delta)
+{
+	if (dk->dk_kstats == NULL)
+		return;
+
+	dataset_lat_add(dk, DS_LAT_LOOKUP, delta);
+}
+
+void
+dataset_kstats_update_getattr_time(dataset_kstats_t *dk, hrtime_t delta)
+{
+	if (dk->dk_kstats == NULL)
+		return;
+
+	dataset_lat_add(dk, DS_LAT_GETATTR, delta);
+}
+
 void
 dataset_kstats_update_nunlinks_kstat(dataset_kstats_t *dk, int64_t delta)
 {
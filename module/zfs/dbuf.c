@@ -76,6 +76,10 @@ typedef struct dbuf_stats {
 	 * Total number of dbuf cache evictions that have occurred.
 	 */
 	kstat_named_t cache_total_evicts;
+	/*
+	 * Number of times eviction was split across dbuf_evict_threads.
+	 */
+	kstat_named_t cache_evict_parallel;
 	/*
 	 * The distribution of dbuf levels in the dbuf cache and
 	 * the total size of all dbufs at each level.
@@ -118,6 +122,11 @@ typedef struct dbuf_stats {
 	 * the data in the regular dbuf cache.
 	 */
 	kstat_named_t metadata_cache_overflow;
+	/*
+	 * Number of times a sublist lock of either dbuf cache was found
+	 * held by another thread.
+	 */
+	kstat_named_t cache_list_contended;
 } dbuf_stats_t;
 
 dbuf_stats_t dbuf_stats = {
@@ -128,6 +137,7 @@ dbuf_stats_t dbuf_stats = {
 	{ "cache_lowater_bytes",		KSTAT_DATA_UINT64 },
 	{ "cache_hiwater_bytes",		KSTAT_DATA_UINT64 },
 	{ "cache_total_evicts",			KSTAT_DATA_UINT64 },
+	{ "cache_evict_parallel",		KSTAT_DATA_UINT64 },
 	{ { "cache_levels_N",			KSTAT_DATA_UINT64 } },
 	{ { "cache_levels_bytes_N",		KSTAT_DATA_UINT64 } },
 	{ "hash_hits",				KSTAT_DATA_UINT64 },
@@ -143,12 +153,14 @@ dbuf_stats_t dbuf_stats = {
 	{ "metadata_cache_count",		KSTAT_DATA_UINT64 },
 	{ "metadata_cache_size_bytes",		KSTAT_DATA_UINT64 },
 	{ "metadata_cache_size_bytes_max",	KSTAT_DATA_UINT64 },
-	{ "metadata_cache_overflow",		KSTAT_DATA_UINT64 }
+	{ "metadata_cache_overflow",		KSTAT_DATA_UINT64 },
+	{ "cache_list_contended",		KSTAT_DATA_UINT64 }
 };
 
 struct {
 	wmsum_t cache_count;
 	wmsum_t cache_total_evicts;
+	wmsum_t cache_evict_parallel;
 	wmsum_t cache_levels[DN_MAX_LEVELS];
 	wmsum_t cache_levels_bytes[DN_MAX_LEVELS];
 	wmsum_t hash_hits;
@@ -234,6 +246,17 @@ static uint64_t dbuf_metadata_cache_max_bytes = UINT64_MAX;
 static uint_t dbuf_cache_shift = 5;
 static uint_t dbuf_metadata_cache_shift = 6;
 
+/*
+ * Number of threads the dbuf eviction thread may spread eviction across,
+ * with 0 meaning to pick a number based on the CPU count.  A thread is only
+ * used for each DBUF_EVICT_TASK_MIN bytes above the low water mark, so a
+ * small excess is still evicted by dbuf_evict_thread() alone.
+ */
+static uint_t dbuf_evict_threads = 0;
+
+/* Set the dbuf hash table size as log2 shift (dynamic by default) */
+static uint_t dbuf_hash_table_shift = 0;
+
 /* Set the dbuf hash mutex count as log2 shift (dynamic by default) */
 static uint_t dbuf_mutex_cache_shift = 0;
 
@@ -285,6 +308,15 @@ static unsigned long dbuf_metadata_cache_target_bytes(void);
 static uint_t dbuf_cache_hiwater_pct = 10;
 static uint_t dbuf_cache_lowater_pct = 10;
 
+/*
+ * File blocks up to this size which were in the MFU state of the ARC when
+ * they were dirtied are treated as frequently read, and written to the
+ * special class as if special_small_blocks were at least this large.
+ * Blocks that have gone cold are written back to the normal class the next
+ * time they are rewritten.  0 disables this.
+ */
+static uint_t zfs_special_class_hot_blocks = 0;
+
 static int
 dbuf_cons(void *vdb, void *unused, int kmflag)
 {
@@ -623,6 +655,16 @@ dbuf_is_metadata(dmu_buf_impl_t *db)
 	}
 }
 
+/*
+ * Data blocks of the object types in l2arc_exclude_ot are kept out of L2ARC.
+ */
+static inline boolean_t
+dbuf_ot_is_l2cacheable(dmu_object_type_t ot)
+{
+	return (l2arc_exclude_ot == 0 || ot >= 64 ||
+	    (l2arc_exclude_ot & (1ULL << ot)) == 0);
+}
+
 /*
  * We want to exclude buffers that are on a special allocation class from
  * L2ARC.
@@ -630,6 +672,16 @@ dbuf_is_metadata(dmu_buf_impl_t *db)
 boolean_t
 dbuf_is_l2cacheable(dmu_buf_impl_t *db)
 {
+	if (l2arc_exclude_ot != 0 && db->db_level == 0 &&
+	    db->db_blkid != DMU_SPILL_BLKID) {
+		DB_DNODE_ENTER(db);
+		boolean_t excluded =
+		    !dbuf_ot_is_l2cacheable(DB_DNODE(db)->dn_type);
+		DB_DNODE_EXIT(db);
+		if (excluded)
+			return (B_FALSE);
+	}
+
 	if (db->db_objset->os_secondary_cache == ZFS_CACHE_ALL ||
 	    (db->db_objset->os_secondary_cache ==
 	    ZFS_CACHE_METADATA && dbuf_is_metadata(db))) {
@@ -659,6 +711,10 @@ dbuf_is_l2cacheable(dmu_buf_impl_t *db)
 static inline boolean_t
 dnode_level_is_l2cacheable(blkptr_t *bp, dnode_t *dn, int64_t level)
 {
+	if (level == 0 &&
+	    !dbuf_ot_is_l2cacheable(dn->dn_handle->dnh_dnode->dn_type))
+		return (B_FALSE);
+
 	if (dn->dn_objset->os_secondary_cache == ZFS_CACHE_ALL ||
 	    (dn->dn_objset->os_secondary_cache == ZFS_CACHE_METADATA &&
 	    (level > 0 ||
@@ -762,9 +818,10 @@ dbuf_cache_above_lowater(void)
 }
 
 /*
- * Evict the oldest eligible dbuf from the dbuf cache.
+ * Evict the oldest eligible dbuf from the dbuf cache, returning the number
+ * of bytes released from the cache.
  */
-static void
+static uint64_t
 dbuf_evict_one(void)
 {
 	int idx = multilist_get_random_index(&dbuf_caches[DB_DBUF_CACHE].cache);
@@ -797,9 +854,65 @@ dbuf_evict_one(void)
 		db->db_caching_status = DB_NO_CACHE;
 		dbuf_destroy(db);
 		DBUF_STAT_BUMP(cache_total_evicts);
+		return (size + usize);
 	} else {
 		multilist_sublist_unlock(mls);
+		return (0);
+	}
+}
+
+#define	DBUF_EVICT_TASK_MIN	(16ULL << 20)
+
+typedef struct dbuf_evict_arg {
+	taskq_ent_t	dea_tqent;
+	uint64_t	dea_bytes;
+} dbuf_evict_arg_t;
+
+static taskq_t *dbuf_evict_taskq;
+static dbuf_evict_arg_t *dbuf_evict_args;
+static uint_t dbuf_evict_nthreads;
+
+static void
+dbuf_evict_task(void *arg)
+{
+	dbuf_evict_arg_t *dea = arg;
+	uint64_t evicted = 0;
+
+	while (evicted < dea->dea_bytes && dbuf_cache_above_lowater() &&
+	    !dbuf_evict_thread_exit)
+		evicted += dbuf_evict_one();
+}
+
+/*
+ * Evict down towards the low water mark, splitting the work between up to
+ * dbuf_evict_nthreads tasks when the excess is large enough to make that
+ * worthwhile.  Each task picks random sublists, so they rarely contend.
+ * Only dbuf_evict_thread() uses the taskq, as the tasks share its args.
+ */
+static void
+dbuf_evict_batch(void)
+{
+	uint64_t size = zfs_refcount_count(&dbuf_caches[DB_DBUF_CACHE].size);
+	uint64_t lowater = dbuf_cache_lowater_bytes();
+	uint64_t bytes = (size > lowater) ? size - lowater : 0;
+	uint_t ntasks = 1;
+
+	if (dbuf_evict_taskq != NULL)
+		ntasks = MIN(bytes / DBUF_EVICT_TASK_MIN, dbuf_evict_nthreads);
+	if (ntasks <= 1) {
+		(void) dbuf_evict_one();
+		return;
+	}
+
+	for (uint_t t = 0; t < ntasks; t++) {
+		dbuf_evict_arg_t *dea = &dbuf_evict_args[t];
+
+		dea->dea_bytes = bytes / ntasks;
+		taskq_dispatch_ent(dbuf_evict_taskq, dbuf_evict_task, dea, 0,
+		    &dea->dea_tqent);
 	}
+	taskq_wait(dbuf_evict_taskq);
+	DBUF_STAT_BUMP(cache_evict_parallel);
 }
 
 /*
@@ -833,7 +946,7 @@ dbuf_evict_thread(void *unused)
 		 * minimize lock contention.
 		 */
 		while (dbuf_cache_above_lowater() && !dbuf_evict_thread_exit) {
-			dbuf_evict_one();
+			dbuf_evict_batch();
 		}
 
 		mutex_enter(&dbuf_evict_lock);
@@ -860,7 +973,7 @@ dbuf_evict_notify(uint64_t size)
 	 */
 	if (size > dbuf_cache_target_bytes()) {
 		if (size > dbuf_cache_hiwater_bytes())
-			dbuf_evict_one();
+			(void) dbuf_evict_one();
 		cv_signal(&dbuf_evict_cv);
 	}
 }
@@ -883,6 +996,8 @@ dbuf_kstat_update(kstat_t *ksp, int rw)
 	ds->cache_lowater_bytes.value.ui64 = dbuf_cache_lowater_bytes();
 	ds->cache_total_evicts.value.ui64 =
 	    wmsum_value(&dbuf_sums.cache_total_evicts);
+	ds->cache_evict_parallel.value.ui64 =
+	    wmsum_value(&dbuf_sums.cache_evict_parallel);
 	for (int i = 0; i < DN_MAX_LEVELS; i++) {
 		ds->cache_levels[i].value.ui64 =
 		    wmsum_value(&dbuf_sums.cache_levels[i]);
@@ -907,6 +1022,10 @@ dbuf_kstat_update(kstat_t *ksp, int rw)
 	    &dbuf_caches[DB_DBUF_METADATA_CACHE].size);
 	ds->metadata_cache_overflow.value.ui64 =
 	    wmsum_value(&dbuf_sums.metadata_cache_overflow);
+	ds->cache_list_contended.value.ui64 =
+	    multilist_get_contended(&dbuf_caches[DB_DBUF_CACHE].cache) +
+	    multilist_get_contended(
+	    &dbuf_caches[DB_DBUF_METADATA_CACHE].cache);
 	return (0);
 }
 
@@ -921,9 +1040,18 @@ dbuf_init(void)
 	 * with an average block size of zfs_arc_average_blocksize (default 8K).
 	 * By default, the table will take up
 	 * totalmem * sizeof(void*) / 8K (1MB per GB with 8-byte pointers).
+	 *
+	 * The table is not resized at runtime, so systems that cache many
+	 * more (smaller) dbufs than this estimate, and see a large
+	 * hash_chain_max in the dbufstats kstat, can size it explicitly
+	 * with dbuf_hash_table_shift.
 	 */
-	while (hsize * zfs_arc_average_blocksize < arc_all_memory() / 8)
-		hsize <<= 1;
+	if (dbuf_hash_table_shift == 0) {
+		while (hsize * zfs_arc_average_blocksize < arc_all_memory() / 8)
+			hsize <<= 1;
+	} else {
+		hsize = 1ULL << MIN(MAX(dbuf_hash_table_shift, 10), 32);
+	}
 
 	h->hash_table = NULL;
 	while (h->hash_table == NULL) {
@@ -979,6 +1107,21 @@ dbuf_init(void)
 		zfs_refcount_create(&dbuf_caches[dcs].size);
 	}
 
+	dbuf_evict_nthreads = dbuf_evict_threads;
+	if (dbuf_evict_nthreads == 0) {
+		dbuf_evict_nthreads = (max_ncpus < 6) ? 1 :
+		    (highbit64(max_ncpus) - 1) + max_ncpus / 32;
+	}
+	if (dbuf_evict_nthreads > 1) {
+		dbuf_evict_args = kmem_zalloc(dbuf_evict_nthreads *
+		    sizeof (dbuf_evict_arg_t), KM_SLEEP);
+		for (uint_t i = 0; i < dbuf_evict_nthreads; i++)
+			taskq_init_ent(&dbuf_evict_args[i].dea_tqent);
+		dbuf_evict_taskq = taskq_create("dbuf_evict",
+		    dbuf_evict_nthreads, defclsyspri, dbuf_evict_nthreads,
+		    INT_MAX, TASKQ_PREPOPULATE);
+	}
+
 	dbuf_evict_thread_exit = B_FALSE;
 	mutex_init(&dbuf_evict_lock, NULL, MUTEX_DEFAULT, NULL);
 	cv_init(&dbuf_evict_cv, NULL, CV_DEFAULT, NULL);
@@ -987,6 +1130,7 @@ dbuf_init(void)
 
 	wmsum_init(&dbuf_sums.cache_count, 0);
 	wmsum_init(&dbuf_sums.cache_total_evicts, 0);
+	wmsum_init(&dbuf_sums.cache_evict_parallel, 0);
 	for (int i = 0; i < DN_MAX_LEVELS; i++) {
 		wmsum_init(&dbuf_sums.cache_levels[i], 0);
 		wmsum_init(&dbuf_sums.cache_levels_bytes[i], 0);
@@ -1044,6 +1188,14 @@ dbuf_fini(void)
 	}
 	mutex_exit(&dbuf_evict_lock);
 
+	if (dbuf_evict_taskq != NULL) {
+		taskq_destroy(dbuf_evict_taskq);
+		dbuf_evict_taskq = NULL;
+		kmem_free(dbuf_evict_args, dbuf_evict_nthreads *
+		    sizeof (dbuf_evict_arg_t));
+		dbuf_evict_args = NULL;
+	}
+
 	mutex_destroy(&dbuf_evict_lock);
 	cv_destroy(&dbuf_evict_cv);
 
@@ -1059,6 +1211,7 @@ dbuf_fini(void)
 
 	wmsum_fini(&dbuf_sums.cache_count);
 	wmsum_fini(&dbuf_sums.cache_total_evicts);
+	wmsum_fini(&dbuf_sums.cache_evict_parallel);
 	for (int i = 0; i < DN_MAX_LEVELS; i++) {
 		wmsum_fini(&dbuf_sums.cache_levels[i]);
 		wmsum_fini(&dbuf_sums.cache_levels_bytes[i]);
@@ -1406,6 +1559,7 @@ dbuf_read_done(zio_t *zio, const zbookmark_phys_t *zb, const blkptr_t *bp,
 	} else {
 		/* success */
 		ASSERT(zio == NULL || zio->io_error == 0);
+		arc_buf_set_tenant(buf, db->db_objset->os_arc_tenant);
 		dbuf_set_data(db, buf);
 		db->db_state = DB_CACHED;
 		DTRACE_SET_STATE(db, "successful read");
@@ -1590,9 +1744,9 @@ dbuf_read_impl(dmu_buf_impl_t *db, dnode_t *dn, zio_t *zio, uint32_t flags,
 	}
 
 	/*
-	 * If we have a pending block clone, we don't want to read the
-	 * underlying block, but the content of the block being cloned,
-	 * pointed by the dirty record, so we have the most recent data.
+	 * If we have a pending block clone or Direct I/O write, we don't want
+	 * to read the underlying block, but the block pointed to by the dirty
+	 * record, so we have the most recent data.
 	 * If there is no dirty record, then we hit a race in a sync
 	 * process when the dirty record is already removed, while the
 	 * dbuf is not yet destroyed. Such case is equivalent to uncached.
@@ -1600,7 +1754,8 @@ dbuf_read_impl(dmu_buf_impl_t *db, dnode_t *dn, zio_t *zio, uint32_t flags,
 	if (db->db_state == DB_NOFILL) {
 		dbuf_dirty_record_t *dr = list_head(&db->db_dirty_records);
 		if (dr != NULL) {
-			if (!dr->dt.dl.dr_brtwrite) {
+			if (!dr->dt.dl.dr_brtwrite &&
+			    !dr->dt.dl.dr_diowrite) {
 				err = EIO;
 				goto early_unlock;
 			}
@@ -1651,7 +1806,11 @@ dbuf_read_impl(dmu_buf_impl_t *db, dnode_t *dn, zio_t *zio, uint32_t flags,
 	DTRACE_SET_STATE(db, "read issued");
 	mutex_exit(&db->db_mtx);
 
-	if (!DBUF_IS_CACHEABLE(db))
+	if (!DBUF_IS_CACHEABLE(db) || (flags & DB_RF_UNCACHED))
+		aflags |= ARC_FLAG_UNCACHED;
+	else if (db->db_level == 0 &&
+	    db->db_objset->os_cacheadmit == ZFS_CACHEADMIT_FREQUENT &&
+	    !arc_admit(db->db_objset->os_spa, bpp, B_TRUE))
 		aflags |= ARC_FLAG_UNCACHED;
 	else if (dbuf_is_l2cacheable(db))
 		aflags |= ARC_FLAG_L2CACHE;
@@ -1789,6 +1948,13 @@ dbuf_read(dmu_buf_impl_t *db, zio_t *pio, uint32_t flags)
 		db->db_partial_read = B_FALSE;
 	miss = (db->db_state != DB_CACHED);
 
+	/*
+	 * The caller keeps its own copy of the data (e.g. in the page
+	 * cache), so don't keep a dbuf around that it has read in.
+	 */
+	if (miss && (flags & DB_RF_UNCACHED) && db->db_level == 0)
+		db->db_pending_evict = B_TRUE;
+
 	if (db->db_state == DB_READ || db->db_state == DB_FILL) {
 		/*
 		 * Another reader came in while the dbuf was in flight between
@@ -1943,6 +2109,7 @@ dbuf_unoverride(dbuf_dirty_record_t *dr)
 	dr->dt.dl.dr_override_state = DR_NOT_OVERRIDDEN;
 	dr->dt.dl.dr_nopwrite = B_FALSE;
 	dr->dt.dl.dr_brtwrite = B_FALSE;
+	dr->dt.dl.dr_diowrite = B_FALSE;
 	dr->dt.dl.dr_has_raw_params = B_FALSE;
 
 	/*
@@ -2356,6 +2523,7 @@ dbuf_dirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
 				 * syncing state (since they are only modified
 				 * then).
 				 */
+				dr->dt.dl.dr_hot = arc_buf_is_mfu(db->db_buf);
 				arc_release(db->db_buf, db);
 				dbuf_fix_old_data(db, tx->tx_txg);
 				data_old = db->db_buf;
@@ -2531,7 +2699,7 @@ boolean_t
 dbuf_undirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
 {
 	uint64_t txg = tx->tx_txg;
-	boolean_t brtwrite;
+	boolean_t brtwrite, diowrite;
 
 	ASSERT(txg != 0);
 
@@ -2557,6 +2725,7 @@ dbuf_undirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
 	ASSERT(dr->dr_dbuf == db);
 
 	brtwrite = dr->dt.dl.dr_brtwrite;
+	diowrite = dr->dt.dl.dr_diowrite;
 	if (brtwrite) {
 		/*
 		 * We are freeing a block that we cloned in the same
@@ -2572,8 +2741,7 @@ dbuf_undirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
 
 	ASSERT(db->db.db_size != 0);
 
-	dsl_pool_undirty_space(dmu_objset_pool(dn->dn_objset),
-	    dr->dr_accounted, txg);
+	dmu_objset_undirty_space(dn->dn_objset, dr->dr_accounted, txg);
 
 	list_remove(&db->db_dirty_records, dr);
 
@@ -2595,7 +2763,14 @@ dbuf_undirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
 		mutex_exit(&dn->dn_mtx);
 	}
 
-	if (db->db_state != DB_NOFILL && !brtwrite) {
+	if (diowrite) {
+		/*
+		 * The block written by Direct I/O was allocated in this
+		 * txg and nothing else references it, so free it.
+		 */
+		ASSERT0P(dr->dt.dl.dr_data);
+		dbuf_unoverride(dr);
+	} else if (db->db_state != DB_NOFILL && !brtwrite) {
 		dbuf_unoverride(dr);
 
 		ASSERT(db->db_buf != NULL);
@@ -2610,7 +2785,7 @@ dbuf_undirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
 	db->db_dirtycnt -= 1;
 
 	if (zfs_refcount_remove(&db->db_holds, (void *)(uintptr_t)txg) == 0) {
-		ASSERT(db->db_state == DB_NOFILL || brtwrite ||
+		ASSERT(db->db_state == DB_NOFILL || brtwrite || diowrite ||
 		    arc_released(db->db_buf));
 		dbuf_destroy(db);
 		return (B_TRUE);
@@ -2642,13 +2817,14 @@ dmu_buf_will_dirty_impl(dmu_buf_t *db_fake, int flags, dmu_tx_t *tx)
 		dbuf_dirty_record_t *dr = dbuf_find_dirty_eq(db, tx->tx_txg);
 		if (dr != NULL) {
 			if (db->db_level == 0 &&
-			    dr->dt.dl.dr_brtwrite) {
+			    (dr->dt.dl.dr_brtwrite ||
+			    dr->dt.dl.dr_diowrite)) {
 				/*
-				 * Block cloning: If we are dirtying a cloned
-				 * level 0 block, we cannot simply redirty it,
-				 * because this dr has no associated data.
-				 * We will go through a full undirtying below,
-				 * before dirtying it again.
+				 * Block cloning or Direct I/O: If we are
+				 * dirtying such a level 0 block, we cannot
+				 * simply redirty it, because this dr has no
+				 * associated data.  We will go through a full
+				 * undirtying below, before dirtying it again.
 				 */
 				undirty = B_TRUE;
 			} else {
@@ -2701,13 +2877,18 @@ dmu_buf_is_dirty(dmu_buf_t *db_fake, dmu_tx_t *tx)
 	return (dr != NULL);
 }
 
+/*
+ * Prepare a level 0 block to have its contents replaced by a block pointer
+ * supplied by the caller (see dmu_brt_clone() and dmu_write_direct()),
+ * rather than by data in the dbuf.
+ */
 void
-dmu_buf_will_clone(dmu_buf_t *db_fake, dmu_tx_t *tx)
+dmu_buf_will_clone_or_dio(dmu_buf_t *db_fake, dmu_tx_t *tx)
 {
 	dmu_buf_impl_t *db = (dmu_buf_impl_t *)db_fake;
 
 	/*
-	 * Block cloning: We are going to clone into this block, so undirty
+	 * We are going to clone or direct write into this block, so undirty
 	 * modifications done to this block so far in this txg. This includes
 	 * writes and clones into this block.
 	 */
@@ -2731,6 +2912,41 @@ dmu_buf_will_clone(dmu_buf_t *db_fake, dmu_tx_t *tx)
 	(void) dbuf_dirty(db, tx);
 }
 
+/*
+ * Direct I/O: if this level 0 block has no data in the dbuf and is not
+ * dirty, copy the block pointer it would be read from into *bp and return
+ * B_TRUE, so that the caller can read it without instantiating it in the
+ * ARC.  Holes and blocks which are freed, embedded or redacted are left to
+ * dbuf_read().
+ */
+boolean_t
+dmu_buf_direct_bp(dmu_buf_t *db_fake, blkptr_t *bp)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)db_fake;
+	boolean_t direct = B_FALSE;
+
+	ASSERT0(db->db_level);
+	ASSERT(db->db_blkid != DMU_BONUS_BLKID);
+	ASSERT(!zfs_refcount_is_zero(&db->db_holds));
+
+	DB_DNODE_ENTER(db);
+	mutex_enter(&db->db_mtx);
+	db_lock_type_t dblt = dmu_buf_lock_parent(db, RW_READER, FTAG);
+	if (db->db_state == DB_UNCACHED && db->db_dirtycnt == 0 &&
+	    db->db_blkptr != NULL && !BP_IS_HOLE(db->db_blkptr) &&
+	    !BP_IS_EMBEDDED(db->db_blkptr) &&
+	    !BP_IS_REDACTED(db->db_blkptr) &&
+	    !dnode_block_freed(DB_DNODE(db), db->db_blkid)) {
+		*bp = *db->db_blkptr;
+		direct = B_TRUE;
+	}
+	dmu_buf_unlock_parent(db, dblt, FTAG);
+	mutex_exit(&db->db_mtx);
+	DB_DNODE_EXIT(db);
+
+	return (direct);
+}
+
 void
 dmu_buf_will_not_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
 {
@@ -3361,6 +3577,7 @@ typedef struct dbuf_prefetch_arg {
 	zio_priority_t dpa_prio; /* The priority I/Os should be issued at. */
 	zio_t *dpa_zio; /* The parent zio_t for all prefetches. */
 	arc_flags_t dpa_aflags; /* Flags to pass to the final prefetch. */
+	boolean_t dpa_admit; /* Consult arc_admit() for the final prefetch */
 	dbuf_prefetch_fn dpa_cb; /* prefetch completion callback */
 	void *dpa_arg; /* prefetch completion arg */
 } dbuf_prefetch_arg_t;
@@ -3407,6 +3624,16 @@ dbuf_issue_final_prefetch(dbuf_prefetch_arg_t *dpa, blkptr_t *bp)
 	    dpa->dpa_aflags | ARC_FLAG_NOWAIT | ARC_FLAG_PREFETCH |
 	    ARC_FLAG_NO_BUF;
 
+	/*
+	 * Only ask the admission filter here; the demand read that follows
+	 * will count the use.
+	 */
+	if (dpa->dpa_curlevel == 0 && !(aflags & ARC_FLAG_UNCACHED) &&
+	    dpa->dpa_admit && !arc_admit(dpa->dpa_spa, bp, B_FALSE)) {
+		aflags &= ~ARC_FLAG_L2CACHE;
+		aflags |= ARC_FLAG_UNCACHED;
+	}
+
 	/* dnodes are always read as raw and then converted later */
 	if (BP_GET_TYPE(bp) == DMU_OT_DNODE && BP_IS_PROTECTED(bp) &&
 	    dpa->dpa_curlevel == 0)
@@ -3620,6 +3847,8 @@ dbuf_prefetch_impl(dnode_t *dn, int64_t level, uint64_t blkid,
 	dpa->dpa_zio = pio;
 	dpa->dpa_cb = cb;
 	dpa->dpa_arg = arg;
+	dpa->dpa_admit =
+	    dn->dn_objset->os_cacheadmit == ZFS_CACHEADMIT_FREQUENT;
 
 	if (!DNODE_LEVEL_IS_CACHEABLE(dn, level))
 		dpa->dpa_aflags |= ARC_FLAG_UNCACHED;
@@ -4457,8 +4686,7 @@ dbuf_lightweight_done(zio_t *zio)
 		dsl_dataset_block_born(ds, zio->io_bp, tx);
 	}
 
-	dsl_pool_undirty_space(dmu_objset_pool(os), dr->dr_accounted,
-	    zio->io_txg);
+	dmu_objset_undirty_space(os, dr->dr_accounted, zio->io_txg);
 
 	abd_free(dr->dt.dll.dr_abd);
 	kmem_free(dr, sizeof (*dr));
@@ -4534,7 +4762,7 @@ dbuf_sync_leaf(dbuf_dirty_record_t *dr, dmu_tx_t *tx)
 		 * write here because the read has already been issued and the
 		 * contents won't change.
 		 */
-		ASSERT(dr->dt.dl.dr_brtwrite &&
+		ASSERT((dr->dt.dl.dr_brtwrite || dr->dt.dl.dr_diowrite) &&
 		    dr->dt.dl.dr_override_state == DR_OVERRIDDEN);
 	} else {
 		ASSERT(db->db_state == DB_CACHED || db->db_state == DB_NOFILL);
@@ -4849,7 +5077,6 @@ dbuf_write_children_ready(zio_t *zio, arc_buf_t *buf, void *vdb)
 static void
 dbuf_write_done(zio_t *zio, arc_buf_t *buf, void *vdb)
 {
-	(void) buf;
 	dmu_buf_impl_t *db = vdb;
 	blkptr_t *bp_orig = &zio->io_bp_orig;
 	blkptr_t *bp = db->db_blkptr;
@@ -4871,6 +5098,9 @@ dbuf_write_done(zio_t *zio, arc_buf_t *buf, void *vdb)
 		dsl_dataset_block_born(ds, bp, tx);
 	}
 
+	if (buf != NULL)
+		arc_buf_set_tenant(buf, os->os_arc_tenant);
+
 	mutex_enter(&db->db_mtx);
 
 	DBUF_VERIFY(db);
@@ -4918,8 +5148,7 @@ dbuf_write_done(zio_t *zio, arc_buf_t *buf, void *vdb)
 	db->db_data_pending = NULL;
 	dbuf_rele_and_unlock(db, (void *)(uintptr_t)tx->tx_txg, B_FALSE);
 
-	dsl_pool_undirty_space(dmu_objset_pool(os), dr->dr_accounted,
-	    zio->io_txg);
+	dmu_objset_undirty_space(os, dr->dr_accounted, zio->io_txg);
 
 	kmem_free(dr, sizeof (dbuf_dirty_record_t));
 }
@@ -5148,6 +5377,10 @@ dbuf_write(dbuf_dirty_record_t *dr, arc_buf_t *data, dmu_tx_t *tx)
 	wp_flag |= (data == NULL) ? WP_NOFILL : 0;
 
 	dmu_write_policy(os, dn, db->db_level, wp_flag, &zp);
+	if (db->db_level == 0 && dr->dt.dl.dr_hot) {
+		zp.zp_zpl_smallblk = MAX(zp.zp_zpl_smallblk,
+		    zfs_special_class_hot_blocks);
+	}
 
 	/*
 	 * We copy the blkptr now (rather than when we instantiate the dirty
@@ -5161,11 +5394,15 @@ dbuf_write(dbuf_dirty_record_t *dr, arc_buf_t *data, dmu_tx_t *tx)
 	    dr->dt.dl.dr_override_state == DR_OVERRIDDEN) {
 		/*
 		 * The BP for this block has been provided by open context
-		 * (by dmu_sync() or dmu_buf_write_embedded()).
+		 * (by dmu_sync(), dmu_buf_write_embedded() or Direct I/O).
+		 * A Direct I/O block has no data here for dedup to use.
 		 */
 		abd_t *contents = (data != NULL) ?
 		    abd_get_from_buf(data->b_data, arc_buf_size(data)) : NULL;
 
+		if (dr->dt.dl.dr_diowrite)
+			zp.zp_dedup = B_FALSE;
+
 		dr->dr_zio = zio_write(pio, os->os_spa, txg, &dr->dr_bp_copy,
 		    contents, db->db.db_size, db->db.db_size, &zp,
 		    dbuf_write_override_ready, NULL,
@@ -5220,7 +5457,8 @@ EXPORT_SYMBOL(dbuf_dirty);
 EXPORT_SYMBOL(dmu_buf_set_crypt_params);
 EXPORT_SYMBOL(dmu_buf_will_dirty);
 EXPORT_SYMBOL(dmu_buf_is_dirty);
-EXPORT_SYMBOL(dmu_buf_will_clone);
+EXPORT_SYMBOL(dmu_buf_will_clone_or_dio);
+EXPORT_SYMBOL(dmu_buf_direct_bp);
 EXPORT_SYMBOL(dmu_buf_will_not_fill);
 EXPORT_SYMBOL(dmu_buf_will_fill);
 EXPORT_SYMBOL(dmu_buf_fill_done);
@@ -5261,5 +5499,15 @@ ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, cache_shift, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, metadata_cache_shift, UINT, ZMOD_RW,
 	"Set size of dbuf metadata cache to log2 fraction of arc size.");
 
+ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, evict_threads, UINT, ZMOD_RD,
+	"Number of threads used to evict from the dbuf cache.");
+
+ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, hash_table_shift, UINT, ZMOD_RD,
+	"Set size of dbuf hash table as log2 shift.");
+
 ZFS_MODULE_PARAM(zfs_dbuf, dbuf_, mutex_cache_shift, UINT, ZMOD_RD,
 	"Set size of dbuf cache mutex array as log2 shift.");
+
+ZFS_MODULE_PARAM(zfs, zfs_, special_class_hot_blocks, UINT, ZMOD_RW,
+	"Place frequently read file blocks up to this size in the special "
+	"class when they are rewritten");
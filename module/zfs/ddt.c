@@ -30,6 +30,7 @@
 #include <sys/spa.h>
 #include <sys/spa_impl.h>
 #include <sys/zio.h>
+#include <sys/blkptr.h>
 #include <sys/ddt.h>
 #include <sys/ddt_impl.h>
 #include <sys/zap.h>
@@ -39,6 +40,8 @@
 #include <sys/zio_checksum.h>
 #include <sys/dsl_scan.h>
 #include <sys/abd.h>
+#include <sys/zfeature.h>
+#include <sys/dsl_synctask.h>
 
 /*
  * # DDT: Deduplication tables
@@ -87,10 +90,10 @@
  * Instead, the changes to an entry are tracked in memory, and written down to
  * disk at the end of each txg.
  *
- * A "live" in-memory entry (ddt_entry_t) is a node on the live tree
- * (ddt_tree).  At the start of a txg, ddt_tree is empty. When an entry is
- * required for IO, ddt_lookup() is called. If an entry already exists on
- * ddt_tree, it is returned. Otherwise, a new one is created, and the
+ * A "live" in-memory entry (ddt_entry_t) is a node on the live tree. At the
+ * start of a txg, the live tree is empty. When an entry is required for IO,
+ * ddt_lookup() is called. If an entry already exists on the live tree, it is
+ * returned. Otherwise, a new one is created, and the
  * type/class objects for the DDT are searched for that key. If its found, its
  * value is copied into the live entry. If not, an empty entry is created.
  *
@@ -98,8 +101,32 @@
  * refcount, but sometimes by adding or updating DVAs. At the end of the txg
  * (during spa_sync()), type and class are recalculated for entry (see
  * ddt_sync_entry()), and the entry is written to the appropriate storage
- * object and (if necessary), removed from an old one. ddt_tree is cleared and
- * the next txg can start.
+ * object and (if necessary), removed from an old one. The live tree is cleared
+ * and the next txg can start.
+ *
+ * ## Locking
+ *
+ * The live tree is split into a number of shards (ddt_shard_t), each with its
+ * own AVL tree and lock. An entry always lives in the shard chosen by a hash
+ * of its key (ddt_shard_select()), and the shard lock protects the tree and
+ * every entry on it. Lookups and updates for different blocks will usually
+ * land on different shards, and so don't contend with each other.
+ *
+ * The table lock (ddt_enter()) protects everything else: the in-memory log
+ * trees, the stats and histograms, and the repair tree. It is only held for
+ * short periods. If both are needed, the shard lock must be taken first.
+ *
+ * ## Dedup log
+ *
+ * If the fast_dedup feature is enabled, changed entries are not written
+ * straight to the storage objects at the end of the txg. Instead, they are
+ * appended to an on-disk log, and a copy is kept in memory. ddt_lookup()
+ * checks the log before the storage objects. Logged entries are moved to the
+ * storage objects a few at a time over the following txgs (see
+ * ddt_sync_flush_log()). This turns the random updates to the storage
+ * objects into sequential log writes, and lets updates to the same entry
+ * across many txgs be combined into a single storage update. See ddt_log.c
+ * for the details.
  *
  * ## Repair IO
  *
@@ -152,8 +179,21 @@ static kmem_cache_t *ddt_entry_cache;
  */
 int zfs_dedup_prefetch = 0;
 
+/*
+ * Enable/disable prefetching the DDT entries for dedup writes before looking
+ * them up. See zio_ddt_write().
+ */
+int zfs_dedup_write_prefetch = 1;
+
+/*
+ * Number of live tree shards for each DDT. 0 means one per CPU, but at
+ * least 4, the same as multilist_create().
+ */
+uint_t zfs_dedup_shards = 0;
+
 static const ddt_ops_t *const ddt_ops[DDT_TYPES] = {
 	&ddt_zap_ops,
+	&ddt_flat_ops,
 };
 
 static const char *const ddt_class_name[DDT_CLASSES] = {
@@ -185,6 +225,9 @@ ddt_object_create(ddt_t *ddt, ddt_type_t type, ddt_class_t class,
 	VERIFY0(zap_add(os, spa->spa_ddt_stat_object, name,
 	    sizeof (uint64_t), sizeof (ddt_histogram_t) / sizeof (uint64_t),
 	    &ddt->ddt_histogram[type][class], tx));
+
+	if (type == DDT_TYPE_FLAT)
+		spa_feature_incr(spa, SPA_FEATURE_DEDUP_FLAT, tx);
 }
 
 static void
@@ -208,6 +251,9 @@ ddt_object_destroy(ddt_t *ddt, ddt_type_t type, ddt_class_t class,
 	VERIFY0(ddt_ops[type]->ddt_op_destroy(os, *objectp, tx));
 	memset(&ddt->ddt_object_stats[type][class], 0, sizeof (ddt_object_t));
 
+	if (type == DDT_TYPE_FLAT)
+		spa_feature_decr(spa, SPA_FEATURE_DEDUP_FLAT, tx);
+
 	*objectp = 0;
 }
 
@@ -319,13 +365,15 @@ ddt_object_prefetch(ddt_t *ddt, ddt_type_t type, ddt_class_t class,
 
 static int
 ddt_object_update(ddt_t *ddt, ddt_type_t type, ddt_class_t class,
-    ddt_entry_t *dde, dmu_tx_t *tx)
+    const ddt_key_t *ddk, const ddt_phys_t *phys, dmu_tx_t *tx)
 {
 	ASSERT(ddt_object_exists(ddt, type, class));
 
+	ddt_cache_remove(ddt, ddk);
+
 	return (ddt_ops[type]->ddt_op_update(ddt->ddt_os,
-	    ddt->ddt_object[type][class], &dde->dde_key, dde->dde_phys,
-	    sizeof (dde->dde_phys), tx));
+	    ddt->ddt_object[type][class], ddk, phys,
+	    sizeof (ddt_phys_t) * DDT_PHYS_TYPES, tx));
 }
 
 static int
@@ -334,6 +382,8 @@ ddt_object_remove(ddt_t *ddt, ddt_type_t type, ddt_class_t class,
 {
 	ASSERT(ddt_object_exists(ddt, type, class));
 
+	ddt_cache_remove(ddt, ddk);
+
 	return (ddt_ops[type]->ddt_op_remove(ddt->ddt_os,
 	    ddt->ddt_object[type][class], ddk, tx));
 }
@@ -419,15 +469,19 @@ ddt_bp_create(enum zio_checksum checksum,
 void
 ddt_key_fill(ddt_key_t *ddk, const blkptr_t *bp)
 {
+	blkptr_view_t bpv;
+
+	bp_view(bp, &bpv);
+
 	ddk->ddk_cksum = bp->blk_cksum;
 	ddk->ddk_prop = 0;
 
 	ASSERT(BP_IS_ENCRYPTED(bp) || !BP_USES_CRYPT(bp));
 
-	DDK_SET_LSIZE(ddk, BP_GET_LSIZE(bp));
-	DDK_SET_PSIZE(ddk, BP_GET_PSIZE(bp));
-	DDK_SET_COMPRESS(ddk, BP_GET_COMPRESS(bp));
-	DDK_SET_CRYPT(ddk, BP_USES_CRYPT(bp));
+	DDK_SET_LSIZE(ddk, bpv.bpv_lsize);
+	DDK_SET_PSIZE(ddk, bpv.bpv_psize);
+	DDK_SET_COMPRESS(ddk, bpv.bpv_compress);
+	DDK_SET_CRYPT(ddk, bpv.bpv_crypt);
 }
 
 void
@@ -502,6 +556,41 @@ ddt_phys_total_refcnt(const ddt_entry_t *dde)
 	return (refcnt);
 }
 
+/*
+ * Select the storage type for an entry with the given phys. Entries that only
+ * use the single-copy phys are stored in the compact flat type, if this DDT
+ * uses it; see ddt_sync_table() for how that is decided.
+ */
+static ddt_type_t
+ddt_entry_type(const ddt_t *ddt, const ddt_phys_t *phys)
+{
+	if (!ddt->ddt_flat)
+		return (DDT_TYPE_DEFAULT);
+
+	for (int p = 0; p < DDT_PHYS_TYPES; p++) {
+		if (p != DDT_PHYS_SINGLE && phys[p].ddp_phys_birth != 0)
+			return (DDT_TYPE_DEFAULT);
+	}
+
+	return (DDT_TYPE_FLAT);
+}
+
+/*
+ * True if none of the storage objects for this DDT exist.
+ */
+static boolean_t
+ddt_objects_empty(ddt_t *ddt)
+{
+	for (ddt_type_t type = 0; type < DDT_TYPES; type++) {
+		for (ddt_class_t class = 0; class < DDT_CLASSES; class++) {
+			if (ddt_object_exists(ddt, type, class))
+				return (B_FALSE);
+		}
+	}
+
+	return (B_TRUE);
+}
+
 ddt_t *
 ddt_select(spa_t *spa, const blkptr_t *bp)
 {
@@ -521,6 +610,55 @@ ddt_exit(ddt_t *ddt)
 	mutex_exit(&ddt->ddt_lock);
 }
 
+static ddt_shard_t *
+ddt_shard_key(ddt_t *ddt, const ddt_key_t *ddk)
+{
+	const uint64_t *w = ddk->ddk_cksum.zc_word;
+	uint64_t hash = w[0] ^ w[1] ^ w[2] ^ w[3];
+
+	return (&ddt->ddt_shards[hash % ddt->ddt_num_shards]);
+}
+
+ddt_shard_t *
+ddt_shard_select(ddt_t *ddt, const blkptr_t *bp)
+{
+	ddt_key_t ddk;
+
+	ddt_key_fill(&ddk, bp);
+	return (ddt_shard_key(ddt, &ddk));
+}
+
+ddt_shard_t *
+ddt_shard_entry(ddt_t *ddt, const ddt_entry_t *dde)
+{
+	return (ddt_shard_key(ddt, &dde->dde_key));
+}
+
+void
+ddt_shard_enter(ddt_shard_t *dds)
+{
+	mutex_enter(&dds->dds_lock);
+}
+
+void
+ddt_shard_exit(ddt_shard_t *dds)
+{
+	mutex_exit(&dds->dds_lock);
+}
+
+/*
+ * Returns B_TRUE if there are no live entries in any shard. Only meaningful
+ * when nothing else can be adding entries, eg in syncing context.
+ */
+boolean_t
+ddt_live_empty(ddt_t *ddt)
+{
+	for (uint_t i = 0; i < ddt->ddt_num_shards; i++)
+		if (avl_numnodes(&ddt->ddt_shards[i].dds_tree) > 0)
+			return (B_FALSE);
+	return (B_TRUE);
+}
+
 void
 ddt_init(void)
 {
@@ -528,11 +666,17 @@ ddt_init(void)
 	    sizeof (ddt_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
 	ddt_entry_cache = kmem_cache_create("ddt_entry_cache",
 	    sizeof (ddt_entry_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
+
+	ddt_log_init();
+	ddt_cache_init();
 }
 
 void
 ddt_fini(void)
 {
+	ddt_cache_fini();
+	ddt_log_fini();
+
 	kmem_cache_destroy(ddt_entry_cache);
 	kmem_cache_destroy(ddt_cache);
 }
@@ -547,6 +691,8 @@ ddt_alloc(const ddt_key_t *ddk)
 	cv_init(&dde->dde_cv, NULL, CV_DEFAULT, NULL);
 
 	dde->dde_key = *ddk;
+	dde->dde_stored_type = DDT_TYPES;
+	dde->dde_stored_class = DDT_CLASSES;
 
 	return (dde);
 }
@@ -569,9 +715,11 @@ ddt_free(ddt_entry_t *dde)
 void
 ddt_remove(ddt_t *ddt, ddt_entry_t *dde)
 {
-	ASSERT(MUTEX_HELD(&ddt->ddt_lock));
+	ddt_shard_t *dds = ddt_shard_entry(ddt, dde);
+
+	ASSERT(MUTEX_HELD(&dds->dds_lock));
 
-	avl_remove(&ddt->ddt_tree, dde);
+	avl_remove(&dds->dds_tree, dde);
 	ddt_free(dde);
 }
 
@@ -579,18 +727,21 @@ ddt_entry_t *
 ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t add)
 {
 	ddt_key_t search;
+	ddt_shard_t *dds;
 	ddt_entry_t *dde;
 	ddt_type_t type;
 	ddt_class_t class;
 	avl_index_t where;
+	boolean_t logged;
 	int error;
 
-	ASSERT(MUTEX_HELD(&ddt->ddt_lock));
-
 	ddt_key_fill(&search, bp);
+	dds = ddt_shard_key(ddt, &search);
+
+	ASSERT(MUTEX_HELD(&dds->dds_lock));
 
 	/* Find an existing live entry */
-	dde = avl_find(&ddt->ddt_tree, &search, &where);
+	dde = avl_find(&dds->dds_tree, &search, &where);
 	if (dde != NULL) {
 		/* Found it. If it's already loaded, we can just return it. */
 		if (dde->dde_flags & DDE_FLAG_LOADED)
@@ -598,7 +749,7 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t add)
 
 		/* Someone else is loading it, wait for it. */
 		while (!(dde->dde_flags & DDE_FLAG_LOADED))
-			cv_wait(&dde->dde_cv, &ddt->ddt_lock);
+			cv_wait(&dde->dde_cv, &dds->dds_lock);
 
 		return (dde);
 	}
@@ -609,15 +760,53 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t add)
 
 	/* Time to make a new entry. */
 	dde = ddt_alloc(&search);
-	avl_insert(&ddt->ddt_tree, dde, where);
+	avl_insert(&dds->dds_tree, dde, where);
 
 	/*
-	 * ddt_tree is now stable, so unlock and let everyone else keep moving.
-	 * Anyone landing on this entry will find it without DDE_FLAG_LOADED,
-	 * and go to sleep waiting for it above.
+	 * If the entry has been logged, the logged copy is the most recent,
+	 * and it's already in memory, so we're done.
 	 */
+	ddt_enter(ddt);
+	logged = ddt_log_find_key(ddt, &search, dde);
+	if (logged) {
+		uint64_t refcnt = ddt_phys_total_refcnt(dde);
+		if (refcnt == 0) {
+			/* Logged as removed, so it doesn't exist. */
+			dde->dde_type = DDT_TYPES;
+			dde->dde_class = DDT_CLASSES;
+		} else {
+			dde->dde_type = ddt_entry_type(ddt, dde->dde_phys);
+			dde->dde_class = refcnt > 1 ?
+			    DDT_CLASS_DUPLICATE : DDT_CLASS_UNIQUE;
+			ddt_stat_update(ddt, dde, -1ULL);
+		}
+	}
 	ddt_exit(ddt);
 
+	if (logged) {
+		dde->dde_flags |= DDE_FLAG_LOADED;
+		return (dde);
+	}
+
+	/*
+	 * If a decoded copy of the stored entry is cached, use that, and skip
+	 * the storage objects entirely.
+	 */
+	if (ddt_cache_lookup(ddt, &search, dde)) {
+		ddt_enter(ddt);
+		ddt_stat_update(ddt, dde, -1ULL);
+		ddt_exit(ddt);
+		dde->dde_flags |= DDE_FLAG_LOADED;
+		return (dde);
+	}
+
+	/*
+	 * The shard is now stable, so unlock and let everyone else keep
+	 * moving. Anyone landing on this entry will find it without
+	 * DDE_FLAG_LOADED, and go to sleep waiting for it above.
+	 */
+	ddt_shard_exit(dds);
+
 	/* Search all store objects for the entry. */
 	error = ENOENT;
 	for (type = 0; type < DDT_TYPES; type++) {
@@ -632,15 +821,21 @@ ddt_lookup(ddt_t *ddt, const blkptr_t *bp, boolean_t add)
 			break;
 	}
 
-	ddt_enter(ddt);
+	ddt_shard_enter(dds);
 
 	ASSERT(!(dde->dde_flags & DDE_FLAG_LOADED));
 
 	dde->dde_type = type;	/* will be DDT_TYPES if no entry found */
 	dde->dde_class = class;	/* will be DDT_CLASSES if no entry found */
+	dde->dde_stored_type = type;
+	dde->dde_stored_class = class;
 
-	if (error == 0)
+	if (error == 0) {
+		ddt_enter(ddt);
 		ddt_stat_update(ddt, dde, -1ULL);
+		ddt_exit(ddt);
+		ddt_cache_insert(ddt, dde);
+	}
 
 	/* Entry loaded, everyone can proceed now */
 	dde->dde_flags |= DDE_FLAG_LOADED;
@@ -673,6 +868,51 @@ ddt_prefetch(spa_t *spa, const blkptr_t *bp)
 	}
 }
 
+/*
+ * If ddt_lookup() for this block would have to go to the storage objects,
+ * start reading the parts of them it will need, and return B_TRUE. If the
+ * entry is already in memory (live, logged or cached), return B_FALSE.
+ *
+ * This lets the write pipeline issue the storage reads for many dedup writes
+ * at once, and only then do the (now mostly cached) lookups.
+ */
+boolean_t
+ddt_prefetch_lookup(ddt_t *ddt, const blkptr_t *bp)
+{
+	ddt_key_t ddk;
+	ddt_shard_t *dds;
+	boolean_t found;
+
+	if (!zfs_dedup_write_prefetch)
+		return (B_FALSE);
+
+	ddt_key_fill(&ddk, bp);
+	dds = ddt_shard_key(ddt, &ddk);
+
+	ddt_shard_enter(dds);
+	found = avl_find(&dds->dds_tree, &ddk, NULL) != NULL;
+	ddt_shard_exit(dds);
+
+	if (!found) {
+		ddt_enter(ddt);
+		found = ddt_log_find_key(ddt, &ddk, NULL);
+		ddt_exit(ddt);
+	}
+	if (!found)
+		found = ddt_cache_lookup(ddt, &ddk, NULL);
+
+	if (found)
+		return (B_FALSE);
+
+	for (ddt_type_t type = 0; type < DDT_TYPES; type++) {
+		for (ddt_class_t class = 0; class < DDT_CLASSES; class++) {
+			ddt_object_prefetch(ddt, type, class, &ddk);
+		}
+	}
+
+	return (B_TRUE);
+}
+
 /*
  * Key comparison. Any struct wanting to make use of this function must have
  * the key as the first element.
@@ -708,10 +948,22 @@ ddt_table_alloc(spa_t *spa, enum zio_checksum c)
 	memset(ddt, 0, sizeof (ddt_t));
 
 	mutex_init(&ddt->ddt_lock, NULL, MUTEX_DEFAULT, NULL);
-	avl_create(&ddt->ddt_tree, ddt_key_compare,
-	    sizeof (ddt_entry_t), offsetof(ddt_entry_t, dde_node));
+
+	ddt->ddt_num_shards = zfs_dedup_shards > 0 ?
+	    zfs_dedup_shards : MAX(boot_ncpus, 4);
+	ddt->ddt_shards = kmem_zalloc(
+	    ddt->ddt_num_shards * sizeof (ddt_shard_t), KM_SLEEP);
+	for (uint_t i = 0; i < ddt->ddt_num_shards; i++) {
+		ddt_shard_t *dds = &ddt->ddt_shards[i];
+		mutex_init(&dds->dds_lock, NULL, MUTEX_DEFAULT, NULL);
+		avl_create(&dds->dds_tree, ddt_key_compare,
+		    sizeof (ddt_entry_t), offsetof(ddt_entry_t, dde_node));
+	}
+
 	avl_create(&ddt->ddt_repair_tree, ddt_key_compare,
 	    sizeof (ddt_entry_t), offsetof(ddt_entry_t, dde_node));
+	ddt_log_alloc(ddt);
+	ddt_cache_alloc(ddt);
 	ddt->ddt_checksum = c;
 	ddt->ddt_spa = spa;
 	ddt->ddt_os = spa->spa_meta_objset;
@@ -722,9 +974,16 @@ ddt_table_alloc(spa_t *spa, enum zio_checksum c)
 static void
 ddt_table_free(ddt_t *ddt)
 {
-	ASSERT0(avl_numnodes(&ddt->ddt_tree));
+	ASSERT(ddt_live_empty(ddt));
 	ASSERT0(avl_numnodes(&ddt->ddt_repair_tree));
-	avl_destroy(&ddt->ddt_tree);
+	ddt_cache_free(ddt);
+	ddt_log_free(ddt);
+	for (uint_t i = 0; i < ddt->ddt_num_shards; i++) {
+		ddt_shard_t *dds = &ddt->ddt_shards[i];
+		avl_destroy(&dds->dds_tree);
+		mutex_destroy(&dds->dds_lock);
+	}
+	kmem_free(ddt->ddt_shards, ddt->ddt_num_shards * sizeof (ddt_shard_t));
 	avl_destroy(&ddt->ddt_repair_tree);
 	mutex_destroy(&ddt->ddt_lock);
 	kmem_cache_free(ddt_cache, ddt);
@@ -769,6 +1028,15 @@ ddt_load(spa_t *spa)
 			}
 		}
 
+		for (ddt_class_t class = 0; class < DDT_CLASSES; class++) {
+			if (ddt_object_exists(ddt, DDT_TYPE_FLAT, class))
+				ddt->ddt_flat = B_TRUE;
+		}
+
+		error = ddt_log_load(ddt);
+		if (error != 0)
+			return (error);
+
 		/*
 		 * Seed the cached histograms.
 		 */
@@ -777,6 +1045,8 @@ ddt_load(spa_t *spa)
 		spa->spa_dedup_dspace = ~0ULL;
 	}
 
+	spa->spa_dedup_table_size = ddt_get_ddt_dsize(spa);
+
 	return (0);
 }
 
@@ -827,6 +1097,14 @@ ddt_repair_start(ddt_t *ddt, const blkptr_t *bp)
 
 	dde = ddt_alloc(&ddk);
 
+	/* The logged copy, if any, is more recent than the stores. */
+	ddt_enter(ddt);
+	if (ddt_log_find_key(ddt, &ddk, dde)) {
+		ddt_exit(ddt);
+		return (dde);
+	}
+	ddt_exit(ddt);
+
 	for (ddt_type_t type = 0; type < DDT_TYPES; type++) {
 		for (ddt_class_t class = 0; class < DDT_CLASSES; class++) {
 			/*
@@ -922,13 +1200,14 @@ ddt_repair_table(ddt_t *ddt, zio_t *rio)
 }
 
 static void
-ddt_sync_entry(ddt_t *ddt, ddt_entry_t *dde, dmu_tx_t *tx, uint64_t txg)
+ddt_sync_entry(ddt_t *ddt, ddt_entry_t *dde, ddt_log_update_t *dlu,
+    dmu_tx_t *tx, uint64_t txg)
 {
 	dsl_pool_t *dp = ddt->ddt_spa->spa_dsl_pool;
 	ddt_phys_t *ddp = dde->dde_phys;
 	ddt_key_t *ddk = &dde->dde_key;
 	ddt_type_t otype = dde->dde_type;
-	ddt_type_t ntype = DDT_TYPE_DEFAULT;
+	ddt_type_t ntype;
 	ddt_class_t oclass = dde->dde_class;
 	ddt_class_t nclass;
 	uint64_t total_refcnt = 0;
@@ -956,11 +1235,41 @@ ddt_sync_entry(ddt_t *ddt, ddt_entry_t *dde, dmu_tx_t *tx, uint64_t txg)
 
 	/* We do not create new DDT-DITTO blocks. */
 	ASSERT0(dde->dde_phys[DDT_PHYS_DITTO].ddp_phys_birth);
+	ntype = ddt_entry_type(ddt, dde->dde_phys);
 	if (total_refcnt > 1)
 		nclass = DDT_CLASS_DUPLICATE;
 	else
 		nclass = DDT_CLASS_UNIQUE;
 
+	if (dlu != NULL) {
+		/*
+		 * Logging; the store will be updated when the entry is
+		 * flushed. If it didn't exist before and still doesn't,
+		 * there's nothing to record.
+		 */
+		if (total_refcnt != 0) {
+			dde->dde_type = ntype;
+			dde->dde_class = nclass;
+			ddt_stat_update(ddt, dde, 0);
+
+			/*
+			 * Create the target object now, so the histogram for
+			 * the entry's class is saved with it.
+			 */
+			if (!ddt_object_exists(ddt, ntype, nclass))
+				ddt_object_create(ddt, ntype, nclass, tx);
+		}
+		if (total_refcnt != 0 || otype != DDT_TYPES) {
+			ddt_log_entry(ddt, dlu, ddk, dde->dde_phys,
+			    dde->dde_stored_type, dde->dde_stored_class);
+		}
+		if (total_refcnt != 0 && nclass < oclass) {
+			dsl_scan_ddt_entry(dp->dp_scan,
+			    ddt->ddt_checksum, dde, tx);
+		}
+		return;
+	}
+
 	if (otype != DDT_TYPES &&
 	    (otype != ntype || oclass != nclass || total_refcnt == 0)) {
 		VERIFY0(ddt_object_remove(ddt, otype, oclass, ddk, tx));
@@ -974,7 +1283,8 @@ ddt_sync_entry(ddt_t *ddt, ddt_entry_t *dde, dmu_tx_t *tx, uint64_t txg)
 		ddt_stat_update(ddt, dde, 0);
 		if (!ddt_object_exists(ddt, ntype, nclass))
 			ddt_object_create(ddt, ntype, nclass, tx);
-		VERIFY0(ddt_object_update(ddt, ntype, nclass, dde, tx));
+		VERIFY0(ddt_object_update(ddt, ntype, nclass, ddk,
+		    dde->dde_phys, tx));
 
 		/*
 		 * If the class changes, the order that we scan this bp
@@ -990,14 +1300,143 @@ ddt_sync_entry(ddt_t *ddt, ddt_entry_t *dde, dmu_tx_t *tx, uint64_t txg)
 	}
 }
 
+/*
+ * Move a logged entry to the storage objects, removing it from the object it
+ * was previously stored in if necessary. Returns the type and class of the
+ * object it is now stored in, if any.
+ */
+static void
+ddt_sync_flush_entry(ddt_t *ddt, ddt_log_entry_t *ddle, ddt_type_t *typep,
+    ddt_class_t *classp, dmu_tx_t *tx)
+{
+	ddt_key_t *ddk = &ddle->ddle_key;
+	ddt_type_t otype = ddle->ddle_type;
+	ddt_type_t ntype = ddt_entry_type(ddt, ddle->ddle_phys);
+	ddt_class_t oclass = ddle->ddle_class;
+	ddt_class_t nclass;
+	uint64_t total_refcnt = 0;
+
+	/* Ditto phys are freed before the entry is logged. */
+	ASSERT0(ddle->ddle_phys[DDT_PHYS_DITTO].ddp_phys_birth);
+
+	for (int p = DDT_PHYS_SINGLE; p <= DDT_PHYS_TRIPLE; p++)
+		total_refcnt += ddle->ddle_phys[p].ddp_refcnt;
+
+	if (total_refcnt > 1)
+		nclass = DDT_CLASS_DUPLICATE;
+	else
+		nclass = DDT_CLASS_UNIQUE;
+
+	if (otype != DDT_TYPES &&
+	    (otype != ntype || oclass != nclass || total_refcnt == 0)) {
+		VERIFY0(ddt_object_remove(ddt, otype, oclass, ddk, tx));
+		ASSERT3U(
+		    ddt_object_contains(ddt, otype, oclass, ddk), ==, ENOENT);
+	}
+
+	if (total_refcnt == 0) {
+		*typep = DDT_TYPES;
+		*classp = DDT_CLASSES;
+		return;
+	}
+
+	if (!ddt_object_exists(ddt, ntype, nclass))
+		ddt_object_create(ddt, ntype, nclass, tx);
+	VERIFY0(ddt_object_update(ddt, ntype, nclass, ddk, ddle->ddle_phys,
+	    tx));
+
+	*typep = ntype;
+	*classp = nclass;
+}
+
+/*
+ * Flush up to count entries from the flushing log to the storage objects.
+ */
+static void
+ddt_sync_flush_entries(ddt_t *ddt, uint64_t count, dmu_tx_t *tx)
+{
+	ddt_log_update_t dlu;
+	ddt_log_entry_t *ddle;
+	ddt_key_t last;
+	uint64_t n = 0;
+
+	ddt_log_begin(ddt, &dlu, tx);
+
+	while (n < count && (ddle = ddt_log_flush_next(ddt)) != NULL) {
+		ddt_type_t type;
+		ddt_class_t class;
+
+		ddt_sync_flush_entry(ddt, ddle, &type, &class, tx);
+		last = ddle->ddle_key;
+		ddt_log_flush_done(ddt, &dlu, ddle, type, class);
+		n++;
+	}
+
+	ddt_log_commit(ddt, &dlu);
+
+	if (n > 0 && !avl_is_empty(&ddt->ddt_log_flushing->ddl_tree))
+		ddt_log_checkpoint(ddt, &last, tx);
+}
+
+/*
+ * Move some logged entries to the storage objects, and swap the logs when
+ * the flushing log is empty and the active log is due. Normally, this is
+ * spread out over many txgs (see ddt_flush_rate), but if the in-core log uses
+ * too much memory, or if a flush was requested for a walk, the whole log is
+ * flushed immediately.
+ */
+static void
+ddt_sync_flush_log(ddt_t *ddt, dmu_tx_t *tx)
+{
+	uint64_t txg = dmu_tx_get_txg(tx);
+	ddt_log_t *addl = ddt->ddt_log_active;
+	boolean_t force = ddt->ddt_flush_force_txg != 0;
+	boolean_t overmem = ddt_log_memused(ddt) > zfs_dedup_log_mem_max;
+
+	ddt_sync_flush_entries(ddt,
+	    (force || overmem) ? UINT64_MAX : ddt->ddt_flush_rate, tx);
+
+	if (!avl_is_empty(&ddt->ddt_log_flushing->ddl_tree))
+		return;
+
+	ddt_log_truncate(ddt, tx);
+
+	if (!avl_is_empty(&addl->ddl_tree) && (force || overmem ||
+	    txg - addl->ddl_first_txg >= zfs_dedup_log_txg_max)) {
+		ddt_log_swap(ddt, tx);
+		if (force) {
+			ddt_sync_flush_entries(ddt, UINT64_MAX, tx);
+			ddt_log_truncate(ddt, tx);
+		}
+	}
+
+	if (force && ddt_log_empty(ddt))
+		ddt->ddt_flush_force_txg = 0;
+}
+
+/*
+ * True if the log has entries to flush, or the flushing log has been flushed
+ * but not yet truncated (eg after import).
+ */
+static boolean_t
+ddt_log_want_flush(ddt_t *ddt)
+{
+	ddt_log_t *fddl = ddt->ddt_log_flushing;
+
+	return (ddt_log_exists(ddt) && (!ddt_log_empty(ddt) ||
+	    fddl->ddl_length > 0 || (fddl->ddl_flags & DDL_FLAG_CHECKPOINT)));
+}
+
 static void
 ddt_sync_table(ddt_t *ddt, dmu_tx_t *tx, uint64_t txg)
 {
 	spa_t *spa = ddt->ddt_spa;
 	ddt_entry_t *dde;
-	void *cookie = NULL;
+	boolean_t flush = spa_sync_pass(spa) == 1 && ddt_log_want_flush(ddt);
+
+	boolean_t empty = ddt_live_empty(ddt);
 
-	if (avl_numnodes(&ddt->ddt_tree) == 0)
+	if (empty && !flush)
 		return;
 
 	ASSERT3U(spa->spa_uberblock.ub_version, >=, SPA_VERSION_DEDUP);
@@ -1008,9 +1447,44 @@ ddt_sync_table(ddt_t *ddt, dmu_tx_t *tx, uint64_t txg)
 		    DMU_POOL_DDT_STATS, tx);
 	}
 
-	while ((dde = avl_destroy_nodes(&ddt->ddt_tree, &cookie)) != NULL) {
-		ddt_sync_entry(ddt, dde, tx, txg);
-		ddt_free(dde);
+	/*
+	 * Whether the flat type can be used is decided when the DDT has no
+	 * storage objects, so that it is fixed for as long as any entry
+	 * exists. Older DDTs only move to it once they have been emptied.
+	 */
+	if (ddt_objects_empty(ddt))
+		ddt->ddt_flat =
+		    spa_feature_is_enabled(spa, SPA_FEATURE_DEDUP_FLAT);
+
+	if (!ddt_log_exists(ddt) && !empty &&
+	    spa_feature_is_enabled(spa, SPA_FEATURE_FAST_DEDUP))
+		ddt_log_create(ddt, tx);
+
+	if (ddt_log_exists(ddt)) {
+		ddt_log_update_t dlu;
+
+		ddt_log_begin(ddt, &dlu, tx);
+		for (uint_t i = 0; i < ddt->ddt_num_shards; i++) {
+			avl_tree_t *t = &ddt->ddt_shards[i].dds_tree;
+			void *cookie = NULL;
+			while ((dde = avl_destroy_nodes(t, &cookie)) != NULL) {
+				ddt_sync_entry(ddt, dde, &dlu, tx, txg);
+				ddt_free(dde);
+			}
+		}
+		ddt_log_commit(ddt, &dlu);
+
+		if (spa_sync_pass(spa) == 1)
+			ddt_sync_flush_log(ddt, tx);
+	} else {
+		for (uint_t i = 0; i < ddt->ddt_num_shards; i++) {
+			avl_tree_t *t = &ddt->ddt_shards[i].dds_tree;
+			void *cookie = NULL;
+			while ((dde = avl_destroy_nodes(t, &cookie)) != NULL) {
+				ddt_sync_entry(ddt, dde, NULL, tx, txg);
+				ddt_free(dde);
+			}
+		}
 	}
 
 	for (ddt_type_t type = 0; type < DDT_TYPES; type++) {
@@ -1024,16 +1498,37 @@ ddt_sync_table(ddt_t *ddt, dmu_tx_t *tx, uint64_t txg)
 			}
 		}
 		for (ddt_class_t class = 0; class < DDT_CLASSES; class++) {
-			if (count == 0 && ddt_object_exists(ddt, type, class))
+			/*
+			 * Logged entries may still need the objects, and
+			 * their histograms, even if the objects are empty.
+			 */
+			if (count == 0 && ddt_log_empty(ddt) &&
+			    ddt_object_exists(ddt, type, class))
 				ddt_object_destroy(ddt, type, class, tx);
 		}
 	}
 
+	if (ddt_log_exists(ddt) && ddt_log_empty(ddt) && ddt_objects_empty(ddt))
+		ddt_log_destroy(ddt, tx);
+
 	memcpy(&ddt->ddt_histogram_cache, ddt->ddt_histogram,
 	    sizeof (ddt->ddt_histogram));
 	spa->spa_dedup_dspace = ~0ULL;
 }
 
+/*
+ * True if the DDTs have reached the dedup_table_quota pool property, and so
+ * no new entries should be created.
+ */
+boolean_t
+ddt_over_quota(spa_t *spa)
+{
+	if (spa->spa_dedup_table_quota == 0)
+		return (B_FALSE);
+
+	return (spa->spa_dedup_table_size >= spa->spa_dedup_table_quota);
+}
+
 void
 ddt_sync(spa_t *spa, uint64_t txg)
 {
@@ -1068,6 +1563,8 @@ ddt_sync(spa_t *spa, uint64_t txg)
 	(void) zio_wait(rio);
 	scn->scn_zio_root = NULL;
 
+	spa->spa_dedup_table_size = ddt_get_ddt_dsize(spa);
+
 	dmu_tx_commit(tx);
 }
 
@@ -1080,6 +1577,8 @@ ddt_walk(spa_t *spa, ddt_bookmark_t *ddb, ddt_entry_t *dde)
 				ddt_t *ddt = spa->spa_ddt[ddb->ddb_checksum];
 				if (ddt == NULL)
 					continue;
+				if (ddt->ddt_flush_force_txg != 0)
+					return (SET_ERROR(EAGAIN));
 				int error = ENOENT;
 				if (ddt_object_exists(ddt, ddb->ddb_type,
 				    ddb->ddb_class)) {
@@ -1103,6 +1602,42 @@ ddt_walk(spa_t *spa, ddt_bookmark_t *ddb, ddt_entry_t *dde)
 	return (SET_ERROR(ENOENT));
 }
 
+/*
+ * ddt_walk() only walks the storage objects, so any logged entries need to be
+ * flushed to them first. This requests that flush; the walk will return
+ * EAGAIN until it completes, which can be checked with ddt_walk_ready().
+ */
+void
+ddt_walk_init(spa_t *spa, uint64_t txg)
+{
+	if (txg == 0)
+		txg = spa_syncing_txg(spa);
+
+	for (enum zio_checksum c = 0; c < ZIO_CHECKSUM_FUNCTIONS; c++) {
+		ddt_t *ddt = spa->spa_ddt[c];
+		if (ddt == NULL || !ddt_log_exists(ddt))
+			continue;
+
+		if (!ddt_log_empty(ddt))
+			ddt->ddt_flush_force_txg = txg;
+	}
+}
+
+boolean_t
+ddt_walk_ready(spa_t *spa)
+{
+	for (enum zio_checksum c = 0; c < ZIO_CHECKSUM_FUNCTIONS; c++) {
+		ddt_t *ddt = spa->spa_ddt[c];
+		if (ddt == NULL)
+			continue;
+
+		if (ddt->ddt_flush_force_txg != 0)
+			return (B_FALSE);
+	}
+
+	return (B_TRUE);
+}
+
 /*
  * This function is used by Block Cloning (brt.c) to increase reference
  * counter for the DDT entry if the block is already in DDT.
@@ -1115,12 +1650,14 @@ boolean_t
 ddt_addref(spa_t *spa, const blkptr_t *bp)
 {
 	ddt_t *ddt;
+	ddt_shard_t *dds;
 	ddt_entry_t *dde;
 	boolean_t result;
 
 	spa_config_enter(spa, SCL_ZIO, FTAG, RW_READER);
 	ddt = ddt_select(spa, bp);
-	ddt_enter(ddt);
+	dds = ddt_shard_select(ddt, bp);
+	ddt_shard_enter(dds);
 
 	dde = ddt_lookup(ddt, bp, B_TRUE);
 	ASSERT3P(dde, !=, NULL);
@@ -1160,11 +1697,149 @@ ddt_addref(spa_t *spa, const blkptr_t *bp)
 		result = B_FALSE;
 	}
 
-	ddt_exit(ddt);
+	ddt_shard_exit(dds);
 	spa_config_exit(spa, SCL_ZIO, FTAG);
 
 	return (result);
 }
 
+/*
+ * Pruning removes unique entries whose block was born before a cutoff txg from
+ * the storage objects. The blocks themselves are untouched, and still have the
+ * dedup bit set; when they are freed, zio_ddt_free() won't find an entry and
+ * will free them directly. Entries that are dirty this txg or in the dedup log
+ * are left alone; they can be pruned next time.
+ */
+static uint64_t
+ddt_prune_table(ddt_t *ddt, uint64_t maxtxg, dmu_tx_t *tx)
+{
+	ddt_key_t ddk = {{{0}}};
+	ddt_entry_t *dde = ddt_alloc(&ddk);
+	uint64_t pruned = 0;
+
+	dde->dde_flags |= DDE_FLAG_LOADED;
+
+	for (ddt_type_t type = 0; type < DDT_TYPES; type++) {
+		const ddt_class_t class = DDT_CLASS_UNIQUE;
+		uint64_t walk = 0;
+
+		if (!ddt_object_exists(ddt, type, class))
+			continue;
+
+		while (ddt_object_walk(ddt, type, class, &walk, dde) == 0) {
+			ddt_phys_t *ddp = dde->dde_phys;
+			boolean_t old = B_TRUE;
+
+			if (ddp[DDT_PHYS_DITTO].ddp_phys_birth != 0)
+				continue;
+			for (int p = DDT_PHYS_SINGLE; p <= DDT_PHYS_TRIPLE;
+			    p++) {
+				if (ddp[p].ddp_phys_birth >= maxtxg)
+					old = B_FALSE;
+			}
+			if (!old || ddt_phys_total_refcnt(dde) != 1)
+				continue;
+
+			/*
+			 * Hold the lock over the remove, so a concurrent
+			 * lookup either already has the entry (and we skip
+			 * it), or won't find it at all.
+			 */
+			ddt_key_t *key = &dde->dde_key;
+			ddt_shard_t *dds = ddt_shard_key(ddt, key);
+			ddt_shard_enter(dds);
+			ddt_enter(ddt);
+			if (avl_find(&dds->dds_tree, key, NULL) != NULL ||
+			    ddt_log_find_key(ddt, key, NULL)) {
+				ddt_exit(ddt);
+				ddt_shard_exit(dds);
+				continue;
+			}
+			VERIFY0(ddt_object_remove(ddt, type, class, key, tx));
+			ddt_exit(ddt);
+			ddt_shard_exit(dds);
+
+			dde->dde_type = type;
+			dde->dde_class = class;
+			ddt_stat_update(ddt, dde, -1ULL);
+			pruned++;
+		}
+
+		ddt_object_sync(ddt, type, class, tx);
+	}
+
+	ddt_free(dde);
+
+	memcpy(&ddt->ddt_histogram_cache, ddt->ddt_histogram,
+	    sizeof (ddt->ddt_histogram));
+
+	return (pruned);
+}
+
+static int
+ddt_prune_check(void *arg, dmu_tx_t *tx)
+{
+	(void) arg;
+	spa_t *spa = dmu_tx_pool(tx)->dp_spa;
+
+	if (spa->spa_ddt_stat_object == 0)
+		return (SET_ERROR(ENOENT));
+
+	return (0);
+}
+
+static void
+ddt_prune_sync(void *arg, dmu_tx_t *tx)
+{
+	spa_t *spa = dmu_tx_pool(tx)->dp_spa;
+	uint64_t days = *(uint64_t *)arg;
+	uint64_t maxtxg, pruned = 0;
+
+	/*
+	 * Zero days means everything born before this txg. Otherwise, find a
+	 * txg that was synced at least that long ago.
+	 */
+	if (days == 0) {
+		maxtxg = dmu_tx_get_txg(tx);
+	} else {
+		uint64_t now = gethrestime_sec();
+		maxtxg = (days < now / (24 * 60 * 60)) ?
+		    spa_get_txg_at_time(spa, now - days * 24 * 60 * 60) : 0;
+	}
+
+	if (maxtxg != 0) {
+		for (enum zio_checksum c = 0; c < ZIO_CHECKSUM_FUNCTIONS;
+		    c++) {
+			ddt_t *ddt = spa->spa_ddt[c];
+			if (ddt == NULL)
+				continue;
+			pruned += ddt_prune_table(ddt, maxtxg, tx);
+		}
+		spa->spa_dedup_dspace = ~0ULL;
+	}
+
+	spa_history_log_internal(spa, "ddt prune", tx,
+	    "days=%llu maxtxg=%llu pruned=%llu", (u_longlong_t)days,
+	    (u_longlong_t)maxtxg, (u_longlong_t)pruned);
+}
+
+/*
+ * Remove unique entries from the DDT whose blocks were born more than the
+ * given number of days ago, to keep the table small. Zero days removes all
+ * unique entries.
+ */
+int
+ddt_prune_unique_entries(spa_t *spa, uint64_t days)
+{
+	return (dsl_sync_task(spa_name(spa), ddt_prune_check, ddt_prune_sync,
+	    &days, 0, ZFS_SPACE_CHECK_EXTRA_RESERVED));
+}
+
 ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, prefetch, INT, ZMOD_RW,
 	"Enable prefetching dedup-ed blks");
+
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, shards, UINT, ZMOD_RW,
+	"Number of live entry tree shards per DDT (0 = one per CPU)");
+
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, write_prefetch, INT, ZMOD_RW,
+	"Enable prefetching DDT entries for dedup writes before lookup");
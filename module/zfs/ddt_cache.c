@@ -0,0 +1,329 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2023, Klara Inc.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/ddt.h>
+#include <sys/ddt_impl.h>
+#include <sys/arc.h>
+#include <sys/kstat.h>
+#include <sys/wmsum.h>
+
+/*
+ * # DDT entry cache
+ *
+ * The live tree only holds entries that are being changed this txg. Any other
+ * lookup has to go to the storage objects, which means a trip through the
+ * dbuf cache and ARC, and decoding the entry out of a ZAP leaf every time.
+ * For a hot key, that's the same work over and over. It also means that DDT
+ * lookups slow down sharply when ARC is under pressure from regular data.
+ *
+ * The entry cache holds decoded copies of entries as they are in the storage
+ * objects, so ddt_lookup() can skip the storage objects entirely on a hit.
+ * It has its own memory limit (zfs_dedup_cache_max, shared by all DDTs) and
+ * its own LRU eviction, independent of ARC.
+ *
+ * The cache only ever holds what is in the storage objects. Entries are added
+ * when ddt_lookup() loads them, and dropped whenever the storage object copy
+ * is changed or removed (see ddt_object_update() and ddt_object_remove()), so
+ * it never has to be written back. The dedup log is checked before the cache,
+ * so an entry that has changed but not yet been flushed is never served from
+ * here.
+ */
+
+typedef struct {
+	/* key must be first for ddt_key_compare */
+	ddt_key_t	ddce_key;
+	ddt_phys_t	ddce_phys[DDT_PHYS_TYPES];
+
+	/* storage type and class the entry is held in */
+	ddt_type_t	ddce_type;
+	ddt_class_t	ddce_class;
+
+	avl_node_t	ddce_node;	/* ddt_cache_tree node */
+	list_node_t	ddce_lru_node;	/* ddt_cache_lru node */
+} ddt_cache_entry_t;
+
+static kmem_cache_t *ddt_cache_entry_cache;
+
+/*
+ * Maximum amount of memory to use for cached entries, across all DDTs. If 0
+ * at module load, it is set from zfs_dedup_cache_max_percent of total memory.
+ */
+static uint64_t zfs_dedup_cache_max = 0;
+static uint_t zfs_dedup_cache_max_percent = 1;
+
+/* Memory used by cached entries, across all DDTs. */
+static uint64_t ddt_cache_size = 0;
+
+typedef struct ddt_cache_stats {
+	kstat_named_t ddtcachestat_hits;
+	kstat_named_t ddtcachestat_misses;
+	kstat_named_t ddtcachestat_inserts;
+	kstat_named_t ddtcachestat_removes;
+	kstat_named_t ddtcachestat_evictions;
+	kstat_named_t ddtcachestat_size;
+	kstat_named_t ddtcachestat_max_size;
+} ddt_cache_stats_t;
+
+static ddt_cache_stats_t ddt_cache_stats = {
+	{ "hits",			KSTAT_DATA_UINT64 },
+	{ "misses",			KSTAT_DATA_UINT64 },
+	{ "inserts",			KSTAT_DATA_UINT64 },
+	{ "removes",			KSTAT_DATA_UINT64 },
+	{ "evictions",			KSTAT_DATA_UINT64 },
+	{ "size",			KSTAT_DATA_UINT64 },
+	{ "max_size",			KSTAT_DATA_UINT64 },
+};
+
+static struct {
+	wmsum_t ddtcachestat_hits;
+	wmsum_t ddtcachestat_misses;
+	wmsum_t ddtcachestat_inserts;
+	wmsum_t ddtcachestat_removes;
+	wmsum_t ddtcachestat_evictions;
+} ddt_cache_sums;
+
+#define	DDTCACHESTAT_BUMP(stat)					\
+	wmsum_add(&ddt_cache_sums.stat, 1)
+
+static kstat_t *ddt_cache_ksp;
+
+static int
+ddt_cache_kstats_update(kstat_t *ksp, int rw)
+{
+	ddt_cache_stats_t *dcs = ksp->ks_data;
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+	dcs->ddtcachestat_hits.value.ui64 =
+	    wmsum_value(&ddt_cache_sums.ddtcachestat_hits);
+	dcs->ddtcachestat_misses.value.ui64 =
+	    wmsum_value(&ddt_cache_sums.ddtcachestat_misses);
+	dcs->ddtcachestat_inserts.value.ui64 =
+	    wmsum_value(&ddt_cache_sums.ddtcachestat_inserts);
+	dcs->ddtcachestat_removes.value.ui64 =
+	    wmsum_value(&ddt_cache_sums.ddtcachestat_removes);
+	dcs->ddtcachestat_evictions.value.ui64 =
+	    wmsum_value(&ddt_cache_sums.ddtcachestat_evictions);
+	dcs->ddtcachestat_size.value.ui64 = ddt_cache_size;
+	dcs->ddtcachestat_max_size.value.ui64 = zfs_dedup_cache_max;
+	return (0);
+}
+
+void
+ddt_cache_init(void)
+{
+	ddt_cache_entry_cache = kmem_cache_create("ddt_cache_entry_cache",
+	    sizeof (ddt_cache_entry_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
+
+	if (zfs_dedup_cache_max == 0) {
+		zfs_dedup_cache_max = (arc_all_memory() *
+		    zfs_dedup_cache_max_percent) / 100;
+	}
+
+	wmsum_init(&ddt_cache_sums.ddtcachestat_hits, 0);
+	wmsum_init(&ddt_cache_sums.ddtcachestat_misses, 0);
+	wmsum_init(&ddt_cache_sums.ddtcachestat_inserts, 0);
+	wmsum_init(&ddt_cache_sums.ddtcachestat_removes, 0);
+	wmsum_init(&ddt_cache_sums.ddtcachestat_evictions, 0);
+
+	ddt_cache_ksp = kstat_create("zfs", 0, "ddt_cache", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (ddt_cache_stats) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+
+	if (ddt_cache_ksp != NULL) {
+		ddt_cache_ksp->ks_data = &ddt_cache_stats;
+		ddt_cache_ksp->ks_update = ddt_cache_kstats_update;
+		kstat_install(ddt_cache_ksp);
+	}
+}
+
+void
+ddt_cache_fini(void)
+{
+	if (ddt_cache_ksp != NULL) {
+		kstat_delete(ddt_cache_ksp);
+		ddt_cache_ksp = NULL;
+	}
+
+	wmsum_fini(&ddt_cache_sums.ddtcachestat_hits);
+	wmsum_fini(&ddt_cache_sums.ddtcachestat_misses);
+	wmsum_fini(&ddt_cache_sums.ddtcachestat_inserts);
+	wmsum_fini(&ddt_cache_sums.ddtcachestat_removes);
+	wmsum_fini(&ddt_cache_sums.ddtcachestat_evictions);
+
+	ASSERT0(ddt_cache_size);
+	kmem_cache_destroy(ddt_cache_entry_cache);
+}
+
+void
+ddt_cache_alloc(ddt_t *ddt)
+{
+	mutex_init(&ddt->ddt_cache_lock, NULL, MUTEX_DEFAULT, NULL);
+	avl_create(&ddt->ddt_cache_tree, ddt_key_compare,
+	    sizeof (ddt_cache_entry_t), offsetof(ddt_cache_entry_t, ddce_node));
+	list_create(&ddt->ddt_cache_lru, sizeof (ddt_cache_entry_t),
+	    offsetof(ddt_cache_entry_t, ddce_lru_node));
+}
+
+static void
+ddt_cache_entry_free(ddt_t *ddt, ddt_cache_entry_t *ddce)
+{
+	ASSERT(MUTEX_HELD(&ddt->ddt_cache_lock));
+
+	avl_remove(&ddt->ddt_cache_tree, ddce);
+	list_remove(&ddt->ddt_cache_lru, ddce);
+	atomic_sub_64(&ddt_cache_size, sizeof (ddt_cache_entry_t));
+	kmem_cache_free(ddt_cache_entry_cache, ddce);
+}
+
+void
+ddt_cache_free(ddt_t *ddt)
+{
+	ddt_cache_entry_t *ddce;
+
+	mutex_enter(&ddt->ddt_cache_lock);
+	while ((ddce = list_head(&ddt->ddt_cache_lru)) != NULL)
+		ddt_cache_entry_free(ddt, ddce);
+	mutex_exit(&ddt->ddt_cache_lock);
+
+	list_destroy(&ddt->ddt_cache_lru);
+	avl_destroy(&ddt->ddt_cache_tree);
+	mutex_destroy(&ddt->ddt_cache_lock);
+}
+
+/*
+ * If the entry is in the cache, fill in its phys and storage location and
+ * return B_TRUE. If dde is NULL, just report whether it's there.
+ */
+boolean_t
+ddt_cache_lookup(ddt_t *ddt, const ddt_key_t *ddk, ddt_entry_t *dde)
+{
+	ddt_cache_entry_t *ddce;
+
+	mutex_enter(&ddt->ddt_cache_lock);
+	ddce = avl_find(&ddt->ddt_cache_tree, ddk, NULL);
+	if (dde == NULL) {
+		mutex_exit(&ddt->ddt_cache_lock);
+		return (ddce != NULL);
+	}
+	if (ddce == NULL) {
+		mutex_exit(&ddt->ddt_cache_lock);
+		DDTCACHESTAT_BUMP(ddtcachestat_misses);
+		return (B_FALSE);
+	}
+
+	memcpy(dde->dde_phys, ddce->ddce_phys, sizeof (dde->dde_phys));
+	dde->dde_type = dde->dde_stored_type = ddce->ddce_type;
+	dde->dde_class = dde->dde_stored_class = ddce->ddce_class;
+
+	/* Most recently used goes to the tail. */
+	list_remove(&ddt->ddt_cache_lru, ddce);
+	list_insert_tail(&ddt->ddt_cache_lru, ddce);
+	mutex_exit(&ddt->ddt_cache_lock);
+
+	DDTCACHESTAT_BUMP(ddtcachestat_hits);
+	return (B_TRUE);
+}
+
+/*
+ * Add an entry just loaded from its storage object to the cache, evicting the
+ * least recently used entries if over the memory limit.
+ */
+void
+ddt_cache_insert(ddt_t *ddt, const ddt_entry_t *dde)
+{
+	ddt_cache_entry_t *ddce;
+	avl_index_t where;
+
+	ASSERT3U(dde->dde_stored_type, <, DDT_TYPES);
+	ASSERT3U(dde->dde_stored_class, <, DDT_CLASSES);
+
+	if (zfs_dedup_cache_max < sizeof (ddt_cache_entry_t))
+		return;
+
+	mutex_enter(&ddt->ddt_cache_lock);
+
+	ddce = avl_find(&ddt->ddt_cache_tree, &dde->dde_key, &where);
+	if (ddce == NULL) {
+		while (ddt_cache_size + sizeof (ddt_cache_entry_t) >
+		    zfs_dedup_cache_max) {
+			ddt_cache_entry_t *lru = list_head(&ddt->ddt_cache_lru);
+			if (lru == NULL)
+				break;
+			ddt_cache_entry_free(ddt, lru);
+			DDTCACHESTAT_BUMP(ddtcachestat_evictions);
+		}
+		if (ddt_cache_size + sizeof (ddt_cache_entry_t) >
+		    zfs_dedup_cache_max) {
+			/* Other DDTs are holding the memory. */
+			mutex_exit(&ddt->ddt_cache_lock);
+			return;
+		}
+
+		ddce = kmem_cache_alloc(ddt_cache_entry_cache, KM_SLEEP);
+		ddce->ddce_key = dde->dde_key;
+		avl_insert(&ddt->ddt_cache_tree, ddce, where);
+		list_insert_tail(&ddt->ddt_cache_lru, ddce);
+		atomic_add_64(&ddt_cache_size, sizeof (ddt_cache_entry_t));
+	} else {
+		list_remove(&ddt->ddt_cache_lru, ddce);
+		list_insert_tail(&ddt->ddt_cache_lru, ddce);
+	}
+
+	memcpy(ddce->ddce_phys, dde->dde_phys, sizeof (ddce->ddce_phys));
+	ddce->ddce_type = dde->dde_stored_type;
+	ddce->ddce_class = dde->dde_stored_class;
+
+	mutex_exit(&ddt->ddt_cache_lock);
+
+	DDTCACHESTAT_BUMP(ddtcachestat_inserts);
+}
+
+/*
+ * Drop an entry from the cache, because its storage object copy is about to
+ * change.
+ */
+void
+ddt_cache_remove(ddt_t *ddt, const ddt_key_t *ddk)
+{
+	ddt_cache_entry_t *ddce;
+
+	mutex_enter(&ddt->ddt_cache_lock);
+	ddce = avl_find(&ddt->ddt_cache_tree, ddk, NULL);
+	if (ddce != NULL) {
+		ddt_cache_entry_free(ddt, ddce);
+		DDTCACHESTAT_BUMP(ddtcachestat_removes);
+	}
+	mutex_exit(&ddt->ddt_cache_lock);
+}
+
+/* BEGIN CSTYLED */
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, cache_max, U64, ZMOD_RW,
+	"Max memory for cached DDT entries, across all DDTs");
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, cache_max_percent, UINT, ZMOD_RD,
+	"Max memory for cached DDT entries, as a percentage of total memory");
+/* END CSTYLED */
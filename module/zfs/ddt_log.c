@@ -0,0 +1,635 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copyright (c) 2023, Klara Inc.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/ddt.h>
+#include <sys/dmu_tx.h>
+#include <sys/dmu.h>
+#include <sys/ddt_impl.h>
+#include <sys/dnode.h>
+#include <sys/dbuf.h>
+#include <sys/zap.h>
+#include <sys/zio_checksum.h>
+#include <sys/zfeature.h>
+#include <sys/arc.h>
+
+/*
+ * # DDT log
+ *
+ * Without the log, every entry changed in a txg is written straight to its
+ * storage object (usually a ZAP) at the end of the txg. The storage objects
+ * are keyed by checksum, so the updates land on effectively random leaf
+ * blocks, and each one needs the leaf read in first. Once the DDT no longer
+ * fits in ARC, that dominates dedup write performance.
+ *
+ * The log sits in front of the storage objects. At the end of each txg, the
+ * changed entries are appended to the "active" log object, which is a simple
+ * array of ddt_log_record_t, written sequentially. A copy of every logged
+ * entry is also kept in memory (ddl_tree), and ddt_lookup() consults these
+ * before going to the storage objects.
+ *
+ * Every so often the logs are swapped: the active log becomes the "flushing"
+ * log, and a new empty active log is started. Entries on the flushing log are
+ * then moved to the storage objects a few at a time each txg (see
+ * ddt_sync_flush_log()), in key order. When the flushing log is empty it is
+ * truncated, and is ready to be swapped in again.
+ *
+ * Because entries are flushed in key order, recording the key of the last one
+ * flushed in the log header (the "checkpoint") is enough to know, after an
+ * import, which entries on the flushing log have already been flushed.
+ *
+ * Each logged entry carries the storage object it currently lives in, so the
+ * flush knows where to remove it from. If an entry is flushed while a newer
+ * copy of it is on the active log, the newer copy is relogged with the new
+ * location in the same txg, so the last record for an entry is always right.
+ */
+
+static kmem_cache_t *ddt_log_entry_cache;
+
+/*
+ * Minimum number of entries to flush from the log to the storage objects
+ * each txg.
+ */
+uint64_t zfs_dedup_log_flush_entries_min = 1000;
+
+/*
+ * Number of txgs to spread the flush of a log over. When the logs are
+ * swapped, the flush rate is set so that the whole flushing log will be
+ * written out in about this many txgs.
+ */
+uint_t zfs_dedup_log_flush_txgs = 100;
+
+/*
+ * Maximum number of txgs the active log will accumulate entries for before
+ * being swapped for flushing (once the previous flush has finished).
+ */
+uint_t zfs_dedup_log_txg_max = 8;
+
+/*
+ * Maximum amount of memory to hold for in-core copies of logged entries.
+ * Once exceeded, the flushing log is written out in full, and the logs are
+ * swapped as soon as possible. If zero at module load, it is set to
+ * zfs_dedup_log_mem_max_percent of total memory.
+ */
+uint64_t zfs_dedup_log_mem_max = 0;
+static uint_t zfs_dedup_log_mem_max_percent = 1;
+
+#define	DDT_LOG_BLOCKSIZE	SPA_OLD_MAXBLOCKSIZE
+#define	DDT_LOG_WRITE_RECS	\
+	(DDT_LOG_BLOCKSIZE / sizeof (ddt_log_record_t))
+
+void
+ddt_log_init(void)
+{
+	ddt_log_entry_cache = kmem_cache_create("ddt_log_entry_cache",
+	    sizeof (ddt_log_entry_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
+
+	if (zfs_dedup_log_mem_max == 0) {
+		zfs_dedup_log_mem_max = (arc_all_memory() *
+		    zfs_dedup_log_mem_max_percent) / 100;
+	}
+}
+
+void
+ddt_log_fini(void)
+{
+	kmem_cache_destroy(ddt_log_entry_cache);
+}
+
+static void
+ddt_log_name(ddt_t *ddt, uint_t n, char *name)
+{
+	(void) snprintf(name, DDT_NAMELEN, DMU_POOL_DDT_LOG,
+	    zio_checksum_table[ddt->ddt_checksum].ci_name, n);
+}
+
+static void
+ddt_log_tree_clear(ddt_log_t *ddl)
+{
+	ddt_log_entry_t *ddle;
+	void *cookie = NULL;
+
+	while ((ddle = avl_destroy_nodes(&ddl->ddl_tree, &cookie)) != NULL)
+		kmem_cache_free(ddt_log_entry_cache, ddle);
+}
+
+void
+ddt_log_alloc(ddt_t *ddt)
+{
+	for (int n = 0; n < 2; n++) {
+		ddt_log_t *ddl = &ddt->ddt_log[n];
+		memset(ddl, 0, sizeof (ddt_log_t));
+		avl_create(&ddl->ddl_tree, ddt_key_compare,
+		    sizeof (ddt_log_entry_t),
+		    offsetof(ddt_log_entry_t, ddle_node));
+	}
+
+	ddt->ddt_log_active = &ddt->ddt_log[0];
+	ddt->ddt_log_flushing = &ddt->ddt_log[1];
+	ddt->ddt_log_flushing->ddl_flags = DDL_FLAG_FLUSHING;
+	ddt->ddt_flush_rate = zfs_dedup_log_flush_entries_min;
+}
+
+void
+ddt_log_free(ddt_t *ddt)
+{
+	for (int n = 0; n < 2; n++) {
+		ddt_log_t *ddl = &ddt->ddt_log[n];
+		ddt_log_tree_clear(ddl);
+		avl_destroy(&ddl->ddl_tree);
+	}
+}
+
+boolean_t
+ddt_log_exists(const ddt_t *ddt)
+{
+	return (ddt->ddt_log_active->ddl_object != 0);
+}
+
+boolean_t
+ddt_log_empty(const ddt_t *ddt)
+{
+	return (avl_is_empty(&ddt->ddt_log_active->ddl_tree) &&
+	    avl_is_empty(&ddt->ddt_log_flushing->ddl_tree));
+}
+
+uint64_t
+ddt_log_count(const ddt_t *ddt)
+{
+	return (avl_numnodes(&ddt->ddt_log_active->ddl_tree) +
+	    avl_numnodes(&ddt->ddt_log_flushing->ddl_tree));
+}
+
+uint64_t
+ddt_log_memused(const ddt_t *ddt)
+{
+	return (ddt_log_count(ddt) * sizeof (ddt_log_entry_t));
+}
+
+static void
+ddt_log_update_header(ddt_t *ddt, ddt_log_t *ddl, dmu_tx_t *tx)
+{
+	dmu_buf_t *db;
+	ddt_log_header_t *hdr;
+
+	VERIFY0(dmu_bonus_hold(ddt->ddt_os, ddl->ddl_object, FTAG, &db));
+	dmu_buf_will_dirty(db, tx);
+
+	hdr = db->db_data;
+	memset(hdr, 0, sizeof (ddt_log_header_t));
+	DLH_SET_VERSION(hdr, DDT_LOG_VERSION);
+	DLH_SET_FLAGS(hdr, ddl->ddl_flags);
+	hdr->dlh_length = ddl->ddl_length;
+	hdr->dlh_first_txg = ddl->ddl_first_txg;
+	hdr->dlh_checkpoint = ddl->ddl_checkpoint;
+
+	dmu_buf_rele(db, FTAG);
+}
+
+void
+ddt_log_create(ddt_t *ddt, dmu_tx_t *tx)
+{
+	objset_t *os = ddt->ddt_os;
+	char name[DDT_NAMELEN];
+
+	ASSERT(!ddt_log_exists(ddt));
+	ASSERT(ddt_log_empty(ddt));
+
+	for (int n = 0; n < 2; n++) {
+		ddt_log_t *ddl = &ddt->ddt_log[n];
+
+		ddt_log_name(ddt, n, name);
+		ddl->ddl_object = dmu_object_alloc(os,
+		    DMU_OTN_UINT64_METADATA, DDT_LOG_BLOCKSIZE,
+		    DMU_OTN_UINT64_METADATA, sizeof (ddt_log_header_t), tx);
+		VERIFY0(zap_add(os, DMU_POOL_DIRECTORY_OBJECT, name,
+		    sizeof (uint64_t), 1, &ddl->ddl_object, tx));
+		ddt_log_update_header(ddt, ddl, tx);
+	}
+
+	spa_feature_incr(ddt->ddt_spa, SPA_FEATURE_FAST_DEDUP, tx);
+}
+
+void
+ddt_log_destroy(ddt_t *ddt, dmu_tx_t *tx)
+{
+	objset_t *os = ddt->ddt_os;
+	char name[DDT_NAMELEN];
+
+	ASSERT(ddt_log_exists(ddt));
+	ASSERT(ddt_log_empty(ddt));
+
+	for (int n = 0; n < 2; n++) {
+		ddt_log_t *ddl = &ddt->ddt_log[n];
+
+		ddt_log_name(ddt, n, name);
+		VERIFY0(zap_remove(os, DMU_POOL_DIRECTORY_OBJECT, name, tx));
+		VERIFY0(dmu_object_free(os, ddl->ddl_object, tx));
+		ddl->ddl_object = 0;
+		ddl->ddl_length = 0;
+		ddl->ddl_first_txg = 0;
+	}
+
+	spa_feature_decr(ddt->ddt_spa, SPA_FEATURE_FAST_DEDUP, tx);
+}
+
+/*
+ * Add or replace the in-core copy of an entry on the given log.
+ */
+static void
+ddt_log_tree_update(ddt_log_t *ddl, const ddt_key_t *ddk,
+    const ddt_phys_t *phys, ddt_type_t type, ddt_class_t class)
+{
+	ddt_log_entry_t *ddle;
+	avl_index_t where;
+
+	ddle = avl_find(&ddl->ddl_tree, ddk, &where);
+	if (ddle == NULL) {
+		ddle = kmem_cache_alloc(ddt_log_entry_cache, KM_SLEEP);
+		ddle->ddle_key = *ddk;
+		avl_insert(&ddl->ddl_tree, ddle, where);
+	}
+
+	memcpy(ddle->ddle_phys, phys, sizeof (ddle->ddle_phys));
+	ddle->ddle_type = type;
+	ddle->ddle_class = class;
+}
+
+static int
+ddt_log_load_one(ddt_t *ddt, uint_t n)
+{
+	ddt_log_t *ddl = &ddt->ddt_log[n];
+	objset_t *os = ddt->ddt_os;
+	ddt_log_header_t hdr;
+	char name[DDT_NAMELEN];
+	dmu_buf_t *db;
+	int error;
+
+	ddt_log_name(ddt, n, name);
+
+	error = zap_lookup(os, DMU_POOL_DIRECTORY_OBJECT, name,
+	    sizeof (uint64_t), 1, &ddl->ddl_object);
+	if (error != 0)
+		return (error);
+
+	error = dmu_bonus_hold(os, ddl->ddl_object, FTAG, &db);
+	if (error != 0)
+		return (error);
+	memcpy(&hdr, db->db_data, sizeof (ddt_log_header_t));
+	dmu_buf_rele(db, FTAG);
+
+	if (DLH_GET_VERSION(&hdr) != DDT_LOG_VERSION)
+		return (SET_ERROR(EOPNOTSUPP));
+	if (hdr.dlh_length % sizeof (ddt_log_record_t) != 0)
+		return (SET_ERROR(ECKSUM));
+
+	ddl->ddl_flags = DLH_GET_FLAGS(&hdr);
+	ddl->ddl_length = hdr.dlh_length;
+	ddl->ddl_first_txg = hdr.dlh_first_txg;
+	ddl->ddl_checkpoint = hdr.dlh_checkpoint;
+
+	const uint64_t bufsize = DDT_LOG_WRITE_RECS * sizeof (ddt_log_record_t);
+	ddt_log_record_t *buf = vmem_alloc(bufsize, KM_SLEEP);
+
+	for (uint64_t offset = 0; offset < ddl->ddl_length;
+	    offset += bufsize) {
+		uint64_t len = MIN(bufsize, ddl->ddl_length - offset);
+
+		error = dmu_read(os, ddl->ddl_object, offset, len, buf,
+		    DMU_READ_PREFETCH);
+		if (error != 0)
+			break;
+
+		for (int i = 0; i < len / sizeof (ddt_log_record_t); i++) {
+			ddt_log_record_t *dlr = &buf[i];
+			ddt_type_t type = DLR_GET_TYPE(dlr);
+			ddt_class_t class = DLR_GET_CLASS(dlr);
+
+			if (type > DDT_TYPES || class > DDT_CLASSES) {
+				error = SET_ERROR(ECKSUM);
+				break;
+			}
+
+			/* Later records for the same key replace earlier. */
+			ddt_log_tree_update(ddl, &dlr->dlr_key, dlr->dlr_phys,
+			    type, class);
+		}
+		if (error != 0)
+			break;
+	}
+
+	vmem_free(buf, bufsize);
+
+	return (error);
+}
+
+int
+ddt_log_load(ddt_t *ddt)
+{
+	int error;
+
+	error = ddt_log_load_one(ddt, 0);
+	if (error == ENOENT) {
+		/* No log for this DDT yet, nothing to do. */
+		ddt->ddt_log[0].ddl_object = 0;
+		return (0);
+	}
+	if (error == 0)
+		error = ddt_log_load_one(ddt, 1);
+	if (error != 0)
+		goto fail;
+
+	/* Exactly one of the logs must be the flushing log. */
+	boolean_t flushing0 =
+	    !!(ddt->ddt_log[0].ddl_flags & DDL_FLAG_FLUSHING);
+	boolean_t flushing1 =
+	    !!(ddt->ddt_log[1].ddl_flags & DDL_FLAG_FLUSHING);
+	if (flushing0 == flushing1) {
+		error = SET_ERROR(ECKSUM);
+		goto fail;
+	}
+
+	ddt->ddt_log_active = &ddt->ddt_log[flushing0 ? 1 : 0];
+	ddt->ddt_log_flushing = &ddt->ddt_log[flushing0 ? 0 : 1];
+
+	/*
+	 * Drop anything from the flushing log that was flushed before the
+	 * pool was last exported. Any newer copy of those entries on the
+	 * active log was relogged with its new location at the same time.
+	 */
+	ddt_log_t *ddl = ddt->ddt_log_flushing;
+	if (ddl->ddl_flags & DDL_FLAG_CHECKPOINT) {
+		ddt_log_entry_t *ddle;
+		while ((ddle = avl_first(&ddl->ddl_tree)) != NULL &&
+		    ddt_key_compare(&ddle->ddle_key,
+		    &ddl->ddl_checkpoint) <= 0) {
+			avl_remove(&ddl->ddl_tree, ddle);
+			kmem_cache_free(ddt_log_entry_cache, ddle);
+		}
+	}
+
+	ddt->ddt_flush_rate = MAX(zfs_dedup_log_flush_entries_min,
+	    avl_numnodes(&ddl->ddl_tree) / MAX(zfs_dedup_log_flush_txgs, 1));
+
+	return (0);
+
+fail:
+	for (int n = 0; n < 2; n++) {
+		ddt_log_tree_clear(&ddt->ddt_log[n]);
+		ddt->ddt_log[n].ddl_object = 0;
+	}
+	return (error);
+}
+
+/*
+ * Find the most recent logged copy of an entry. If found, and dde is not
+ * NULL, the entry's phys and storage location are copied into it.
+ */
+boolean_t
+ddt_log_find_key(ddt_t *ddt, const ddt_key_t *ddk, ddt_entry_t *dde)
+{
+	ddt_log_entry_t *ddle;
+
+	ASSERT(MUTEX_HELD(&ddt->ddt_lock));
+
+	ddle = avl_find(&ddt->ddt_log_active->ddl_tree, ddk, NULL);
+	if (ddle == NULL)
+		ddle = avl_find(&ddt->ddt_log_flushing->ddl_tree, ddk, NULL);
+	if (ddle == NULL)
+		return (B_FALSE);
+
+	if (dde != NULL) {
+		memcpy(dde->dde_phys, ddle->ddle_phys, sizeof (dde->dde_phys));
+		dde->dde_stored_type = ddle->ddle_type;
+		dde->dde_stored_class = ddle->ddle_class;
+	}
+
+	return (B_TRUE);
+}
+
+void
+ddt_log_begin(ddt_t *ddt, ddt_log_update_t *dlu, dmu_tx_t *tx)
+{
+	ASSERT(ddt_log_exists(ddt));
+
+	dlu->dlu_tx = tx;
+	dlu->dlu_buf = vmem_alloc(DDT_LOG_WRITE_RECS *
+	    sizeof (ddt_log_record_t), KM_SLEEP);
+	dlu->dlu_nrecs = 0;
+	dlu->dlu_written = B_FALSE;
+}
+
+static void
+ddt_log_write(ddt_t *ddt, ddt_log_update_t *dlu)
+{
+	ddt_log_t *ddl = ddt->ddt_log_active;
+	uint64_t len = dlu->dlu_nrecs * sizeof (ddt_log_record_t);
+
+	if (len == 0)
+		return;
+
+	dmu_write(ddt->ddt_os, ddl->ddl_object, ddl->ddl_length, len,
+	    dlu->dlu_buf, dlu->dlu_tx);
+
+	ddl->ddl_length += len;
+	dlu->dlu_nrecs = 0;
+	dlu->dlu_written = B_TRUE;
+}
+
+static void
+ddt_log_append(ddt_t *ddt, ddt_log_update_t *dlu, const ddt_key_t *ddk,
+    const ddt_phys_t *phys, ddt_type_t type, ddt_class_t class)
+{
+	ddt_log_t *ddl = ddt->ddt_log_active;
+	ddt_log_record_t *dlr = &dlu->dlu_buf[dlu->dlu_nrecs];
+
+	if (ddl->ddl_first_txg == 0)
+		ddl->ddl_first_txg = dmu_tx_get_txg(dlu->dlu_tx);
+
+	dlr->dlr_key = *ddk;
+	memcpy(dlr->dlr_phys, phys, sizeof (dlr->dlr_phys));
+	dlr->dlr_info = 0;
+	DLR_SET_TYPE(dlr, type);
+	DLR_SET_CLASS(dlr, class);
+
+	if (++dlu->dlu_nrecs == DDT_LOG_WRITE_RECS)
+		ddt_log_write(ddt, dlu);
+}
+
+/*
+ * Append an entry to the active log. type and class are the storage object
+ * the entry currently lives in, or DDT_TYPES/DDT_CLASSES if it has never
+ * been flushed.
+ */
+void
+ddt_log_entry(ddt_t *ddt, ddt_log_update_t *dlu, const ddt_key_t *ddk,
+    const ddt_phys_t *phys, ddt_type_t type, ddt_class_t class)
+{
+	ddt_log_append(ddt, dlu, ddk, phys, type, class);
+
+	ddt_enter(ddt);
+	ddt_log_tree_update(ddt->ddt_log_active, ddk, phys, type, class);
+	ddt_exit(ddt);
+}
+
+void
+ddt_log_commit(ddt_t *ddt, ddt_log_update_t *dlu)
+{
+	ddt_log_write(ddt, dlu);
+
+	if (dlu->dlu_written)
+		ddt_log_update_header(ddt, ddt->ddt_log_active, dlu->dlu_tx);
+
+	vmem_free(dlu->dlu_buf,
+	    DDT_LOG_WRITE_RECS * sizeof (ddt_log_record_t));
+	dlu->dlu_buf = NULL;
+}
+
+/*
+ * Return the next entry to be flushed, or NULL if the flushing log is empty.
+ * Only the sync thread removes entries from the flushing log, so the entry
+ * will remain valid until passed to ddt_log_flush_done().
+ */
+ddt_log_entry_t *
+ddt_log_flush_next(ddt_t *ddt)
+{
+	ddt_log_entry_t *ddle;
+
+	ddt_enter(ddt);
+	ddle = avl_first(&ddt->ddt_log_flushing->ddl_tree);
+	ddt_exit(ddt);
+
+	return (ddle);
+}
+
+/*
+ * The entry has been written to (or removed from) the storage objects, and
+ * now lives in the type/class given. Remove it from the flushing log. If
+ * there is a newer copy on the active log, it gets the new location, and is
+ * relogged so that location survives an export.
+ */
+void
+ddt_log_flush_done(ddt_t *ddt, ddt_log_update_t *dlu, ddt_log_entry_t *ddle,
+    ddt_type_t type, ddt_class_t class)
+{
+	ddt_log_entry_t *nddle;
+
+	ddt_enter(ddt);
+	nddle = avl_find(&ddt->ddt_log_active->ddl_tree, &ddle->ddle_key,
+	    NULL);
+	if (nddle != NULL) {
+		nddle->ddle_type = type;
+		nddle->ddle_class = class;
+	}
+	avl_remove(&ddt->ddt_log_flushing->ddl_tree, ddle);
+	ddt_exit(ddt);
+
+	if (nddle != NULL) {
+		ddt_log_append(ddt, dlu, &nddle->ddle_key, nddle->ddle_phys,
+		    type, class);
+	}
+
+	kmem_cache_free(ddt_log_entry_cache, ddle);
+}
+
+/*
+ * Record the last entry flushed, so it and everything before it can be
+ * skipped if the flushing log has to be reloaded.
+ */
+void
+ddt_log_checkpoint(ddt_t *ddt, const ddt_key_t *ddk, dmu_tx_t *tx)
+{
+	ddt_log_t *ddl = ddt->ddt_log_flushing;
+
+	ddl->ddl_checkpoint = *ddk;
+	ddl->ddl_flags |= DDL_FLAG_CHECKPOINT;
+	ddt_log_update_header(ddt, ddl, tx);
+}
+
+/*
+ * Throw away the contents of the (now empty) flushing log.
+ */
+void
+ddt_log_truncate(ddt_t *ddt, dmu_tx_t *tx)
+{
+	ddt_log_t *ddl = ddt->ddt_log_flushing;
+
+	ASSERT(avl_is_empty(&ddl->ddl_tree));
+
+	if (ddl->ddl_length == 0 && !(ddl->ddl_flags & DDL_FLAG_CHECKPOINT))
+		return;
+
+	if (ddl->ddl_length > 0) {
+		VERIFY0(dmu_free_range(ddt->ddt_os, ddl->ddl_object, 0,
+		    DMU_OBJECT_END, tx));
+	}
+
+	ddl->ddl_length = 0;
+	ddl->ddl_first_txg = 0;
+	ddl->ddl_flags = DDL_FLAG_FLUSHING;
+	memset(&ddl->ddl_checkpoint, 0, sizeof (ddt_key_t));
+	ddt_log_update_header(ddt, ddl, tx);
+}
+
+/*
+ * Make the active log the flushing log, and start a new active log. The
+ * flushing log must already be empty and truncated.
+ */
+void
+ddt_log_swap(ddt_t *ddt, dmu_tx_t *tx)
+{
+	ddt_log_t *fddl = ddt->ddt_log_flushing;
+	ddt_log_t *addl = ddt->ddt_log_active;
+
+	ASSERT(avl_is_empty(&fddl->ddl_tree));
+	ASSERT0(fddl->ddl_length);
+
+	ddt_enter(ddt);
+	ddt->ddt_log_flushing = addl;
+	ddt->ddt_log_active = fddl;
+	ddt_exit(ddt);
+
+	addl->ddl_flags = DDL_FLAG_FLUSHING;
+	fddl->ddl_flags = 0;
+	ddt_log_update_header(ddt, addl, tx);
+	ddt_log_update_header(ddt, fddl, tx);
+
+	ddt->ddt_flush_rate = MAX(zfs_dedup_log_flush_entries_min,
+	    avl_numnodes(&addl->ddl_tree) / MAX(zfs_dedup_log_flush_txgs, 1));
+}
+
+/* BEGIN CSTYLED */
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_flush_entries_min, U64, ZMOD_RW,
+	"Minimum number of log entries to flush each txg");
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_flush_txgs, UINT, ZMOD_RW,
+	"Number of txgs to spread a log flush over");
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_txg_max, UINT, ZMOD_RW,
+	"Max txgs to accumulate entries on the active log before flushing");
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_mem_max, U64, ZMOD_RW,
+	"Max memory for in-core copies of logged entries");
+ZFS_MODULE_PARAM(zfs_dedup, zfs_dedup_, log_mem_max_percent, UINT, ZMOD_RD,
+	"Max memory for logged entries, as a percentage of total memory");
+/* END CSTYLED */
@@ -199,6 +199,36 @@ ddt_get_dedup_dspace(spa_t *spa)
 	return (spa->spa_dedup_dspace);
 }
 
+/*
+ * Total on-disk size of all DDT storage objects and dedup logs, as of the
+ * last sync. This is what the dedup_table_quota property is checked against.
+ */
+uint64_t
+ddt_get_ddt_dsize(spa_t *spa)
+{
+	uint64_t dsize = 0;
+
+	for (enum zio_checksum c = 0; c < ZIO_CHECKSUM_FUNCTIONS; c++) {
+		ddt_t *ddt = spa->spa_ddt[c];
+		if (!ddt)
+			continue;
+
+		for (ddt_type_t type = 0; type < DDT_TYPES; type++) {
+			for (ddt_class_t class = 0; class < DDT_CLASSES;
+			    class++) {
+				ddt_object_t *ddo =
+				    &ddt->ddt_object_stats[type][class];
+				dsize += ddo->ddo_dspace;
+			}
+		}
+
+		dsize += ddt->ddt_log[0].ddl_length;
+		dsize += ddt->ddt_log[1].ddl_length;
+	}
+
+	return (dsize);
+}
+
 uint64_t
 ddt_get_pool_dedup_ratio(spa_t *spa)
 {
@@ -210,3 +240,234 @@ ddt_get_pool_dedup_ratio(spa_t *spa)
 
 	return (dds_total.dds_ref_dsize * 100 / dds_total.dds_dsize);
 }
+
+/*
+ * Sampling the dedup and block clone tables.
+ *
+ * Walking every entry of a large table to build a histogram can take days,
+ * so instead runs of consecutive entries are read from random positions in
+ * the table's hash space, and what was seen is scaled up by the number of
+ * entries in the table.  The tables are ZAPs keyed by checksum or by the
+ * hash of a block offset, so the entries in a run are as good as randomly
+ * chosen.  A table with no more entries than its share of the samples is
+ * read in full, and its figures are exact.  DDT_SAMPLE_RUN entries, about
+ * a leaf block's worth, are read from each position.
+ */
+
+/*
+ * Return a random cursor for ddt_object_walk() or
+ * zap_cursor_init_serialized().  The tables are all ZAP_FLAG_HASH64 ZAPs,
+ * whose serialized cursors start with a 48-bit hash prefix.
+ */
+uint64_t
+ddt_sample_cursor(void)
+{
+	uint64_t r;
+
+	(void) random_get_pseudo_bytes((uint8_t *)&r, sizeof (r));
+
+	return (r & ((1ULL << 48) - 1));
+}
+
+/*
+ * Scale 'val', seen in 'sampled' of 'count' entries, up to the whole table.
+ */
+uint64_t
+ddt_sample_scale(uint64_t val, uint64_t count, uint64_t sampled)
+{
+	if (sampled == 0 || sampled >= count)
+		return (val);
+
+	return (val / sampled * count + val % sampled * count / sampled);
+}
+
+static uint64_t
+ddt_sample_isqrt(uint64_t n)
+{
+	uint64_t x = n, y = (n + 1) / 2;
+
+	while (y < x) {
+		x = y;
+		y = (x + n / x) / 2;
+	}
+
+	return (x);
+}
+
+/*
+ * Return the bound, at about 95% confidence, on the error of the estimated
+ * number of entries in a table of 'count' falling into a histogram bucket,
+ * when 'hits' of the 'sampled' entries did.  That is twice the standard
+ * deviation of the binomial estimate, or, if the bucket was always or never
+ * hit, the "rule of three" bound.
+ */
+uint64_t
+ddt_sample_error(uint64_t count, uint64_t sampled, uint64_t hits)
+{
+	if (sampled == 0 || sampled >= count)
+		return (0);
+
+	if (hits == 0 || hits == sampled)
+		return (ddt_sample_scale(3, count, sampled));
+
+	uint64_t s = ddt_sample_isqrt(hits * (sampled - hits) * sampled);
+	uint64_t t = count / sampled * s + count % sampled * s / sampled;
+
+	return (2 * t / sampled);
+}
+
+static void
+ddt_stat_add_scaled(ddt_stat_t *dst, const ddt_stat_t *src, uint64_t count,
+    uint64_t sampled)
+{
+	const uint64_t *s = (const uint64_t *)src;
+	uint64_t *d = (uint64_t *)dst;
+	uint64_t *d_end = (uint64_t *)(dst + 1);
+
+	for (int i = 0; i < d_end - d; i++)
+		d[i] += ddt_sample_scale(s[i], count, sampled);
+}
+
+/*
+ * Sample about 'want' entries of one dedup table, adding the estimated
+ * histogram to 'ddh' and the error bounds to 'error'.  Returns the number
+ * of entries read in 'seenp'.
+ */
+static int
+ddt_sample_object(ddt_t *ddt, ddt_type_t type, ddt_class_t class,
+    uint64_t want, ddt_histogram_t *ddh, uint64_t *error, uint64_t *seenp)
+{
+	ddt_entry_t *dde = kmem_zalloc(sizeof (ddt_entry_t), KM_SLEEP);
+	ddt_histogram_t *sddh = kmem_zalloc(sizeof (ddt_histogram_t),
+	    KM_SLEEP);
+	uint64_t hits[64] = { 0 };
+	uint64_t count, nread = 0, nseen = 0, walk = 0;
+	boolean_t full;
+	int err = 0;
+
+	*seenp = 0;
+
+	if (ddt->ddt_object[type][class] == 0 ||
+	    ddt_object_count(ddt, type, class, &count) != 0 || count == 0)
+		goto out;
+
+	full = (count <= want);
+	if (full)
+		want = count;
+
+	while (nread < want) {
+		ddt_stat_t dds;
+		int bucket;
+
+		if (!full && nread % DDT_SAMPLE_RUN == 0)
+			walk = ddt_sample_cursor();
+
+		err = ddt_object_walk(ddt, type, class, &walk, dde);
+		if (err == ENOENT && !full) {
+			/* Ran off the end of the table; start a new run. */
+			nread = P2ROUNDUP(nread + 1, DDT_SAMPLE_RUN);
+			continue;
+		}
+		if (err != 0)
+			break;
+		nread++;
+		nseen++;
+
+		ddt_stat_generate(ddt, dde, &dds);
+		bucket = highbit64(dds.dds_ref_blocks) - 1;
+		if (bucket < 0)
+			continue;
+		ddt_stat_add(&sddh->ddh_stat[bucket], &dds, 0);
+		hits[bucket]++;
+	}
+	if (err == ENOENT)
+		err = 0;
+	if (err != 0 || nseen == 0)
+		goto out;
+
+	/* A full walk is exact, even if the table changed since counted. */
+	if (full)
+		count = nseen;
+
+	for (int h = 0; h < 64; h++) {
+		ddt_stat_add_scaled(&ddh->ddh_stat[h], &sddh->ddh_stat[h],
+		    count, nseen);
+		error[h] += ddt_sample_error(count, nseen, hits[h]);
+	}
+	*seenp = nseen;
+out:
+	kmem_free(sddh, sizeof (ddt_histogram_t));
+	kmem_free(dde, sizeof (ddt_entry_t));
+
+	return (err);
+}
+
+/*
+ * Sample about 'samples' entries of the dedup tables, shared out between
+ * the tables by size, and add the estimated histogram to 'nvl' as a
+ * ddt_histogram_t, along with the error bounds on the number of entries in
+ * each bucket.  Entries still in the dedup log are not counted.
+ */
+int
+ddt_get_sample_stats(spa_t *spa, uint64_t samples, nvlist_t *nvl)
+{
+	ddt_histogram_t *ddh = kmem_zalloc(sizeof (ddt_histogram_t), KM_SLEEP);
+	uint64_t error[64] = { 0 };
+	uint64_t total = 0, sampled = 0;
+	int err = 0;
+
+	samples = MIN(samples, DDT_SAMPLE_MAX);
+
+	for (enum zio_checksum c = 0; c < ZIO_CHECKSUM_FUNCTIONS; c++) {
+		ddt_t *ddt = spa->spa_ddt[c];
+		if (ddt == NULL)
+			continue;
+
+		for (ddt_type_t type = 0; type < DDT_TYPES; type++) {
+			for (ddt_class_t class = 0; class < DDT_CLASSES;
+			    class++) {
+				uint64_t count;
+
+				if (ddt->ddt_object[type][class] != 0 &&
+				    ddt_object_count(ddt, type, class,
+				    &count) == 0)
+					total += count;
+			}
+		}
+	}
+
+	for (enum zio_checksum c = 0; c < ZIO_CHECKSUM_FUNCTIONS; c++) {
+		ddt_t *ddt = spa->spa_ddt[c];
+		if (ddt == NULL)
+			continue;
+
+		for (ddt_type_t type = 0; type < DDT_TYPES; type++) {
+			for (ddt_class_t class = 0; class < DDT_CLASSES;
+			    class++) {
+				uint64_t count, seen;
+
+				if (ddt->ddt_object[type][class] == 0 ||
+				    ddt_object_count(ddt, type, class,
+				    &count) != 0)
+					continue;
+
+				err = ddt_sample_object(ddt, type, class,
+				    MAX(count * samples / total, 1), ddh,
+				    error, &seen);
+				if (err != 0)
+					goto out;
+				sampled += seen;
+			}
+		}
+	}
+
+	fnvlist_add_uint64(nvl, DEDUP_SAMPLE_ENTRIES, total);
+	fnvlist_add_uint64(nvl, DEDUP_SAMPLE_SAMPLED, sampled);
+	fnvlist_add_uint64_array(nvl, DEDUP_SAMPLE_HISTOGRAM,
+	    (uint64_t *)ddh, sizeof (*ddh) / sizeof (uint64_t));
+	fnvlist_add_uint64_array(nvl, DEDUP_SAMPLE_ERROR, error, 64);
+out:
+	kmem_free(ddh, sizeof (ddt_histogram_t));
+
+	return (err);
+}
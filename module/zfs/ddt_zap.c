@@ -237,6 +237,90 @@ const ddt_ops_t ddt_zap_ops = {
 	ddt_zap_count,
 };
 
+/*
+ * The flat type stores entries in a ZAP object just like the zap type, but
+ * only keeps the single-copy phys, as a fixed-width array of uint64s. It is
+ * only used for entries that have no other phys (see ddt_entry_type()), which
+ * is almost all of them, and saves the compression header and the work of
+ * compressing and decompressing the value on every access.
+ */
+#define	DDT_FLAT_PHYS_WORDS	(sizeof (ddt_phys_t) / sizeof (uint64_t))
+
+static int
+ddt_flat_lookup(objset_t *os, uint64_t object,
+    const ddt_key_t *ddk, ddt_phys_t *phys, size_t psize)
+{
+	ASSERT3U(psize, ==, sizeof (ddt_phys_t) * DDT_PHYS_TYPES);
+
+	memset(phys, 0, psize);
+
+	return (zap_lookup_uint64(os, object, (uint64_t *)ddk,
+	    DDT_KEY_WORDS, sizeof (uint64_t), DDT_FLAT_PHYS_WORDS,
+	    &phys[DDT_PHYS_SINGLE]));
+}
+
+static int
+ddt_flat_update(objset_t *os, uint64_t object, const ddt_key_t *ddk,
+    const ddt_phys_t *phys, size_t psize, dmu_tx_t *tx)
+{
+	ASSERT3U(psize, ==, sizeof (ddt_phys_t) * DDT_PHYS_TYPES);
+	for (int p = 0; p < DDT_PHYS_TYPES; p++) {
+		if (p != DDT_PHYS_SINGLE)
+			ASSERT0(phys[p].ddp_phys_birth);
+	}
+
+	return (zap_update_uint64(os, object, (uint64_t *)ddk,
+	    DDT_KEY_WORDS, sizeof (uint64_t), DDT_FLAT_PHYS_WORDS,
+	    &phys[DDT_PHYS_SINGLE], tx));
+}
+
+static int
+ddt_flat_walk(objset_t *os, uint64_t object, uint64_t *walk, ddt_key_t *ddk,
+    ddt_phys_t *phys, size_t psize)
+{
+	zap_cursor_t zc;
+	zap_attribute_t za;
+	int error;
+
+	ASSERT3U(psize, ==, sizeof (ddt_phys_t) * DDT_PHYS_TYPES);
+
+	/* See ddt_zap_walk() for why we don't prefetch. */
+	if (*walk == 0)
+		zap_cursor_init_noprefetch(&zc, os, object);
+	else
+		zap_cursor_init_serialized(&zc, os, object, *walk);
+	if ((error = zap_cursor_retrieve(&zc, &za)) == 0) {
+		ASSERT3U(za.za_integer_length, ==, sizeof (uint64_t));
+		ASSERT3U(za.za_num_integers, ==, DDT_FLAT_PHYS_WORDS);
+
+		memset(phys, 0, psize);
+		error = zap_lookup_uint64(os, object, (uint64_t *)za.za_name,
+		    DDT_KEY_WORDS, sizeof (uint64_t), DDT_FLAT_PHYS_WORDS,
+		    &phys[DDT_PHYS_SINGLE]);
+		ASSERT0(error);
+		if (error == 0)
+			*ddk = *(ddt_key_t *)za.za_name;
+
+		zap_cursor_advance(&zc);
+		*walk = zap_cursor_serialize(&zc);
+	}
+	zap_cursor_fini(&zc);
+	return (error);
+}
+
+const ddt_ops_t ddt_flat_ops = {
+	"flat",
+	ddt_zap_create,
+	ddt_zap_destroy,
+	ddt_flat_lookup,
+	ddt_zap_contains,
+	ddt_zap_prefetch,
+	ddt_flat_update,
+	ddt_zap_remove,
+	ddt_flat_walk,
+	ddt_zap_count,
+};
+
 /* BEGIN CSTYLED */
 ZFS_MODULE_PARAM(zfs_dedup, , ddt_zap_default_bs, UINT, ZMOD_RW,
 	"DDT ZAP leaf blockshift");
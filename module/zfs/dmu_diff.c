@@ -238,3 +238,171 @@ dmu_diff(const char *tosnap_name, const char *fromsnap_name,
 
 	return (da.da_err);
 }
+
+typedef struct dmu_changedarg {
+	zfs_file_t *dca_fp;		/* file to which we are reporting */
+	offset_t *dca_offp;
+	uint64_t dca_object;		/* object whose blocks we report */
+	int dca_err;			/* error that stopped the traversal */
+	dmu_changed_range_t dca_dcr;
+} dmu_changedarg_t;
+
+/*
+ * Returned from changed_cb() once the traversal has moved past the object
+ * of interest; it never leaves dmu_changed_ranges().
+ */
+#define	CHANGED_DONE	(-2)
+
+static int
+write_changed_range(dmu_changedarg_t *dca)
+{
+	ssize_t resid;
+
+	if (dca->dca_dcr.dcr_length == 0) {
+		dca->dca_err = 0;
+		return (0);
+	}
+
+	dca->dca_err = zfs_file_write(dca->dca_fp, (caddr_t)&dca->dca_dcr,
+	    sizeof (dca->dca_dcr), &resid);
+	*dca->dca_offp += sizeof (dca->dca_dcr);
+	dca->dca_dcr.dcr_length = 0;
+	return (dca->dca_err);
+}
+
+static int
+report_changed_range(dmu_changedarg_t *dca, uint64_t offset, uint64_t length)
+{
+	dmu_changed_range_t *dcr = &dca->dca_dcr;
+
+	if (dcr->dcr_length != 0 &&
+	    offset == dcr->dcr_offset + dcr->dcr_length) {
+		dcr->dcr_length += length;
+		return (0);
+	}
+	if (write_changed_range(dca) != 0)
+		return (dca->dca_err);
+	dcr->dcr_offset = offset;
+	dcr->dcr_length = length;
+	return (0);
+}
+
+static int
+changed_cb(spa_t *spa, zilog_t *zilog, const blkptr_t *bp,
+    const zbookmark_phys_t *zb, const dnode_phys_t *dnp, void *arg)
+{
+	(void) spa, (void) zilog;
+	dmu_changedarg_t *dca = arg;
+
+	if (issig())
+		return (SET_ERROR(EINTR));
+
+	if (zb->zb_object == DMU_META_DNODE_OBJECT)
+		return (0);
+	if (zb->zb_object > dca->dca_object)
+		return (CHANGED_DONE);
+	if (zb->zb_level == ZB_DNODE_LEVEL || zb->zb_blkid == DMU_SPILL_BLKID)
+		return (0);
+
+	/*
+	 * The traversal only hands us block pointers born after the "from"
+	 * snapshot, so every hole (with hole_birth) and every level-0 block
+	 * we see here covers a changed range.  Indirect blocks are walked
+	 * through to find which of their children actually changed.
+	 */
+	if (BP_IS_HOLE(bp) || zb->zb_level == 0) {
+		uint64_t span = DBP_SPAN(dnp, zb->zb_level);
+
+		return (report_changed_range(dca, zb->zb_blkid * span, span));
+	}
+	return (0);
+}
+
+/*
+ * Report the byte ranges of one object in "tosnap" which differ from
+ * "fromsnap" as a stream of dmu_changed_range_t records.  This is the same
+ * birth-time pruned traversal that dmu_diff() does for the meta-dnode, but
+ * restricted to the blocks of a single file or zvol, which lets incremental
+ * backup tools copy just the changed extents.  Without a "from" snapshot
+ * every allocated block is reported.  Freed ranges are only reported when
+ * the hole_birth feature recorded when the hole was created.
+ */
+int
+dmu_changed_ranges(const char *tosnap_name, const char *fromsnap_name,
+    uint64_t object, zfs_file_t *fp, offset_t *offp)
+{
+	dmu_changedarg_t dca;
+	zbookmark_phys_t resume;
+	dsl_dataset_t *fromsnap;
+	dsl_dataset_t *tosnap;
+	dsl_pool_t *dp;
+	int error;
+	uint64_t fromtxg = 0;
+
+	if (object == DMU_META_DNODE_OBJECT)
+		return (SET_ERROR(EINVAL));
+
+	if (strchr(tosnap_name, '@') == NULL || (fromsnap_name != NULL &&
+	    strchr(fromsnap_name, '@') == NULL))
+		return (SET_ERROR(EINVAL));
+
+	error = dsl_pool_hold(tosnap_name, FTAG, &dp);
+	if (error != 0)
+		return (error);
+
+	error = dsl_dataset_hold(dp, tosnap_name, FTAG, &tosnap);
+	if (error != 0) {
+		dsl_pool_rele(dp, FTAG);
+		return (error);
+	}
+
+	if (fromsnap_name != NULL) {
+		error = dsl_dataset_hold(dp, fromsnap_name, FTAG, &fromsnap);
+		if (error != 0) {
+			dsl_dataset_rele(tosnap, FTAG);
+			dsl_pool_rele(dp, FTAG);
+			return (error);
+		}
+
+		if (!dsl_dataset_is_before(tosnap, fromsnap, 0)) {
+			dsl_dataset_rele(fromsnap, FTAG);
+			dsl_dataset_rele(tosnap, FTAG);
+			dsl_pool_rele(dp, FTAG);
+			return (SET_ERROR(EXDEV));
+		}
+
+		fromtxg = dsl_dataset_phys(fromsnap)->ds_creation_txg;
+		dsl_dataset_rele(fromsnap, FTAG);
+	}
+
+	dsl_dataset_long_hold(tosnap, FTAG);
+	dsl_pool_rele(dp, FTAG);
+
+	dca.dca_fp = fp;
+	dca.dca_offp = offp;
+	dca.dca_object = object;
+	dca.dca_dcr.dcr_offset = dca.dca_dcr.dcr_length = 0;
+	dca.dca_err = 0;
+
+	/*
+	 * Start the traversal at the object so that the meta-dnode subtrees
+	 * and dnodes before it are skipped.  Only block pointers are looked
+	 * at, so the keys do not need to be loaded for encrypted datasets.
+	 */
+	SET_BOOKMARK(&resume, tosnap->ds_object, object, 0, 0);
+	error = traverse_dataset_resume(tosnap, fromtxg, &resume,
+	    TRAVERSE_PRE | TRAVERSE_PREFETCH_METADATA | TRAVERSE_NO_DECRYPT,
+	    changed_cb, &dca);
+
+	if (error != 0 && error != CHANGED_DONE) {
+		dca.dca_err = error;
+	} else {
+		/* we set the dca.dca_err we return as side-effect */
+		(void) write_changed_range(&dca);
+	}
+
+	dsl_dataset_long_rele(tosnap, FTAG);
+	dsl_dataset_rele(tosnap, FTAG);
+
+	return (dca.dca_err);
+}
@@ -0,0 +1,298 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/dmu.h>
+#include <sys/dmu_impl.h>
+#include <sys/dmu_objset.h>
+#include <sys/dmu_tx.h>
+#include <sys/dbuf.h>
+#include <sys/dnode.h>
+#include <sys/zfs_context.h>
+#include <sys/zio.h>
+#include <sys/abd.h>
+
+/*
+ * Direct I/O
+ *
+ * Whole-block reads and writes of datasets with the "direct" property set
+ * (see zfsprops(7)) bypass the ARC and the dbuf data buffers.
+ *
+ * A direct write issues the zio for each block from open context, the way
+ * dmu_sync() does, and records the resulting block pointer in a NOFILL
+ * dirty record marked dr_diowrite.  Syncing context then only has to link
+ * that block pointer into the tree, as it does for block cloning.  Reads of
+ * the block before it is synced are serviced by dbuf_read() from the
+ * overridden block pointer, and a later buffered write to the block
+ * undirties the record, freeing the block written by Direct I/O.
+ *
+ * A direct read issues the zio for each block straight into a transient
+ * buffer, provided that the block is neither cached nor dirty; otherwise
+ * the dbuf is read as usual, so that cached and pending data always wins.
+ *
+ * Checksums, compression, encryption and copies are applied by the zio
+ * pipeline exactly as for buffered I/O.  The caller is expected to hold a
+ * range lock covering the blocks.
+ */
+
+static void
+dmu_write_direct_ready(zio_t *zio)
+{
+	dbuf_dirty_record_t *dr = zio->io_private;
+	dmu_buf_impl_t *db = dr->dr_dbuf;
+	blkptr_t *bp = zio->io_bp;
+
+	if (zio->io_error != 0)
+		return;
+
+	if (BP_IS_HOLE(bp)) {
+		/*
+		 * A block of zeros may compress to a hole, but the
+		 * block size still needs to be known for replay.
+		 */
+		BP_SET_LSIZE(bp, db->db.db_size);
+	} else if (!BP_IS_EMBEDDED(bp)) {
+		ASSERT0(BP_GET_LEVEL(bp));
+		BP_SET_FILL(bp, 1);
+	}
+}
+
+static void
+dmu_write_direct_done(zio_t *zio)
+{
+	dbuf_dirty_record_t *dr = zio->io_private;
+	dmu_buf_impl_t *db = dr->dr_dbuf;
+
+	mutex_enter(&db->db_mtx);
+	ASSERT3U(dr->dt.dl.dr_override_state, ==, DR_IN_DMU_SYNC);
+	if (zio->io_error == 0) {
+		dr->dt.dl.dr_override_state = DR_OVERRIDDEN;
+		dr->dt.dl.dr_copies = zio->io_prop.zp_copies;
+
+		/* See dmu_sync_done() */
+		if (BP_IS_HOLE(&dr->dt.dl.dr_overridden_by) &&
+		    BP_GET_LOGICAL_BIRTH(&dr->dt.dl.dr_overridden_by) == 0)
+			BP_ZERO(&dr->dt.dl.dr_overridden_by);
+	} else {
+		dr->dt.dl.dr_override_state = DR_NOT_OVERRIDDEN;
+	}
+	cv_broadcast(&db->db_changed);
+	mutex_exit(&db->db_mtx);
+
+	abd_free(zio->io_abd);
+}
+
+/*
+ * Write 'size' bytes of 'data' at 'offset', which must both be multiples
+ * of the object's block size, bypassing the dbuf cache.  The writes are
+ * complete when this returns.  On error the blocks are undirtied, so they
+ * keep the contents they had as of the previous txg.
+ */
+int
+dmu_write_direct_by_dnode(dnode_t *dn, uint64_t offset, uint64_t size,
+    abd_t *data, dmu_tx_t *tx)
+{
+	objset_t *os = dn->dn_objset;
+	spa_t *spa = os->os_spa;
+	uint64_t txg = dmu_tx_get_txg(tx);
+	dmu_buf_t **dbp;
+	zio_prop_t zp;
+	zio_t *rio;
+	int numbufs, err;
+
+	ASSERT3U(abd_get_size(data), >=, size);
+
+	err = dmu_buf_hold_array_by_dnode(dn, offset, size, B_FALSE, FTAG,
+	    &numbufs, &dbp, DMU_READ_NO_PREFETCH);
+	if (err != 0)
+		return (err);
+
+	/*
+	 * There is no on-disk block to compare against for nopwrite, and
+	 * dedup is not possible without the data in syncing context.
+	 */
+	dmu_write_policy(os, dn, 0, WP_DMU_SYNC, &zp);
+	zp.zp_nopwrite = B_FALSE;
+	ASSERT(!zp.zp_dedup);
+
+	rio = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+	for (int i = 0; i < numbufs; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+		dbuf_dirty_record_t *dr;
+		zbookmark_phys_t zb;
+
+		ASSERT0(db->db_level);
+		ASSERT3U(db->db.db_offset, >=, offset);
+		ASSERT3U(db->db.db_offset + db->db.db_size, <=, offset + size);
+
+		dmu_buf_will_clone_or_dio(dbp[i], tx);
+
+		mutex_enter(&db->db_mtx);
+		dr = dbuf_find_dirty_eq(db, txg);
+		VERIFY3P(dr, !=, NULL);
+		ASSERT3U(dr->dt.dl.dr_override_state, ==, DR_NOT_OVERRIDDEN);
+		dr->dt.dl.dr_diowrite = B_TRUE;
+		dr->dt.dl.dr_override_state = DR_IN_DMU_SYNC;
+		BP_ZERO(&dr->dt.dl.dr_overridden_by);
+		mutex_exit(&db->db_mtx);
+
+		SET_BOOKMARK(&zb, dmu_objset_id(os), db->db.db_object,
+		    db->db_level, db->db_blkid);
+
+		zio_nowait(zio_write(rio, spa, txg, &dr->dt.dl.dr_overridden_by,
+		    abd_get_offset_size(data, db->db.db_offset - offset,
+		    db->db.db_size), db->db.db_size, db->db.db_size, &zp,
+		    dmu_write_direct_ready, NULL, dmu_write_direct_done, dr,
+		    ZIO_PRIORITY_SYNC_WRITE, ZIO_FLAG_CANFAIL, &zb));
+	}
+	err = zio_wait(rio);
+
+	/*
+	 * Undirty every block on failure, which also frees the ones that
+	 * were written.
+	 */
+	if (err != 0) {
+		for (int i = 0; i < numbufs; i++) {
+			dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+
+			mutex_enter(&db->db_mtx);
+			VERIFY(!dbuf_undirty(db, tx));
+			if (db->db_state == DB_NOFILL &&
+			    list_is_empty(&db->db_dirty_records))
+				db->db_state = DB_UNCACHED;
+			mutex_exit(&db->db_mtx);
+		}
+	}
+
+	dmu_buf_rele_array(dbp, numbufs, FTAG);
+
+	return (err);
+}
+
+int
+dmu_write_direct(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    abd_t *data, dmu_tx_t *tx)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+	int err;
+
+	DB_DNODE_ENTER(db);
+	err = dmu_write_direct_by_dnode(DB_DNODE(db), offset, size, data, tx);
+	DB_DNODE_EXIT(db);
+
+	return (err);
+}
+
+#ifdef _KERNEL
+/*
+ * Read 'size' bytes into the uio buffer, starting at zfs_uio_offset(uio),
+ * which must both be multiples of the object's block size.  Blocks which
+ * are not cached are read without being added to the ARC.
+ */
+int
+dmu_read_uio_direct_by_dnode(dnode_t *dn, zfs_uio_t *uio, uint64_t size)
+{
+	spa_t *spa = dn->dn_objset->os_spa;
+	dmu_buf_t **dbp;
+	abd_t **abds;
+	zio_t *rio;
+	int numbufs, err;
+
+	err = dmu_buf_hold_array_by_dnode(dn, zfs_uio_offset(uio), size,
+	    B_FALSE, FTAG, &numbufs, &dbp, DMU_READ_NO_PREFETCH);
+	if (err != 0)
+		return (err);
+
+	abds = kmem_zalloc(numbufs * sizeof (abd_t *), KM_SLEEP);
+	rio = zio_root(spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+	for (int i = 0; i < numbufs; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+		zbookmark_phys_t zb;
+		blkptr_t bp;
+
+		if (!dmu_buf_direct_bp(dbp[i], &bp))
+			continue;
+
+		SET_BOOKMARK(&zb, dmu_objset_id(dn->dn_objset),
+		    db->db.db_object, db->db_level, db->db_blkid);
+		abds[i] = abd_alloc_linear(db->db.db_size, B_FALSE);
+		zio_nowait(zio_read(rio, spa, &bp, abds[i], db->db.db_size,
+		    NULL, NULL, ZIO_PRIORITY_SYNC_READ, ZIO_FLAG_CANFAIL, &zb));
+	}
+	err = zio_wait(rio);
+
+	for (int i = 0; i < numbufs && err == 0; i++) {
+		dmu_buf_t *db = dbp[i];
+		uint64_t tocpy;
+		int64_t bufoff;
+		char *buf;
+
+		ASSERT(size > 0);
+
+		if (abds[i] != NULL) {
+			buf = abd_to_buf(abds[i]);
+		} else {
+			err = dbuf_read((dmu_buf_impl_t *)db, NULL,
+			    DB_RF_CANFAIL | DB_RF_NOPREFETCH);
+			if (err != 0)
+				break;
+			buf = db->db_data;
+		}
+
+		bufoff = zfs_uio_offset(uio) - db->db_offset;
+		tocpy = MIN(db->db_size - bufoff, size);
+
+		err = zfs_uio_fault_move(buf + bufoff, tocpy, UIO_READ, uio);
+		size -= tocpy;
+	}
+
+	for (int i = 0; i < numbufs; i++) {
+		if (abds[i] != NULL)
+			abd_free(abds[i]);
+	}
+	kmem_free(abds, numbufs * sizeof (abd_t *));
+	dmu_buf_rele_array(dbp, numbufs, FTAG);
+
+	return (err);
+}
+
+int
+dmu_read_uio_direct(dmu_buf_t *zdb, zfs_uio_t *uio, uint64_t size)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+	int err;
+
+	if (size == 0)
+		return (0);
+
+	DB_DNODE_ENTER(db);
+	err = dmu_read_uio_direct_by_dnode(DB_DNODE(db), uio, size);
+	DB_DNODE_EXIT(db);
+
+	return (err);
+}
+#endif /* _KERNEL */
+
+EXPORT_SYMBOL(dmu_write_direct_by_dnode);
+EXPORT_SYMBOL(dmu_write_direct);
+#ifdef _KERNEL
+EXPORT_SYMBOL(dmu_read_uio_direct_by_dnode);
+EXPORT_SYMBOL(dmu_read_uio_direct);
+#endif
@@ -164,6 +164,19 @@ dmu_object_alloc_impl(objset_t *os, dmu_object_type_t ot, int blocksize,
 			    dnodes_per_chunk;
 			(void) atomic_swap_64(cpuobj, object);
 			mutex_exit(&os->os_obj_lock);
+
+			/*
+			 * When backfilling previously used parts of the
+			 * meta-dnode, the dnode blocks of the new chunk are
+			 * often not cached, and each would otherwise be read
+			 * synchronously by dnode_hold_impl() below.  Start
+			 * reading the whole chunk now.  This is a no-op for
+			 * chunks that are still holes.
+			 */
+			dmu_prefetch_by_dnode(DMU_META_DNODE(os), 0,
+			    object << DNODE_SHIFT,
+			    (uint64_t)dnodes_per_chunk << DNODE_SHIFT,
+			    ZIO_PRIORITY_SYNC_READ);
 		}
 
 		/*
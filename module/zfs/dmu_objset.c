@@ -276,6 +276,69 @@ prefetch_changed_cb(void *arg, uint64_t newval)
 	os->os_prefetch = newval;
 }
 
+static void
+cacheadmit_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	/*
+	 * Inheritance should have been done by now.
+	 */
+	ASSERT(newval == ZFS_CACHEADMIT_ALL ||
+	    newval == ZFS_CACHEADMIT_FREQUENT);
+	os->os_cacheadmit = newval;
+}
+
+static void
+direct_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	/*
+	 * Inheritance should have been done by now.
+	 */
+	ASSERT(newval == ZFS_DIRECT_DISABLED ||
+	    newval == ZFS_DIRECT_STANDARD || newval == ZFS_DIRECT_ALWAYS);
+	os->os_direct = newval;
+}
+
+/*
+ * The ARC tenant is created the first time either limit is set, and kept
+ * until the objset is evicted so that headers already charged to it stay
+ * valid.
+ */
+static void
+arc_limits_changed(objset_t *os)
+{
+	if (os->os_arc_tenant == NULL) {
+		if (os->os_arc_min == 0 && os->os_arc_max == 0)
+			return;
+		arc_tenant_t *at = arc_tenant_alloc();
+		membar_producer();
+		os->os_arc_tenant = at;
+	}
+	arc_tenant_set_limits(os->os_arc_tenant, os->os_arc_min,
+	    os->os_arc_max);
+}
+
+static void
+arcmin_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	os->os_arc_min = newval;
+	arc_limits_changed(os);
+}
+
+static void
+arcmax_changed_cb(void *arg, uint64_t newval)
+{
+	objset_t *os = arg;
+
+	os->os_arc_max = newval;
+	arc_limits_changed(os);
+}
+
 static void
 sync_changed_cb(void *arg, uint64_t newval)
 {
@@ -424,8 +487,13 @@ dnode_multilist_index_func(multilist_t *ml, void *obj)
 	 * has a power of two number of sublists, each sublists' usage
 	 * would not be evenly distributed. In this context full 64bit
 	 * division would be a waste of time, so limit it to 32 bits.
+	 *
+	 * All dnodes of one meta-dnode block hash to the same sublist, so
+	 * each block is synced by a single sync_dnodes_task() rather than
+	 * having its dnodes spread over every sync thread.
 	 */
-	return ((unsigned int)dnode_hash(dn->dn_objset, dn->dn_object) %
+	return ((unsigned int)dnode_hash(dn->dn_objset,
+	    dn->dn_object >> DNODES_PER_BLOCK_SHIFT) %
 	    multilist_get_num_sublists(ml));
 }
 
@@ -580,6 +648,16 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 			    zfs_prop_to_name(ZFS_PROP_PREFETCH),
 			    prefetch_changed_cb, os);
 		}
+		if (err == 0) {
+			err = dsl_prop_register(ds,
+			    zfs_prop_to_name(ZFS_PROP_CACHEADMIT),
+			    cacheadmit_changed_cb, os);
+		}
+		if (err == 0) {
+			err = dsl_prop_register(ds,
+			    zfs_prop_to_name(ZFS_PROP_DIRECT),
+			    direct_changed_cb, os);
+		}
 		if (!ds->ds_is_snapshot) {
 			if (err == 0) {
 				err = dsl_prop_register(ds,
@@ -633,8 +711,20 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 				    ZFS_PROP_SPECIAL_SMALL_BLOCKS),
 				    smallblk_changed_cb, os);
 			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_ARCMIN),
+				    arcmin_changed_cb, os);
+			}
+			if (err == 0) {
+				err = dsl_prop_register(ds,
+				    zfs_prop_to_name(ZFS_PROP_ARCMAX),
+				    arcmax_changed_cb, os);
+			}
 		}
 		if (err != 0) {
+			if (os->os_arc_tenant != NULL)
+				arc_tenant_rele(os->os_arc_tenant);
 			arc_buf_destroy(os->os_phys_buf, &os->os_phys_buf);
 			kmem_free(os, sizeof (objset_t));
 			return (err);
@@ -654,6 +744,8 @@ dmu_objset_open_impl(spa_t *spa, dsl_dataset_t *ds, blkptr_t *bp,
 		os->os_secondary_cache = ZFS_CACHE_ALL;
 		os->os_dnodesize = DNODE_MIN_SIZE;
 		os->os_prefetch = ZFS_PREFETCH_ALL;
+		os->os_cacheadmit = ZFS_CACHEADMIT_ALL;
+		os->os_direct = ZFS_DIRECT_STANDARD;
 	}
 
 	if (ds == NULL || !ds->ds_is_snapshot)
@@ -1047,6 +1139,9 @@ dmu_objset_evict_done(objset_t *os)
 	rw_enter(&os_lock, RW_READER);
 	rw_exit(&os_lock);
 
+	if (os->os_arc_tenant != NULL)
+		arc_tenant_rele(os->os_arc_tenant);
+
 	kmem_free(os->os_obj_next_percpu,
 	    os->os_obj_next_percpu_len * sizeof (os->os_obj_next_percpu[0]));
 
@@ -1557,34 +1652,68 @@ dmu_objset_upgrade_stop(objset_t *os)
 	}
 }
 
+static int
+dnode_object_compare(const void *x1, const void *x2)
+{
+	const dnode_t *dn1 = *(dnode_t * const *)x1;
+	const dnode_t *dn2 = *(dnode_t * const *)x2;
+
+	return (TREE_CMP(dn1->dn_object, dn2->dn_object));
+}
+
+/*
+ * Sync the dirty dnodes of one sublist in object order.  Dnodes are
+ * dirtied in arbitrary order, so syncing them as they appear in the list
+ * jumps back and forth between meta-dnode blocks and issues the writes
+ * of unrelated objects interleaved.  Sorting keeps the dnodes of each
+ * meta-dnode block together and lets the allocator lay out the data of
+ * consecutive objects consecutively.
+ */
 static void
 dmu_objset_sync_dnodes(multilist_sublist_t *list, dmu_tx_t *tx)
 {
-	dnode_t *dn;
+	dnode_t *dn, **dns;
+	uint64_t count, i;
 
-	while ((dn = multilist_sublist_head(list)) != NULL) {
-		ASSERT(dn->dn_object != DMU_META_DNODE_OBJECT);
-		ASSERT(dn->dn_dbuf->db_data_pending);
-		/*
-		 * Initialize dn_zio outside dnode_sync() because the
-		 * meta-dnode needs to set it outside dnode_sync().
-		 */
-		dn->dn_zio = dn->dn_dbuf->db_data_pending->dr_zio;
-		ASSERT(dn->dn_zio);
+	while (!multilist_sublist_is_empty(list)) {
+		count = 0;
+		for (dn = multilist_sublist_head(list); dn != NULL;
+		    dn = multilist_sublist_next(list, dn))
+			count++;
 
-		ASSERT3U(dn->dn_nlevels, <=, DN_MAX_LEVELS);
-		multilist_sublist_remove(list, dn);
+		dns = vmem_alloc(count * sizeof (dnode_t *), KM_SLEEP);
+		for (i = 0; i < count; i++) {
+			dn = multilist_sublist_head(list);
+			multilist_sublist_remove(list, dn);
+			dns[i] = dn;
+		}
+		qsort(dns, count, sizeof (dnode_t *), dnode_object_compare);
 
-		/*
-		 * See the comment above dnode_rele_task() for an explanation
-		 * of why this dnode hold is always needed (even when not
-		 * doing user accounting).
-		 */
-		multilist_t *newlist = &dn->dn_objset->os_synced_dnodes;
-		(void) dnode_add_ref(dn, newlist);
-		multilist_insert(newlist, dn);
+		for (i = 0; i < count; i++) {
+			dn = dns[i];
+			ASSERT(dn->dn_object != DMU_META_DNODE_OBJECT);
+			ASSERT(dn->dn_dbuf->db_data_pending);
+			/*
+			 * Initialize dn_zio outside dnode_sync() because the
+			 * meta-dnode needs to set it outside dnode_sync().
+			 */
+			dn->dn_zio = dn->dn_dbuf->db_data_pending->dr_zio;
+			ASSERT(dn->dn_zio);
+
+			ASSERT3U(dn->dn_nlevels, <=, DN_MAX_LEVELS);
+
+			/*
+			 * See the comment above dnode_rele_task() for an
+			 * explanation of why this dnode hold is always needed
+			 * (even when not doing user accounting).
+			 */
+			multilist_t *newlist = &dn->dn_objset->os_synced_dnodes;
+			(void) dnode_add_ref(dn, newlist);
+			multilist_insert(newlist, dn);
 
-		dnode_sync(dn, tx);
+			dnode_sync(dn, tx);
+		}
+		vmem_free(dns, count * sizeof (dnode_t *));
 	}
 }
 
@@ -2063,12 +2192,98 @@ do_userobjquota_update(objset_t *os, userquota_cache_t *cache, uint64_t flags,
 	}
 }
 
+/*
+ * State shared by the userquota_updates_task()s of one objset in one txg.
+ * Each task sums the deltas of its own sublist of os_synced_dnodes without
+ * any locking, then merges them into uqs_cache.  The last task to finish
+ * applies the merged deltas to the ZAPs, so every id that was touched is
+ * updated once per txg rather than once per sublist it appeared in.
+ */
+typedef struct userquota_shared {
+	kmutex_t uqs_lock;
+	userquota_cache_t uqs_cache;
+	int uqs_tasks;			/* tasks yet to merge, uqs_lock */
+	uint64_t uqs_update_nsecs;	/* summed task time, uqs_lock */
+} userquota_shared_t;
+
 typedef struct userquota_updates_arg {
 	objset_t *uua_os;
 	int uua_sublist_idx;
 	dmu_tx_t *uua_tx;
+	userquota_shared_t *uua_shared;
 } userquota_updates_arg_t;
 
+static void
+userquota_cache_create(objset_t *os, userquota_cache_t *cache)
+{
+	avl_create(&cache->uqc_user_deltas, userquota_compare,
+	    sizeof (userquota_node_t), offsetof(userquota_node_t, uqn_node));
+	avl_create(&cache->uqc_group_deltas, userquota_compare,
+	    sizeof (userquota_node_t), offsetof(userquota_node_t, uqn_node));
+	if (dmu_objset_projectquota_enabled(os))
+		avl_create(&cache->uqc_project_deltas, userquota_compare,
+		    sizeof (userquota_node_t), offsetof(userquota_node_t,
+		    uqn_node));
+}
+
+/*
+ * Move all nodes of "from" into "to", adding up the deltas of ids present
+ * in both, and destroy "from".
+ */
+static void
+userquota_cache_merge_tree(avl_tree_t *to, avl_tree_t *from)
+{
+	void *cookie = NULL;
+	userquota_node_t *uqn, *dst;
+	avl_index_t idx;
+
+	while ((uqn = avl_destroy_nodes(from, &cookie)) != NULL) {
+		dst = avl_find(to, uqn, &idx);
+		if (dst != NULL) {
+			dst->uqn_delta += uqn->uqn_delta;
+			kmem_free(uqn, sizeof (*uqn));
+		} else {
+			avl_insert(to, uqn, idx);
+		}
+	}
+	avl_destroy(from);
+}
+
+/*
+ * Merge a task's private cache into the shared one.  The last task to
+ * merge flushes the result to the ZAPs and frees the shared state.
+ */
+static void
+userquota_cache_merge(objset_t *os, userquota_shared_t *uqs,
+    userquota_cache_t *cache, uint64_t update_nsecs, dmu_tx_t *tx)
+{
+	boolean_t last;
+
+	mutex_enter(&uqs->uqs_lock);
+	userquota_cache_merge_tree(&uqs->uqs_cache.uqc_user_deltas,
+	    &cache->uqc_user_deltas);
+	userquota_cache_merge_tree(&uqs->uqs_cache.uqc_group_deltas,
+	    &cache->uqc_group_deltas);
+	if (dmu_objset_projectquota_enabled(os)) {
+		userquota_cache_merge_tree(&uqs->uqs_cache.uqc_project_deltas,
+		    &cache->uqc_project_deltas);
+	}
+	uqs->uqs_update_nsecs += update_nsecs;
+	last = (--uqs->uqs_tasks == 0);
+	mutex_exit(&uqs->uqs_lock);
+
+	if (!last)
+		return;
+
+	hrtime_t start = gethrtime();
+	do_userquota_cacheflush(os, &uqs->uqs_cache, tx);
+	spa_iostats_userquota_add(dmu_objset_spa(os), uqs->uqs_update_nsecs,
+	    gethrtime() - start);
+
+	mutex_destroy(&uqs->uqs_lock);
+	kmem_free(uqs, sizeof (*uqs));
+}
+
 static void
 userquota_updates_task(void *arg)
 {
@@ -2077,20 +2292,14 @@ userquota_updates_task(void *arg)
 	dmu_tx_t *tx = uua->uua_tx;
 	dnode_t *dn;
 	userquota_cache_t cache = { { 0 } };
+	hrtime_t start = gethrtime();
 
 	multilist_sublist_t *list = multilist_sublist_lock_idx(
 	    &os->os_synced_dnodes, uua->uua_sublist_idx);
 
 	ASSERT(multilist_sublist_head(list) == NULL ||
 	    dmu_objset_userused_enabled(os));
-	avl_create(&cache.uqc_user_deltas, userquota_compare,
-	    sizeof (userquota_node_t), offsetof(userquota_node_t, uqn_node));
-	avl_create(&cache.uqc_group_deltas, userquota_compare,
-	    sizeof (userquota_node_t), offsetof(userquota_node_t, uqn_node));
-	if (dmu_objset_projectquota_enabled(os))
-		avl_create(&cache.uqc_project_deltas, userquota_compare,
-		    sizeof (userquota_node_t), offsetof(userquota_node_t,
-		    uqn_node));
+	userquota_cache_create(os, &cache);
 
 	while ((dn = multilist_sublist_head(list)) != NULL) {
 		int flags;
@@ -2138,8 +2347,9 @@ userquota_updates_task(void *arg)
 		multilist_sublist_remove(list, dn);
 		dnode_rele(dn, &os->os_synced_dnodes);
 	}
-	do_userquota_cacheflush(os, &cache, tx);
 	multilist_sublist_unlock(list);
+	userquota_cache_merge(os, uua->uua_shared, &cache,
+	    gethrtime() - start, tx);
 	kmem_free(uua, sizeof (*uua));
 }
 
@@ -2222,14 +2432,22 @@ void
 dmu_objset_sync_done(objset_t *os, dmu_tx_t *tx)
 {
 	boolean_t need_userquota = dmu_objset_do_userquota_updates_prep(os, tx);
+	userquota_shared_t *uqs = NULL;
 
 	int num_sublists = multilist_get_num_sublists(&os->os_synced_dnodes);
+	if (need_userquota) {
+		uqs = kmem_zalloc(sizeof (*uqs), KM_SLEEP);
+		mutex_init(&uqs->uqs_lock, NULL, MUTEX_DEFAULT, NULL);
+		userquota_cache_create(os, &uqs->uqs_cache);
+		uqs->uqs_tasks = num_sublists;
+	}
 	for (int i = 0; i < num_sublists; i++) {
 		userquota_updates_arg_t *uua =
 		    kmem_alloc(sizeof (*uua), KM_SLEEP);
 		uua->uua_os = os;
 		uua->uua_sublist_idx = i;
 		uua->uua_tx = tx;
+		uua->uua_shared = uqs;
 
 		/*
 		 * If we don't need to update userquotas, use
@@ -2583,6 +2801,10 @@ dmu_objset_stats(objset_t *os, nvlist_t *nv)
 	    os->os_phys->os_type);
 	dsl_prop_nvlist_add_uint64(nv, ZFS_PROP_USERACCOUNTING,
 	    dmu_objset_userspace_present(os));
+	if (os->os_arc_tenant != NULL) {
+		dsl_prop_nvlist_add_uint64(nv, ZFS_PROP_ARCUSED,
+		    arc_tenant_size(os->os_arc_tenant));
+	}
 }
 
 int
@@ -2933,6 +3155,79 @@ dmu_objset_find_dp(dsl_pool_t *dp, uint64_t ddobj,
 	return (error);
 }
 
+static int
+dmu_objset_prefetch_cb(dsl_pool_t *dp, dsl_dataset_t *ds, void *arg)
+{
+	(void) arg;
+	dsl_dir_t *dd = ds->ds_dir;
+	blkptr_t *bp = &dsl_dataset_phys(ds)->ds_bp;
+	uint64_t zapobj = dsl_dir_phys(dd)->dd_props_zapobj;
+
+	/*
+	 * Both the property lookups and the objset open (which reads the
+	 * ZIL header out of the objset_phys_t) of a later mount would
+	 * otherwise each wait on a random MOS or objset read of their own.
+	 */
+	if (zapobj != 0) {
+		dmu_prefetch(dp->dp_meta_objset, zapobj, 0, 0, 1,
+		    ZIO_PRIORITY_ASYNC_READ);
+	}
+
+	if (!BP_IS_HOLE(bp)) {
+		arc_flags_t aflags = ARC_FLAG_NOWAIT | ARC_FLAG_PREFETCH;
+		zio_flag_t zio_flags = ZIO_FLAG_CANFAIL | ZIO_FLAG_SPECULATIVE;
+		zbookmark_phys_t zb;
+
+		if (BP_IS_PROTECTED(bp))
+			zio_flags |= ZIO_FLAG_RAW;
+
+		SET_BOOKMARK(&zb, ds->ds_object, ZB_ROOT_OBJECT,
+		    ZB_ROOT_LEVEL, ZB_ROOT_BLKID);
+		(void) arc_read(NULL, dp->dp_spa, bp, NULL, NULL,
+		    ZIO_PRIORITY_ASYNC_READ, zio_flags, &aflags, &zb);
+	}
+
+	return (0);
+}
+
+/*
+ * Warm the caches for mounting every filesystem under and including name.
+ * The walk itself reads each dataset's dsl_dir and dsl_dataset on the
+ * dmu_objset_find_dp() taskq, and we additionally prefetch each
+ * dataset's property ZAP and objset block.  Running this once before a
+ * mass mount turns tens of thousands of serialized metadata reads into a
+ * few parallel passes over the MOS.
+ */
+int
+dmu_objset_prefetch_descendants(const char *name)
+{
+	dsl_pool_t *dp;
+	dsl_dir_t *dd;
+	uint64_t ddobj;
+	int error;
+
+	if (strchr(name, '@') != NULL)
+		return (SET_ERROR(EINVAL));
+
+	error = dsl_pool_hold(name, FTAG, &dp);
+	if (error != 0)
+		return (error);
+
+	error = dsl_dir_hold(dp, name, FTAG, &dd, NULL);
+	if (error != 0) {
+		dsl_pool_rele(dp, FTAG);
+		return (error);
+	}
+	ddobj = dd->dd_object;
+	dsl_dir_rele(dd, FTAG);
+
+	error = dmu_objset_find_dp(dp, ddobj, dmu_objset_prefetch_cb, NULL,
+	    DS_FIND_CHILDREN);
+
+	dsl_pool_rele(dp, FTAG);
+	return (error);
+}
+
 /*
  * Find all objsets under name, and for each, call 'func(child_name, arg)'.
  * The dp_config_rwlock must not be held when this is called, and it
@@ -3121,11 +3416,45 @@ dmu_objset_willuse_space(objset_t *os, int64_t space, dmu_tx_t *tx)
 
 	if (ds != NULL) {
 		dsl_dir_willuse_space(ds->ds_dir, aspace, tx);
+		if (space > 0) {
+			atomic_add_64(
+			    &os->os_dirty_pertxg[tx->tx_txg & TXG_MASK], space);
+		}
 	}
 
 	dsl_pool_dirty_space(dmu_tx_pool(tx), space, tx);
 }
 
+/*
+ * Counterpart of dmu_objset_willuse_space(), called as dirty data of this
+ * objset is written out or undirtied.  Whatever remains accounted to the
+ * txg once it has synced is dropped by dsl_dataset_sync_done().
+ */
+void
+dmu_objset_undirty_space(objset_t *os, int64_t space, uint64_t txg)
+{
+	if (os->os_dsl_dataset != NULL && space > 0)
+		atomic_add_64(&os->os_dirty_pertxg[txg & TXG_MASK], -space);
+
+	dsl_pool_undirty_space(dmu_objset_pool(os), space, txg);
+}
+
+/*
+ * Dirty data of this dataset over all open and syncing txgs, as used by
+ * the per-dataset write throttle in dmu_tx_delay().  The per-txg counters
+ * may briefly go negative when more is written than was accounted.
+ */
+uint64_t
+dmu_objset_dirty_total(objset_t *os)
+{
+	int64_t total = 0;
+
+	for (int t = 0; t < TXG_SIZE; t++)
+		total += (int64_t)atomic_load_64(&os->os_dirty_pertxg[t]);
+
+	return (MAX(total, 0));
+}
+
 #if defined(_KERNEL)
 EXPORT_SYMBOL(dmu_objset_zil);
 EXPORT_SYMBOL(dmu_objset_pool);
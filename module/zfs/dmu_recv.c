@@ -73,6 +73,17 @@ static uint_t zfs_recv_queue_ff = 20;
 static uint_t zfs_recv_write_batch_size = 1024 * 1024;
 static int zfs_recv_best_effort_corrective = 0;
 
+/*
+ * Number of threads that apply per-object records of a receive, in addition
+ * to the writer thread. Records are routed by dnode block, so records for
+ * one object (or for objects sharing a dnode block) keep their stream
+ * order, while different objects are applied concurrently. Records that
+ * span objects (FREEOBJECTS, OBJECT_RANGE, REDACT) wait for all threads to
+ * drain first. Resumable, raw and healing receives, which depend on strict
+ * stream order, always use the writer thread alone. 0 disables this.
+ */
+static uint_t zfs_recv_writer_threads = 0;
+
 static const void *const dmu_recv_tag = "dmu_recv_tag";
 const char *const recv_clone_name = "%recv";
 
@@ -96,6 +107,7 @@ struct receive_record_arg {
 	int payload_size;
 	uint64_t bytes_read; /* bytes read from stream when record created */
 	boolean_t eos_marker; /* Marks the end of the stream */
+	boolean_t barrier; /* Writer lane must drain; see receive_lanes_wait */
 	bqueue_node_t node;
 };
 
@@ -138,6 +150,14 @@ struct receive_writer_arg {
 
 	/* Keep track of DRR_FREEOBJECTS right after DRR_OBJECT_RANGE */
 	or_need_sync_t or_need_sync;
+
+	/* Writer lanes, see zfs_recv_writer_threads */
+	struct receive_writer_arg *lanes;
+	struct receive_writer_arg *parent;
+	uint_t nlanes;
+	uint_t lanes_busy;	/* lanes yet to reach a barrier, under mutex */
+	boolean_t lanes_dirty;	/* records queued since the last barrier */
+	kcondvar_t lanes_cv;
 };
 
 typedef struct dmu_recv_begin_arg {
@@ -2803,15 +2823,44 @@ receive_read_payload_and_next_header(dmu_recv_cookie_t *drc, int len, void *buf)
  * given object number, we can safely remove any reference to lower object
  * numbers in the ignore list. In practice, we receive up to 32 object records
  * before receiving write records, so the list can have up to 32 nodes in it.
+ *
+ * A record which does not start or end on a block boundary makes the writer
+ * read the existing block at that edge to merge it with the new data (or to
+ * zero part of it for a free).  In an incremental receive these reads would
+ * otherwise be issued one at a time from the writer thread, so prefetch the
+ * edge blocks as well while the record waits in the queue.  Pass
+ * "indirect" as B_FALSE to skip the indirect blocks, e.g. for a free of an
+ * unbounded range.
  */
 static void
 receive_read_prefetch(dmu_recv_cookie_t *drc, uint64_t object, uint64_t offset,
-    uint64_t length)
+    uint64_t length, boolean_t indirect)
 {
-	if (!objlist_exists(drc->drc_ignore_objlist, object)) {
-		dmu_prefetch(drc->drc_os, object, 1, offset, length,
+	dnode_t *dn;
+
+	if (objlist_exists(drc->drc_ignore_objlist, object) || length == 0)
+		return;
+	if (dnode_hold(drc->drc_os, object, FTAG, &dn) != 0)
+		return;
+
+	if (indirect) {
+		dmu_prefetch_by_dnode(dn, 1, offset, length,
+		    ZIO_PRIORITY_SYNC_READ);
+	}
+
+	/* A racy read of the block size is fine for a prefetch. */
+	uint32_t blksz = dn->dn_datablksz;
+	if (offset % blksz != 0) {
+		dmu_prefetch_by_dnode(dn, 0, offset, 1,
+		    ZIO_PRIORITY_SYNC_READ);
+	}
+	if (length != DMU_OBJECT_END && offset + length > offset &&
+	    (offset + length) % blksz != 0 &&
+	    (offset + length - 1) / blksz != offset / blksz) {
+		dmu_prefetch_by_dnode(dn, 0, offset + length - 1, 1,
 		    ZIO_PRIORITY_SYNC_READ);
 	}
+	dnode_rele(dn, FTAG);
 }
 
 /*
@@ -2870,7 +2919,7 @@ receive_read_record(dmu_recv_cookie_t *drc)
 		}
 		drc->drc_rrd->abd = abd;
 		receive_read_prefetch(drc, drrw->drr_object, drrw->drr_offset,
-		    drrw->drr_logical_size);
+		    drrw->drr_logical_size, B_TRUE);
 		return (err);
 	}
 	case DRR_WRITE_EMBEDDED:
@@ -2887,16 +2936,25 @@ receive_read_record(dmu_recv_cookie_t *drc)
 		}
 
 		receive_read_prefetch(drc, drrwe->drr_object, drrwe->drr_offset,
-		    drrwe->drr_length);
+		    drrwe->drr_length, B_TRUE);
 		return (err);
 	}
 	case DRR_FREE:
-	case DRR_REDACT:
 	{
+		struct drr_free *drrf = &drc->drc_rrd->header.drr_u.drr_free;
+
 		/*
 		 * It might be beneficial to prefetch indirect blocks here, but
-		 * we don't really have the data to decide for sure.
+		 * we don't really have the data to decide for sure.  The
+		 * partially freed blocks at the edges will be read, though.
 		 */
+		receive_read_prefetch(drc, drrf->drr_object, drrf->drr_offset,
+		    drrf->drr_length, B_FALSE);
+		err = receive_read_payload_and_next_header(drc, 0, NULL);
+		return (err);
+	}
+	case DRR_REDACT:
+	{
 		err = receive_read_payload_and_next_header(drc, 0, NULL);
 		return (err);
 	}
@@ -3170,6 +3228,192 @@ receive_process_record(struct receive_writer_arg *rwa,
 	return (err);
 }
 
+/*
+ * Apply one record, or just free it if we have already failed.
+ */
+static void
+receive_writer_consume(struct receive_writer_arg *rwa,
+    struct receive_record_arg *rrd)
+{
+	/*
+	 * If there's an error, the main thread will stop putting things
+	 * on the queue, but we need to clear everything in it before we
+	 * can exit.
+	 */
+	int err = 0;
+	if (rwa->err == 0 && rwa->parent != NULL)
+		rwa->err = rwa->parent->err;
+	if (rwa->err == 0) {
+		err = receive_process_record(rwa, rrd);
+	} else if (rrd->abd != NULL) {
+		abd_free(rrd->abd);
+		rrd->abd = NULL;
+		rrd->payload = NULL;
+	} else if (rrd->payload != NULL) {
+		kmem_free(rrd->payload, rrd->payload_size);
+		rrd->payload = NULL;
+	}
+	/*
+	 * EAGAIN indicates that this record has been saved (on
+	 * raw->write_batch), and will be used again, so we don't
+	 * free it.
+	 * When healing data we always need to free the record.
+	 */
+	if (err != EAGAIN || rwa->heal) {
+		if (rwa->err == 0)
+			rwa->err = err;
+		kmem_free(rrd, sizeof (*rrd));
+	}
+}
+
+/*
+ * Pick the writer lane for a record, or NULL if it must be applied by the
+ * writer thread after all lanes have drained. All objects in a dnode block
+ * share a lane, so that a DRR_OBJECT whose dnode slots overlap an older
+ * object is ordered against the records for that object.
+ */
+static struct receive_writer_arg *
+receive_lane_select(struct receive_writer_arg *rwa,
+    struct receive_record_arg *rrd)
+{
+	uint64_t object;
+
+	switch (rrd->header.drr_type) {
+	case DRR_OBJECT:
+		object = rrd->header.drr_u.drr_object.drr_object;
+		break;
+	case DRR_WRITE:
+		object = rrd->header.drr_u.drr_write.drr_object;
+		break;
+	case DRR_WRITE_EMBEDDED:
+		object = rrd->header.drr_u.drr_write_embedded.drr_object;
+		break;
+	case DRR_FREE:
+		object = rrd->header.drr_u.drr_free.drr_object;
+		break;
+	case DRR_SPILL:
+		object = rrd->header.drr_u.drr_spill.drr_object;
+		break;
+	default:
+		return (NULL);
+	}
+	return (&rwa->lanes[(object >> DNODES_PER_BLOCK_SHIFT) % rwa->nlanes]);
+}
+
+static __attribute__((noreturn)) void
+receive_lane_thread(void *arg)
+{
+	struct receive_writer_arg *lane = arg;
+	struct receive_writer_arg *rwa = lane->parent;
+	struct receive_record_arg *rrd;
+	fstrans_cookie_t cookie = spl_fstrans_mark();
+	boolean_t eos = B_FALSE;
+
+	while (!eos) {
+		rrd = bqueue_dequeue(&lane->q);
+		if (!rrd->barrier && !rrd->eos_marker) {
+			receive_writer_consume(lane, rrd);
+			continue;
+		}
+
+		int err = flush_write_batch(lane);
+		if (lane->err == 0)
+			lane->err = err;
+		eos = rrd->eos_marker;
+		kmem_free(rrd, sizeof (*rrd));
+
+		mutex_enter(&rwa->mutex);
+		if (--rwa->lanes_busy == 0)
+			cv_signal(&rwa->lanes_cv);
+		mutex_exit(&rwa->mutex);
+	}
+	spl_fstrans_unmark(cookie);
+	thread_exit();
+}
+
+/*
+ * Wait for every lane to apply the records queued to it so far, and pick
+ * up any error they hit. With eos set the lanes exit afterwards.
+ */
+static void
+receive_lanes_wait(struct receive_writer_arg *rwa, boolean_t eos)
+{
+	if (!rwa->lanes_dirty && !eos)
+		return;
+
+	mutex_enter(&rwa->mutex);
+	ASSERT0(rwa->lanes_busy);
+	rwa->lanes_busy = rwa->nlanes;
+	mutex_exit(&rwa->mutex);
+
+	for (uint_t i = 0; i < rwa->nlanes; i++) {
+		struct receive_record_arg *rrd =
+		    kmem_zalloc(sizeof (*rrd), KM_SLEEP);
+		rrd->barrier = !eos;
+		rrd->eos_marker = eos;
+		bqueue_enqueue_flush(&rwa->lanes[i].q, rrd, 1);
+	}
+
+	mutex_enter(&rwa->mutex);
+	while (rwa->lanes_busy != 0)
+		cv_wait(&rwa->lanes_cv, &rwa->mutex);
+	mutex_exit(&rwa->mutex);
+
+	for (uint_t i = 0; i < rwa->nlanes; i++) {
+		if (rwa->err == 0)
+			rwa->err = rwa->lanes[i].err;
+	}
+	rwa->lanes_dirty = B_FALSE;
+}
+
+static void
+receive_lanes_init(struct receive_writer_arg *rwa, uint_t nlanes)
+{
+	rwa->nlanes = nlanes;
+	rwa->lanes = kmem_zalloc(nlanes * sizeof (*rwa->lanes), KM_SLEEP);
+	cv_init(&rwa->lanes_cv, NULL, CV_DEFAULT, NULL);
+
+	for (uint_t i = 0; i < nlanes; i++) {
+		struct receive_writer_arg *lane = &rwa->lanes[i];
+
+		(void) bqueue_init(&lane->q, zfs_recv_queue_ff,
+		    MAX(zfs_recv_queue_length, 2 * zfs_max_recordsize),
+		    offsetof(struct receive_record_arg, node));
+		lane->parent = rwa;
+		lane->os = rwa->os;
+		lane->byteswap = rwa->byteswap;
+		lane->tofs = rwa->tofs;
+		lane->spill = rwa->spill;
+		lane->full = rwa->full;
+		list_create(&lane->write_batch,
+		    sizeof (struct receive_record_arg),
+		    offsetof(struct receive_record_arg, node.bqn_node));
+		(void) thread_create(NULL, 0, receive_lane_thread, lane, 0,
+		    curproc, TS_RUN, minclsyspri);
+	}
+}
+
+/*
+ * Stop the lanes and fold their state back into the writer.
+ */
+static void
+receive_lanes_fini(struct receive_writer_arg *rwa)
+{
+	receive_lanes_wait(rwa, B_TRUE);
+
+	for (uint_t i = 0; i < rwa->nlanes; i++) {
+		struct receive_writer_arg *lane = &rwa->lanes[i];
+
+		rwa->max_object = MAX(rwa->max_object, lane->max_object);
+		bqueue_destroy(&lane->q);
+		list_destroy(&lane->write_batch);
+	}
+	cv_destroy(&rwa->lanes_cv);
+	kmem_free(rwa->lanes, rwa->nlanes * sizeof (*rwa->lanes));
+	rwa->lanes = NULL;
+	rwa->nlanes = 0;
+}
+
 /*
  * dmu_recv_stream's worker thread; pull records off the queue, and then call
  * receive_process_record  When we're done, signal the main thread and exit.
@@ -3183,36 +3427,28 @@ receive_writer_thread(void *arg)
 
 	for (rrd = bqueue_dequeue(&rwa->q); !rrd->eos_marker;
 	    rrd = bqueue_dequeue(&rwa->q)) {
-		/*
-		 * If there's an error, the main thread will stop putting things
-		 * on the queue, but we need to clear everything in it before we
-		 * can exit.
-		 */
-		int err = 0;
-		if (rwa->err == 0) {
-			err = receive_process_record(rwa, rrd);
-		} else if (rrd->abd != NULL) {
-			abd_free(rrd->abd);
-			rrd->abd = NULL;
-			rrd->payload = NULL;
-		} else if (rrd->payload != NULL) {
-			kmem_free(rrd->payload, rrd->payload_size);
-			rrd->payload = NULL;
-		}
-		/*
-		 * EAGAIN indicates that this record has been saved (on
-		 * raw->write_batch), and will be used again, so we don't
-		 * free it.
-		 * When healing data we always need to free the record.
-		 */
-		if (err != EAGAIN || rwa->heal) {
-			if (rwa->err == 0)
-				rwa->err = err;
-			kmem_free(rrd, sizeof (*rrd));
+		if (rwa->nlanes != 0 && rwa->err == 0) {
+			struct receive_writer_arg *lane =
+			    receive_lane_select(rwa, rrd);
+
+			if (lane != NULL) {
+				if (lane->err != 0)
+					rwa->err = lane->err;
+				rwa->lanes_dirty = B_TRUE;
+				bqueue_enqueue(&lane->q, rrd,
+				    sizeof (struct receive_record_arg) +
+				    rrd->payload_size);
+				continue;
+			}
+			receive_lanes_wait(rwa, B_FALSE);
 		}
+		receive_writer_consume(rwa, rrd);
 	}
 	kmem_free(rrd, sizeof (*rrd));
 
+	if (rwa->nlanes != 0)
+		receive_lanes_fini(rwa);
+
 	if (rwa->heal) {
 		zio_wait(rwa->heal_pio);
 	} else {
@@ -3370,6 +3606,9 @@ dmu_recv_stream(dmu_recv_cookie_t *drc, offset_t *voffp)
 	}
 	list_create(&rwa->write_batch, sizeof (struct receive_record_arg),
 	    offsetof(struct receive_record_arg, node.bqn_node));
+	if (zfs_recv_writer_threads != 0 && !rwa->heal && !rwa->raw &&
+	    !rwa->resumable)
+		receive_lanes_init(rwa, zfs_recv_writer_threads);
 
 	(void) thread_create(NULL, 0, receive_writer_thread, rwa, 0, curproc,
 	    TS_RUN, minclsyspri);
@@ -3804,6 +4043,9 @@ ZFS_MODULE_PARAM(zfs_recv, zfs_recv_, queue_ff, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_recv, zfs_recv_, write_batch_size, UINT, ZMOD_RW,
 	"Maximum amount of writes to batch into one transaction");
 
+ZFS_MODULE_PARAM(zfs_recv, zfs_recv_, writer_threads, UINT, ZMOD_RW,
+	"Threads applying per-object records of a non-resumable receive");
+
 ZFS_MODULE_PARAM(zfs_recv, zfs_recv_, best_effort_corrective, INT, ZMOD_RW,
 	"Ignore errors during corrective receive");
 /* END CSTYLED */
@@ -94,6 +94,14 @@ static uint_t zfs_send_no_prefetch_queue_length = 1024 * 1024;
 static uint_t zfs_send_queue_ff = 20;
 static uint_t zfs_send_no_prefetch_queue_ff = 20;
 
+/*
+ * Number of threads per send that fetch block data from the ARC on behalf
+ * of the reader thread. A hit may need to decompress or decrypt the block,
+ * which would otherwise serialize the stream on the reader. 0 does the
+ * lookups on the reader thread itself.
+ */
+static uint_t zfs_send_reader_threads = 4;
+
 /*
  * Use this to override the recordsize calculation for fast zfs send estimates.
  */
@@ -167,6 +175,8 @@ struct send_range {
 			boolean_t		io_outstanding;
 			boolean_t		io_compressed;
 			int			io_err;
+			zio_flag_t		io_flags;
+			objset_t		*io_os;
 		} data;
 		struct srh {
 			uint32_t		datablksz;
@@ -1600,6 +1610,7 @@ send_merge_thread(void *arg)
 struct send_reader_thread_arg {
 	struct send_merge_thread_arg *smta;
 	bqueue_t q;
+	taskq_t *tq;	/* see zfs_send_reader_threads */
 	boolean_t cancel;
 	boolean_t issue_reads;
 	uint64_t featureflags;
@@ -1624,6 +1635,55 @@ dmu_send_read_done(zio_t *zio)
 	mutex_exit(&range->sru.data.lock);
 }
 
+/*
+ * Read the data for a DATA range, from the ARC if it is cached there and
+ * with an asynchronous zio otherwise. If async is set, the caller has
+ * marked the read outstanding and the consumer may already be waiting.
+ */
+static void
+send_read_data(struct send_range *range, boolean_t async)
+{
+	struct srd *srdp = &range->sru.data;
+	objset_t *os = srdp->io_os;
+
+	zbookmark_phys_t zb = {
+	    .zb_objset = dmu_objset_id(os),
+	    .zb_object = range->object,
+	    .zb_level = 0,
+	    .zb_blkid = range->start_blkid,
+	};
+
+	arc_flags_t aflags = ARC_FLAG_CACHED_ONLY;
+
+	int arc_err = arc_read(NULL, os->os_spa, &srdp->bp,
+	    arc_getbuf_func, &srdp->abuf, ZIO_PRIORITY_ASYNC_READ,
+	    srdp->io_flags, &aflags, &zb);
+	/*
+	 * If the data is not already cached in the ARC, we read directly
+	 * from zio.  This avoids the performance overhead of adding a new
+	 * entry to the ARC, and we also avoid polluting the ARC cache with
+	 * data that is not likely to be used in the future.
+	 */
+	if (arc_err != 0) {
+		srdp->abd = abd_alloc_linear(srdp->datasz, B_FALSE);
+		srdp->io_outstanding = B_TRUE;
+		zio_nowait(zio_read(NULL, os->os_spa, &srdp->bp, srdp->abd,
+		    srdp->datasz, dmu_send_read_done, range,
+		    ZIO_PRIORITY_ASYNC_READ, srdp->io_flags, &zb));
+	} else if (async) {
+		mutex_enter(&srdp->lock);
+		srdp->io_outstanding = B_FALSE;
+		cv_broadcast(&srdp->cv);
+		mutex_exit(&srdp->lock);
+	}
+}
+
+static void
+send_read_data_task(void *arg)
+{
+	send_read_data(arg, B_TRUE);
+}
+
 static void
 issue_data_read(struct send_reader_thread_arg *srta, struct send_range *range)
 {
@@ -1677,30 +1737,20 @@ issue_data_read(struct send_reader_thread_arg *srta, struct send_range *range)
 	if (send_do_embed(bp, srta->featureflags))
 		return;
 
-	zbookmark_phys_t zb = {
-	    .zb_objset = dmu_objset_id(os),
-	    .zb_object = range->object,
-	    .zb_level = 0,
-	    .zb_blkid = range->start_blkid,
-	};
-
-	arc_flags_t aflags = ARC_FLAG_CACHED_ONLY;
+	srdp->io_flags = zioflags;
+	srdp->io_os = os;
 
-	int arc_err = arc_read(NULL, os->os_spa, bp,
-	    arc_getbuf_func, &srdp->abuf, ZIO_PRIORITY_ASYNC_READ,
-	    zioflags, &aflags, &zb);
 	/*
-	 * If the data is not already cached in the ARC, we read directly
-	 * from zio.  This avoids the performance overhead of adding a new
-	 * entry to the ARC, and we also avoid polluting the ARC cache with
-	 * data that is not likely to be used in the future.
+	 * Ranges are consumed in queue order no matter when their data
+	 * arrives, so the lookups can be spread over the reader taskq;
+	 * do_dump() waits for io_outstanding to clear as it does for zios.
 	 */
-	if (arc_err != 0) {
-		srdp->abd = abd_alloc_linear(srdp->datasz, B_FALSE);
+	if (srta->tq != NULL) {
 		srdp->io_outstanding = B_TRUE;
-		zio_nowait(zio_read(NULL, os->os_spa, bp, srdp->abd,
-		    srdp->datasz, dmu_send_read_done, range,
-		    ZIO_PRIORITY_ASYNC_READ, zioflags, &zb));
+		VERIFY3U(taskq_dispatch(srta->tq, send_read_data_task, range,
+		    TQ_SLEEP), !=, TASKQID_INVALID);
+	} else {
+		send_read_data(range, B_FALSE);
 	}
 }
 
@@ -2149,6 +2199,11 @@ setup_reader_thread(struct send_reader_thread_arg *srt_arg,
 	srt_arg->smta = smt_arg;
 	srt_arg->issue_reads = !dspp->dso->dso_dryrun;
 	srt_arg->featureflags = featureflags;
+	if (srt_arg->issue_reads && zfs_send_reader_threads > 0) {
+		srt_arg->tq = taskq_create("send_reader",
+		    zfs_send_reader_threads, minclsyspri,
+		    zfs_send_reader_threads, INT_MAX, TASKQ_PREPOPULATE);
+	}
 	(void) thread_create(NULL, 0, send_reader_thread, srt_arg, 0,
 	    curproc, TS_RUN, minclsyspri);
 }
@@ -2571,6 +2626,8 @@ dmu_send_impl(struct dmu_send_params *dspp)
 	range_free(range);
 
 	bqueue_destroy(&srt_arg->q);
+	if (srt_arg->tq != NULL)
+		taskq_destroy(srt_arg->tq);
 	bqueue_destroy(&smt_arg->q);
 	if (dspp->redactbook != NULL)
 		bqueue_destroy(&rlt_arg->q);
@@ -3115,6 +3172,9 @@ ZFS_MODULE_PARAM(zfs_send, zfs_send_, no_prefetch_queue_length, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_send, zfs_send_, queue_ff, UINT, ZMOD_RW,
 	"Send queue fill fraction");
 
+ZFS_MODULE_PARAM(zfs_send, zfs_send_, reader_threads, UINT, ZMOD_RW,
+	"Threads per send that fetch block data for the reader thread");
+
 ZFS_MODULE_PARAM(zfs_send, zfs_send_, no_prefetch_queue_ff, UINT, ZMOD_RW,
 	"Send queue fill fraction for non-prefetch queues");
 
@@ -803,8 +803,152 @@ traverse_pool(spa_t *spa, uint64_t txg_start, int flags,
 	return (err);
 }
 
+typedef struct traverse_parallel {
+	kmutex_t	tp_lock;
+	spa_t		*tp_spa;
+	uint64_t	tp_txg_start;
+	int		tp_flags;
+	blkptr_cb_t	*tp_func;
+	void		**tp_args;
+	boolean_t	*tp_busy;
+	int		tp_nargs;
+	int		tp_err;
+} traverse_parallel_t;
+
+typedef struct traverse_parallel_arg {
+	traverse_parallel_t	*tpa_tp;
+	uint64_t		tpa_obj;
+} traverse_parallel_arg_t;
+
+static void
+traverse_parallel_dataset(void *arg)
+{
+	traverse_parallel_arg_t *tpa = arg;
+	traverse_parallel_t *tp = tpa->tpa_tp;
+	dsl_pool_t *dp = spa_get_dsl(tp->tp_spa);
+	boolean_t hard = (tp->tp_flags & TRAVERSE_HARD);
+	dsl_dataset_t *ds;
+	int i, err = 0;
+
+	/*
+	 * There are as many taskq threads as arguments, so one is always
+	 * free.
+	 */
+	mutex_enter(&tp->tp_lock);
+	for (i = 0; tp->tp_busy[i]; i++)
+		ASSERT3S(i, <, tp->tp_nargs - 1);
+	tp->tp_busy[i] = B_TRUE;
+	boolean_t skip = (tp->tp_err != 0);
+	mutex_exit(&tp->tp_lock);
+
+	if (!skip) {
+		dsl_pool_config_enter(dp, FTAG);
+		err = dsl_dataset_hold_obj(dp, tpa->tpa_obj, FTAG, &ds);
+		dsl_pool_config_exit(dp, FTAG);
+		if (err == 0) {
+			uint64_t txg = tp->tp_txg_start;
+
+			if (dsl_dataset_phys(ds)->ds_prev_snap_txg > txg)
+				txg = dsl_dataset_phys(ds)->ds_prev_snap_txg;
+			err = traverse_dataset(ds, txg, tp->tp_flags,
+			    tp->tp_func, tp->tp_args[i]);
+			dsl_dataset_rele(ds, FTAG);
+		} else if (hard) {
+			err = 0;
+		}
+	}
+
+	mutex_enter(&tp->tp_lock);
+	tp->tp_busy[i] = B_FALSE;
+	if (tp->tp_err == 0)
+		tp->tp_err = err;
+	mutex_exit(&tp->tp_lock);
+
+	kmem_free(tpa, sizeof (traverse_parallel_arg_t));
+}
+
+/*
+ * Like traverse_pool(), but traverse up to nargs datasets at once.  Each
+ * concurrent traversal calls func with its own element of args, so that
+ * callers can accumulate into unlocked per-thread state and merge it once
+ * this returns.  The MOS is traversed first, with args[0].
+ */
+int
+traverse_pool_parallel(spa_t *spa, uint64_t txg_start, int flags,
+    blkptr_cb_t func, void **args, int nargs)
+{
+	dsl_pool_t *dp = spa_get_dsl(spa);
+	objset_t *mos = dp->dp_meta_objset;
+	boolean_t hard = (flags & TRAVERSE_HARD);
+	traverse_parallel_t tp;
+	taskq_t *tq;
+	int err;
+
+	if (nargs <= 1)
+		return (traverse_pool(spa, txg_start, flags, func, args[0]));
+
+	/* visit the MOS */
+	err = traverse_impl(spa, NULL, 0, spa_get_rootblkptr(spa),
+	    txg_start, NULL, flags, func, args[0]);
+	if (err != 0)
+		return (err);
+
+	mutex_init(&tp.tp_lock, NULL, MUTEX_DEFAULT, NULL);
+	tp.tp_spa = spa;
+	tp.tp_txg_start = txg_start;
+	tp.tp_flags = flags;
+	tp.tp_func = func;
+	tp.tp_args = args;
+	tp.tp_busy = kmem_zalloc(nargs * sizeof (boolean_t), KM_SLEEP);
+	tp.tp_nargs = nargs;
+	tp.tp_err = 0;
+
+	tq = taskq_create("z_traverse", nargs, minclsyspri, nargs, INT_MAX,
+	    TASKQ_PREPOPULATE);
+
+	/* visit each dataset */
+	for (uint64_t obj = 1; err == 0;
+	    err = dmu_object_next(mos, &obj, B_FALSE, txg_start)) {
+		dmu_object_info_t doi;
+
+		err = dmu_object_info(mos, obj, &doi);
+		if (err != 0) {
+			if (hard)
+				continue;
+			break;
+		}
+
+		if (doi.doi_bonus_type == DMU_OT_DSL_DATASET) {
+			traverse_parallel_arg_t *tpa =
+			    kmem_alloc(sizeof (*tpa), KM_SLEEP);
+
+			tpa->tpa_tp = &tp;
+			tpa->tpa_obj = obj;
+			VERIFY3U(taskq_dispatch(tq, traverse_parallel_dataset,
+			    tpa, TQ_SLEEP), !=, TASKQID_INVALID);
+
+			mutex_enter(&tp.tp_lock);
+			err = tp.tp_err;
+			mutex_exit(&tp.tp_lock);
+		}
+	}
+	taskq_wait(tq);
+	taskq_destroy(tq);
+
+	if (err == ESRCH)
+		err = 0;
+	if (err == 0)
+		err = tp.tp_err;
+
+	kmem_free(tp.tp_busy, nargs * sizeof (boolean_t));
+	mutex_destroy(&tp.tp_lock);
+
+	return (err);
+}
+
 EXPORT_SYMBOL(traverse_dataset);
 EXPORT_SYMBOL(traverse_pool);
+EXPORT_SYMBOL(traverse_pool_parallel);
 
 ZFS_MODULE_PARAM(zfs, zfs_, pd_bytes_max, INT, ZMOD_RW,
 	"Max number of bytes to prefetch");
@@ -53,6 +53,7 @@ dmu_tx_stats_t dmu_tx_stats = {
 	{ "dmu_tx_dirty_throttle",	KSTAT_DATA_UINT64 },
 	{ "dmu_tx_dirty_delay",		KSTAT_DATA_UINT64 },
 	{ "dmu_tx_dirty_over_max",	KSTAT_DATA_UINT64 },
+	{ "dmu_tx_dataset_dirty_delay",	KSTAT_DATA_UINT64 },
 	{ "dmu_tx_dirty_frees_delay",	KSTAT_DATA_UINT64 },
 	{ "dmu_tx_wrlog_delay",		KSTAT_DATA_UINT64 },
 	{ "dmu_tx_quota",		KSTAT_DATA_UINT64 },
@@ -914,13 +915,46 @@ static const hrtime_t zfs_delay_max_ns = 100 * MICROSEC; /* 100 milliseconds */
  * ensuring that the appropriate limits are set for the I/O scheduler to reach
  * optimal throughput on the backend storage, and then by changing the value
  * of zfs_delay_scale to increase the steepness of the curve.
+ *
+ * When zfs_dirty_data_dataset_percent is set, the same curve is also
+ * applied to the dirty data of the transaction's own dataset, scaled to
+ * that percentage of zfs_dirty_data_max.  A transaction is delayed by the
+ * larger of the two.  Delays caused by the dataset's own share are
+ * spaced out against the dataset's previous delayed transaction rather
+ * than the pool's, so a heavy writer queues only behind itself.
  */
+static uint64_t
+dmu_tx_dataset_dirty_max(dmu_tx_t *tx)
+{
+	objset_t *os = tx->tx_objset;
+
+	if (zfs_dirty_data_dataset_percent == 0 || os == NULL ||
+	    os->os_dsl_dataset == NULL)
+		return (0);
+
+	return (zfs_dirty_data_max *
+	    MIN(zfs_dirty_data_dataset_percent, 100) / 100);
+}
+
+static boolean_t
+dmu_tx_need_dataset_dirty_delay(dmu_tx_t *tx)
+{
+	uint64_t dirty_max = dmu_tx_dataset_dirty_max(tx);
+
+	if (dirty_max == 0)
+		return (B_FALSE);
+
+	return (dmu_objset_dirty_total(tx->tx_objset) >
+	    dirty_max * zfs_delay_min_dirty_percent / 100);
+}
+
 static void
 dmu_tx_delay(dmu_tx_t *tx, uint64_t dirty)
 {
 	dsl_pool_t *dp = tx->tx_pool;
-	uint64_t delay_min_bytes, wrlog;
-	hrtime_t wakeup, tx_time = 0, now;
+	objset_t *os = tx->tx_objset;
+	uint64_t delay_min_bytes, wrlog, ds_dirty, ds_dirty_max;
+	hrtime_t wakeup, tx_time = 0, ds_time = 0, now;
 
 	/* Calculate minimum transaction time for the dirty data amount. */
 	delay_min_bytes =
@@ -949,9 +983,40 @@ dmu_tx_delay(dmu_tx_t *tx, uint64_t dirty)
 		    (zfs_wrlog_data_max - wrlog), tx_time);
 	}
 
-	if (tx_time == 0)
+	/* Calculate minimum transaction time for this dataset's share. */
+	ds_dirty_max = dmu_tx_dataset_dirty_max(tx);
+	if (ds_dirty_max != 0) {
+		ds_dirty = dmu_objset_dirty_total(os);
+		delay_min_bytes =
+		    ds_dirty_max * zfs_delay_min_dirty_percent / 100;
+		if (ds_dirty >= ds_dirty_max) {
+			ds_time = zfs_delay_max_ns;
+		} else if (ds_dirty > delay_min_bytes) {
+			ds_time = zfs_delay_scale *
+			    (ds_dirty - delay_min_bytes) /
+			    (ds_dirty_max - ds_dirty);
+		}
+	}
+
+	if (tx_time == 0 && ds_time == 0)
 		return;
 
+	if (ds_time > tx_time) {
+		ds_time = MIN(ds_time, zfs_delay_max_ns);
+		now = gethrtime();
+		if (now > tx->tx_start + ds_time)
+			return;
+
+		mutex_enter(&os->os_lock);
+		wakeup = MAX(tx->tx_start + ds_time,
+		    os->os_last_wakeup + ds_time);
+		os->os_last_wakeup = wakeup;
+		mutex_exit(&os->os_lock);
+
+		zfs_sleep_until(wakeup);
+		return;
+	}
+
 	tx_time = MIN(tx_time, zfs_delay_max_ns);
 	now = gethrtime();
 	if (now > tx->tx_start + tx_time)
@@ -1052,6 +1117,13 @@ dmu_tx_try_assign(dmu_tx_t *tx, uint64_t txg_how)
 		return (SET_ERROR(ERESTART));
 	}
 
+	if (!tx->tx_dirty_delayed &&
+	    dmu_tx_need_dataset_dirty_delay(tx)) {
+		tx->tx_wait_dirty = B_TRUE;
+		DMU_TX_STAT_BUMP(dmu_tx_dataset_dirty_delay);
+		return (SET_ERROR(ERESTART));
+	}
+
 	tx->tx_txg = txg_hold_open(tx->tx_pool, &tx->tx_txgh);
 	tx->tx_needassign_txh = NULL;
 
@@ -75,6 +75,7 @@ typedef struct zfetch_stats {
 	kstat_named_t zfetchstat_future;
 	kstat_named_t zfetchstat_stride;
 	kstat_named_t zfetchstat_past;
+	kstat_named_t zfetchstat_backward;
 	kstat_named_t zfetchstat_misses;
 	kstat_named_t zfetchstat_max_streams;
 	kstat_named_t zfetchstat_io_issued;
@@ -86,6 +87,7 @@ static zfetch_stats_t zfetch_stats = {
 	{ "future",			KSTAT_DATA_UINT64 },
 	{ "stride",			KSTAT_DATA_UINT64 },
 	{ "past",			KSTAT_DATA_UINT64 },
+	{ "backward",			KSTAT_DATA_UINT64 },
 	{ "misses",			KSTAT_DATA_UINT64 },
 	{ "max_streams",		KSTAT_DATA_UINT64 },
 	{ "io_issued",			KSTAT_DATA_UINT64 },
@@ -97,6 +99,7 @@ struct {
 	wmsum_t zfetchstat_future;
 	wmsum_t zfetchstat_stride;
 	wmsum_t zfetchstat_past;
+	wmsum_t zfetchstat_backward;
 	wmsum_t zfetchstat_misses;
 	wmsum_t zfetchstat_max_streams;
 	wmsum_t zfetchstat_io_issued;
@@ -126,6 +129,8 @@ zfetch_kstats_update(kstat_t *ksp, int rw)
 	    wmsum_value(&zfetch_sums.zfetchstat_stride);
 	zs->zfetchstat_past.value.ui64 =
 	    wmsum_value(&zfetch_sums.zfetchstat_past);
+	zs->zfetchstat_backward.value.ui64 =
+	    wmsum_value(&zfetch_sums.zfetchstat_backward);
 	zs->zfetchstat_misses.value.ui64 =
 	    wmsum_value(&zfetch_sums.zfetchstat_misses);
 	zs->zfetchstat_max_streams.value.ui64 =
@@ -144,6 +149,7 @@ zfetch_init(void)
 	wmsum_init(&zfetch_sums.zfetchstat_future, 0);
 	wmsum_init(&zfetch_sums.zfetchstat_stride, 0);
 	wmsum_init(&zfetch_sums.zfetchstat_past, 0);
+	wmsum_init(&zfetch_sums.zfetchstat_backward, 0);
 	wmsum_init(&zfetch_sums.zfetchstat_misses, 0);
 	wmsum_init(&zfetch_sums.zfetchstat_max_streams, 0);
 	wmsum_init(&zfetch_sums.zfetchstat_io_issued, 0);
@@ -172,6 +178,7 @@ zfetch_fini(void)
 	wmsum_fini(&zfetch_sums.zfetchstat_future);
 	wmsum_fini(&zfetch_sums.zfetchstat_stride);
 	wmsum_fini(&zfetch_sums.zfetchstat_past);
+	wmsum_fini(&zfetch_sums.zfetchstat_backward);
 	wmsum_fini(&zfetch_sums.zfetchstat_misses);
 	wmsum_fini(&zfetch_sums.zfetchstat_max_streams);
 	wmsum_fini(&zfetch_sums.zfetchstat_io_issued);
@@ -241,10 +248,11 @@ dmu_zfetch_fini(zfetch_t *zf)
  * If there aren't too many active streams already, create one more.
  * In process delete/reuse all streams without hits for zfetch_max_sec_reap.
  * If needed, reuse oldest stream without hits for zfetch_min_sec_reap or ever.
- * The "blkid" argument is the next block that we expect this stream to access.
+ * The "start" argument is the first block of the access creating the stream,
+ * and "blkid" is the next block that we expect this stream to access.
  */
 static void
-dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid)
+dmu_zfetch_stream_create(zfetch_t *zf, uint64_t start, uint64_t blkid)
 {
 	zstream_t *zs, *zs_next, *zs_old = NULL;
 	uint_t now = gethrestime_sec(), t;
@@ -314,6 +322,8 @@ dmu_zfetch_stream_create(zfetch_t *zf, uint64_t blkid)
 reuse:
 	list_insert_head(&zf->zf_stream, zs);
 	zs->zs_blkid = blkid;
+	zs->zs_start = start;
+	zs->zs_backward = B_FALSE;
 	/* Allow immediate stream reuse until first hit. */
 	zs->zs_atime = now - zfetch_min_sec_reap;
 	memset(zs->zs_ranges, 0, sizeof (zs->zs_ranges));
@@ -327,6 +337,15 @@ reuse:
 	zs->zs_more = B_FALSE;
 }
 
+/*
+ * A data prefetch completing for a block the stream has already moved past
+ * means the demand read had to wait for it: the distance covers less than
+ * the I/O latency times the consumer's read rate.  zs_more then lets the
+ * next hit grow the distance beyond zfetch_min_distance.  So the distance
+ * settles at roughly the bandwidth-delay product of the stream: larger on
+ * slow pools, and staying near zfetch_min_distance where prefetches
+ * always arrive in time.
+ */
 static void
 dmu_zfetch_done(void *arg, uint64_t level, uint64_t blkid, boolean_t io_issued)
 {
@@ -517,10 +536,15 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	 * the last block of the previous access, or be equal to it.
 	 */
 	unsigned int dbs = zf->zf_dnode->dn_datablkshift;
-	uint64_t end_blkid = blkid + nblks;
+	unsigned int nbytes, pf_nblks;
+	uint64_t end_blkid = blkid + nblks, pf_start;
 	for (zs = list_head(&zf->zf_stream); zs != NULL;
 	    zs = list_next(&zf->zf_stream, zs)) {
-		if (blkid == zs->zs_blkid) {
+		if (zs->zs_backward) {
+			if (end_blkid == zs->zs_blkid ||
+			    end_blkid == zs->zs_blkid + 1)
+				goto backward;
+		} else if (blkid == zs->zs_blkid) {
 			goto hit;
 		} else if (blkid + 1 == zs->zs_blkid) {
 			blkid++;
@@ -529,6 +553,26 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 		}
 	}
 
+	/*
+	 * Find a new stream whose first access directly follows this one.
+	 * Two such accesses in a row mean that the file is being read from
+	 * the end towards the start, so turn the stream into a backward one.
+	 * Only streams without hits are considered, as a reordered access
+	 * within a forward stream can look the same.
+	 */
+	for (zs = list_head(&zf->zf_stream); zs != NULL;
+	    zs = list_next(&zf->zf_stream, zs)) {
+		if (zs->zs_backward || zs->zs_ipf_dist != 0)
+			continue;
+		if (end_blkid == zs->zs_start ||
+		    end_blkid == zs->zs_start + 1) {
+			zs->zs_backward = B_TRUE;
+			memset(zs->zs_ranges, 0, sizeof (zs->zs_ranges));
+			zs->zs_pf_start = zs->zs_pf_end = blkid;
+			goto backward;
+		}
+	}
+
 	/*
 	 * Find close enough prefetch stream.  Access crossing stream position
 	 * is a hit in its new part.  Access ahead of stream position considered
@@ -540,6 +584,8 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	uint_t t = gethrestime_sec() - zfetch_max_sec_reap;
 	for (zs = list_head(&zf->zf_stream); zs != NULL;
 	    zs = list_next(&zf->zf_stream, zs)) {
+		if (zs->zs_backward)
+			continue;
 		if (blkid > zs->zs_blkid) {
 			if (end_blkid <= zs->zs_blkid + max_reorder) {
 				if (!fetch_data) {
@@ -572,7 +618,7 @@ dmu_zfetch_prepare(zfetch_t *zf, uint64_t blkid, uint64_t nblks,
 	 * stream for it unless we are at the end of file.
 	 */
 	if (end_blkid < maxblkid)
-		dmu_zfetch_stream_create(zf, end_blkid);
+		dmu_zfetch_stream_create(zf, blkid, end_blkid);
 	mutex_exit(&zf->zf_lock);
 	if (!have_lock)
 		rw_exit(&zf->zf_dnode->dn_struct_rwlock);
@@ -613,8 +659,7 @@ out:
 	 * than ~6% of ARC held by active prefetches.  It should help with
 	 * getting out of RAM on some badly mispredicted read patterns.
 	 */
-	unsigned int nbytes = nblks << dbs;
-	unsigned int pf_nblks;
+	nbytes = nblks << dbs;
 	if (fetch_data) {
 		if (unlikely(zs->zs_pf_dist < nbytes))
 			zs->zs_pf_dist = nbytes;
@@ -653,6 +698,7 @@ out:
 	if (zs->zs_ipf_end < zs->zs_pf_end + pf_nblks)
 		zs->zs_ipf_end = zs->zs_pf_end + pf_nblks;
 
+issue:
 	zfs_refcount_add(&zs->zs_refs, NULL);
 	/* Count concurrent callers. */
 	zfs_refcount_add(&zs->zs_callers, NULL);
@@ -661,6 +707,44 @@ out:
 	if (!have_lock)
 		rw_exit(&zf->zf_dnode->dn_struct_rwlock);
 	return (zs);
+
+backward:
+	/*
+	 * The next access of a backward stream is expected to end where this
+	 * one starts.  Only data blocks are prefetched, doubling the distance
+	 * as for forward streams up to zfetch_min_distance, but no further,
+	 * since dmu_zfetch_done() cannot tell if a backward stream is starved.
+	 * zs_pf_start is the lowest block prefetched so far, and
+	 * [zs_pf_start, zs_pf_end) is what dmu_zfetch_run() has yet to issue.
+	 */
+	ZFETCHSTAT_BUMP(zfetchstat_backward);
+	zs->zs_atime = gethrestime_sec();
+	zs->zs_blkid = blkid;
+	if (blkid == 0) {
+		dmu_zfetch_stream_remove(zf, zs);
+		goto out;
+	}
+	if (!fetch_data)
+		goto out;
+
+	nbytes = nblks << dbs;
+	if (unlikely(zs->zs_pf_dist < nbytes))
+		zs->zs_pf_dist = nbytes;
+	else if (zs->zs_pf_dist < zfetch_min_distance &&
+	    (zs->zs_pf_dist < (1 << dbs) ||
+	    aggsum_compare(&zfetch_sums.zfetchstat_io_active,
+	    arc_c_max >> (4 + dbs)) < 0))
+		zs->zs_pf_dist *= 2;
+	if (zs->zs_pf_dist > zfetch_max_distance)
+		zs->zs_pf_dist = zfetch_max_distance;
+	pf_nblks = zs->zs_pf_dist >> dbs;
+	pf_start = (blkid > pf_nblks) ? blkid - pf_nblks : 0;
+	if (pf_start >= zs->zs_pf_start)
+		goto out;
+	if (zs->zs_pf_end == zs->zs_pf_start)
+		zs->zs_pf_end = MIN(zs->zs_pf_start, blkid);
+	zs->zs_pf_start = pf_start;
+	goto issue;
 }
 
 void
@@ -686,7 +770,12 @@ dmu_zfetch_run(zfetch_t *zf, zstream_t *zs, boolean_t missed,
 	}
 
 	mutex_enter(&zf->zf_lock);
-	if (zs->zs_missed) {
+	if (zs->zs_missed && zs->zs_backward) {
+		/* Keep zs_pf_start as the lowest block prefetched. */
+		pf_start = zs->zs_pf_start;
+		pf_end = zs->zs_pf_end;
+		zs->zs_pf_end = zs->zs_pf_start;
+	} else if (zs->zs_missed) {
 		pf_start = zs->zs_pf_start;
 		pf_end = zs->zs_pf_start = zs->zs_pf_end;
 	} else {
@@ -1397,6 +1397,16 @@ dnode_buf_evict_async(void *dbu)
  * EIO    - I/O error when reading the meta dnode dbuf.
  *
  * succeeds even for free dnodes.
+ *
+ * For a dnode that is already instantiated, a hold costs a dbuf hash
+ * lookup of the cached meta-dnode block (under the meta-dnode's
+ * dn_struct_rwlock as reader), a zrl_add() on the dnode's slots, and a
+ * short dn_mtx section to check its state and take the hold.  A separate
+ * lock-free object-to-dnode cache would need deferred reclamation (RCU or
+ * hazard pointers) to be safe against dnode_buf_evict_async(), which the
+ * SPL does not offer on all supported platforms, and would save only the
+ * dbuf lookup: the dbuf hold is what keeps the dnode's backing block,
+ * and so the dnode_t, from being evicted while it is held.
  */
 int
 dnode_hold_impl(objset_t *os, uint64_t object, int flag, int slots,
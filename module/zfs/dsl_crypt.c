@@ -2826,7 +2826,6 @@ spa_do_crypt_abd(boolean_t encrypt, spa_t *spa, const zbookmark_phys_t *zb,
 {
 	int ret;
 	dsl_crypto_key_t *dck = NULL;
-	uint8_t *plainbuf = NULL, *cipherbuf = NULL;
 
 	ASSERT(spa_feature_is_active(spa, SPA_FEATURE_ENCRYPTION));
 
@@ -2837,14 +2836,6 @@ spa_do_crypt_abd(boolean_t encrypt, spa_t *spa, const zbookmark_phys_t *zb,
 		return (ret);
 	}
 
-	if (encrypt) {
-		plainbuf = abd_borrow_buf_copy(pabd, datalen);
-		cipherbuf = abd_borrow_buf(cabd, datalen);
-	} else {
-		plainbuf = abd_borrow_buf(pabd, datalen);
-		cipherbuf = abd_borrow_buf_copy(cabd, datalen);
-	}
-
 	/*
 	 * Both encryption and decryption functions need a salt for key
 	 * generation and an IV. When encrypting a non-dedup block, we
@@ -2863,15 +2854,18 @@ spa_do_crypt_abd(boolean_t encrypt, spa_t *spa, const zbookmark_phys_t *zb,
 		if (ret != 0)
 			goto error;
 	} else if (encrypt && dedup) {
+		void *plainbuf = abd_borrow_buf_copy(pabd, datalen);
+
 		ret = zio_crypt_generate_iv_salt_dedup(&dck->dck_key,
 		    plainbuf, datalen, iv, salt);
+		abd_return_buf(pabd, plainbuf, datalen);
 		if (ret != 0)
 			goto error;
 	}
 
 	/* call lower level function to perform encryption / decryption */
-	ret = zio_do_crypt_data(encrypt, &dck->dck_key, ot, bswap, salt, iv,
-	    mac, datalen, plainbuf, cipherbuf, no_crypt);
+	ret = zio_do_crypt_abd(encrypt, &dck->dck_key, ot, bswap, salt, iv,
+	    mac, datalen, pabd, cabd, no_crypt);
 
 	/*
 	 * Handle injected decryption faults. Unfortunately, we cannot inject
@@ -2884,14 +2878,6 @@ spa_do_crypt_abd(boolean_t encrypt, spa_t *spa, const zbookmark_phys_t *zb,
 	if (ret != 0)
 		goto error;
 
-	if (encrypt) {
-		abd_return_buf(pabd, plainbuf, datalen);
-		abd_return_buf_copy(cabd, cipherbuf, datalen);
-	} else {
-		abd_return_buf_copy(pabd, plainbuf, datalen);
-		abd_return_buf(cabd, cipherbuf, datalen);
-	}
-
 	spa_keystore_dsl_key_rele(spa, dck, FTAG);
 
 	return (0);
@@ -2902,11 +2888,6 @@ error:
 		memset(salt, 0, ZIO_DATA_SALT_LEN);
 		memset(iv, 0, ZIO_DATA_IV_LEN);
 		memset(mac, 0, ZIO_DATA_MAC_LEN);
-		abd_return_buf(pabd, plainbuf, datalen);
-		abd_return_buf_copy(cabd, cipherbuf, datalen);
-	} else {
-		abd_return_buf_copy(pabd, plainbuf, datalen);
-		abd_return_buf(cabd, cipherbuf, datalen);
 	}
 
 	spa_keystore_dsl_key_rele(spa, dck, FTAG);
@@ -1687,9 +1687,9 @@ dsl_dataset_snapshot_check(void *arg, dmu_tx_t *tx)
 	return (rv);
 }
 
-void
-dsl_dataset_snapshot_sync_impl(dsl_dataset_t *ds, const char *snapname,
-    dmu_tx_t *tx)
+static void
+dsl_dataset_snapshot_sync_common(dsl_dataset_t *ds, const char *snapname,
+    boolean_t adjust_count, dmu_tx_t *tx)
 {
 	dsl_pool_t *dp = ds->ds_dir->dd_pool;
 	dmu_buf_t *dbuf;
@@ -1713,7 +1713,10 @@ dsl_dataset_snapshot_sync_impl(dsl_dataset_t *ds, const char *snapname,
 	ASSERT(!txg_list_member(&ds->ds_dir->dd_pool->dp_dirty_datasets,
 	    ds, tx->tx_txg));
 
-	dsl_fs_ss_count_adjust(ds->ds_dir, 1, DD_FIELD_SNAPSHOT_COUNT, tx);
+	if (adjust_count) {
+		dsl_fs_ss_count_adjust(ds->ds_dir, 1, DD_FIELD_SNAPSHOT_COUNT,
+		    tx);
+	}
 
 	/*
 	 * The origin's ds_creation_txg has to be < TXG_INITIAL
@@ -1868,12 +1871,126 @@ dsl_dataset_snapshot_sync_impl(dsl_dataset_t *ds, const char *snapname,
 		spa_history_log_internal_ds(ds->ds_prev, "snapshot", tx, " ");
 }
 
+void
+dsl_dataset_snapshot_sync_impl(dsl_dataset_t *ds, const char *snapname,
+    dmu_tx_t *tx)
+{
+	dsl_dataset_snapshot_sync_common(ds, snapname, B_TRUE, tx);
+}
+
+/*
+ * Snapshot counts are rolled up into every ancestor, so taking a
+ * recursive snapshot of N datasets would otherwise update the count ZAP
+ * of the pool's root dir N times, and of each other dir once per
+ * snapshot below it.  Instead, dsl_dataset_snapshot_sync() records the
+ * dirs it snapshotted (and their ancestors) in a tree ordered deepest
+ * first, and then updates each dir once with the total for its subtree.
+ */
+typedef struct snap_count_node {
+	avl_node_t	scn_node;
+	uint64_t	scn_depth;
+	uint64_t	scn_ddobj;
+	uint64_t	scn_parent_ddobj;
+	int64_t		scn_delta;
+} snap_count_node_t;
+
+static int
+snap_count_compare(const void *arg1, const void *arg2)
+{
+	const snap_count_node_t *s1 = arg1;
+	const snap_count_node_t *s2 = arg2;
+
+	int cmp = TREE_CMP(s2->scn_depth, s1->scn_depth);
+	if (likely(cmp))
+		return (cmp);
+
+	return (TREE_CMP(s1->scn_ddobj, s2->scn_ddobj));
+}
+
+static void
+snap_count_add(avl_tree_t *tree, dsl_dir_t *dd)
+{
+	uint64_t depth = 0;
+	int64_t delta = 1;
+
+	for (dsl_dir_t *pdd = dd->dd_parent; pdd != NULL; pdd = pdd->dd_parent)
+		depth++;
+
+	for (; dd != NULL; dd = dd->dd_parent, depth--) {
+		snap_count_node_t search, *scn;
+		avl_index_t where;
+
+		search.scn_depth = depth;
+		search.scn_ddobj = dd->dd_object;
+		scn = avl_find(tree, &search, &where);
+		if (scn != NULL) {
+			/* All of its ancestors are already in the tree. */
+			scn->scn_delta += delta;
+			return;
+		}
+
+		scn = kmem_zalloc(sizeof (*scn), KM_SLEEP);
+		scn->scn_depth = depth;
+		scn->scn_ddobj = dd->dd_object;
+		if (dd->dd_parent != NULL)
+			scn->scn_parent_ddobj = dd->dd_parent->dd_object;
+		scn->scn_delta = delta;
+		avl_insert(tree, scn, where);
+		delta = 0;
+	}
+}
+
+/*
+ * Apply the counts deepest first, carrying each dir's total up to its
+ * parent.  As in dsl_fs_ss_count_adjust(), a dir whose counts are not
+ * initialized stops the roll-up for the snapshots below it.
+ */
+static void
+snap_count_apply(dsl_pool_t *dp, avl_tree_t *tree, dmu_tx_t *tx)
+{
+	snap_count_node_t *scn;
+	void *cookie = NULL;
+
+	for (scn = avl_first(tree); scn != NULL; scn = AVL_NEXT(tree, scn)) {
+		snap_count_node_t search, *pscn;
+		dsl_dir_t *dd;
+		boolean_t counted;
+
+		if (scn->scn_delta == 0)
+			continue;
+
+		VERIFY0(dsl_dir_hold_obj(dp, scn->scn_ddobj, NULL, FTAG, &dd));
+		counted = dsl_fs_ss_count_adjust_one(dd, scn->scn_delta,
+		    DD_FIELD_SNAPSHOT_COUNT, tx);
+		dsl_dir_rele(dd, FTAG);
+
+		if (!counted || scn->scn_depth == 0)
+			continue;
+
+		search.scn_depth = scn->scn_depth - 1;
+		search.scn_ddobj = scn->scn_parent_ddobj;
+		pscn = avl_find(tree, &search, NULL);
+		VERIFY3P(pscn, !=, NULL);
+		pscn->scn_delta += scn->scn_delta;
+	}
+
+	while ((scn = avl_destroy_nodes(tree, &cookie)) != NULL)
+		kmem_free(scn, sizeof (*scn));
+	avl_destroy(tree);
+}
+
 void
 dsl_dataset_snapshot_sync(void *arg, dmu_tx_t *tx)
 {
 	dsl_dataset_snapshot_arg_t *ddsa = arg;
 	dsl_pool_t *dp = dmu_tx_pool(tx);
 	nvpair_t *pair;
+	avl_tree_t counts;
+	hrtime_t start = gethrtime();
+	uint64_t nsnaps = 0;
+
+	avl_create(&counts, snap_count_compare, sizeof (snap_count_node_t),
+	    offsetof(snap_count_node_t, scn_node));
 
 	for (pair = nvlist_next_nvpair(ddsa->ddsa_snaps, NULL);
 	    pair != NULL; pair = nvlist_next_nvpair(ddsa->ddsa_snaps, pair)) {
@@ -1886,13 +2003,21 @@ dsl_dataset_snapshot_sync(void *arg, dmu_tx_t *tx)
 		(void) strlcpy(dsname, name, atp - name + 1);
 		VERIFY0(dsl_dataset_hold(dp, dsname, FTAG, &ds));
 
-		dsl_dataset_snapshot_sync_impl(ds, atp + 1, tx);
+		snap_count_add(&counts, ds->ds_dir);
+		dsl_dataset_snapshot_sync_common(ds, atp + 1, B_FALSE, tx);
 		if (ddsa->ddsa_props != NULL) {
 			dsl_props_set_sync_impl(ds->ds_prev,
 			    ZPROP_SRC_LOCAL, ddsa->ddsa_props, tx);
 		}
 		dsl_dataset_rele(ds, FTAG);
+		nsnaps++;
 	}
+
+	snap_count_apply(dp, &counts, tx);
+
+	zfs_dbgmsg("txg %llu created %llu snapshots in %llu us",
+	    (u_longlong_t)tx->tx_txg, (u_longlong_t)nsnaps,
+	    (u_longlong_t)NSEC2USEC(gethrtime() - start));
 }
 
 /*
@@ -2265,6 +2390,12 @@ dsl_dataset_sync_done(dsl_dataset_t *ds, dmu_tx_t *tx)
 
 	multilist_destroy(&os->os_synced_dnodes);
 
+	/*
+	 * All dirty data of this txg has been written.  Drop whatever the
+	 * estimates left behind, like dsl_pool_sync() does for the pool.
+	 */
+	(void) atomic_swap_64(&os->os_dirty_pertxg[tx->tx_txg & TXG_MASK], 0);
+
 	if (os->os_encrypted)
 		os->os_next_write_raw[tx->tx_txg & TXG_MASK] = B_FALSE;
 	else
@@ -904,10 +904,6 @@ void
 dsl_fs_ss_count_adjust(dsl_dir_t *dd, int64_t delta, const char *prop,
     dmu_tx_t *tx)
 {
-	int err;
-	objset_t *os = dd->dd_pool->dp_meta_objset;
-	uint64_t count;
-
 	ASSERT(dsl_pool_config_held(dd->dd_pool));
 	ASSERT(dmu_tx_is_syncing(tx));
 	ASSERT(strcmp(prop, DD_FIELD_FILESYSTEM_COUNT) == 0 ||
@@ -930,13 +926,36 @@ dsl_fs_ss_count_adjust(dsl_dir_t *dd, int64_t delta, const char *prop,
 	/*
 	 * If we hit an uninitialized node while recursing up the tree, we can
 	 * stop since we know the counts are not valid on this node and we
-	 * know we shouldn't touch this node's counts. An uninitialized count
-	 * on the node indicates that either the feature has not yet been
-	 * activated or there are no limits on this part of the tree.
+	 * know we shouldn't touch this node's counts.
 	 */
+	if (!dsl_fs_ss_count_adjust_one(dd, delta, prop, tx))
+		return;
+
+	/* Roll up this additional count into our ancestors */
+	if (dd->dd_parent != NULL)
+		dsl_fs_ss_count_adjust(dd->dd_parent, delta, prop, tx);
+}
+
+/*
+ * Adjust the filesystem or snapshot count of the specified dsl_dir_t only,
+ * leaving its parents to the caller.  Returns B_FALSE without changing
+ * anything if the count is uninitialized on this node, which indicates
+ * that either the feature has not yet been activated or there are no
+ * limits on this part of the tree.
+ */
+boolean_t
+dsl_fs_ss_count_adjust_one(dsl_dir_t *dd, int64_t delta, const char *prop,
+    dmu_tx_t *tx)
+{
+	int err;
+	objset_t *os = dd->dd_pool->dp_meta_objset;
+	uint64_t count;
+
+	ASSERT(dmu_tx_is_syncing(tx));
+
 	if (!dsl_dir_is_zapified(dd) || (err = zap_lookup(os, dd->dd_object,
 	    prop, sizeof (count), 1, &count)) == ENOENT)
-		return;
+		return (B_FALSE);
 	VERIFY0(err);
 
 	count += delta;
@@ -946,9 +965,7 @@ dsl_fs_ss_count_adjust(dsl_dir_t *dd, int64_t delta, const char *prop,
 	VERIFY0(zap_update(os, dd->dd_object, prop, sizeof (count), 1, &count,
 	    tx));
 
-	/* Roll up this additional count into our ancestors */
-	if (dd->dd_parent != NULL)
-		dsl_fs_ss_count_adjust(dd->dd_parent, delta, prop, tx);
+	return (B_TRUE);
 }
 
 uint64_t
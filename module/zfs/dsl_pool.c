@@ -125,6 +125,16 @@ static uint_t zfs_dirty_data_sync_percent = 20;
  */
 uint_t zfs_delay_min_dirty_percent = 60;
 
+/*
+ * If non-zero, each dataset may only have this percentage of
+ * zfs_dirty_data_max dirty before its own transactions are delayed, along
+ * a curve of the same shape as the pool-wide one (see dmu_tx_delay()).
+ * A dataset writing heavily is then throttled against its own share,
+ * before it can push the pool as a whole into the delay range and slow
+ * down everyone else.
+ */
+uint_t zfs_dirty_data_dataset_percent = 0;
+
 /*
  * This controls how quickly the delay approaches infinity.
  * Larger values cause it to delay more for a given amount of dirty data.
@@ -573,6 +583,7 @@ dsl_pool_mos_diduse_space(dsl_pool_t *dp,
 static void
 dsl_pool_sync_mos(dsl_pool_t *dp, dmu_tx_t *tx)
 {
+	hrtime_t start = gethrtime();
 	zio_t *zio = zio_root(dp->dp_spa, NULL, NULL, ZIO_FLAG_MUSTSUCCEED);
 	dmu_objset_sync(dp->dp_meta_objset, zio, tx);
 	VERIFY0(zio_wait(zio));
@@ -582,6 +593,9 @@ dsl_pool_sync_mos(dsl_pool_t *dp, dmu_tx_t *tx)
 
 	dprintf_bp(&dp->dp_meta_rootbp, "meta objset rootbp is %s", "");
 	spa_set_rootblkptr(dp->dp_spa, &dp->dp_meta_rootbp);
+
+	dp->dp_spa->spa_sync_phase_nsecs[SPA_SYNC_PHASE_MOS] +=
+	    gethrtime() - start;
 }
 
 static void
@@ -1469,6 +1483,9 @@ ZFS_MODULE_PARAM(zfs, zfs_, wrlog_data_max, U64, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs, zfs_, dirty_data_max_max, U64, ZMOD_RD,
 	"zfs_dirty_data_max upper bound in bytes");
 
+ZFS_MODULE_PARAM(zfs, zfs_, dirty_data_dataset_percent, UINT, ZMOD_RW,
+	"Per-dataset dirty data limit as a percentage of zfs_dirty_data_max");
+
 ZFS_MODULE_PARAM(zfs, zfs_, dirty_data_sync_percent, UINT, ZMOD_RW,
 	"Dirty data txg sync threshold as a percentage of zfs_dirty_data_max");
 
@@ -40,6 +40,7 @@
 #include <sys/arc_impl.h>
 #include <sys/zap.h>
 #include <sys/zio.h>
+#include <sys/blkptr.h>
 #include <sys/zfs_context.h>
 #include <sys/fs/zfs.h>
 #include <sys/zfs_znode.h>
@@ -83,6 +84,14 @@
  * large and contiguous, allowing us to approach sequential I/O throughput
  * even without a fully sorted tree.
  *
+ * The queues live only in memory; they are never spilled to the pool to be
+ * merged later. On very large pools the sorting window is therefore the
+ * memory limit, and the sequentiality of the issued I/O depends on how much
+ * of the pool fits in it. Raising the limit (lowering zfs_scan_mem_lim_fact)
+ * widens the window. Raising zfs_scan_mem_lim_soft_max makes each clearing
+ * pass issue more of the largest extents before metadata scanning resumes,
+ * so the scan alternates less often between the two.
+ *
  * Metadata scanning takes place in dsl_scan_visit(), which is called from
  * dsl_scan_sync() every spa_sync(). If we have either fully scanned all
  * metadata on the pool, or we need to make room in memory because our
@@ -103,6 +112,17 @@
  * Instead, we simply issue gang I/Os as soon as we find them using the legacy
  * algorithm.
  *
+ * Metadata traversal itself is single threaded. The resume point of a scan
+ * is one bookmark (scn_phys.scn_bookmark) in logical order. Suspending the
+ * scan at that bookmark is only correct if every block before it has been
+ * visited, so traversal cannot be split across workers that advance
+ * independently. Doing so would need a bookmark per worker in the on-disk
+ * scan state. The reads of metadata are parallel, though. The prefetch
+ * thread issues them asynchronously, bounded by scn_maxinflight_bytes, and
+ * dsl_scan_prefetch_cb() queues the children of each indirect block as it
+ * arrives. By the time dsl_scan_visitbp() reaches a block, it is normally
+ * already cached.
+ *
  * Backwards compatibility
  *
  * This new algorithm is backwards compatible with the legacy on-disk data
@@ -178,7 +198,7 @@ static uint64_t fill_weight;
 
 /* See dsl_scan_should_clear() for details on the memory limit tunables */
 static const uint64_t zfs_scan_mem_lim_min = 16 << 20;	/* bytes */
-static const uint64_t zfs_scan_mem_lim_soft_max = 128 << 20;	/* bytes */
+static uint64_t zfs_scan_mem_lim_soft_max = 128 << 20;	/* bytes */
 
 
 /* fraction of physmem */
@@ -208,6 +228,8 @@ static const ddt_class_t zfs_scrub_ddt_class_max = DDT_CLASS_DUPLICATE;
 static uint64_t zfs_async_block_max_blocks = UINT64_MAX;
 /* max number of dedup blocks to free in a single TXG */
 static uint64_t zfs_max_async_dedup_frees = 100000;
+/* block pointers per dp_sync_taskq task when freeing, 0 to free inline */
+static uint_t zfs_async_free_batch = 1024;
 
 /* set to disable resilver deferring */
 static int zfs_resilver_disable_defer = B_FALSE;
@@ -323,9 +345,15 @@ struct dsl_scan_io_queue {
 
 	/* members for zio rate limiting */
 	uint64_t	q_maxinflight_bytes;
+	uint64_t	q_maxinflight_cap; /* q_maxinflight_bytes w/o backoff */
 	uint64_t	q_inflight_bytes;
 	kcondvar_t	q_zio_cv; /* used under vd->vdev_scan_io_queue_lock */
 
+	/* token bucket for the scrub_rate_limit pool property */
+	uint64_t	q_rate;		/* bytes per second, 0 if unlimited */
+	int64_t		q_tokens;
+	hrtime_t	q_tokens_ts;
+
 	/* per txg statistics */
 	uint64_t	q_total_seg_size_this_txg;
 	uint64_t	q_segs_this_txg;
@@ -849,9 +877,9 @@ dsl_scan_setup_check(void *arg, dmu_tx_t *tx)
 void
 dsl_scan_setup_sync(void *arg, dmu_tx_t *tx)
 {
-	(void) arg;
+	setup_sync_arg_t *setup_sync_arg = arg;
 	dsl_scan_t *scn = dmu_tx_pool(tx)->dp_scan;
-	pool_scan_func_t *funcp = arg;
+	pool_scan_func_t *funcp = &setup_sync_arg->func;
 	dmu_object_type_t ot = 0;
 	dsl_pool_t *dp = scn->scn_dp;
 	spa_t *spa = dp->dp_spa;
@@ -869,8 +897,11 @@ dsl_scan_setup_sync(void *arg, dmu_tx_t *tx)
 
 	scn->scn_phys.scn_func = *funcp;
 	scn->scn_phys.scn_state = DSS_SCANNING;
-	scn->scn_phys.scn_min_txg = 0;
-	scn->scn_phys.scn_max_txg = tx->tx_txg;
+	/* scn_min_txg is exclusive, txgstart is the first txg to visit */
+	scn->scn_phys.scn_min_txg = setup_sync_arg->txgstart > 0 ?
+	    setup_sync_arg->txgstart - 1 : 0;
+	scn->scn_phys.scn_max_txg = setup_sync_arg->txgend > 0 ?
+	    MIN(setup_sync_arg->txgend, tx->tx_txg) : tx->tx_txg;
 	scn->scn_phys.scn_ddt_class_max = DDT_CLASSES - 1; /* the entire DDT */
 	scn->scn_phys.scn_start_time = gethrestime_sec();
 	scn->scn_phys.scn_errors = 0;
@@ -880,6 +911,7 @@ dsl_scan_setup_sync(void *arg, dmu_tx_t *tx)
 	scn->scn_done_txg = 0;
 	scn->scn_last_checkpoint = 0;
 	scn->scn_checkpointing = B_FALSE;
+	scn->scn_ddt_walk_inited = B_FALSE;
 	spa_scan_stat_init(spa);
 	vdev_scan_stat_init(spa->spa_root_vdev);
 
@@ -965,10 +997,12 @@ dsl_scan_setup_sync(void *arg, dmu_tx_t *tx)
  * error scrub.
  */
 int
-dsl_scan(dsl_pool_t *dp, pool_scan_func_t func)
+dsl_scan(dsl_pool_t *dp, pool_scan_func_t func, uint64_t txgstart,
+    uint64_t txgend)
 {
 	spa_t *spa = dp->dp_spa;
 	dsl_scan_t *scn = dp->dp_scan;
+	setup_sync_arg_t setup_sync_arg;
 
 	/*
 	 * Purge all vdev caches and probe all devices.  We do this here
@@ -1019,8 +1053,13 @@ dsl_scan(dsl_pool_t *dp, pool_scan_func_t func)
 		return (SET_ERROR(err));
 	}
 
+	setup_sync_arg.func = func;
+	setup_sync_arg.txgstart = txgstart;
+	setup_sync_arg.txgend = txgend;
+
 	return (dsl_sync_task(spa_name(spa), dsl_scan_setup_check,
-	    dsl_scan_setup_sync, &func, 0, ZFS_SPACE_CHECK_EXTRA_RESERVED));
+	    dsl_scan_setup_sync, &setup_sync_arg, 0,
+	    ZFS_SPACE_CHECK_EXTRA_RESERVED));
 }
 
 static void
@@ -1147,6 +1186,24 @@ dsl_scan_done(dsl_scan_t *scn, boolean_t complete, dmu_tx_t *tx)
 				spa_event_notify(spa, NULL, NULL,
 				    ESC_ZFS_SCRUB_FINISH);
 			}
+
+			/*
+			 * Every block born before scn_max_txg has now been
+			 * verified (for an incremental scrub, the earlier
+			 * ones were by previous scrubs), so the next
+			 * incremental scrub can start from there.
+			 */
+			if (scn->scn_phys.scn_func == POOL_SCAN_SCRUB &&
+			    scn->scn_phys.scn_min_txg <=
+			    spa->spa_scrubbed_last_txg) {
+				spa->spa_scrubbed_last_txg =
+				    scn->scn_phys.scn_max_txg;
+				VERIFY0(zap_update(dp->dp_meta_objset,
+				    DMU_POOL_DIRECTORY_OBJECT,
+				    DMU_POOL_LAST_SCRUBBED_TXG,
+				    sizeof (uint64_t), 1,
+				    &spa->spa_scrubbed_last_txg, tx));
+			}
 		} else {
 			vdev_dtl_reassess(spa->spa_root_vdev, tx->tx_txg,
 			    0, B_TRUE, B_FALSE);
@@ -2317,6 +2374,7 @@ dsl_scan_visitbp(const blkptr_t *bp, const zbookmark_phys_t *zb,
     dmu_objset_type_t ostype, dmu_tx_t *tx)
 {
 	dsl_pool_t *dp = scn->scn_dp;
+	blkptr_view_t bpv;
 
 	if (dsl_scan_check_suspend(scn, zb))
 		return;
@@ -2326,12 +2384,14 @@ dsl_scan_visitbp(const blkptr_t *bp, const zbookmark_phys_t *zb,
 
 	scn->scn_visited_this_txg++;
 
-	if (BP_IS_HOLE(bp)) {
+	bp_view(bp, &bpv);
+
+	if (bpv.bpv_hole) {
 		scn->scn_holes_this_txg++;
 		return;
 	}
 
-	if (BP_IS_REDACTED(bp)) {
+	if (bpv.bpv_redacted) {
 		ASSERT(dsl_dataset_feature_is_active(ds,
 		    SPA_FEATURE_REDACTED_DATASETS));
 		return;
@@ -2341,18 +2401,18 @@ dsl_scan_visitbp(const blkptr_t *bp, const zbookmark_phys_t *zb,
 	 * Check if this block contradicts any filesystem flags.
 	 */
 	spa_feature_t f = SPA_FEATURE_LARGE_BLOCKS;
-	if (BP_GET_LSIZE(bp) > SPA_OLD_MAXBLOCKSIZE)
+	if (bpv.bpv_lsize > SPA_OLD_MAXBLOCKSIZE)
 		ASSERT(dsl_dataset_feature_is_active(ds, f));
 
-	f = zio_checksum_to_feature(BP_GET_CHECKSUM(bp));
+	f = zio_checksum_to_feature(bpv.bpv_checksum);
 	if (f != SPA_FEATURE_NONE)
 		ASSERT(dsl_dataset_feature_is_active(ds, f));
 
-	f = zio_compress_to_feature(BP_GET_COMPRESS(bp));
+	f = zio_compress_to_feature(bpv.bpv_compress);
 	if (f != SPA_FEATURE_NONE)
 		ASSERT(dsl_dataset_feature_is_active(ds, f));
 
-	if (BP_GET_LOGICAL_BIRTH(bp) <= scn->scn_phys.scn_cur_min_txg) {
+	if (bpv.bpv_logical_birth <= scn->scn_phys.scn_cur_min_txg) {
 		scn->scn_lt_min_this_txg++;
 		return;
 	}
@@ -2378,7 +2438,7 @@ dsl_scan_visitbp(const blkptr_t *bp, const zbookmark_phys_t *zb,
 	 * Don't scan it now unless we need to because something
 	 * under it was modified.
 	 */
-	if (BP_GET_BIRTH(bp) > scn->scn_phys.scn_cur_max_txg) {
+	if (bpv.bpv_birth > scn->scn_phys.scn_cur_max_txg) {
 		scn->scn_gt_max_this_txg++;
 		return;
 	}
@@ -3006,6 +3066,19 @@ dsl_scan_ddt(dsl_scan_t *scn, dmu_tx_t *tx)
 	int error;
 	uint64_t n = 0;
 
+	/*
+	 * The walk only sees entries in the DDT storage objects, so any
+	 * logged entries must be flushed to them first. Wait for that.
+	 */
+	if (!scn->scn_ddt_walk_inited) {
+		ddt_walk_init(scn->scn_dp->dp_spa, tx->tx_txg);
+		scn->scn_ddt_walk_inited = B_TRUE;
+	}
+	if (!ddt_walk_ready(scn->scn_dp->dp_spa)) {
+		scn->scn_suspending = B_TRUE;
+		return;
+	}
+
 	while ((error = ddt_walk(scn->scn_dp->dp_spa, ddb, &dde)) == 0) {
 		ddt_t *ddt;
 
@@ -3019,7 +3092,7 @@ dsl_scan_ddt(dsl_scan_t *scn, dmu_tx_t *tx)
 
 		/* There should be no pending changes to the dedup table */
 		ddt = scn->scn_dp->dp_spa->spa_ddt[ddb->ddb_checksum];
-		ASSERT(avl_first(&ddt->ddt_tree) == NULL);
+		ASSERT(ddt_live_empty(ddt));
 
 		dsl_scan_ddt_entry(scn, ddb->ddb_checksum, &dde, tx);
 		n++;
@@ -3370,16 +3443,96 @@ scan_io_queue_fetch_ext(dsl_scan_io_queue_t *queue)
 	return (addr_rs);
 }
 
+/*
+ * Highest recent synchronous I/O latency among the leaves of a top-level
+ * vdev. See vdev_queue_sync_latency().
+ */
+static hrtime_t
+scan_io_queue_sync_latency(vdev_t *vd)
+{
+	hrtime_t lat = 0;
+
+	if (vd->vdev_ops->vdev_op_leaf)
+		return (vdev_queue_sync_latency(vd));
+
+	for (uint64_t c = 0; c < vd->vdev_children; c++)
+		lat = MAX(lat, scan_io_queue_sync_latency(vd->vdev_child[c]));
+	return (lat);
+}
+
+/*
+ * Back off when foreground I/O is suffering. If the average synchronous
+ * I/O latency on any disk of this vdev exceeds the pool's
+ * scrub_latency_target, halve the number of bytes we keep in flight;
+ * otherwise grow it back by an eighth of the configured limit per batch.
+ * This is the usual additive-increase / multiplicative-decrease scheme,
+ * so scan I/O backs off quickly and creeps back up. A moving average is
+ * used instead of a true high percentile, which would need a histogram
+ * per leaf and would react more slowly.
+ */
+static void
+scan_io_queue_latency_feedback(dsl_scan_io_queue_t *queue)
+{
+	spa_t *spa = queue->q_scn->scn_dp->dp_spa;
+	uint64_t target = spa->spa_scrub_latency_target;
+	uint64_t cap = queue->q_maxinflight_cap;
+
+	ASSERT(MUTEX_HELD(&queue->q_vd->vdev_scan_io_queue_lock));
+
+	if (target == 0) {
+		queue->q_maxinflight_bytes = cap;
+	} else if (scan_io_queue_sync_latency(queue->q_vd) >
+	    MSEC2NSEC(target)) {
+		queue->q_maxinflight_bytes =
+		    MAX(1, queue->q_maxinflight_bytes / 2);
+	} else {
+		queue->q_maxinflight_bytes = MIN(cap,
+		    queue->q_maxinflight_bytes + MAX(1, cap / 8));
+	}
+}
+
+/*
+ * Enforce the scrub_rate_limit pool property with a token bucket. Tokens
+ * accrue at q_rate bytes per second, up to a tenth of a second's worth,
+ * and each issued I/O takes its size. When we run into debt, sleep until
+ * it is paid off, but never more than 100ms at a time so that the caller
+ * gets to check whether it should suspend for the txg.
+ */
+static void
+scan_io_queue_rate_limit(dsl_scan_io_queue_t *queue, uint64_t size)
+{
+	hrtime_t now, elapsed;
+
+	if (queue->q_rate == 0)
+		return;
+
+	now = gethrtime();
+	elapsed = MIN(now - queue->q_tokens_ts, SEC2NSEC(1));
+	queue->q_tokens_ts = now;
+	queue->q_tokens = MIN(queue->q_tokens +
+	    (int64_t)(NSEC2USEC(elapsed) * queue->q_rate / MICROSEC),
+	    (int64_t)(queue->q_rate / 10));
+	queue->q_tokens -= size;
+
+	if (queue->q_tokens < 0) {
+		hrtime_t wait = USEC2NSEC(-queue->q_tokens * MICROSEC /
+		    (int64_t)queue->q_rate);
+		zfs_sleep_until(now + MIN(wait, MSEC2NSEC(100)));
+	}
+}
+
 static void
 scan_io_queues_run_one(void *arg)
 {
 	dsl_scan_io_queue_t *queue = arg;
 	kmutex_t *q_lock = &queue->q_vd->vdev_scan_io_queue_lock;
+	spa_t *spa = queue->q_scn->scn_dp->dp_spa;
 	boolean_t suspended = B_FALSE;
 	range_seg_t *rs;
 	scan_io_t *sio;
 	zio_t *zio;
 	list_t sio_list;
+	uint64_t ndata;
 
 	ASSERT(queue->q_scn->scn_is_sorted);
 
@@ -3390,9 +3543,13 @@ scan_io_queues_run_one(void *arg)
 	mutex_enter(q_lock);
 	queue->q_zio = zio;
 
-	/* Calculate maximum in-flight bytes for this vdev. */
-	queue->q_maxinflight_bytes = MAX(1, zfs_scan_vdev_limit *
-	    (vdev_get_ndisks(queue->q_vd) - vdev_get_nparity(queue->q_vd)));
+	/* Calculate maximum in-flight bytes and issue rate for this vdev. */
+	ndata = vdev_get_ndisks(queue->q_vd) - vdev_get_nparity(queue->q_vd);
+	queue->q_maxinflight_bytes = MAX(1, zfs_scan_vdev_limit * ndata);
+	queue->q_maxinflight_cap = queue->q_maxinflight_bytes;
+	queue->q_rate = spa->spa_scrub_rate_limit * MAX(ndata, 1);
+	queue->q_tokens = 0;
+	queue->q_tokens_ts = gethrtime();
 
 	/* reset per-queue scan statistics for this txg */
 	queue->q_total_seg_size_this_txg = 0;
@@ -3431,6 +3588,7 @@ scan_io_queues_run_one(void *arg)
 			 * we can be sure that our trees will remain exactly
 			 * as we left them.
 			 */
+			scan_io_queue_latency_feedback(queue);
 			mutex_exit(q_lock);
 			suspended = scan_io_queue_issue(queue, &sio_list);
 			mutex_enter(q_lock);
@@ -3538,6 +3696,108 @@ dsl_scan_async_block_should_pause(dsl_scan_t *scn)
 	    spa_shutting_down(scn->scn_dp->dp_spa));
 }
 
+/*
+ * Freeing blocks from the free bpobj and the bptree is bound by the CPU
+ * cost of zio_free_sync() (the ARC, scan queue and metaslab updates for
+ * each block) rather than by the traversal itself, which already reads
+ * ahead. The traversal has to stay serial so that it can stop and resume
+ * at a bookmark, but the frees it finds are independent of each other, so
+ * they are collected into batches that are freed on dp_sync_taskq while
+ * the traversal carries on, and whose metaslab updates are applied as
+ * coalesced extents through a metaslab free batch. Space accounting for
+ * dp_free_dir is summed up and applied once by dsl_scan_free_flush().
+ */
+typedef struct dsl_scan_free_batch {
+	zio_t		*sfb_pio;
+	spa_t		*sfb_spa;
+	uint64_t	sfb_txg;
+	uint_t		sfb_size;
+	uint_t		sfb_count;
+	blkptr_t	sfb_bps[];
+} dsl_scan_free_batch_t;
+
+static void
+dsl_scan_free_batch_task(void *arg)
+{
+	dsl_scan_free_batch_t *sfb = arg;
+	metaslab_free_batch_t *mfb =
+	    metaslab_free_batch_create(sfb->sfb_spa, sfb->sfb_txg);
+
+	for (uint_t i = 0; i < sfb->sfb_count; i++) {
+		zio_nowait(zio_free_sync_batch(sfb->sfb_pio, sfb->sfb_spa,
+		    sfb->sfb_txg, &sfb->sfb_bps[i], 0, mfb));
+	}
+	metaslab_free_batch_destroy(mfb);
+	vmem_free(sfb, offsetof(dsl_scan_free_batch_t,
+	    sfb_bps[sfb->sfb_size]));
+}
+
+static void
+dsl_scan_free_batch_dispatch(dsl_scan_t *scn)
+{
+	dsl_scan_free_batch_t *sfb = scn->scn_free_batch;
+
+	if (sfb == NULL)
+		return;
+
+	VERIFY3U(taskq_dispatch(scn->scn_dp->dp_sync_taskq,
+	    dsl_scan_free_batch_task, sfb, TQ_SLEEP), !=, TASKQID_INVALID);
+	scn->scn_free_batch = NULL;
+	scn->scn_free_dispatched = B_TRUE;
+}
+
+static void
+dsl_scan_free_bp(dsl_scan_t *scn, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	dsl_scan_free_batch_t *sfb = scn->scn_free_batch;
+	uint_t size = MIN(zfs_async_free_batch, 16384);
+
+	if (sfb == NULL && size == 0) {
+		zio_nowait(zio_free_sync(scn->scn_zio_root,
+		    scn->scn_dp->dp_spa, dmu_tx_get_txg(tx), bp, 0));
+		return;
+	}
+
+	if (sfb == NULL) {
+		sfb = vmem_alloc(offsetof(dsl_scan_free_batch_t,
+		    sfb_bps[size]), KM_SLEEP);
+		sfb->sfb_pio = scn->scn_zio_root;
+		sfb->sfb_spa = scn->scn_dp->dp_spa;
+		sfb->sfb_txg = dmu_tx_get_txg(tx);
+		sfb->sfb_size = size;
+		sfb->sfb_count = 0;
+		scn->scn_free_batch = sfb;
+	}
+
+	sfb->sfb_bps[sfb->sfb_count++] = *bp;
+	if (sfb->sfb_count == sfb->sfb_size)
+		dsl_scan_free_batch_dispatch(scn);
+}
+
+/*
+ * Wait for all batched frees to be issued and apply their space accounting.
+ * Must be called before waiting on scn_zio_root.
+ */
+static void
+dsl_scan_free_flush(dsl_scan_t *scn, dmu_tx_t *tx)
+{
+	dsl_scan_free_batch_dispatch(scn);
+	if (scn->scn_free_dispatched) {
+		taskq_wait(scn->scn_dp->dp_sync_taskq);
+		scn->scn_free_dispatched = B_FALSE;
+	}
+
+	if (scn->scn_free_used != 0 || scn->scn_free_comp != 0 ||
+	    scn->scn_free_uncomp != 0) {
+		dsl_dir_diduse_space(tx->tx_pool->dp_free_dir, DD_USED_HEAD,
+		    scn->scn_free_used, scn->scn_free_comp,
+		    scn->scn_free_uncomp, tx);
+		scn->scn_free_used = 0;
+		scn->scn_free_comp = 0;
+		scn->scn_free_uncomp = 0;
+	}
+}
+
 static int
 dsl_scan_free_block_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
 {
@@ -3549,11 +3809,10 @@ dsl_scan_free_block_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
 			return (SET_ERROR(ERESTART));
 	}
 
-	zio_nowait(zio_free_sync(scn->scn_zio_root, scn->scn_dp->dp_spa,
-	    dmu_tx_get_txg(tx), bp, 0));
-	dsl_dir_diduse_space(tx->tx_pool->dp_free_dir, DD_USED_HEAD,
-	    -bp_get_dsize_sync(scn->scn_dp->dp_spa, bp),
-	    -BP_GET_PSIZE(bp), -BP_GET_UCSIZE(bp), tx);
+	dsl_scan_free_bp(scn, bp, tx);
+	scn->scn_free_used -= bp_get_dsize_sync(scn->scn_dp->dp_spa, bp);
+	scn->scn_free_comp -= BP_GET_PSIZE(bp);
+	scn->scn_free_uncomp -= BP_GET_UCSIZE(bp);
 	scn->scn_visited_this_txg++;
 	if (BP_GET_DEDUP(bp))
 		scn->scn_dedup_frees_this_txg++;
@@ -3745,6 +4004,7 @@ dsl_process_async_destroys(dsl_pool_t *dp, dmu_tx_t *tx)
 		    NULL, ZIO_FLAG_MUSTSUCCEED);
 		err = bpobj_iterate(&dp->dp_free_bpobj,
 		    bpobj_dsl_scan_free_block_cb, scn, tx);
+		dsl_scan_free_flush(scn, tx);
 		VERIFY0(zio_wait(scn->scn_zio_root));
 		scn->scn_zio_root = NULL;
 
@@ -3759,6 +4019,7 @@ dsl_process_async_destroys(dsl_pool_t *dp, dmu_tx_t *tx)
 		    NULL, ZIO_FLAG_MUSTSUCCEED);
 		err = bptree_iterate(dp->dp_meta_objset,
 		    dp->dp_bptree_obj, B_TRUE, dsl_scan_free_block_cb, scn, tx);
+		dsl_scan_free_flush(scn, tx);
 		VERIFY0(zio_wait(scn->scn_zio_root));
 		scn->scn_zio_root = NULL;
 
@@ -4283,13 +4544,18 @@ dsl_scan_sync(dsl_pool_t *dp, dmu_tx_t *tx)
 	 */
 	if (dsl_scan_restarting(scn, tx) ||
 	    (spa->spa_resilver_deferred && zfs_resilver_disable_defer)) {
-		pool_scan_func_t func = POOL_SCAN_SCRUB;
+		setup_sync_arg_t setup_sync_arg = {
+			.func = POOL_SCAN_SCRUB,
+			.txgstart = 0,
+			.txgend = 0,
+		};
 		dsl_scan_done(scn, B_FALSE, tx);
 		if (vdev_resilver_needed(spa->spa_root_vdev, NULL, NULL))
-			func = POOL_SCAN_RESILVER;
+			setup_sync_arg.func = POOL_SCAN_RESILVER;
 		zfs_dbgmsg("restarting scan func=%u on %s txg=%llu",
-		    func, dp->dp_spa->spa_name, (longlong_t)tx->tx_txg);
-		dsl_scan_setup_sync(&func, tx);
+		    setup_sync_arg.func, dp->dp_spa->spa_name,
+		    (longlong_t)tx->tx_txg);
+		dsl_scan_setup_sync(&setup_sync_arg, tx);
 	}
 
 	/*
@@ -4843,6 +5109,8 @@ scan_exec_io(dsl_pool_t *dp, const blkptr_t *bp, int zio_flags,
 	} else {
 		kmutex_t *q_lock = &queue->q_vd->vdev_scan_io_queue_lock;
 
+		scan_io_queue_rate_limit(queue, size);
+
 		ASSERT3U(queue->q_maxinflight_bytes, >, 0);
 		mutex_enter(q_lock);
 		while (queue->q_inflight_bytes >= queue->q_maxinflight_bytes)
@@ -5231,6 +5499,9 @@ ZFS_MODULE_PARAM(zfs, zfs_, async_block_max_blocks, U64, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs, zfs_, max_async_dedup_frees, U64, ZMOD_RW,
 	"Max number of dedup blocks freed in one txg");
 
+ZFS_MODULE_PARAM(zfs, zfs_, async_free_batch, UINT, ZMOD_RW,
+	"Block pointers per sync taskq task when freeing, 0 to free inline");
+
 ZFS_MODULE_PARAM(zfs, zfs_, free_bpobj_enabled, INT, ZMOD_RW,
 	"Enable processing of the free_bpobj");
 
@@ -5255,6 +5526,9 @@ ZFS_MODULE_PARAM(zfs, zfs_, scan_max_ext_gap, U64, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs, zfs_, scan_mem_lim_soft_fact, UINT, ZMOD_RW,
 	"Fraction of hard limit used as soft limit");
 
+ZFS_MODULE_PARAM(zfs, zfs_, scan_mem_lim_soft_max, U64, ZMOD_RW,
+	"Max distance in bytes between scan hard and soft memory limits");
+
 ZFS_MODULE_PARAM(zfs, zfs_, scan_strict_mem_lim, INT, ZMOD_RW,
 	"Tunable to attempt to reduce lock contention");
 
@@ -38,13 +38,14 @@
 
 #include <sys/zfs_context.h>
 #include <sys/zio_compress.h>
+#include <zfs_fletcher.h>
 
 static int real_LZ4_compress(const char *source, char *dest, int isize,
-    int osize);
+    int osize, zio_compress_cksum_t *zcc);
 static int LZ4_compressCtx(void *ctx, const char *source, char *dest,
-    int isize, int osize);
+    int isize, int osize, zio_compress_cksum_t *zcc);
 static int LZ4_compress64kCtx(void *ctx, const char *source, char *dest,
-    int isize, int osize);
+    int isize, int osize, zio_compress_cksum_t *zcc);
 
 /* See lz4.c */
 int LZ4_uncompress_unknownOutputSize(const char *source, char *dest,
@@ -52,18 +53,17 @@ int LZ4_uncompress_unknownOutputSize(const char *source, char *dest,
 
 static kmem_cache_t *lz4_cache;
 
-size_t
-lz4_compress_zfs(void *s_start, void *d_start, size_t s_len,
-    size_t d_len, int n)
+static size_t
+lz4_compress_impl(void *s_start, void *d_start, size_t s_len,
+    size_t d_len, zio_compress_cksum_t *zcc)
 {
-	(void) n;
 	uint32_t bufsiz;
 	char *dest = d_start;
 
 	ASSERT(d_len >= sizeof (bufsiz));
 
 	bufsiz = real_LZ4_compress(s_start, &dest[sizeof (bufsiz)], s_len,
-	    d_len - sizeof (bufsiz));
+	    d_len - sizeof (bufsiz), zcc);
 
 	/* Signal an error if the compression routine returned zero. */
 	if (bufsiz == 0)
@@ -77,9 +77,40 @@ lz4_compress_zfs(void *s_start, void *d_start, size_t s_len,
 	 */
 	*(uint32_t *)dest = BE_32(bufsiz);
 
+	/*
+	 * The running checksum started after the size word, which is the
+	 * same as starting from a zero word. zio_compress_cksum_finish()
+	 * adds its real value in once the final length is known.
+	 */
+	if (zcc != NULL) {
+		zcc->zcc_head = *(uint32_t *)dest;
+		zcc->zcc_len += sizeof (bufsiz);
+	}
+
 	return (bufsiz + sizeof (bufsiz));
 }
 
+size_t
+lz4_compress_zfs(void *s_start, void *d_start, size_t s_len,
+    size_t d_len, int n)
+{
+	(void) n;
+	return (lz4_compress_impl(s_start, d_start, s_len, d_len, NULL));
+}
+
+/*
+ * As lz4_compress_zfs(), but also checksumming the output with fletcher4
+ * while it is written. On success, zcc holds the checksum of the first
+ * zcc_len bytes of d_start; see zio_compress_data_cksum().
+ */
+size_t
+lz4_compress_cksum(void *s_start, void *d_start, size_t s_len,
+    size_t d_len, zio_compress_cksum_t *zcc)
+{
+	memset(zcc, 0, sizeof (*zcc));
+	return (lz4_compress_impl(s_start, d_start, s_len, d_len, zcc));
+}
+
 int
 lz4_decompress_zfs(void *s_start, void *d_start, size_t s_len,
     size_t d_len, int n)
@@ -467,11 +498,36 @@ LZ4_NbCommonBytes(register U32 val)
 
 #endif
 
+/*
+ * When checksumming while compressing, output is folded into the running
+ * fletcher4 in LZ4_CKSUM_STEP pieces, which are still in L1 when they are
+ * read back. Each piece also pays for an FPU save/restore in the SIMD
+ * fletcher4 implementations, so it shouldn't be much smaller than this.
+ */
+#define	LZ4_CKSUM_STEP	(16 * 1024)
+
+/*
+ * Everything before op is final once a match has been encoded, so it can be
+ * checksummed.
+ */
+static inline void
+LZ4_cksum_update(zio_compress_cksum_t *zcc, char *dest, const BYTE *op)
+{
+	size_t len = P2ALIGN_TYPED((size_t)(op - (BYTE *)dest) - zcc->zcc_len,
+	    LZ4_CKSUM_STEP, size_t);
+
+	if (len != 0) {
+		(void) fletcher_4_incremental_native(dest + zcc->zcc_len, len,
+		    &zcc->zcc_cksum);
+		zcc->zcc_len += len;
+	}
+}
+
 /* Compression functions */
 
 static int
 LZ4_compressCtx(void *ctx, const char *source, char *dest, int isize,
-    int osize)
+    int osize, zio_compress_cksum_t *zcc)
 {
 	struct refTables *srt = (struct refTables *)ctx;
 	HTYPE *HashTable = (HTYPE *) (srt->hashTable);
@@ -604,6 +660,9 @@ LZ4_compressCtx(void *ctx, const char *source, char *dest, int isize,
 		} else
 			*token += len;
 
+		if (zcc != NULL)
+			LZ4_cksum_update(zcc, dest, op);
+
 		/* Test end of chunk */
 		if (ip > mflimit) {
 			anchor = ip;
@@ -661,7 +720,7 @@ LZ4_compressCtx(void *ctx, const char *source, char *dest, int isize,
 
 static int
 LZ4_compress64kCtx(void *ctx, const char *source, char *dest, int isize,
-    int osize)
+    int osize, zio_compress_cksum_t *zcc)
 {
 	struct refTables *srt = (struct refTables *)ctx;
 	U16 *HashTable = (U16 *) (srt->hashTable);
@@ -792,6 +851,9 @@ LZ4_compress64kCtx(void *ctx, const char *source, char *dest, int isize,
 		} else
 			*token += len;
 
+		if (zcc != NULL)
+			LZ4_cksum_update(zcc, dest, op);
+
 		/* Test end of chunk */
 		if (ip > mflimit) {
 			anchor = ip;
@@ -837,7 +899,8 @@ LZ4_compress64kCtx(void *ctx, const char *source, char *dest, int isize,
 }
 
 static int
-real_LZ4_compress(const char *source, char *dest, int isize, int osize)
+real_LZ4_compress(const char *source, char *dest, int isize, int osize,
+    zio_compress_cksum_t *zcc)
 {
 	void *ctx;
 	int result;
@@ -855,14 +918,240 @@ real_LZ4_compress(const char *source, char *dest, int isize, int osize)
 	memset(ctx, 0, sizeof (struct refTables));
 
 	if (isize < LZ4_64KLIMIT)
-		result = LZ4_compress64kCtx(ctx, source, dest, isize, osize);
+		result = LZ4_compress64kCtx(ctx, source, dest, isize, osize,
+		    zcc);
 	else
-		result = LZ4_compressCtx(ctx, source, dest, isize, osize);
+		result = LZ4_compressCtx(ctx, source, dest, isize, osize, zcc);
 
 	kmem_cache_free(lz4_cache, ctx);
 	return (result);
 }
 
+/*
+ * Decompression from an ABD. The compressed stream is fed to a resumable
+ * decoder one ABD chunk at a time, so a scatter ABD never has to be copied
+ * into a linear buffer first. The output is linear, so matches are copied
+ * straight out of it.
+ */
+typedef enum {
+	LZ4_STREAM_TOKEN,
+	LZ4_STREAM_LITLEN,
+	LZ4_STREAM_LITERALS,
+	LZ4_STREAM_OFFSET_LO,
+	LZ4_STREAM_OFFSET_HI,
+	LZ4_STREAM_MATCHLEN,
+} lz4_stream_state_t;
+
+typedef struct lz4_stream {
+	lz4_stream_state_t	ls_state;
+	uint8_t			*ls_dst;
+	uint8_t			*ls_op;
+	uint8_t			*ls_oend;
+	size_t			ls_lit;
+	size_t			ls_mlen;
+	size_t			ls_off;
+} lz4_stream_t;
+
+/*
+ * Copy a match of len bytes from off bytes back in the output. Matches may
+ * overlap their own output, in which case the last off bytes repeat.
+ */
+static inline void
+lz4_stream_copy_match(uint8_t *op, size_t off, size_t len, uint8_t *oend)
+{
+	const uint8_t *ref = op - off;
+	uint8_t *end = op + len;
+
+	if (off >= 16 && (size_t)(oend - op) >= len + 16) {
+		do {
+			memcpy(op, ref, 16);
+			op += 16;
+			ref += 16;
+		} while (op < end);
+	} else if (off >= len) {
+		memcpy(op, ref, len);
+	} else {
+		/* Overlapping: double the repeated pattern on each copy */
+		while (op < end) {
+			size_t n = MIN((size_t)(op - ref), (size_t)(end - op));
+			memcpy(op, ref, n);
+			op += n;
+		}
+	}
+}
+
+static int
+lz4_stream_match(lz4_stream_t *ls)
+{
+	size_t len = ls->ls_mlen + MINMATCH;
+
+	if (ls->ls_off == 0 || ls->ls_off > (size_t)(ls->ls_op - ls->ls_dst) ||
+	    len > (size_t)(ls->ls_oend - ls->ls_op))
+		return (1);
+
+	lz4_stream_copy_match(ls->ls_op, ls->ls_off, len, ls->ls_oend);
+	ls->ls_op += len;
+	ls->ls_state = LZ4_STREAM_TOKEN;
+	return (0);
+}
+
+/*
+ * Decode whole sequences that lie entirely within this chunk, without
+ * going through the state machine. Stops at the first sequence that
+ * crosses the end of the chunk, which is always the case for the final
+ * sequence of the stream since it has no match. Returns NULL on a
+ * corrupt stream.
+ */
+static const uint8_t *
+lz4_stream_fast(lz4_stream_t *ls, const uint8_t *ip, const uint8_t *iend)
+{
+	uint8_t *op = ls->ls_op;
+	uint8_t *oend = ls->ls_oend;
+
+	while (ip < iend) {
+		const uint8_t *p = ip;
+		size_t lit = *p >> ML_BITS;
+		size_t mlen = *p++ & ML_MASK;
+		size_t off;
+		uint8_t b;
+
+		if (lit == RUN_MASK) {
+			do {
+				if (p == iend)
+					goto out;
+				b = *p++;
+				lit += b;
+			} while (b == 255);
+		}
+		if ((size_t)(iend - p) < lit + 2)
+			goto out;
+		const uint8_t *litp = p;
+		p += lit;
+		off = p[0] | (p[1] << 8);
+		p += 2;
+		if (mlen == ML_MASK) {
+			do {
+				if (p == iend)
+					goto out;
+				b = *p++;
+				mlen += b;
+			} while (b == 255);
+		}
+		mlen += MINMATCH;
+
+		if (lit + mlen > (size_t)(oend - op))
+			return (NULL);
+		if (lit <= 16 && (size_t)(oend - op) >= 16 &&
+		    (size_t)(iend - litp) >= 16)
+			memcpy(op, litp, 16);
+		else
+			memcpy(op, litp, lit);
+		op += lit;
+
+		if (off == 0 || off > (size_t)(op - ls->ls_dst))
+			return (NULL);
+		lz4_stream_copy_match(op, off, mlen, oend);
+		op += mlen;
+		ip = p;
+	}
+out:
+	ls->ls_op = op;
+	return (ip);
+}
+
+static int
+lz4_stream_cb(void *buf, size_t size, void *private)
+{
+	lz4_stream_t *ls = private;
+	const uint8_t *ip = buf;
+	const uint8_t *iend = ip + size;
+	size_t n;
+
+	while (ip < iend) {
+		switch (ls->ls_state) {
+		case LZ4_STREAM_TOKEN:
+			ip = lz4_stream_fast(ls, ip, iend);
+			if (ip == NULL)
+				return (1);
+			if (ip == iend)
+				break;
+			ls->ls_lit = *ip >> ML_BITS;
+			ls->ls_mlen = *ip++ & ML_MASK;
+			if (ls->ls_lit == RUN_MASK)
+				ls->ls_state = LZ4_STREAM_LITLEN;
+			else if (ls->ls_lit != 0)
+				ls->ls_state = LZ4_STREAM_LITERALS;
+			else
+				ls->ls_state = LZ4_STREAM_OFFSET_LO;
+			break;
+		case LZ4_STREAM_LITLEN:
+			ls->ls_lit += *ip;
+			if (*ip++ != 255)
+				ls->ls_state = LZ4_STREAM_LITERALS;
+			break;
+		case LZ4_STREAM_LITERALS:
+			n = MIN(ls->ls_lit, (size_t)(iend - ip));
+			if (n > (size_t)(ls->ls_oend - ls->ls_op))
+				return (1);
+			memcpy(ls->ls_op, ip, n);
+			ls->ls_op += n;
+			ip += n;
+			ls->ls_lit -= n;
+			if (ls->ls_lit == 0)
+				ls->ls_state = LZ4_STREAM_OFFSET_LO;
+			break;
+		case LZ4_STREAM_OFFSET_LO:
+			ls->ls_off = *ip++;
+			ls->ls_state = LZ4_STREAM_OFFSET_HI;
+			break;
+		case LZ4_STREAM_OFFSET_HI:
+			ls->ls_off |= (size_t)*ip++ << 8;
+			if (ls->ls_mlen == ML_MASK)
+				ls->ls_state = LZ4_STREAM_MATCHLEN;
+			else if (lz4_stream_match(ls) != 0)
+				return (1);
+			break;
+		case LZ4_STREAM_MATCHLEN:
+			ls->ls_mlen += *ip;
+			if (*ip++ != 255 && lz4_stream_match(ls) != 0)
+				return (1);
+			break;
+		}
+	}
+
+	return (0);
+}
+
+int
+lz4_decompress_abd(abd_t *src, void *d_start, size_t s_len, size_t d_len,
+    uint8_t *level)
+{
+	(void) level;
+	uint32_t bufsiz;
+	lz4_stream_t ls = {
+		.ls_state = LZ4_STREAM_TOKEN,
+		.ls_dst = d_start,
+		.ls_op = d_start,
+		.ls_oend = (uint8_t *)d_start + d_len,
+	};
+
+	if (s_len < sizeof (bufsiz))
+		return (1);
+	abd_copy_to_buf(&bufsiz, src, sizeof (bufsiz));
+	bufsiz = BE_32(bufsiz);
+
+	/* invalid compressed buffer size encoded at start */
+	if (bufsiz + sizeof (bufsiz) > s_len)
+		return (1);
+
+	if (abd_iterate_func(src, sizeof (bufsiz), bufsiz, lz4_stream_cb,
+	    &ls) != 0)
+		return (1);
+
+	/* A valid stream always ends with the literals of its last sequence */
+	return (ls.ls_state != LZ4_STREAM_OFFSET_LO);
+}
+
 void
 lz4_init(void)
 {
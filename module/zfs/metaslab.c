@@ -39,6 +39,7 @@
 #include <sys/vdev_indirect_mapping.h>
 #include <sys/zap.h>
 #include <sys/btree.h>
+#include <cityhash.h>
 
 #define	GANG_ALLOCATION(flags) \
 	((flags) & (METASLAB_GANG_CHILD | METASLAB_GANG_HEADER))
@@ -148,6 +149,14 @@ static uint_t zfs_mg_fragmentation_threshold = 95;
  */
 static uint_t zfs_metaslab_fragmentation_threshold = 70;
 
+/*
+ * If nonzero, metaslabs at least this fragmented are drained: allocations
+ * pass them over (unless trying hard) for as long as their group as a whole
+ * is less fragmented than this, so the blocks still in them are only ever
+ * freed and the holes between them merge back into large free segments.
+ */
+static uint_t zfs_metaslab_drain_fragmentation = 0;
+
 /*
  * When set will load all metaslabs when pool is first opened.
  */
@@ -226,6 +235,16 @@ uint_t metaslab_preload_limit = 10;
  */
 static int metaslab_preload_enabled = B_TRUE;
 
+/*
+ * If nonzero, metaslab_group_preload() forecasts how much space the group
+ * will allocate over this many txgs, from the recent allocation rate, and
+ * keeps preloading metaslabs past metaslab_preload_limit (up to
+ * METASLAB_PRELOAD_FORECAST_MAX times as many) until the free segments they
+ * hold that are big enough for the recent average allocation cover it.
+ */
+static uint_t metaslab_preload_forecast_txgs = 4;
+#define	METASLAB_PRELOAD_FORECAST_MAX	4
+
 /*
  * Enable/disable fragmentation weighting on metaslabs.
  */
@@ -321,6 +340,23 @@ static const uint32_t metaslab_by_size_min_shift = 14;
  */
 static int zfs_metaslab_try_hard_before_gang = B_FALSE;
 
+/*
+ * If nonzero, an allocator that allocates a block in syncing context also
+ * carves an extent of this size out of the same metaslab. Later blocks of up
+ * to 1/8th of the extent allocated for the same write stream (objset, object
+ * and level) by the same allocator in the same txg are taken from the extent
+ * without the group and metaslab locks, which are otherwise shared by
+ * everything mapped to the allocator. What is left of the extent is returned
+ * to the metaslab before it syncs. Not used for ZIL blocks, which are
+ * allocated outside syncing context.
+ *
+ * Each time a stream uses up its extent within a txg the next one is twice
+ * as big, up to zfs_metaslab_carve_max_size, so a large sequential writer
+ * ends up laying out its blocks in a few long runs.
+ */
+static uint_t zfs_metaslab_carve_size = 0;
+static uint_t zfs_metaslab_carve_max_size = 16 << 20;
+
 /*
  * When not trying hard, we only consider the best zfs_metaslab_find_max_tries
  * metaslabs.  This improves performance, especially when there are many
@@ -347,6 +383,8 @@ static uint64_t metaslab_weight_from_range_tree(metaslab_t *msp);
 static void metaslab_flush_update(metaslab_t *, dmu_tx_t *);
 static unsigned int metaslab_idx_func(multilist_t *, void *);
 static void metaslab_evict(metaslab_t *, uint64_t);
+static void metaslab_carve_return(metaslab_group_allocator_t *,
+    metaslab_carve_t *);
 static void metaslab_rt_add(range_tree_t *rt, range_seg_t *rs, void *arg);
 kmem_cache_t *metaslab_alloc_trace_cache;
 
@@ -355,6 +393,13 @@ typedef struct metaslab_stats {
 	kstat_named_t metaslabstat_reload_tree;
 	kstat_named_t metaslabstat_too_many_tries;
 	kstat_named_t metaslabstat_try_hard;
+	kstat_named_t metaslabstat_load_stalls;
+	kstat_named_t metaslabstat_load_stall_us;
+	kstat_named_t metaslabstat_preload_forecast_extra;
+	kstat_named_t metaslabstat_forecast_txgs;
+	kstat_named_t metaslabstat_forecast_alloc_bytes;
+	kstat_named_t metaslabstat_forecast_error_bytes;
+	kstat_named_t metaslabstat_drain_skips;
 } metaslab_stats_t;
 
 static metaslab_stats_t metaslab_stats = {
@@ -362,10 +407,19 @@ static metaslab_stats_t metaslab_stats = {
 	{ "reload_tree",		KSTAT_DATA_UINT64 },
 	{ "too_many_tries",		KSTAT_DATA_UINT64 },
 	{ "try_hard",			KSTAT_DATA_UINT64 },
+	{ "load_stalls",		KSTAT_DATA_UINT64 },
+	{ "load_stall_us",		KSTAT_DATA_UINT64 },
+	{ "preload_forecast_extra",	KSTAT_DATA_UINT64 },
+	{ "forecast_txgs",		KSTAT_DATA_UINT64 },
+	{ "forecast_alloc_bytes",	KSTAT_DATA_UINT64 },
+	{ "forecast_error_bytes",	KSTAT_DATA_UINT64 },
+	{ "drain_skips",		KSTAT_DATA_UINT64 },
 };
 
 #define	METASLABSTAT_BUMP(stat) \
 	atomic_inc_64(&metaslab_stats.stat.value.ui64);
+#define	METASLABSTAT_INCR(stat, val) \
+	atomic_add_64(&metaslab_stats.stat.value.ui64, (val));
 
 
 static kstat_t *metaslab_ksp;
@@ -850,6 +904,7 @@ metaslab_group_create(metaslab_class_t *mc, vdev_t *vd, int allocators)
 	for (int i = 0; i < allocators; i++) {
 		metaslab_group_allocator_t *mga = &mg->mg_allocator[i];
 		zfs_refcount_create_tracked(&mga->mga_alloc_queue_depth);
+		mutex_init(&mga->mga_carve_lock, NULL, MUTEX_DEFAULT, NULL);
 	}
 
 	return (mg);
@@ -875,6 +930,9 @@ metaslab_group_destroy(metaslab_group_t *mg)
 	for (int i = 0; i < mg->mg_allocators; i++) {
 		metaslab_group_allocator_t *mga = &mg->mg_allocator[i];
 		zfs_refcount_destroy(&mga->mga_alloc_queue_depth);
+		for (int s = 0; s < METASLAB_CARVE_STREAMS; s++)
+			ASSERT3P(mga->mga_carve[s].mcv_ms, ==, NULL);
+		mutex_destroy(&mga->mga_carve_lock);
 	}
 	kmem_free(mg, offsetof(metaslab_group_t,
 	    mg_allocator[mg->mg_allocators]));
@@ -1652,12 +1710,14 @@ metaslab_block_picker(range_tree_t *rt, uint64_t *cursor, uint64_t size,
 static uint64_t metaslab_df_alloc(metaslab_t *msp, uint64_t size);
 static uint64_t metaslab_cf_alloc(metaslab_t *msp, uint64_t size);
 static uint64_t metaslab_ndf_alloc(metaslab_t *msp, uint64_t size);
+static uint64_t metaslab_sf_alloc(metaslab_t *msp, uint64_t size);
 metaslab_ops_t *metaslab_allocator(spa_t *spa);
 
 static metaslab_ops_t metaslab_allocators[] = {
 	{ "dynamic", metaslab_df_alloc },
 	{ "cursor", metaslab_cf_alloc },
 	{ "new-dynamic", metaslab_ndf_alloc },
+	{ "segregated", metaslab_sf_alloc },
 };
 
 static int
@@ -1888,6 +1948,44 @@ metaslab_ndf_alloc(metaslab_t *msp, uint64_t size)
 	return (-1ULL);
 }
 
+/*
+ * ==========================================================================
+ * Segregated fit allocator -
+ * Treat the free segments as segregated into power-of-two size classes,
+ * using the allocatable range tree's histogram as the map of which classes
+ * are populated. Allocate from the smallest populated class whose segments
+ * are all big enough, taking the smallest segment in it; only if there is
+ * no such class, search the class the request itself falls in. Either way
+ * this is one lookup in the size-sorted tree and never a walk by offset, so
+ * the cost does not grow as the metaslab fills and fragments.
+ * ==========================================================================
+ */
+static uint64_t
+metaslab_sf_alloc(metaslab_t *msp, uint64_t size)
+{
+	range_tree_t *rt = msp->ms_allocatable;
+	zfs_btree_t *t = &msp->ms_allocatable_by_size;
+	zfs_btree_index_t where;
+	range_seg_t *rs;
+
+	ASSERT(MUTEX_HELD(&msp->ms_lock));
+
+	/* Every segment in class c (and above) is at least 2^c >= size. */
+	int c = highbit64(size - 1);
+	while (c < RANGE_TREE_HISTOGRAM_SIZE && rt->rt_histogram[c] == 0)
+		c++;
+
+	if (zfs_btree_numnodes(t) == 0)
+		metaslab_size_tree_full_load(rt);
+
+	rs = metaslab_block_find(t, rt, msp->ms_start,
+	    c < RANGE_TREE_HISTOGRAM_SIZE ? 1ULL << c : size, &where);
+	if (rs == NULL || rs_get_end(rs, rt) - rs_get_start(rs, rt) < size)
+		return (-1ULL);
+
+	return (rs_get_start(rs, rt));
+}
+
 /*
  * ==========================================================================
  * Metaslabs
@@ -3232,6 +3330,24 @@ metaslab_segment_weight(metaslab_t *msp)
 	return (weight);
 }
 
+/*
+ * Determine if msp is being drained (see zfs_metaslab_drain_fragmentation).
+ */
+static boolean_t
+metaslab_is_draining(metaslab_t *msp)
+{
+	metaslab_group_t *mg = msp->ms_group;
+	uint_t threshold = zfs_metaslab_drain_fragmentation;
+
+	if (threshold == 0 || msp->ms_fragmentation == ZFS_FRAG_INVALID ||
+	    msp->ms_fragmentation < threshold)
+		return (B_FALSE);
+
+	/* Only while the group has better metaslabs to allocate from. */
+	return (mg->mg_fragmentation != ZFS_FRAG_INVALID &&
+	    mg->mg_fragmentation < threshold);
+}
+
 /*
  * Determine if we should attempt to allocate from this metaslab. If the
  * metaslab is loaded, then we can determine if the desired allocation
@@ -3399,7 +3515,19 @@ metaslab_activate(metaslab_t *msp, int allocator, uint64_t activation_weight)
 		return (0);
 	}
 
+	/*
+	 * Having to load (or wait for the load of) the metaslab here stalls
+	 * the allocation; count it, as a measure of how well preloading is
+	 * keeping up.
+	 */
+	boolean_t stall = !msp->ms_loaded;
+	hrtime_t stall_start = stall ? gethrtime() : 0;
 	int error = metaslab_load(msp);
+	if (stall) {
+		METASLABSTAT_BUMP(metaslabstat_load_stalls);
+		METASLABSTAT_INCR(metaslabstat_load_stall_us,
+		    NSEC2USEC(gethrtime() - stall_start));
+	}
 	if (error != 0) {
 		metaslab_group_sort(msp->ms_group, msp, 0);
 		return (error);
@@ -3557,6 +3685,67 @@ metaslab_preload(void *arg)
 	spl_fstrans_unmark(cookie);
 }
 
+/*
+ * Estimate how much of msp's free space is in segments that can hold an
+ * allocation of size, from whichever histogram is at hand. This is only
+ * used to size preloading, so it does not take the ms_lock.
+ */
+static uint64_t
+metaslab_usable_space(metaslab_t *msp, uint64_t size)
+{
+	uint64_t usable = 0;
+
+	if (msp->ms_loaded) {
+		uint64_t *hist = msp->ms_allocatable->rt_histogram;
+		for (int i = 0; i < RANGE_TREE_HISTOGRAM_SIZE - 1; i++) {
+			if ((2ULL << i) > size)
+				usable += hist[i] << i;
+		}
+	} else if (msp->ms_sm == NULL) {
+		usable = msp->ms_size;
+	} else if (msp->ms_sm->sm_dbuf->db_size ==
+	    sizeof (space_map_phys_t)) {
+		space_map_phys_t *smp = msp->ms_sm->sm_phys;
+		int shift = msp->ms_sm->sm_shift;
+		for (int i = 0; i < SPACE_MAP_HISTOGRAM_SIZE &&
+		    i + shift < 63; i++) {
+			if ((2ULL << (i + shift)) > size)
+				usable += smp->smp_histogram[i] << (i + shift);
+		}
+	}
+
+	return (usable);
+}
+
+/*
+ * Fold the allocations made since the last call into the group's moving
+ * averages, first accounting for how far off the previous rate was as a
+ * forecast of this txg's allocations.
+ */
+static void
+metaslab_group_forecast_update(metaslab_group_t *mg)
+{
+	uint64_t bytes = atomic_load_64(&mg->mg_alloc_bytes);
+	uint64_t count = atomic_load_64(&mg->mg_alloc_count);
+	uint64_t delta = bytes - mg->mg_forecast_bytes;
+	uint64_t ndelta = count - mg->mg_forecast_count;
+
+	mg->mg_forecast_bytes = bytes;
+	mg->mg_forecast_count = count;
+
+	METASLABSTAT_BUMP(metaslabstat_forecast_txgs);
+	METASLABSTAT_INCR(metaslabstat_forecast_alloc_bytes, delta);
+	METASLABSTAT_INCR(metaslabstat_forecast_error_bytes,
+	    delta > mg->mg_alloc_rate ? delta - mg->mg_alloc_rate :
+	    mg->mg_alloc_rate - delta);
+
+	mg->mg_alloc_rate = (mg->mg_alloc_rate * 3 + delta) / 4;
+	if (ndelta != 0) {
+		mg->mg_alloc_avgsize =
+		    (mg->mg_alloc_avgsize * 3 + delta / ndelta) / 4;
+	}
+}
+
 static void
 metaslab_group_preload(metaslab_group_t *mg)
 {
@@ -3568,6 +3757,13 @@ metaslab_group_preload(metaslab_group_t *mg)
 	if (spa_shutting_down(spa) || !metaslab_preload_enabled)
 		return;
 
+	/*
+	 * The space we expect to allocate before the next few preloads,
+	 * and how much of it the metaslabs we have walked past could serve.
+	 */
+	uint64_t demand = mg->mg_alloc_rate * metaslab_preload_forecast_txgs;
+	uint64_t supply = 0;
+
 	mutex_enter(&mg->mg_lock);
 
 	/*
@@ -3583,8 +3779,16 @@ metaslab_group_preload(metaslab_group_t *mg)
 		 * that force condensing happens in the next txg.
 		 */
 		if (++m > metaslab_preload_limit && !msp->ms_condense_wanted) {
-			continue;
+			/*
+			 * Past the limit, keep going only while the forecast
+			 * demand is not yet covered.
+			 */
+			if (supply >= demand || m > metaslab_preload_limit *
+			    METASLAB_PRELOAD_FORECAST_MAX)
+				continue;
+			METASLABSTAT_BUMP(metaslabstat_preload_forecast_extra);
 		}
+		supply += metaslab_usable_space(msp, mg->mg_alloc_avgsize);
 
 		VERIFY(taskq_dispatch(spa->spa_metaslab_taskq, metaslab_preload,
 		    msp, TQ_SLEEP | (m <= mg->mg_allocators ? TQ_FRONT : 0))
@@ -4027,6 +4231,25 @@ metaslab_sync(metaslab_t *msp, uint64_t txg)
 
 	ASSERT(!vd->vdev_ishole);
 
+	/*
+	 * Take back whatever is left of any extent carved out of us this
+	 * txg, before the allocations are written out.
+	 */
+	for (int i = 0; i < mg->mg_allocators; i++) {
+		metaslab_group_allocator_t *mga = &mg->mg_allocator[i];
+		for (int s = 0; s < METASLAB_CARVE_STREAMS; s++) {
+			metaslab_carve_t *mcv = &mga->mga_carve[s];
+			if (mcv->mcv_ms != msp)
+				continue;
+			mutex_enter(&mga->mga_carve_lock);
+			if (mcv->mcv_ms == msp) {
+				ASSERT3U(mcv->mcv_txg, ==, txg);
+				metaslab_carve_return(mga, mcv);
+			}
+			mutex_exit(&mga->mga_carve_lock);
+		}
+	}
+
 	/*
 	 * This metaslab has just been added so there's no work to do now.
 	 */
@@ -4454,6 +4677,7 @@ metaslab_sync_reassess(metaslab_group_t *mg)
 	spa_config_enter(spa, SCL_ALLOC, FTAG, RW_READER);
 	metaslab_group_alloc_update(mg);
 	mg->mg_fragmentation = metaslab_group_fragmentation(mg);
+	metaslab_group_forecast_update(mg);
 
 	/*
 	 * Preload the next potential metaslabs but only on active
@@ -4732,6 +4956,11 @@ find_valid_metaslab(metaslab_group_t *mg, uint64_t activation_weight,
 		if (msp->ms_condensing || msp->ms_disabled > 0 || msp->ms_new)
 			continue;
 
+		if (!try_hard && metaslab_is_draining(msp)) {
+			METASLABSTAT_BUMP(metaslabstat_drain_skips);
+			continue;
+		}
+
 		*was_active = msp->ms_allocator != -1;
 		/*
 		 * If we're activating as primary, this is our first allocation
@@ -4796,10 +5025,105 @@ metaslab_active_mask_verify(metaslab_t *msp)
 	}
 }
 
+/*
+ * Carve an extent of mcv_size out of msp into the empty slot mcv. Called
+ * with the allocator's mga_carve_lock and the ms_lock held, right after a
+ * successful allocation from msp.
+ */
+static void
+metaslab_carve(metaslab_carve_t *mcv, metaslab_t *msp, uint64_t txg)
+{
+	uint64_t size = P2ROUNDUP(mcv->mcv_size,
+	    1ULL << msp->ms_group->mg_vd->vdev_ashift);
+
+	ASSERT(MUTEX_HELD(&msp->ms_lock));
+	ASSERT3P(mcv->mcv_ms, ==, NULL);
+
+	/*
+	 * dRAID allocations must start on a group boundary, which packing
+	 * blocks back to back inside an extent does not preserve.
+	 */
+	if (msp->ms_group->mg_vd->vdev_ops == &vdev_draid_ops ||
+	    msp->ms_max_size < size)
+		return;
+
+	uint64_t start = metaslab_block_alloc(msp, size, txg);
+	if (start == -1ULL)
+		return;
+
+	mcv->mcv_ms = msp;
+	mcv->mcv_base = start;
+	mcv->mcv_count = 0;
+	mcv->mcv_start = start;
+	mcv->mcv_end = start + size;
+	mcv->mcv_txg = txg;
+}
+
+/*
+ * Give what is left of a carved extent back to its metaslab. This must
+ * happen before the metaslab syncs the txg the extent was carved in, as
+ * until then the whole extent is only in its ms_allocating tree.
+ */
+static void
+metaslab_carve_return(metaslab_group_allocator_t *mga, metaslab_carve_t *mcv)
+{
+	metaslab_t *msp = mcv->mcv_ms;
+	uint64_t txg = mcv->mcv_txg;
+
+	ASSERT(MUTEX_HELD(&mga->mga_carve_lock));
+
+	if (msp == NULL)
+		return;
+
+	uint64_t start = mcv->mcv_start;
+	uint64_t size = mcv->mcv_end - start;
+
+	mutex_enter(&msp->ms_lock);
+	if (size != 0) {
+		ASSERT(msp->ms_loaded);
+		range_tree_remove(msp->ms_allocating[txg & TXG_MASK],
+		    start, size);
+		msp->ms_allocating_total -= size;
+		range_tree_add(msp->ms_allocatable, start, size);
+		msp->ms_max_size = metaslab_largest_allocatable(msp);
+	}
+	mutex_exit(&msp->ms_lock);
+
+	metaslab_group_t *mg = msp->ms_group;
+	atomic_add_64(&mg->mg_alloc_bytes, start - mcv->mcv_base);
+	atomic_add_64(&mg->mg_alloc_count, mcv->mcv_count);
+
+	mcv->mcv_ms = NULL;
+	mcv->mcv_start = mcv->mcv_end = 0;
+}
+
+/*
+ * Release the extent in slot mcv, which could not satisfy an allocation of
+ * asize for stream, and size the one to be carved in its place.
+ */
+static void
+metaslab_carve_next(metaslab_group_allocator_t *mga, metaslab_carve_t *mcv,
+    uint64_t stream, uint64_t asize, uint64_t txg)
+{
+	uint64_t max_size = MAX(zfs_metaslab_carve_size,
+	    zfs_metaslab_carve_max_size);
+	boolean_t used_up = mcv->mcv_ms != NULL && mcv->mcv_txg == txg &&
+	    mcv->mcv_stream == stream;
+
+	metaslab_carve_return(mga, mcv);
+
+	if (used_up)
+		mcv->mcv_size = MIN(mcv->mcv_size * 2, max_size);
+	else
+		mcv->mcv_size = zfs_metaslab_carve_size;
+	mcv->mcv_size = MIN(MAX(mcv->mcv_size, asize * 8), max_size);
+	mcv->mcv_stream = stream;
+}
+
 static uint64_t
 metaslab_group_alloc_normal(metaslab_group_t *mg, zio_alloc_list_t *zal,
     uint64_t asize, uint64_t txg, boolean_t want_unique, dva_t *dva, int d,
-    int allocator, boolean_t try_hard)
+    int allocator, boolean_t try_hard, metaslab_carve_t *carve)
 {
 	metaslab_t *msp = NULL;
 	uint64_t offset = -1ULL;
@@ -5021,6 +5345,8 @@ metaslab_group_alloc_normal(metaslab_group_t *mg, zio_alloc_list_t *zal,
 		metaslab_trace_add(zal, mg, msp, asize, d, offset, allocator);
 
 		if (offset != -1ULL) {
+			if (carve != NULL)
+				metaslab_carve(carve, msp, txg);
 			/* Proactively passivate the metaslab, if needed */
 			if (activated)
 				metaslab_segment_may_passivate(msp);
@@ -5105,12 +5431,34 @@ next:
 static uint64_t
 metaslab_group_alloc(metaslab_group_t *mg, zio_alloc_list_t *zal,
     uint64_t asize, uint64_t txg, boolean_t want_unique, dva_t *dva, int d,
-    int allocator, boolean_t try_hard)
+    int allocator, boolean_t try_hard, boolean_t carve_ok, uint64_t stream)
 {
+	metaslab_group_allocator_t *mga = &mg->mg_allocator[allocator];
+	metaslab_carve_t *carve = NULL;
 	uint64_t offset;
 
+	if (carve_ok && asize <= MAX(zfs_metaslab_carve_size,
+	    zfs_metaslab_carve_max_size) / 8) {
+		carve = &mga->mga_carve[stream % METASLAB_CARVE_STREAMS];
+		mutex_enter(&mga->mga_carve_lock);
+		if (carve->mcv_ms != NULL && carve->mcv_txg == txg &&
+		    carve->mcv_stream == stream &&
+		    carve->mcv_end - carve->mcv_start >= asize) {
+			offset = carve->mcv_start;
+			carve->mcv_start += asize;
+			carve->mcv_count++;
+			metaslab_trace_add(zal, mg, carve->mcv_ms, asize,
+			    d, offset, allocator);
+			mutex_exit(&mga->mga_carve_lock);
+			return (offset);
+		}
+		metaslab_carve_next(mga, carve, stream, asize, txg);
+	}
+
 	offset = metaslab_group_alloc_normal(mg, zal, asize, txg, want_unique,
-	    dva, d, allocator, try_hard);
+	    dva, d, allocator, try_hard, carve);
+	if (carve != NULL)
+		mutex_exit(&mga->mga_carve_lock);
 
 	mutex_enter(&mg->mg_lock);
 	if (offset == -1ULL) {
@@ -5134,21 +5482,28 @@ metaslab_group_alloc(metaslab_group_t *mg, zio_alloc_list_t *zal,
 	}
 	mg->mg_allocations++;
 	mutex_exit(&mg->mg_lock);
+	if (offset != -1ULL) {
+		atomic_add_64(&mg->mg_alloc_bytes, asize);
+		atomic_inc_64(&mg->mg_alloc_count);
+	}
 	return (offset);
 }
 
 /*
- * Allocate a block for the specified i/o.
+ * Allocate a block for the specified i/o. stream identifies the sequence
+ * of writes the block belongs to, for zfs_metaslab_carve_size.
  */
-int
-metaslab_alloc_dva(spa_t *spa, metaslab_class_t *mc, uint64_t psize,
+static int
+metaslab_alloc_dva_impl(spa_t *spa, metaslab_class_t *mc, uint64_t psize,
     dva_t *dva, int d, dva_t *hintdva, uint64_t txg, int flags,
-    zio_alloc_list_t *zal, int allocator)
+    zio_alloc_list_t *zal, int allocator, uint64_t stream)
 {
 	metaslab_class_allocator_t *mca = &mc->mc_allocator[allocator];
 	metaslab_group_t *mg, *rotor;
 	vdev_t *vd;
 	boolean_t try_hard = B_FALSE;
+	boolean_t carve_ok = zfs_metaslab_carve_size != 0 && d == 0 &&
+	    !(flags & METASLAB_ZIL) && txg == spa_syncing_txg(spa);
 
 	ASSERT(!DVA_IS_VALID(&dva[d]));
 
@@ -5282,7 +5637,8 @@ top:
 		 * allow any metaslab to be used (unique=false).
 		 */
 		uint64_t offset = metaslab_group_alloc(mg, zal, asize, txg,
-		    !try_hard, dva, d, allocator, try_hard);
+		    !try_hard, dva, d, allocator, try_hard,
+		    carve_ok && !try_hard, stream);
 
 		if (offset != -1ULL) {
 			/*
@@ -5368,6 +5724,15 @@ next:
 	return (SET_ERROR(ENOSPC));
 }
 
+int
+metaslab_alloc_dva(spa_t *spa, metaslab_class_t *mc, uint64_t psize,
+    dva_t *dva, int d, dva_t *hintdva, uint64_t txg, int flags,
+    zio_alloc_list_t *zal, int allocator)
+{
+	return (metaslab_alloc_dva_impl(spa, mc, psize, dva, d, hintdva, txg,
+	    flags, zal, allocator, 0));
+}
+
 void
 metaslab_free_concrete(vdev_t *vd, uint64_t offset, uint64_t asize,
     boolean_t checkpoint)
@@ -5865,9 +6230,15 @@ metaslab_alloc(spa_t *spa, metaslab_class_t *mc, uint64_t psize, blkptr_t *bp,
 	ASSERT(hintbp == NULL || ndvas <= BP_GET_NDVAS(hintbp));
 	ASSERT3P(zal, !=, NULL);
 
+	uint64_t stream = 0;
+	if (zio != NULL) {
+		stream = cityhash4(zio->io_bookmark.zb_objset,
+		    zio->io_bookmark.zb_object, zio->io_bookmark.zb_level, 0);
+	}
+
 	for (int d = 0; d < ndvas; d++) {
-		error = metaslab_alloc_dva(spa, mc, psize, dva, d, hintdva,
-		    txg, flags, zal, allocator);
+		error = metaslab_alloc_dva_impl(spa, mc, psize, dva, d, hintdva,
+		    txg, flags, zal, allocator, stream);
 		if (error != 0) {
 			for (d--; d >= 0; d--) {
 				metaslab_unalloc_dva(spa, &dva[d], txg);
@@ -5897,6 +6268,13 @@ metaslab_alloc(spa_t *spa, metaslab_class_t *mc, uint64_t psize, blkptr_t *bp,
 	return (0);
 }
 
+static boolean_t
+metaslab_free_checkpoint(spa_t *spa, const blkptr_t *bp)
+{
+	return (BP_GET_LOGICAL_BIRTH(bp) <= spa->spa_checkpoint_txg &&
+	    spa_syncing_txg(spa) > spa->spa_checkpoint_txg);
+}
+
 void
 metaslab_free(spa_t *spa, const blkptr_t *bp, uint64_t txg, boolean_t now)
 {
@@ -5922,8 +6300,7 @@ metaslab_free(spa_t *spa, const blkptr_t *bp, uint64_t txg, boolean_t now)
 	 * normally as they will be referenced by the checkpointed uberblock.
 	 */
 	boolean_t checkpoint = B_FALSE;
-	if (BP_GET_LOGICAL_BIRTH(bp) <= spa->spa_checkpoint_txg &&
-	    spa_syncing_txg(spa) > spa->spa_checkpoint_txg) {
+	if (metaslab_free_checkpoint(spa, bp)) {
 		/*
 		 * At this point, if the block is part of the checkpoint
 		 * there is no way it was created in the current txg.
@@ -5947,6 +6324,141 @@ metaslab_free(spa_t *spa, const blkptr_t *bp, uint64_t txg, boolean_t now)
 	spa_config_exit(spa, SCL_FREE, FTAG);
 }
 
+/*
+ * Freeing a large file or snapshot frees its blocks one at a time, each
+ * taking the config lock and its metaslab's ms_lock to add one segment to
+ * ms_freeing. A free batch instead collects the DVAs of blocks which can be
+ * freed without a read (i.e. not gang, dedup or cloned blocks), and when it
+ * fills up or is flushed sorts them by vdev and offset and coalesces
+ * adjacent ones into extents. Each extent is then freed with a single
+ * metaslab_free_impl() call under one hold of the config lock. Blocks
+ * written together are usually freed together, so a batch of a few
+ * thousand frees typically comes down to a few dozen extents.
+ */
+#define	METASLAB_FREE_BATCH	4096
+
+typedef struct metaslab_free_ext {
+	uint64_t	mfe_vdev;
+	uint64_t	mfe_offset;
+	uint64_t	mfe_size;
+	boolean_t	mfe_checkpoint;
+} metaslab_free_ext_t;
+
+struct metaslab_free_batch {
+	spa_t			*mfb_spa;
+	uint64_t		mfb_txg;
+	uint_t			mfb_count;
+	metaslab_free_ext_t	mfb_exts[METASLAB_FREE_BATCH];
+};
+
+metaslab_free_batch_t *
+metaslab_free_batch_create(spa_t *spa, uint64_t txg)
+{
+	metaslab_free_batch_t *mfb = vmem_alloc(sizeof (*mfb), KM_SLEEP);
+
+	ASSERT3U(txg, ==, spa_syncing_txg(spa));
+	mfb->mfb_spa = spa;
+	mfb->mfb_txg = txg;
+	mfb->mfb_count = 0;
+	return (mfb);
+}
+
+static int
+metaslab_free_ext_compare(const void *x1, const void *x2)
+{
+	const metaslab_free_ext_t *e1 = x1;
+	const metaslab_free_ext_t *e2 = x2;
+
+	int cmp = TREE_CMP(e1->mfe_vdev, e2->mfe_vdev);
+	if (likely(cmp))
+		return (cmp);
+	cmp = TREE_CMP(e1->mfe_checkpoint, e2->mfe_checkpoint);
+	if (likely(cmp))
+		return (cmp);
+	return (TREE_CMP(e1->mfe_offset, e2->mfe_offset));
+}
+
+void
+metaslab_free_batch_flush(metaslab_free_batch_t *mfb)
+{
+	spa_t *spa = mfb->mfb_spa;
+	metaslab_free_ext_t *exts = mfb->mfb_exts;
+	uint_t count = mfb->mfb_count;
+
+	if (count == 0)
+		return;
+
+	qsort(exts, count, sizeof (metaslab_free_ext_t),
+	    metaslab_free_ext_compare);
+
+	spa_config_enter(spa, SCL_FREE, FTAG, RW_READER);
+	for (uint_t i = 0; i < count; ) {
+		metaslab_free_ext_t *e = &exts[i++];
+		vdev_t *vd = vdev_lookup_top(spa, e->mfe_vdev);
+		uint64_t offset = e->mfe_offset;
+		uint64_t size = e->mfe_size;
+
+		/*
+		 * Only coalesce on plain concrete vdevs; indirect and
+		 * removing vdevs map each free on to its own segments.
+		 * An extent never spans two metaslabs.
+		 */
+		if (vdev_is_concrete(vd) &&
+		    vd->vdev_ops->vdev_op_remap == NULL &&
+		    (spa->spa_vdev_removal == NULL ||
+		    spa->spa_vdev_removal->svr_vdev_id != vd->vdev_id)) {
+			while (i < count && exts[i].mfe_vdev == e->mfe_vdev &&
+			    exts[i].mfe_checkpoint == e->mfe_checkpoint &&
+			    exts[i].mfe_offset == offset + size &&
+			    (exts[i].mfe_offset >> vd->vdev_ms_shift) ==
+			    (offset >> vd->vdev_ms_shift)) {
+				size += exts[i++].mfe_size;
+			}
+		}
+		metaslab_free_impl(vd, offset, size, e->mfe_checkpoint);
+	}
+	spa_config_exit(spa, SCL_FREE, FTAG);
+
+	mfb->mfb_count = 0;
+}
+
+/*
+ * Equivalent to metaslab_free(spa, bp, txg, B_FALSE), but the free is only
+ * applied by the next metaslab_free_batch_flush().
+ */
+void
+metaslab_free_batch_add(metaslab_free_batch_t *mfb, const blkptr_t *bp)
+{
+	spa_t *spa = mfb->mfb_spa;
+	boolean_t checkpoint = metaslab_free_checkpoint(spa, bp);
+
+	ASSERT(!BP_IS_HOLE(bp));
+	ASSERT(!BP_IS_EMBEDDED(bp));
+	ASSERT(!BP_IS_GANG(bp));
+	ASSERT3U(spa_syncing_txg(spa), ==, mfb->mfb_txg);
+
+	for (int d = 0; d < BP_GET_NDVAS(bp); d++) {
+		const dva_t *dva = &bp->blk_dva[d];
+
+		ASSERT(DVA_IS_VALID(dva));
+		if (mfb->mfb_count == METASLAB_FREE_BATCH)
+			metaslab_free_batch_flush(mfb);
+
+		metaslab_free_ext_t *e = &mfb->mfb_exts[mfb->mfb_count++];
+		e->mfe_vdev = DVA_GET_VDEV(dva);
+		e->mfe_offset = DVA_GET_OFFSET(dva);
+		e->mfe_size = DVA_GET_ASIZE(dva);
+		e->mfe_checkpoint = checkpoint;
+	}
+}
+
+void
+metaslab_free_batch_destroy(metaslab_free_batch_t *mfb)
+{
+	metaslab_free_batch_flush(mfb);
+	vmem_free(mfb, sizeof (*mfb));
+}
+
 int
 metaslab_claim(spa_t *spa, const blkptr_t *bp, uint64_t txg)
 {
@@ -6214,6 +6726,9 @@ ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, debug_load, INT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, debug_unload, INT, ZMOD_RW,
 	"Prevent metaslabs from being unloaded");
 
+ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, preload_forecast_txgs, UINT,
+	ZMOD_RW, "Txgs of forecast allocations to keep preloaded for");
+
 ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, preload_enabled, INT, ZMOD_RW,
 	"Preload potential metaslabs during reassessment");
 
@@ -6241,6 +6756,9 @@ ZFS_MODULE_PARAM(zfs_metaslab, metaslab_, fragmentation_factor_enabled, INT,
 	"Use the fragmentation metric to prefer less fragmented metaslabs");
 /* END CSTYLED */
 
+ZFS_MODULE_PARAM(zfs_metaslab, zfs_metaslab_, drain_fragmentation, UINT,
+	ZMOD_RW, "Fragmentation at which metaslabs stop taking allocations");
+
 ZFS_MODULE_PARAM(zfs_metaslab, zfs_metaslab_, fragmentation_threshold, UINT,
 	ZMOD_RW, "Fragmentation for metaslab to allow allocation");
 
@@ -6277,6 +6795,12 @@ ZFS_MODULE_PARAM(zfs_metaslab, zfs_metaslab_, mem_limit, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_metaslab, zfs_metaslab_, try_hard_before_gang, INT,
 	ZMOD_RW, "Try hard to allocate before ganging");
 
+ZFS_MODULE_PARAM(zfs_metaslab, zfs_metaslab_, carve_size, UINT, ZMOD_RW,
+	"Size of the extents allocators carve out of metaslabs (0 = off)");
+
+ZFS_MODULE_PARAM(zfs_metaslab, zfs_metaslab_, carve_max_size, UINT, ZMOD_RW,
+	"Largest extent carved for a single sequential write stream");
+
 ZFS_MODULE_PARAM(zfs_metaslab, zfs_metaslab_, find_max_tries, UINT, ZMOD_RW,
 	"Normally only consider this many of the best metaslabs in each vdev");
 
@@ -407,6 +407,9 @@ mmp_write_done(zio_t *zio)
 
 	spa_mmp_history_set(spa, mmp_kstat_id, zio->io_error,
 	    mmp_write_duration);
+	spa_iostats_mmp_write_add(spa, mmp_write_duration, zio->io_error,
+	    mmp_write_duration > MSEC2NSEC(MMP_INTERVAL_OK(
+	    zfs_multihost_interval)));
 
 	abd_free(zio->io_abd);
 }
@@ -531,7 +534,7 @@ mmp_write_uberblock(spa_t *spa)
 	label = random_in_range(VDEV_LABELS);
 	vdev_label_write(zio, vd, label, ub_abd, offset,
 	    VDEV_UBERBLOCK_SIZE(vd), mmp_write_done, mmp,
-	    flags | ZIO_FLAG_DONT_PROPAGATE);
+	    flags | ZIO_FLAG_DONT_PROPAGATE | ZIO_FLAG_MMP);
 
 	(void) spa_mmp_history_add(spa, ub->ub_txg, ub->ub_timestamp,
 	    ub->ub_mmp_delay, vd, label, vd->vdev_mmp_kstat_id, 0);
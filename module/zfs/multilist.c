@@ -103,14 +103,29 @@ multilist_create_impl(multilist_t *ml, size_t size, size_t offset,
 void
 multilist_create(multilist_t *ml, size_t size, size_t offset,
     multilist_sublist_index_func_t *index_func)
+{
+	multilist_create_groups(ml, size, offset, 1, index_func);
+}
+
+/*
+ * As multilist_create(), but with the number of sublists rounded up to a
+ * multiple of ngroups, so that the index function can split them evenly
+ * into that many groups (e.g. one per NUMA node).
+ */
+void
+multilist_create_groups(multilist_t *ml, size_t size, size_t offset,
+    uint_t ngroups, multilist_sublist_index_func_t *index_func)
 {
 	uint_t num_sublists;
 
+	ASSERT3U(ngroups, >, 0);
+
 	if (zfs_multilist_num_sublists > 0) {
 		num_sublists = zfs_multilist_num_sublists;
 	} else {
 		num_sublists = MAX(boot_ncpus, 4);
 	}
+	num_sublists = roundup(num_sublists, ngroups);
 
 	multilist_create_impl(ml, size, offset, num_sublists, index_func);
 }
@@ -141,6 +156,21 @@ multilist_destroy(multilist_t *ml)
 	ml->ml_sublists = NULL;
 }
 
+/*
+ * Take a sublist lock, counting how often it was held by someone else.
+ * The count makes it possible to tell whether a multilist has too few
+ * sublists for the number of CPUs hammering it, and costs nothing when
+ * the lock is uncontended.
+ */
+static inline void
+multilist_sublist_enter(multilist_sublist_t *mls)
+{
+	if (!mutex_tryenter(&mls->mls_lock)) {
+		mutex_enter(&mls->mls_lock);
+		mls->mls_contended++;
+	}
+}
+
 /*
  * Insert the given object into the multilist.
  *
@@ -176,7 +206,7 @@ multilist_insert(multilist_t *ml, void *obj)
 	need_lock = !MUTEX_HELD(&mls->mls_lock);
 
 	if (need_lock)
-		mutex_enter(&mls->mls_lock);
+		multilist_sublist_enter(mls);
 
 	ASSERT(!multilist_link_active(multilist_d2l(ml, obj)));
 
@@ -212,7 +242,7 @@ multilist_remove(multilist_t *ml, void *obj)
 	need_lock = !MUTEX_HELD(&mls->mls_lock);
 
 	if (need_lock)
-		mutex_enter(&mls->mls_lock);
+		multilist_sublist_enter(mls);
 
 	ASSERT(multilist_link_active(multilist_d2l(ml, obj)));
 
@@ -277,10 +307,26 @@ multilist_get_random_index(multilist_t *ml)
 	return (random_in_range(ml->ml_num_sublists));
 }
 
+/*
+ * Return the number of times any sublist lock of this multilist was found
+ * held by another thread.  The sublists are read without their locks, so
+ * the result is only approximate while the multilist is in use.
+ */
+uint64_t
+multilist_get_contended(multilist_t *ml)
+{
+	uint64_t contended = 0;
+
+	for (int i = 0; i < ml->ml_num_sublists; i++)
+		contended += ml->ml_sublists[i].mls_contended;
+
+	return (contended);
+}
+
 void
 multilist_sublist_lock(multilist_sublist_t *mls)
 {
-	mutex_enter(&mls->mls_lock);
+	multilist_sublist_enter(mls);
 }
 
 /* Lock and return the sublist specified at the given index */
@@ -291,7 +337,7 @@ multilist_sublist_lock_idx(multilist_t *ml, unsigned int sublist_idx)
 
 	ASSERT3U(sublist_idx, <, ml->ml_num_sublists);
 	mls = &ml->ml_sublists[sublist_idx];
-	mutex_enter(&mls->mls_lock);
+	multilist_sublist_enter(mls);
 
 	return (mls);
 }
@@ -1462,11 +1462,51 @@ sa_buf_rele(dmu_buf_t *db, const void *tag)
 	dmu_buf_rele(db, tag);
 }
 
+/*
+ * Lookup fast path for the common case of every attribute being in the
+ * bonus buffer, as is the case for the ZPL's attributes on nearly every
+ * file.  The bonus index table already holds the offset of each attribute
+ * for this layout, so each lookup is a single load of its table of
+ * contents entry followed by the copy.  Returns B_FALSE as soon as an
+ * attribute is not found, leaving the rest to sa_attr_op(), which may
+ * need the spill block.
+ */
+static boolean_t
+sa_lookup_bonus(sa_handle_t *hdl, sa_bulk_attr_t *bulk, int count)
+{
+	sa_os_t *sa = hdl->sa_os->os_sa;
+	sa_idx_tab_t *tab = hdl->sa_bonus_tab;
+	sa_hdr_phys_t *hdr;
+
+	if (tab == NULL)
+		return (B_FALSE);
+
+	hdr = SA_GET_HDR(hdl, SA_BONUS);
+	for (int i = 0; i != count; i++) {
+		sa_attr_type_t attr = bulk[i].sa_attr;
+
+		ASSERT(attr <= sa->sa_num_attrs);
+		if (!TOC_ATTR_PRESENT(tab->sa_idx_tab[attr]))
+			return (B_FALSE);
+
+		SA_ATTR_INFO(sa, tab, hdr, attr, bulk[i], SA_BONUS, hdl);
+		if (bulk[i].sa_data) {
+			SA_COPY_DATA(bulk[i].sa_data_func, bulk[i].sa_addr,
+			    bulk[i].sa_data,
+			    MIN(bulk[i].sa_size, bulk[i].sa_length));
+		}
+	}
+
+	return (B_TRUE);
+}
+
 static int
 sa_lookup_impl(sa_handle_t *hdl, sa_bulk_attr_t *bulk, int count)
 {
 	ASSERT(hdl);
 	ASSERT(MUTEX_HELD(&hdl->sa_lock));
+	if (sa_lookup_bonus(hdl, bulk, count))
+		return (0);
 	return (sa_attr_op(hdl, bulk, count, SA_LOOKUP, NULL));
 }
 
@@ -216,6 +216,36 @@ static const boolean_t spa_create_process = B_TRUE; /* no process => no sysdc */
 
 static uint_t	zio_taskq_write_tpq = 16;
 
+/*
+ * Maximum number of small writes executed back to back by one write issue
+ * task. Batching amortizes the taskq handoff over several zios and keeps
+ * the compression and checksum code hot in cache; zero disables it.
+ */
+static uint_t	zio_taskq_write_batch = 0;
+
+/*
+ * Only writes this size or smaller are batched. Larger writes spend enough
+ * time compressing and checksumming to make the handoff insignificant, and
+ * are better spread across the taskq threads.
+ */
+#define	ZIO_TASKQ_BATCH_MAXSIZE	(32 * 1024)
+
+/*
+ * When a zio type and queue has several taskqs, pick the one matching the
+ * dispatching CPU rather than one at random. CPUs are split evenly into
+ * contiguous ranges, one per taskq, so issue and completion work stays
+ * near the CPU that submitted the I/O or handled its interrupt.
+ */
+static int	zio_taskq_cpu_affine = B_FALSE;
+
+/*
+ * When the taskq selected for a zio has no idle thread, try one other
+ * taskq of the same type and queue, and use it instead if it has one.
+ * This keeps a burst of zios from one CPU or allocator from queueing
+ * behind a single taskq's lock while its siblings sit idle.
+ */
+static int	zio_taskq_balance = B_TRUE;
+
 /*
  * Report any spa_load_verify errors found, but do not fail spa_load.
  * This is used by zdb to analyze non-idle pools.
@@ -406,6 +436,9 @@ spa_prop_get_config(spa_t *spa, nvlist_t **nvp)
 		spa_prop_add_list(*nvp, ZPOOL_PROP_BCLONERATIO, NULL,
 		    brt_get_ratio(spa), src);
 
+		spa_prop_add_list(*nvp, ZPOOL_PROP_DEDUP_TABLE_SIZE, NULL,
+		    ddt_get_ddt_dsize(spa), src);
+
 		spa_prop_add_list(*nvp, ZPOOL_PROP_HEALTH, NULL,
 		    rvd->vdev_state, src);
 
@@ -1195,6 +1228,20 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 
 		tqs->stqs_taskq[i] = tq;
 	}
+
+	if (t == ZIO_TYPE_WRITE && q == ZIO_TASKQ_ISSUE) {
+		tqs->stqs_batch = kmem_zalloc(count *
+		    sizeof (spa_taskq_batch_t), KM_SLEEP);
+		for (uint_t i = 0; i < count; i++) {
+			spa_taskq_batch_t *stqb = &tqs->stqs_batch[i];
+
+			mutex_init(&stqb->stqb_lock, NULL, MUTEX_DEFAULT, NULL);
+			list_create(&stqb->stqb_zios, sizeof (zio_t),
+			    offsetof(zio_t, io_batch_node));
+			stqb->stqb_taskq = tqs->stqs_taskq[i];
+			taskq_init_ent(&stqb->stqb_tqent);
+		}
+	}
 }
 
 static void
@@ -1212,6 +1259,20 @@ spa_taskqs_fini(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 		taskq_destroy(tqs->stqs_taskq[i]);
 	}
 
+	if (tqs->stqs_batch != NULL) {
+		for (uint_t i = 0; i < tqs->stqs_count; i++) {
+			spa_taskq_batch_t *stqb = &tqs->stqs_batch[i];
+
+			ASSERT(list_is_empty(&stqb->stqb_zios));
+			ASSERT(!stqb->stqb_dispatched);
+			list_destroy(&stqb->stqb_zios);
+			mutex_destroy(&stqb->stqb_lock);
+		}
+		kmem_free(tqs->stqs_batch,
+		    tqs->stqs_count * sizeof (spa_taskq_batch_t));
+		tqs->stqs_batch = NULL;
+	}
+
 	kmem_free(tqs->stqs_taskq, tqs->stqs_count * sizeof (taskq_t *));
 	tqs->stqs_taskq = NULL;
 }
@@ -1490,12 +1551,71 @@ spa_taskq_write_param(ZFS_MODULE_PARAM_ARGS)
  * Note that a type may have multiple discrete taskqs to avoid lock contention
  * on the taskq itself.
  */
+/*
+ * Execute up to zio_taskq_write_batch queued zios. If more remain, the batch
+ * task is redispatched before running them, so that another taskq thread
+ * can pick up the rest in parallel. Zios whose checksums can be computed
+ * together are parked at the checksum stage and finished once the whole
+ * batch has run (see zio_checksum_batch_enter()).
+ */
+static void
+spa_taskq_batch_execute(void *arg)
+{
+	spa_taskq_batch_t *stqb = arg;
+	uint_t batch = MAX(zio_taskq_write_batch, 1);
+	zio_checksum_batch_t zcb;
+	list_t zios;
+	zio_t *zio;
+
+	list_create(&zios, sizeof (zio_t), offsetof(zio_t, io_batch_node));
+
+	mutex_enter(&stqb->stqb_lock);
+	ASSERT(stqb->stqb_dispatched);
+	for (uint_t n = 0; n < batch; n++) {
+		if ((zio = list_remove_head(&stqb->stqb_zios)) == NULL)
+			break;
+		list_insert_tail(&zios, zio);
+	}
+	if (list_is_empty(&stqb->stqb_zios)) {
+		stqb->stqb_dispatched = B_FALSE;
+	} else {
+		taskq_dispatch_ent(stqb->stqb_taskq, spa_taskq_batch_execute,
+		    stqb, 0, &stqb->stqb_tqent);
+	}
+	mutex_exit(&stqb->stqb_lock);
+
+	zio_checksum_batch_enter(&zcb);
+	while ((zio = list_remove_head(&zios)) != NULL) {
+		zcb.zcb_current = zio;
+		stqb->stqb_func(zio);
+	}
+	zio_checksum_batch_exit(&zcb);
+
+	list_destroy(&zios);
+}
+
+static void
+spa_taskq_batch_dispatch(spa_taskq_batch_t *stqb, task_func_t *func,
+    zio_t *zio)
+{
+	mutex_enter(&stqb->stqb_lock);
+	stqb->stqb_func = func;
+	list_insert_tail(&stqb->stqb_zios, zio);
+	if (!stqb->stqb_dispatched) {
+		stqb->stqb_dispatched = B_TRUE;
+		taskq_dispatch_ent(stqb->stqb_taskq, spa_taskq_batch_execute,
+		    stqb, 0, &stqb->stqb_tqent);
+	}
+	mutex_exit(&stqb->stqb_lock);
+}
+
 void
 spa_taskq_dispatch(spa_t *spa, zio_type_t t, zio_taskq_type_t q,
     task_func_t *func, zio_t *zio, boolean_t cutinline)
 {
 	spa_taskqs_t *tqs = &spa->spa_zio_taskq[t][q];
 	taskq_t *tq;
+	uint_t i;
 
 	ASSERT3P(tqs->stqs_taskq, !=, NULL);
 	ASSERT3U(tqs->stqs_count, !=, 0);
@@ -1509,12 +1629,33 @@ spa_taskq_dispatch(spa_t *spa, zio_type_t t, zio_taskq_type_t q,
 	ASSERT(taskq_empty_ent(&zio->io_tqent));
 
 	if (tqs->stqs_count == 1) {
-		tq = tqs->stqs_taskq[0];
+		i = 0;
 	} else if ((t == ZIO_TYPE_WRITE) && (q == ZIO_TASKQ_ISSUE) &&
 	    ZIO_HAS_ALLOCATOR(zio)) {
-		tq = tqs->stqs_taskq[zio->io_allocator % tqs->stqs_count];
+		i = zio->io_allocator % tqs->stqs_count;
+	} else if (zio_taskq_cpu_affine) {
+		i = MIN((uint64_t)CPU_SEQID_UNSTABLE * tqs->stqs_count /
+		    MAX(max_ncpus, 1), tqs->stqs_count - 1);
 	} else {
-		tq = tqs->stqs_taskq[((uint64_t)gethrtime()) % tqs->stqs_count];
+		i = ((uint64_t)gethrtime()) % tqs->stqs_count;
+	}
+
+	/*
+	 * Write issue zios stay on their allocator's taskq, as they are
+	 * batched per taskq and issued in allocation order.
+	 */
+	if (zio_taskq_balance && tqs->stqs_count > 1 &&
+	    tqs->stqs_batch == NULL && taskq_busy(tqs->stqs_taskq[i])) {
+		uint_t j = ((uint64_t)gethrtime()) % tqs->stqs_count;
+		if (j != i && !taskq_busy(tqs->stqs_taskq[j]))
+			i = j;
+	}
+	tq = tqs->stqs_taskq[i];
+
+	if (tqs->stqs_batch != NULL && zio_taskq_write_batch > 1 &&
+	    !cutinline && zio->io_size <= ZIO_TASKQ_BATCH_MAXSIZE) {
+		spa_taskq_batch_dispatch(&tqs->stqs_batch[i], func, zio);
+		return;
 	}
 
 	taskq_dispatch_ent(tq, func, zio, cutinline ? TQ_FRONT : 0,
@@ -1972,6 +2113,10 @@ spa_destroy_aux_threads(spa_t *spa)
 		zthr_destroy(spa->spa_raidz_expand_zthr);
 		spa->spa_raidz_expand_zthr = NULL;
 	}
+	if (spa->spa_arc_warm_zthr != NULL) {
+		zthr_destroy(spa->spa_arc_warm_zthr);
+		spa->spa_arc_warm_zthr = NULL;
+	}
 }
 
 /*
@@ -3273,6 +3418,8 @@ spa_spawn_aux_threads(spa_t *spa)
 	    zthr_create("z_checkpoint_discard",
 	    spa_checkpoint_discard_thread_check,
 	    spa_checkpoint_discard_thread, spa, minclsyspri);
+
+	arc_warm_start(spa);
 }
 
 /*
@@ -4601,6 +4748,36 @@ spa_ld_load_special_directories(spa_t *spa)
 	return (0);
 }
 
+/*
+ * Load the txg time records, see spa_sync_txg_log_time(). These are only
+ * used to estimate the age of blocks, so if they can't be loaded we just
+ * start again.
+ */
+static void
+spa_load_txg_log_time(spa_t *spa)
+{
+	objset_t *mos = spa->spa_meta_objset;
+	uint64_t isize, count;
+
+	spa->spa_txg_log_time_count = 0;
+
+	if (zap_length(mos, DMU_POOL_DIRECTORY_OBJECT, DMU_POOL_TXG_LOG_TIME,
+	    &isize, &count) != 0)
+		return;
+
+	if (isize != sizeof (uint64_t) || count == 0 ||
+	    count % (sizeof (spa_txg_log_time_t) / sizeof (uint64_t)) != 0 ||
+	    count * sizeof (uint64_t) > sizeof (spa->spa_txg_log_time))
+		return;
+
+	if (zap_lookup(mos, DMU_POOL_DIRECTORY_OBJECT, DMU_POOL_TXG_LOG_TIME,
+	    sizeof (uint64_t), count, spa->spa_txg_log_time) != 0)
+		return;
+
+	spa->spa_txg_log_time_count =
+	    count / (sizeof (spa_txg_log_time_t) / sizeof (uint64_t));
+}
+
 static int
 spa_ld_get_props(spa_t *spa)
 {
@@ -4660,6 +4837,16 @@ spa_ld_get_props(spa_t *spa)
 	if (error != 0 && error != ENOENT)
 		return (spa_vdev_err(rvd, VDEV_AUX_CORRUPT_DATA, EIO));
 
+	/*
+	 * Load the txg of the last complete scrub, used as the starting
+	 * point of incremental scrubs.  Not present if the pool has never
+	 * been fully scrubbed by a version that records it.
+	 */
+	error = spa_dir_prop(spa, DMU_POOL_LAST_SCRUBBED_TXG,
+	    &spa->spa_scrubbed_last_txg, B_FALSE);
+	if (error != 0 && error != ENOENT)
+		return (spa_vdev_err(rvd, VDEV_AUX_CORRUPT_DATA, EIO));
+
 	/*
 	 * Load the livelist deletion field. If a livelist is queued for
 	 * deletion, indicate that in the spa
@@ -4734,9 +4921,17 @@ spa_ld_get_props(spa_t *spa)
 		spa_prop_find(spa, ZPOOL_PROP_AUTOEXPAND, &spa->spa_autoexpand);
 		spa_prop_find(spa, ZPOOL_PROP_MULTIHOST, &spa->spa_multihost);
 		spa_prop_find(spa, ZPOOL_PROP_AUTOTRIM, &spa->spa_autotrim);
+		spa_prop_find(spa, ZPOOL_PROP_DEDUP_TABLE_QUOTA,
+		    &spa->spa_dedup_table_quota);
+		spa_prop_find(spa, ZPOOL_PROP_SCRUB_RATE_LIMIT,
+		    &spa->spa_scrub_rate_limit);
+		spa_prop_find(spa, ZPOOL_PROP_SCRUB_LATENCY_TARGET,
+		    &spa->spa_scrub_latency_target);
 		spa->spa_autoreplace = (autoreplace != 0);
 	}
 
+	spa_load_txg_log_time(spa);
+
 	/*
 	 * If we are importing a pool with missing top-level vdevs,
 	 * we enforce that the pool doesn't panic or get suspended on
@@ -6588,6 +6783,12 @@ spa_create(const char *pool, nvlist_t *nvroot, nvlist_t *props,
 	spa->spa_autoexpand = zpool_prop_default_numeric(ZPOOL_PROP_AUTOEXPAND);
 	spa->spa_multihost = zpool_prop_default_numeric(ZPOOL_PROP_MULTIHOST);
 	spa->spa_autotrim = zpool_prop_default_numeric(ZPOOL_PROP_AUTOTRIM);
+	spa->spa_dedup_table_quota =
+	    zpool_prop_default_numeric(ZPOOL_PROP_DEDUP_TABLE_QUOTA);
+	spa->spa_scrub_rate_limit =
+	    zpool_prop_default_numeric(ZPOOL_PROP_SCRUB_RATE_LIMIT);
+	spa->spa_scrub_latency_target =
+	    zpool_prop_default_numeric(ZPOOL_PROP_SCRUB_LATENCY_TARGET);
 
 	if (props != NULL) {
 		spa_configfile_set(spa, props, B_FALSE);
@@ -8792,6 +8993,18 @@ spa_scan_stop(spa_t *spa)
 
 int
 spa_scan(spa_t *spa, pool_scan_func_t func)
+{
+	return (spa_scan_range(spa, func, 0, 0));
+}
+
+/*
+ * Start a scan that only visits blocks born in [txgstart, txgend).  Zero
+ * for either bound means no limit on that side.  Only scrubs may be
+ * limited.
+ */
+int
+spa_scan_range(spa_t *spa, pool_scan_func_t func, uint64_t txgstart,
+    uint64_t txgend)
 {
 	ASSERT(spa_config_held(spa, SCL_ALL, RW_WRITER) == 0);
 
@@ -8816,7 +9029,13 @@ spa_scan(spa_t *spa, pool_scan_func_t func)
 	    !spa_feature_is_enabled(spa, SPA_FEATURE_HEAD_ERRLOG))
 		return (SET_ERROR(ENOTSUP));
 
-	return (dsl_scan(spa->spa_dsl_pool, func));
+	if ((txgstart != 0 || txgend != 0) && func != POOL_SCAN_SCRUB)
+		return (SET_ERROR(ENOTSUP));
+
+	if (txgend != 0 && txgstart >= txgend)
+		return (SET_ERROR(EINVAL));
+
+	return (dsl_scan(spa->spa_dsl_pool, func, txgstart, txgend));
 }
 
 /*
@@ -9063,6 +9282,10 @@ spa_async_suspend(spa_t *spa)
 	zthr_t *ll_condense_thread = spa->spa_livelist_condense_zthr;
 	if (ll_condense_thread != NULL)
 		zthr_cancel(ll_condense_thread);
+
+	zthr_t *arc_warm_thread = spa->spa_arc_warm_zthr;
+	if (arc_warm_thread != NULL)
+		zthr_cancel(arc_warm_thread);
 }
 
 void
@@ -9093,6 +9316,10 @@ spa_async_resume(spa_t *spa)
 	zthr_t *ll_condense_thread = spa->spa_livelist_condense_zthr;
 	if (ll_condense_thread != NULL)
 		zthr_resume(ll_condense_thread);
+
+	zthr_t *arc_warm_thread = spa->spa_arc_warm_zthr;
+	if (arc_warm_thread != NULL)
+		zthr_resume(arc_warm_thread);
 }
 
 static boolean_t
@@ -9170,13 +9397,19 @@ bpobj_enqueue_free_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
 	return (bpobj_enqueue_cb(arg, bp, B_TRUE, tx));
 }
 
+typedef struct spa_free_sync_arg {
+	zio_t			*sfsa_pio;
+	metaslab_free_batch_t	*sfsa_mfb;
+} spa_free_sync_arg_t;
+
 static int
 spa_free_sync_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
 {
-	zio_t *pio = arg;
+	spa_free_sync_arg_t *sfsa = arg;
+	zio_t *pio = sfsa->sfsa_pio;
 
-	zio_nowait(zio_free_sync(pio, pio->io_spa, dmu_tx_get_txg(tx), bp,
-	    pio->io_flags));
+	zio_nowait(zio_free_sync_batch(pio, pio->io_spa, dmu_tx_get_txg(tx),
+	    bp, pio->io_flags, sfsa->sfsa_mfb));
 	return (0);
 }
 
@@ -9195,9 +9428,13 @@ bpobj_spa_free_sync_cb(void *arg, const blkptr_t *bp, boolean_t bp_freed,
 static void
 spa_sync_frees(spa_t *spa, bplist_t *bpl, dmu_tx_t *tx)
 {
-	zio_t *zio = zio_root(spa, NULL, NULL, 0);
-	bplist_iterate(bpl, spa_free_sync_cb, zio, tx);
-	VERIFY(zio_wait(zio) == 0);
+	spa_free_sync_arg_t sfsa = {
+		.sfsa_pio = zio_root(spa, NULL, NULL, 0),
+		.sfsa_mfb = metaslab_free_batch_create(spa, dmu_tx_get_txg(tx)),
+	};
+	bplist_iterate(bpl, spa_free_sync_cb, &sfsa, tx);
+	metaslab_free_batch_destroy(sfsa.sfsa_mfb);
+	VERIFY(zio_wait(sfsa.sfsa_pio) == 0);
 }
 
 /*
@@ -9222,10 +9459,14 @@ spa_sync_deferred_frees(spa_t *spa, dmu_tx_t *tx)
 	 * activated the log space map feature in this TXG but we have
 	 * deferred frees from the previous TXG.
 	 */
-	zio_t *zio = zio_root(spa, NULL, NULL, 0);
+	spa_free_sync_arg_t sfsa = {
+		.sfsa_pio = zio_root(spa, NULL, NULL, 0),
+		.sfsa_mfb = metaslab_free_batch_create(spa, dmu_tx_get_txg(tx)),
+	};
 	VERIFY3U(bpobj_iterate(&spa->spa_deferred_bpobj,
-	    bpobj_spa_free_sync_cb, zio, tx), ==, 0);
-	VERIFY0(zio_wait(zio));
+	    bpobj_spa_free_sync_cb, &sfsa, tx), ==, 0);
+	metaslab_free_batch_destroy(sfsa.sfsa_mfb);
+	VERIFY0(zio_wait(sfsa.sfsa_pio));
 }
 
 static void
@@ -9628,9 +9869,18 @@ spa_sync_props(void *arg, dmu_tx_t *tx)
 						spa_async_request(spa,
 						    SPA_ASYNC_AUTOEXPAND);
 					break;
-				case ZPOOL_PROP_MULTIHOST:
+						case ZPOOL_PROP_MULTIHOST:
 					spa->spa_multihost = intval;
 					break;
+				case ZPOOL_PROP_DEDUP_TABLE_QUOTA:
+					spa->spa_dedup_table_quota = intval;
+					break;
+				case ZPOOL_PROP_SCRUB_RATE_LIMIT:
+					spa->spa_scrub_rate_limit = intval;
+					break;
+				case ZPOOL_PROP_SCRUB_LATENCY_TARGET:
+					spa->spa_scrub_latency_target = intval;
+					break;
 				default:
 					break;
 				}
@@ -9818,6 +10068,36 @@ spa_sync_adjust_vdev_max_queue_depth(spa_t *spa)
 	dedup->mc_alloc_throttle_enabled = zio_dva_throttle_enabled;
 }
 
+/*
+ * Record the first txg synced each day, so that block birth txgs can later be
+ * turned into an approximate age (see spa_get_txg_at_time()). Once the table
+ * is full, the oldest record is dropped.
+ */
+static void
+spa_sync_txg_log_time(spa_t *spa, dmu_tx_t *tx)
+{
+	spa_txg_log_time_t *stlt = spa->spa_txg_log_time;
+	uint64_t n = spa->spa_txg_log_time_count;
+	uint64_t now = gethrestime_sec();
+
+	if (n > 0 && now / SPA_TXG_LOG_TIME_INTERVAL <=
+	    stlt[n - 1].stlt_time / SPA_TXG_LOG_TIME_INTERVAL)
+		return;
+
+	if (n == SPA_TXG_LOG_TIME_ENTRIES) {
+		memmove(&stlt[0], &stlt[1], (n - 1) * sizeof (*stlt));
+		n--;
+	}
+
+	stlt[n].stlt_txg = tx->tx_txg;
+	stlt[n].stlt_time = now;
+	spa->spa_txg_log_time_count = ++n;
+
+	VERIFY0(zap_update(spa->spa_meta_objset, DMU_POOL_DIRECTORY_OBJECT,
+	    DMU_POOL_TXG_LOG_TIME, sizeof (uint64_t),
+	    n * sizeof (*stlt) / sizeof (uint64_t), stlt, tx));
+}
+
 static void
 spa_sync_condense_indirect(spa_t *spa, dmu_tx_t *tx)
 {
@@ -9835,6 +10115,27 @@ spa_sync_condense_indirect(spa_t *spa, dmu_tx_t *tx)
 	}
 }
 
+/*
+ * Charge the time since *start to the given sync phase of this txg and
+ * restart the clock for the next one.
+ */
+static inline void
+spa_sync_phase_done(spa_t *spa, spa_sync_phase_t phase, hrtime_t *start)
+{
+	hrtime_t now = gethrtime();
+
+	spa->spa_sync_phase_nsecs[phase] += now - *start;
+	*start = now;
+}
+
+/*
+ * The steps of a pass are not run concurrently: brt_sync(), ddt_sync(),
+ * the scan and the upgrade tasks all update the MOS pool directory and
+ * feature refcounts, and vdev_sync() must see the frees and allocations
+ * made by everything before it.  The datasets themselves are already
+ * synced in parallel by dsl_pool_sync() on dp_sync_taskq.  The time spent
+ * in each phase is exported in the pool's iostats and txgs kstats.
+ */
 static void
 spa_sync_iterate_to_convergence(spa_t *spa, dmu_tx_t *tx)
 {
@@ -9842,10 +10143,14 @@ spa_sync_iterate_to_convergence(spa_t *spa, dmu_tx_t *tx)
 	dsl_pool_t *dp = spa->spa_dsl_pool;
 	uint64_t txg = tx->tx_txg;
 	bplist_t *free_bpl = &spa->spa_free_bplist[txg & TXG_MASK];
+	hrtime_t *phase_nsecs = spa->spa_sync_phase_nsecs;
+	hrtime_t start, mos_nsecs;
 
 	do {
 		int pass = ++spa->spa_sync_pass;
 
+		start = gethrtime();
+		mos_nsecs = phase_nsecs[SPA_SYNC_PHASE_MOS];
 		spa_sync_config_object(spa, tx);
 		spa_sync_aux_dev(spa, &spa->spa_spares, tx,
 		    ZPOOL_CONFIG_SPARES, DMU_POOL_SPARES);
@@ -9853,6 +10158,10 @@ spa_sync_iterate_to_convergence(spa_t *spa, dmu_tx_t *tx)
 		    ZPOOL_CONFIG_L2CACHE, DMU_POOL_L2CACHE);
 		spa_errlog_sync(spa, txg);
 		dsl_pool_sync(dp, txg);
+		spa_sync_phase_done(spa, SPA_SYNC_PHASE_POOL, &start);
+		/* dsl_pool_sync_mos() accounts its own time. */
+		phase_nsecs[SPA_SYNC_PHASE_POOL] -=
+		    phase_nsecs[SPA_SYNC_PHASE_MOS] - mos_nsecs;
 
 		if (pass < zfs_sync_pass_deferred_free ||
 		    spa_feature_is_active(spa, SPA_FEATURE_LOG_SPACEMAP)) {
@@ -9872,20 +10181,26 @@ spa_sync_iterate_to_convergence(spa_t *spa, dmu_tx_t *tx)
 			bplist_iterate(free_bpl, bpobj_enqueue_alloc_cb,
 			    &spa->spa_deferred_bpobj, tx);
 		}
+		spa_sync_phase_done(spa, SPA_SYNC_PHASE_FREES, &start);
 
 		brt_sync(spa, txg);
+		spa_sync_phase_done(spa, SPA_SYNC_PHASE_BRT, &start);
 		ddt_sync(spa, txg);
+		spa_sync_phase_done(spa, SPA_SYNC_PHASE_DDT, &start);
 		dsl_scan_sync(dp, tx);
 		dsl_errorscrub_sync(dp, tx);
 		svr_sync(spa, tx);
 		spa_sync_upgrades(spa, tx);
+		spa_sync_phase_done(spa, SPA_SYNC_PHASE_SCAN, &start);
 
 		spa_flush_metaslabs(spa, tx);
+		spa_sync_phase_done(spa, SPA_SYNC_PHASE_LOG_FLUSH, &start);
 
 		vdev_t *vd = NULL;
 		while ((vd = txg_list_remove(&spa->spa_vdev_txg_list, txg))
 		    != NULL)
 			vdev_sync(vd, txg);
+		spa_sync_phase_done(spa, SPA_SYNC_PHASE_VDEV, &start);
 
 		if (pass == 1) {
 			/*
@@ -9933,6 +10248,7 @@ spa_sync_iterate_to_convergence(spa_t *spa, dmu_tx_t *tx)
 		}
 
 		spa_sync_deferred_frees(spa, tx);
+		spa_sync_phase_done(spa, SPA_SYNC_PHASE_DEFERRED_FREES, &start);
 	} while (dmu_objset_is_dirty(mos, txg));
 }
 
@@ -10034,6 +10350,8 @@ spa_sync(spa_t *spa, uint64_t txg)
 
 	spa->spa_syncing_txg = txg;
 	spa->spa_sync_pass = 0;
+	memset(spa->spa_sync_phase_nsecs, 0,
+	    sizeof (spa->spa_sync_phase_nsecs));
 
 	for (int i = 0; i < spa->spa_alloc_count; i++) {
 		mutex_enter(&spa->spa_allocs[i].spaa_lock);
@@ -10106,6 +10424,8 @@ spa_sync(spa_t *spa, uint64_t txg)
 
 	spa_sync_condense_indirect(spa, tx);
 
+	spa_sync_txg_log_time(spa, tx);
+
 	spa_sync_iterate_to_convergence(spa, tx);
 
 #ifdef ZFS_DEBUG
@@ -10129,7 +10449,11 @@ spa_sync(spa_t *spa, uint64_t txg)
 		ASSERT0(spa->spa_vdev_removal->svr_bytes_done[txg & TXG_MASK]);
 	}
 
+	hrtime_t config_start = gethrtime();
 	spa_sync_rewrite_vdev_config(spa, tx);
+	spa_sync_phase_done(spa, SPA_SYNC_PHASE_CONFIG, &config_start);
+	spa_iostats_sync_add(spa, spa->spa_sync_pass,
+	    spa->spa_sync_phase_nsecs);
 	dmu_tx_commit(tx);
 
 	taskq_cancel_id(system_delay_taskq, spa->spa_deadman_tqid);
@@ -10970,3 +11294,12 @@ ZFS_MODULE_VIRTUAL_PARAM_CALL(zfs_zio, zio_, taskq_write,
 
 ZFS_MODULE_PARAM(zfs_zio, zio_, taskq_write_tpq, UINT, ZMOD_RW,
 	"Number of CPUs per write issue taskq");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, taskq_cpu_affine, INT, ZMOD_RW,
+	"Select zio taskqs by the dispatching CPU");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, taskq_balance, INT, ZMOD_RW,
+	"Move zios from a busy zio taskq to an idle sibling");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, taskq_write_batch, UINT, ZMOD_RW,
+	"Maximum number of small writes run back to back per issue task");
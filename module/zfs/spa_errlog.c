@@ -688,10 +688,14 @@ spa_remove_healed_errors(spa_t *spa, avl_tree_t *s, avl_tree_t *l, dmu_tx_t *tx)
 	spa_error_entry_t *se;
 	void *cookie = NULL;
 
+	avl_tree_t *healed = &spa->spa_errlist_healed;
+
 	ASSERT(MUTEX_HELD(&spa->spa_errlog_lock));
 
-	while ((se = avl_destroy_nodes(&spa->spa_errlist_healed,
-	    &cookie)) != NULL) {
+	if (avl_numnodes(healed) == 0)
+		return;
+
+	for (se = avl_first(healed); se != NULL; se = AVL_NEXT(healed, se)) {
 		remove_error_from_list(spa, s, &se->se_bookmark);
 		remove_error_from_list(spa, l, &se->se_bookmark);
 
@@ -701,30 +705,43 @@ spa_remove_healed_errors(spa_t *spa, avl_tree_t *s, avl_tree_t *l, dmu_tx_t *tx)
 			    spa->spa_errlog_last, name, tx);
 			(void) zap_remove(spa->spa_meta_objset,
 			    spa->spa_errlog_scrub, name, tx);
-		} else {
-			errphys_to_name(&se->se_zep, name, sizeof (name));
+		}
+	}
+
+	/*
+	 * With head_errlog the healed errors have to be removed from the
+	 * error log of every head filesystem.  Walk each log's list of
+	 * heads once and remove all healed errors from it, rather than
+	 * walking the lists again for every healed error.
+	 */
+	if (spa_feature_is_enabled(spa, SPA_FEATURE_HEAD_ERRLOG)) {
+		uint64_t logs[2] = { spa->spa_errlog_last,
+		    spa->spa_errlog_scrub };
+
+		for (int i = 0; i < ARRAY_SIZE(logs); i++) {
 			zap_cursor_t zc;
 			zap_attribute_t za;
-			for (zap_cursor_init(&zc, spa->spa_meta_objset,
-			    spa->spa_errlog_last);
-			    zap_cursor_retrieve(&zc, &za) == 0;
-			    zap_cursor_advance(&zc)) {
-				zap_remove(spa->spa_meta_objset,
-				    za.za_first_integer, name, tx);
-			}
-			zap_cursor_fini(&zc);
+
+			if (logs[i] == 0)
+				continue;
 
 			for (zap_cursor_init(&zc, spa->spa_meta_objset,
-			    spa->spa_errlog_scrub);
-			    zap_cursor_retrieve(&zc, &za) == 0;
+			    logs[i]); zap_cursor_retrieve(&zc, &za) == 0;
 			    zap_cursor_advance(&zc)) {
-				zap_remove(spa->spa_meta_objset,
-				    za.za_first_integer, name, tx);
+				for (se = avl_first(healed); se != NULL;
+				    se = AVL_NEXT(healed, se)) {
+					errphys_to_name(&se->se_zep, name,
+					    sizeof (name));
+					(void) zap_remove(spa->spa_meta_objset,
+					    za.za_first_integer, name, tx);
+				}
 			}
 			zap_cursor_fini(&zc);
 		}
-		kmem_free(se, sizeof (spa_error_entry_t));
 	}
+
+	while ((se = avl_destroy_nodes(healed, &cookie)) != NULL)
+		kmem_free(se, sizeof (spa_error_entry_t));
 }
 
 /*
@@ -1182,6 +1199,15 @@ sync_error_list(spa_t *spa, avl_tree_t *t, uint64_t *obj, dmu_tx_t *tx)
 			    strlen(name) + 1, name, tx);
 		}
 	} else {
+		/*
+		 * The tree is sorted by bookmark, so all errors of a dataset
+		 * are adjacent.  Look up the head filesystem and its error
+		 * log once per run of errors rather than once per error,
+		 * which matters when a faulted device logs many thousands of
+		 * errors in a single txg.
+		 */
+		uint64_t objset = 0, err_obj = 0;
+
 		for (se = avl_first(t); se != NULL; se = AVL_NEXT(t, se)) {
 			zbookmark_err_phys_t zep;
 			zep.zb_object = se->se_zep.zb_object;
@@ -1189,28 +1215,33 @@ sync_error_list(spa_t *spa, avl_tree_t *t, uint64_t *obj, dmu_tx_t *tx)
 			zep.zb_blkid = se->se_zep.zb_blkid;
 			zep.zb_birth = se->se_zep.zb_birth;
 
-			uint64_t head_ds = 0;
-			int error = get_head_ds(spa, se->se_bookmark.zb_objset,
-			    &head_ds);
-
-			/*
-			 * If get_head_ds() errors out, set the head filesystem
-			 * to the filesystem stored in the bookmark of the
-			 * error block.
-			 */
-			if (error != 0)
-				head_ds = se->se_bookmark.zb_objset;
-
-			uint64_t err_obj;
-			error = zap_lookup_int_key(spa->spa_meta_objset,
-			    *obj, head_ds, &err_obj);
-
-			if (error == ENOENT) {
-				err_obj = zap_create(spa->spa_meta_objset,
-				    DMU_OT_ERROR_LOG, DMU_OT_NONE, 0, tx);
-
-				(void) zap_update_int_key(spa->spa_meta_objset,
-				    *obj, head_ds, err_obj, tx);
+			if (err_obj == 0 ||
+			    se->se_bookmark.zb_objset != objset) {
+				objset = se->se_bookmark.zb_objset;
+
+				/*
+				 * If get_head_ds() errors out, set the head
+				 * filesystem to the filesystem stored in the
+				 * bookmark of the error block.
+				 */
+				uint64_t head_ds = 0;
+				if (get_head_ds(spa, objset, &head_ds) != 0)
+					head_ds = objset;
+
+				int error = zap_lookup_int_key(
+				    spa->spa_meta_objset, *obj, head_ds,
+				    &err_obj);
+
+				if (error == ENOENT) {
+					err_obj = zap_create(
+					    spa->spa_meta_objset,
+					    DMU_OT_ERROR_LOG, DMU_OT_NONE,
+					    0, tx);
+
+					(void) zap_update_int_key(
+					    spa->spa_meta_objset, *obj,
+					    head_ds, err_obj, tx);
+				}
 			}
 			errphys_to_name(&zep, buf, sizeof (buf));
 
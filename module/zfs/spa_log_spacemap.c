@@ -264,6 +264,24 @@ static uint64_t zfs_unflushed_log_block_max = (1ULL << 17);
  */
 static uint64_t zfs_unflushed_log_txg_max = 1000;
 
+/*
+ * Rather than tuning the limits above, the import time can be bounded
+ * directly: if zfs_unflushed_log_replay_ms is set, the log block limit is
+ * also capped at the number of log blocks we expect to replay within that
+ * many milliseconds after an unclean export. The replay rate is the one
+ * measured when the pool was imported, or zfs_unflushed_log_replay_rate
+ * blocks per second if too few log blocks were replayed to tell. The cap
+ * never goes below zfs_unflushed_log_block_min.
+ */
+static uint64_t zfs_unflushed_log_replay_ms = 0;
+static uint64_t zfs_unflushed_log_replay_rate = 1000;
+
+/*
+ * Fewer log blocks than this replayed at import don't make for a
+ * meaningful measurement of the replay rate.
+ */
+#define	LOG_SM_REPLAY_RATE_MIN_BLOCKS	64
+
 /*
  * Max # of rows allowed for the log_summary. The tradeoff here is accuracy and
  * stability of the flushing algorithm (longer summary) vs its runtime overhead
@@ -344,8 +362,38 @@ spa_log_sm_set_blocklimit(spa_t *spa)
 		msdcount += e->lse_msdcount;
 
 	uint64_t limit = msdcount * zfs_unflushed_log_block_pct / 100;
-	spa->spa_unflushed_stats.sus_blocklimit = MIN(MAX(limit,
-	    zfs_unflushed_log_block_min), zfs_unflushed_log_block_max);
+	limit = MIN(MAX(limit, zfs_unflushed_log_block_min),
+	    zfs_unflushed_log_block_max);
+
+	if (zfs_unflushed_log_replay_ms != 0) {
+		uint64_t budget = spa_log_sm_replay_rate(spa) *
+		    zfs_unflushed_log_replay_ms / MILLISEC;
+		limit = MIN(limit, MAX(budget, zfs_unflushed_log_block_min));
+	}
+	spa->spa_unflushed_stats.sus_blocklimit = limit;
+}
+
+/*
+ * Log blocks replayed per second when the pool was imported, or the
+ * assumed zfs_unflushed_log_replay_rate if that wasn't measured.
+ */
+uint64_t
+spa_log_sm_replay_rate(spa_t *spa)
+{
+	uint64_t rate = spa->spa_unflushed_stats.sus_replay_rate;
+
+	return (rate != 0 ? rate : MAX(zfs_unflushed_log_replay_rate, 1));
+}
+
+/*
+ * How long reading the log space maps as they stand now would take if the
+ * pool had to be imported, in milliseconds.
+ */
+uint64_t
+spa_log_sm_replay_estimate_ms(spa_t *spa)
+{
+	return (spa_log_sm_nblocks(spa) * MILLISEC /
+	    spa_log_sm_replay_rate(spa));
 }
 
 uint64_t
@@ -819,6 +867,9 @@ spa_flush_metaslabs(spa_t *spa, dmu_tx_t *tx)
 	/* Used purely for verification purposes */
 	uint64_t visited = 0;
 
+	/* Metaslabs flushed for the block limit, memory limit or export */
+	uint64_t flushed_blocks = 0, flushed_memory = 0, flushed_all = 0;
+
 	/*
 	 * Ideally we would only iterate through spa_metaslabs_by_flushed
 	 * using only one variable (curr). We can't do that because
@@ -852,6 +903,12 @@ spa_flush_metaslabs(spa_t *spa, dmu_tx_t *tx)
 			metaslab_flush(curr, tx);
 			mutex_exit(&curr->ms_lock);
 			mutex_exit(&curr->ms_sync_lock);
+			if (spa_flush_all_logs_requested(spa))
+				flushed_all++;
+			else if (want_to_flush > 0)
+				flushed_blocks++;
+			else
+				flushed_memory++;
 			if (want_to_flush > 0)
 				want_to_flush--;
 		} else
@@ -861,6 +918,8 @@ spa_flush_metaslabs(spa_t *spa, dmu_tx_t *tx)
 	}
 	ASSERT3U(avl_numnodes(&spa->spa_metaslabs_by_flushed), >=, visited);
 
+	spa_iostats_log_flush_add(spa, flushed_blocks, flushed_memory,
+	    flushed_all);
 	spa_log_sm_set_blocklimit(spa);
 }
 
@@ -1067,16 +1126,86 @@ spa_ld_log_sm_metadata(spa_t *spa)
 	return (0);
 }
 
+/*
+ * With more than one top-level vdev, log space map entries are applied to
+ * their metaslabs' unflushed trees on a taskq, one task per top-level vdev,
+ * in batches of up to SPA_LD_LOG_SM_BATCH entries per vdev. The batches
+ * are only dispatched together, and all of them are applied before any
+ * more entries are queued, so every metaslab still sees its changes in
+ * log (TXG) order.
+ */
+#define	SPA_LD_LOG_SM_BATCH	1024
+
+typedef struct spa_ld_log_sm_batch {
+	vdev_t *sllb_vd;
+	uint64_t sllb_count;
+	space_map_entry_t *sllb_entries;
+} spa_ld_log_sm_batch_t;
+
 typedef struct spa_ld_log_sm_arg {
 	spa_t *slls_spa;
 	uint64_t slls_txg;
+	taskq_t *slls_tq;
+	spa_ld_log_sm_batch_t *slls_batches;	/* per top-level vdev */
 } spa_ld_log_sm_arg_t;
 
+static void
+spa_ld_log_sm_apply(vdev_t *vd, const space_map_entry_t *sme)
+{
+	uint64_t offset = sme->sme_offset;
+	uint64_t size = sme->sme_run;
+	metaslab_t *ms = vd->vdev_ms[offset >> vd->vdev_ms_shift];
+
+	switch (sme->sme_type) {
+	case SM_ALLOC:
+		range_tree_remove_xor_add_segment(offset, offset + size,
+		    ms->ms_unflushed_frees, ms->ms_unflushed_allocs);
+		break;
+	case SM_FREE:
+		range_tree_remove_xor_add_segment(offset, offset + size,
+		    ms->ms_unflushed_allocs, ms->ms_unflushed_frees);
+		break;
+	default:
+		panic("invalid maptype_t");
+		break;
+	}
+}
+
+static void
+spa_ld_log_sm_apply_batch(void *arg)
+{
+	spa_ld_log_sm_batch_t *sllb = arg;
+
+	for (uint64_t i = 0; i < sllb->sllb_count; i++)
+		spa_ld_log_sm_apply(sllb->sllb_vd, &sllb->sllb_entries[i]);
+	sllb->sllb_count = 0;
+}
+
+/*
+ * Apply all queued batches, and wait for them.
+ */
+static void
+spa_ld_log_sm_flush(spa_ld_log_sm_arg_t *slls)
+{
+	vdev_t *rvd = slls->slls_spa->spa_root_vdev;
+
+	if (slls->slls_tq == NULL)
+		return;
+
+	for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+		spa_ld_log_sm_batch_t *sllb = &slls->slls_batches[c];
+		if (sllb->sllb_count == 0)
+			continue;
+		VERIFY(taskq_dispatch(slls->slls_tq, spa_ld_log_sm_apply_batch,
+		    sllb, TQ_SLEEP) != TASKQID_INVALID);
+	}
+	taskq_wait(slls->slls_tq);
+}
+
 static int
 spa_ld_log_sm_cb(space_map_entry_t *sme, void *arg)
 {
 	uint64_t offset = sme->sme_offset;
-	uint64_t size = sme->sme_run;
 	uint32_t vdev_id = sme->sme_vdev;
 
 	spa_ld_log_sm_arg_t *slls = arg;
@@ -1105,19 +1234,20 @@ spa_ld_log_sm_cb(space_map_entry_t *sme, void *arg)
 	if (slls->slls_txg < metaslab_unflushed_txg(ms))
 		return (0);
 
-	switch (sme->sme_type) {
-	case SM_ALLOC:
-		range_tree_remove_xor_add_segment(offset, offset + size,
-		    ms->ms_unflushed_frees, ms->ms_unflushed_allocs);
-		break;
-	case SM_FREE:
-		range_tree_remove_xor_add_segment(offset, offset + size,
-		    ms->ms_unflushed_allocs, ms->ms_unflushed_frees);
-		break;
-	default:
-		panic("invalid maptype_t");
-		break;
+	if (slls->slls_tq == NULL) {
+		spa_ld_log_sm_apply(vd, sme);
+	} else {
+		spa_ld_log_sm_batch_t *sllb = &slls->slls_batches[vdev_id];
+		if (sllb->sllb_entries == NULL) {
+			sllb->sllb_vd = vd;
+			sllb->sllb_entries = vmem_alloc(SPA_LD_LOG_SM_BATCH *
+			    sizeof (space_map_entry_t), KM_SLEEP);
+		}
+		sllb->sllb_entries[sllb->sllb_count++] = *sme;
+		if (sllb->sllb_count == SPA_LD_LOG_SM_BATCH)
+			spa_ld_log_sm_flush(slls);
 	}
+
 	if (!metaslab_unflushed_dirty(ms)) {
 		metaslab_set_unflushed_dirty(ms, B_TRUE);
 		spa_log_summary_dirty_flushed_metaslab(spa,
@@ -1127,9 +1257,10 @@ spa_ld_log_sm_cb(space_map_entry_t *sme, void *arg)
 }
 
 static int
-spa_ld_log_sm_data(spa_t *spa)
+spa_ld_log_sm_data(spa_t *spa, taskq_t *tq)
 {
 	spa_log_sm_t *sls, *psls;
+	vdev_t *rvd = spa->spa_root_vdev;
 	int error = 0;
 
 	/*
@@ -1151,6 +1282,15 @@ spa_ld_log_sm_data(spa_t *spa)
 		    ZIO_PRIORITY_SYNC_READ);
 	}
 
+	struct spa_ld_log_sm_arg vla = {
+		.slls_spa = spa,
+		.slls_tq = tq
+	};
+	if (tq != NULL) {
+		vla.slls_batches = kmem_zalloc(rvd->vdev_children *
+		    sizeof (spa_ld_log_sm_batch_t), KM_SLEEP);
+	}
+
 	uint_t pn = 0;
 	uint64_t ps = 0;
 	uint64_t nsm = 0;
@@ -1190,10 +1330,7 @@ spa_ld_log_sm_data(spa_t *spa)
 		    "Read %llu of %lu log space maps", (u_longlong_t)nsm,
 		    avl_numnodes(&spa->spa_sm_logs_by_txg));
 
-		struct spa_ld_log_sm_arg vla = {
-			.slls_spa = spa,
-			.slls_txg = sls->sls_txg
-		};
+		vla.slls_txg = sls->sls_txg;
 		error = space_map_iterate(sls->sls_sm,
 		    space_map_length(sls->sls_sm), spa_ld_log_sm_cb, &vla);
 		if (error != 0) {
@@ -1214,15 +1351,40 @@ spa_ld_log_sm_data(spa_t *spa)
 		spa_log_sm_set_blocklimit(spa);
 	}
 
+	spa_ld_log_sm_flush(&vla);
+
 	hrtime_t read_logs_endtime = gethrtime();
+	hrtime_t read_logs_time = read_logs_endtime - read_logs_starttime;
 	spa_load_note(spa,
 	    "Read %lu log space maps (%llu total blocks - blksz = %llu bytes) "
 	    "in %lld ms", avl_numnodes(&spa->spa_sm_logs_by_txg),
 	    (u_longlong_t)spa_log_sm_nblocks(spa),
 	    (u_longlong_t)zfs_log_sm_blksz,
-	    (longlong_t)NSEC2MSEC(read_logs_endtime - read_logs_starttime));
+	    (longlong_t)NSEC2MSEC(read_logs_time));
+
+	/* Remember the replay rate to plan flushes against the budget. */
+	if (spa_log_sm_nblocks(spa) >= LOG_SM_REPLAY_RATE_MIN_BLOCKS &&
+	    read_logs_time > 0) {
+		spa->spa_unflushed_stats.sus_replay_rate = MAX(1,
+		    spa_log_sm_nblocks(spa) * NANOSEC / read_logs_time);
+		spa_log_sm_set_blocklimit(spa);
+	}
 
 out:
+	if (tq != NULL) {
+		spa_ld_log_sm_flush(&vla);
+		for (uint64_t c = 0; c < rvd->vdev_children; c++) {
+			spa_ld_log_sm_batch_t *sllb = &vla.slls_batches[c];
+			if (sllb->sllb_entries != NULL) {
+				vmem_free(sllb->sllb_entries,
+				    SPA_LD_LOG_SM_BATCH *
+				    sizeof (space_map_entry_t));
+			}
+		}
+		kmem_free(vla.slls_batches, rvd->vdev_children *
+		    sizeof (spa_ld_log_sm_batch_t));
+	}
+
 	if (error != 0) {
 		for (spa_log_sm_t *sls = avl_first(&spa->spa_sm_logs_by_txg);
 		    sls; sls = AVL_NEXT(&spa->spa_sm_logs_by_txg, sls)) {
@@ -1327,29 +1489,65 @@ spa_ld_unflushed_txgs(vdev_t *vd)
 	return (0);
 }
 
+typedef struct spa_ld_unflushed_arg {
+	vdev_t *slua_vd;
+	int slua_error;
+} spa_ld_unflushed_arg_t;
+
+static void
+spa_ld_unflushed_txgs_task(void *arg)
+{
+	spa_ld_unflushed_arg_t *slua = arg;
+
+	slua->slua_error = spa_ld_unflushed_txgs(slua->slua_vd);
+}
+
 /*
  * Read all the log space map entries into their respective
  * metaslab unflushed trees and keep them sorted by TXG in the
  * SPA's metadata. In addition, setup all the metadata for the
  * memory and the block heuristics.
+ *
+ * With several top-level vdevs, their unflushed TXGs are read and the
+ * log entries applied to their metaslabs in parallel.
  */
 int
 spa_ld_log_spacemaps(spa_t *spa)
 {
-	int error;
+	vdev_t *rvd = spa->spa_root_vdev;
+	uint64_t children = rvd->vdev_children;
+	taskq_t *tq = NULL;
+	int error = 0;
 
 	spa_log_sm_set_blocklimit(spa);
 
-	for (uint64_t c = 0; c < spa->spa_root_vdev->vdev_children; c++) {
-		vdev_t *vd = spa->spa_root_vdev->vdev_child[c];
-		error = spa_ld_unflushed_txgs(vd);
-		if (error != 0)
-			return (error);
+	if (children > 1) {
+		tq = taskq_create("spa_ld_log_sm", children, minclsyspri,
+		    children, children, TASKQ_PREPOPULATE);
 	}
 
+	spa_ld_unflushed_arg_t *slua = kmem_zalloc(children *
+	    sizeof (spa_ld_unflushed_arg_t), KM_SLEEP);
+	for (uint64_t c = 0; c < children; c++) {
+		slua[c].slua_vd = rvd->vdev_child[c];
+		if (tq == NULL) {
+			spa_ld_unflushed_txgs_task(&slua[c]);
+		} else {
+			VERIFY(taskq_dispatch(tq, spa_ld_unflushed_txgs_task,
+			    &slua[c], TQ_SLEEP) != TASKQID_INVALID);
+		}
+	}
+	if (tq != NULL)
+		taskq_wait(tq);
+	for (uint64_t c = 0; c < children && error == 0; c++)
+		error = slua[c].slua_error;
+	kmem_free(slua, children * sizeof (spa_ld_unflushed_arg_t));
+	if (error != 0)
+		goto out;
+
 	error = spa_ld_log_sm_metadata(spa);
 	if (error != 0)
-		return (error);
+		goto out;
 
 	/*
 	 * Note: we don't actually expect anything to change at this point
@@ -1357,9 +1555,12 @@ spa_ld_log_spacemaps(spa_t *spa)
 	 * when using vdev_lookup_top().
 	 */
 	spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
-	error = spa_ld_log_sm_data(spa);
+	error = spa_ld_log_sm_data(spa, tq);
 	spa_config_exit(spa, SCL_CONFIG, FTAG);
 
+out:
+	if (tq != NULL)
+		taskq_destroy(tq);
 	return (error);
 }
 
@@ -1385,6 +1586,14 @@ ZFS_MODULE_PARAM(zfs, zfs_, unflushed_log_txg_max, U64, ZMOD_RW,
     "Hard limit (upper-bound) in the size of the space map log "
     "in terms of dirty TXGs.");
 
+ZFS_MODULE_PARAM(zfs, zfs_, unflushed_log_replay_ms, U64, ZMOD_RW,
+	"Cap the log spacemap at what can be replayed on import in this many "
+	"milliseconds (0 disables)");
+
+ZFS_MODULE_PARAM(zfs, zfs_, unflushed_log_replay_rate, U64, ZMOD_RW,
+	"Log spacemap blocks replayed per second assumed until measured "
+	"at import");
+
 ZFS_MODULE_PARAM(zfs, zfs_, unflushed_log_block_pct, UINT, ZMOD_RW,
 	"Tunable used to determine the number of blocks that can be used for "
 	"the spacemap log, expressed as a percentage of the total number of "
@@ -391,14 +391,15 @@ static const uint64_t spa_min_slop = 128ULL * 1024 * 1024;
 static const uint64_t spa_max_slop = 128ULL * 1024 * 1024 * 1024;
 
 /*
- * Number of allocators to use, per spa instance
+ * Number of allocators to use, per spa instance (0 = one per
+ * spa_cpus_per_allocator CPUs, uncapped)
  */
 static int spa_num_allocators = 4;
 static int spa_cpus_per_allocator = 4;
 
 /*
  * Spa active allocator.
- * Valid values are zfs_active_allocator=<dynamic|cursor|new-dynamic>.
+ * Valid values are zfs_active_allocator=<dynamic|cursor|segregated>.
  */
 const char *zfs_active_allocator = "dynamic";
 
@@ -445,6 +446,24 @@ static int zfs_user_indirect_is_special = B_TRUE;
  */
 static uint_t zfs_special_class_metadata_reserve_pct = 25;
 
+/*
+ * The percentage of special class final space which dedup tables stored in
+ * the special class may not use, so that pool metadata keeps the last of
+ * it once the class fills up.  This should not be larger than
+ * zfs_special_class_metadata_reserve_pct, as dedup tables are worth more
+ * on fast storage than small file blocks are.
+ */
+static uint_t zfs_special_class_ddt_reserve_pct = 0;
+
+/*
+ * On raidz and draid, a block smaller than a full stripe still pays for
+ * a full set of parity sectors plus padding. If the normal class has such
+ * vdevs, file blocks up to this size are steered to the special class as
+ * if special_small_blocks were at least this large, subject to the same
+ * metadata reserve.
+ */
+static uint_t zfs_special_class_raidz_small_blocks = 0;
+
 /*
  * ==========================================================================
  * SPA config locking
@@ -715,6 +734,8 @@ spa_add(const char *name, nvlist_t *config, const char *altroot)
 	mutex_init(&spa->spa_flushed_ms_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&spa->spa_activities_lock, NULL, MUTEX_DEFAULT, NULL);
 
+	spa->spa_compress_auto = zio_compress_auto_create();
+
 	cv_init(&spa->spa_async_cv, NULL, CV_DEFAULT, NULL);
 	cv_init(&spa->spa_evicting_os_cv, NULL, CV_DEFAULT, NULL);
 	cv_init(&spa->spa_proc_cv, NULL, CV_DEFAULT, NULL);
@@ -755,8 +776,10 @@ spa_add(const char *name, nvlist_t *config, const char *altroot)
 		spa->spa_root = spa_strdup(altroot);
 
 	/* Do not allow more allocators than fraction of CPUs. */
-	spa->spa_alloc_count = MAX(MIN(spa_num_allocators,
-	    boot_ncpus / MAX(spa_cpus_per_allocator, 1)), 1);
+	int alloc_count = boot_ncpus / MAX(spa_cpus_per_allocator, 1);
+	if (spa_num_allocators > 0)
+		alloc_count = MIN(alloc_count, spa_num_allocators);
+	spa->spa_alloc_count = MAX(alloc_count, 1);
 
 	spa->spa_allocs = kmem_zalloc(spa->spa_alloc_count *
 	    sizeof (spa_alloc_t), KM_SLEEP);
@@ -893,6 +916,7 @@ spa_remove(spa_t *spa)
 		bplist_destroy(&spa->spa_free_bplist[t]);
 
 	zio_checksum_templates_free(spa);
+	zio_compress_auto_destroy(spa->spa_compress_auto);
 
 	cv_destroy(&spa->spa_async_cv);
 	cv_destroy(&spa->spa_evicting_os_cv);
@@ -1814,6 +1838,16 @@ spa_final_dirty_txg(spa_t *spa)
 	return (spa->spa_final_txg - TXG_DEFER_SIZE);
 }
 
+/*
+ * Return the txg up to which the last complete scrub verified all blocks
+ * (0 if there has been none). Blocks born at or after it are new.
+ */
+uint64_t
+spa_get_last_scrubbed_txg(spa_t *spa)
+{
+	return (spa->spa_scrubbed_last_txg);
+}
+
 pool_state_t
 spa_state(spa_t *spa)
 {
@@ -1999,6 +2033,20 @@ spa_dedup_class(spa_t *spa)
 /*
  * Locate an appropriate allocation class
  */
+/*
+ * Returns B_TRUE if less than (100 - reserve_pct)% of the special class
+ * is allocated.
+ */
+static boolean_t
+spa_special_has_room(spa_t *spa, uint_t reserve_pct)
+{
+	metaslab_class_t *special = spa_special_class(spa);
+	uint64_t alloc = metaslab_class_get_alloc(special);
+	uint64_t space = metaslab_class_get_space(special);
+
+	return (alloc < space * (100 - MIN(reserve_pct, 100)) / 100);
+}
+
 metaslab_class_t *
 spa_preferred_class(spa_t *spa, uint64_t size, dmu_object_type_t objtype,
     uint_t level, uint_t special_smallblk)
@@ -2013,7 +2061,9 @@ spa_preferred_class(spa_t *spa, uint64_t size, dmu_object_type_t objtype,
 	if (DMU_OT_IS_DDT(objtype)) {
 		if (spa->spa_dedup_class->mc_groups != 0)
 			return (spa_dedup_class(spa));
-		else if (has_special_class && zfs_ddt_data_is_special)
+		else if (has_special_class && zfs_ddt_data_is_special &&
+		    spa_special_has_room(spa,
+		    zfs_special_class_ddt_reserve_pct))
 			return (spa_special_class(spa));
 		else
 			return (spa_normal_class(spa));
@@ -2034,23 +2084,19 @@ spa_preferred_class(spa_t *spa, uint64_t size, dmu_object_type_t objtype,
 			return (spa_normal_class(spa));
 	}
 
+	if (spa->spa_max_nparity > 0 &&
+	    zfs_special_class_raidz_small_blocks > special_smallblk)
+		special_smallblk = zfs_special_class_raidz_small_blocks;
+
 	/*
 	 * Allow small file blocks in special class in some cases (like
 	 * for the dRAID vdev feature). But always leave a reserve of
 	 * zfs_special_class_metadata_reserve_pct exclusively for metadata.
 	 */
 	if (DMU_OT_IS_FILE(objtype) &&
-	    has_special_class && size <= special_smallblk) {
-		metaslab_class_t *special = spa_special_class(spa);
-		uint64_t alloc = metaslab_class_get_alloc(special);
-		uint64_t space = metaslab_class_get_space(special);
-		uint64_t limit =
-		    (space * (100 - zfs_special_class_metadata_reserve_pct))
-		    / 100;
-
-		if (alloc < limit)
-			return (special);
-	}
+	    has_special_class && size <= special_smallblk &&
+	    spa_special_has_room(spa, zfs_special_class_metadata_reserve_pct))
+		return (spa_special_class(spa));
 
 	return (spa_normal_class(spa));
 }
@@ -2567,7 +2613,6 @@ spa_init(spa_mode_t mode)
 	zpool_feature_init();
 	spa_config_load();
 	vdev_prop_init();
-	l2arc_start();
 	scan_init();
 	qat_init();
 	spa_import_progress_init();
@@ -2576,8 +2621,6 @@ spa_init(spa_mode_t mode)
 void
 spa_fini(void)
 {
-	l2arc_stop();
-
 	spa_evict_all();
 
 	vdev_file_fini();
@@ -2811,6 +2854,27 @@ spa_get_last_removal_txg(spa_t *spa)
 	return (ret);
 }
 
+/*
+ * Return a txg that was synced at or before the given time, so that any block
+ * born before it is older than that time, or 0 if there is no record that old.
+ * The records are only updated in syncing context, so this must be called
+ * from there too, or with the pool otherwise quiesced.
+ */
+uint64_t
+spa_get_txg_at_time(spa_t *spa, uint64_t time)
+{
+	uint64_t txg = 0;
+
+	for (uint64_t i = 0; i < spa->spa_txg_log_time_count; i++) {
+		spa_txg_log_time_t *stlt = &spa->spa_txg_log_time[i];
+		if (stlt->stlt_time > time)
+			break;
+		txg = stlt->stlt_txg;
+	}
+
+	return (txg);
+}
+
 int
 spa_maxdnodesize(spa_t *spa)
 {
@@ -3027,6 +3091,7 @@ EXPORT_SYMBOL(spa_guid);
 EXPORT_SYMBOL(spa_last_synced_txg);
 EXPORT_SYMBOL(spa_first_txg);
 EXPORT_SYMBOL(spa_syncing_txg);
+EXPORT_SYMBOL(spa_get_last_scrubbed_txg);
 EXPORT_SYMBOL(spa_version);
 EXPORT_SYMBOL(spa_state);
 EXPORT_SYMBOL(spa_load_state);
@@ -3117,11 +3182,22 @@ ZFS_MODULE_PARAM_CALL(zfs_deadman, zfs_deadman_, ziotime_ms,
 ZFS_MODULE_PARAM(zfs, zfs_, special_class_metadata_reserve_pct, UINT, ZMOD_RW,
 	"Small file blocks in special vdevs depends on this much "
 	"free space available");
+
+ZFS_MODULE_PARAM(zfs, zfs_, special_class_ddt_reserve_pct, UINT, ZMOD_RW,
+	"Percentage of the special class reserved from dedup tables for "
+	"metadata");
+
+ZFS_MODULE_PARAM(zfs, zfs_, special_class_raidz_small_blocks, UINT, ZMOD_RW,
+	"Place file blocks up to this size in the special class when the "
+	"pool has raidz or draid vdevs");
 /* END CSTYLED */
 
 ZFS_MODULE_PARAM_CALL(zfs_spa, spa_, slop_shift, param_set_slop_shift,
 	param_get_uint, ZMOD_RW, "Reserved free space in pool");
 
+ZFS_MODULE_PARAM_CALL(zfs, zfs_, active_allocator, param_set_active_allocator,
+	param_get_charp, ZMOD_RW, "Block allocator for newly imported pools");
+
 ZFS_MODULE_PARAM(zfs, spa_, num_allocators, INT, ZMOD_RW,
 	"Number of allocators per spa");
 
@@ -23,6 +23,7 @@
 #include <sys/spa_impl.h>
 #include <sys/vdev_impl.h>
 #include <sys/spa.h>
+#include <sys/zio_impl.h>
 #include <zfs_comutil.h>
 
 /*
@@ -45,6 +46,17 @@ static uint_t zfs_txg_history = 100;
  */
 static uint_t zfs_multihost_history = B_FALSE;
 
+/*
+ * Sample one in N arc_read()/arc_write() calls into the per-object heatmap,
+ * disabled by default.
+ */
+static uint_t zfs_heatmap_sample_rate = 0;
+
+/*
+ * Number of distinct objset/object/level keys tracked by the heatmap.
+ */
+static uint_t zfs_heatmap_entries = 256;
+
 /*
  * ==========================================================================
  * SPA Read History Routines
@@ -180,6 +192,219 @@ spa_read_history_add(spa_t *spa, const zbookmark_phys_t *zb, uint32_t aflags)
 	mutex_exit(&shl->procfs_list.pl_lock);
 }
 
+/*
+ * ==========================================================================
+ * SPA Object Heatmap Routines
+ * ==========================================================================
+ */
+
+/*
+ * Per-object access counts.  A sampled subset of the pool's arc_read() and
+ * arc_write() calls is counted against the objset/object/level of the block
+ * in a bounded "space-saving" top-K sketch: when all zfs_heatmap_entries
+ * slots are in use, the entry with the lowest count is recycled for the new
+ * key and its count is inherited, which keeps the hottest keys resident at
+ * the cost of overestimating newcomers by at most 'error' samples.
+ */
+typedef struct spa_heatmap_entry {
+	uint64_t	objset;		/* objset of the sampled block */
+	uint64_t	object;		/* object of the sampled block */
+	uint64_t	level;		/* indirection level of the block */
+	uint64_t	count;		/* total samples, including error */
+	uint64_t	error;		/* count inherited on recycling */
+	uint64_t	reads;		/* sampled arc_read() calls */
+	uint64_t	misses;		/* sampled reads which missed the ARC */
+	uint64_t	writes;		/* sampled arc_write() calls */
+	avl_node_t	she_avl;
+	procfs_list_node_t	she_node;
+} spa_heatmap_entry_t;
+
+static int
+spa_heatmap_compare(const void *a, const void *b)
+{
+	const spa_heatmap_entry_t *ha = a;
+	const spa_heatmap_entry_t *hb = b;
+
+	int cmp = TREE_CMP(ha->objset, hb->objset);
+	if (cmp != 0)
+		return (cmp);
+
+	cmp = TREE_CMP(ha->object, hb->object);
+	if (cmp != 0)
+		return (cmp);
+
+	return (TREE_CMP(ha->level, hb->level));
+}
+
+static int
+spa_heatmap_show_header(struct seq_file *f)
+{
+	seq_printf(f, "%-8s %-8s %-8s %-12s %-12s %-12s %-12s %-12s\n",
+	    "objset", "object", "level", "count", "error", "reads",
+	    "misses", "writes");
+
+	return (0);
+}
+
+static int
+spa_heatmap_show(struct seq_file *f, void *data)
+{
+	spa_heatmap_entry_t *she = (spa_heatmap_entry_t *)data;
+
+	seq_printf(f, "0x%-6llx %-8lli %-8lli %-12llu %-12llu %-12llu "
+	    "%-12llu %-12llu\n",
+	    (u_longlong_t)she->objset, (longlong_t)she->object,
+	    (longlong_t)she->level, (u_longlong_t)she->count,
+	    (u_longlong_t)she->error, (u_longlong_t)she->reads,
+	    (u_longlong_t)she->misses, (u_longlong_t)she->writes);
+
+	return (0);
+}
+
+/* Remove oldest elements from list until there are no more than 'size' left */
+static void
+spa_heatmap_truncate(spa_heatmap_t *shm, unsigned int size)
+{
+	spa_heatmap_entry_t *she;
+	while (shm->size > size) {
+		she = list_remove_head(&shm->procfs_list.pl_list);
+		ASSERT3P(she, !=, NULL);
+		avl_remove(&shm->tree, she);
+		kmem_free(she, sizeof (spa_heatmap_entry_t));
+		shm->size--;
+	}
+
+	if (size == 0) {
+		ASSERT(list_is_empty(&shm->procfs_list.pl_list));
+		ASSERT0(avl_numnodes(&shm->tree));
+	}
+}
+
+static int
+spa_heatmap_clear(procfs_list_t *procfs_list)
+{
+	spa_heatmap_t *shm = procfs_list->pl_private;
+	mutex_enter(&procfs_list->pl_lock);
+	spa_heatmap_truncate(shm, 0);
+	mutex_exit(&procfs_list->pl_lock);
+	return (0);
+}
+
+static void
+spa_heatmap_init(spa_t *spa)
+{
+	spa_heatmap_t *shm = &spa->spa_stats.heatmap;
+
+	shm->size = 0;
+	avl_create(&shm->tree, spa_heatmap_compare,
+	    sizeof (spa_heatmap_entry_t),
+	    offsetof(spa_heatmap_entry_t, she_avl));
+	shm->procfs_list.pl_private = shm;
+	procfs_list_install("zfs",
+	    spa_name(spa),
+	    "heatmap",
+	    0600,
+	    &shm->procfs_list,
+	    spa_heatmap_show,
+	    spa_heatmap_show_header,
+	    spa_heatmap_clear,
+	    offsetof(spa_heatmap_entry_t, she_node));
+}
+
+static void
+spa_heatmap_destroy(spa_t *spa)
+{
+	spa_heatmap_t *shm = &spa->spa_stats.heatmap;
+	procfs_list_uninstall(&shm->procfs_list);
+	spa_heatmap_truncate(shm, 0);
+	procfs_list_destroy(&shm->procfs_list);
+	avl_destroy(&shm->tree);
+}
+
+/*
+ * Return the entry with the lowest count, the one the space-saving
+ * algorithm recycles.  This is a linear walk, but it is only taken for a
+ * sampled access to a key which is not already resident in a full sketch.
+ */
+static spa_heatmap_entry_t *
+spa_heatmap_min(spa_heatmap_t *shm)
+{
+	spa_heatmap_entry_t *she, *min = NULL;
+
+	for (she = list_head(&shm->procfs_list.pl_list); she != NULL;
+	    she = list_next(&shm->procfs_list.pl_list, she)) {
+		if (min == NULL || she->count < min->count)
+			min = she;
+	}
+
+	return (min);
+}
+
+void
+spa_heatmap_add(spa_t *spa, const zbookmark_phys_t *zb, spa_heatmap_op_t op)
+{
+	spa_heatmap_t *shm = &spa->spa_stats.heatmap;
+	spa_heatmap_entry_t search, *she;
+	avl_index_t where;
+	uint_t rate = zfs_heatmap_sample_rate;
+	uint_t entries = zfs_heatmap_entries;
+
+	ASSERT3P(spa, !=, NULL);
+	ASSERT3P(zb,  !=, NULL);
+
+	if (rate == 0 || entries == 0)
+		return;
+
+	if (rate > 1 && random_in_range(rate) != 0)
+		return;
+
+	search.objset = zb->zb_objset;
+	search.object = zb->zb_object;
+	search.level = zb->zb_level;
+
+	mutex_enter(&shm->procfs_list.pl_lock);
+
+	spa_heatmap_truncate(shm, entries);
+
+	she = avl_find(&shm->tree, &search, &where);
+	if (she == NULL) {
+		if (shm->size < entries) {
+			she = kmem_zalloc(sizeof (spa_heatmap_entry_t),
+			    KM_NOSLEEP);
+			if (she == NULL) {
+				mutex_exit(&shm->procfs_list.pl_lock);
+				return;
+			}
+			procfs_list_add(&shm->procfs_list, she);
+			shm->size++;
+		} else {
+			she = spa_heatmap_min(shm);
+			avl_remove(&shm->tree, she);
+			she->error = she->count;
+			she->reads = she->misses = she->writes = 0;
+		}
+		she->objset = search.objset;
+		she->object = search.object;
+		she->level = search.level;
+		avl_insert(&shm->tree, she, where);
+	}
+
+	she->count++;
+	switch (op) {
+	case SPA_HEATMAP_MISS:
+		she->misses++;
+		zfs_fallthrough;
+	case SPA_HEATMAP_READ:
+		she->reads++;
+		break;
+	case SPA_HEATMAP_WRITE:
+		she->writes++;
+		break;
+	}
+
+	mutex_exit(&shm->procfs_list.pl_lock);
+}
+
 /*
  * ==========================================================================
  * SPA TXG History Routines
@@ -199,16 +424,26 @@ typedef struct spa_txg_history {
 	uint64_t	writes;		/* number of write operations */
 	uint64_t	ndirty;		/* number of dirty bytes */
 	hrtime_t	times[TXG_STATE_COMMITTED]; /* completion times */
+	hrtime_t	phase_nsecs[SPA_SYNC_NUM_PHASES]; /* spa_sync() */
 	procfs_list_node_t	sth_node;
 } spa_txg_history_t;
 
+/* Column names of the spa_sync() phase times, see spa_sync_phase_t */
+static const char *const spa_txg_history_phases[SPA_SYNC_NUM_PHASES] = {
+	"pool", "mos", "frees", "brt", "ddt", "scan", "logflush", "vdev",
+	"dfrees", "config"
+};
+
 static int
 spa_txg_history_show_header(struct seq_file *f)
 {
 	seq_printf(f, "%-8s %-16s %-5s %-12s %-12s %-12s "
-	    "%-8s %-8s %-12s %-12s %-12s %-12s\n", "txg", "birth", "state",
+	    "%-8s %-8s %-12s %-12s %-12s %-12s", "txg", "birth", "state",
 	    "ndirty", "nread", "nwritten", "reads", "writes",
 	    "otime", "qtime", "wtime", "stime");
+	for (int p = 0; p < SPA_SYNC_NUM_PHASES; p++)
+		seq_printf(f, " %-12s", spa_txg_history_phases[p]);
+	seq_printf(f, "\n");
 	return (0);
 }
 
@@ -246,13 +481,18 @@ spa_txg_history_show(struct seq_file *f, void *data)
 		    sth->times[TXG_STATE_WAIT_FOR_SYNC];
 
 	seq_printf(f, "%-8llu %-16llu %-5c %-12llu "
-	    "%-12llu %-12llu %-8llu %-8llu %-12llu %-12llu %-12llu %-12llu\n",
+	    "%-12llu %-12llu %-8llu %-8llu %-12llu %-12llu %-12llu %-12llu",
 	    (longlong_t)sth->txg, sth->times[TXG_STATE_BIRTH], state,
 	    (u_longlong_t)sth->ndirty,
 	    (u_longlong_t)sth->nread, (u_longlong_t)sth->nwritten,
 	    (u_longlong_t)sth->reads, (u_longlong_t)sth->writes,
 	    (u_longlong_t)open, (u_longlong_t)quiesce, (u_longlong_t)wait,
 	    (u_longlong_t)sync);
+	for (int p = 0; p < SPA_SYNC_NUM_PHASES; p++) {
+		seq_printf(f, " %-12llu",
+		    (u_longlong_t)sth->phase_nsecs[p]);
+	}
+	seq_printf(f, "\n");
 
 	return (0);
 }
@@ -396,6 +636,35 @@ spa_txg_history_set_io(spa_t *spa, uint64_t txg, uint64_t nread,
 	return (error);
 }
 
+/*
+ * Set txg spa_sync() phase times.
+ */
+static int
+spa_txg_history_set_phases(spa_t *spa, uint64_t txg,
+    const hrtime_t *phase_nsecs)
+{
+	spa_history_list_t *shl = &spa->spa_stats.txg_history;
+	spa_txg_history_t *sth;
+	int error = ENOENT;
+
+	if (zfs_txg_history == 0)
+		return (0);
+
+	mutex_enter(&shl->procfs_list.pl_lock);
+	for (sth = list_tail(&shl->procfs_list.pl_list); sth != NULL;
+	    sth = list_prev(&shl->procfs_list.pl_list, sth)) {
+		if (sth->txg == txg) {
+			memcpy(sth->phase_nsecs, phase_nsecs,
+			    sizeof (sth->phase_nsecs));
+			error = 0;
+			break;
+		}
+	}
+	mutex_exit(&shl->procfs_list.pl_lock);
+
+	return (error);
+}
+
 txg_stat_t *
 spa_txg_history_init_io(spa_t *spa, uint64_t txg, dsl_pool_t *dp)
 {
@@ -440,6 +709,7 @@ spa_txg_history_fini_io(spa_t *spa, txg_stat_t *ts)
 	    ts->vs2.vs_ops[ZIO_TYPE_READ] - ts->vs1.vs_ops[ZIO_TYPE_READ],
 	    ts->vs2.vs_ops[ZIO_TYPE_WRITE] - ts->vs1.vs_ops[ZIO_TYPE_WRITE],
 	    ts->ndirty);
+	spa_txg_history_set_phases(spa, ts->txg, spa->spa_sync_phase_nsecs);
 
 	kmem_free(ts, sizeof (txg_stat_t));
 }
@@ -548,6 +818,129 @@ spa_tx_assign_add_nsecs(spa_t *spa, uint64_t nsecs)
 	atomic_inc_64(&((kstat_named_t *)shk->priv)[idx].value.ui64);
 }
 
+/*
+ * ==========================================================================
+ * SPA ZIO Stage Latency Histogram Routines
+ * ==========================================================================
+ */
+
+/*
+ * Time from entering each zio pipeline stage until entering the next one
+ * (or, for the done stage, until the zio is freed), in power of two
+ * nanosecond buckets.  Time a zio spends waiting in a taskq, the vdev
+ * queue or on the device is charged to the stage that sent it there.
+ * Only collected while zio_stage_histogram is set.
+ */
+static const char *const spa_zio_stage_names[ZIO_STAGES] = {
+	"open", "read_bp_init", "write_bp_init", "free_bp_init",
+	"issue_async", "write_compress", "encrypt", "checksum_generate",
+	"nop_write", "brt_free", "ddt_read_start", "ddt_read_done",
+	"ddt_write", "ddt_free", "gang_assemble", "gang_issue",
+	"dva_throttle", "dva_allocate", "dva_free", "dva_claim", "ready",
+	"vdev_io_start", "vdev_io_done", "vdev_io_assess",
+	"checksum_verify", "done",
+};
+
+static int
+spa_zio_stages_headers(char *buf, size_t size)
+{
+	int n = snprintf(buf, size, "%-18s", "stage");
+
+	for (int i = 0; i < VDEV_L_HISTO_BUCKETS && n < size; i++)
+		n += snprintf(buf + n, size - n, " %llu",
+		    (u_longlong_t)1 << i);
+	if (n < size)
+		(void) snprintf(buf + n, size - n, "\n");
+
+	return (0);
+}
+
+static int
+spa_zio_stages_data(char *buf, size_t size, void *data)
+{
+	uint64_t *histo = data;
+	uint64_t stage = histo[VDEV_L_HISTO_BUCKETS];
+	int n = snprintf(buf, size, "%-18s", spa_zio_stage_names[stage]);
+
+	for (int i = 0; i < VDEV_L_HISTO_BUCKETS && n < size; i++)
+		n += snprintf(buf + n, size - n, " %llu",
+		    (u_longlong_t)histo[i]);
+	if (n < size)
+		(void) snprintf(buf + n, size - n, "\n");
+
+	return (0);
+}
+
+static void *
+spa_zio_stages_addr(kstat_t *ksp, loff_t n)
+{
+	spa_t *spa = ksp->ks_private;
+	spa_history_kstat_t *shk = &spa->spa_stats.zio_stages;
+
+	if (n >= 0 && n < ZIO_STAGES)
+		return ((uint64_t *)shk->priv + n * (VDEV_L_HISTO_BUCKETS + 1));
+	return (NULL);
+}
+
+static void
+spa_zio_stages_init(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.zio_stages;
+	char *name;
+	kstat_t *ksp;
+
+	mutex_init(&shk->lock, NULL, MUTEX_DEFAULT, NULL);
+
+	/* One row per stage: the buckets, then the stage index. */
+	shk->count = ZIO_STAGES;
+	shk->size = ZIO_STAGES * (VDEV_L_HISTO_BUCKETS + 1) *
+	    sizeof (uint64_t);
+	shk->priv = kmem_zalloc(shk->size, KM_SLEEP);
+	for (int s = 0; s < ZIO_STAGES; s++) {
+		((uint64_t *)shk->priv)[s * (VDEV_L_HISTO_BUCKETS + 1) +
+		    VDEV_L_HISTO_BUCKETS] = s;
+	}
+
+	name = kmem_asprintf("zfs/%s", spa_name(spa));
+	ksp = kstat_create(name, 0, "zio_stages", "misc",
+	    KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+
+	shk->kstat = ksp;
+	if (ksp) {
+		ksp->ks_lock = &shk->lock;
+		ksp->ks_data = NULL;
+		ksp->ks_private = spa;
+		kstat_set_raw_ops(ksp, spa_zio_stages_headers,
+		    spa_zio_stages_data, spa_zio_stages_addr);
+		kstat_install(ksp);
+	}
+
+	kmem_strfree(name);
+}
+
+static void
+spa_zio_stages_destroy(spa_t *spa)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.zio_stages;
+
+	if (shk->kstat)
+		kstat_delete(shk->kstat);
+
+	kmem_free(shk->priv, shk->size);
+	mutex_destroy(&shk->lock);
+}
+
+void
+spa_zio_stage_add_nsecs(spa_t *spa, uint32_t stage, uint64_t nsecs)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.zio_stages;
+	uint_t s = highbit64(stage) - 1;
+
+	ASSERT3U(s, <, ZIO_STAGES);
+	atomic_inc_64((uint64_t *)shk->priv +
+	    s * (VDEV_L_HISTO_BUCKETS + 1) + L_HISTO(nsecs));
+}
+
 /*
  * ==========================================================================
  * SPA MMP History Routines
@@ -895,6 +1288,36 @@ static const spa_iostats_t spa_iostats_template = {
 	{ "simple_trim_bytes_skipped",		KSTAT_DATA_UINT64 },
 	{ "simple_trim_extents_failed",		KSTAT_DATA_UINT64 },
 	{ "simple_trim_bytes_failed",		KSTAT_DATA_UINT64 },
+	{ "userquota_update_nsecs",		KSTAT_DATA_UINT64 },
+	{ "userquota_flush_nsecs",		KSTAT_DATA_UINT64 },
+	{ "sync_passes",			KSTAT_DATA_UINT64 },
+	{ "sync_pool_nsecs",			KSTAT_DATA_UINT64 },
+	{ "sync_mos_nsecs",			KSTAT_DATA_UINT64 },
+	{ "sync_frees_nsecs",			KSTAT_DATA_UINT64 },
+	{ "sync_brt_nsecs",			KSTAT_DATA_UINT64 },
+	{ "sync_ddt_nsecs",			KSTAT_DATA_UINT64 },
+	{ "sync_scan_nsecs",			KSTAT_DATA_UINT64 },
+	{ "sync_log_flush_nsecs",		KSTAT_DATA_UINT64 },
+	{ "sync_vdev_nsecs",			KSTAT_DATA_UINT64 },
+	{ "sync_deferred_frees_nsecs",		KSTAT_DATA_UINT64 },
+	{ "sync_config_nsecs",			KSTAT_DATA_UINT64 },
+	{ "special_spill_metadata_count",	KSTAT_DATA_UINT64 },
+	{ "special_spill_metadata_bytes",	KSTAT_DATA_UINT64 },
+	{ "special_spill_smallblk_count",	KSTAT_DATA_UINT64 },
+	{ "special_spill_smallblk_bytes",	KSTAT_DATA_UINT64 },
+	{ "special_spill_ddt_count",		KSTAT_DATA_UINT64 },
+	{ "special_spill_ddt_bytes",		KSTAT_DATA_UINT64 },
+	{ "log_flush_blocks_count",		KSTAT_DATA_UINT64 },
+	{ "log_flush_memory_count",		KSTAT_DATA_UINT64 },
+	{ "log_flush_all_count",		KSTAT_DATA_UINT64 },
+	{ "log_blocks",				KSTAT_DATA_UINT64 },
+	{ "log_block_limit",			KSTAT_DATA_UINT64 },
+	{ "log_replay_rate",			KSTAT_DATA_UINT64 },
+	{ "log_replay_est_ms",			KSTAT_DATA_UINT64 },
+	{ "mmp_write_count",			KSTAT_DATA_UINT64 },
+	{ "mmp_write_nsecs",			KSTAT_DATA_UINT64 },
+	{ "mmp_write_errors",			KSTAT_DATA_UINT64 },
+	{ "mmp_write_slow_count",		KSTAT_DATA_UINT64 },
 };
 
 #define	SPA_IOSTATS_ADD(stat, val) \
@@ -938,14 +1361,149 @@ spa_iostats_trim_add(spa_t *spa, trim_type_t type,
 	}
 }
 
+/*
+ * Time spent by userquota_updates_task() in syncing context: update_nsecs
+ * is the time spent walking the synced dnodes and summing their deltas,
+ * summed over all sync threads, and flush_nsecs is the time spent applying
+ * the merged deltas to the user/group/project used ZAPs.
+ */
+void
+spa_iostats_userquota_add(spa_t *spa, uint64_t update_nsecs,
+    uint64_t flush_nsecs)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.iostats;
+	kstat_t *ksp = shk->kstat;
+	spa_iostats_t *iostats;
+
+	if (ksp == NULL)
+		return;
+
+	iostats = ksp->ks_data;
+	SPA_IOSTATS_ADD(userquota_update_nsecs, update_nsecs);
+	SPA_IOSTATS_ADD(userquota_flush_nsecs, flush_nsecs);
+}
+
+/*
+ * Time spent in each phase of spa_sync(), summed over all passes of one
+ * txg (see spa_sync_phase_t).
+ */
+void
+spa_iostats_sync_add(spa_t *spa, uint64_t passes, const hrtime_t *phase_nsecs)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.iostats;
+	kstat_t *ksp = shk->kstat;
+	spa_iostats_t *iostats;
+
+	if (ksp == NULL)
+		return;
+
+	iostats = ksp->ks_data;
+	SPA_IOSTATS_ADD(sync_passes, passes);
+	SPA_IOSTATS_ADD(sync_pool_nsecs, phase_nsecs[SPA_SYNC_PHASE_POOL]);
+	SPA_IOSTATS_ADD(sync_mos_nsecs, phase_nsecs[SPA_SYNC_PHASE_MOS]);
+	SPA_IOSTATS_ADD(sync_frees_nsecs, phase_nsecs[SPA_SYNC_PHASE_FREES]);
+	SPA_IOSTATS_ADD(sync_brt_nsecs, phase_nsecs[SPA_SYNC_PHASE_BRT]);
+	SPA_IOSTATS_ADD(sync_ddt_nsecs, phase_nsecs[SPA_SYNC_PHASE_DDT]);
+	SPA_IOSTATS_ADD(sync_scan_nsecs, phase_nsecs[SPA_SYNC_PHASE_SCAN]);
+	SPA_IOSTATS_ADD(sync_log_flush_nsecs,
+	    phase_nsecs[SPA_SYNC_PHASE_LOG_FLUSH]);
+	SPA_IOSTATS_ADD(sync_vdev_nsecs, phase_nsecs[SPA_SYNC_PHASE_VDEV]);
+	SPA_IOSTATS_ADD(sync_deferred_frees_nsecs,
+	    phase_nsecs[SPA_SYNC_PHASE_DEFERRED_FREES]);
+	SPA_IOSTATS_ADD(sync_config_nsecs, phase_nsecs[SPA_SYNC_PHASE_CONFIG]);
+}
+
+/*
+ * Allocations which were meant for the special or dedup class but landed
+ * in the normal class because that class was full, by what they were.
+ */
+void
+spa_iostats_special_spill_add(spa_t *spa, dmu_object_type_t objtype,
+    uint_t level, uint64_t bytes)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.iostats;
+	kstat_t *ksp = shk->kstat;
+	spa_iostats_t *iostats;
+
+	if (ksp == NULL)
+		return;
+
+	iostats = ksp->ks_data;
+	if (DMU_OT_IS_DDT(objtype)) {
+		SPA_IOSTATS_ADD(special_spill_ddt_count, 1);
+		SPA_IOSTATS_ADD(special_spill_ddt_bytes, bytes);
+	} else if (level == 0 &&
+	    (DMU_OT_IS_FILE(objtype) || objtype == DMU_OT_ZVOL)) {
+		SPA_IOSTATS_ADD(special_spill_smallblk_count, 1);
+		SPA_IOSTATS_ADD(special_spill_smallblk_bytes, bytes);
+	} else {
+		SPA_IOSTATS_ADD(special_spill_metadata_count, 1);
+		SPA_IOSTATS_ADD(special_spill_metadata_bytes, bytes);
+	}
+}
+
+/*
+ * Metaslabs flushed by spa_flush_metaslabs() to keep the log space maps
+ * within their block limit, within the memory limit, or to export the pool.
+ */
+void
+spa_iostats_log_flush_add(spa_t *spa, uint64_t blocks, uint64_t memory,
+    uint64_t all)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.iostats;
+	kstat_t *ksp = shk->kstat;
+	spa_iostats_t *iostats;
+
+	if (ksp == NULL)
+		return;
+
+	iostats = ksp->ks_data;
+	SPA_IOSTATS_ADD(log_flush_blocks_count, blocks);
+	SPA_IOSTATS_ADD(log_flush_memory_count, memory);
+	SPA_IOSTATS_ADD(log_flush_all_count, all);
+}
+
+/*
+ * Completed multihost uberblock writes, their total latency, how many
+ * failed, and how many took longer than zfs_multihost_interval.
+ */
+void
+spa_iostats_mmp_write_add(spa_t *spa, hrtime_t nsecs, int error,
+    boolean_t slow)
+{
+	spa_history_kstat_t *shk = &spa->spa_stats.iostats;
+	kstat_t *ksp = shk->kstat;
+	spa_iostats_t *iostats;
+
+	if (ksp == NULL)
+		return;
+
+	iostats = ksp->ks_data;
+	SPA_IOSTATS_ADD(mmp_write_count, 1);
+	SPA_IOSTATS_ADD(mmp_write_nsecs, nsecs);
+	SPA_IOSTATS_ADD(mmp_write_errors, error != 0);
+	SPA_IOSTATS_ADD(mmp_write_slow_count, slow);
+}
+
 static int
 spa_iostats_update(kstat_t *ksp, int rw)
 {
+	spa_t *spa = ksp->ks_private;
+	spa_iostats_t *iostats = ksp->ks_data;
+
 	if (rw == KSTAT_WRITE) {
 		memcpy(ksp->ks_data, &spa_iostats_template,
 		    sizeof (spa_iostats_t));
+		return (0);
 	}
 
+	/* The log space map gauges are read as they stand. */
+	iostats->log_blocks.value.ui64 = spa_log_sm_nblocks(spa);
+	iostats->log_block_limit.value.ui64 = spa_log_sm_blocklimit(spa);
+	iostats->log_replay_rate.value.ui64 = spa_log_sm_replay_rate(spa);
+	iostats->log_replay_est_ms.value.ui64 =
+	    spa_log_sm_replay_estimate_ms(spa);
+
 	return (0);
 }
 
@@ -998,11 +1556,15 @@ spa_stats_init(spa_t *spa)
 	spa_state_init(spa);
 	spa_guid_init(spa);
 	spa_iostats_init(spa);
+	spa_zio_stages_init(spa);
+	spa_heatmap_init(spa);
 }
 
 void
 spa_stats_destroy(spa_t *spa)
 {
+	spa_heatmap_destroy(spa);
+	spa_zio_stages_destroy(spa);
 	spa_iostats_destroy(spa);
 	spa_health_destroy(spa);
 	spa_tx_assign_destroy(spa);
@@ -1018,6 +1580,12 @@ ZFS_MODULE_PARAM(zfs, zfs_, read_history, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs, zfs_, read_history_hits, INT, ZMOD_RW,
 	"Include cache hits in read history");
 
+ZFS_MODULE_PARAM(zfs, zfs_, heatmap_sample_rate, UINT, ZMOD_RW,
+	"Sample one in N reads and writes into the per-object heatmap");
+
+ZFS_MODULE_PARAM(zfs, zfs_, heatmap_entries, UINT, ZMOD_RW,
+	"Number of objects tracked by the per-object heatmap");
+
 ZFS_MODULE_PARAM(zfs_txg, zfs_txg_, history, UINT, ZMOD_RW,
 	"Historical statistics for the last N txgs");
 
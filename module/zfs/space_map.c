@@ -391,16 +391,63 @@ space_map_incremental_destroy(space_map_t *sm, sm_cb_t callback, void *arg,
 	return (error);
 }
 
+/*
+ * Space maps that were just condensed, and most segments appended after
+ * that, list their entries in offset order. While that holds, the tree is
+ * built by appending to it with range_tree_add_tail(): for SM_FREE the
+ * free space before each allocated run, with the rest of the map
+ * [smla_cursor, end) still pending; for SM_ALLOC the runs themselves. On
+ * the first entry out of order (or of the other type, for SM_ALLOC), the
+ * pending space is added and loading continues one entry at a time.
+ */
 typedef struct space_map_load_arg {
 	space_map_t	*smla_sm;
 	range_tree_t	*smla_rt;
 	maptype_t	smla_type;
+	boolean_t	smla_sorted;
+	uint64_t	smla_cursor;
 } space_map_load_arg_t;
 
+static void
+space_map_load_unsort(space_map_load_arg_t *smla)
+{
+	space_map_t *sm = smla->smla_sm;
+	uint64_t end = sm->sm_start + sm->sm_size;
+
+	smla->smla_sorted = B_FALSE;
+	if (smla->smla_type == SM_FREE && smla->smla_cursor < end) {
+		range_tree_add_tail(smla->smla_rt, smla->smla_cursor,
+		    end - smla->smla_cursor);
+	}
+}
+
 static int
 space_map_load_callback(space_map_entry_t *sme, void *arg)
 {
 	space_map_load_arg_t *smla = arg;
+
+	if (smla->smla_sorted && sme->sme_offset >= smla->smla_cursor) {
+		if (smla->smla_type == SM_FREE && sme->sme_type == SM_ALLOC) {
+			if (sme->sme_offset > smla->smla_cursor) {
+				range_tree_add_tail(smla->smla_rt,
+				    smla->smla_cursor,
+				    sme->sme_offset - smla->smla_cursor);
+			}
+			smla->smla_cursor = sme->sme_offset + sme->sme_run;
+			return (0);
+		}
+		if (smla->smla_type == SM_ALLOC && sme->sme_type == SM_ALLOC) {
+			VERIFY3U(range_tree_space(smla->smla_rt) +
+			    sme->sme_run, <=, smla->smla_sm->sm_size);
+			range_tree_add_tail(smla->smla_rt, sme->sme_offset,
+			    sme->sme_run);
+			smla->smla_cursor = sme->sme_offset + sme->sme_run;
+			return (0);
+		}
+	}
+	if (smla->smla_sorted)
+		space_map_load_unsort(smla);
+
 	if (sme->sme_type == smla->smla_type) {
 		VERIFY3U(range_tree_space(smla->smla_rt) + sme->sme_run, <=,
 		    smla->smla_sm->sm_size);
@@ -424,17 +471,18 @@ space_map_load_length(space_map_t *sm, range_tree_t *rt, maptype_t maptype,
 
 	VERIFY0(range_tree_space(rt));
 
-	if (maptype == SM_FREE)
-		range_tree_add(rt, sm->sm_start, sm->sm_size);
-
 	smla.smla_rt = rt;
 	smla.smla_sm = sm;
 	smla.smla_type = maptype;
+	smla.smla_sorted = B_TRUE;
+	smla.smla_cursor = sm->sm_start;
 	int err = space_map_iterate(sm, length,
 	    space_map_load_callback, &smla);
 
 	if (err != 0)
 		range_tree_vacate(rt, NULL, NULL);
+	else if (smla.smla_sorted)
+		space_map_load_unsort(&smla);
 
 	return (err);
 }
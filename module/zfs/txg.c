@@ -106,6 +106,19 @@
  * the root of the tree of blocks that comprise all state stored on the ZFS
  * pool. Finally, if there is a quiesced txg waiting, we signal that it can
  * now transition to the syncing state.
+ *
+ * Only one txg is ever in the syncing state, and the writes of the next txg
+ * are not issued until the previous one's uberblock is on disk. Starting
+ * the first (data) pass of txg N+1 while txg N still writes its MOS and
+ * uberblock is not possible in this design. The data pass allocates from
+ * metaslabs whose state txg N has not finished syncing. It rewrites dbufs
+ * whose txg N writes may still be pending (db_data_pending). And it updates
+ * dataset and dsl_dir accounting that txg N is still writing into the MOS.
+ * The idle time between txgs is instead kept short by starting a txg early
+ * once zfs_dirty_data_sync_percent of zfs_dirty_data_max is dirty. The
+ * vdev queue also ramps async writes up with the amount of dirty data (see
+ * vdev_queue.c), so the open txg is usually ready to sync by the time the
+ * previous one completes.
  */
 
 static __attribute__((noreturn)) void txg_sync_thread(void *arg);
@@ -122,6 +122,12 @@ static unsigned int zfs_deadman_events_per_second = 1;
  */
 static unsigned int zfs_checksum_events_per_second = 20;
 
+/*
+ * Of those, only compare the bad data to the good (the bad_ranges and bit
+ * histograms of the ereport) for this many per second.
+ */
+static unsigned int zfs_checksum_detail_events_per_second = 5;
+
 /*
  * Ignore errors during scrub/resilver.  Allows to work around resilver
  * upon import when there are pool errors.
@@ -240,6 +246,7 @@ static vdev_ops_t *const vdev_ops_table[] = {
 	&vdev_spare_ops,
 	&vdev_disk_ops,
 	&vdev_file_ops,
+	&vdev_mem_ops,
 	&vdev_missing_ops,
 	&vdev_hole_ops,
 	&vdev_indirect_ops,
@@ -675,6 +682,8 @@ vdev_alloc_common(spa_t *spa, uint_t id, uint64_t guid, vdev_ops_t *ops)
 	    1);
 	zfs_ratelimit_init(&vd->vdev_checksum_rl,
 	    &zfs_checksum_events_per_second, 1);
+	zfs_ratelimit_init(&vd->vdev_checksum_detail_rl,
+	    &zfs_checksum_detail_events_per_second, 1);
 
 	/*
 	 * Default Thresholds for tuning ZED
@@ -1183,6 +1192,7 @@ vdev_free(vdev_t *vd)
 	zfs_ratelimit_fini(&vd->vdev_delay_rl);
 	zfs_ratelimit_fini(&vd->vdev_deadman_rl);
 	zfs_ratelimit_fini(&vd->vdev_checksum_rl);
+	zfs_ratelimit_fini(&vd->vdev_checksum_detail_rl);
 
 	if (vd == spa->spa_root_vdev)
 		spa->spa_root_vdev = NULL;
@@ -1492,6 +1502,10 @@ vdev_metaslab_group_create(vdev_t *vd)
 
 			uint64_t min_alloc = vdev_get_min_alloc(vd);
 			vdev_spa_set_alloc(spa, min_alloc);
+
+			uint64_t nparity = vdev_get_nparity(vd);
+			if (nparity > spa->spa_max_nparity)
+				spa->spa_max_nparity = nparity;
 		}
 	}
 }
@@ -1879,11 +1893,16 @@ vdev_default_open_children_func(vdev_t *vd)
  * Open the requested child vdevs.  If any of the leaf vdevs are using
  * a ZFS volume then do the opens in a single thread.  This avoids a
  * deadlock when the current thread is holding the spa_namespace_lock.
+ *
+ * vdev_uses_zvols() resolves the path of every leaf below this vdev, so
+ * it is checked once up front rather than for each child; doing it per
+ * child made opening a wide vdev quadratic in the number of its leaves.
  */
 static void
 vdev_open_children_impl(vdev_t *vd, vdev_open_children_func_t *open_func)
 {
 	int children = vd->vdev_children;
+	boolean_t uses_zvols = vdev_uses_zvols(vd);
 
 	taskq_t *tq = taskq_create("vdev_open", children, minclsyspri,
 	    children, children, TASKQ_PREPOPULATE);
@@ -1895,7 +1914,7 @@ vdev_open_children_impl(vdev_t *vd, vdev_open_children_func_t *open_func)
 		if (open_func(cvd) == B_FALSE)
 			continue;
 
-		if (tq == NULL || vdev_uses_zvols(vd)) {
+		if (tq == NULL || uses_zvols) {
 			cvd->vdev_open_error = vdev_open(cvd);
 		} else {
 			VERIFY(taskq_dispatch(tq, vdev_open_child,
@@ -3636,11 +3655,13 @@ vdev_load(vdev_t *vd)
 	taskq_t *tq = NULL;
 
 	/*
-	 * It's only worthwhile to use the taskq for the root vdev, because the
-	 * slow part is metaslab_init, and that only happens for top-level
-	 * vdevs.
+	 * The slow part for top-level vdevs is metaslab_init, but each leaf
+	 * also looks up its properties in its ZAP and loads its DTL, all of
+	 * which are random reads of the MOS.  Load the children of any vdev
+	 * with more than one of them in parallel, so that a wide raidz or
+	 * draid does not read its leaves' metadata one at a time.
 	 */
-	if (vd->vdev_ops == &vdev_root_ops && vd->vdev_children > 0) {
+	if (vd->vdev_children > 1) {
 		tq = taskq_create("vdev_load", children, minclsyspri,
 		    children, children, TASKQ_PREPOPULATE);
 	}
@@ -3779,6 +3800,33 @@ vdev_load(vdev_t *vd)
 		if (error && error != ENOENT)
 			vdev_dbgmsg(vd, "vdev_load: zap_lookup(zap=%llu) "
 			    "failed [error=%d]", (u_longlong_t)zapobj, error);
+
+		if (vd->vdev_ops->vdev_op_leaf) {
+			error = vdev_prop_get_int(vd, VDEV_PROP_QUEUE_BYPASS,
+			    &vd->vdev_queue_bypass);
+			if (error && error != ENOENT)
+				vdev_dbgmsg(vd, "vdev_load: zap_lookup("
+				    "zap=%llu) failed [error=%d]",
+				    (u_longlong_t)zapobj, error);
+
+			error = vdev_prop_get_int(vd,
+			    VDEV_PROP_NONVOLATILE_CACHE,
+			    &vd->vdev_nonvolatile_cache);
+			if (error && error != ENOENT)
+				vdev_dbgmsg(vd, "vdev_load: zap_lookup("
+				    "zap=%llu) failed [error=%d]",
+				    (u_longlong_t)zapobj, error);
+		}
+
+		if (vd->vdev_ops == &vdev_mirror_ops) {
+			error = vdev_prop_get_int(vd,
+			    VDEV_PROP_MIRROR_READ_POLICY,
+			    &vd->vdev_mirror_read_policy);
+			if (error && error != ENOENT)
+				vdev_dbgmsg(vd, "vdev_load: zap_lookup("
+				    "zap=%llu) failed [error=%d]",
+				    (u_longlong_t)zapobj, error);
+		}
 	}
 
 	/*
@@ -4648,6 +4696,8 @@ vdev_get_child_stat_ex(vdev_t *cvd, vdev_stat_ex_t *vsx, vdev_stat_ex_t *cvsx)
 
 		for (b = 0; b < ARRAY_SIZE(vsx->vsx_agg_histo[0]); b++)
 			vsx->vsx_agg_histo[t][b] += cvsx->vsx_agg_histo[t][b];
+
+		vsx->vsx_deadline_miss[t] += cvsx->vsx_deadline_miss[t];
 	}
 
 }
@@ -4716,6 +4766,8 @@ vdev_get_stats_ex_impl(vdev_t *vd, vdev_stat_t *vs, vdev_stat_ex_t *vsx)
 		for (t = 0; t < ZIO_PRIORITY_NUM_QUEUEABLE; t++) {
 			vsx->vsx_active_queue[t] = vd->vdev_queue.vq_cactive[t];
 			vsx->vsx_pend_queue[t] = vdev_queue_class_length(vd, t);
+			vsx->vsx_deadline_miss[t] =
+			    vd->vdev_queue.vq_deadline_miss[t];
 		}
 	}
 }
@@ -5966,6 +6018,40 @@ vdev_prop_set(vdev_t *vd, nvlist_t *innvl, nvlist_t *outnvl)
 			}
 			vd->vdev_failfast = intval & 1;
 			break;
+		case VDEV_PROP_QUEUE_BYPASS:
+			if (!vd->vdev_ops->vdev_op_leaf) {
+				error = ENOTSUP;
+				break;
+			}
+			if (nvpair_value_uint64(elem, &intval) != 0) {
+				error = EINVAL;
+				break;
+			}
+			vd->vdev_queue_bypass = intval & 1;
+			break;
+		case VDEV_PROP_NONVOLATILE_CACHE:
+			if (!vd->vdev_ops->vdev_op_leaf) {
+				error = ENOTSUP;
+				break;
+			}
+			if (nvpair_value_uint64(elem, &intval) != 0) {
+				error = EINVAL;
+				break;
+			}
+			vd->vdev_nonvolatile_cache = intval & 1;
+			break;
+		case VDEV_PROP_MIRROR_READ_POLICY:
+			if (vd->vdev_ops != &vdev_mirror_ops) {
+				error = ENOTSUP;
+				break;
+			}
+			if (nvpair_value_uint64(elem, &intval) != 0 ||
+			    intval > VDEV_MIRROR_READ_LATENCY) {
+				error = EINVAL;
+				break;
+			}
+			vd->vdev_mirror_read_policy = intval;
+			break;
 		case VDEV_PROP_CHECKSUM_N:
 			if (nvpair_value_uint64(elem, &intval) != 0) {
 				error = EINVAL;
@@ -6329,6 +6415,9 @@ vdev_prop_get(vdev_t *vd, nvlist_t *innvl, nvlist_t *outnvl)
 				    intval, src);
 				break;
 			case VDEV_PROP_FAILFAST:
+			case VDEV_PROP_QUEUE_BYPASS:
+			case VDEV_PROP_MIRROR_READ_POLICY:
+			case VDEV_PROP_NONVOLATILE_CACHE:
 				src = ZPROP_SRC_LOCAL;
 				strval = NULL;
 
@@ -6490,6 +6579,10 @@ ZFS_MODULE_PARAM(zfs, zfs_, checksum_events_per_second, UINT, ZMOD_RW,
 	"(do not set below ZED threshold).");
 /* END CSTYLED */
 
+ZFS_MODULE_PARAM(zfs, zfs_, checksum_detail_events_per_second, UINT,
+	ZMOD_RW, "Collect the bad ranges of this many checksum events per "
+	"second");
+
 ZFS_MODULE_PARAM(zfs, zfs_, scan_ignore_errors, INT, ZMOD_RW,
 	"Ignore errors during resilver/scrub");
 
@@ -569,7 +569,15 @@ static inline uint64_t
 vdev_draid_permute_id(vdev_draid_config_t *vdc,
     uint8_t *base, uint64_t iter, uint64_t index)
 {
-	return ((base[index] + iter) % vdc->vdc_children);
+	uint64_t id = base[index] + iter;
+
+	/*
+	 * Both base[index] and iter are less than vdc_children, so this is
+	 * (base[index] + iter) % vdc_children without the division, which
+	 * is otherwise paid once per column for every I/O.
+	 */
+	ASSERT3U(id, <, 2 * vdc->vdc_children);
+	return (id >= vdc->vdc_children ? id - vdc->vdc_children : id);
 }
 
 /*
@@ -1038,13 +1046,14 @@ vdev_draid_map_alloc_row(zio_t *zio, raidz_row_t **rrp, uint64_t io_offset,
 	uint8_t *base;
 	uint64_t iter, asize = 0;
 	vdev_draid_get_perm(vdc, perm, &base, &iter);
-	for (uint64_t i = 0; i < groupwidth; i++) {
+	for (uint64_t i = 0, c = groupstart; i < groupwidth; i++, c++) {
 		raidz_col_t *rc = &rr->rr_col[i];
-		uint64_t c = (groupstart + i) % ndisks;
 
 		/* increment the offset if we wrap to the next row */
-		if (i == wrap)
+		if (i == wrap) {
 			physical_offset += VDEV_DRAID_ROWHEIGHT;
+			c = 0;
+		}
 
 		rc->rc_devidx = vdev_draid_permute_id(vdc, base, iter, c);
 		rc->rc_offset = physical_offset;
@@ -1401,8 +1410,11 @@ vdev_draid_group_degraded(vdev_t *vd, uint64_t offset)
 	uint64_t iter;
 	vdev_draid_get_perm(vdc, perm, &base, &iter);
 
-	for (uint64_t i = 0; i < vdc->vdc_groupwidth; i++) {
-		uint64_t c = (groupstart + i) % vdc->vdc_ndisks;
+	for (uint64_t i = 0, c = groupstart; i < vdc->vdc_groupwidth;
+	    i++, c++) {
+		if (c == vdc->vdc_ndisks)
+			c = 0;
+
 		uint64_t cid = vdev_draid_permute_id(vdc, base, iter, c);
 		vdev_t *cvd = vd->vdev_child[cid];
 
@@ -1441,8 +1453,11 @@ vdev_draid_group_missing(vdev_t *vd, uint64_t offset, uint64_t txg,
 	uint64_t iter;
 	vdev_draid_get_perm(vdc, perm, &base, &iter);
 
-	for (uint64_t i = 0; i < vdc->vdc_groupwidth; i++) {
-		uint64_t c = (groupstart + i) % vdc->vdc_ndisks;
+	for (uint64_t i = 0, c = groupstart; i < vdc->vdc_groupwidth;
+	    i++, c++) {
+		if (c == vdc->vdc_ndisks)
+			c = 0;
+
 		uint64_t cid = vdev_draid_permute_id(vdc, base, iter, c);
 		vdev_t *cvd = vd->vdev_child[cid];
 
@@ -25,6 +25,10 @@
 #include <sys/zfeature.h>
 #include <sys/dmu_objset.h>
 
+#define	VIM_INDEX_STRIDE	64
+#define	VIM_INDEX_COUNT(n)	\
+	(((n) + VIM_INDEX_STRIDE - 1) / VIM_INDEX_STRIDE)
+
 #ifdef ZFS_DEBUG
 static boolean_t
 vdev_indirect_mapping_verify(vdev_indirect_mapping_t *vim)
@@ -181,8 +185,24 @@ vdev_indirect_mapping_entry_for_offset_impl(vdev_indirect_mapping_t *vim,
 
 	vdev_indirect_mapping_entry_phys_t *entry = NULL;
 
-	uint64_t last = vim->vim_phys->vimp_num_entries - 1;
-	uint64_t base = 0;
+	/*
+	 * Find the last stride which starts at or before the offset.  Any
+	 * entry containing the offset is in that stride, and the next entry
+	 * is at most one past its end, where the search below leaves it.
+	 */
+	uint64_t nstrides = VIM_INDEX_COUNT(vim->vim_phys->vimp_num_entries);
+	uint64_t lo = 0, hi = nstrides;
+	while (hi - lo > 1) {
+		uint64_t m = lo + ((hi - lo) >> 1);
+		if (vim->vim_index[m] <= offset)
+			lo = m;
+		else
+			hi = m;
+	}
+
+	uint64_t last = MIN((lo + 1) * VIM_INDEX_STRIDE,
+	    vim->vim_phys->vimp_num_entries) - 1;
+	uint64_t base = lo * VIM_INDEX_STRIDE;
 
 	/*
 	 * We don't define these inside of the while loop because we use
@@ -285,6 +305,30 @@ vdev_indirect_mapping_entry_for_offset_or_next(vdev_indirect_mapping_t *vim,
 	    B_TRUE));
 }
 
+/*
+ * (Re)build vim_index for the first "count" entries of vim_entries,
+ * freeing the index built for "old_count" entries.
+ */
+static void
+vdev_indirect_mapping_index_build(vdev_indirect_mapping_t *vim,
+    uint64_t old_count, uint64_t count)
+{
+	if (old_count > 0) {
+		vmem_free(vim->vim_index,
+		    VIM_INDEX_COUNT(old_count) * sizeof (uint64_t));
+		vim->vim_index = NULL;
+	}
+	if (count == 0)
+		return;
+
+	uint64_t nstrides = VIM_INDEX_COUNT(count);
+	vim->vim_index = vmem_alloc(nstrides * sizeof (uint64_t), KM_SLEEP);
+	for (uint64_t i = 0; i < nstrides; i++) {
+		vim->vim_index[i] = DVA_MAPPING_GET_SRC_OFFSET(
+		    &vim->vim_entries[i * VIM_INDEX_STRIDE]);
+	}
+}
+
 void
 vdev_indirect_mapping_close(vdev_indirect_mapping_t *vim)
 {
@@ -292,6 +336,8 @@ vdev_indirect_mapping_close(vdev_indirect_mapping_t *vim)
 
 	if (vim->vim_phys->vimp_num_entries > 0) {
 		uint64_t map_size = vdev_indirect_mapping_size(vim);
+		vdev_indirect_mapping_index_build(vim,
+		    vim->vim_phys->vimp_num_entries, 0);
 		vmem_free(vim->vim_entries, map_size);
 		vim->vim_entries = NULL;
 	}
@@ -362,6 +408,8 @@ vdev_indirect_mapping_open(objset_t *os, uint64_t mapping_object)
 		vim->vim_entries = vmem_alloc(map_size, KM_SLEEP);
 		VERIFY0(dmu_read(os, vim->vim_object, 0, map_size,
 		    vim->vim_entries, DMU_READ_PREFETCH));
+		vdev_indirect_mapping_index_build(vim, 0,
+		    vim->vim_phys->vimp_num_entries);
 	}
 
 	ASSERT(vdev_indirect_mapping_verify(vim));
@@ -488,6 +536,8 @@ vdev_indirect_mapping_add_entries(vdev_indirect_mapping_t *vim,
 	VERIFY0(dmu_read(vim->vim_objset, vim->vim_object, old_size,
 	    new_size - old_size, &vim->vim_entries[old_count],
 	    DMU_READ_PREFETCH));
+	vdev_indirect_mapping_index_build(vim, old_count,
+	    vim->vim_phys->vimp_num_entries);
 
 	zfs_dbgmsg("txg %llu: wrote %llu entries to "
 	    "indirect mapping obj %llu; max offset=0x%llx",
@@ -38,8 +38,18 @@
  */
 static uint64_t zfs_initialize_value = 0xdeadbeefdeadbeeeULL;
 
-/* maximum number of I/Os outstanding per leaf vdev */
-static const int zfs_initialize_limit = 1;
+/*
+ * Maximum number of I/Os outstanding per leaf vdev.  How many of them are
+ * active on the device at once is controlled by the vdev queue, which
+ * drops to zfs_vdev_initializing_min_active while there is other I/O.
+ */
+static uint_t zfs_initialize_queue_limit = 8;
+
+/*
+ * Number of metaslabs which are disabled and initialized together, so that
+ * the queue does not drain at every metaslab boundary.
+ */
+static uint_t zfs_initialize_metaslab_batch = 4;
 
 /* size of initializing writes; default 1MiB, see zfs_remove_max_segment */
 static uint64_t zfs_initialize_chunk_size = 1024 * 1024;
@@ -241,7 +251,8 @@ vdev_initialize_write(vdev_t *vd, uint64_t start, uint64_t size, abd_t *data)
 
 	/* Limit inflight initializing I/Os */
 	mutex_enter(&vd->vdev_initialize_io_lock);
-	while (vd->vdev_initialize_inflight >= zfs_initialize_limit) {
+	while (vd->vdev_initialize_inflight >=
+	    MAX(zfs_initialize_queue_limit, 1)) {
 		cv_wait(&vd->vdev_initialize_io_cv,
 		    &vd->vdev_initialize_io_lock);
 	}
@@ -542,11 +553,19 @@ vdev_initialize_thread(void *arg)
 	vd->vdev_initialize_tree = range_tree_create(NULL, RANGE_SEG64, NULL,
 	    0, 0);
 
-	for (uint64_t i = 0; !vd->vdev_detached &&
-	    i < vd->vdev_top->vdev_ms_count; i++) {
-		metaslab_t *msp = vd->vdev_top->vdev_ms[i];
-		boolean_t unload_when_done = B_FALSE;
+	/*
+	 * Metaslabs are initialized in batches of consecutive metaslabs,
+	 * so the writes are still issued in offset order, as required to
+	 * track progress with vdev_initialize_offset.
+	 */
+	uint64_t batch = MAX(zfs_initialize_metaslab_batch, 1);
+	metaslab_t **msps = kmem_alloc(batch * sizeof (metaslab_t *),
+	    KM_SLEEP);
+	boolean_t *unload = kmem_alloc(batch * sizeof (boolean_t), KM_SLEEP);
+	uint64_t nms;
 
+	for (uint64_t i = 0; !vd->vdev_detached &&
+	    i < vd->vdev_top->vdev_ms_count; i += nms) {
 		/*
 		 * If we've expanded the top-level vdev or it's our
 		 * first pass, calculate our progress.
@@ -556,19 +575,39 @@ vdev_initialize_thread(void *arg)
 			ms_count = vd->vdev_top->vdev_ms_count;
 		}
 
+		nms = MIN(batch, vd->vdev_top->vdev_ms_count - i);
+		for (uint64_t j = 0; j < nms; j++)
+			msps[j] = vd->vdev_top->vdev_ms[i + j];
+
 		spa_config_exit(spa, SCL_CONFIG, FTAG);
-		metaslab_disable(msp);
-		mutex_enter(&msp->ms_lock);
-		if (!msp->ms_loaded && !msp->ms_loading)
-			unload_when_done = B_TRUE;
-		VERIFY0(metaslab_load(msp));
+		for (uint64_t j = 0; j < nms; j++) {
+			metaslab_t *msp = msps[j];
 
-		range_tree_walk(msp->ms_allocatable, vdev_initialize_range_add,
-		    vd);
-		mutex_exit(&msp->ms_lock);
+			metaslab_disable(msp);
+			mutex_enter(&msp->ms_lock);
+			unload[j] = (!msp->ms_loaded && !msp->ms_loading);
+			VERIFY0(metaslab_load(msp));
+
+			range_tree_walk(msp->ms_allocatable,
+			    vdev_initialize_range_add, vd);
+			mutex_exit(&msp->ms_lock);
+		}
 
 		error = vdev_initialize_ranges(vd, deadbeef);
-		metaslab_enable(msp, B_TRUE, unload_when_done);
+
+		/*
+		 * Wait for the writes to complete before the metaslabs can
+		 * be allocated from again, so they cannot overwrite new data.
+		 */
+		mutex_enter(&vd->vdev_initialize_io_lock);
+		while (vd->vdev_initialize_inflight > 0) {
+			cv_wait(&vd->vdev_initialize_io_cv,
+			    &vd->vdev_initialize_io_lock);
+		}
+		mutex_exit(&vd->vdev_initialize_io_lock);
+
+		for (uint64_t j = 0; j < nms; j++)
+			metaslab_enable(msps[j], B_TRUE, unload[j]);
 		spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
 
 		range_tree_vacate(vd->vdev_initialize_tree, NULL, NULL);
@@ -577,12 +616,8 @@ vdev_initialize_thread(void *arg)
 	}
 
 	spa_config_exit(spa, SCL_CONFIG, FTAG);
-	mutex_enter(&vd->vdev_initialize_io_lock);
-	while (vd->vdev_initialize_inflight > 0) {
-		cv_wait(&vd->vdev_initialize_io_cv,
-		    &vd->vdev_initialize_io_lock);
-	}
-	mutex_exit(&vd->vdev_initialize_io_lock);
+	kmem_free(msps, batch * sizeof (metaslab_t *));
+	kmem_free(unload, batch * sizeof (boolean_t));
 
 	range_tree_destroy(vd->vdev_initialize_tree);
 	vdev_initialize_block_free(deadbeef);
@@ -828,5 +863,11 @@ EXPORT_SYMBOL(vdev_initialize_restart);
 ZFS_MODULE_PARAM(zfs, zfs_, initialize_value, U64, ZMOD_RW,
 	"Value written during zpool initialize");
 
+ZFS_MODULE_PARAM(zfs, zfs_, initialize_queue_limit, UINT, ZMOD_RW,
+	"Max queued initializing writes outstanding per leaf vdev");
+
+ZFS_MODULE_PARAM(zfs, zfs_, initialize_metaslab_batch, UINT, ZMOD_RW,
+	"Number of metaslabs initialized together per leaf vdev");
+
 ZFS_MODULE_PARAM(zfs, zfs_, initialize_chunk_size, U64, ZMOD_RW,
 	"Size in bytes of writes by zpool initialize");
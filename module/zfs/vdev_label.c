@@ -387,6 +387,9 @@ vdev_config_generate_stats(vdev_t *vd, nvlist_t *nv)
 	/* IO delays */
 	fnvlist_add_uint64(nvx, ZPOOL_CONFIG_VDEV_SLOW_IOS, vs->vs_slow_ios);
 
+	fnvlist_add_uint64_array(nvx, ZPOOL_CONFIG_VDEV_DEADLINE_MISSES,
+	    vsx->vsx_deadline_miss, ARRAY_SIZE(vsx->vsx_deadline_miss));
+
 	/* Add extended stats nvlist to main nvlist */
 	fnvlist_add_nvlist(nv, ZPOOL_CONFIG_VDEV_STATS_EX, nvx);
 
@@ -0,0 +1,209 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * The 'mem' vdev is a leaf vdev backed by memory, intended for measuring
+ * the CPU cost and scaling of the zio pipeline without the noise of real
+ * devices.  Its contents are kept in chunks which are only allocated
+ * when first written, so a large device costs no more memory than the
+ * data written to it; unwritten space reads back as zeros.
+ *
+ * The contents live only as long as the vdev_t, i.e. they survive a
+ * reopen but not an export, after which the pool can't be imported again.
+ * Every device is vdev_mem_size bytes large as of its first open, and an
+ * I/O completes no sooner than vdev_mem_latency_us after it was issued,
+ * by way of the same delayed completion used for zinject delays.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/vdev_impl.h>
+#include <sys/fs/zfs.h>
+#include <sys/zio.h>
+#include <sys/abd.h>
+
+#define	VDEV_MEM_CHUNK_SHIFT	20	/* 1 MiB */
+#define	VDEV_MEM_CHUNK_SIZE	(1ULL << VDEV_MEM_CHUNK_SHIFT)
+
+typedef struct vdev_mem {
+	uint64_t	vm_size;
+	uint64_t	vm_nchunks;
+	void		**vm_chunks;
+} vdev_mem_t;
+
+uint64_t vdev_mem_size = 1ULL << 30;
+static uint_t vdev_mem_latency_us = 0;
+
+static int
+vdev_mem_open(vdev_t *vd, uint64_t *psize, uint64_t *max_psize,
+    uint64_t *logical_ashift, uint64_t *physical_ashift)
+{
+	vdev_mem_t *vm = vd->vdev_tsd;
+
+	vd->vdev_nonrot = B_TRUE;
+	vd->vdev_has_trim = B_FALSE;
+	vd->vdev_has_securetrim = B_FALSE;
+
+	if (vm == NULL) {
+		if (vdev_mem_size < SPA_MINDEVSIZE) {
+			vd->vdev_stat.vs_aux = VDEV_AUX_OPEN_FAILED;
+			return (SET_ERROR(EOVERFLOW));
+		}
+
+		vm = vd->vdev_tsd = kmem_zalloc(sizeof (vdev_mem_t), KM_SLEEP);
+		vm->vm_size = vdev_mem_size;
+		vm->vm_nchunks = P2ROUNDUP(vm->vm_size, VDEV_MEM_CHUNK_SIZE) >>
+		    VDEV_MEM_CHUNK_SHIFT;
+		vm->vm_chunks = vmem_zalloc(vm->vm_nchunks * sizeof (void *),
+		    KM_SLEEP);
+	} else {
+		ASSERT(vd->vdev_reopening);
+	}
+
+	*max_psize = *psize = vm->vm_size;
+	*logical_ashift = SPA_MINBLOCKSHIFT;
+	*physical_ashift = SPA_MINBLOCKSHIFT;
+
+	return (0);
+}
+
+static void
+vdev_mem_close(vdev_t *vd)
+{
+	vdev_mem_t *vm = vd->vdev_tsd;
+
+	if (vd->vdev_reopening || vm == NULL)
+		return;
+
+	for (uint64_t c = 0; c < vm->vm_nchunks; c++) {
+		if (vm->vm_chunks[c] != NULL)
+			vmem_free(vm->vm_chunks[c], VDEV_MEM_CHUNK_SIZE);
+	}
+	vmem_free(vm->vm_chunks, vm->vm_nchunks * sizeof (void *));
+	kmem_free(vm, sizeof (vdev_mem_t));
+	vd->vdev_tsd = NULL;
+}
+
+/*
+ * Return the chunk holding the given offset, allocating it for a write.
+ * Chunks are never freed while the vdev is open, so racing writers only
+ * have to agree on which of them installs the chunk.
+ */
+static void *
+vdev_mem_chunk(vdev_mem_t *vm, uint64_t offset, boolean_t write)
+{
+	void **chunkp = &vm->vm_chunks[offset >> VDEV_MEM_CHUNK_SHIFT];
+	void *chunk = *chunkp;
+
+	if (chunk == NULL && write) {
+		void *new = vmem_zalloc(VDEV_MEM_CHUNK_SIZE, KM_SLEEP);
+
+		chunk = atomic_cas_ptr(chunkp, NULL, new);
+		if (chunk == NULL) {
+			chunk = new;
+		} else {
+			vmem_free(new, VDEV_MEM_CHUNK_SIZE);
+		}
+	}
+
+	return (chunk);
+}
+
+static void
+vdev_mem_io_start(zio_t *zio)
+{
+	vdev_t *vd = zio->io_vd;
+	vdev_mem_t *vm = vd->vdev_tsd;
+	boolean_t write = (zio->io_type == ZIO_TYPE_WRITE);
+
+	if (zio->io_type == ZIO_TYPE_FLUSH) {
+		if (!vdev_readable(vd))
+			zio->io_error = SET_ERROR(ENXIO);
+		zio_execute(zio);
+		return;
+	}
+
+	ASSERT(zio->io_type == ZIO_TYPE_READ || write);
+	ASSERT3U(zio->io_offset + zio->io_size, <=, vm->vm_size);
+
+	zio->io_target_timestamp = zio_handle_io_delay(zio);
+	if (vdev_mem_latency_us != 0) {
+		zio->io_target_timestamp = MAX(zio->io_target_timestamp,
+		    gethrtime() + USEC2NSEC(vdev_mem_latency_us));
+	}
+
+	for (uint64_t done = 0; done < zio->io_size; ) {
+		uint64_t offset = zio->io_offset + done;
+		uint64_t off = P2PHASE(offset, VDEV_MEM_CHUNK_SIZE);
+		uint64_t size = MIN(zio->io_size - done,
+		    VDEV_MEM_CHUNK_SIZE - off);
+		char *chunk = vdev_mem_chunk(vm, offset, write);
+
+		if (write)
+			abd_copy_to_buf_off(chunk + off, zio->io_abd, done,
+			    size);
+		else if (chunk != NULL)
+			abd_copy_from_buf_off(zio->io_abd, chunk + off, done,
+			    size);
+		else
+			abd_zero_off(zio->io_abd, done, size);
+		done += size;
+	}
+
+	zio_delay_interrupt(zio);
+}
+
+static void
+vdev_mem_io_done(zio_t *zio)
+{
+	(void) zio;
+}
+
+vdev_ops_t vdev_mem_ops = {
+	.vdev_op_init = NULL,
+	.vdev_op_fini = NULL,
+	.vdev_op_open = vdev_mem_open,
+	.vdev_op_close = vdev_mem_close,
+	.vdev_op_asize = vdev_default_asize,
+	.vdev_op_min_asize = vdev_default_min_asize,
+	.vdev_op_min_alloc = NULL,
+	.vdev_op_io_start = vdev_mem_io_start,
+	.vdev_op_io_done = vdev_mem_io_done,
+	.vdev_op_state_change = NULL,
+	.vdev_op_need_resilver = NULL,
+	.vdev_op_hold = NULL,
+	.vdev_op_rele = NULL,
+	.vdev_op_remap = NULL,
+	.vdev_op_xlate = vdev_default_xlate,
+	.vdev_op_rebuild_asize = NULL,
+	.vdev_op_metaslab_init = NULL,
+	.vdev_op_config_generate = NULL,
+	.vdev_op_nparity = NULL,
+	.vdev_op_ndisks = NULL,
+	.vdev_op_type = VDEV_TYPE_MEM,		/* name of this vdev type */
+	.vdev_op_leaf = B_TRUE			/* leaf vdev */
+};
+
+ZFS_MODULE_PARAM(zfs_vdev_mem, vdev_mem_, size, U64, ZMOD_RW,
+	"Size of newly opened memory-backed vdevs");
+
+ZFS_MODULE_PARAM(zfs_vdev_mem, vdev_mem_, latency_us, UINT, ZMOD_RW,
+	"Minimum latency of I/O to memory-backed vdevs in microseconds");
@@ -53,6 +53,11 @@ typedef struct mirror_stats {
 
 	kstat_named_t vdev_mirror_stat_preferred_found;
 	kstat_named_t vdev_mirror_stat_preferred_not_found;
+
+	kstat_named_t vdev_mirror_stat_latency;
+
+	kstat_named_t vdev_mirror_stat_hedge_issued;
+	kstat_named_t vdev_mirror_stat_hedge_won;
 } mirror_stats_t;
 
 static mirror_stats_t mirror_stats = {
@@ -70,6 +75,12 @@ static mirror_stats_t mirror_stats = {
 	{ "preferred_found",			KSTAT_DATA_UINT64 },
 	/* Preferred child vdev not found or equal load  */
 	{ "preferred_not_found",		KSTAT_DATA_UINT64 },
+	/* Load estimated from read latency (mirror_read_policy=latency) */
+	{ "latency",				KSTAT_DATA_UINT64 },
+	/* Read also issued to a second child after zfs_vdev_mirror_hedge_* */
+	{ "hedge_issued",			KSTAT_DATA_UINT64 },
+	/* The second child's copy arrived first */
+	{ "hedge_won",				KSTAT_DATA_UINT64 },
 
 };
 
@@ -120,6 +131,7 @@ typedef struct mirror_map {
 	boolean_t	mm_resilvering;
 	boolean_t	mm_rebuilding;
 	boolean_t	mm_root;
+	boolean_t	mm_latency;
 	mirror_child_t	mm_child[];
 } mirror_map_t;
 
@@ -144,6 +156,13 @@ static int zfs_vdev_mirror_rotating_seek_offset = 1 * 1024 * 1024;
 static int zfs_vdev_mirror_non_rotating_inc = 0;
 static int zfs_vdev_mirror_non_rotating_seek_inc = 1;
 
+/* Hedged read configuration, disabled when zfs_vdev_mirror_hedge_pct is 0. */
+static uint_t zfs_vdev_mirror_hedge_pct = 0;
+static uint_t zfs_vdev_mirror_hedge_min_ms = 10;
+
+/* Don't hedge on a percentile computed from fewer reads than this. */
+#define	MIRROR_HEDGE_MIN_SAMPLES	1000
+
 static inline size_t
 vdev_mirror_map_size(int children)
 {
@@ -203,6 +222,19 @@ vdev_mirror_load(mirror_map_t *mm, vdev_t *vd, uint64_t zio_offset)
 	load = vdev_queue_length(vd);
 	last_offset = vdev_queue_last_offset(vd);
 
+	/*
+	 * With mirror_read_policy=latency, the load is the expected time in
+	 * microseconds for a new read to complete: the average read latency
+	 * for each I/O already active plus this one.  A child that hasn't
+	 * completed a read yet has no latency and will be picked first.
+	 */
+	if (mm->mm_latency) {
+		uint64_t lat = vdev_queue_read_latency(vd) / NSEC_PER_USEC;
+
+		MIRROR_BUMP(vdev_mirror_stat_latency);
+		return ((int)MIN(lat * (load + 1), INT_MAX - 1));
+	}
+
 	if (vd->vdev_nonrot) {
 		/* Non-rotating media. */
 		if (last_offset == zio_offset) {
@@ -370,6 +402,8 @@ vdev_mirror_map_init(zio_t *zio)
 		    dsl_scan_resilvering(vd->vdev_spa->spa_dsl_pool);
 		mm = vdev_mirror_map_alloc(vd->vdev_children, replacing,
 		    B_FALSE);
+		mm->mm_latency = (vd->vdev_mirror_read_policy ==
+		    VDEV_MIRROR_READ_LATENCY);
 		for (c = 0; c < mm->mm_children; c++) {
 			mc = &mm->mm_child[c];
 			mc->mc_vd = vd->vdev_child[c];
@@ -600,6 +634,261 @@ vdev_mirror_child_select(zio_t *zio)
 	return (-1);
 }
 
+/*
+ * Hedged reads.  A normal read which hasn't completed after the child's
+ * zfs_vdev_mirror_hedge_pct percentile read latency is also issued to a
+ * second child, and whichever copy arrives first completes the mirror zio.
+ * The slower read may still be in flight after that, so both read into
+ * private buffers and the mirror_hedge_t is reference counted rather than
+ * hung off the mirror zio.  The reads are children of their own root zio
+ * for the same reason.
+ */
+typedef enum mirror_hedge_timer {
+	MH_TIMER_PENDING,
+	MH_TIMER_FIRED,
+	MH_TIMER_CANCELLED,
+} mirror_hedge_timer_t;
+
+typedef struct mirror_hedge_io {
+	struct mirror_hedge	*mhi_hedge;
+	mirror_child_t		*mhi_mc;
+	abd_t			*mhi_abd;
+} mirror_hedge_io_t;
+
+typedef struct mirror_hedge {
+	kmutex_t		mh_lock;
+	zio_t			*mh_zio;	/* NULL once resumed */
+	taskqid_t		mh_timer;
+	mirror_hedge_timer_t	mh_timer_state;
+	uint_t			mh_pending;	/* reads in flight */
+	uint_t			mh_refs;	/* reads in flight + timer */
+	mirror_hedge_io_t	mh_io[2];	/* first and hedged read */
+} mirror_hedge_t;
+
+/*
+ * Returns the delay in ticks after which a read from this child should be
+ * hedged, or 0 if its read latency distribution isn't known yet.  Bucket b
+ * of the latency histogram holds latencies below 2^(b + 1) nanoseconds.
+ */
+static clock_t
+vdev_mirror_hedge_delay(vdev_t *vd)
+{
+	uint64_t *histo = vd->vdev_stat_ex.vsx_total_histo[ZIO_TYPE_READ];
+	uint64_t total = 0, sum = 0, target;
+	int b;
+
+	if (!vd->vdev_ops->vdev_op_leaf)
+		return (0);
+
+	mutex_enter(&vd->vdev_stat_lock);
+	for (b = 0; b < VDEV_L_HISTO_BUCKETS; b++)
+		total += histo[b];
+	target = total * zfs_vdev_mirror_hedge_pct / 100;
+	for (b = 0; b < VDEV_L_HISTO_BUCKETS - 1; b++) {
+		sum += histo[b];
+		if (sum > target)
+			break;
+	}
+	mutex_exit(&vd->vdev_stat_lock);
+
+	if (total < MIRROR_HEDGE_MIN_SAMPLES)
+		return (0);
+
+	return (MAX(MSEC_TO_TICK(zfs_vdev_mirror_hedge_min_ms),
+	    NSEC_TO_TICK(1ULL << (b + 1))));
+}
+
+static void
+vdev_mirror_hedge_rele(mirror_hedge_t *mh)
+{
+	mutex_enter(&mh->mh_lock);
+	ASSERT3U(mh->mh_refs, >, 0);
+	if (--mh->mh_refs > 0) {
+		mutex_exit(&mh->mh_lock);
+		return;
+	}
+	mutex_exit(&mh->mh_lock);
+
+	mutex_destroy(&mh->mh_lock);
+	kmem_free(mh, sizeof (mirror_hedge_t));
+}
+
+static void
+vdev_mirror_hedge_done(zio_t *zio)
+{
+	mirror_hedge_io_t *mhi = zio->io_private;
+	mirror_hedge_t *mh = mhi->mhi_hedge;
+	mirror_child_t *mc = mhi->mhi_mc;
+	taskqid_t tid = TASKQID_INVALID;
+	zio_t *pio;
+
+	mutex_enter(&mh->mh_lock);
+	ASSERT3U(mh->mh_pending, >, 0);
+	mh->mh_pending--;
+	pio = mh->mh_zio;
+	if (pio != NULL) {
+		mc->mc_error = zio->io_error;
+		mc->mc_tried = 1;
+		mc->mc_skipped = 0;
+
+		/*
+		 * The first good copy completes the mirror zio.  If all the
+		 * reads failed vdev_mirror_io_done() retries the remaining
+		 * children as usual.
+		 */
+		if (zio->io_error == 0 || mh->mh_pending == 0) {
+			if (zio->io_error == 0) {
+				abd_copy(pio->io_abd, mhi->mhi_abd,
+				    pio->io_size);
+				if (mhi != &mh->mh_io[0])
+					MIRROR_BUMP(vdev_mirror_stat_hedge_won);
+			}
+			mh->mh_zio = NULL;
+			if (mh->mh_timer_state == MH_TIMER_PENDING) {
+				mh->mh_timer_state = MH_TIMER_CANCELLED;
+				tid = mh->mh_timer;
+			}
+		} else {
+			pio = NULL;
+		}
+	}
+	mutex_exit(&mh->mh_lock);
+
+	abd_free(mhi->mhi_abd);
+
+	if (pio != NULL)
+		zio_interrupt(pio);
+
+	/*
+	 * Once taskq_cancel_id() returns the timer has either been removed
+	 * or has seen MH_TIMER_CANCELLED, so its reference is ours to drop.
+	 */
+	if (tid != TASKQID_INVALID) {
+		(void) taskq_cancel_id(system_delay_taskq, tid);
+		vdev_mirror_hedge_rele(mh);
+	}
+
+	vdev_mirror_hedge_rele(mh);
+}
+
+/*
+ * Create the read for mhi.  The caller issues it with zio_nowait() after
+ * dropping mh_lock, since it may complete synchronously.
+ */
+static zio_t *
+vdev_mirror_hedge_io(zio_t *zio, mirror_hedge_io_t *mhi)
+{
+	mirror_child_t *mc = mhi->mhi_mc;
+	zio_t *rio, *cio;
+
+	rio = zio_root(zio->io_spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+	rio->io_bookmark = zio->io_bookmark;
+	cio = zio_vdev_child_io(rio, zio->io_bp, mc->mc_vd, mc->mc_offset,
+	    mhi->mhi_abd, zio->io_size, ZIO_TYPE_READ, zio->io_priority,
+	    ZIO_VDEV_CHILD_FLAGS(zio), vdev_mirror_hedge_done, mhi);
+	zio_nowait(rio);
+
+	return (cio);
+}
+
+static void
+vdev_mirror_hedge_timeout(void *arg)
+{
+	mirror_hedge_t *mh = arg;
+	mirror_hedge_io_t *mhi = &mh->mh_io[1];
+	zio_t *pio, *cio = NULL;
+	int c;
+
+	mutex_enter(&mh->mh_lock);
+	if (mh->mh_timer_state == MH_TIMER_CANCELLED) {
+		/* vdev_mirror_hedge_done() drops our reference. */
+		mutex_exit(&mh->mh_lock);
+		return;
+	}
+	mh->mh_timer_state = MH_TIMER_FIRED;
+
+	/*
+	 * Only hedge to a child which vdev_mirror_child_select() prefers,
+	 * not one which is missing this txg and could only be speculative.
+	 */
+	pio = mh->mh_zio;
+	if (pio != NULL && (c = vdev_mirror_child_select(pio)) >= 0 &&
+	    ((mirror_map_t *)pio->io_vsd)->mm_preferred_cnt > 0) {
+		mirror_map_t *mm = pio->io_vsd;
+
+		mhi->mhi_mc = &mm->mm_child[c];
+		mhi->mhi_mc->mc_tried = 1;
+		mhi->mhi_abd = abd_alloc_sametype(pio->io_abd, pio->io_size);
+		mh->mh_pending++;
+		mh->mh_refs++;
+		cio = vdev_mirror_hedge_io(pio, mhi);
+		MIRROR_BUMP(vdev_mirror_stat_hedge_issued);
+	}
+	mutex_exit(&mh->mh_lock);
+
+	if (cio != NULL)
+		zio_nowait(cio);
+
+	vdev_mirror_hedge_rele(mh);
+}
+
+/*
+ * Issue a normal read from child c as a hedged read if enabled.  Returns
+ * B_FALSE if the caller should issue it as a regular child I/O instead.
+ */
+static boolean_t
+vdev_mirror_hedge_start(zio_t *zio, int c)
+{
+	mirror_map_t *mm = zio->io_vsd;
+	mirror_child_t *mc = &mm->mm_child[c];
+	mirror_hedge_t *mh;
+	clock_t delay;
+	zio_t *cio;
+
+	if (zfs_vdev_mirror_hedge_pct == 0 ||
+	    zfs_vdev_mirror_hedge_pct >= 100 || mm->mm_root || zio->io_vd->vdev_ops != &vdev_mirror_ops ||
+	    zio->io_bp == NULL || zio->io_priority != ZIO_PRIORITY_SYNC_READ)
+		return (B_FALSE);
+
+	if ((delay = vdev_mirror_hedge_delay(mc->mc_vd)) == 0)
+		return (B_FALSE);
+
+	mh = kmem_zalloc(sizeof (mirror_hedge_t), KM_SLEEP);
+	mutex_init(&mh->mh_lock, NULL, MUTEX_DEFAULT, NULL);
+	mh->mh_zio = zio;
+	mh->mh_timer_state = MH_TIMER_PENDING;
+	mh->mh_pending = 1;
+	mh->mh_refs = 2;
+	mh->mh_io[0].mhi_hedge = mh;
+	mh->mh_io[0].mhi_mc = mc;
+	mh->mh_io[1].mhi_hedge = mh;
+
+	mutex_enter(&mh->mh_lock);
+	mh->mh_timer = taskq_dispatch_delay(system_delay_taskq,
+	    vdev_mirror_hedge_timeout, mh, TQ_NOSLEEP,
+	    ddi_get_lbolt() + delay);
+	if (mh->mh_timer == TASKQID_INVALID) {
+		mutex_exit(&mh->mh_lock);
+		mutex_destroy(&mh->mh_lock);
+		kmem_free(mh, sizeof (mirror_hedge_t));
+		return (B_FALSE);
+	}
+
+	/*
+	 * As in zio_vdev_child_io(), the child reads verify the checksum
+	 * so the mirror zio need not.
+	 */
+	zio->io_pipeline &= ~ZIO_STAGE_CHECKSUM_VERIFY;
+
+	mc->mc_tried = 1;
+	mh->mh_io[0].mhi_abd = abd_alloc_sametype(zio->io_abd, zio->io_size);
+	cio = vdev_mirror_hedge_io(zio, &mh->mh_io[0]);
+	mutex_exit(&mh->mh_lock);
+
+	zio_nowait(cio);
+	return (B_TRUE);
+}
+
 static void
 vdev_mirror_io_start(zio_t *zio)
 {
@@ -657,6 +946,10 @@ vdev_mirror_io_start(zio_t *zio)
 		 */
 		c = vdev_mirror_child_select(zio);
 		children = (c >= 0);
+
+		/* The hedged read completion resumes the zio. */
+		if (children && vdev_mirror_hedge_start(zio, c))
+			return;
 	} else {
 		ASSERT(zio->io_type == ZIO_TYPE_WRITE);
 
@@ -1038,3 +1331,9 @@ ZFS_MODULE_PARAM(zfs_vdev_mirror, zfs_vdev_mirror_, non_rotating_inc, INT,
 
 ZFS_MODULE_PARAM(zfs_vdev_mirror, zfs_vdev_mirror_, non_rotating_seek_inc, INT,
 	ZMOD_RW, "Non-rotating media load increment for seeking I/Os");
+
+ZFS_MODULE_PARAM(zfs_vdev_mirror, zfs_vdev_mirror_, hedge_pct, UINT, ZMOD_RW,
+	"Percentile of a child's read latency after which to hedge a read");
+
+ZFS_MODULE_PARAM(zfs_vdev_mirror, zfs_vdev_mirror_, hedge_min_ms, UINT,
+	ZMOD_RW, "Minimum time in milliseconds before hedging a read");
@@ -115,6 +115,53 @@
  * maximum percentage, this indicates that the rate of incoming data is
  * greater than the rate that the backend storage can handle. In this case, we
  * must further throttle incoming writes (see dmu_tx_delay() for details).
+ *
+ * Deadlines
+ *
+ * The interactive classes may also be given a deadline: the time from an I/O
+ * being queued to it completing that it should not exceed. An I/O that takes
+ * longer than its class deadline is counted as a miss in the vdev's extended
+ * stats. If zfs_vdev_deadline is set, the scheduler also looks for queued
+ * I/Os that have used up most of their deadline before choosing a class the
+ * normal way. If it finds any, the class whose oldest I/O expires first is
+ * issued from next, oldest I/O first, ignoring its max_active (but not
+ * zfs_vdev_max_active). This stops a sync read from waiting behind a long
+ * train of async writes on slow devices.
+ *
+ * Adaptive Queue Depth
+ *
+ * The same min/max_active values suit neither a deep NVMe queue nor a
+ * shallow HDD one. If zfs_vdev_adaptive_active is set, each leaf vdev scales
+ * the min and max_active of its interactive classes by its own factor. Every
+ * zfs_vdev_adaptive_window completions, the zfs_vdev_adaptive_percentile
+ * device latency of the window is compared with the vdev's baseline (the
+ * lowest seen so far, drifting slowly towards recent values). If it is more
+ * than zfs_vdev_adaptive_latency_pct of the baseline, the device is
+ * overloaded and the factor is cut by a quarter. Otherwise, if I/Os were left
+ * waiting in the queue for most of the window, the factor is raised by 25%.
+ * The factor stays between zfs_vdev_adaptive_min_pct and
+ * zfs_vdev_adaptive_max_pct.
+ *
+ * Queue Bypass
+ *
+ * On fast devices the queue gains little from aggregation, and taking
+ * vq_lock twice per I/O is a significant cost at very high IOPS. If the
+ * queue_bypass property is set on a leaf vdev, interactive I/Os are not
+ * queued at all: they are counted in the per-CPU vq_bypass_active and sent
+ * straight to the vdev, and their completion does not take vq_lock.
+ * Non-interactive and TRIM I/Os are still queued, so that they remain
+ * throttled against the interactive load.
+ *
+ * Multihost Writes
+ *
+ * The uberblock writes of the multihost (MMP) thread are how other hosts
+ * know the pool is in use. If they wait behind a full queue of other
+ * writes long enough, the pool suspends itself (see
+ * zfs_multihost_fail_intervals). So they always take the bypass path
+ * above, whatever the queue_bypass property says, and are sent to the
+ * device as soon as they are issued. As the MMP thread keeps at most one
+ * write outstanding per leaf vdev, this amounts to a single slot per vdev
+ * reserved for them on top of zfs_vdev_max_active.
  */
 
 /*
@@ -154,12 +201,34 @@ static uint_t zfs_vdev_scrub_max_active = 3;
 static uint_t zfs_vdev_removal_min_active = 1;
 static uint_t zfs_vdev_removal_max_active = 2;
 static uint_t zfs_vdev_initializing_min_active = 1;
-static uint_t zfs_vdev_initializing_max_active = 1;
+static uint_t zfs_vdev_initializing_max_active = 4;
 static uint_t zfs_vdev_trim_min_active = 1;
 static uint_t zfs_vdev_trim_max_active = 2;
 static uint_t zfs_vdev_rebuild_min_active = 1;
 static uint_t zfs_vdev_rebuild_max_active = 3;
 
+/*
+ * Per-class I/O deadlines, in milliseconds. 0 means the class has none.
+ * Misses are always counted; they only affect scheduling if
+ * zfs_vdev_deadline is set.
+ */
+static int zfs_vdev_deadline = 0;
+static uint_t zfs_vdev_sync_read_deadline_ms = 100;
+static uint_t zfs_vdev_sync_write_deadline_ms = 100;
+static uint_t zfs_vdev_async_read_deadline_ms = 500;
+static uint_t zfs_vdev_async_write_deadline_ms = 0;
+
+/*
+ * Scale interactive class limits per vdev according to observed device
+ * latency. See "Adaptive Queue Depth" above.
+ */
+static int zfs_vdev_adaptive_active = 0;
+static uint_t zfs_vdev_adaptive_window = 128;
+static uint_t zfs_vdev_adaptive_percentile = 95;
+static uint_t zfs_vdev_adaptive_latency_pct = 200;
+static uint_t zfs_vdev_adaptive_min_pct = 25;
+static uint_t zfs_vdev_adaptive_max_pct = 800;
+
 /*
  * When the pool has less than zfs_vdev_async_write_active_min_dirty_percent
  * dirty data, use zfs_vdev_async_write_min_active.  When it has more than
@@ -203,6 +272,16 @@ static uint_t zfs_vdev_aggregation_limit_non_rotating = SPA_OLD_MAXBLOCKSIZE;
 static uint_t zfs_vdev_read_gap_limit = 32 << 10;
 static uint_t zfs_vdev_write_gap_limit = 4 << 10;
 
+/*
+ * Scan (scrub and resilver) reads differ from normal reads only in flags
+ * that don't affect the physical I/O. If this is set, reads are aggregated
+ * even when those flags differ, so a scrub read next to an async read can
+ * share its I/O.
+ */
+static int zfs_vdev_aggregate_scan_reads = 0;
+#define	VDQ_AGG_SCAN_FLAGS \
+	(ZIO_FLAG_SCRUB | ZIO_FLAG_RESILVER | ZIO_FLAG_SCAN_THREAD)
+
 /*
  * Define the queue depth percentage for each top-level. This percentage is
  * used in conjunction with zfs_vdev_async_max_active to determine how many
@@ -299,18 +378,30 @@ vdev_queue_class_remove(vdev_queue_t *vq, zio_t *zio)
 	vq->vq_cqueued &= ~(empty << p);
 }
 
+static inline uint_t
+vdev_queue_adapt_limit(vdev_queue_t *vq, uint_t limit)
+{
+	if (!zfs_vdev_adaptive_active || vq->vq_adapt_pct == 100)
+		return (limit);
+	return (MAX(1, (uint64_t)limit * vq->vq_adapt_pct / 100));
+}
+
 static uint_t
 vdev_queue_class_min_active(vdev_queue_t *vq, zio_priority_t p)
 {
 	switch (p) {
 	case ZIO_PRIORITY_SYNC_READ:
-		return (zfs_vdev_sync_read_min_active);
+		return (vdev_queue_adapt_limit(vq,
+		    zfs_vdev_sync_read_min_active));
 	case ZIO_PRIORITY_SYNC_WRITE:
-		return (zfs_vdev_sync_write_min_active);
+		return (vdev_queue_adapt_limit(vq,
+		    zfs_vdev_sync_write_min_active));
 	case ZIO_PRIORITY_ASYNC_READ:
-		return (zfs_vdev_async_read_min_active);
+		return (vdev_queue_adapt_limit(vq,
+		    zfs_vdev_async_read_min_active));
 	case ZIO_PRIORITY_ASYNC_WRITE:
-		return (zfs_vdev_async_write_min_active);
+		return (vdev_queue_adapt_limit(vq,
+		    zfs_vdev_async_write_min_active));
 	case ZIO_PRIORITY_SCRUB:
 		return (vq->vq_ia_active == 0 ? zfs_vdev_scrub_min_active :
 		    MIN(vq->vq_nia_credit, zfs_vdev_scrub_min_active));
@@ -382,13 +473,17 @@ vdev_queue_class_max_active(vdev_queue_t *vq, zio_priority_t p)
 {
 	switch (p) {
 	case ZIO_PRIORITY_SYNC_READ:
-		return (zfs_vdev_sync_read_max_active);
+		return (vdev_queue_adapt_limit(vq,
+		    zfs_vdev_sync_read_max_active));
 	case ZIO_PRIORITY_SYNC_WRITE:
-		return (zfs_vdev_sync_write_max_active);
+		return (vdev_queue_adapt_limit(vq,
+		    zfs_vdev_sync_write_max_active));
 	case ZIO_PRIORITY_ASYNC_READ:
-		return (zfs_vdev_async_read_max_active);
+		return (vdev_queue_adapt_limit(vq,
+		    zfs_vdev_async_read_max_active));
 	case ZIO_PRIORITY_ASYNC_WRITE:
-		return (vdev_queue_max_async_writes(vq->vq_vdev->vdev_spa));
+		return (vdev_queue_adapt_limit(vq,
+		    vdev_queue_max_async_writes(vq->vq_vdev->vdev_spa)));
 	case ZIO_PRIORITY_SCRUB:
 		if (vq->vq_ia_active > 0) {
 			return (MIN(vq->vq_nia_credit,
@@ -425,19 +520,99 @@ vdev_queue_class_max_active(vdev_queue_t *vq, zio_priority_t p)
 	}
 }
 
+static hrtime_t
+vdev_queue_class_deadline(zio_priority_t p)
+{
+	uint_t ms;
+
+	switch (p) {
+	case ZIO_PRIORITY_SYNC_READ:
+		ms = zfs_vdev_sync_read_deadline_ms;
+		break;
+	case ZIO_PRIORITY_SYNC_WRITE:
+		ms = zfs_vdev_sync_write_deadline_ms;
+		break;
+	case ZIO_PRIORITY_ASYNC_READ:
+		ms = zfs_vdev_async_read_deadline_ms;
+		break;
+	case ZIO_PRIORITY_ASYNC_WRITE:
+		ms = zfs_vdev_async_write_deadline_ms;
+		break;
+	default:
+		ms = 0;
+		break;
+	}
+	return (MSEC2NSEC(ms));
+}
+
+/*
+ * Return the oldest queued I/O in a class. The LBA-ordered queues only sort
+ * by time down to VDQ_T_SHIFT, which is close enough here.
+ */
+static zio_t *
+vdev_queue_class_oldest(vdev_queue_t *vq, zio_priority_t p)
+{
+	if (vdev_queue_class_fifo(p))
+		return (list_head(&vq->vq_class[p].vqc_list));
+	return (avl_first(&vq->vq_class[p].vqc_tree));
+}
+
+/*
+ * Return the class whose oldest queued I/O is closest to missing its
+ * deadline, if any have used up three quarters of it, or
+ * ZIO_PRIORITY_NUM_QUEUEABLE if none have.
+ */
+static zio_priority_t
+vdev_queue_class_expiring(vdev_queue_t *vq)
+{
+	uint32_t cq = vq->vq_cqueued;
+	zio_priority_t p, ep = ZIO_PRIORITY_NUM_QUEUEABLE;
+	hrtime_t now = gethrtime();
+	hrtime_t eexp = 0;
+
+	for (p = 0; p < ZIO_PRIORITY_NUM_QUEUEABLE; p++) {
+		hrtime_t dl, exp;
+
+		if ((cq & (1U << p)) == 0)
+			continue;
+		if ((dl = vdev_queue_class_deadline(p)) == 0)
+			continue;
+
+		exp = vdev_queue_class_oldest(vq, p)->io_timestamp + dl;
+		if (now >= exp - dl / 4 &&
+		    (ep == ZIO_PRIORITY_NUM_QUEUEABLE || exp < eexp)) {
+			ep = p;
+			eexp = exp;
+		}
+	}
+
+	return (ep);
+}
+
 /*
  * Return the i/o class to issue from, or ZIO_PRIORITY_NUM_QUEUEABLE if
- * there is no eligible class.
+ * there is no eligible class. If the class was chosen because its oldest
+ * I/O is about to miss its deadline, *expiring is set.
  */
 static zio_priority_t
-vdev_queue_class_to_issue(vdev_queue_t *vq)
+vdev_queue_class_to_issue(vdev_queue_t *vq, boolean_t *expiring)
 {
 	uint32_t cq = vq->vq_cqueued;
 	zio_priority_t p, p1;
 
+	*expiring = B_FALSE;
+
 	if (cq == 0 || vq->vq_active >= zfs_vdev_max_active)
 		return (ZIO_PRIORITY_NUM_QUEUEABLE);
 
+	if (zfs_vdev_deadline) {
+		p = vdev_queue_class_expiring(vq);
+		if (p != ZIO_PRIORITY_NUM_QUEUEABLE) {
+			*expiring = B_TRUE;
+			goto found;
+		}
+	}
+
 	/*
 	 * Find a queue that has not reached its minimum # outstanding i/os.
 	 * Do round-robin to reduce starvation due to zfs_vdev_max_active
@@ -499,8 +674,10 @@ vdev_queue_init(vdev_t *vd)
 	    offsetof(struct zio, io_offset_node));
 
 	vq->vq_last_offset = 0;
+	vq->vq_adapt_pct = 100;
 	list_create(&vq->vq_active_list, sizeof (struct zio),
 	    offsetof(struct zio, io_queue_node.l));
+	wmsum_init(&vq->vq_bypass_active, 0);
 	mutex_init(&vq->vq_lock, NULL, MUTEX_DEFAULT, NULL);
 }
 
@@ -519,6 +696,7 @@ vdev_queue_fini(vdev_t *vd)
 	avl_destroy(&vq->vq_write_offset_tree);
 
 	list_destroy(&vq->vq_active_list);
+	wmsum_fini(&vq->vq_bypass_active);
 	mutex_destroy(&vq->vq_lock);
 }
 
@@ -608,6 +786,22 @@ vdev_queue_agg_io_done(zio_t *aio)
 #define	IO_SPAN(fio, lio) ((lio)->io_offset + (lio)->io_size - (fio)->io_offset)
 #define	IO_GAP(fio, lio) (-IO_SPAN(lio, fio))
 
+/*
+ * Can dio be aggregated with an I/O whose AGG_INHERIT flags are flags?
+ * The flags of the aggregate are reduced to those all its members share.
+ */
+static inline boolean_t
+vdev_queue_agg_flags_ok(zio_t *dio, zio_flag_t flags, zio_flag_t mask,
+    zio_flag_t *aflags)
+{
+	zio_flag_t dflags = dio->io_flags & ZIO_FLAG_AGG_INHERIT;
+
+	if ((dflags & mask) != (flags & mask))
+		return (B_FALSE);
+	*aflags &= dflags | mask;
+	return (B_TRUE);
+}
+
 /*
  * Sufficiently adjacent io_offset's in ZIOs will be aggregated. We do this
  * by creating a gang ABD from the adjacent ZIOs io_abd's. By using
@@ -669,6 +863,10 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 	 * The latter requirement is necessary so that certain
 	 * attributes of the I/O, such as whether it's a normal I/O
 	 * or a scrub/resilver, can be preserved in the aggregate.
+	 * With zfs_vdev_aggregate_scan_reads, reads may differ in the
+	 * scan flags; the aggregate then only carries the ones all of
+	 * its reads have, and is issued as the class of the read that
+	 * started it.
 	 * We can include optional I/Os, but don't allow them
 	 * to begin a range as they add no benefit in that situation.
 	 */
@@ -683,11 +881,15 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 	 * recording the last non-optional I/O.
 	 */
 	zio_flag_t flags = zio->io_flags & ZIO_FLAG_AGG_INHERIT;
+	zio_flag_t mask = ZIO_FLAG_AGG_INHERIT;
+	zio_flag_t aflags = flags;
+	if (zio->io_type == ZIO_TYPE_READ && zfs_vdev_aggregate_scan_reads)
+		mask &= ~VDQ_AGG_SCAN_FLAGS;
 	while ((dio = AVL_PREV(t, first)) != NULL &&
-	    (dio->io_flags & ZIO_FLAG_AGG_INHERIT) == flags &&
 	    IO_SPAN(dio, last) <= limit &&
 	    IO_GAP(dio, first) <= maxgap &&
-	    dio->io_type == zio->io_type) {
+	    dio->io_type == zio->io_type &&
+	    vdev_queue_agg_flags_ok(dio, flags, mask, &aflags)) {
 		first = dio;
 		if (mandatory == NULL && !(first->io_flags & ZIO_FLAG_OPTIONAL))
 			mandatory = first;
@@ -709,12 +911,12 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 	 * aggregation limit.
 	 */
 	while ((dio = AVL_NEXT(t, last)) != NULL &&
-	    (dio->io_flags & ZIO_FLAG_AGG_INHERIT) == flags &&
 	    (IO_SPAN(first, dio) <= limit ||
 	    (dio->io_flags & ZIO_FLAG_OPTIONAL)) &&
 	    IO_SPAN(first, dio) <= SPA_MAXBLOCKSIZE &&
 	    IO_GAP(last, dio) <= maxgap &&
-	    dio->io_type == zio->io_type) {
+	    dio->io_type == zio->io_type &&
+	    vdev_queue_agg_flags_ok(dio, flags, mask, &aflags)) {
 		last = dio;
 		if (!(last->io_flags & ZIO_FLAG_OPTIONAL))
 			mandatory = last;
@@ -774,7 +976,7 @@ vdev_queue_aggregate(vdev_queue_t *vq, zio_t *zio)
 
 	aio = zio_vdev_delegated_io(first->io_vd, first->io_offset,
 	    abd, size, first->io_type, zio->io_priority,
-	    flags | ZIO_FLAG_DONT_QUEUE, vdev_queue_agg_io_done, NULL);
+	    aflags | ZIO_FLAG_DONT_QUEUE, vdev_queue_agg_io_done, NULL);
 	aio->io_timestamp = first->io_timestamp;
 
 	nio = first;
@@ -839,19 +1041,20 @@ vdev_queue_io_to_issue(vdev_queue_t *vq)
 	zio_priority_t p;
 	avl_index_t idx;
 	avl_tree_t *tree;
+	boolean_t expiring;
 
 again:
 	ASSERT(MUTEX_HELD(&vq->vq_lock));
 
-	p = vdev_queue_class_to_issue(vq);
+	p = vdev_queue_class_to_issue(vq, &expiring);
 
 	if (p == ZIO_PRIORITY_NUM_QUEUEABLE) {
 		/* No eligible queued i/os */
 		return (NULL);
 	}
 
-	if (vdev_queue_class_fifo(p)) {
-		zio = list_head(&vq->vq_class[p].vqc_list);
+	if (vdev_queue_class_fifo(p) || expiring) {
+		zio = vdev_queue_class_oldest(vq, p);
 	} else {
 		/*
 		 * For LBA-ordered queues (async / scrub / initializing),
@@ -946,6 +1149,21 @@ vdev_queue_io(zio_t *zio)
 	zio->io_flags |= ZIO_FLAG_DONT_QUEUE;
 	zio->io_timestamp = gethrtime();
 
+	/*
+	 * Optional I/Os must go through the queue, as only aggregation
+	 * can give them any purpose. Multihost writes never do: they
+	 * must not wait behind other I/O (see "Multihost Writes" above).
+	 */
+	if ((zio->io_flags & ZIO_FLAG_MMP) ||
+	    (zio->io_vd->vdev_queue_bypass &&
+	    vdev_queue_is_interactive(zio->io_priority) &&
+	    zio->io_type != ZIO_TYPE_TRIM &&
+	    !(zio->io_flags & ZIO_FLAG_NODATA))) {
+		zio->io_queue_state = ZIO_QS_BYPASS;
+		wmsum_add(&vq->vq_bypass_active, 1);
+		return (zio);
+	}
+
 	mutex_enter(&vq->vq_lock);
 	vdev_queue_io_add(vq, zio);
 	nio = vdev_queue_io_to_issue(vq);
@@ -967,6 +1185,83 @@ vdev_queue_io(zio_t *zio)
 	return (nio);
 }
 
+static uint_t
+vdev_queue_lat_bucket(hrtime_t lat)
+{
+	int b;
+
+	if (lat < (1LL << VDQ_LAT_MIN_SHIFT))
+		return (0);
+	b = highbit64(lat) - 1;
+	if (b >= VDQ_LAT_MAX_SHIFT)
+		return (VDQ_LAT_BUCKETS - 1);
+	return ((b - VDQ_LAT_MIN_SHIFT) * 4 + ((lat >> (b - 2)) & 3));
+}
+
+/* Upper bound of the latencies counted in a bucket. */
+static hrtime_t
+vdev_queue_lat_bucket_max(uint_t i)
+{
+	int b = i / 4 + VDQ_LAT_MIN_SHIFT;
+
+	return ((1LL << b) + (i % 4 + 1) * (1LL << (b - 2)));
+}
+
+/*
+ * Record a completion for the adaptive queue depth, and adjust the scale
+ * factor if a window has ended. See "Adaptive Queue Depth" above.
+ */
+static void
+vdev_queue_adapt(vdev_queue_t *vq, zio_t *zio)
+{
+	uint32_t window, target, sum = 0;
+	uint_t i;
+	hrtime_t lat;
+
+	ASSERT(MUTEX_HELD(&vq->vq_lock));
+
+	if (!zfs_vdev_adaptive_active || zio->io_delay == 0 ||
+	    zio->io_type == ZIO_TYPE_TRIM)
+		return;
+
+	vq->vq_adapt_histo[vdev_queue_lat_bucket(zio->io_delay)]++;
+	if (vq->vq_cqueued != 0)
+		vq->vq_adapt_backlog++;
+
+	window = MIN(MAX(zfs_vdev_adaptive_window, 16), UINT16_MAX);
+	if (++vq->vq_adapt_count < window)
+		return;
+
+	target = vq->vq_adapt_count *
+	    MIN(zfs_vdev_adaptive_percentile, 100) / 100;
+	for (i = 0; i < VDQ_LAT_BUCKETS - 1; i++) {
+		sum += vq->vq_adapt_histo[i];
+		if (sum >= target)
+			break;
+	}
+	lat = vdev_queue_lat_bucket_max(i);
+
+	if (vq->vq_adapt_base == 0 || lat < vq->vq_adapt_base)
+		vq->vq_adapt_base = lat;
+	else
+		vq->vq_adapt_base += (lat - vq->vq_adapt_base) / 16;
+
+	if (lat > vq->vq_adapt_base * zfs_vdev_adaptive_latency_pct / 100)
+		vq->vq_adapt_pct = vq->vq_adapt_pct * 3 / 4;
+	else if (vq->vq_adapt_backlog > vq->vq_adapt_count / 2)
+		vq->vq_adapt_pct += 25;
+	vq->vq_adapt_pct = MAX(vq->vq_adapt_pct, zfs_vdev_adaptive_min_pct);
+	vq->vq_adapt_pct = MIN(vq->vq_adapt_pct,
+	    MAX(zfs_vdev_adaptive_max_pct, zfs_vdev_adaptive_min_pct));
+
+	vq->vq_adapt_count = 0;
+	vq->vq_adapt_backlog = 0;
+	memset(vq->vq_adapt_histo, 0, sizeof (vq->vq_adapt_histo));
+}
+
+/* Each completed read moves vq_read_lat 1/VDQ_READ_LAT_WEIGHT of the way. */
+#define	VDQ_READ_LAT_WEIGHT	8
+
 void
 vdev_queue_io_done(zio_t *zio)
 {
@@ -978,8 +1273,41 @@ vdev_queue_io_done(zio_t *zio)
 	vq->vq_io_complete_ts = now;
 	vq->vq_io_delta_ts = zio->io_delta = now - zio->io_timestamp;
 
+	/*
+	 * Keep a moving average of read latency for mirror child selection.
+	 * This can race with another completion, which at worst loses one
+	 * sample.
+	 */
+	if (zio->io_type == ZIO_TYPE_READ) {
+		hrtime_t lat = vq->vq_read_lat;
+		vq->vq_read_lat = (lat == 0) ? zio->io_delta :
+		    lat + (zio->io_delta - lat) / VDQ_READ_LAT_WEIGHT;
+	}
+
+	/*
+	 * The same for synchronous (foreground) I/O only, which the scan
+	 * code uses to back off when it is hurting application latency.
+	 */
+	if (zio->io_priority == ZIO_PRIORITY_SYNC_READ ||
+	    zio->io_priority == ZIO_PRIORITY_SYNC_WRITE) {
+		hrtime_t lat = vq->vq_sync_lat;
+		vq->vq_sync_lat = (lat == 0) ? zio->io_delta :
+		    lat + (zio->io_delta - lat) / VDQ_READ_LAT_WEIGHT;
+		vq->vq_sync_lat_ts = now;
+	}
+
+	if (zio->io_queue_state == ZIO_QS_BYPASS) {
+		wmsum_add(&vq->vq_bypass_active, -1);
+		zio->io_queue_state = ZIO_QS_NONE;
+		return;
+	}
+
+	hrtime_t dl = vdev_queue_class_deadline(zio->io_priority);
+
 	mutex_enter(&vq->vq_lock);
 	vdev_queue_pending_remove(vq, zio);
+	if (dl != 0 && zio->io_delta > dl)
+		vq->vq_deadline_miss[zio->io_priority]++;
 
 	while ((nio = vdev_queue_io_to_issue(vq)) != NULL) {
 		mutex_exit(&vq->vq_lock);
@@ -997,6 +1325,7 @@ vdev_queue_io_done(zio_t *zio)
 		mutex_enter(&vq->vq_lock);
 	}
 
+	vdev_queue_adapt(vq, zio);
 	mutex_exit(&vq->vq_lock);
 }
 
@@ -1053,12 +1382,17 @@ vdev_queue_change_io_priority(zio_t *zio, zio_priority_t priority)
  * As these two methods are only used for load calculations we're not
  * concerned if we get an incorrect value on 32bit platforms due to lack of
  * vq_lock mutex use here, instead we prefer to keep it lock free for
- * performance.
+ * performance. Summing the bypass count has to visit every CPU, so it is
+ * only done when the vdev is bypassing the queue.
  */
 uint32_t
 vdev_queue_length(vdev_t *vd)
 {
-	return (vd->vdev_queue.vq_active);
+	vdev_queue_t *vq = &vd->vdev_queue;
+
+	if (!vd->vdev_queue_bypass)
+		return (vq->vq_active);
+	return (vq->vq_active + MAX(0, wmsum_value(&vq->vq_bypass_active)));
 }
 
 uint64_t
@@ -1067,6 +1401,27 @@ vdev_queue_last_offset(vdev_t *vd)
 	return (vd->vdev_queue.vq_last_offset);
 }
 
+hrtime_t
+vdev_queue_read_latency(vdev_t *vd)
+{
+	return (vd->vdev_queue.vq_read_lat);
+}
+
+/*
+ * Moving average of synchronous I/O latency.  Returns 0 if there has been
+ * no synchronous I/O in the last second, so that a burst of slow requests
+ * does not keep reporting pressure after the workload has gone idle.
+ */
+hrtime_t
+vdev_queue_sync_latency(vdev_t *vd)
+{
+	vdev_queue_t *vq = &vd->vdev_queue;
+
+	if (gethrtime() - vq->vq_sync_lat_ts > SEC2NSEC(1))
+		return (0);
+	return (vq->vq_sync_lat);
+}
+
 uint64_t
 vdev_queue_class_length(vdev_t *vd, zio_priority_t p)
 {
@@ -1086,6 +1441,9 @@ ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, aggregation_limit_non_rotating, UINT,
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, read_gap_limit, UINT, ZMOD_RW,
 	"Aggregate read I/O over gap");
 
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, aggregate_scan_reads, INT, ZMOD_RW,
+	"Aggregate scrub and resilver reads with other reads");
+
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, write_gap_limit, UINT, ZMOD_RW,
 	"Aggregate write I/O over gap");
 
@@ -1152,6 +1510,39 @@ ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, rebuild_max_active, UINT, ZMOD_RW,
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, rebuild_min_active, UINT, ZMOD_RW,
 	"Min active rebuild I/Os per vdev");
 
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, deadline, INT, ZMOD_RW,
+	"Issue I/Os about to miss their class deadline first");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, sync_read_deadline_ms, UINT, ZMOD_RW,
+	"Sync read I/O deadline in milliseconds");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, sync_write_deadline_ms, UINT, ZMOD_RW,
+	"Sync write I/O deadline in milliseconds");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, async_read_deadline_ms, UINT, ZMOD_RW,
+	"Async read I/O deadline in milliseconds");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, async_write_deadline_ms, UINT, ZMOD_RW,
+	"Async write I/O deadline in milliseconds");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, adaptive_active, INT, ZMOD_RW,
+	"Scale per-vdev active I/O limits by observed latency");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, adaptive_window, UINT, ZMOD_RW,
+	"Completions per adaptive queue depth adjustment");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, adaptive_percentile, UINT, ZMOD_RW,
+	"Latency percentile used for adaptive queue depth");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, adaptive_latency_pct, UINT, ZMOD_RW,
+	"Latency over baseline, in percent, that shrinks the queue depth");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, adaptive_min_pct, UINT, ZMOD_RW,
+	"Minimum adaptive scale of active I/O limits, in percent");
+
+ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, adaptive_max_pct, UINT, ZMOD_RW,
+	"Maximum adaptive scale of active I/O limits, in percent");
+
 ZFS_MODULE_PARAM(zfs_vdev, zfs_vdev_, nia_credit, UINT, ZMOD_RW,
 	"Number of non-interactive I/Os to allow in sequence");
 
@@ -2078,11 +2078,21 @@ vdev_raidz_reconstruct_row(raidz_map_t *rm, raidz_row_t *rr,
 
 	dt = &tgts[nbadparity];
 
-	/* Reconstruct using the new math implementation */
+	/*
+	 * Reconstruct using the new math implementation. It has a method for
+	 * every recoverable combination of up to three missing data columns,
+	 * for raidz and draid rows alike, so the scalar routines below are
+	 * normally only used when the "original" implementation is selected.
+	 */
 	ret = vdev_raidz_math_reconstruct(rm, rr, parity_valid, dt, nbaddata);
 	if (ret != RAIDZ_ORIGINAL_IMPL)
 		return;
 
+	if (zfs_flags & ZFS_DEBUG_RAIDZ_RECONSTRUCT) {
+		zfs_dbgmsg("reconstruct(rm=%px) using original impl "
+		    "(ops=%s nbaddata=%u)", rr, rm->rm_ops->name, nbaddata);
+	}
+
 	/*
 	 * See if we can use any of our optimized reconstruction routines.
 	 */
@@ -3777,22 +3787,32 @@ raidz_reflow_complete_sync(void *arg, dmu_tx_t *tx)
 	 * setup a scrub. All the data has been sucessfully copied
 	 * but we have not validated any checksums.
 	 */
-	pool_scan_func_t func = POOL_SCAN_SCRUB;
-	if (zfs_scrub_after_expand && dsl_scan_setup_check(&func, tx) == 0)
-		dsl_scan_setup_sync(&func, tx);
+	setup_sync_arg_t setup_sync_arg = {
+		.func = POOL_SCAN_SCRUB,
+		.txgstart = 0,
+		.txgend = 0,
+	};
+	if (zfs_scrub_after_expand &&
+	    dsl_scan_setup_check(&setup_sync_arg, tx) == 0)
+		dsl_scan_setup_sync(&setup_sync_arg, tx);
 }
 
 /*
- * Struct for one copy zio.
+ * Struct for one copy operation: a contiguous run of sectors that is read
+ * with one zio per old child and written with one zio per new child.
  */
 typedef struct raidz_reflow_arg {
 	vdev_raidz_expand_t *rra_vre;
 	zfs_locked_range_t *rra_lr;
 	uint64_t rra_txg;
+	uint32_t rra_reads;	/* reads still outstanding */
+	uint_t rra_writes;	/* writes still outstanding */
+	uint_t rra_nwrites;
+	zio_t *rra_zio[];	/* the writes, issued once all reads are done */
 } raidz_reflow_arg_t;
 
 /*
- * The write of the new location is done.
+ * A write of the new location is done.
  */
 static void
 raidz_reflow_write_done(zio_t *zio)
@@ -3816,17 +3836,22 @@ raidz_reflow_write_done(zio_t *zio)
 		    zio->io_size;
 	}
 	cv_signal(&vre->vre_cv);
+	boolean_t done = (--rra->rra_writes == 0);
 	mutex_exit(&vre->vre_lock);
 
+	if (!done)
+		return;
+
 	zfs_rangelock_exit(rra->rra_lr);
 
-	kmem_free(rra, sizeof (*rra));
+	kmem_free(rra, sizeof (*rra) + sizeof (zio_t *) * rra->rra_nwrites);
 	spa_config_exit(zio->io_spa, SCL_STATE, zio->io_spa);
 }
 
 /*
- * The read of the old location is done.  The parent zio is the write to
- * the new location.  Allow it to start.
+ * A read of the old location is done.  Its buffer was assembled from
+ * pieces of the write buffers, so once all reads are done the writes to
+ * the new location can start.
  */
 static void
 raidz_reflow_read_done(zio_t *zio)
@@ -3834,6 +3859,8 @@ raidz_reflow_read_done(zio_t *zio)
 	raidz_reflow_arg_t *rra = zio->io_private;
 	vdev_raidz_expand_t *vre = rra->rra_vre;
 
+	abd_free(zio->io_abd);
+
 	/*
 	 * If the read failed, or if it was done on a vdev that is not fully
 	 * healthy (e.g. a child that has a resilver in progress), we may not
@@ -3857,7 +3884,11 @@ raidz_reflow_read_done(zio_t *zio)
 		mutex_exit(&vre->vre_lock);
 	}
 
-	zio_nowait(zio_unique_parent(zio));
+	if (atomic_dec_32_nv(&rra->rra_reads) > 0)
+		return;
+
+	for (uint_t i = 0; i < rra->rra_nwrites; i++)
+		zio_nowait(rra->rra_zio[i]);
 }
 
 static void
@@ -3938,22 +3969,36 @@ raidz_reflow_impl(vdev_t *vd, vdev_raidz_expand_t *vre, range_tree_t *rt,
 		return (B_TRUE);
 	}
 
+	/*
+	 * Copy as much of this segment as we can in one go, up to a full
+	 * record per old child, so that each child sees large sequential
+	 * reads and writes rather than one sector at a time.
+	 */
+	size = MIN(size, raidz_expand_max_copy_bytes);
+	size = MIN(size, (uint64_t)old_children *
+	    MIN(zfs_max_recordsize, SPA_MAXBLOCKSIZE));
+	size = MAX(size, length);
+	uint64_t blocks = MIN(size >> ashift, next_overwrite_blkid - blkid);
+	length = blocks << ashift;
+
 	range_tree_remove(rt, offset, length);
 
-	raidz_reflow_arg_t *rra = kmem_zalloc(sizeof (*rra), KM_SLEEP);
+	uint_t reads = MIN(blocks, old_children);
+	uint_t writes = MIN(blocks, vd->vdev_children);
+	raidz_reflow_arg_t *rra = kmem_zalloc(sizeof (*rra) +
+	    sizeof (zio_t *) * writes, KM_SLEEP);
 	rra->rra_vre = vre;
 	rra->rra_lr = zfs_rangelock_enter(&vre->vre_rangelock,
 	    offset, length, RL_WRITER);
 	rra->rra_txg = dmu_tx_get_txg(tx);
+	rra->rra_reads = reads;
+	rra->rra_writes = writes;
+	rra->rra_nwrites = writes;
 
 	raidz_reflow_record_progress(vre, offset + length, tx);
 
-	mutex_enter(&vre->vre_lock);
-	vre->vre_outstanding_bytes += length;
-	mutex_exit(&vre->vre_lock);
-
 	/*
-	 * SCL_STATE will be released when the read and write are done,
+	 * SCL_STATE will be released when the reads and writes are done,
 	 * by raidz_reflow_write_done().
 	 */
 	spa_config_enter(spa, SCL_STATE, spa, RW_READER);
@@ -3973,28 +4018,63 @@ raidz_reflow_impl(vdev_t *vd, vdev_raidz_expand_t *vre, range_tree_t *rt,
 
 		/* drop everything we acquired */
 		zfs_rangelock_exit(rra->rra_lr);
-		kmem_free(rra, sizeof (*rra));
+		kmem_free(rra, sizeof (*rra) + sizeof (zio_t *) * writes);
 		spa_config_exit(spa, SCL_STATE, spa);
 		return (B_TRUE);
 	}
 
+	mutex_enter(&vre->vre_lock);
+	vre->vre_outstanding_bytes += length;
+	mutex_exit(&vre->vre_lock);
+
+	/*
+	 * Sector k of the run lives on old child (blkid + k) % old_children
+	 * and moves to new child (blkid + k) % vdev_children, so each child
+	 * gets one contiguous range of sectors on either side. Create the
+	 * writes first, then build each read buffer from the pieces of the
+	 * write buffers its sectors end up in.
+	 */
 	zio_t *pio = spa->spa_txg_zio[txgoff];
-	abd_t *abd = abd_alloc_for_io(length, B_FALSE);
-	zio_t *write_zio = zio_vdev_child_io(pio, NULL,
-	    vd->vdev_child[blkid % vd->vdev_children],
-	    (blkid / vd->vdev_children) << ashift,
-	    abd, length,
-	    ZIO_TYPE_WRITE, ZIO_PRIORITY_REMOVAL,
-	    ZIO_FLAG_CANFAIL,
-	    raidz_reflow_write_done, rra);
-
-	zio_nowait(zio_vdev_child_io(write_zio, NULL,
-	    vd->vdev_child[blkid % old_children],
-	    (blkid / old_children) << ashift,
-	    abd, length,
-	    ZIO_TYPE_READ, ZIO_PRIORITY_REMOVAL,
-	    ZIO_FLAG_CANFAIL,
-	    raidz_reflow_read_done, rra));
+	for (uint_t i = 0; i < writes; i++) {
+		uint64_t n = (blocks - i + vd->vdev_children - 1) /
+		    vd->vdev_children;
+		abd_t *abd = abd_alloc_for_io(n << ashift, B_FALSE);
+
+		rra->rra_zio[i] = zio_vdev_child_io(pio, NULL,
+		    vd->vdev_child[(blkid + i) % vd->vdev_children],
+		    ((blkid + i) / vd->vdev_children) << ashift,
+		    abd, n << ashift,
+		    ZIO_TYPE_WRITE, ZIO_PRIORITY_REMOVAL,
+		    ZIO_FLAG_CANFAIL,
+		    raidz_reflow_write_done, rra);
+	}
+
+	for (uint_t i = 0; i < reads; i++) {
+		uint64_t n = (blocks - i + old_children - 1) / old_children;
+		abd_t *abd;
+
+		if (n == 1) {
+			abd = abd_get_offset_size(
+			    rra->rra_zio[i % vd->vdev_children]->io_abd,
+			    (i / vd->vdev_children) << ashift, 1 << ashift);
+		} else {
+			abd = abd_alloc_gang();
+			for (uint64_t k = i; k < blocks; k += old_children) {
+				abd_gang_add(abd, abd_get_offset_size(
+				    rra->rra_zio[k % vd->vdev_children]->io_abd,
+				    (k / vd->vdev_children) << ashift,
+				    1 << ashift), B_TRUE);
+			}
+		}
+
+		zio_nowait(zio_vdev_child_io(pio, NULL,
+		    vd->vdev_child[(blkid + i) % old_children],
+		    ((blkid + i) / old_children) << ashift,
+		    abd, n << ashift,
+		    ZIO_TYPE_READ, ZIO_PRIORITY_REMOVAL,
+		    ZIO_FLAG_CANFAIL,
+		    raidz_reflow_read_done, rra));
+	}
 
 	return (B_FALSE);
 }
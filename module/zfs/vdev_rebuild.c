@@ -70,6 +70,15 @@
  *   - Sequential reconstruction is not possible on RAIDZ due to its
  *     variable stripe width.  Note dRAID uses a fixed stripe width which
  *     avoids this issue, but comes at the expense of some usable capacity.
+ *     On RAIDZ each block is its own parity stripe: which columns hold
+ *     parity, where the stripe wraps to the next row, and how many skip
+ *     sectors pad it out are all functions of the block's size and
+ *     offset.  A range from the space map may contain many blocks
+ *     back to back, and nothing in it records where one ends and the next
+ *     begins, so the missing column cannot be computed from the others
+ *     without the block pointers.  RAIDZ resilvers instead rely on the
+ *     sorted scan in dsl_scan.c (zfs_scan_legacy=0), which gathers block
+ *     pointers into per-vdev extent ranges and issues them in LBA order.
  *
  *   - Block checksums are not verified during sequential reconstruction.
  *     Similar to traditional RAID the parity/mirror data is reconstructed
@@ -81,6 +90,17 @@
  *     supported.  When adding another vdev to an active top-level resilver
  *     it must be restarted.
  *
+ *   - Rebuild I/O is issued strictly in LBA order, because progress is
+ *     recorded as a single offset (vrp_last_offset) from which an
+ *     interrupted rebuild resumes.  Issuing segments out of order would
+ *     require tracking the completed ranges on disk instead.  For dRAID
+ *     this costs little: consecutive groups rotate through the rows of the
+ *     permutation map, so with zfs_rebuild_vdev_limit bytes in flight per
+ *     child the reads are spread over all children, and every child holds
+ *     the same share of the data, so no ordering can finish sooner than
+ *     the slowest child allows.  The per-child rebuild queue depth and
+ *     latency can be watched with "zpool iostat -q" and "zpool iostat -l".
+ *
  * Advantages:
  *
  *   - Sequential reconstruction is performed in LBA order which may be faster
@@ -345,10 +365,14 @@ vdev_rebuild_complete_sync(void *arg, dmu_tx_t *tx)
 	 * While we're in syncing context take the opportunity to
 	 * setup the scrub when there are no more active rebuilds.
 	 */
-	pool_scan_func_t func = POOL_SCAN_SCRUB;
-	if (dsl_scan_setup_check(&func, tx) == 0 &&
+	setup_sync_arg_t setup_sync_arg = {
+		.func = POOL_SCAN_SCRUB,
+		.txgstart = 0,
+		.txgend = 0,
+	};
+	if (dsl_scan_setup_check(&setup_sync_arg, tx) == 0 &&
 	    zfs_rebuild_scrub_enabled) {
-		dsl_scan_setup_sync(&func, tx);
+		dsl_scan_setup_sync(&setup_sync_arg, tx);
 	}
 
 	cv_broadcast(&vd->vdev_rebuild_cv);
@@ -91,10 +91,12 @@ typedef struct vdev_copy_arg {
 
 /*
  * The maximum amount of memory we can use for outstanding i/o while
- * doing a device removal.  This determines how much i/o we can have
- * in flight concurrently.
+ * doing a device removal, per top-level vdev that the data can be copied
+ * to.  This determines how much i/o we can have in flight concurrently,
+ * so that the copy speeds up as the pool has more vdevs to write to.  The
+ * total is limited to 1/16th of memory.
  */
-static const uint_t zfs_remove_max_copy_bytes = 64 * 1024 * 1024;
+static uint_t zfs_remove_max_copy_bytes = 64 * 1024 * 1024;
 
 /*
  * The largest contiguous segment that we will attempt to allocate when
@@ -1574,6 +1576,25 @@ spa_remove_max_segment(spa_t *spa)
 	return (P2ROUNDUP(zfs_remove_max_segment, 1 << spa->spa_max_ashift));
 }
 
+/*
+ * The amount of copy i/o the removal thread may have outstanding, scaled
+ * by the number of vdevs which the removing vdev's data can be copied to.
+ * The allocator spreads the copies across those vdevs, so each of them
+ * gets about zfs_remove_max_copy_bytes in flight.
+ */
+static uint64_t
+spa_vdev_remove_max_copy_bytes(vdev_t *vd)
+{
+	metaslab_class_t *mc = vd->vdev_mg->mg_class;
+	uint64_t ndest = mc->mc_groups;
+
+	if (mc != spa_normal_class(vd->vdev_spa))
+		ndest += spa_normal_class(vd->vdev_spa)->mc_groups;
+
+	return (MIN((uint64_t)zfs_remove_max_copy_bytes * MAX(ndest, 1),
+	    MAX(physmem * PAGESIZE / 16, zfs_remove_max_copy_bytes)));
+}
+
 /*
  * The removal thread operates in open context.  It iterates over all
  * allocated space in the vdev, by loading each metaslab's spacemap.
@@ -1617,6 +1638,8 @@ spa_vdev_remove_thread(void *arg)
 	vca.vca_write_error_bytes = 0;
 
 	mutex_enter(&svr->svr_lock);
+	svr->svr_pass_start = gethrestime_sec();
+	svr->svr_pass_copied_base = spa->spa_removing_phys.sr_copied;
 
 	/*
 	 * Start from vim_max_offset so we pick up where we left off
@@ -1690,6 +1713,8 @@ spa_vdev_remove_thread(void *arg)
 			 * lock for reader).  So we can't hold the config lock
 			 * while calling dmu_tx_assign().
 			 */
+			uint64_t max_copy_bytes =
+			    spa_vdev_remove_max_copy_bytes(vd);
 			spa_config_exit(spa, SCL_CONFIG, FTAG);
 
 			/*
@@ -1702,10 +1727,8 @@ spa_vdev_remove_thread(void *arg)
 				delay(hz);
 
 			mutex_enter(&vca.vca_lock);
-			while (vca.vca_outstanding_bytes >
-			    zfs_remove_max_copy_bytes) {
+			while (vca.vca_outstanding_bytes > max_copy_bytes)
 				cv_wait(&vca.vca_cv, &vca.vca_lock);
-			}
 			mutex_exit(&vca.vca_lock);
 
 			dmu_tx_t *tx =
@@ -2526,6 +2549,16 @@ spa_removal_get_stats(spa_t *spa, pool_removal_stat_t *prs)
 	prs->prs_to_copy = spa->spa_removing_phys.sr_to_copy;
 	prs->prs_copied = spa->spa_removing_phys.sr_copied;
 
+	spa_vdev_removal_t *svr = spa->spa_vdev_removal;
+	if (svr != NULL && svr->svr_pass_start != 0) {
+		prs->prs_pass_start = svr->svr_pass_start;
+		prs->prs_pass_copied =
+		    prs->prs_copied - svr->svr_pass_copied_base;
+	} else {
+		prs->prs_pass_start = 0;
+		prs->prs_pass_copied = 0;
+	}
+
 	prs->prs_mapping_memory = 0;
 	uint64_t indirect_vdev_id =
 	    spa->spa_removing_phys.sr_prev_indirect_vdev;
@@ -2545,6 +2578,10 @@ spa_removal_get_stats(spa_t *spa, pool_removal_stat_t *prs)
 ZFS_MODULE_PARAM(zfs_vdev, zfs_, removal_ignore_errors, INT, ZMOD_RW,
 	"Ignore hard IO errors when removing device");
 
+ZFS_MODULE_PARAM(zfs_vdev, zfs_, remove_max_copy_bytes, UINT, ZMOD_RW,
+	"Max bytes of copy I/O in flight per destination vdev when removing "
+	"a device");
+
 ZFS_MODULE_PARAM(zfs_vdev, zfs_, remove_max_segment, UINT, ZMOD_RW,
 	"Largest contiguous segment to allocate when removing device");
 
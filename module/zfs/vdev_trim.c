@@ -121,6 +121,12 @@ unsigned int zfs_trim_metaslab_skip = 0;
  */
 static unsigned int zfs_trim_queue_limit = 10;
 
+/*
+ * Number of metaslabs which are disabled and trimmed together by a manual
+ * TRIM, so that the queue does not drain at every metaslab boundary.
+ */
+static unsigned int zfs_trim_metaslab_batch = 4;
+
 /*
  * The minimum number of transaction groups between automatic trims of a
  * metaslab.  This setting represents a trade-off between issuing more
@@ -137,6 +143,16 @@ static unsigned int zfs_trim_queue_limit = 10;
  */
 static unsigned int zfs_trim_txg_batch = 32;
 
+/*
+ * When an automatic TRIM takes longer than this to complete, the device is
+ * assumed to be struggling with it at the expense of other I/O, and the
+ * delay between automatic TRIMs to the leaf vdev is doubled, up to
+ * zfs_trim_autotrim_delay_max_ms.  Each TRIM which completes faster halves
+ * the delay again.  0 disables this.
+ */
+static unsigned int zfs_trim_autotrim_latency_ms = 0;
+static unsigned int zfs_trim_autotrim_delay_max_ms = 1000;
+
 /*
  * The trim_args are a control structure which describe how a leaf vdev
  * should be trimmed.  The core elements are the vdev, the metaslab being
@@ -443,6 +459,15 @@ vdev_autotrim_cb(zio_t *zio)
 		    1, zio->io_orig_size, 0, 0, 0, 0);
 	}
 
+	if (zfs_trim_autotrim_latency_ms == 0) {
+		vd->vdev_autotrim_delay_ms = 0;
+	} else if (zio->io_delta > MSEC2NSEC(zfs_trim_autotrim_latency_ms)) {
+		vd->vdev_autotrim_delay_ms = MIN(MAX(vd->vdev_autotrim_delay_ms
+		    * 2, 1), zfs_trim_autotrim_delay_max_ms);
+	} else {
+		vd->vdev_autotrim_delay_ms /= 2;
+	}
+
 	ASSERT3U(vd->vdev_trim_inflight[TRIM_TYPE_AUTO], >, 0);
 	vd->vdev_trim_inflight[TRIM_TYPE_AUTO]--;
 	cv_broadcast(&vd->vdev_trim_io_cv);
@@ -515,6 +540,21 @@ vdev_trim_range(trim_args_t *ta, uint64_t start, uint64_t size)
 			    MSEC_TO_TICK(10));
 		}
 	}
+
+	/*
+	 * Space out automatic TRIM I/Os while the device is slow to
+	 * complete them, see zfs_trim_autotrim_latency_ms.
+	 */
+	if (ta->trim_type == TRIM_TYPE_AUTO && vd->vdev_autotrim_delay_ms > 0) {
+		clock_t deadline = ddi_get_lbolt() +
+		    MAX(MSEC_TO_TICK(vd->vdev_autotrim_delay_ms), 1);
+
+		while (ddi_get_lbolt() < deadline &&
+		    !vdev_autotrim_should_stop(vd->vdev_top)) {
+			(void) cv_timedwait_idle(&vd->vdev_trim_io_cv,
+			    &vd->vdev_trim_io_lock, deadline);
+		}
+	}
 	ta->trim_bytes_done += size;
 
 	/* Limit in flight trimming I/Os */
@@ -595,16 +635,55 @@ vdev_trim_ranges(trim_args_t *ta)
 	zfs_btree_index_t idx;
 	uint64_t extent_bytes_max = ta->trim_extent_bytes_max;
 	uint64_t extent_bytes_min = ta->trim_extent_bytes_min;
+	uint64_t granularity = vd->vdev_trim_granularity;
 	spa_t *spa = vd->vdev_spa;
 	int error = 0;
 
+	/*
+	 * Devices ignore, or handle slowly, the parts of a discard which do
+	 * not cover whole units of their discard granularity.  When that is
+	 * larger than the allocation size, trim only the whole units of each
+	 * range, and never issue more than the device accepts in one
+	 * discard so the block layer does not have to split it.
+	 */
+	if (granularity <= (1ULL << vd->vdev_ashift))
+		granularity = 0;
+	if (vd->vdev_trim_max_bytes != 0) {
+		extent_bytes_max = MIN(extent_bytes_max,
+		    vd->vdev_trim_max_bytes);
+	}
+	if (granularity != 0) {
+		extent_bytes_max = MAX(extent_bytes_max -
+		    extent_bytes_max % granularity, granularity);
+	}
+
 	ta->trim_start_time = gethrtime();
 	ta->trim_bytes_done = 0;
 
 	for (range_seg_t *rs = zfs_btree_first(t, &idx); rs != NULL;
 	    rs = zfs_btree_next(t, &idx, &idx)) {
-		uint64_t size = rs_get_end(rs, ta->trim_tree) - rs_get_start(rs,
-		    ta->trim_tree);
+		uint64_t start = VDEV_LABEL_START_SIZE +
+		    rs_get_start(rs, ta->trim_tree);
+		uint64_t end = VDEV_LABEL_START_SIZE +
+		    rs_get_end(rs, ta->trim_tree);
+
+		if (granularity != 0) {
+			uint64_t astart = start +
+			    (granularity - start % granularity) % granularity;
+			uint64_t aend = end - end % granularity;
+
+			if (aend <= astart) {
+				spa_iostats_trim_add(spa, ta->trim_type,
+				    0, 0, 1, end - start, 0, 0);
+				continue;
+			}
+			spa_iostats_trim_add(spa, ta->trim_type, 0, 0, 0,
+			    (astart - start) + (end - aend), 0, 0);
+			start = astart;
+			end = aend;
+		}
+
+		uint64_t size = end - start;
 
 		if (extent_bytes_min && size < extent_bytes_min) {
 			spa_iostats_trim_add(spa, ta->trim_type,
@@ -616,9 +695,8 @@ vdev_trim_ranges(trim_args_t *ta)
 		uint64_t writes_required = ((size - 1) / extent_bytes_max) + 1;
 
 		for (uint64_t w = 0; w < writes_required; w++) {
-			error = vdev_trim_range(ta, VDEV_LABEL_START_SIZE +
-			    rs_get_start(rs, ta->trim_tree) +
-			    (w *extent_bytes_max), MIN(size -
+			error = vdev_trim_range(ta, start +
+			    (w * extent_bytes_max), MIN(size -
 			    (w * extent_bytes_max), extent_bytes_max));
 			if (error != 0) {
 				goto done;
@@ -914,11 +992,20 @@ vdev_trim_thread(void *arg)
 		ta.trim_extent_bytes_min = SPA_MINBLOCKSIZE;
 	}
 
+	/*
+	 * Metaslabs are trimmed in batches of consecutive metaslabs, so the
+	 * TRIMs are still issued in offset order, as required to track
+	 * progress with vdev_trim_offset.  vdev_trim_ranges() waits for all
+	 * of them before the metaslabs are enabled again.
+	 */
+	uint64_t batch = MAX(zfs_trim_metaslab_batch, 1);
+	metaslab_t **msps = kmem_alloc(batch * sizeof (metaslab_t *),
+	    KM_SLEEP);
 	uint64_t ms_count = 0;
-	for (uint64_t i = 0; !vd->vdev_detached &&
-	    i < vd->vdev_top->vdev_ms_count; i++) {
-		metaslab_t *msp = vd->vdev_top->vdev_ms[i];
+	uint64_t nms;
 
+	for (uint64_t i = 0; !vd->vdev_detached &&
+	    i < vd->vdev_top->vdev_ms_count; i += nms) {
 		/*
 		 * If we've expanded the top-level vdev or it's our
 		 * first pass, calculate our progress.
@@ -928,31 +1015,47 @@ vdev_trim_thread(void *arg)
 			ms_count = vd->vdev_top->vdev_ms_count;
 		}
 
+		nms = MIN(batch, vd->vdev_top->vdev_ms_count - i);
+		uint64_t ntrim = 0;
+		boolean_t skipped = B_FALSE;
+
+		for (uint64_t j = 0; j < nms; j++)
+			msps[j] = vd->vdev_top->vdev_ms[i + j];
+
 		spa_config_exit(spa, SCL_CONFIG, FTAG);
-		metaslab_disable(msp);
-		mutex_enter(&msp->ms_lock);
-		VERIFY0(metaslab_load(msp));
+		for (uint64_t j = 0; j < nms; j++) {
+			metaslab_t *msp = msps[j];
 
-		/*
-		 * If a partial TRIM was requested skip metaslabs which have
-		 * never been initialized and thus have never been written.
-		 */
-		if (msp->ms_sm == NULL && vd->vdev_trim_partial) {
+			metaslab_disable(msp);
+			mutex_enter(&msp->ms_lock);
+			VERIFY0(metaslab_load(msp));
+
+			/*
+			 * If a partial TRIM was requested skip metaslabs
+			 * which have never been initialized and thus have
+			 * never been written.
+			 */
+			if (msp->ms_sm == NULL && vd->vdev_trim_partial) {
+				mutex_exit(&msp->ms_lock);
+				metaslab_enable(msp, B_FALSE, B_FALSE);
+				skipped = B_TRUE;
+				continue;
+			}
+
+			ta.trim_msp = msp;
+			range_tree_walk(msp->ms_allocatable,
+			    vdev_trim_range_add, &ta);
+			range_tree_vacate(msp->ms_trim, NULL, NULL);
 			mutex_exit(&msp->ms_lock);
-			metaslab_enable(msp, B_FALSE, B_FALSE);
-			spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
-			vdev_trim_calculate_progress(vd);
-			continue;
+			msps[ntrim++] = msp;
 		}
 
-		ta.trim_msp = msp;
-		range_tree_walk(msp->ms_allocatable, vdev_trim_range_add, &ta);
-		range_tree_vacate(msp->ms_trim, NULL, NULL);
-		mutex_exit(&msp->ms_lock);
-
 		error = vdev_trim_ranges(&ta);
-		metaslab_enable(msp, B_TRUE, B_FALSE);
+		for (uint64_t j = 0; j < ntrim; j++)
+			metaslab_enable(msps[j], B_TRUE, B_FALSE);
 		spa_config_enter(spa, SCL_CONFIG, FTAG, RW_READER);
+		if (skipped)
+			vdev_trim_calculate_progress(vd);
 
 		range_tree_vacate(ta.trim_tree, NULL, NULL);
 		if (error != 0)
@@ -960,6 +1063,7 @@ vdev_trim_thread(void *arg)
 	}
 
 	spa_config_exit(spa, SCL_CONFIG, FTAG);
+	kmem_free(msps, batch * sizeof (metaslab_t *));
 
 	range_tree_destroy(ta.trim_tree);
 
@@ -1786,3 +1890,12 @@ ZFS_MODULE_PARAM(zfs_trim, zfs_trim_, txg_batch, UINT, ZMOD_RW,
 
 ZFS_MODULE_PARAM(zfs_trim, zfs_trim_, queue_limit, UINT, ZMOD_RW,
 	"Max queued TRIMs outstanding per leaf vdev");
+
+ZFS_MODULE_PARAM(zfs_trim, zfs_trim_, metaslab_batch, UINT, ZMOD_RW,
+	"Number of metaslabs trimmed together by a manual TRIM");
+
+ZFS_MODULE_PARAM(zfs_trim, zfs_trim_, autotrim_latency_ms, UINT, ZMOD_RW,
+	"Back off automatic TRIM when TRIMs take longer than this");
+
+ZFS_MODULE_PARAM(zfs_trim, zfs_trim_, autotrim_delay_max_ms, UINT, ZMOD_RW,
+	"Max delay between automatic TRIMs when backing off");
@@ -81,6 +81,15 @@
  */
 static int zap_iterate_prefetch = B_TRUE;
 
+/*
+ * The initial prefetch is capped by dmu_prefetch_max, and a cursor resumed
+ * from a serialized position (e.g. by each getdents() call) does not do it
+ * at all.  So, unless zap_iterate_prefetch is disabled, each time a cursor
+ * moves to a new leaf it also prefetches the leaves holding the next
+ * zap_iterate_readahead ranges of hashes.
+ */
+static uint_t zap_iterate_readahead = 16;
+
 /*
  * Enable ZAP shrinking. When enabled, empty sibling leaf blocks will be
  * collapsed into a single block.
@@ -1294,6 +1303,35 @@ zap_increment_int(objset_t *os, uint64_t obj, uint64_t key, int64_t delta,
  * Routines for iterating over the attributes.
  */
 
+/*
+ * Prefetch the leaves for up to zap_iterate_readahead pointer table entries
+ * after the one for hash h, which is the order the cursor visits them in.
+ * A leaf may be referenced by several consecutive entries, so the number of
+ * entries examined is bounded too.
+ */
+static void
+zap_cursor_readahead(zap_t *zap, uint64_t h)
+{
+	int bs = FZAP_BLOCK_SHIFT(zap);
+	int shift = zap_f_phys(zap)->zap_ptrtbl.zt_shift;
+	uint64_t idx = ZAP_HASH_IDX(h, shift);
+	uint64_t end = MIN(1ULL << shift,
+	    idx + 1 + 4 * (uint64_t)zap_iterate_readahead);
+	uint64_t blk, lastblk = 0;
+	uint_t n = 0;
+
+	while (++idx < end && n < zap_iterate_readahead) {
+		if (zap_idx_to_blk(zap, idx, &blk) != 0)
+			break;
+		if (blk == lastblk)
+			continue;
+		lastblk = blk;
+		dmu_prefetch_by_dnode(zap->zap_dnode, 0, blk << bs, 1ULL << bs,
+		    ZIO_PRIORITY_ASYNC_READ);
+		n++;
+	}
+}
+
 int
 fzap_cursor_retrieve(zap_t *zap, zap_cursor_t *zc, zap_attribute_t *za)
 {
@@ -1336,6 +1374,9 @@ fzap_cursor_retrieve(zap_t *zap, zap_cursor_t *zc, zap_attribute_t *za)
 
 again:
 	if (zc->zc_leaf == NULL) {
+		if (zap_iterate_prefetch && zc->zc_prefetch &&
+		    zap_f_phys(zap)->zap_freeblk > 2)
+			zap_cursor_readahead(zap, zc->zc_hash);
 		err = zap_deref_leaf(zap, zc->zc_hash, NULL, RW_READER,
 		    &zc->zc_leaf);
 		if (err != 0)
@@ -1704,6 +1745,10 @@ zap_shrink(zap_name_t *zn, zap_leaf_t *l, dmu_tx_t *tx)
 ZFS_MODULE_PARAM(zfs, , zap_iterate_prefetch, INT, ZMOD_RW,
 	"When iterating ZAP object, prefetch it");
 
+/* CSTYLED */
+ZFS_MODULE_PARAM(zfs, , zap_iterate_readahead, UINT, ZMOD_RW,
+	"When iterating ZAP object, prefetch this many leaves ahead");
+
 /* CSTYLED */
 ZFS_MODULE_PARAM(zfs, , zap_shrink_enabled, INT, ZMOD_RW,
 	"Enable ZAP shrinking");
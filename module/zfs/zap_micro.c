@@ -414,6 +414,15 @@ mze_destroy(zap_t *zap)
 	zfs_btree_destroy(&zap->zap_m.zap_tree);
 }
 
+/*
+ * The in-memory index of a micro ZAP is a B-tree of 8-byte mzap_ent_t
+ * (hash, cd, chunk id), built once when the ZAP is first opened and kept
+ * for as long as its dbuf is cached; the names stay in the dbuf.  Lookups
+ * compare hashes and touch a name only on a hash match.  Directories of a
+ * few thousand short names already stay micro with the default
+ * zap_micro_max_size of 128 KiB (2047 chunks).  Longer names or more
+ * entries would need a new on-disk micro ZAP layout behind a feature flag.
+ */
 static zap_t *
 mzap_open(dmu_buf_t *db)
 {
@@ -1098,6 +1107,29 @@ zap_lookup_norm_by_dnode(dnode_t *dn, const char *name,
 	return (err);
 }
 
+int
+zap_lookup_uint64_by_dnode(dnode_t *dn, const uint64_t *key,
+    int key_numints, uint64_t integer_size, uint64_t num_integers, void *buf)
+{
+	zap_t *zap;
+
+	int err = zap_lockdir_by_dnode(dn, NULL, RW_READER, TRUE, FALSE,
+	    FTAG, &zap);
+	if (err != 0)
+		return (err);
+	zap_name_t *zn = zap_name_alloc_uint64(zap, key, key_numints);
+	if (zn == NULL) {
+		zap_unlockdir(zap, FTAG);
+		return (SET_ERROR(ENOTSUP));
+	}
+
+	err = fzap_lookup(zn, integer_size, num_integers, buf,
+	    NULL, 0, NULL);
+	zap_name_free(zn);
+	zap_unlockdir(zap, FTAG);
+	return (err);
+}
+
 int
 zap_prefetch_uint64(objset_t *os, uint64_t zapobj, const uint64_t *key,
     int key_numints)
@@ -1477,6 +1509,74 @@ zap_update_uint64_by_dnode(dnode_t *dn, const uint64_t *key, int key_numints,
 	return (err);
 }
 
+typedef struct zap_batch_ent {
+	zap_name_t	*zbe_zn;
+	uint64_t	zbe_idx;
+} zap_batch_ent_t;
+
+static int
+zap_batch_ent_compare(const void *a, const void *b)
+{
+	const zap_batch_ent_t *zbea = a;
+	const zap_batch_ent_t *zbeb = b;
+
+	return (TREE_CMP(zbea->zbe_zn->zn_hash, zbeb->zbe_zn->zn_hash));
+}
+
+/*
+ * Add or update nkeys entries of a uint64-keyed ZAP while locking it only
+ * once.  Key i is the key_numints words at keys[i * key_numints] and its
+ * value is the num_integers integers of integer_size bytes at the
+ * corresponding offset in vals.  The entries are applied in hash order, so
+ * that those in the same leaf block are updated back to back.
+ */
+int
+zap_update_uint64_batch_by_dnode(dnode_t *dn, const uint64_t *keys,
+    int key_numints, uint64_t nkeys, int integer_size,
+    uint64_t num_integers, const void *vals, dmu_tx_t *tx)
+{
+	size_t valsize = (size_t)integer_size * num_integers;
+	zap_batch_ent_t *zbe;
+	zap_t *zap;
+	uint64_t i;
+
+	if (nkeys == 0)
+		return (0);
+
+	int err =
+	    zap_lockdir_by_dnode(dn, tx, RW_WRITER, TRUE, TRUE, FTAG, &zap);
+	if (err != 0)
+		return (err);
+
+	zbe = vmem_alloc(nkeys * sizeof (zap_batch_ent_t), KM_SLEEP);
+	for (i = 0; i < nkeys; i++) {
+		zbe[i].zbe_zn = zap_name_alloc_uint64(zap,
+		    &keys[i * key_numints], key_numints);
+		zbe[i].zbe_idx = i;
+	}
+	qsort(zbe, nkeys, sizeof (zap_batch_ent_t), zap_batch_ent_compare);
+
+	for (i = 0; i < nkeys && err == 0; i++) {
+		zap_name_t *zn = zbe[i].zbe_zn;
+
+		/* A previous leaf split may have relocked the zap. */
+		zn->zn_zap = zap;
+		err = fzap_update(zn, integer_size, num_integers,
+		    (const char *)vals + zbe[i].zbe_idx * valsize, FTAG, tx);
+		zap = zn->zn_zap;	/* fzap_update() may change zap */
+		if (zap == NULL && err == 0)
+			err = SET_ERROR(EIO);
+	}
+
+	for (i = 0; i < nkeys; i++)
+		zap_name_free(zbe[i].zbe_zn);
+	vmem_free(zbe, nkeys * sizeof (zap_batch_ent_t));
+
+	if (zap != NULL)	/* may be NULL if fzap_upgrade() failed */
+		zap_unlockdir(zap, FTAG);
+	return (err);
+}
+
 int
 zap_remove(objset_t *os, uint64_t zapobj, const char *name, dmu_tx_t *tx)
 {
@@ -1781,6 +1881,7 @@ EXPORT_SYMBOL(zap_lookup);
 EXPORT_SYMBOL(zap_lookup_by_dnode);
 EXPORT_SYMBOL(zap_lookup_norm);
 EXPORT_SYMBOL(zap_lookup_uint64);
+EXPORT_SYMBOL(zap_lookup_uint64_by_dnode);
 EXPORT_SYMBOL(zap_contains);
 EXPORT_SYMBOL(zap_prefetch);
 EXPORT_SYMBOL(zap_prefetch_uint64);
@@ -1791,6 +1892,7 @@ EXPORT_SYMBOL(zap_add_uint64_by_dnode);
 EXPORT_SYMBOL(zap_update);
 EXPORT_SYMBOL(zap_update_uint64);
 EXPORT_SYMBOL(zap_update_uint64_by_dnode);
+EXPORT_SYMBOL(zap_update_uint64_batch_by_dnode);
 EXPORT_SYMBOL(zap_length);
 EXPORT_SYMBOL(zap_length_uint64);
 EXPORT_SYMBOL(zap_remove);
@@ -45,6 +45,85 @@ typedef struct zcp_list_info {
 	const zcp_arg_t kwargs[2];
 } zcp_list_info_t;
 
+/*
+ * With the batch kwarg, zfs.list.snapshots and zfs.list.children return an
+ * array of up to that many names per iteration instead of a single name,
+ * saving a Lua call, a dataset hold and the interpreter's instructions for
+ * every entry but the first.  The names are gathered into a buffer created
+ * along with the iterator while the dataset is held, and only pushed once
+ * it has been released, as running out of Lua memory longjmps out of the
+ * iterator.
+ */
+#define	ZCP_LIST_BATCH_MAX	1024
+#define	ZCP_LIST_BATCH_BUFSIZE	(64 * 1024)
+
+static int
+zcp_list_batch_arg(lua_State *state, int narg, uint64_t *batch)
+{
+	int64_t n;
+
+	*batch = 0;
+	if (lua_isnil(state, narg))
+		return (0);
+
+	n = lua_tonumber(state, narg);
+	if (n < 1 || n > ZCP_LIST_BATCH_MAX) {
+		return (zcp_argerror(state, narg,
+		    "batch must be between 1 and %d", ZCP_LIST_BATCH_MAX));
+	}
+	*batch = n;
+	return (0);
+}
+
+/*
+ * Push the iterator closure 'iter' for dataset 'dsobj', with the buffer for
+ * the names of a batch when one was asked for.
+ */
+static int
+zcp_list_push_iter(lua_State *state, lua_CFunction iter, uint64_t dsobj,
+    uint64_t batch)
+{
+	lua_pushnumber(state, dsobj);
+	lua_pushnumber(state, 0);
+	lua_pushnumber(state, batch);
+	if (batch != 0)
+		(void) lua_newuserdata(state, ZCP_LIST_BATCH_BUFSIZE);
+	else
+		lua_pushnil(state);
+	lua_pushcclosure(state, iter, 4);
+	return (1);
+}
+
+/*
+ * Return B_TRUE if there is room in the batch buffer for another name.
+ */
+static boolean_t
+zcp_list_batch_room(uint64_t batch, uint_t count, size_t used)
+{
+	return (count < batch &&
+	    ZCP_LIST_BATCH_BUFSIZE - used >= ZFS_MAX_DATASET_NAME_LEN);
+}
+
+/*
+ * Push the 'count' names gathered in 'buf' as an array of full dataset
+ * names, each 'prefix' followed by the name.
+ */
+static int
+zcp_list_batch_push(lua_State *state, const char *prefix, const char *buf,
+    uint_t count)
+{
+	char name[ZFS_MAX_DATASET_NAME_LEN];
+
+	lua_createtable(state, count, 0);
+	for (uint_t i = 0; i < count; i++) {
+		(void) snprintf(name, sizeof (name), "%s%s", prefix, buf);
+		(void) lua_pushstring(state, name);
+		lua_rawseti(state, -2, i + 1);
+		buf += strlen(buf) + 1;
+	}
+	return (1);
+}
+
 static int
 zcp_clones_iter(lua_State *state)
 {
@@ -157,10 +236,14 @@ zcp_snapshots_iter(lua_State *state)
 	char snapname[ZFS_MAX_DATASET_NAME_LEN];
 	uint64_t dsobj = lua_tonumber(state, lua_upvalueindex(1));
 	uint64_t cursor = lua_tonumber(state, lua_upvalueindex(2));
+	uint64_t batch = lua_tonumber(state, lua_upvalueindex(3));
+	char *buf = lua_touserdata(state, lua_upvalueindex(4));
 	dsl_pool_t *dp = zcp_run_info(state)->zri_pool;
 	dsl_dataset_t *ds;
 	objset_t *os;
 	char *p;
+	uint_t count = 0;
+	size_t used = 0;
 
 	err = dsl_dataset_hold_obj(dp, dsobj, FTAG, &ds);
 	if (err != 0) {
@@ -175,13 +258,20 @@ zcp_snapshots_iter(lua_State *state)
 
 	p = strchr(snapname, '\0');
 	VERIFY0(dmu_objset_from_ds(ds, &os));
-	err = dmu_snapshot_list_next(os,
-	    sizeof (snapname) - (p - snapname), p, NULL, &cursor, NULL);
+	do {
+		err = dmu_snapshot_list_next(os,
+		    sizeof (snapname) - (p - snapname), p, NULL, &cursor, NULL);
+		if (err != 0 || buf == NULL)
+			break;
+		used += strlcpy(buf + used, p,
+		    ZCP_LIST_BATCH_BUFSIZE - used) + 1;
+		count++;
+	} while (zcp_list_batch_room(batch, count, used));
 	dsl_dataset_rele(ds, FTAG);
 
-	if (err == ENOENT) {
+	if (err == ENOENT && count == 0) {
 		return (0);
-	} else if (err != 0) {
+	} else if (err != 0 && err != ENOENT) {
 		return (luaL_error(state,
 		    "unexpected error %d from dmu_snapshot_list_next()", err));
 	}
@@ -189,6 +279,11 @@ zcp_snapshots_iter(lua_State *state)
 	lua_pushnumber(state, cursor);
 	lua_replace(state, lua_upvalueindex(2));
 
+	if (buf != NULL) {
+		*p = '\0';
+		return (zcp_list_batch_push(state, snapname, buf, count));
+	}
+
 	(void) lua_pushstring(state, snapname);
 	return (1);
 }
@@ -203,6 +298,7 @@ static const zcp_list_info_t zcp_snapshots_list_info = {
 	    {NULL, 0}
 	},
 	.kwargs = {
+	    { .za_name = "batch", .za_lua_type = LUA_TNUMBER },
 	    {NULL, 0}
 	}
 };
@@ -213,7 +309,9 @@ zcp_snapshots_list(lua_State *state)
 	const char *fsname = lua_tostring(state, 1);
 	dsl_pool_t *dp = zcp_run_info(state)->zri_pool;
 	boolean_t issnap;
-	uint64_t dsobj;
+	uint64_t dsobj, batch;
+
+	(void) zcp_list_batch_arg(state, 2, &batch);
 
 	dsl_dataset_t *ds = zcp_dataset_hold(state, dp, fsname, FTAG);
 	if (ds == NULL)
@@ -227,10 +325,7 @@ zcp_snapshots_list(lua_State *state)
 		    "argument %s cannot be a snapshot", fsname));
 	}
 
-	lua_pushnumber(state, dsobj);
-	lua_pushnumber(state, 0);
-	lua_pushcclosure(state, &zcp_snapshots_iter, 2);
-	return (1);
+	return (zcp_list_push_iter(state, &zcp_snapshots_iter, dsobj, batch));
 }
 
 static int
@@ -240,11 +335,15 @@ zcp_children_iter(lua_State *state)
 	char childname[ZFS_MAX_DATASET_NAME_LEN];
 	uint64_t dsobj = lua_tonumber(state, lua_upvalueindex(1));
 	uint64_t cursor = lua_tonumber(state, lua_upvalueindex(2));
+	uint64_t batch = lua_tonumber(state, lua_upvalueindex(3));
+	char *buf = lua_touserdata(state, lua_upvalueindex(4));
 	zcp_run_info_t *ri = zcp_run_info(state);
 	dsl_pool_t *dp = ri->zri_pool;
 	dsl_dataset_t *ds;
 	objset_t *os;
 	char *p;
+	uint_t count = 0;
+	size_t used = 0;
 
 	err = dsl_dataset_hold_obj(dp, dsobj, FTAG, &ds);
 	if (err != 0) {
@@ -260,14 +359,22 @@ zcp_children_iter(lua_State *state)
 
 	VERIFY0(dmu_objset_from_ds(ds, &os));
 	do {
-		err = dmu_dir_list_next(os,
-		    sizeof (childname) - (p - childname), p, NULL, &cursor);
-	} while (err == 0 && zfs_dataset_name_hidden(childname));
+		do {
+			err = dmu_dir_list_next(os,
+			    sizeof (childname) - (p - childname), p, NULL,
+			    &cursor);
+		} while (err == 0 && zfs_dataset_name_hidden(childname));
+		if (err != 0 || buf == NULL)
+			break;
+		used += strlcpy(buf + used, p,
+		    ZCP_LIST_BATCH_BUFSIZE - used) + 1;
+		count++;
+	} while (zcp_list_batch_room(batch, count, used));
 	dsl_dataset_rele(ds, FTAG);
 
-	if (err == ENOENT) {
+	if (err == ENOENT && count == 0) {
 		return (0);
-	} else if (err != 0) {
+	} else if (err != 0 && err != ENOENT) {
 		return (luaL_error(state,
 		    "unexpected error %d from dmu_dir_list_next()",
 		    err));
@@ -276,6 +383,11 @@ zcp_children_iter(lua_State *state)
 	lua_pushnumber(state, cursor);
 	lua_replace(state, lua_upvalueindex(2));
 
+	if (buf != NULL) {
+		*p = '\0';
+		return (zcp_list_batch_push(state, childname, buf, count));
+	}
+
 	(void) lua_pushstring(state, childname);
 	return (1);
 }
@@ -290,6 +402,7 @@ static const zcp_list_info_t zcp_children_list_info = {
 	    {NULL, 0}
 	},
 	.kwargs = {
+	    { .za_name = "batch", .za_lua_type = LUA_TNUMBER },
 	    {NULL, 0}
 	}
 };
@@ -300,7 +413,9 @@ zcp_children_list(lua_State *state)
 	const char *fsname = lua_tostring(state, 1);
 	dsl_pool_t *dp = zcp_run_info(state)->zri_pool;
 	boolean_t issnap;
-	uint64_t dsobj;
+	uint64_t dsobj, batch;
+
+	(void) zcp_list_batch_arg(state, 2, &batch);
 
 	dsl_dataset_t *ds = zcp_dataset_hold(state, dp, fsname, FTAG);
 	if (ds == NULL)
@@ -315,10 +430,7 @@ zcp_children_list(lua_State *state)
 		    "argument %s cannot be a snapshot", fsname));
 	}
 
-	lua_pushnumber(state, dsobj);
-	lua_pushnumber(state, 0);
-	lua_pushcclosure(state, &zcp_children_iter, 2);
-	return (1);
+	return (zcp_list_push_iter(state, &zcp_children_iter, dsobj, batch));
 }
 
 static int
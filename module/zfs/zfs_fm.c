@@ -437,30 +437,52 @@ zfs_zevent_post_cb(nvlist_t *nvl, nvlist_t *detector)
  * We want to rate limit ZIO delay, deadman, and checksum events so as to not
  * flood zevent consumers when a disk is acting up.
  *
- * Returns 1 if we're ratelimiting, 0 if not.
+ * Returns 1 if we're ratelimiting, 0 if not.  When not, 'suppressed' is set
+ * to the number of events of this class the vdev had limited since the last
+ * one that went through, for the caller to add to the ereport; this way a
+ * single ereport stands in for the whole burst, rather than the consumer
+ * only seeing the first few of it.
  */
 static int
-zfs_is_ratelimiting_event(const char *subclass, vdev_t *vd)
+zfs_is_ratelimiting_event(const char *subclass, vdev_t *vd,
+    uint64_t *suppressed)
 {
-	int rc = 0;
-	/*
-	 * zfs_ratelimit() returns 1 if we're *not* ratelimiting and 0 if we
-	 * are.  Invert it to get our return value.
-	 */
+	zfs_ratelimit_t *rl = NULL;
+
+	*suppressed = 0;
 	if (strcmp(subclass, FM_EREPORT_ZFS_DELAY) == 0) {
-		rc = !zfs_ratelimit(&vd->vdev_delay_rl);
+		rl = &vd->vdev_delay_rl;
 	} else if (strcmp(subclass, FM_EREPORT_ZFS_DEADMAN) == 0) {
-		rc = !zfs_ratelimit(&vd->vdev_deadman_rl);
+		rl = &vd->vdev_deadman_rl;
 	} else if (strcmp(subclass, FM_EREPORT_ZFS_CHECKSUM) == 0) {
-		rc = !zfs_ratelimit(&vd->vdev_checksum_rl);
+		rl = &vd->vdev_checksum_rl;
 	}
 
-	if (rc)	{
+	if (rl == NULL)
+		return (0);
+
+	/*
+	 * zfs_ratelimit() returns 1 if we're *not* ratelimiting and 0 if we
+	 * are.
+	 */
+	if (!zfs_ratelimit(rl)) {
 		/* We're rate limiting */
 		fm_erpt_dropped_increment();
+		return (1);
 	}
 
-	return (rc);
+	*suppressed = zfs_ratelimit_take(rl);
+	return (0);
+}
+
+static void
+zfs_ereport_add_suppressed(nvlist_t *ereport, uint64_t suppressed)
+{
+	if (ereport != NULL && suppressed != 0) {
+		fm_payload_set(ereport,
+		    FM_EREPORT_PAYLOAD_ZFS_VDEV_SUPPRESSED,
+		    DATA_TYPE_UINT64, suppressed, NULL);
+	}
 }
 
 /*
@@ -1163,6 +1185,7 @@ zfs_ereport_post(const char *subclass, spa_t *spa, vdev_t *vd,
 #ifdef _KERNEL
 	nvlist_t *ereport = NULL;
 	nvlist_t *detector = NULL;
+	uint64_t suppressed;
 
 	if (!zfs_ereport_is_valid(subclass, spa, vd, zio))
 		return (EINVAL);
@@ -1170,7 +1193,7 @@ zfs_ereport_post(const char *subclass, spa_t *spa, vdev_t *vd,
 	if (zfs_ereport_is_duplicate(subclass, spa, vd, zb, zio, 0, 0))
 		return (SET_ERROR(EALREADY));
 
-	if (zfs_is_ratelimiting_event(subclass, vd))
+	if (zfs_is_ratelimiting_event(subclass, vd, &suppressed))
 		return (SET_ERROR(EBUSY));
 
 	if (!zfs_ereport_start(&ereport, &detector, subclass, spa, vd,
@@ -1180,6 +1203,8 @@ zfs_ereport_post(const char *subclass, spa_t *spa, vdev_t *vd,
 	if (ereport == NULL)
 		return (SET_ERROR(EINVAL));
 
+	zfs_ereport_add_suppressed(ereport, suppressed);
+
 	/* Cleanup is handled by the callback function */
 	rc = zfs_zevent_post(ereport, detector, zfs_zevent_post_cb);
 #else
@@ -1189,6 +1214,25 @@ zfs_ereport_post(const char *subclass, spa_t *spa, vdev_t *vd,
 	return (rc);
 }
 
+/*
+ * Checksum errors beyond zfs_checksum_detail_events_per_second are still
+ * reported, but without comparing the bad data to the good, which is by
+ * far the most expensive part of building the ereport.  There's then no
+ * point in keeping a copy of the bad data until the I/O completes.
+ */
+static void
+zfs_ecksum_summary_finish(zio_cksum_report_t *zcr, const abd_t *good_data)
+{
+	(void) good_data;
+	zfs_ereport_finish_checksum(zcr, NULL, NULL, B_FALSE);
+}
+
+static void
+zfs_ecksum_summary_free(void *cbdata, size_t size)
+{
+	(void) cbdata, (void) size;
+}
+
 /*
  * Prepare a checksum ereport
  *
@@ -1203,8 +1247,10 @@ zfs_ereport_start_checksum(spa_t *spa, vdev_t *vd, const zbookmark_phys_t *zb,
     struct zio *zio, uint64_t offset, uint64_t length, zio_bad_cksum_t *info)
 {
 	zio_cksum_report_t *report;
-
+	boolean_t detailed = B_TRUE;
 #ifdef _KERNEL
+	uint64_t suppressed;
+
 	if (!zfs_ereport_is_valid(FM_EREPORT_ZFS_CHECKSUM, spa, vd, zio))
 		return (SET_ERROR(EINVAL));
 
@@ -1212,15 +1258,23 @@ zfs_ereport_start_checksum(spa_t *spa, vdev_t *vd, const zbookmark_phys_t *zb,
 	    offset, length))
 		return (SET_ERROR(EALREADY));
 
-	if (zfs_is_ratelimiting_event(FM_EREPORT_ZFS_CHECKSUM, vd))
+	if (zfs_is_ratelimiting_event(FM_EREPORT_ZFS_CHECKSUM, vd,
+	    &suppressed))
 		return (SET_ERROR(EBUSY));
+
+	detailed = zfs_ratelimit(&vd->vdev_checksum_detail_rl);
 #else
 	(void) zb, (void) offset;
 #endif
 
 	report = kmem_zalloc(sizeof (*report), KM_SLEEP);
 
-	zio_vsd_default_cksum_report(zio, report);
+	if (detailed) {
+		zio_vsd_default_cksum_report(zio, report);
+	} else {
+		report->zcr_finish = zfs_ecksum_summary_finish;
+		report->zcr_free = zfs_ecksum_summary_free;
+	}
 
 	/* copy the checksum failure information if it was provided */
 	if (info != NULL) {
@@ -1241,6 +1295,7 @@ zfs_ereport_start_checksum(spa_t *spa, vdev_t *vd, const zbookmark_phys_t *zb,
 		zfs_ereport_free_checksum(report);
 		return (0);
 	}
+	zfs_ereport_add_suppressed(report->zcr_ereport, suppressed);
 #endif
 
 	mutex_enter(&spa->spa_errlist_lock);
@@ -1312,6 +1367,8 @@ zfs_ereport_post_checksum(spa_t *spa, vdev_t *vd, const zbookmark_phys_t *zb,
 	nvlist_t *ereport = NULL;
 	nvlist_t *detector = NULL;
 	zfs_ecksum_info_t *info;
+	uint64_t suppressed;
+	boolean_t detailed;
 
 	if (!zfs_ereport_is_valid(FM_EREPORT_ZFS_CHECKSUM, spa, vd, zio))
 		return (SET_ERROR(EINVAL));
@@ -1320,7 +1377,8 @@ zfs_ereport_post_checksum(spa_t *spa, vdev_t *vd, const zbookmark_phys_t *zb,
 	    offset, length))
 		return (SET_ERROR(EALREADY));
 
-	if (zfs_is_ratelimiting_event(FM_EREPORT_ZFS_CHECKSUM, vd))
+	if (zfs_is_ratelimiting_event(FM_EREPORT_ZFS_CHECKSUM, vd,
+	    &suppressed))
 		return (SET_ERROR(EBUSY));
 
 	if (!zfs_ereport_start(&ereport, &detector, FM_EREPORT_ZFS_CHECKSUM,
@@ -1328,8 +1386,11 @@ zfs_ereport_post_checksum(spa_t *spa, vdev_t *vd, const zbookmark_phys_t *zb,
 		return (SET_ERROR(EINVAL));
 	}
 
-	info = annotate_ecksum(ereport, zbc, good_data, bad_data, length,
-	    B_FALSE);
+	zfs_ereport_add_suppressed(ereport, suppressed);
+
+	detailed = zfs_ratelimit(&vd->vdev_checksum_detail_rl);
+	info = annotate_ecksum(ereport, zbc, detailed ? good_data : NULL,
+	    detailed ? bad_data : NULL, length, B_FALSE);
 
 	if (info != NULL) {
 		rc = zfs_zevent_post(ereport, detector, zfs_zevent_post_cb);
@@ -206,6 +206,8 @@
 #include <sys/dsl_bookmark.h>
 #include <sys/dsl_userhold.h>
 #include <sys/zfeature.h>
+#include <sys/ddt.h>
+#include <sys/brt.h>
 #include <sys/zcp.h>
 #include <sys/zio_checksum.h>
 #include <sys/vdev_removal.h>
@@ -1678,6 +1680,9 @@ zfs_ioc_pool_scan(zfs_cmd_t *zc)
 		error = spa_scrub_pause_resume(spa, POOL_SCRUB_PAUSE);
 	else if (zc->zc_cookie == POOL_SCAN_NONE)
 		error = spa_scan_stop(spa);
+	else if (zc->zc_flags == POOL_SCRUB_FROM_LAST_TXG)
+		error = spa_scan_range(spa, zc->zc_cookie,
+		    spa_get_last_scrubbed_txg(spa), 0);
 	else
 		error = spa_scan(spa, zc->zc_cookie);
 
@@ -1719,6 +1724,9 @@ zfs_ioc_pool_scrub(const char *poolname, nvlist_t *innvl, nvlist_t *outnvl)
 		error = spa_scrub_pause_resume(spa, POOL_SCRUB_PAUSE);
 	} else if (scan_type == POOL_SCAN_NONE) {
 		error = spa_scan_stop(spa);
+	} else if (scan_cmd == POOL_SCRUB_FROM_LAST_TXG) {
+		error = spa_scan_range(spa, scan_type,
+		    spa_get_last_scrubbed_txg(spa), 0);
 	} else {
 		error = spa_scan(spa, scan_type);
 	}
@@ -1727,6 +1735,189 @@ zfs_ioc_pool_scrub(const char *poolname, nvlist_t *innvl, nvlist_t *outnvl)
 	return (error);
 }
 
+/*
+ * innvl: {
+ *     "ddt_prune_days" -> prune unique entries older than this many days
+ * }
+ *
+ * outnvl: empty
+ */
+static const zfs_ioc_key_t zfs_keys_ddt_prune[] = {
+	{DDT_PRUNE_DAYS,	DATA_TYPE_UINT64,	0},
+};
+
+static int
+zfs_ioc_ddt_prune(const char *poolname, nvlist_t *innvl, nvlist_t *outnvl)
+{
+	(void) outnvl;
+	spa_t *spa;
+	uint64_t days;
+	int error;
+
+	days = fnvlist_lookup_uint64(innvl, DDT_PRUNE_DAYS);
+
+	if ((error = spa_open(poolname, &spa, FTAG)) != 0)
+		return (error);
+
+	if (!spa_feature_is_enabled(spa, SPA_FEATURE_FAST_DEDUP)) {
+		spa_close(spa, FTAG);
+		return (SET_ERROR(ENOTSUP));
+	}
+
+	error = ddt_prune_unique_entries(spa, days);
+
+	spa_close(spa, FTAG);
+	return (error);
+}
+
+/*
+ * innvl: {
+ *     "sample_count" -> (optional) number of entries to read from each of
+ *                       the DDT and the BRT, default DDT_SAMPLE_DEFAULT
+ * }
+ *
+ * outnvl: {
+ *     "ddt" -> { "entries", "sampled", "histogram", "error" }
+ *     "brt" -> { "entries", "sampled", "hist_entries", "hist_refs", "error" }
+ * }
+ *
+ * "brt" is only present when block cloning is active on the pool.  See
+ * ddt_get_sample_stats() and brt_get_sample_stats().
+ */
+static const zfs_ioc_key_t zfs_keys_dedup_sample[] = {
+	{DEDUP_SAMPLE_COUNT,	DATA_TYPE_UINT64,	ZK_OPTIONAL},
+};
+
+static int
+zfs_ioc_dedup_sample(const char *poolname, nvlist_t *innvl, nvlist_t *outnvl)
+{
+	uint64_t samples = DDT_SAMPLE_DEFAULT;
+	nvlist_t *nvl;
+	spa_t *spa;
+	int error;
+
+	(void) nvlist_lookup_uint64(innvl, DEDUP_SAMPLE_COUNT, &samples);
+	if (samples == 0 || samples > DDT_SAMPLE_MAX)
+		return (SET_ERROR(EINVAL));
+
+	if ((error = spa_open(poolname, &spa, FTAG)) != 0)
+		return (error);
+
+	nvl = fnvlist_alloc();
+	error = ddt_get_sample_stats(spa, samples, nvl);
+	if (error == 0)
+		fnvlist_add_nvlist(outnvl, DEDUP_SAMPLE_DDT, nvl);
+	fnvlist_free(nvl);
+
+	if (error == 0 &&
+	    spa_feature_is_active(spa, SPA_FEATURE_BLOCK_CLONING)) {
+		nvl = fnvlist_alloc();
+		error = brt_get_sample_stats(spa, samples, nvl);
+		if (error == 0)
+			fnvlist_add_nvlist(outnvl, DEDUP_SAMPLE_BRT, nvl);
+		fnvlist_free(nvl);
+	}
+
+	spa_close(spa, FTAG);
+	return (error);
+}
+
+typedef struct zfs_kstats_arg {
+	const char	*zka_class;
+	nvlist_t	*zka_kstats;
+} zfs_kstats_arg_t;
+
+static int
+zfs_kstat_to_nvlist(kstat_t *ksp, const char *name, void *arg)
+{
+	zfs_kstats_arg_t *zka = arg;
+	kstat_named_t *knp;
+	nvlist_t *nvl;
+
+	if (zka->zka_class != NULL && strcmp(zka->zka_class, ksp->ks_class))
+		return (0);
+
+	nvl = fnvlist_alloc();
+	mutex_enter(ksp->ks_lock);
+	(void) ksp->ks_update(ksp, KSTAT_READ);
+	ksp->ks_snaptime = gethrtime();
+	knp = ksp->ks_data;
+	for (uint_t i = 0; knp != NULL && i < ksp->ks_ndata; i++, knp++) {
+		switch (knp->data_type) {
+		case KSTAT_DATA_INT32:
+			fnvlist_add_int32(nvl, knp->name, knp->value.i32);
+			break;
+		case KSTAT_DATA_UINT32:
+			fnvlist_add_uint32(nvl, knp->name, knp->value.ui32);
+			break;
+		case KSTAT_DATA_INT64:
+			fnvlist_add_int64(nvl, knp->name, knp->value.i64);
+			break;
+		case KSTAT_DATA_UINT64:
+			fnvlist_add_uint64(nvl, knp->name, knp->value.ui64);
+			break;
+		case KSTAT_DATA_LONG:
+			fnvlist_add_int64(nvl, knp->name, knp->value.l);
+			break;
+		case KSTAT_DATA_ULONG:
+			fnvlist_add_uint64(nvl, knp->name, knp->value.ul);
+			break;
+		case KSTAT_DATA_STRING:
+			if (KSTAT_NAMED_STR_PTR(knp) != NULL) {
+				fnvlist_add_string(nvl, knp->name,
+				    KSTAT_NAMED_STR_PTR(knp));
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	mutex_exit(ksp->ks_lock);
+
+	fnvlist_add_nvlist(zka->zka_kstats, name, nvl);
+	fnvlist_free(nvl);
+	return (0);
+}
+
+/*
+ * Snapshot all named kstats of the kstat module given as the name, e.g.
+ * "zfs" for the global ones or "zfs/<pool>" for those of a pool, in one
+ * call.  Monitoring tools reading hundreds of objset-* kstats avoid the
+ * open, read and text formatting of each of them.
+ *
+ * innvl: {
+ *     "class" -> (optional) only the kstats of this class, e.g. "dataset"
+ * }
+ *
+ * outnvl: {
+ *     "version" -> ZFS_KSTATS_VERSION
+ *     "kstats" -> { kstat name -> { entry name -> value } }
+ * }
+ */
+static const zfs_ioc_key_t zfs_keys_kstats[] = {
+	{KSTATS_CLASS,		DATA_TYPE_STRING,	ZK_OPTIONAL},
+};
+
+static int
+zfs_ioc_kstats(const char *module, nvlist_t *innvl, nvlist_t *outnvl)
+{
+	zfs_kstats_arg_t zka;
+	int error;
+
+	zka.zka_class = NULL;
+	(void) nvlist_lookup_string(innvl, KSTATS_CLASS, &zka.zka_class);
+	zka.zka_kstats = fnvlist_alloc();
+
+	error = kstat_walk_named(module, zfs_kstat_to_nvlist, &zka);
+	if (error == 0) {
+		fnvlist_add_uint64(outnvl, KSTATS_VERSION, ZFS_KSTATS_VERSION);
+		fnvlist_add_nvlist(outnvl, KSTATS_KSTATS, zka.zka_kstats);
+	}
+	fnvlist_free(zka.zka_kstats);
+
+	return (error);
+}
+
 static int
 zfs_ioc_pool_freeze(zfs_cmd_t *zc)
 {
@@ -2072,35 +2263,57 @@ zfs_ioc_vdev_setfru(zfs_cmd_t *zc)
 	return (error);
 }
 
+/*
+ * Fill in the stats of an objset and, if nvp is not NULL, allocate and
+ * return its property nvlist.
+ */
 static int
-zfs_ioc_objset_stats_impl(zfs_cmd_t *zc, objset_t *os)
+zfs_objset_stats_get(objset_t *os, dmu_objset_stats_t *stat, nvlist_t **nvp)
 {
-	int error = 0;
+	int error;
 	nvlist_t *nv;
 
-	dmu_objset_fast_stat(os, &zc->zc_objset_stats);
+	dmu_objset_fast_stat(os, stat);
 
-	if (!zc->zc_simple && zc->zc_nvlist_dst != 0 &&
-	    (error = dsl_prop_get_all(os, &nv)) == 0) {
-		dmu_objset_stats(os, nv);
-		/*
-		 * NB: zvol_get_stats() will read the objset contents,
-		 * which we aren't supposed to do with a
-		 * DS_MODE_USER hold, because it could be
-		 * inconsistent.  So this is a bit of a workaround...
-		 * XXX reading without owning
-		 */
-		if (!zc->zc_objset_stats.dds_inconsistent &&
-		    dmu_objset_type(os) == DMU_OST_ZVOL) {
-			error = zvol_get_stats(os, nv);
-			if (error == EIO) {
-				nvlist_free(nv);
-				return (error);
-			}
-			VERIFY0(error);
+	if (nvp == NULL)
+		return (0);
+
+	if ((error = dsl_prop_get_all(os, &nv)) != 0)
+		return (error);
+
+	dmu_objset_stats(os, nv);
+	/*
+	 * NB: zvol_get_stats() will read the objset contents,
+	 * which we aren't supposed to do with a
+	 * DS_MODE_USER hold, because it could be
+	 * inconsistent.  So this is a bit of a workaround...
+	 * XXX reading without owning
+	 */
+	if (!stat->dds_inconsistent &&
+	    dmu_objset_type(os) == DMU_OST_ZVOL) {
+		error = zvol_get_stats(os, nv);
+		if (error == EIO) {
+			nvlist_free(nv);
+			return (error);
 		}
-		if (error == 0)
-			error = put_nvlist(zc, nv);
+		VERIFY0(error);
+	}
+
+	*nvp = nv;
+	return (0);
+}
+
+static int
+zfs_ioc_objset_stats_impl(zfs_cmd_t *zc, objset_t *os)
+{
+	int error;
+	nvlist_t *nv = NULL;
+
+	error = zfs_objset_stats_get(os, &zc->zc_objset_stats,
+	    (!zc->zc_simple && zc->zc_nvlist_dst != 0) ? &nv : NULL);
+
+	if (error == 0 && nv != NULL) {
+		error = put_nvlist(zc, nv);
 		nvlist_free(nv);
 	}
 
@@ -2391,6 +2604,266 @@ zfs_ioc_snapshot_list_next(zfs_cmd_t *zc)
 	return (error);
 }
 
+/*
+ * Add one dataset to the output of ZFS_IOC_DATASET_LIST_BATCH, consuming
+ * its property nvlist.  If the caller named the properties it wants, drop
+ * all of the others before they are copied out.
+ */
+static void
+zfs_list_batch_add(nvlist_t *datasets, const char *name,
+    dmu_objset_stats_t *stat, nvlist_t *props, nvlist_t *wanted)
+{
+	nvlist_t *entry = fnvlist_alloc();
+
+	fnvlist_add_uint8_array(entry, DATASET_LIST_STATS, (uint8_t *)stat,
+	    sizeof (*stat));
+
+	if (props != NULL) {
+		if (wanted != NULL) {
+			nvpair_t *pair, *next;
+
+			for (pair = nvlist_next_nvpair(props, NULL);
+			    pair != NULL; pair = next) {
+				next = nvlist_next_nvpair(props, pair);
+				if (!nvlist_exists(wanted, nvpair_name(pair)))
+					fnvlist_remove_nvpair(props, pair);
+			}
+		}
+		fnvlist_add_nvlist(entry, DATASET_LIST_PROPS, props);
+		nvlist_free(props);
+	}
+
+	fnvlist_add_nvlist(datasets, name, entry);
+	fnvlist_free(entry);
+}
+
+/*
+ * Batched equivalent of ZFS_IOC_DATASET_LIST_NEXT: returns up to "count"
+ * child filesystems of fsname, starting at *cursor.  Sets *cursor to 0
+ * once the children are exhausted.
+ */
+static int
+zfs_list_batch_filesystems(const char *fsname, uint64_t *cursor,
+    uint64_t count, boolean_t simple, nvlist_t *wanted, nvlist_t *datasets)
+{
+	char *name = kmem_alloc(ZFS_MAX_DATASET_NAME_LEN, KM_SLEEP);
+	size_t plen = strlen(fsname) + 1;
+	uint64_t n = 0;
+	int error = 0;
+
+	if (snprintf(name, ZFS_MAX_DATASET_NAME_LEN, "%s/", fsname) >=
+	    ZFS_MAX_DATASET_NAME_LEN) {
+		/* A name of maximum length cannot have any children. */
+		*cursor = 0;
+		goto out;
+	}
+
+	while (n < count) {
+		dmu_objset_stats_t stat;
+		nvlist_t *props = NULL;
+		objset_t *os;
+
+		if (issig()) {
+			error = SET_ERROR(EINTR);
+			break;
+		}
+
+		if ((error = dmu_objset_hold(fsname, FTAG, &os)) != 0)
+			break;
+		do {
+			error = dmu_dir_list_next(os,
+			    ZFS_MAX_DATASET_NAME_LEN - plen, name + plen,
+			    NULL, cursor);
+		} while (error == 0 && zfs_dataset_name_hidden(name));
+		dmu_objset_rele(os, FTAG);
+
+		if (error == ENOENT) {
+			*cursor = 0;
+			error = 0;
+			break;
+		} else if (error != 0) {
+			break;
+		}
+
+		/* Internal datasets have no stats; see dataset_list_next. */
+		if (strchr(name, '$') != NULL)
+			continue;
+
+		if ((error = dmu_objset_hold(name, FTAG, &os)) != 0) {
+			/* We lost a race with destroy, get the next one. */
+			if (error == ENOENT) {
+				error = 0;
+				continue;
+			}
+			break;
+		}
+		error = zfs_objset_stats_get(os, &stat, simple ? NULL : &props);
+		dmu_objset_rele(os, FTAG);
+		if (error != 0)
+			break;
+
+		zfs_list_batch_add(datasets, name, &stat, props, wanted);
+		n++;
+	}
+out:
+	kmem_free(name, ZFS_MAX_DATASET_NAME_LEN);
+	return (error);
+}
+
+/*
+ * Batched equivalent of ZFS_IOC_SNAPSHOT_LIST_NEXT.
+ */
+static int
+zfs_list_batch_snapshots(const char *fsname, uint64_t *cursor,
+    uint64_t count, boolean_t simple, nvlist_t *wanted, uint64_t min_txg,
+    uint64_t max_txg, nvlist_t *datasets)
+{
+	char *name = kmem_alloc(ZFS_MAX_DATASET_NAME_LEN, KM_SLEEP);
+	size_t plen = strlen(fsname) + 1;
+	uint64_t n = 0;
+	objset_t *os;
+	int error;
+
+	if ((error = dmu_objset_hold(fsname, FTAG, &os)) != 0) {
+		kmem_free(name, ZFS_MAX_DATASET_NAME_LEN);
+		return (error);
+	}
+
+	/*
+	 * A dataset name of maximum length cannot have any snapshots.
+	 */
+	if (snprintf(name, ZFS_MAX_DATASET_NAME_LEN, "%s@", fsname) >=
+	    ZFS_MAX_DATASET_NAME_LEN) {
+		*cursor = 0;
+		goto out;
+	}
+
+	while (n < count) {
+		dmu_objset_stats_t stat;
+		nvlist_t *props = NULL;
+		dsl_dataset_t *ds;
+		objset_t *ossnap;
+		uint64_t obj;
+
+		if (issig()) {
+			error = SET_ERROR(EINTR);
+			break;
+		}
+
+		error = dmu_snapshot_list_next(os,
+		    ZFS_MAX_DATASET_NAME_LEN - plen, name + plen, &obj,
+		    cursor, NULL);
+		if (error == ENOENT) {
+			*cursor = 0;
+			error = 0;
+			break;
+		} else if (error != 0) {
+			break;
+		}
+
+		error = dsl_dataset_hold_obj(dmu_objset_pool(os), obj,
+		    FTAG, &ds);
+		if (error != 0)
+			break;
+
+		if ((min_txg != 0 && dsl_get_creationtxg(ds) < min_txg) ||
+		    (max_txg != 0 && dsl_get_creationtxg(ds) > max_txg)) {
+			dsl_dataset_rele(ds, FTAG);
+			continue;
+		}
+
+		if (simple) {
+			dsl_dataset_fast_stat(ds, &stat);
+		} else if ((error = dmu_objset_from_ds(ds, &ossnap)) == 0) {
+			error = zfs_objset_stats_get(ossnap, &stat, &props);
+		}
+		dsl_dataset_rele(ds, FTAG);
+		if (error != 0)
+			break;
+
+		zfs_list_batch_add(datasets, name, &stat, props, wanted);
+		n++;
+	}
+out:
+	dmu_objset_rele(os, FTAG);
+	kmem_free(name, ZFS_MAX_DATASET_NAME_LEN);
+	return (error);
+}
+
+/*
+ * innvl: {
+ *     (optional) "cursor" -> position to resume from, 0 to start (uint64)
+ *     (optional) "count" -> maximum number of datasets to return (uint64)
+ *     (optional) "snapshots" -> list snapshots instead of children
+ *     (optional) "simple" -> return only stats, not properties
+ *     (optional) "props" -> { propname -> (value ignored), ... }
+ *     (optional) "snap_iter_min_txg" -> oldest snapshot to list (uint64)
+ *     (optional) "snap_iter_max_txg" -> newest snapshot to list (uint64)
+ * }
+ *
+ * outnvl: {
+ *     "datasets" -> {
+ *         name -> {
+ *             "stats" -> dmu_objset_stats_t (uint8 array)
+ *             (optional) "props" -> { propname -> value, ... }
+ *         }, ...
+ *     }
+ *     (optional) "cursor" -> pass back in to get the next batch (uint64)
+ * }
+ *
+ * The datasets are returned in the same order as the single-step list
+ * ioctls would return them, and "cursor" is absent once there are no more.
+ */
+static const zfs_ioc_key_t zfs_keys_dataset_list_batch[] = {
+	{DATASET_LIST_CURSOR,		DATA_TYPE_UINT64,	ZK_OPTIONAL},
+	{DATASET_LIST_COUNT,		DATA_TYPE_UINT64,	ZK_OPTIONAL},
+	{DATASET_LIST_SNAPSHOTS,	DATA_TYPE_BOOLEAN,	ZK_OPTIONAL},
+	{DATASET_LIST_SIMPLE,		DATA_TYPE_BOOLEAN,	ZK_OPTIONAL},
+	{DATASET_LIST_PROPS,		DATA_TYPE_NVLIST,	ZK_OPTIONAL},
+	{SNAP_ITER_MIN_TXG,		DATA_TYPE_UINT64,	ZK_OPTIONAL},
+	{SNAP_ITER_MAX_TXG,		DATA_TYPE_UINT64,	ZK_OPTIONAL},
+};
+
+static int
+zfs_ioc_dataset_list_batch(const char *fsname, nvlist_t *innvl,
+    nvlist_t *outnvl)
+{
+	uint64_t cursor = 0, count = DATASET_LIST_DEFAULT_COUNT;
+	uint64_t min_txg = 0, max_txg = 0;
+	nvlist_t *wanted = NULL;
+	nvlist_t *datasets;
+	boolean_t simple;
+	int error;
+
+	(void) nvlist_lookup_uint64(innvl, DATASET_LIST_CURSOR, &cursor);
+	(void) nvlist_lookup_uint64(innvl, DATASET_LIST_COUNT, &count);
+	(void) nvlist_lookup_nvlist(innvl, DATASET_LIST_PROPS, &wanted);
+	(void) nvlist_lookup_uint64(innvl, SNAP_ITER_MIN_TXG, &min_txg);
+	(void) nvlist_lookup_uint64(innvl, SNAP_ITER_MAX_TXG, &max_txg);
+	simple = nvlist_exists(innvl, DATASET_LIST_SIMPLE);
+
+	if (count == 0 || count > DATASET_LIST_MAX_COUNT)
+		count = DATASET_LIST_MAX_COUNT;
+
+	datasets = fnvlist_alloc();
+	if (nvlist_exists(innvl, DATASET_LIST_SNAPSHOTS)) {
+		error = zfs_list_batch_snapshots(fsname, &cursor, count,
+		    simple, wanted, min_txg, max_txg, datasets);
+	} else {
+		error = zfs_list_batch_filesystems(fsname, &cursor, count,
+		    simple, wanted, datasets);
+	}
+
+	if (error == 0) {
+		fnvlist_add_nvlist(outnvl, DATASET_LIST_DATASETS, datasets);
+		if (cursor != 0)
+			fnvlist_add_uint64(outnvl, DATASET_LIST_CURSOR, cursor);
+	}
+	fnvlist_free(datasets);
+
+	return (error);
+}
+
 static int
 zfs_prop_set_userquota(const char *dsname, nvpair_t *pair)
 {
@@ -6302,6 +6775,64 @@ zfs_ioc_diff(zfs_cmd_t *zc)
 	return (error);
 }
 
+/*
+ * innvl: {
+ *     "fd" -> file descriptor to write dmu_changed_range_t records to (int32)
+ *     "object" -> object number of the file or zvol (uint64)
+ *     (optional) "fromsnap" -> earlier snapshot of the same dataset (string)
+ * }
+ *
+ * outnvl: empty
+ */
+static const zfs_ioc_key_t zfs_keys_changed_blocks[] = {
+	{CHANGED_BLOCKS_FD,		DATA_TYPE_INT32,	0},
+	{CHANGED_BLOCKS_OBJECT,		DATA_TYPE_UINT64,	0},
+	{CHANGED_BLOCKS_FROMSNAP,	DATA_TYPE_STRING,	ZK_OPTIONAL},
+};
+
+static int
+zfs_ioc_changed_blocks(const char *snapname, nvlist_t *innvl,
+    nvlist_t *outnvl)
+{
+	(void) outnvl;
+	zfs_file_t *fp;
+	const char *fromname = NULL;
+	offset_t off;
+	uint64_t object;
+	int fd;
+	int error;
+
+	fd = fnvlist_lookup_int32(innvl, CHANGED_BLOCKS_FD);
+	object = fnvlist_lookup_uint64(innvl, CHANGED_BLOCKS_OBJECT);
+	(void) nvlist_lookup_string(innvl, CHANGED_BLOCKS_FROMSNAP, &fromname);
+
+	if ((fp = zfs_file_get(fd)) == NULL)
+		return (SET_ERROR(EBADF));
+
+	off = zfs_file_off(fp);
+	error = dmu_changed_ranges(snapname, fromname, object, fp, &off);
+
+	zfs_file_put(fp);
+
+	return (error);
+}
+
+/*
+ * innvl: empty
+ * outnvl: empty
+ */
+static const zfs_ioc_key_t zfs_keys_mount_prefetch[] = {
+	/* no nvl keys */
+};
+
+static int
+zfs_ioc_mount_prefetch(const char *fsname, nvlist_t *innvl, nvlist_t *outnvl)
+{
+	(void) innvl, (void) outnvl;
+
+	return (dmu_objset_prefetch_descendants(fsname));
+}
+
 static int
 zfs_ioc_smb_acl(zfs_cmd_t *zc)
 {
@@ -6405,13 +6936,74 @@ zfs_ioc_release(const char *pool, nvlist_t *holds, nvlist_t *errlist)
 	return (dsl_dataset_user_release(holds, errlist));
 }
 
+/*
+ * Room left in the output buffer for the batch nvlist itself, and for
+ * each event on top of its size when packed on its own.
+ */
+#define	ZEVENT_BATCH_HDR_SIZE	1024
+#define	ZEVENT_BATCH_EV_SIZE	64
+
+/*
+ * Copy out as many of the next zevents as fit in zc_nvlist_dst, up to
+ * zc_obj of them.  The stream only advances past events which are added
+ * to the batch, so the buffer has to be sized with enough slack up front;
+ * an event which doesn't fit ends the batch and is returned first by the
+ * next call.  Fails with ENOENT if there are no events, or with ENOMEM
+ * and zc_nvlist_dst_size set to the size needed if the first one doesn't
+ * fit.
+ */
+static int
+zfs_zevent_next_batch(zfs_cmd_t *zc, zfs_zevent_t *ze)
+{
+	uint64_t max = MIN(MAX(zc->zc_obj, 1), ZEVENT_BATCH_MAX);
+	uint64_t used = ZEVENT_BATCH_HDR_SIZE;
+	uint64_t dropped = 0, size = 0;
+	nvlist_t **events;
+	uint_t n = 0;
+	int error = 0;
+
+	events = kmem_alloc(max * sizeof (nvlist_t *), KM_SLEEP);
+	while (n < max) {
+		uint64_t d = 0;
+
+		used += ZEVENT_BATCH_EV_SIZE;
+		size = zc->zc_nvlist_dst_size > used ?
+		    zc->zc_nvlist_dst_size - used : 0;
+		error = zfs_zevent_next(ze, &events[n], &size, &d);
+		if (error != 0)
+			break;
+		used += fnvlist_size(events[n]);
+		dropped += d;
+		n++;
+	}
+
+	if (n == 0) {
+		if (error == ENOMEM)
+			zc->zc_nvlist_dst_size = used + size;
+	} else {
+		nvlist_t *batch = fnvlist_alloc();
+
+		fnvlist_add_nvlist_array(batch, ZEVENT_BATCH_EVENTS,
+		    (const nvlist_t * const *)events, n);
+		zc->zc_cookie = dropped;
+		error = put_nvlist(zc, batch);
+		nvlist_free(batch);
+		for (uint_t i = 0; i < n; i++)
+			nvlist_free(events[i]);
+	}
+	kmem_free(events, max * sizeof (nvlist_t *));
+
+	return (error);
+}
+
 /*
  * inputs:
- * zc_guid		flags (ZEVENT_NONBLOCK)
+ * zc_guid		flags (ZEVENT_NONBLOCK, ZEVENT_BATCH)
+ * zc_obj		maximum number of events to return with ZEVENT_BATCH
  * zc_cleanup_fd	zevent file descriptor
  *
  * outputs:
- * zc_nvlist_dst	next nvlist event
+ * zc_nvlist_dst	next nvlist event, or a batch of them
  * zc_cookie		dropped events since last get
  */
 static int
@@ -6428,8 +7020,12 @@ zfs_ioc_events_next(zfs_cmd_t *zc)
 		return (SET_ERROR(EBADF));
 
 	do {
-		error = zfs_zevent_next(ze, &event,
-		    &zc->zc_nvlist_dst_size, &dropped);
+		if (zc->zc_guid & ZEVENT_BATCH) {
+			error = zfs_zevent_next_batch(zc, ze);
+		} else {
+			error = zfs_zevent_next(ze, &event,
+			    &zc->zc_nvlist_dst_size, &dropped);
+		}
 		if (event != NULL) {
 			zc->zc_cookie = dropped;
 			error = put_nvlist(zc, event);
@@ -7328,6 +7924,37 @@ zfs_ioctl_init(void)
 	    POOL_CHECK_NONE, B_TRUE, B_TRUE,
 	    zfs_keys_pool_scrub, ARRAY_SIZE(zfs_keys_pool_scrub));
 
+	zfs_ioctl_register("ddt_prune", ZFS_IOC_DDT_PRUNE,
+	    zfs_ioc_ddt_prune, zfs_secpolicy_config, POOL_NAME,
+	    POOL_CHECK_SUSPENDED | POOL_CHECK_READONLY, B_TRUE, B_TRUE,
+	    zfs_keys_ddt_prune, ARRAY_SIZE(zfs_keys_ddt_prune));
+
+	zfs_ioctl_register("changed_blocks", ZFS_IOC_CHANGED_BLOCKS,
+	    zfs_ioc_changed_blocks, zfs_secpolicy_diff, DATASET_NAME,
+	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE,
+	    zfs_keys_changed_blocks, ARRAY_SIZE(zfs_keys_changed_blocks));
+
+	zfs_ioctl_register("mount_prefetch", ZFS_IOC_MOUNT_PREFETCH,
+	    zfs_ioc_mount_prefetch, zfs_secpolicy_read, DATASET_NAME,
+	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE,
+	    zfs_keys_mount_prefetch, ARRAY_SIZE(zfs_keys_mount_prefetch));
+
+	zfs_ioctl_register("dataset_list_batch", ZFS_IOC_DATASET_LIST_BATCH,
+	    zfs_ioc_dataset_list_batch, zfs_secpolicy_read, DATASET_NAME,
+	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE,
+	    zfs_keys_dataset_list_batch,
+	    ARRAY_SIZE(zfs_keys_dataset_list_batch));
+
+	zfs_ioctl_register("dedup_sample", ZFS_IOC_DEDUP_SAMPLE,
+	    zfs_ioc_dedup_sample, zfs_secpolicy_read, POOL_NAME,
+	    POOL_CHECK_SUSPENDED, B_FALSE, B_FALSE,
+	    zfs_keys_dedup_sample, ARRAY_SIZE(zfs_keys_dedup_sample));
+
+	zfs_ioctl_register("kstats", ZFS_IOC_KSTATS,
+	    zfs_ioc_kstats, zfs_secpolicy_none, NO_NAME,
+	    POOL_CHECK_NONE, B_FALSE, B_FALSE,
+	    zfs_keys_kstats, ARRAY_SIZE(zfs_keys_kstats));
+
 	/* IOCTLS that use the legacy function signature */
 
 	zfs_ioctl_register_legacy(ZFS_IOC_POOL_FREEZE, zfs_ioc_pool_freeze,
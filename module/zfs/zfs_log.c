@@ -604,6 +604,15 @@ zfs_log_rename_whiteout(zilog_t *zilog, dmu_tx_t *tx, uint64_t txtype,
  */
 static int64_t zfs_immediate_write_sz = 32768;
 
+/*
+ * With a SLOG, large writes are normally copied into the log and so are
+ * written twice.  Once a single commit exceeds zil_slog_bulk the SLOG is
+ * the bottleneck, so when this is set, writes of at least
+ * zfs_immediate_write_sz are logged indirectly (written to the main pool)
+ * after such a commit.
+ */
+static int zfs_immediate_write_slog_bulk = 0;
+
 void
 zfs_log_write(zilog_t *zilog, dmu_tx_t *tx, int txtype,
     znode_t *zp, offset_t off, ssize_t resid, boolean_t commit,
@@ -624,8 +633,9 @@ zfs_log_write(zilog_t *zilog, dmu_tx_t *tx, int txtype,
 
 	if (zilog->zl_logbias == ZFS_LOGBIAS_THROUGHPUT)
 		write_state = WR_INDIRECT;
-	else if (!spa_has_slogs(zilog->zl_spa) &&
-	    resid >= zfs_immediate_write_sz)
+	else if (resid >= zfs_immediate_write_sz &&
+	    (!spa_has_slogs(zilog->zl_spa) ||
+	    (zfs_immediate_write_slog_bulk && zil_slog_is_bulk(zilog))))
 		write_state = WR_INDIRECT;
 	else if (commit)
 		write_state = WR_COPIED;
@@ -933,3 +943,6 @@ zfs_log_clone_range(zilog_t *zilog, dmu_tx_t *tx, int txtype, znode_t *zp,
 
 ZFS_MODULE_PARAM(zfs, zfs_, immediate_write_sz, S64, ZMOD_RW,
 	"Largest data block to write to zil");
+
+ZFS_MODULE_PARAM(zfs, zfs_, immediate_write_slog_bulk, INT, ZMOD_RW,
+	"Log large writes indirectly after a commit exceeds zil_slog_bulk");
@@ -419,8 +419,13 @@ zfs_id_overobjquota(zfsvfs_t *zfsvfs, uint64_t usedobj, uint64_t id)
 	return (used >= quota);
 }
 
+/*
+ * Return true if the id is over its block quota, or would be if another
+ * len bytes were charged to it.
+ */
 boolean_t
-zfs_id_overblockquota(zfsvfs_t *zfsvfs, uint64_t usedobj, uint64_t id)
+zfs_id_overblockquota_len(zfsvfs_t *zfsvfs, uint64_t usedobj, uint64_t id,
+    uint64_t len)
 {
 	char buf[20];
 	uint64_t used, quota, quotaobj;
@@ -456,7 +461,13 @@ zfs_id_overblockquota(zfsvfs_t *zfsvfs, uint64_t usedobj, uint64_t id)
 	err = zap_lookup(zfsvfs->z_os, usedobj, buf, 8, 1, &used);
 	if (err != 0)
 		return (B_FALSE);
-	return (used >= quota);
+	return (used >= quota || len > quota - used);
+}
+
+boolean_t
+zfs_id_overblockquota(zfsvfs_t *zfsvfs, uint64_t usedobj, uint64_t id)
+{
+	return (zfs_id_overblockquota_len(zfsvfs, usedobj, id, 0));
 }
 
 boolean_t
@@ -471,5 +482,6 @@ EXPORT_SYMBOL(zfs_userspace_one);
 EXPORT_SYMBOL(zfs_userspace_many);
 EXPORT_SYMBOL(zfs_set_userquota);
 EXPORT_SYMBOL(zfs_id_overblockquota);
+EXPORT_SYMBOL(zfs_id_overblockquota_len);
 EXPORT_SYMBOL(zfs_id_overobjquota);
 EXPORT_SYMBOL(zfs_id_overquota);
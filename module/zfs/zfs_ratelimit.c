@@ -38,6 +38,7 @@ zfs_ratelimit_init(zfs_ratelimit_t *rl, unsigned int *burst,
 {
 	rl->count = 0;
 	rl->start = 0;
+	rl->suppressed = 0;
 	rl->interval = interval;
 	rl->burst = burst;
 	mutex_init(&rl->lock, NULL, MUTEX_DEFAULT, NULL);
@@ -91,9 +92,27 @@ zfs_ratelimit(zfs_ratelimit_t *rl)
 	} else {
 		if (rl->count >= *rl->burst) {
 			error = 0; /* We're ratelimiting */
+			rl->suppressed++;
 		}
 	}
 	mutex_exit(&rl->lock);
 
 	return (error);
 }
+
+/*
+ * Return how many times zfs_ratelimit() has limited since the last call,
+ * so that the next thing let through can account for what was dropped.
+ */
+uint64_t
+zfs_ratelimit_take(zfs_ratelimit_t *rl)
+{
+	uint64_t suppressed;
+
+	mutex_enter(&rl->lock);
+	suppressed = rl->suppressed;
+	rl->suppressed = 0;
+	mutex_exit(&rl->lock);
+
+	return (suppressed);
+}
@@ -108,11 +108,48 @@
  * So if the block size needs to be grown then the whole file is
  * exclusively locked, then later the caller will reduce the lock
  * range to just the range to be written using rangelock_reduce().
+ *
+ * Segments
+ * --------
+ * All ranges of a file are kept in one AVL tree protected by rl_lock, which
+ * serializes every reader and writer of the file even when their ranges are
+ * disjoint, as with many processes writing separate regions of one shared
+ * file.  Once a rangelock has been seen with zfs_rangelock_segment_threshold
+ * ranges locked at the same time, it is split into zfs_rangelock_segments
+ * segments, each a rangelock of its own.  The file's offsets are striped
+ * across the segments in units of 2^zfs_rangelock_segment_shift bytes, and
+ * a range is locked in every segment owning one of the stripe units it
+ * touches.  Two overlapping ranges share at least one stripe unit, so they
+ * conflict in the segment owning it, while disjoint ranges usually only
+ * meet in different segments.  Segments are always locked in ascending
+ * order to avoid deadlocks; whole-file locks simply lock every segment.
+ *
+ * The callback is invoked without any lock held in segmented mode, so its
+ * result is checked again once the segments are locked, and the lock is
+ * retried if it changed (for instance because an append raced with another
+ * write extending the file).  Ranges locked before the split remain in
+ * rl_tree until released; while any are left (rl_draining), new lockers
+ * first wait for those overlapping their range.  A rangelock stays
+ * segmented until zfs_rangelock_fini().
  */
 
 #include <sys/zfs_context.h>
 #include <sys/zfs_rlock.h>
 
+/*
+ * Number of segments a contended rangelock is split into, 0 to never split.
+ */
+static uint_t zfs_rangelock_segments = 16;
+
+/*
+ * log2 of the size of the file stripes assigned to each segment.
+ */
+static uint_t zfs_rangelock_segment_shift = 20;
+
+/*
+ * Number of ranges locked at once which causes a rangelock to be split.
+ */
+static uint_t zfs_rangelock_segment_threshold = 8;
 
 /*
  * AVL comparison function used to order range locks
@@ -140,15 +177,57 @@ zfs_rangelock_init(zfs_rangelock_t *rl, zfs_rangelock_cb_t *cb, void *arg)
 	    sizeof (zfs_locked_range_t), offsetof(zfs_locked_range_t, lr_node));
 	rl->rl_cb = cb;
 	rl->rl_arg = arg;
+	rl->rl_segs = NULL;
+	rl->rl_nsegs = 0;
+	rl->rl_seg_shift = 0;
+	rl->rl_is_seg = B_FALSE;
+	rl->rl_draining = B_FALSE;
 }
 
 void
 zfs_rangelock_fini(zfs_rangelock_t *rl)
 {
+	if (rl->rl_segs != NULL) {
+		for (uint_t i = 0; i < rl->rl_nsegs; i++)
+			zfs_rangelock_fini(&rl->rl_segs[i]);
+		kmem_free(rl->rl_segs, rl->rl_nsegs * sizeof (zfs_rangelock_t));
+	}
 	mutex_destroy(&rl->rl_lock);
 	avl_destroy(&rl->rl_tree);
 }
 
+/*
+ * Split a contended rangelock into segments.  Called with rl_lock held once
+ * a range has been added to the tree.  Allocation failures are ignored, the
+ * split will be attempted again by a later locker.
+ */
+static void
+zfs_rangelock_segment(zfs_rangelock_t *rl)
+{
+	zfs_rangelock_t *segs;
+	uint_t nsegs = MIN(zfs_rangelock_segments, 64);
+
+	ASSERT(MUTEX_HELD(&rl->rl_lock));
+
+	if (rl->rl_is_seg || rl->rl_segs != NULL || nsegs < 2 ||
+	    avl_numnodes(&rl->rl_tree) < zfs_rangelock_segment_threshold)
+		return;
+
+	segs = kmem_zalloc(nsegs * sizeof (zfs_rangelock_t), KM_NOSLEEP);
+	if (segs == NULL)
+		return;
+
+	for (uint_t i = 0; i < nsegs; i++) {
+		zfs_rangelock_init(&segs[i], NULL, NULL);
+		segs[i].rl_is_seg = B_TRUE;
+	}
+	rl->rl_nsegs = nsegs;
+	rl->rl_seg_shift = MIN(zfs_rangelock_segment_shift, 63);
+	rl->rl_draining = B_TRUE;
+	membar_producer();
+	rl->rl_segs = segs;
+}
+
 /*
  * Check if a write lock can be grabbed.  If not, fail immediately or sleep and
  * recheck until available, depending on the value of the "nonblock" parameter.
@@ -216,6 +295,10 @@ wait:
 		}
 		cv_wait(&lr->lr_write_cv, &rl->rl_lock);
 
+		/* split while waiting, lock the segments instead */
+		if (rl->rl_segs != NULL)
+			return (B_FALSE);
+
 		/* reset to original */
 		new->lr_offset = orig_off;
 		new->lr_length = orig_len;
@@ -429,6 +512,8 @@ retry:
 				prev->lr_read_wanted = B_TRUE;
 			}
 			cv_wait(&prev->lr_read_cv, &rl->rl_lock);
+			if (rl->rl_segs != NULL)
+				return (B_FALSE);
 			goto retry;
 		}
 		if (off + len < prev->lr_offset + prev->lr_length)
@@ -455,6 +540,8 @@ retry:
 				next->lr_read_wanted = B_TRUE;
 			}
 			cv_wait(&next->lr_read_cv, &rl->rl_lock);
+			if (rl->rl_segs != NULL)
+				return (B_FALSE);
 			goto retry;
 		}
 		if (off + len <= next->lr_offset + next->lr_length)
@@ -478,6 +565,9 @@ got_lock:
  * entire file is locked as RL_WRITER), or NULL if nonblock is true and the
  * lock could not be acquired immediately.
  */
+static zfs_locked_range_t *zfs_rangelock_enter_segmented(zfs_rangelock_t *,
+    uint64_t, uint64_t, zfs_rangelock_type_t, boolean_t);
+
 static zfs_locked_range_t *
 zfs_rangelock_enter_impl(zfs_rangelock_t *rl, uint64_t off, uint64_t len,
     zfs_rangelock_type_t type, boolean_t nonblock)
@@ -486,6 +576,11 @@ zfs_rangelock_enter_impl(zfs_rangelock_t *rl, uint64_t off, uint64_t len,
 
 	ASSERT(type == RL_READER || type == RL_WRITER || type == RL_APPEND);
 
+	if (rl->rl_segs != NULL) {
+		return (zfs_rangelock_enter_segmented(rl, off, len, type,
+		    nonblock));
+	}
+
 	new = kmem_alloc(sizeof (zfs_locked_range_t), KM_SLEEP);
 	new->lr_rangelock = rl;
 	new->lr_offset = off;
@@ -497,8 +592,16 @@ zfs_rangelock_enter_impl(zfs_rangelock_t *rl, uint64_t off, uint64_t len,
 	new->lr_proxy = B_FALSE;
 	new->lr_write_wanted = B_FALSE;
 	new->lr_read_wanted = B_FALSE;
+	new->lr_segs = NULL;
 
 	mutex_enter(&rl->rl_lock);
+	if (rl->rl_segs != NULL) {
+		/* split since checked above */
+		mutex_exit(&rl->rl_lock);
+		kmem_free(new, sizeof (*new));
+		return (zfs_rangelock_enter_segmented(rl, off, len, type,
+		    nonblock));
+	}
 	if (type == RL_READER) {
 		/*
 		 * First check for the usual case of no locks
@@ -513,10 +616,179 @@ zfs_rangelock_enter_impl(zfs_rangelock_t *rl, uint64_t off, uint64_t len,
 		kmem_free(new, sizeof (*new));
 		new = NULL;
 	}
+	if (new != NULL) {
+		zfs_rangelock_segment(rl);
+	} else if (rl->rl_segs != NULL) {
+		/* split while waiting */
+		mutex_exit(&rl->rl_lock);
+		return (zfs_rangelock_enter_segmented(rl, off, len, type,
+		    nonblock));
+	}
 	mutex_exit(&rl->rl_lock);
 	return (new);
 }
 
+/*
+ * Wait until no range locked before the rangelock was split conflicts with
+ * the new one.  No ranges are added to rl_tree once split, so once it is
+ * empty it stays empty and rl_draining is cleared.  Returns B_FALSE if
+ * "nonblock" is set and the range is not available.
+ */
+static boolean_t
+zfs_rangelock_drain(zfs_rangelock_t *rl, zfs_locked_range_t *new,
+    boolean_t nonblock)
+{
+	avl_tree_t *tree = &rl->rl_tree;
+	zfs_locked_range_t *lr;
+	avl_index_t where;
+	uint64_t off = new->lr_offset;
+	uint64_t end = off + MIN(new->lr_length, UINT64_MAX - off);
+
+	mutex_enter(&rl->rl_lock);
+	while (avl_numnodes(tree) != 0) {
+		lr = avl_find(tree, new, &where);
+		if (lr == NULL)
+			lr = avl_nearest(tree, where, AVL_BEFORE);
+		if (lr == NULL)
+			lr = avl_nearest(tree, where, AVL_AFTER);
+		for (; lr != NULL && lr->lr_offset < end;
+		    lr = AVL_NEXT(tree, lr)) {
+			if (lr->lr_offset + lr->lr_length <= off)
+				continue;
+			if (new->lr_type == RL_WRITER ||
+			    lr->lr_type == RL_WRITER)
+				break;
+		}
+		if (lr == NULL || lr->lr_offset >= end) {
+			mutex_exit(&rl->rl_lock);
+			return (B_TRUE);
+		}
+		if (nonblock) {
+			mutex_exit(&rl->rl_lock);
+			return (B_FALSE);
+		}
+		if (new->lr_type == RL_WRITER) {
+			if (!lr->lr_write_wanted) {
+				cv_init(&lr->lr_write_cv,
+				    NULL, CV_DEFAULT, NULL);
+				lr->lr_write_wanted = B_TRUE;
+			}
+			cv_wait(&lr->lr_write_cv, &rl->rl_lock);
+		} else {
+			if (!lr->lr_read_wanted) {
+				cv_init(&lr->lr_read_cv,
+				    NULL, CV_DEFAULT, NULL);
+				lr->lr_read_wanted = B_TRUE;
+			}
+			cv_wait(&lr->lr_read_cv, &rl->rl_lock);
+		}
+	}
+	rl->rl_draining = B_FALSE;
+	mutex_exit(&rl->rl_lock);
+	return (B_TRUE);
+}
+
+/*
+ * Return the mask of the segments owning a stripe unit of the range.
+ */
+static uint64_t
+zfs_rangelock_segmask(zfs_rangelock_t *rl, uint64_t off, uint64_t len)
+{
+	uint64_t first, last, mask = 0;
+
+	len = MAX(MIN(len, UINT64_MAX - off), 1);
+	first = off >> rl->rl_seg_shift;
+	last = (off + len - 1) >> rl->rl_seg_shift;
+	if (last - first + 1 >= rl->rl_nsegs)
+		return (rl->rl_nsegs == 64 ? UINT64_MAX :
+		    (1ULL << rl->rl_nsegs) - 1);
+
+	for (uint64_t unit = first; unit <= last; unit++)
+		mask |= 1ULL << (unit % rl->rl_nsegs);
+	return (mask);
+}
+
+static void
+zfs_rangelock_exit_segments(zfs_locked_range_t *lr)
+{
+	zfs_rangelock_t *rl = lr->lr_rangelock;
+
+	for (uint_t i = 0; i < rl->rl_nsegs; i++) {
+		if (lr->lr_segs[i] != NULL) {
+			zfs_rangelock_exit(lr->lr_segs[i]);
+			lr->lr_segs[i] = NULL;
+		}
+	}
+}
+
+/*
+ * Lock a range of a split rangelock by locking it in each segment it
+ * touches.  The returned handle carries the range as set by the callback.
+ */
+static zfs_locked_range_t *
+zfs_rangelock_enter_segmented(zfs_rangelock_t *rl, uint64_t off,
+    uint64_t len, zfs_rangelock_type_t type, boolean_t nonblock)
+{
+	zfs_locked_range_t *new, check;
+	uint64_t mask;
+
+	new = kmem_zalloc(sizeof (zfs_locked_range_t), KM_SLEEP);
+	new->lr_segs = kmem_zalloc(rl->rl_nsegs * sizeof (zfs_locked_range_t *),
+	    KM_SLEEP);
+	new->lr_rangelock = rl;
+	new->lr_count = 1;
+	if (len + off < off)	/* overflow */
+		len = UINT64_MAX - off;
+
+	for (;;) {
+		new->lr_offset = off;
+		new->lr_length = len;
+		new->lr_type = type;
+		if (rl->rl_cb != NULL && type != RL_READER)
+			rl->rl_cb(new, rl->rl_arg);
+		ASSERT(new->lr_type == RL_READER || new->lr_type == RL_WRITER);
+
+		if (rl->rl_draining && !zfs_rangelock_drain(rl, new, nonblock))
+			goto fail;
+
+		mask = zfs_rangelock_segmask(rl, new->lr_offset,
+		    new->lr_length);
+		for (uint_t i = 0; i < rl->rl_nsegs; i++) {
+			if (!(mask & (1ULL << i)))
+				continue;
+			new->lr_segs[i] = zfs_rangelock_enter_impl(
+			    &rl->rl_segs[i], new->lr_offset, new->lr_length,
+			    new->lr_type, nonblock);
+			if (new->lr_segs[i] == NULL) {
+				zfs_rangelock_exit_segments(new);
+				goto fail;
+			}
+		}
+
+		if (rl->rl_cb == NULL || type == RL_READER)
+			return (new);
+
+		/*
+		 * The callback ran unlocked, make sure the file did not
+		 * change in a way that changes the range to lock.
+		 */
+		check.lr_offset = off;
+		check.lr_length = len;
+		check.lr_type = type;
+		rl->rl_cb(&check, rl->rl_arg);
+		if (check.lr_offset == new->lr_offset &&
+		    check.lr_length == new->lr_length)
+			return (new);
+
+		zfs_rangelock_exit_segments(new);
+	}
+
+fail:
+	kmem_free(new->lr_segs, rl->rl_nsegs * sizeof (zfs_locked_range_t *));
+	kmem_free(new, sizeof (zfs_locked_range_t));
+	return (NULL);
+}
+
 zfs_locked_range_t *
 zfs_rangelock_enter(zfs_rangelock_t *rl, uint64_t off, uint64_t len,
     zfs_rangelock_type_t type)
@@ -622,6 +894,14 @@ zfs_rangelock_exit(zfs_locked_range_t *lr)
 	ASSERT(lr->lr_count == 1 || lr->lr_count == 0);
 	ASSERT(!lr->lr_proxy);
 
+	if (lr->lr_segs != NULL) {
+		zfs_rangelock_exit_segments(lr);
+		kmem_free(lr->lr_segs,
+		    rl->rl_nsegs * sizeof (zfs_locked_range_t *));
+		kmem_free(lr, sizeof (zfs_locked_range_t));
+		return;
+	}
+
 	/*
 	 * The free list is used to defer the cv_destroy() and
 	 * subsequent kmem_free until after the mutex is dropped.
@@ -663,6 +943,19 @@ zfs_rangelock_reduce(zfs_locked_range_t *lr, uint64_t off, uint64_t len)
 {
 	zfs_rangelock_t *rl = lr->lr_rangelock;
 
+	if (lr->lr_segs != NULL) {
+		/*
+		 * The whole file is locked in every segment.  Reducing the
+		 * range in each of them keeps it locked in those owning the
+		 * new range, and harmlessly in the others.
+		 */
+		for (uint_t i = 0; i < rl->rl_nsegs; i++)
+			zfs_rangelock_reduce(lr->lr_segs[i], off, len);
+		lr->lr_offset = off;
+		lr->lr_length = len;
+		return;
+	}
+
 	/* Ensure there are no other locks */
 	ASSERT3U(avl_numnodes(&rl->rl_tree), ==, 1);
 	ASSERT3U(lr->lr_offset, ==, 0);
@@ -689,3 +982,12 @@ EXPORT_SYMBOL(zfs_rangelock_tryenter);
 EXPORT_SYMBOL(zfs_rangelock_exit);
 EXPORT_SYMBOL(zfs_rangelock_reduce);
 #endif
+
+ZFS_MODULE_PARAM(zfs, zfs_, rangelock_segments, UINT, ZMOD_RW,
+	"Number of segments a contended range lock is split into");
+
+ZFS_MODULE_PARAM(zfs, zfs_, rangelock_segment_shift, UINT, ZMOD_RW,
+	"log2 of the file stripe size assigned to each range lock segment");
+
+ZFS_MODULE_PARAM(zfs, zfs_, rangelock_segment_threshold, UINT, ZMOD_RW,
+	"Number of concurrently locked ranges which splits a range lock");
@@ -79,6 +79,15 @@ static int zfs_bclone_wait_dirty = 0;
  */
 static uint64_t zfs_vnops_read_chunk_size = 1024 * 1024;
 
+/*
+ * When set, O_APPEND writes reserve their offset up front and only lock the
+ * reserved range, so that concurrent appenders to the same file no longer
+ * wait for each other's entire write.  The file size then advances as each
+ * append completes, which may be out of order, so a failed or interrupted
+ * append (or a crash) can leave a zero-filled gap before later appends.
+ */
+static int zfs_append_reserve = 0;
+
 int
 zfs_fsync(znode_t *zp, int syncflag, cred_t *cr)
 {
@@ -86,16 +95,62 @@ zfs_fsync(znode_t *zp, int syncflag, cred_t *cr)
 	zfsvfs_t *zfsvfs = ZTOZSB(zp);
 
 	if (zfsvfs->z_os->os_sync != ZFS_SYNC_DISABLED) {
+		hrtime_t start = gethrtime();
+
 		if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
 			return (error);
 		atomic_inc_32(&zp->z_sync_writes_cnt);
 		zil_commit(zfsvfs->z_log, zp->z_id);
 		atomic_dec_32(&zp->z_sync_writes_cnt);
+		dataset_kstats_update_fsync_kstats(&zfsvfs->z_kstat,
+		    gethrtime() - start);
 		zfs_exit(zfsvfs, FTAG);
 	}
 	return (error);
 }
 
+/*
+ * Fsync several files of the same filesystem at once.  A single ZIL commit
+ * covers all of them, so they share the lwb writes and the flush of the
+ * log device instead of waiting for one each.
+ */
+int
+zfs_fsync_many(znode_t **zps, uint_t nzps, int syncflag, cred_t *cr)
+{
+	(void) syncflag, (void) cr;
+	int error = 0;
+	zfsvfs_t *zfsvfs = ZTOZSB(zps[0]);
+
+	if (zfsvfs->z_os->os_sync == ZFS_SYNC_DISABLED)
+		return (0);
+
+	hrtime_t start = gethrtime();
+	uint64_t *foids = kmem_alloc(nzps * sizeof (uint64_t), KM_SLEEP);
+
+	if ((error = zfs_enter(zfsvfs, FTAG)) != 0)
+		goto out;
+	for (uint_t i = 0; i < nzps; i++) {
+		ASSERT3P(ZTOZSB(zps[i]), ==, zfsvfs);
+		if ((error = zfs_verify_zp(zps[i])) != 0) {
+			zfs_exit(zfsvfs, FTAG);
+			goto out;
+		}
+		foids[i] = zps[i]->z_id;
+	}
+
+	for (uint_t i = 0; i < nzps; i++)
+		atomic_inc_32(&zps[i]->z_sync_writes_cnt);
+	zil_commit_objects(zfsvfs->z_log, foids, nzps);
+	for (uint_t i = 0; i < nzps; i++)
+		atomic_dec_32(&zps[i]->z_sync_writes_cnt);
+	dataset_kstats_update_fsync_kstats(&zfsvfs->z_kstat,
+	    gethrtime() - start);
+	zfs_exit(zfsvfs, FTAG);
+out:
+	kmem_free(foids, nzps * sizeof (uint64_t));
+	return (error);
+}
+
 
 #if defined(SEEK_HOLE) && defined(SEEK_DATA)
 /*
@@ -202,6 +257,61 @@ zfs_access(znode_t *zp, int mode, int flag, cred_t *cr)
 	return (error);
 }
 
+/*
+ * Decide whether a request for [off, off + len) may bypass the ARC, based
+ * on the dataset's "direct" property.  Only whole, block-aligned ranges of
+ * files which are not memory mapped are eligible.
+ */
+static boolean_t
+zfs_dio_ok(znode_t *zp, int ioflag, uint64_t off, uint64_t len)
+{
+	objset_t *os = ZTOZSB(zp)->z_os;
+	uint64_t blksz = zp->z_blksz;
+
+	switch (os->os_direct) {
+	case ZFS_DIRECT_ALWAYS:
+		break;
+	case ZFS_DIRECT_STANDARD:
+		if (!(ioflag & O_DIRECT))
+			return (B_FALSE);
+		break;
+	default:
+		return (B_FALSE);
+	}
+
+	if (len == 0 || blksz == 0 || off % blksz != 0 || len % blksz != 0)
+		return (B_FALSE);
+
+	return (!zn_has_cached_data(zp, off, off + len - 1));
+}
+
+#if defined(__linux__)
+/*
+ * Wrap the user pages backing the next n bytes of the uio in an ABD, so a
+ * Direct I/O write can be issued without copying the data.  Returns NULL
+ * if the pages can't be referenced in place.
+ */
+static abd_t *
+zfs_dio_borrow_abd(zfs_uio_t *uio, size_t n)
+{
+	int maxpages = DIV_ROUND_UP(n, PAGESIZE) + 1;
+	struct page **pages;
+	abd_t *abd = NULL;
+	size_t off;
+	int npages;
+
+	pages = kmem_alloc(maxpages * sizeof (struct page *), KM_SLEEP);
+	npages = zfs_uio_get_pages(uio, n, pages, maxpages, &off);
+	if (npages > 0) {
+		abd = abd_alloc_from_pages(pages, off, n);
+		zfs_uio_put_pages(pages, npages);
+	}
+	kmem_free(pages, maxpages * sizeof (struct page *));
+
+	return (abd);
+}
+#endif
+
 /*
  * Read bytes from specified file into supplied buffer.
  *
@@ -225,6 +335,7 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	(void) cr;
 	int error = 0;
 	boolean_t frsync = B_FALSE;
+	hrtime_t start = gethrtime();
 
 	zfsvfs_t *zfsvfs = ZTOZSB(zp);
 	if ((error = zfs_enter_verify_zp(zfsvfs, zp, FTAG)) != 0)
@@ -305,6 +416,10 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		if (zn_has_cached_data(zp, zfs_uio_offset(uio),
 		    zfs_uio_offset(uio) + nbytes - 1) && !(ioflag & O_DIRECT)) {
 			error = mappedread(zp, nbytes, uio);
+		} else if (zfs_dio_ok(zp, ioflag, zfs_uio_offset(uio),
+		    nbytes)) {
+			error = dmu_read_uio_direct(sa_get_db(zp->z_sa_hdl),
+			    uio, nbytes);
 		} else {
 			error = dmu_read_uio_dbuf(sa_get_db(zp->z_sa_hdl),
 			    uio, nbytes);
@@ -334,6 +449,7 @@ zfs_read(struct znode *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 
 	int64_t nread = start_resid - n;
 	dataset_kstats_update_read_kstats(&zfsvfs->z_kstat, nread);
+	dataset_kstats_update_read_time(&zfsvfs->z_kstat, gethrtime() - start);
 	task_io_account_read(nread);
 out:
 	zfs_rangelock_exit(lr);
@@ -398,6 +514,43 @@ zfs_clear_setid_bits_if_necessary(zfsvfs_t *zfsvfs, znode_t *zp, cred_t *cr,
 	}
 }
 
+/*
+ * Reserve n bytes at the end of the file for an O_APPEND write, past any
+ * range already reserved by appends still in progress.
+ */
+static uint64_t
+zfs_append_reserve_range(znode_t *zp, uint64_t n)
+{
+	uint64_t woff;
+
+	mutex_enter(&zp->z_lock);
+	if (zp->z_append_busy == 0)
+		zp->z_append_end = zp->z_size;
+	woff = MAX(zp->z_size, zp->z_append_end);
+	zp->z_append_end = woff + n;
+	zp->z_append_busy++;
+	mutex_exit(&zp->z_lock);
+
+	return (woff);
+}
+
+/*
+ * Release an append reservation of [woff, woff + n) of which the write got
+ * as far as end.  If no later append reserved space in the meantime, the
+ * unused part is handed back.
+ */
+static void
+zfs_append_release_range(znode_t *zp, uint64_t woff, uint64_t n,
+    uint64_t end)
+{
+	mutex_enter(&zp->z_lock);
+	ASSERT3U(zp->z_append_busy, >, 0);
+	if (zp->z_append_end == woff + n)
+		zp->z_append_end = MAX(end, woff);
+	zp->z_append_busy--;
+	mutex_exit(&zp->z_lock);
+}
+
 /*
  * Write the bytes to a file.
  *
@@ -422,6 +575,7 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	int error = 0, error1;
 	ssize_t start_resid = zfs_uio_resid(uio);
 	uint64_t clear_setid_bits_txg = 0;
+	hrtime_t start = gethrtime();
 
 	/*
 	 * Fasttrack empty write
@@ -488,7 +642,23 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 	 * If in append mode, set the io offset pointer to eof.
 	 */
 	zfs_locked_range_t *lr;
-	if (ioflag & O_APPEND) {
+	boolean_t reserved = B_FALSE;
+	uint64_t resv_off = 0, resv_len = 0;
+	if ((ioflag & O_APPEND) && zfs_append_reserve && !zfsvfs->z_replay) {
+		/*
+		 * Reserve the range at the end of the file and lock only
+		 * that.  The range lock may still cover the whole file if
+		 * the block size has to grow, but the offset stays the one
+		 * reserved.
+		 */
+		resv_len = n;
+		resv_off = zfs_append_reserve_range(zp, resv_len);
+		reserved = B_TRUE;
+		lr = zfs_rangelock_enter(&zp->z_rangelock, resv_off, n,
+		    RL_WRITER);
+		woff = resv_off;
+		zfs_uio_setoffset(uio, woff);
+	} else if (ioflag & O_APPEND) {
 		/*
 		 * Obtain an appending range lock to guarantee file append
 		 * semantics.  We reset the write offset once we have the lock.
@@ -515,6 +685,8 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 
 	if (zn_rlimit_fsize_uio(zp, uio)) {
 		zfs_rangelock_exit(lr);
+		if (reserved)
+			zfs_append_release_range(zp, resv_off, resv_len, woff);
 		zfs_exit(zfsvfs, FTAG);
 		return (SET_ERROR(EFBIG));
 	}
@@ -523,6 +695,8 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 
 	if (woff >= limit) {
 		zfs_rangelock_exit(lr);
+		if (reserved)
+			zfs_append_release_range(zp, resv_off, resv_len, woff);
 		zfs_exit(zfsvfs, FTAG);
 		return (SET_ERROR(EFBIG));
 	}
@@ -577,8 +751,32 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		}
 
 		arc_buf_t *abuf = NULL;
+		abd_t *dabd = NULL;
 		ssize_t nbytes = n;
-		if (n >= blksz && woff >= zp->z_size &&
+		ssize_t dbytes = MIN(n, SPA_MAXBLOCKSIZE) / blksz * blksz;
+		if (lr->lr_length != UINT64_MAX && dbytes > 0 &&
+		    zfsvfs->z_os->os_dedup_checksum == ZIO_CHECKSUM_OFF &&
+		    zfs_dio_ok(zp, ioflag, woff, dbytes)) {
+			/*
+			 * Direct I/O of whole blocks.  Reference the user
+			 * pages where possible; otherwise, as for the borrowed
+			 * arc buffer below, fill a transient buffer before
+			 * entering the transaction.
+			 */
+#if defined(__linux__)
+			dabd = zfs_dio_borrow_abd(uio, dbytes);
+#endif
+			if (dabd == NULL) {
+				dabd = abd_alloc_linear(dbytes, B_FALSE);
+				if ((error = zfs_uiocopy(abd_to_buf(dabd),
+				    dbytes, UIO_WRITE, uio, &nbytes))) {
+					abd_free(dabd);
+					break;
+				}
+				ASSERT3S(nbytes, ==, dbytes);
+			}
+			nbytes = dbytes;
+		} else if (n >= blksz && woff >= zp->z_size &&
 		    P2PHASE(woff, blksz) == 0 &&
 		    (blksz >= SPA_OLD_MAXBLOCKSIZE || n < 4 * blksz)) {
 			/*
@@ -625,6 +823,8 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 			dmu_tx_abort(tx);
 			if (abuf != NULL)
 				dmu_return_arcbuf(abuf);
+			if (dabd != NULL)
+				abd_free(dabd);
 			break;
 		}
 
@@ -645,7 +845,20 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 		}
 
 		ssize_t tx_bytes;
-		if (abuf == NULL) {
+		if (dabd != NULL) {
+			error = dmu_write_direct(sa_get_db(zp->z_sa_hdl),
+			    woff, nbytes, dabd, tx);
+			abd_free(dabd);
+			if (error != 0) {
+				zfs_clear_setid_bits_if_necessary(zfsvfs, zp,
+				    cr, &clear_setid_bits_txg, tx);
+				dmu_tx_commit(tx);
+				break;
+			}
+			ASSERT3S(nbytes, <=, zfs_uio_resid(uio));
+			zfs_uioskip(uio, nbytes);
+			tx_bytes = nbytes;
+		} else if (abuf == NULL) {
 			tx_bytes = zfs_uio_resid(uio);
 			zfs_uio_fault_disable(uio, B_TRUE);
 			error = dmu_write_uio_dbuf(sa_get_db(zp->z_sa_hdl),
@@ -769,6 +982,10 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 
 	zfs_znode_update_vfs(zp);
 	zfs_rangelock_exit(lr);
+	if (reserved) {
+		zfs_append_release_range(zp, resv_off, resv_len,
+		    zfs_uio_offset(uio));
+	}
 
 	/*
 	 * If we're in replay mode, or we made no progress, or the
@@ -786,6 +1003,8 @@ zfs_write(znode_t *zp, zfs_uio_t *uio, int ioflag, cred_t *cr)
 
 	const int64_t nwritten = start_resid - zfs_uio_resid(uio);
 	dataset_kstats_update_write_kstats(&zfsvfs->z_kstat, nwritten);
+	dataset_kstats_update_write_time(&zfsvfs->z_kstat, gethrtime() - start,
+	    commit);
 	task_io_account_write(nwritten);
 
 	zfs_exit(zfsvfs, FTAG);
@@ -1554,6 +1773,9 @@ EXPORT_SYMBOL(zfs_clone_range_replay);
 ZFS_MODULE_PARAM(zfs_vnops, zfs_vnops_, read_chunk_size, U64, ZMOD_RW,
 	"Bytes to read per chunk");
 
+ZFS_MODULE_PARAM(zfs, zfs_, append_reserve, INT, ZMOD_RW,
+	"Reserve the offset of O_APPEND writes instead of serializing them");
+
 ZFS_MODULE_PARAM(zfs, zfs_, bclone_enabled, INT, ZMOD_RW,
 	"Enable block cloning");
 
@@ -99,6 +99,10 @@ static uint_t zfs_commit_timeout_pct = 10;
 static zil_kstat_values_t zil_stats = {
 	{ "zil_commit_count",			KSTAT_DATA_UINT64 },
 	{ "zil_commit_writer_count",		KSTAT_DATA_UINT64 },
+	{ "zil_commit_lwb_count",		KSTAT_DATA_UINT64 },
+	{ "zil_commit_lwb_wait_time",		KSTAT_DATA_UINT64 },
+	{ "zil_commit_lwb_write_time",		KSTAT_DATA_UINT64 },
+	{ "zil_commit_lwb_flush_time",		KSTAT_DATA_UINT64 },
 	{ "zil_itx_count",			KSTAT_DATA_UINT64 },
 	{ "zil_itx_indirect_count",		KSTAT_DATA_UINT64 },
 	{ "zil_itx_indirect_bytes",		KSTAT_DATA_UINT64 },
@@ -144,6 +148,8 @@ static kmem_cache_t *zil_zcw_cache;
 static void zil_lwb_commit(zilog_t *zilog, lwb_t *lwb, itx_t *itx);
 static itx_t *zil_itx_clone(itx_t *oitx);
 static uint64_t zil_max_waste_space(zilog_t *zilog);
+static void zil_commit_objects_impl(zilog_t *zilog, const uint64_t *foids,
+    uint_t nfoids);
 
 static int
 zil_bp_compare(const void *x1, const void *x2)
@@ -360,6 +366,10 @@ zil_sums_init(zil_sums_t *zs)
 {
 	wmsum_init(&zs->zil_commit_count, 0);
 	wmsum_init(&zs->zil_commit_writer_count, 0);
+	wmsum_init(&zs->zil_commit_lwb_count, 0);
+	wmsum_init(&zs->zil_commit_lwb_wait_time, 0);
+	wmsum_init(&zs->zil_commit_lwb_write_time, 0);
+	wmsum_init(&zs->zil_commit_lwb_flush_time, 0);
 	wmsum_init(&zs->zil_itx_count, 0);
 	wmsum_init(&zs->zil_itx_indirect_count, 0);
 	wmsum_init(&zs->zil_itx_indirect_bytes, 0);
@@ -382,6 +392,10 @@ zil_sums_fini(zil_sums_t *zs)
 {
 	wmsum_fini(&zs->zil_commit_count);
 	wmsum_fini(&zs->zil_commit_writer_count);
+	wmsum_fini(&zs->zil_commit_lwb_count);
+	wmsum_fini(&zs->zil_commit_lwb_wait_time);
+	wmsum_fini(&zs->zil_commit_lwb_write_time);
+	wmsum_fini(&zs->zil_commit_lwb_flush_time);
 	wmsum_fini(&zs->zil_itx_count);
 	wmsum_fini(&zs->zil_itx_indirect_count);
 	wmsum_fini(&zs->zil_itx_indirect_bytes);
@@ -406,6 +420,14 @@ zil_kstat_values_update(zil_kstat_values_t *zs, zil_sums_t *zil_sums)
 	    wmsum_value(&zil_sums->zil_commit_count);
 	zs->zil_commit_writer_count.value.ui64 =
 	    wmsum_value(&zil_sums->zil_commit_writer_count);
+	zs->zil_commit_lwb_count.value.ui64 =
+	    wmsum_value(&zil_sums->zil_commit_lwb_count);
+	zs->zil_commit_lwb_wait_time.value.ui64 =
+	    wmsum_value(&zil_sums->zil_commit_lwb_wait_time);
+	zs->zil_commit_lwb_write_time.value.ui64 =
+	    wmsum_value(&zil_sums->zil_commit_lwb_write_time);
+	zs->zil_commit_lwb_flush_time.value.ui64 =
+	    wmsum_value(&zil_sums->zil_commit_lwb_flush_time);
 	zs->zil_itx_count.value.ui64 =
 	    wmsum_value(&zil_sums->zil_itx_count);
 	zs->zil_itx_indirect_count.value.ui64 =
@@ -812,6 +834,7 @@ zil_alloc_lwb(zilog_t *zilog, int sz, blkptr_t *bp, boolean_t slog,
 	lwb->lwb_write_zio = NULL;
 	lwb->lwb_root_zio = NULL;
 	lwb->lwb_issued_timestamp = 0;
+	lwb->lwb_write_done_timestamp = 0;
 	lwb->lwb_issued_txg = 0;
 	lwb->lwb_alloc_txg = txg;
 	lwb->lwb_max_txg = 0;
@@ -1424,10 +1447,13 @@ zil_lwb_flush_vdevs_done(zio_t *zio)
 	zilog_t *zilog = lwb->lwb_zilog;
 	zil_commit_waiter_t *zcw;
 	itx_t *itx;
+	uint64_t nwaiters = 0;
+	hrtime_t wait_time = 0, write_time = 0, flush_time = 0;
 
 	spa_config_exit(zilog->zl_spa, SCL_STATE, lwb);
 
-	hrtime_t t = gethrtime() - lwb->lwb_issued_timestamp;
+	hrtime_t now = gethrtime();
+	hrtime_t t = now - lwb->lwb_issued_timestamp;
 
 	mutex_enter(&zilog->zl_lock);
 
@@ -1456,6 +1482,18 @@ zil_lwb_flush_vdevs_done(zio_t *zio)
 
 		ASSERT3P(zcw->zcw_lwb, ==, lwb);
 		zcw->zcw_lwb = NULL;
+
+		/*
+		 * A waiter may be linked to an lwb that was already issued
+		 * or written, in which case it didn't wait for that phase.
+		 */
+		hrtime_t issued = MAX(lwb->lwb_issued_timestamp,
+		    zcw->zcw_start);
+		hrtime_t written = MAX(lwb->lwb_write_done_timestamp, issued);
+		wait_time += issued - zcw->zcw_start;
+		write_time += written - issued;
+		flush_time += now - written;
+		nwaiters++;
 		/*
 		 * We expect any ZIO errors from child ZIOs to have been
 		 * propagated "up" to this specific LWB's root ZIO, in
@@ -1485,6 +1523,13 @@ zil_lwb_flush_vdevs_done(zio_t *zio)
 	/* Once we drop the lock, lwb may be freed by zil_sync(). */
 	mutex_exit(&zilog->zl_lock);
 
+	if (nwaiters > 0) {
+		ZIL_STAT_INCR(zilog, zil_commit_lwb_count, nwaiters);
+		ZIL_STAT_INCR(zilog, zil_commit_lwb_wait_time, wait_time);
+		ZIL_STAT_INCR(zilog, zil_commit_lwb_write_time, write_time);
+		ZIL_STAT_INCR(zilog, zil_commit_lwb_flush_time, flush_time);
+	}
+
 	mutex_enter(&zilog->zl_lwb_io_lock);
 	ASSERT3U(zilog->zl_lwb_inflight[txg & TXG_MASK], >, 0);
 	zilog->zl_lwb_inflight[txg & TXG_MASK]--;
@@ -1560,6 +1605,7 @@ zil_lwb_write_done(zio_t *zio)
 	mutex_enter(&zilog->zl_lock);
 	ASSERT3S(lwb->lwb_state, ==, LWB_STATE_ISSUED);
 	lwb->lwb_state = LWB_STATE_WRITE_DONE;
+	lwb->lwb_write_done_timestamp = gethrtime();
 	lwb->lwb_child_zio = NULL;
 	lwb->lwb_write_zio = NULL;
 
@@ -2827,6 +2873,18 @@ zil_commit_writer_stall(zilog_t *zilog)
 	ASSERT(list_is_empty(&zilog->zl_lwb_list));
 }
 
+/*
+ * Returns B_TRUE if the last commit burst was larger than zil_slog_bulk,
+ * i.e. a single writer is streaming enough data through the log that its
+ * SLOG writes beyond zil_slog_bulk were issued at asynchronous priority.
+ * Read without a lock; it's only a hint for zfs_log_write().
+ */
+boolean_t
+zil_slog_is_bulk(zilog_t *zilog)
+{
+	return (zilog->zl_slog_bulk);
+}
+
 static void
 zil_burst_done(zilog_t *zilog)
 {
@@ -2841,6 +2899,7 @@ zil_burst_done(zilog_t *zilog)
 	zilog->zl_prev_rotor = r;
 	zilog->zl_prev_opt[r] = zil_lwb_plan(zilog, zilog->zl_cur_size,
 	    &zilog->zl_prev_min[r]);
+	zilog->zl_slog_bulk = (zilog->zl_cur_size > zil_slog_bulk);
 
 	zilog->zl_cur_size = 0;
 	zilog->zl_cur_max = 0;
@@ -3390,6 +3449,7 @@ zil_alloc_commit_waiter(void)
 	zcw->zcw_lwb = NULL;
 	zcw->zcw_done = B_FALSE;
 	zcw->zcw_zio_error = 0;
+	zcw->zcw_start = gethrtime();
 
 	return (zcw);
 }
@@ -3547,9 +3607,30 @@ zil_commit_itx_assign(zilog_t *zilog, zil_commit_waiter_t *zcw)
  *      many lwb zio's concurrently issued to the underlying storage,
  *      but the order in which they complete will be the same order in
  *      which they were created.
+ *
+ *      Note the single chain doesn't limit the queue depth used on the
+ *      log device.  Each lwb's successor block is allocated before the
+ *      lwb is issued, so the chain pointers are known up front and the
+ *      lwb writes don't wait for one another; only their completion
+ *      (and with it the commit waiters) is ordered.  Splitting a
+ *      dataset's log into several independent chains would instead
+ *      require a new on-disk format, with replay merging the chains by
+ *      sequence number, for little gain in device parallelism.
  */
 void
 zil_commit(zilog_t *zilog, uint64_t foid)
+{
+	zil_commit_objects(zilog, &foid, 1);
+}
+
+/*
+ * Like zil_commit(), but for several objects at once: the itxs of all of
+ * them are moved to the sync lists before a single commit itx is assigned,
+ * so they are written out in one chain of lwbs and waited for together,
+ * rather than paying for a separate lwb write and flush per object.
+ */
+void
+zil_commit_objects(zilog_t *zilog, const uint64_t *foids, uint_t nfoids)
 {
 	/*
 	 * We should never attempt to call zil_commit on a snapshot for
@@ -3596,16 +3677,22 @@ zil_commit(zilog_t *zilog, uint64_t foid)
 		return;
 	}
 
-	zil_commit_impl(zilog, foid);
+	zil_commit_objects_impl(zilog, foids, nfoids);
 }
 
 void
 zil_commit_impl(zilog_t *zilog, uint64_t foid)
+{
+	zil_commit_objects_impl(zilog, &foid, 1);
+}
+
+static void
+zil_commit_objects_impl(zilog_t *zilog, const uint64_t *foids, uint_t nfoids)
 {
 	ZIL_STAT_BUMP(zilog, zil_commit_count);
 
 	/*
-	 * Move the "async" itxs for the specified foid to the "sync"
+	 * Move the "async" itxs for the specified foids to the "sync"
 	 * queues, such that they will be later committed (or skipped)
 	 * to an lwb when zil_process_commit_list() is called.
 	 *
@@ -3613,7 +3700,8 @@ zil_commit_impl(zilog_t *zilog, uint64_t foid)
 	 * call to zil_commit returning, we must perform this operation
 	 * before we call zil_commit_itx_assign().
 	 */
-	zil_async_to_sync(zilog, foid);
+	for (uint_t i = 0; i < nfoids; i++)
+		zil_async_to_sync(zilog, foids[i]);
 
 	/*
 	 * We allocate a new "waiter" structure which will initially be
@@ -4266,6 +4354,14 @@ zil_incr_blks(zilog_t *zilog, const blkptr_t *bp, void *arg, uint64_t claim_txg)
 /*
  * If this dataset has a non-empty intent log, replay it and destroy it.
  * Return B_TRUE if there were any entries to replay.
+ *
+ * Records are replayed strictly in sequence.  zh_replay_seq records the
+ * last replayed record so an interrupted replay can resume, which only
+ * works if every record before it has been applied, and many records
+ * (create, link, rename, remove) touch a directory and another object,
+ * so they aren't independent per object either.  Datasets are replayed
+ * in parallel as they are mounted, since "zfs mount -a" mounts
+ * independent filesystems from a thread pool.
  */
 boolean_t
 zil_replay(objset_t *os, void *arg,
@@ -4345,6 +4441,7 @@ EXPORT_SYMBOL(zil_itx_create);
 EXPORT_SYMBOL(zil_itx_destroy);
 EXPORT_SYMBOL(zil_itx_assign);
 EXPORT_SYMBOL(zil_commit);
+EXPORT_SYMBOL(zil_commit_objects);
 EXPORT_SYMBOL(zil_claim);
 EXPORT_SYMBOL(zil_check_log_chain);
 EXPORT_SYMBOL(zil_sync);
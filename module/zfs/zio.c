@@ -39,6 +39,7 @@
 #include <sys/zio_impl.h>
 #include <sys/zio_compress.h>
 #include <sys/zio_checksum.h>
+#include <sys/zio_accel.h>
 #include <sys/dmu_objset.h>
 #include <sys/arc.h>
 #include <sys/brt.h>
@@ -51,6 +52,7 @@
 #include <sys/trace_zfs.h>
 #include <sys/abd.h>
 #include <sys/dsl_crypt.h>
+#include <sys/wmsum.h>
 #include <cityhash.h>
 
 /*
@@ -76,6 +78,26 @@ static int zio_deadman_log_all = B_FALSE;
  */
 static kmem_cache_t *zio_cache;
 static kmem_cache_t *zio_link_cache;
+#ifndef _KERNEL
+static taskq_t *zio_delay_taskq;	/* see zio_delay_interrupt() */
+#endif
+
+/*
+ * Small per-CPU stashes of free zio_t and zio_link_t objects in front of
+ * their kmem caches. Objects in a magazine keep their constructed state, so
+ * a zio allocated from one skips the lock, cv and list setup entirely.
+ */
+#define	ZIO_MAG_ROUNDS	16
+
+typedef struct zio_mag {
+	kmutex_t	zm_lock;
+	uint_t		zm_rounds;
+	void		*zm_objs[ZIO_MAG_ROUNDS];
+} ____cacheline_aligned zio_mag_t;
+
+static zio_mag_t *zio_mags;
+static zio_mag_t *zio_link_mags;
+static uint_t zio_mag_count;
 kmem_cache_t *zio_buf_cache[SPA_MAXBLOCKSIZE >> SPA_MINBLOCKSHIFT];
 kmem_cache_t *zio_data_buf_cache[SPA_MAXBLOCKSIZE >> SPA_MINBLOCKSHIFT];
 #if defined(ZFS_DEBUG) && !defined(_KERNEL)
@@ -83,6 +105,69 @@ static uint64_t zio_buf_cache_allocs[SPA_MAXBLOCKSIZE >> SPA_MINBLOCKSHIFT];
 static uint64_t zio_buf_cache_frees[SPA_MAXBLOCKSIZE >> SPA_MINBLOCKSHIFT];
 #endif
 
+/*
+ * Record how long zios spend in each pipeline stage, per pool, in
+ * /proc/spl/kstat/zfs/<pool>/zio_stages.
+ */
+static int zio_stage_histogram = B_FALSE;
+
+/*
+ * While a write issue thread runs a batch of zios (see
+ * spa_taskq_batch_execute()), zios from the batch whose checksum can hash
+ * several buffers at once are parked at the checksum stage, then
+ * checksummed together and resumed when the batch ends.
+ */
+static int zio_checksum_batch = B_TRUE;
+static uint_t zio_checksum_batch_key;
+
+/*
+ * Take the fletcher4 checksum of a compressed write in the compress stage,
+ * while the compressed data is still in cache, instead of in the checksum
+ * stage. lz4 checksums its output as it writes it.
+ */
+static int zio_compress_cksum = B_TRUE;
+
+/*
+ * A level 0 block no larger than this which compresses to just over
+ * BPE_PAYLOAD_SIZE with its own algorithm is compressed again with gzip-9,
+ * and embedded in its block pointer if that makes it fit. Small files then
+ * live in their dnode and need neither an allocation nor a second read,
+ * and as the embedded block pointer records its own compression algorithm
+ * nothing new is needed on disk to read them back. 0 disables this.
+ */
+static uint_t zio_embed_retry_max = 1024;
+
+/*
+ * Run gzip and zstd compression of async writes on a separate taskq,
+ * rather than in the write issue taskq that dispatched them, so expensive
+ * compression can use every CPU without holding up the issue threads. The
+ * taskq is created with zio_compress_taskq_pct percent of the CPUs as its
+ * maximum thread count, at a lower priority than the zio taskqs.
+ */
+static int zio_compress_offload = B_FALSE;
+static uint_t zio_compress_taskq_pct = 100;
+static taskq_t *zio_compress_tq;
+
+typedef struct zio_compress_stats {
+	kstat_named_t zcs_offloaded;
+	kstat_named_t zcs_offloaded_bytes;
+	kstat_named_t zcs_sync_inline;
+} zio_compress_stats_t;
+
+static zio_compress_stats_t zio_compress_stats = {
+	{ "offloaded",			KSTAT_DATA_UINT64 },
+	{ "offloaded_bytes",		KSTAT_DATA_UINT64 },
+	{ "sync_inline",		KSTAT_DATA_UINT64 },
+};
+
+static struct {
+	wmsum_t zcs_offloaded;
+	wmsum_t zcs_offloaded_bytes;
+	wmsum_t zcs_sync_inline;
+} zio_compress_sums;
+
+static kstat_t *zio_compress_ksp;
+
 /* Mark IOs as "slow" if they take longer than 30 seconds */
 static uint_t zio_slow_io_ms = (30 * MILLISEC);
 
@@ -148,15 +233,165 @@ static inline void __zio_execute(zio_t *zio);
 
 static void zio_taskq_dispatch(zio_t *, zio_taskq_type_t, boolean_t);
 
+/*
+ * The zio lock, cv and link lists are set up when an object enters the
+ * cache and are left intact by zio_destroy(), so zio_create() only has to
+ * clear the fields that precede them.
+ */
+static int
+zio_cons(void *arg, void *unused, int kmflag)
+{
+	(void) unused, (void) kmflag;
+	zio_t *zio = arg;
+	memset(zio, 0, sizeof (zio_t));
+
+	mutex_init(&zio->io_lock, NULL, MUTEX_NOLOCKDEP, NULL);
+	cv_init(&zio->io_cv, NULL, CV_DEFAULT, NULL);
+	list_create(&zio->io_parent_list, sizeof (zio_link_t),
+	    offsetof(zio_link_t, zl_parent_node));
+	list_create(&zio->io_child_list, sizeof (zio_link_t),
+	    offsetof(zio_link_t, zl_child_node));
+
+	return (0);
+}
+
+static void
+zio_dest(void *arg, void *unused)
+{
+	(void) unused;
+	zio_t *zio = arg;
+
+	list_destroy(&zio->io_parent_list);
+	list_destroy(&zio->io_child_list);
+	mutex_destroy(&zio->io_lock);
+	cv_destroy(&zio->io_cv);
+}
+
+static int
+zio_compress_kstats_update(kstat_t *ksp, int rw)
+{
+	zio_compress_stats_t *zcs = ksp->ks_data;
+
+	if (rw == KSTAT_WRITE)
+		return (EACCES);
+
+	zcs->zcs_offloaded.value.ui64 =
+	    wmsum_value(&zio_compress_sums.zcs_offloaded);
+	zcs->zcs_offloaded_bytes.value.ui64 =
+	    wmsum_value(&zio_compress_sums.zcs_offloaded_bytes);
+	zcs->zcs_sync_inline.value.ui64 =
+	    wmsum_value(&zio_compress_sums.zcs_sync_inline);
+
+	return (0);
+}
+
+static void
+zio_compress_taskq_init(void)
+{
+	zio_compress_tq = taskq_create("z_wr_cmp",
+	    MAX(1, MIN(zio_compress_taskq_pct, 100)), defclsyspri, 1,
+	    INT_MAX, TASKQ_DYNAMIC | TASKQ_THREADS_CPU_PCT);
+
+	wmsum_init(&zio_compress_sums.zcs_offloaded, 0);
+	wmsum_init(&zio_compress_sums.zcs_offloaded_bytes, 0);
+	wmsum_init(&zio_compress_sums.zcs_sync_inline, 0);
+
+	zio_compress_ksp = kstat_create("zfs", 0, "zio_compress", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (zio_compress_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (zio_compress_ksp != NULL) {
+		zio_compress_ksp->ks_data = &zio_compress_stats;
+		zio_compress_ksp->ks_update = zio_compress_kstats_update;
+		kstat_install(zio_compress_ksp);
+	}
+}
+
+static void
+zio_compress_taskq_fini(void)
+{
+	if (zio_compress_ksp != NULL) {
+		kstat_delete(zio_compress_ksp);
+		zio_compress_ksp = NULL;
+	}
+
+	wmsum_fini(&zio_compress_sums.zcs_offloaded);
+	wmsum_fini(&zio_compress_sums.zcs_offloaded_bytes);
+	wmsum_fini(&zio_compress_sums.zcs_sync_inline);
+
+	taskq_destroy(zio_compress_tq);
+	zio_compress_tq = NULL;
+}
+
+static zio_mag_t *
+zio_mags_create(void)
+{
+	zio_mag_t *mags = kmem_zalloc(zio_mag_count * sizeof (zio_mag_t),
+	    KM_SLEEP);
+	for (uint_t i = 0; i < zio_mag_count; i++)
+		mutex_init(&mags[i].zm_lock, NULL, MUTEX_DEFAULT, NULL);
+	return (mags);
+}
+
+static void
+zio_mags_destroy(zio_mag_t *mags, kmem_cache_t *cache)
+{
+	for (uint_t i = 0; i < zio_mag_count; i++) {
+		zio_mag_t *zm = &mags[i];
+		while (zm->zm_rounds > 0)
+			kmem_cache_free(cache, zm->zm_objs[--zm->zm_rounds]);
+		mutex_destroy(&zm->zm_lock);
+	}
+	kmem_free(mags, zio_mag_count * sizeof (zio_mag_t));
+}
+
+static void *
+zio_mag_alloc(zio_mag_t *mags, kmem_cache_t *cache)
+{
+	zio_mag_t *zm = &mags[CPU_SEQID_UNSTABLE % zio_mag_count];
+	void *obj = NULL;
+
+	mutex_enter(&zm->zm_lock);
+	if (zm->zm_rounds > 0)
+		obj = zm->zm_objs[--zm->zm_rounds];
+	mutex_exit(&zm->zm_lock);
+
+	if (obj == NULL)
+		obj = kmem_cache_alloc(cache, KM_SLEEP);
+	return (obj);
+}
+
+static void
+zio_mag_free(zio_mag_t *mags, kmem_cache_t *cache, void *obj)
+{
+	zio_mag_t *zm = &mags[CPU_SEQID_UNSTABLE % zio_mag_count];
+
+	mutex_enter(&zm->zm_lock);
+	if (zm->zm_rounds < ZIO_MAG_ROUNDS) {
+		zm->zm_objs[zm->zm_rounds++] = obj;
+		obj = NULL;
+	}
+	mutex_exit(&zm->zm_lock);
+
+	if (obj != NULL)
+		kmem_cache_free(cache, obj);
+}
+
+static void zio_gang_cache_init(void);
+static void zio_gang_cache_fini(void);
+
 void
 zio_init(void)
 {
 	size_t c;
 
 	zio_cache = kmem_cache_create("zio_cache",
-	    sizeof (zio_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
+	    sizeof (zio_t), 0, zio_cons, zio_dest, NULL, NULL, NULL, 0);
 	zio_link_cache = kmem_cache_create("zio_link_cache",
 	    sizeof (zio_link_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
+	zio_mag_count = MAX(max_ncpus, 1);
+	zio_mags = zio_mags_create();
+	zio_link_mags = zio_mags_create();
+	zio_gang_cache_init();
 
 	for (c = 0; c < SPA_MAXBLOCKSIZE >> SPA_MINBLOCKSHIFT; c++) {
 		size_t size = (c + 1) << SPA_MINBLOCKSHIFT;
@@ -228,6 +463,13 @@ zio_init(void)
 	}
 
 	zio_inject_init();
+	zio_compress_taskq_init();
+	zio_accel_init();
+	tsd_create(&zio_checksum_batch_key, NULL);
+#ifndef _KERNEL
+	zio_delay_taskq = taskq_create("z_delay", 64, minclsyspri, 64,
+	    INT_MAX, TASKQ_PREPOPULATE);
+#endif
 
 	lz4_init();
 }
@@ -281,9 +523,18 @@ zio_fini(void)
 		VERIFY3P(zio_data_buf_cache[i], ==, NULL);
 	}
 
+	zio_gang_cache_fini();
+	zio_mags_destroy(zio_link_mags, zio_link_cache);
+	zio_mags_destroy(zio_mags, zio_cache);
 	kmem_cache_destroy(zio_link_cache);
 	kmem_cache_destroy(zio_cache);
 
+#ifndef _KERNEL
+	taskq_destroy(zio_delay_taskq);
+#endif
+	tsd_destroy(&zio_checksum_batch_key);
+	zio_accel_fini();
+	zio_compress_taskq_fini();
 	zio_inject_fini();
 
 	lz4_fini();
@@ -681,7 +932,7 @@ zio_add_child(zio_t *pio, zio_t *cio)
 	    (cio->io_child_type != ZIO_CHILD_VDEV),
 	    (pio->io_pipeline & ZIO_STAGE_READY) == 0);
 
-	zio_link_t *zl = kmem_cache_alloc(zio_link_cache, KM_SLEEP);
+	zio_link_t *zl = zio_mag_alloc(zio_link_mags, zio_link_cache);
 	zl->zl_parent = pio;
 	zl->zl_child = cio;
 
@@ -691,8 +942,10 @@ zio_add_child(zio_t *pio, zio_t *cio)
 	ASSERT(pio->io_state[ZIO_WAIT_DONE] == 0);
 
 	uint64_t *countp = pio->io_children[cio->io_child_type];
-	for (int w = 0; w < ZIO_WAIT_TYPES; w++)
-		countp[w] += !cio->io_state[w];
+	for (int w = 0; w < ZIO_WAIT_TYPES; w++) {
+		if (!cio->io_state[w])
+			atomic_inc_64(&countp[w]);
+	}
 
 	list_insert_head(&pio->io_child_list, zl);
 	list_insert_head(&cio->io_parent_list, zl);
@@ -717,7 +970,7 @@ zio_add_child_first(zio_t *pio, zio_t *cio)
 	    (cio->io_child_type != ZIO_CHILD_VDEV),
 	    (pio->io_pipeline & ZIO_STAGE_READY) == 0);
 
-	zio_link_t *zl = kmem_cache_alloc(zio_link_cache, KM_SLEEP);
+	zio_link_t *zl = zio_mag_alloc(zio_link_mags, zio_link_cache);
 	zl->zl_parent = pio;
 	zl->zl_child = cio;
 
@@ -729,8 +982,10 @@ zio_add_child_first(zio_t *pio, zio_t *cio)
 	ASSERT(pio->io_state[ZIO_WAIT_DONE] == 0);
 
 	uint64_t *countp = pio->io_children[cio->io_child_type];
-	for (int w = 0; w < ZIO_WAIT_TYPES; w++)
-		countp[w] += !cio->io_state[w];
+	for (int w = 0; w < ZIO_WAIT_TYPES; w++) {
+		if (!cio->io_state[w])
+			atomic_inc_64(&countp[w]);
+	}
 
 	list_insert_head(&pio->io_child_list, zl);
 
@@ -751,7 +1006,7 @@ zio_remove_child(zio_t *pio, zio_t *cio, zio_link_t *zl)
 
 	mutex_exit(&cio->io_lock);
 	mutex_exit(&pio->io_lock);
-	kmem_cache_free(zio_link_cache, zl);
+	zio_mag_free(zio_link_mags, zio_link_cache, zl);
 }
 
 static boolean_t
@@ -766,7 +1021,7 @@ zio_wait_for_children(zio_t *zio, uint8_t childbits, enum zio_wait_type wait)
 			continue;
 
 		uint64_t *countp = &zio->io_children[c][wait];
-		if (*countp != 0) {
+		if (atomic_load_64(countp) != 0) {
 			zio->io_stage >>= 1;
 			ASSERT3U(zio->io_stage, !=, ZIO_STAGE_OPEN);
 			zio->io_stall = countp;
@@ -785,16 +1040,36 @@ zio_notify_parent(zio_t *pio, zio_t *zio, enum zio_wait_type wait,
 {
 	uint64_t *countp = &pio->io_children[zio->io_child_type][wait];
 	int *errorp = &pio->io_child_error[zio->io_child_type];
+	boolean_t propagate_error = zio->io_error &&
+	    !(zio->io_flags & ZIO_FLAG_DONT_PROPAGATE);
+	uint64_t left;
 
-	mutex_enter(&pio->io_lock);
-	if (zio->io_error && !(zio->io_flags & ZIO_FLAG_DONT_PROPAGATE))
-		*errorp = zio_worst_error(*errorp, zio->io_error);
-	pio->io_reexecute |= zio->io_reexecute;
-	ASSERT3U(*countp, >, 0);
-
-	(*countp)--;
+	/*
+	 * The child counts are atomic, so that a child with no error or
+	 * reexecute state to hand up only takes the parent's io_lock if it
+	 * was the last one outstanding. zio_wait_for_children() records a
+	 * stall and checks the count under io_lock, so a count reaching
+	 * zero outside the lock is always seen by one side or the other.
+	 * The count is checked again under the lock in case a new child
+	 * was added in the meantime.
+	 */
+	if (!propagate_error && zio->io_reexecute == 0) {
+		left = atomic_dec_64_nv(countp);
+		ASSERT3U(left, !=, UINT64_MAX);
+		if (left != 0)
+			return;
+		mutex_enter(&pio->io_lock);
+	} else {
+		mutex_enter(&pio->io_lock);
+		if (propagate_error)
+			*errorp = zio_worst_error(*errorp, zio->io_error);
+		pio->io_reexecute |= zio->io_reexecute;
+		left = atomic_dec_64_nv(countp);
+		ASSERT3U(left, !=, UINT64_MAX);
+	}
 
-	if (*countp == 0 && pio->io_stall == countp) {
+	if (left == 0 && atomic_load_64(countp) == 0 &&
+	    pio->io_stall == countp) {
 		zio_taskq_type_t type =
 		    pio->io_stage < ZIO_STAGE_VDEV_IO_START ? ZIO_TASKQ_ISSUE :
 		    ZIO_TASKQ_INTERRUPT;
@@ -903,16 +1178,11 @@ zio_create(zio_t *pio, spa_t *spa, uint64_t txg, const blkptr_t *bp,
 
 	IMPLY(lsize != psize, (flags & ZIO_FLAG_RAW_COMPRESS) != 0);
 
-	zio = kmem_cache_alloc(zio_cache, KM_SLEEP);
-	memset(zio, 0, sizeof (zio_t));
-
-	mutex_init(&zio->io_lock, NULL, MUTEX_NOLOCKDEP, NULL);
-	cv_init(&zio->io_cv, NULL, CV_DEFAULT, NULL);
+	zio = zio_mag_alloc(zio_mags, zio_cache);
+	memset(zio, 0, offsetof(zio_t, io_lock));
+	ASSERT(list_is_empty(&zio->io_parent_list));
+	ASSERT(list_is_empty(&zio->io_child_list));
 
-	list_create(&zio->io_parent_list, sizeof (zio_link_t),
-	    offsetof(zio_link_t, zl_parent_node));
-	list_create(&zio->io_child_list, sizeof (zio_link_t),
-	    offsetof(zio_link_t, zl_child_node));
 	metaslab_trace_init(&zio->io_alloc_list);
 
 	if (vd != NULL)
@@ -973,19 +1243,35 @@ zio_create(zio_t *pio, spa_t *spa, uint64_t txg, const blkptr_t *bp,
 	}
 
 	taskq_init_ent(&zio->io_tqent);
+	list_link_init(&zio->io_batch_node);
 
 	return (zio);
 }
 
+/*
+ * Charge the time since the zio entered its current stage to that stage.
+ */
+static void
+zio_stage_histogram_update(zio_t *zio)
+{
+	hrtime_t now = gethrtime();
+
+	if (zio->io_stage_timestamp != 0) {
+		spa_zio_stage_add_nsecs(zio->io_spa, zio->io_stage,
+		    now - zio->io_stage_timestamp);
+	}
+	zio->io_stage_timestamp = now;
+}
+
 void
 zio_destroy(zio_t *zio)
 {
+	if (zio_stage_histogram && zio->io_stage == ZIO_STAGE_DONE)
+		zio_stage_histogram_update(zio);
 	metaslab_trace_fini(&zio->io_alloc_list);
-	list_destroy(&zio->io_parent_list);
-	list_destroy(&zio->io_child_list);
-	mutex_destroy(&zio->io_lock);
-	cv_destroy(&zio->io_cv);
-	kmem_cache_free(zio_cache, zio);
+	ASSERT(list_is_empty(&zio->io_parent_list));
+	ASSERT(list_is_empty(&zio->io_child_list));
+	zio_mag_free(zio_mags, zio_cache, zio);
 }
 
 /*
@@ -1382,6 +1668,18 @@ zio_free(spa_t *spa, uint64_t txg, const blkptr_t *bp)
 zio_t *
 zio_free_sync(zio_t *pio, spa_t *spa, uint64_t txg, const blkptr_t *bp,
     zio_flag_t flags)
+{
+	return (zio_free_sync_batch(pio, spa, txg, bp, flags, NULL));
+}
+
+/*
+ * As zio_free_sync(), but if mfb isn't NULL a block which can be freed
+ * immediately is added to that free batch instead, to be applied to its
+ * metaslab together with the blocks around it when the batch is flushed.
+ */
+zio_t *
+zio_free_sync_batch(zio_t *pio, spa_t *spa, uint64_t txg, const blkptr_t *bp,
+    zio_flag_t flags, metaslab_free_batch_t *mfb)
 {
 	ASSERT(!BP_IS_HOLE(bp));
 	ASSERT(spa_syncing_txg(spa) == txg);
@@ -1408,6 +1706,9 @@ zio_free_sync(zio_t *pio, spa_t *spa, uint64_t txg, const blkptr_t *bp,
 		    BP_GET_PSIZE(bp), NULL, NULL,
 		    ZIO_TYPE_FREE, ZIO_PRIORITY_NOW,
 		    flags, NULL, 0, NULL, ZIO_STAGE_OPEN, stage));
+	} else if (mfb != NULL) {
+		metaslab_free_batch_add(mfb, bp);
+		return (NULL);
 	} else {
 		metaslab_free(spa, bp, txg, B_FALSE);
 		return (NULL);
@@ -1629,7 +1930,7 @@ zio_flush(zio_t *pio, vdev_t *vd)
 	const zio_flag_t flags = ZIO_FLAG_CANFAIL | ZIO_FLAG_DONT_PROPAGATE |
 	    ZIO_FLAG_DONT_RETRY;
 
-	if (vd->vdev_nowritecache)
+	if (vd->vdev_nowritecache || vd->vdev_nonvolatile_cache)
 		return;
 
 	if (vd->vdev_children == 0) {
@@ -1785,6 +2086,42 @@ zio_write_bp_init(zio_t *zio)
 	return (zio);
 }
 
+/*
+ * Hand an expensive compression off to the compression taskq, repeating
+ * this pipeline stage there. Sync writes are always compressed in place,
+ * so that a backlog of bulk compression can't delay them.
+ */
+static boolean_t
+zio_compress_offload_dispatch(zio_t *zio, enum zio_compress compress)
+{
+	if (!zio_compress_offload ||
+	    (zio->io_flags & ZIO_FLAG_RAW_COMPRESS) ||
+	    (compress != ZIO_COMPRESS_ZSTD &&
+	    (compress < ZIO_COMPRESS_GZIP_1 || compress > ZIO_COMPRESS_GZIP_9)))
+		return (B_FALSE);
+
+	if (zio->io_priority == ZIO_PRIORITY_SYNC_WRITE) {
+		wmsum_add(&zio_compress_sums.zcs_sync_inline, 1);
+		return (B_FALSE);
+	}
+
+	/*
+	 * Pool initialization outside the zio taskqs gets sent back to the
+	 * issue taskq by zio_execute_stack_check(), so keep it there.
+	 */
+	if (taskq_member(zio_compress_tq, curthread) ||
+	    spa_is_initializing(zio->io_spa))
+		return (B_FALSE);
+
+	wmsum_add(&zio_compress_sums.zcs_offloaded, 1);
+	wmsum_add(&zio_compress_sums.zcs_offloaded_bytes, zio->io_lsize);
+
+	zio->io_stage >>= 1;
+	taskq_dispatch_ent(zio_compress_tq, zio_execute, zio, 0,
+	    &zio->io_tqent);
+	return (B_TRUE);
+}
+
 static zio_t *
 zio_write_compress(zio_t *zio)
 {
@@ -1795,6 +2132,9 @@ zio_write_compress(zio_t *zio)
 	uint64_t lsize = zio->io_lsize;
 	uint64_t psize = zio->io_size;
 	uint32_t pass = 1;
+	zio_compress_cksum_t zcc;
+	zio_cksum_t cksum;
+	boolean_t have_cksum = B_FALSE;
 
 	/*
 	 * If our children haven't all reached the ready stage,
@@ -1808,6 +2148,9 @@ zio_write_compress(zio_t *zio)
 	if (!IO_IS_ALLOCATING(zio))
 		return (zio);
 
+	if (zio_compress_offload_dispatch(zio, compress))
+		return (NULL);
+
 	if (zio->io_children_ready != NULL) {
 		/*
 		 * Now that all our children are ready, run the callback
@@ -1850,18 +2193,54 @@ zio_write_compress(zio_t *zio)
 	if (compress != ZIO_COMPRESS_OFF &&
 	    !(zio->io_flags & ZIO_FLAG_RAW_COMPRESS)) {
 		void *cbuf = NULL;
-		psize = zio_compress_data(compress, zio->io_abd, &cbuf, lsize,
-		    zp->zp_complevel);
+		/*
+		 * Dedup needs the checksum before the write is issued, and
+		 * encryption changes the data after this stage, so only
+		 * plain fletcher4 writes are checksummed here.
+		 */
+		boolean_t want_cksum = zio_compress_cksum &&
+		    zp->zp_checksum == ZIO_CHECKSUM_FLETCHER_4 &&
+		    !zp->zp_dedup && !zp->zp_encrypt;
+
+		memset(&zcc, 0, sizeof (zcc));
+		if (compress == ZIO_COMPRESS_ZSTD &&
+		    zp->zp_complevel == ZIO_ZSTD_LEVEL_AUTO) {
+			psize = zio_compress_auto(spa, &zio->io_bookmark,
+			    zio->io_abd, &cbuf, lsize, &compress,
+			    &zp->zp_complevel);
+		} else if (want_cksum) {
+			psize = zio_compress_data_cksum(compress, zio->io_abd,
+			    &cbuf, lsize, zp->zp_complevel, &zcc);
+		} else {
+			psize = zio_compress_data(compress, zio->io_abd, &cbuf,
+			    lsize, zp->zp_complevel);
+		}
+		boolean_t can_embed = !zp->zp_dedup && !zp->zp_encrypt &&
+		    zp->zp_level == 0 && !DMU_OT_HAS_FILL(zp->zp_type) &&
+		    spa_feature_is_enabled(spa, SPA_FEATURE_EMBEDDED_DATA);
+		if (can_embed && psize > BPE_PAYLOAD_SIZE &&
+		    lsize <= zio_embed_retry_max &&
+		    compress != ZIO_COMPRESS_GZIP_9) {
+			void *ebuf = NULL;
+			size_t epsize = zio_compress_data(ZIO_COMPRESS_GZIP_9,
+			    zio->io_abd, &ebuf, lsize, ZIO_COMPLEVEL_DEFAULT);
+			if (epsize != 0 && epsize <= BPE_PAYLOAD_SIZE) {
+				if (cbuf != NULL)
+					zio_buf_free(cbuf, lsize);
+				cbuf = ebuf;
+				psize = epsize;
+				compress = ZIO_COMPRESS_GZIP_9;
+			} else if (ebuf != NULL) {
+				zio_buf_free(ebuf, lsize);
+			}
+		}
 		if (psize == 0) {
 			compress = ZIO_COMPRESS_OFF;
 		} else if (psize >= lsize) {
 			compress = ZIO_COMPRESS_OFF;
 			if (cbuf != NULL)
 				zio_buf_free(cbuf, lsize);
-		} else if (!zp->zp_dedup && !zp->zp_encrypt &&
-		    psize <= BPE_PAYLOAD_SIZE &&
-		    zp->zp_level == 0 && !DMU_OT_HAS_FILL(zp->zp_type) &&
-		    spa_feature_is_enabled(spa, SPA_FEATURE_EMBEDDED_DATA)) {
+		} else if (can_embed && psize <= BPE_PAYLOAD_SIZE) {
 			encode_embedded_bp_compressed(bp,
 			    cbuf, compress, lsize, psize);
 			BPE_SET_ETYPE(bp, BP_EMBEDDED_TYPE_DATA);
@@ -1895,6 +2274,11 @@ zio_write_compress(zio_t *zio)
 				psize = rounded;
 				zio_push_transform(zio, cdata,
 				    psize, lsize, NULL);
+				if (want_cksum) {
+					zio_compress_cksum_finish(&zcc, cbuf,
+					    psize, &cksum);
+					have_cksum = B_TRUE;
+				}
 			}
 		}
 
@@ -1993,6 +2377,10 @@ zio_write_compress(zio_t *zio)
 			ASSERT(!(zio->io_flags & ZIO_FLAG_IO_REWRITE));
 			zio->io_pipeline |= ZIO_STAGE_NOP_WRITE;
 		}
+		if (have_cksum) {
+			bp->blk_cksum = cksum;
+			zio->io_pipeline &= ~ZIO_STAGE_CHECKSUM_GENERATE;
+		}
 	}
 	return (zio);
 }
@@ -2087,16 +2475,36 @@ zio_interrupt(void *zio)
 	zio_taskq_dispatch(zio, ZIO_TASKQ_INTERRUPT, B_FALSE);
 }
 
+#ifndef _KERNEL
+static void
+zio_delay_task(void *arg)
+{
+	zio_t *zio = arg;
+	hrtime_t diff = zio->io_target_timestamp - gethrtime();
+
+	if (diff > 0)
+		zfs_sleep_until(zio->io_target_timestamp);
+	zio_interrupt(zio);
+}
+#endif
+
 void
 zio_delay_interrupt(zio_t *zio)
 {
 	/*
-	 * The timeout_generic() function isn't defined in userspace, so
-	 * rather than trying to implement the function, the zio delay
-	 * functionality has been disabled for userspace builds.
+	 * The timeout_generic() function isn't defined in userspace, and
+	 * neither is taskq_dispatch_delay(), so there a delayed zio waits
+	 * out its delay in one of the z_delay taskq threads instead.  With
+	 * more delayed zios outstanding than threads, the excess ones will
+	 * complete late.
 	 */
 
-#ifdef _KERNEL
+#ifndef _KERNEL
+	if (zio->io_target_timestamp > gethrtime() &&
+	    taskq_dispatch(zio_delay_taskq, zio_delay_task, zio,
+	    TQ_NOSLEEP) != TASKQID_INVALID)
+		return;
+#else
 	/*
 	 * If io_target_timestamp is zero, then no delay has been registered
 	 * for this IO, thus jump to the end of this function and "skip" the
@@ -2348,6 +2756,9 @@ __zio_execute(zio_t *zio)
 			return;
 		}
 
+		if (zio_stage_histogram)
+			zio_stage_histogram_update(zio);
+
 		zio->io_stage = stage;
 		zio->io_pipeline_trace |= zio->io_stage;
 
@@ -2483,8 +2894,10 @@ zio_reexecute(void *arg)
 	zio_link_t *zl = NULL;
 	while ((gio = zio_walk_parents(pio, &zl)) != NULL) {
 		for (int w = 0; w < ZIO_WAIT_TYPES; w++) {
-			gio->io_children[pio->io_child_type][w] +=
-			    !pio->io_state[w];
+			if (!pio->io_state[w]) {
+				atomic_inc_64(
+				    &gio->io_children[pio->io_child_type][w]);
+			}
 		}
 	}
 	for (int c = 0; c < ZIO_CHILD_TYPES; c++)
@@ -2752,8 +3165,147 @@ static zio_gang_issue_func_t *zio_gang_issue_func[ZIO_TYPES] = {
 	NULL
 };
 
+static void zio_gang_tree_assemble(zio_t *gio, blkptr_t *bp,
+    zio_gang_node_t **gnpp);
 static void zio_gang_tree_assemble_done(zio_t *zio);
 
+/*
+ * Gang headers are read from disk whenever the block they describe is
+ * read, claimed or freed without the ARC's help, which puts a dependent
+ * I/O ahead of all the others for the block.  On a fragmented pool that
+ * has had to gang a lot, that adds up, so keep the most recently used
+ * headers around.  A header never changes, and a DVA can only be reused
+ * by a later txg, so entries are keyed by the pool, the header's first
+ * DVA and its birth txg and never need invalidating; they just age out.
+ */
+typedef struct zio_gang_cache_ent {
+	avl_node_t	zgce_avl;
+	list_node_t	zgce_lru;
+	uint64_t	zgce_guid;
+	uint64_t	zgce_vdev;
+	uint64_t	zgce_offset;
+	uint64_t	zgce_birth;
+	zio_gbh_phys_t	zgce_gbh;
+} zio_gang_cache_ent_t;
+
+static uint_t zio_gang_cache_max = 4096;
+
+static kmutex_t zio_gang_cache_lock;
+static avl_tree_t zio_gang_cache_tree;
+static list_t zio_gang_cache_lru;	/* most recently used first */
+static uint64_t zio_gang_cache_count;
+
+static int
+zio_gang_cache_compare(const void *x1, const void *x2)
+{
+	const zio_gang_cache_ent_t *e1 = x1;
+	const zio_gang_cache_ent_t *e2 = x2;
+
+	int cmp = TREE_CMP(e1->zgce_guid, e2->zgce_guid);
+	if (likely(cmp))
+		return (cmp);
+	cmp = TREE_CMP(e1->zgce_vdev, e2->zgce_vdev);
+	if (likely(cmp))
+		return (cmp);
+	cmp = TREE_CMP(e1->zgce_offset, e2->zgce_offset);
+	if (likely(cmp))
+		return (cmp);
+	return (TREE_CMP(e1->zgce_birth, e2->zgce_birth));
+}
+
+static void
+zio_gang_cache_key(spa_t *spa, const blkptr_t *bp, zio_gang_cache_ent_t *e)
+{
+	e->zgce_guid = spa_load_guid(spa);
+	e->zgce_vdev = DVA_GET_VDEV(&bp->blk_dva[0]);
+	e->zgce_offset = DVA_GET_OFFSET(&bp->blk_dva[0]);
+	e->zgce_birth = BP_GET_BIRTH(bp);
+}
+
+static void
+zio_gang_cache_init(void)
+{
+	mutex_init(&zio_gang_cache_lock, NULL, MUTEX_DEFAULT, NULL);
+	avl_create(&zio_gang_cache_tree, zio_gang_cache_compare,
+	    sizeof (zio_gang_cache_ent_t),
+	    offsetof(zio_gang_cache_ent_t, zgce_avl));
+	list_create(&zio_gang_cache_lru, sizeof (zio_gang_cache_ent_t),
+	    offsetof(zio_gang_cache_ent_t, zgce_lru));
+	zio_gang_cache_count = 0;
+}
+
+static void
+zio_gang_cache_fini(void)
+{
+	zio_gang_cache_ent_t *e;
+
+	while ((e = list_remove_head(&zio_gang_cache_lru)) != NULL) {
+		avl_remove(&zio_gang_cache_tree, e);
+		kmem_free(e, sizeof (*e));
+	}
+	zio_gang_cache_count = 0;
+	list_destroy(&zio_gang_cache_lru);
+	avl_destroy(&zio_gang_cache_tree);
+	mutex_destroy(&zio_gang_cache_lock);
+}
+
+/*
+ * Copy the cached header for gang block 'bp' into 'gbh', if there is one.
+ */
+static boolean_t
+zio_gang_cache_lookup(spa_t *spa, const blkptr_t *bp, zio_gbh_phys_t *gbh)
+{
+	zio_gang_cache_ent_t search, *e;
+
+	if (zio_gang_cache_max == 0)
+		return (B_FALSE);
+
+	zio_gang_cache_key(spa, bp, &search);
+	mutex_enter(&zio_gang_cache_lock);
+	e = avl_find(&zio_gang_cache_tree, &search, NULL);
+	if (e != NULL) {
+		memcpy(gbh, &e->zgce_gbh, sizeof (*gbh));
+		list_remove(&zio_gang_cache_lru, e);
+		list_insert_head(&zio_gang_cache_lru, e);
+	}
+	mutex_exit(&zio_gang_cache_lock);
+
+	return (e != NULL);
+}
+
+static void
+zio_gang_cache_insert(spa_t *spa, const blkptr_t *bp,
+    const zio_gbh_phys_t *gbh)
+{
+	zio_gang_cache_ent_t *e, *old;
+	avl_index_t where;
+
+	if (zio_gang_cache_max == 0)
+		return;
+
+	e = kmem_alloc(sizeof (*e), KM_SLEEP);
+	zio_gang_cache_key(spa, bp, e);
+	memcpy(&e->zgce_gbh, gbh, sizeof (*gbh));
+
+	mutex_enter(&zio_gang_cache_lock);
+	if (avl_find(&zio_gang_cache_tree, e, &where) != NULL) {
+		mutex_exit(&zio_gang_cache_lock);
+		kmem_free(e, sizeof (*e));
+		return;
+	}
+	avl_insert(&zio_gang_cache_tree, e, where);
+	list_insert_head(&zio_gang_cache_lru, e);
+	zio_gang_cache_count++;
+
+	while (zio_gang_cache_count > zio_gang_cache_max) {
+		old = list_remove_tail(&zio_gang_cache_lru);
+		avl_remove(&zio_gang_cache_tree, old);
+		zio_gang_cache_count--;
+		kmem_free(old, sizeof (*old));
+	}
+	mutex_exit(&zio_gang_cache_lock);
+}
+
 static zio_gang_node_t *
 zio_gang_node_alloc(zio_gang_node_t **gnpp)
 {
@@ -2795,15 +3347,32 @@ zio_gang_tree_free(zio_gang_node_t **gnpp)
 	zio_gang_node_free(gnpp);
 }
 
+static void
+zio_gang_tree_assemble_children(zio_t *gio, zio_gang_node_t *gn)
+{
+	for (int g = 0; g < SPA_GBH_NBLKPTRS; g++) {
+		blkptr_t *gbp = &gn->gn_gbh->zg_blkptr[g];
+		if (!BP_IS_GANG(gbp))
+			continue;
+		zio_gang_tree_assemble(gio, gbp, &gn->gn_child[g]);
+	}
+}
+
 static void
 zio_gang_tree_assemble(zio_t *gio, blkptr_t *bp, zio_gang_node_t **gnpp)
 {
 	zio_gang_node_t *gn = zio_gang_node_alloc(gnpp);
-	abd_t *gbh_abd = abd_get_from_buf(gn->gn_gbh, SPA_GANGBLOCKSIZE);
+	abd_t *gbh_abd;
 
 	ASSERT(gio->io_gang_leader == gio);
 	ASSERT(BP_IS_GANG(bp));
 
+	if (zio_gang_cache_lookup(gio->io_spa, bp, gn->gn_gbh)) {
+		zio_gang_tree_assemble_children(gio, gn);
+		return;
+	}
+
+	gbh_abd = abd_get_from_buf(gn->gn_gbh, SPA_GANGBLOCKSIZE);
 	zio_nowait(zio_read(gio, gio->io_spa, bp, gbh_abd, SPA_GANGBLOCKSIZE,
 	    zio_gang_tree_assemble_done, gn, gio->io_priority,
 	    ZIO_GANG_CHILD_FLAGS(gio), &gio->io_bookmark));
@@ -2832,12 +3401,8 @@ zio_gang_tree_assemble_done(zio_t *zio)
 
 	abd_free(zio->io_abd);
 
-	for (int g = 0; g < SPA_GBH_NBLKPTRS; g++) {
-		blkptr_t *gbp = &gn->gn_gbh->zg_blkptr[g];
-		if (!BP_IS_GANG(gbp))
-			continue;
-		zio_gang_tree_assemble(gio, gbp, &gn->gn_child[g]);
-	}
+	zio_gang_cache_insert(zio->io_spa, bp, gn->gn_gbh);
+	zio_gang_tree_assemble_children(gio, gn);
 }
 
 static void
@@ -3337,7 +3902,7 @@ zio_ddt_read_done(zio_t *zio)
 }
 
 static boolean_t
-zio_ddt_collision(zio_t *zio, ddt_t *ddt, ddt_entry_t *dde)
+zio_ddt_collision(zio_t *zio, ddt_shard_t *dds, ddt_entry_t *dde)
 {
 	spa_t *spa = zio->io_spa;
 	boolean_t do_raw = !!(zio->io_flags & ZIO_FLAG_RAW);
@@ -3383,7 +3948,7 @@ zio_ddt_collision(zio_t *zio, ddt_t *ddt, ddt_entry_t *dde)
 			if (psize != zio->io_size)
 				return (B_TRUE);
 
-			ddt_exit(ddt);
+			ddt_shard_exit(dds);
 
 			tmpabd = abd_alloc_for_io(psize, B_TRUE);
 
@@ -3398,7 +3963,7 @@ zio_ddt_collision(zio_t *zio, ddt_t *ddt, ddt_entry_t *dde)
 			}
 
 			abd_free(tmpabd);
-			ddt_enter(ddt);
+			ddt_shard_enter(dds);
 			return (error != 0);
 		} else if (ddp->ddp_phys_birth != 0) {
 			arc_buf_t *abuf = NULL;
@@ -3411,7 +3976,7 @@ zio_ddt_collision(zio_t *zio, ddt_t *ddt, ddt_entry_t *dde)
 			if (BP_GET_LSIZE(&blk) != zio->io_orig_size)
 				return (B_TRUE);
 
-			ddt_exit(ddt);
+			ddt_shard_exit(dds);
 
 			error = arc_read(NULL, spa, &blk,
 			    arc_getbuf_func, &abuf, ZIO_PRIORITY_SYNC_READ,
@@ -3425,7 +3990,7 @@ zio_ddt_collision(zio_t *zio, ddt_t *ddt, ddt_entry_t *dde)
 				arc_buf_destroy(abuf, &abuf);
 			}
 
-			ddt_enter(ddt);
+			ddt_shard_enter(dds);
 			return (error != 0);
 		}
 	}
@@ -3439,13 +4004,14 @@ zio_ddt_child_write_ready(zio_t *zio)
 	int p = zio->io_prop.zp_copies;
 	ddt_t *ddt = ddt_select(zio->io_spa, zio->io_bp);
 	ddt_entry_t *dde = zio->io_private;
+	ddt_shard_t *dds = ddt_shard_entry(ddt, dde);
 	ddt_phys_t *ddp = &dde->dde_phys[p];
 	zio_t *pio;
 
 	if (zio->io_error)
 		return;
 
-	ddt_enter(ddt);
+	ddt_shard_enter(dds);
 
 	ASSERT(dde->dde_lead_zio[p] == zio);
 
@@ -3455,7 +4021,7 @@ zio_ddt_child_write_ready(zio_t *zio)
 	while ((pio = zio_walk_parents(zio, &zl)) != NULL)
 		ddt_bp_fill(ddp, pio->io_bp, zio->io_txg);
 
-	ddt_exit(ddt);
+	ddt_shard_exit(dds);
 }
 
 static void
@@ -3464,9 +4030,10 @@ zio_ddt_child_write_done(zio_t *zio)
 	int p = zio->io_prop.zp_copies;
 	ddt_t *ddt = ddt_select(zio->io_spa, zio->io_bp);
 	ddt_entry_t *dde = zio->io_private;
+	ddt_shard_t *dds = ddt_shard_entry(ddt, dde);
 	ddt_phys_t *ddp = &dde->dde_phys[p];
 
-	ddt_enter(ddt);
+	ddt_shard_enter(dds);
 
 	ASSERT(ddp->ddp_refcnt == 0);
 	ASSERT(dde->dde_lead_zio[p] == zio);
@@ -3480,7 +4047,7 @@ zio_ddt_child_write_done(zio_t *zio)
 		ddt_phys_clear(ddp);
 	}
 
-	ddt_exit(ddt);
+	ddt_shard_exit(dds);
 }
 
 static zio_t *
@@ -3493,6 +4060,7 @@ zio_ddt_write(zio_t *zio)
 	int p = zp->zp_copies;
 	zio_t *cio = NULL;
 	ddt_t *ddt = ddt_select(spa, bp);
+	ddt_shard_t *dds;
 	ddt_entry_t *dde;
 	ddt_phys_t *ddp;
 
@@ -3501,11 +4069,28 @@ zio_ddt_write(zio_t *zio)
 	ASSERT(BP_IS_HOLE(bp) || zio->io_bp_override);
 	ASSERT(!(zio->io_bp_override && (zio->io_flags & ZIO_FLAG_RAW)));
 
-	ddt_enter(ddt);
+	/*
+	 * If the entry has to be read from the storage objects, start the
+	 * reads now and go to the back of the issue queue, rather than block
+	 * this thread on them. Other dedup writes queued behind us get to
+	 * start their reads too, so the misses are serviced in parallel, and
+	 * by the time we come back around the lookup should be cached.
+	 */
+	if (!(zio->io_flags & ZIO_FLAG_DDT_PREFETCHED)) {
+		zio->io_flags |= ZIO_FLAG_DDT_PREFETCHED;
+		if (ddt_prefetch_lookup(ddt, bp)) {
+			zio->io_stage >>= 1;
+			zio_taskq_dispatch(zio, ZIO_TASKQ_ISSUE, B_FALSE);
+			return (NULL);
+		}
+	}
+
+	dds = ddt_shard_select(ddt, bp);
+	ddt_shard_enter(dds);
 	dde = ddt_lookup(ddt, bp, B_TRUE);
 	ddp = &dde->dde_phys[p];
 
-	if (zp->zp_dedup_verify && zio_ddt_collision(zio, ddt, dde)) {
+	if (zp->zp_dedup_verify && zio_ddt_collision(zio, dds, dde)) {
 		/*
 		 * If we're using a weak checksum, upgrade to a strong checksum
 		 * and try again.  If we're already using a strong checksum,
@@ -3524,10 +4109,31 @@ zio_ddt_write(zio_t *zio)
 		}
 		ASSERT(!BP_GET_DEDUP(bp));
 		zio->io_pipeline = ZIO_WRITE_PIPELINE;
-		ddt_exit(ddt);
+		ddt_shard_exit(dds);
 		return (zio);
 	}
 
+	/*
+	 * If this would be a brand new entry and the DDT is already at its
+	 * quota, don't add it; just do an ordinary write instead.
+	 */
+	if (!zio->io_bp_override && dde->dde_type == DDT_TYPES &&
+	    ddt_over_quota(spa)) {
+		boolean_t empty = B_TRUE;
+		for (int i = 0; i < DDT_PHYS_TYPES; i++) {
+			if (dde->dde_phys[i].ddp_phys_birth != 0 ||
+			    dde->dde_lead_zio[i] != NULL)
+				empty = B_FALSE;
+		}
+		if (empty) {
+			zp->zp_dedup = B_FALSE;
+			BP_SET_DEDUP(bp, B_FALSE);
+			zio->io_pipeline = ZIO_WRITE_PIPELINE;
+			ddt_shard_exit(dds);
+			return (zio);
+		}
+	}
+
 	if (ddp->ddp_phys_birth != 0 || dde->dde_lead_zio[p] != NULL) {
 		if (ddp->ddp_phys_birth != 0)
 			ddt_bp_fill(ddp, bp, txg);
@@ -3551,7 +4157,7 @@ zio_ddt_write(zio_t *zio)
 		dde->dde_lead_zio[p] = cio;
 	}
 
-	ddt_exit(ddt);
+	ddt_shard_exit(dds);
 
 	zio_nowait(cio);
 
@@ -3566,20 +4172,30 @@ zio_ddt_free(zio_t *zio)
 	spa_t *spa = zio->io_spa;
 	blkptr_t *bp = zio->io_bp;
 	ddt_t *ddt = ddt_select(spa, bp);
+	ddt_shard_t *dds = ddt_shard_select(ddt, bp);
 	ddt_entry_t *dde;
 	ddt_phys_t *ddp;
 
 	ASSERT(BP_GET_DEDUP(bp));
 	ASSERT(zio->io_child_type == ZIO_CHILD_LOGICAL);
 
-	ddt_enter(ddt);
+	ddt_shard_enter(dds);
 	freedde = dde = ddt_lookup(ddt, bp, B_TRUE);
 	if (dde) {
 		ddp = ddt_phys_select(dde, bp);
 		if (ddp)
 			ddt_phys_decref(ddp);
+		else
+			dde = NULL;
 	}
-	ddt_exit(ddt);
+	ddt_shard_exit(dds);
+
+	/*
+	 * No entry for this block; it was pruned from the table (see
+	 * ddt_prune_unique_entries()), so free it directly.
+	 */
+	if (dde == NULL)
+		zio->io_pipeline |= ZIO_STAGE_DVA_FREE;
 
 	return (zio);
 }
@@ -3743,6 +4359,8 @@ zio_dva_allocate(zio_t *zio)
 			    zio->io_prop.zp_copies, zio->io_allocator, zio,
 			    flags | METASLAB_MUST_RESERVE));
 		}
+		spa_iostats_special_spill_add(spa, zio->io_prop.zp_type,
+		    zio->io_prop.zp_level, zio->io_size);
 		zio->io_metaslab_class = mc = spa_normal_class(spa);
 		if (zfs_flags & ZFS_DEBUG_METASLAB_ALLOC) {
 			zfs_dbgmsg("%s: metaslab allocation failure, "
@@ -4446,6 +5064,54 @@ zio_encrypt(zio_t *zio)
  * Generate and verify checksums
  * ==========================================================================
  */
+/*
+ * Start collecting zios for batched checksumming on this thread. The caller
+ * sets zcb_current to each zio it executes; only that zio may be parked,
+ * not any other zio it happens to run along the way.
+ */
+void
+zio_checksum_batch_enter(zio_checksum_batch_t *zcb)
+{
+	zcb->zcb_current = NULL;
+	zcb->zcb_count = 0;
+	VERIFY0(tsd_set(zio_checksum_batch_key, zcb));
+}
+
+/*
+ * Checksum every zio parked since zio_checksum_batch_enter() and send it
+ * on down the pipeline.
+ */
+void
+zio_checksum_batch_exit(zio_checksum_batch_t *zcb)
+{
+	VERIFY0(tsd_set(zio_checksum_batch_key, NULL));
+
+	if (zcb->zcb_count == 0)
+		return;
+
+	zio_checksum_compute_many(zcb->zcb_zios, zcb->zcb_count);
+	for (uint_t i = 0; i < zcb->zcb_count; i++)
+		zio_execute(zcb->zcb_zios[i]);
+}
+
+static boolean_t
+zio_checksum_batch_park(zio_t *zio, enum zio_checksum checksum)
+{
+	zio_checksum_batch_t *zcb;
+
+	if (!zio_checksum_batch ||
+	    zio_checksum_table[checksum].ci_many == NULL)
+		return (B_FALSE);
+
+	zcb = tsd_get(zio_checksum_batch_key);
+	if (zcb == NULL || zcb->zcb_current != zio ||
+	    zcb->zcb_count == ZIO_CHECKSUM_MANY_MAX)
+		return (B_FALSE);
+
+	zcb->zcb_zios[zcb->zcb_count++] = zio;
+	return (B_TRUE);
+}
+
 static zio_t *
 zio_checksum_generate(zio_t *zio)
 {
@@ -4472,6 +5138,9 @@ zio_checksum_generate(zio_t *zio)
 		}
 	}
 
+	if (bp != NULL && zio_checksum_batch_park(zio, checksum))
+		return (NULL);
+
 	zio_checksum_compute(zio, checksum, zio->io_abd, zio->io_size);
 
 	return (zio);
@@ -5242,9 +5911,30 @@ EXPORT_SYMBOL(zio_data_buf_alloc);
 EXPORT_SYMBOL(zio_buf_free);
 EXPORT_SYMBOL(zio_data_buf_free);
 
+ZFS_MODULE_PARAM(zfs_zio, zio_, gang_cache_max, UINT, ZMOD_RW,
+	"Max number of gang block headers to keep cached");
+
 ZFS_MODULE_PARAM(zfs_zio, zio_, slow_io_ms, INT, ZMOD_RW,
 	"Max I/O completion time (milliseconds) before marking it as slow");
 
+ZFS_MODULE_PARAM(zfs_zio, zio_, compress_offload, INT, ZMOD_RW,
+	"Run gzip and zstd compression of async writes on a separate taskq");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, compress_taskq_pct, UINT, ZMOD_RD,
+	"Percentage of CPUs to run compression taskq threads on");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, compress_cksum, INT, ZMOD_RW,
+	"Checksum compressed fletcher4 writes while compressing them");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, embed_retry_max, UINT, ZMOD_RW,
+	"Max size of blocks recompressed with gzip-9 to embed them");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, checksum_batch, INT, ZMOD_RW,
+	"Checksum batched write zios together where the checksum allows");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, stage_histogram, INT, ZMOD_RW,
+	"Collect per-pool zio pipeline stage latency histograms");
+
 ZFS_MODULE_PARAM(zfs_zio, zio_, requeue_io_start_cut_in_line, INT, ZMOD_RW,
 	"Prioritize requeued I/O");
 
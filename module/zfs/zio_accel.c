@@ -0,0 +1,196 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or https://opensource.org/licenses/CDDL-1.0.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Registry of hardware offload providers. Callers try each registered
+ * provider in registration order and fall back to software if none of
+ * them handles the request. With no providers registered, every entry
+ * point returns after a single unlocked load.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/zio_accel.h>
+
+#define	ZIO_ACCEL_MAX_PROVIDERS	4
+
+static krwlock_t zio_accel_lock;
+static const zio_accel_ops_t *zio_accel_providers[ZIO_ACCEL_MAX_PROVIDERS];
+static uint32_t zio_accel_count;
+
+/*
+ * Disable all providers, falling back to the software implementations.
+ */
+static int zio_accel_disable = B_FALSE;
+
+void
+zio_accel_init(void)
+{
+	rw_init(&zio_accel_lock, NULL, RW_DEFAULT, NULL);
+}
+
+void
+zio_accel_fini(void)
+{
+	ASSERT0(zio_accel_count);
+	rw_destroy(&zio_accel_lock);
+}
+
+int
+zio_accel_register(const zio_accel_ops_t *ops)
+{
+	rw_enter(&zio_accel_lock, RW_WRITER);
+	for (uint_t i = 0; i < zio_accel_count; i++) {
+		if (zio_accel_providers[i] == ops) {
+			rw_exit(&zio_accel_lock);
+			return (SET_ERROR(EEXIST));
+		}
+	}
+	if (zio_accel_count == ZIO_ACCEL_MAX_PROVIDERS) {
+		rw_exit(&zio_accel_lock);
+		return (SET_ERROR(ENOSPC));
+	}
+	zio_accel_providers[zio_accel_count] = ops;
+	atomic_inc_32(&zio_accel_count);
+	rw_exit(&zio_accel_lock);
+
+	return (0);
+}
+
+void
+zio_accel_unregister(const zio_accel_ops_t *ops)
+{
+	rw_enter(&zio_accel_lock, RW_WRITER);
+	for (uint_t i = 0; i < zio_accel_count; i++) {
+		if (zio_accel_providers[i] != ops)
+			continue;
+		for (uint_t j = i + 1; j < zio_accel_count; j++)
+			zio_accel_providers[j - 1] = zio_accel_providers[j];
+		zio_accel_providers[zio_accel_count - 1] = NULL;
+		atomic_dec_32(&zio_accel_count);
+		break;
+	}
+	rw_exit(&zio_accel_lock);
+}
+
+/*
+ * Whether any provider may currently be handed work. Callers can use this
+ * to skip preparing the linear buffers the providers need.
+ */
+boolean_t
+zio_accel_enabled(void)
+{
+	return (!zio_accel_disable && atomic_load_32(&zio_accel_count) != 0);
+}
+
+static boolean_t
+zio_accel_enter(void)
+{
+	if (zio_accel_disable || atomic_load_32(&zio_accel_count) == 0)
+		return (B_FALSE);
+	rw_enter(&zio_accel_lock, RW_READER);
+	return (B_TRUE);
+}
+
+int
+zio_accel_compress(enum zio_compress c, int level, void *src, void *dst,
+    size_t s_len, size_t d_len, size_t *c_len)
+{
+	int err = ENOTSUP;
+
+	if (!zio_accel_enter())
+		return (err);
+	for (uint_t i = 0; i < zio_accel_count && err != 0; i++) {
+		const zio_accel_ops_t *ops = zio_accel_providers[i];
+		if (ops->za_compress != NULL) {
+			err = ops->za_compress(c, level, src, dst, s_len,
+			    d_len, c_len);
+		}
+	}
+	rw_exit(&zio_accel_lock);
+
+	return (err);
+}
+
+int
+zio_accel_decompress(enum zio_compress c, void *src, void *dst,
+    size_t s_len, size_t d_len, uint8_t *level)
+{
+	int err = ENOTSUP;
+
+	if (!zio_accel_enter())
+		return (err);
+	for (uint_t i = 0; i < zio_accel_count && err != 0; i++) {
+		const zio_accel_ops_t *ops = zio_accel_providers[i];
+		if (ops->za_decompress != NULL) {
+			err = ops->za_decompress(c, src, dst, s_len, d_len,
+			    level);
+		}
+	}
+	rw_exit(&zio_accel_lock);
+
+	return (err);
+}
+
+int
+zio_accel_checksum(enum zio_checksum c, abd_t *abd, uint64_t size,
+    zio_cksum_t *zcp)
+{
+	int err = ENOTSUP;
+
+	if (!zio_accel_enter())
+		return (err);
+	for (uint_t i = 0; i < zio_accel_count && err != 0; i++) {
+		const zio_accel_ops_t *ops = zio_accel_providers[i];
+		if (ops->za_checksum != NULL)
+			err = ops->za_checksum(c, abd, size, zcp);
+	}
+	rw_exit(&zio_accel_lock);
+
+	return (err);
+}
+
+int
+zio_accel_crypt(boolean_t encrypt, uint64_t crypt, uint8_t *src,
+    uint8_t *dst, uint8_t *iv, uint8_t *mac, crypto_key_t *key, uint32_t len)
+{
+	int err = ENOTSUP;
+
+	if (!zio_accel_enter())
+		return (err);
+	for (uint_t i = 0; i < zio_accel_count && err != 0; i++) {
+		const zio_accel_ops_t *ops = zio_accel_providers[i];
+		if (ops->za_crypt != NULL) {
+			err = ops->za_crypt(encrypt, crypt, src, dst, iv, mac,
+			    key, len);
+		}
+	}
+	rw_exit(&zio_accel_lock);
+
+	return (err);
+}
+
+#if defined(_KERNEL)
+EXPORT_SYMBOL(zio_accel_register);
+EXPORT_SYMBOL(zio_accel_unregister);
+#endif
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, accel_disable, INT, ZMOD_RW,
+	"Disable hardware offload providers");
@@ -29,6 +29,7 @@
 #include <sys/spa_impl.h>
 #include <sys/zio.h>
 #include <sys/zio_checksum.h>
+#include <sys/zio_accel.h>
 #include <sys/zil.h>
 #include <sys/abd.h>
 #include <zfs_fletcher.h>
@@ -161,42 +162,43 @@ abd_fletcher_4_byteswap(abd_t *abd, uint64_t size,
 }
 
 zio_checksum_info_t zio_checksum_table[ZIO_CHECKSUM_FUNCTIONS] = {
-	{{NULL, NULL}, NULL, NULL, 0, "inherit"},
-	{{NULL, NULL}, NULL, NULL, 0, "on"},
+	{{NULL, NULL}, NULL, NULL, NULL, 0, "inherit"},
+	{{NULL, NULL}, NULL, NULL, NULL, 0, "on"},
 	{{abd_checksum_off,		abd_checksum_off},
-	    NULL, NULL, 0, "off"},
+	    NULL, NULL, NULL, 0, "off"},
 	{{abd_checksum_sha256,		abd_checksum_sha256},
-	    NULL, NULL, ZCHECKSUM_FLAG_METADATA | ZCHECKSUM_FLAG_EMBEDDED,
+	    NULL, NULL, NULL, ZCHECKSUM_FLAG_METADATA | ZCHECKSUM_FLAG_EMBEDDED,
 	    "label"},
 	{{abd_checksum_sha256,		abd_checksum_sha256},
-	    NULL, NULL, ZCHECKSUM_FLAG_METADATA | ZCHECKSUM_FLAG_EMBEDDED,
+	    NULL, NULL, NULL, ZCHECKSUM_FLAG_METADATA | ZCHECKSUM_FLAG_EMBEDDED,
 	    "gang_header"},
 	{{abd_fletcher_2_native,	abd_fletcher_2_byteswap},
-	    NULL, NULL, ZCHECKSUM_FLAG_EMBEDDED, "zilog"},
+	    NULL, NULL, NULL, ZCHECKSUM_FLAG_EMBEDDED, "zilog"},
 	{{abd_fletcher_2_native,	abd_fletcher_2_byteswap},
-	    NULL, NULL, 0, "fletcher2"},
+	    NULL, NULL, NULL, 0, "fletcher2"},
 	{{abd_fletcher_4_native,	abd_fletcher_4_byteswap},
-	    NULL, NULL, ZCHECKSUM_FLAG_METADATA, "fletcher4"},
+	    NULL, NULL, NULL, ZCHECKSUM_FLAG_METADATA, "fletcher4"},
 	{{abd_checksum_sha256,		abd_checksum_sha256},
-	    NULL, NULL, ZCHECKSUM_FLAG_METADATA | ZCHECKSUM_FLAG_DEDUP |
+	    NULL, NULL, NULL, ZCHECKSUM_FLAG_METADATA | ZCHECKSUM_FLAG_DEDUP |
 	    ZCHECKSUM_FLAG_NOPWRITE, "sha256"},
 	{{abd_fletcher_4_native,	abd_fletcher_4_byteswap},
-	    NULL, NULL, ZCHECKSUM_FLAG_EMBEDDED, "zilog2"},
+	    NULL, NULL, NULL, ZCHECKSUM_FLAG_EMBEDDED, "zilog2"},
 	{{abd_checksum_off,		abd_checksum_off},
-	    NULL, NULL, 0, "noparity"},
+	    NULL, NULL, NULL, 0, "noparity"},
 	{{abd_checksum_sha512_native,	abd_checksum_sha512_byteswap},
-	    NULL, NULL, ZCHECKSUM_FLAG_METADATA | ZCHECKSUM_FLAG_DEDUP |
+	    NULL, NULL, NULL, ZCHECKSUM_FLAG_METADATA | ZCHECKSUM_FLAG_DEDUP |
 	    ZCHECKSUM_FLAG_NOPWRITE, "sha512"},
 	{{abd_checksum_skein_native,	abd_checksum_skein_byteswap},
-	    abd_checksum_skein_tmpl_init, abd_checksum_skein_tmpl_free,
+	    abd_checksum_skein_tmpl_init, abd_checksum_skein_tmpl_free, NULL,
 	    ZCHECKSUM_FLAG_METADATA | ZCHECKSUM_FLAG_DEDUP |
 	    ZCHECKSUM_FLAG_SALTED | ZCHECKSUM_FLAG_NOPWRITE, "skein"},
 	{{abd_checksum_edonr_native,	abd_checksum_edonr_byteswap},
-	    abd_checksum_edonr_tmpl_init, abd_checksum_edonr_tmpl_free,
+	    abd_checksum_edonr_tmpl_init, abd_checksum_edonr_tmpl_free, NULL,
 	    ZCHECKSUM_FLAG_METADATA | ZCHECKSUM_FLAG_SALTED |
 	    ZCHECKSUM_FLAG_NOPWRITE, "edonr"},
 	{{abd_checksum_blake3_native,	abd_checksum_blake3_byteswap},
 	    abd_checksum_blake3_tmpl_init, abd_checksum_blake3_tmpl_free,
+	    abd_checksum_blake3_many,
 	    ZCHECKSUM_FLAG_METADATA | ZCHECKSUM_FLAG_DEDUP |
 	    ZCHECKSUM_FLAG_SALTED | ZCHECKSUM_FLAG_NOPWRITE, "blake3"},
 };
@@ -333,6 +335,39 @@ zio_checksum_handle_crypt(zio_cksum_t *cksum, zio_cksum_t *saved, boolean_t xor)
 	cksum->zc_word[3] = saved->zc_word[3];
 }
 
+/*
+ * Calculate a checksum, in native or swapped byte order. Native checksums
+ * of unsalted types may be handed to a hardware offload provider.
+ */
+static void
+zio_checksum_calc(spa_t *spa, enum zio_checksum checksum, int byteswap,
+    abd_t *abd, uint64_t size, zio_cksum_t *zcp)
+{
+	zio_checksum_info_t *ci = &zio_checksum_table[checksum];
+
+	if (!byteswap && !(ci->ci_flags & ZCHECKSUM_FLAG_SALTED) &&
+	    zio_accel_checksum(checksum, abd, size, zcp) == 0)
+		return;
+
+	ci->ci_func[byteswap](abd, size, spa->spa_cksum_tmpls[checksum], zcp);
+}
+
+/*
+ * Store a freshly computed checksum in a non-embedded block pointer.
+ */
+static void
+zio_checksum_store(blkptr_t *bp, enum zio_checksum checksum,
+    zio_cksum_t *cksum)
+{
+	zio_checksum_info_t *ci = &zio_checksum_table[checksum];
+	boolean_t insecure = (ci->ci_flags & ZCHECKSUM_FLAG_DEDUP) == 0;
+	zio_cksum_t saved = bp->blk_cksum;
+
+	if (BP_USES_CRYPT(bp) && BP_GET_TYPE(bp) != DMU_OT_OBJSET)
+		zio_checksum_handle_crypt(cksum, &saved, insecure);
+	bp->blk_cksum = *cksum;
+}
+
 /*
  * Generate the checksum.
  */
@@ -392,8 +427,7 @@ zio_checksum_compute(zio_t *zio, enum zio_checksum checksum,
 		    eck_offset + offsetof(zio_eck_t, zec_cksum),
 		    sizeof (zio_cksum_t));
 
-		ci->ci_func[0](abd, size, spa->spa_cksum_tmpls[checksum],
-		    &cksum);
+		zio_checksum_calc(spa, checksum, 0, abd, size, &cksum);
 		if (bp != NULL && BP_USES_CRYPT(bp) &&
 		    BP_GET_TYPE(bp) != DMU_OT_OBJSET)
 			zio_checksum_handle_crypt(&cksum, &saved, insecure);
@@ -402,12 +436,68 @@ zio_checksum_compute(zio_t *zio, enum zio_checksum checksum,
 		    eck_offset + offsetof(zio_eck_t, zec_cksum),
 		    sizeof (zio_cksum_t));
 	} else {
-		saved = bp->blk_cksum;
-		ci->ci_func[0](abd, size, spa->spa_cksum_tmpls[checksum],
-		    &cksum);
-		if (BP_USES_CRYPT(bp) && BP_GET_TYPE(bp) != DMU_OT_OBJSET)
-			zio_checksum_handle_crypt(&cksum, &saved, insecure);
-		bp->blk_cksum = cksum;
+		zio_checksum_calc(spa, checksum, 0, abd, size, &cksum);
+		zio_checksum_store(bp, checksum, &cksum);
+	}
+}
+
+/*
+ * Generate the checksums of several zios at once. The zios must all be
+ * write zios with a block pointer and a non-embedded checksum. Those that
+ * share a checksum type and size are handed to the checksum's ci_many
+ * function together; anything left over is checksummed on its own.
+ */
+void
+zio_checksum_compute_many(zio_t **zios, uint_t n)
+{
+	uint_t group[ZIO_CHECKSUM_MANY_MAX];
+	abd_t *abds[ZIO_CHECKSUM_MANY_MAX];
+	zio_cksum_t cksums[ZIO_CHECKSUM_MANY_MAX];
+	boolean_t done[ZIO_CHECKSUM_MANY_MAX] = { 0 };
+
+	ASSERT3U(n, <=, ZIO_CHECKSUM_MANY_MAX);
+
+	for (uint_t i = 0; i < n; i++) {
+		zio_t *zio = zios[i];
+		enum zio_checksum checksum = BP_GET_CHECKSUM(zio->io_bp);
+		zio_checksum_info_t *ci = &zio_checksum_table[checksum];
+		spa_t *spa = zio->io_spa;
+		uint_t count = 0;
+
+		if (done[i])
+			continue;
+
+		ASSERT0(ci->ci_flags & ZCHECKSUM_FLAG_EMBEDDED);
+
+		if (ci->ci_many != NULL) {
+			for (uint_t j = i; j < n; j++) {
+				if (done[j] || zios[j]->io_spa != spa ||
+				    zios[j]->io_size != zio->io_size ||
+				    BP_GET_CHECKSUM(zios[j]->io_bp) != checksum)
+					continue;
+				group[count] = j;
+				abds[count] = zios[j]->io_abd;
+				count++;
+			}
+		}
+
+		if (count > 1) {
+			zio_checksum_template_init(checksum, spa);
+			if (ci->ci_many(abds, count, zio->io_size,
+			    spa->spa_cksum_tmpls[checksum], cksums) == 0) {
+				for (uint_t k = 0; k < count; k++) {
+					uint_t j = group[k];
+
+					zio_checksum_store(zios[j]->io_bp,
+					    checksum, &cksums[k]);
+					done[j] = B_TRUE;
+				}
+				continue;
+			}
+		}
+
+		zio_checksum_compute(zio, checksum, zio->io_abd, zio->io_size);
+		done[i] = B_TRUE;
 	}
 }
 
@@ -481,8 +571,8 @@ zio_checksum_error_impl(spa_t *spa, const blkptr_t *bp,
 		abd_copy_from_buf_off(abd, &verifier, eck_offset,
 		    sizeof (zio_cksum_t));
 
-		ci->ci_func[byteswap](abd, size,
-		    spa->spa_cksum_tmpls[checksum], &actual_cksum);
+		zio_checksum_calc(spa, checksum, byteswap, abd, size,
+		    &actual_cksum);
 
 		abd_copy_from_buf_off(abd, &expected_cksum, eck_offset,
 		    sizeof (zio_cksum_t));
@@ -494,8 +584,8 @@ zio_checksum_error_impl(spa_t *spa, const blkptr_t *bp,
 	} else {
 		byteswap = BP_SHOULD_BYTESWAP(bp);
 		expected_cksum = bp->blk_cksum;
-		ci->ci_func[byteswap](abd, size,
-		    spa->spa_cksum_tmpls[checksum], &actual_cksum);
+		zio_checksum_calc(spa, checksum, byteswap, abd, size,
+		    &actual_cksum);
 	}
 
 	/*
@@ -35,10 +35,14 @@
 
 #include <sys/zfs_context.h>
 #include <sys/spa.h>
+#include <sys/spa_impl.h>
 #include <sys/zfeature.h>
 #include <sys/zio.h>
 #include <sys/zio_compress.h>
+#include <sys/zio_accel.h>
 #include <sys/zstd/zstd.h>
+#include <cityhash.h>
+#include <zfs_fletcher.h>
 
 /*
  * If nonzero, every 1/X decompression attempts will fail, simulating
@@ -46,28 +50,47 @@
  */
 static unsigned long zio_decompress_fail_fraction = 0;
 
+/*
+ * Decompress scatter ABDs in place with algorithms that support it.
+ */
+static int zio_decompress_abd = B_TRUE;
+
+/*
+ * compression=auto: every this many blocks of an object, compress with
+ * every candidate to refresh the object's compression ratios.
+ */
+static uint_t zio_compress_auto_sample = 16;
+
+/*
+ * compression=auto: CPU time, in nanoseconds, worth spending to save one
+ * byte of storage.
+ */
+static uint_t zio_compress_auto_ns_per_byte = 50;
+
 /*
  * Compression vectors.
  */
 zio_compress_info_t zio_compress_table[ZIO_COMPRESS_FUNCTIONS] = {
-	{"inherit",	0,	NULL,		NULL, NULL},
-	{"on",		0,	NULL,		NULL, NULL},
-	{"uncompressed", 0,	NULL,		NULL, NULL},
-	{"lzjb",	0,	lzjb_compress,	lzjb_decompress, NULL},
-	{"empty",	0,	NULL,		NULL, NULL},
-	{"gzip-1",	1,	gzip_compress,	gzip_decompress, NULL},
-	{"gzip-2",	2,	gzip_compress,	gzip_decompress, NULL},
-	{"gzip-3",	3,	gzip_compress,	gzip_decompress, NULL},
-	{"gzip-4",	4,	gzip_compress,	gzip_decompress, NULL},
-	{"gzip-5",	5,	gzip_compress,	gzip_decompress, NULL},
-	{"gzip-6",	6,	gzip_compress,	gzip_decompress, NULL},
-	{"gzip-7",	7,	gzip_compress,	gzip_decompress, NULL},
-	{"gzip-8",	8,	gzip_compress,	gzip_decompress, NULL},
-	{"gzip-9",	9,	gzip_compress,	gzip_decompress, NULL},
-	{"zle",		64,	zle_compress,	zle_decompress, NULL},
-	{"lz4",		0,	lz4_compress_zfs, lz4_decompress_zfs, NULL},
+	{"inherit",	0,	NULL,		NULL, NULL, NULL},
+	{"on",		0,	NULL,		NULL, NULL, NULL},
+	{"uncompressed", 0,	NULL,		NULL, NULL, NULL},
+	{"lzjb",	0,	lzjb_compress,	lzjb_decompress, NULL, NULL},
+	{"empty",	0,	NULL,		NULL, NULL, NULL},
+	{"gzip-1",	1,	gzip_compress,	gzip_decompress, NULL, NULL},
+	{"gzip-2",	2,	gzip_compress,	gzip_decompress, NULL, NULL},
+	{"gzip-3",	3,	gzip_compress,	gzip_decompress, NULL, NULL},
+	{"gzip-4",	4,	gzip_compress,	gzip_decompress, NULL, NULL},
+	{"gzip-5",	5,	gzip_compress,	gzip_decompress, NULL, NULL},
+	{"gzip-6",	6,	gzip_compress,	gzip_decompress, NULL, NULL},
+	{"gzip-7",	7,	gzip_compress,	gzip_decompress, NULL, NULL},
+	{"gzip-8",	8,	gzip_compress,	gzip_decompress, NULL, NULL},
+	{"gzip-9",	9,	gzip_compress,	gzip_decompress, NULL, NULL},
+	{"zle",		64,	zle_compress,	zle_decompress, NULL, NULL},
+	{"lz4",		0,	lz4_compress_zfs, lz4_decompress_zfs, NULL,
+	    lz4_decompress_abd},
 	{"zstd",	ZIO_ZSTD_LEVEL_DEFAULT,	zfs_zstd_compress_wrap,
-	    zfs_zstd_decompress, zfs_zstd_decompress_level},
+	    zfs_zstd_decompress, zfs_zstd_decompress_level,
+	    zfs_zstd_decompress_abd},
 };
 
 uint8_t
@@ -124,9 +147,9 @@ zio_compress_zeroed_cb(void *data, size_t len, void *private)
 	return (0);
 }
 
-size_t
-zio_compress_data(enum zio_compress c, abd_t *src, void **dst, size_t s_len,
-    uint8_t level)
+static size_t
+zio_compress_data_impl(enum zio_compress c, abd_t *src, void **dst,
+    size_t s_len, uint8_t level, zio_compress_cksum_t *zcc)
 {
 	size_t c_len, d_len;
 	uint8_t complevel;
@@ -155,7 +178,8 @@ zio_compress_data(enum zio_compress c, abd_t *src, void **dst, size_t s_len,
 		if (level == ZIO_COMPLEVEL_INHERIT)
 			return (s_len);
 
-		if (level == ZIO_COMPLEVEL_DEFAULT)
+		if (level == ZIO_COMPLEVEL_DEFAULT ||
+		    level == ZIO_ZSTD_LEVEL_AUTO)
 			complevel = ZIO_ZSTD_LEVEL_DEFAULT;
 		else
 			complevel = level;
@@ -168,7 +192,15 @@ zio_compress_data(enum zio_compress c, abd_t *src, void **dst, size_t s_len,
 
 	/* No compression algorithms can read from ABDs directly */
 	void *tmp = abd_borrow_buf_copy(src, s_len);
-	c_len = ci->ci_compress(tmp, *dst, s_len, d_len, complevel);
+	if (zio_accel_compress(c, complevel, tmp, *dst, s_len, d_len,
+	    &c_len) != 0) {
+		if (zcc != NULL && c == ZIO_COMPRESS_LZ4)
+			c_len = lz4_compress_cksum(tmp, *dst, s_len, d_len,
+			    zcc);
+		else
+			c_len = ci->ci_compress(tmp, *dst, s_len, d_len,
+			    complevel);
+	}
 	abd_return_buf(src, tmp, s_len);
 
 	if (c_len > d_len)
@@ -178,6 +210,64 @@ zio_compress_data(enum zio_compress c, abd_t *src, void **dst, size_t s_len,
 	return (c_len);
 }
 
+size_t
+zio_compress_data(enum zio_compress c, abd_t *src, void **dst, size_t s_len,
+    uint8_t level)
+{
+	return (zio_compress_data_impl(c, src, dst, s_len, level, NULL));
+}
+
+/*
+ * As zio_compress_data(), but also start a fletcher4 checksum of the
+ * output in zcc, for zio_compress_cksum_finish() to complete once the
+ * output has been padded. lz4 checksums its output a piece at a time as it
+ * writes it, so it is read back from cache rather than memory. Other
+ * compressors leave it all to zio_compress_cksum_finish(). zcc is only
+ * meaningful if the data was compressed.
+ */
+size_t
+zio_compress_data_cksum(enum zio_compress c, abd_t *src, void **dst,
+    size_t s_len, uint8_t level, zio_compress_cksum_t *zcc)
+{
+	memset(zcc, 0, sizeof (*zcc));
+	return (zio_compress_data_impl(c, src, dst, s_len, level, zcc));
+}
+
+/*
+ * Complete the fletcher4 checksum started by zio_compress_data_cksum(),
+ * over the first size bytes of the compressed output in buf.
+ */
+void
+zio_compress_cksum_finish(const zio_compress_cksum_t *zcc, const void *buf,
+    size_t size, zio_cksum_t *zcp)
+{
+	ASSERT(IS_P2ALIGNED(size, sizeof (uint32_t)));
+	ASSERT3U(zcc->zcc_len, <=, size);
+
+	*zcp = zcc->zcc_cksum;
+	(void) fletcher_4_incremental_native((char *)buf + zcc->zcc_len,
+	    size - zcc->zcc_len, zcp);
+
+	/*
+	 * Add in the first word. In a checksum of n words, word 0 contributes
+	 * itself to a, n times itself to b, n(n+1)/2 times to c and
+	 * n(n+1)(n+2)/6 times to d. The last is computed by dividing the
+	 * factors exactly first, as the product overflows for large blocks.
+	 */
+	uint64_t w = zcc->zcc_head;
+	uint64_t n = size / sizeof (uint32_t);
+	uint64_t f[3] = { n, n + 1, n + 2 };
+
+	f[n % 2] /= 2;
+	f[(3 - n % 3) % 3] /= 3;
+
+	zcp->zc_word[0] += w;
+	zcp->zc_word[1] += n * w;
+	zcp->zc_word[2] += (n % 2 == 0 ? (n / 2) * (n + 1) :
+	    n * ((n + 1) / 2)) * w;
+	zcp->zc_word[3] += f[0] * f[1] * f[2] * w;
+}
+
 int
 zio_decompress_data_buf(enum zio_compress c, void *src, void *dst,
     size_t s_len, size_t d_len, uint8_t *level)
@@ -186,6 +276,9 @@ zio_decompress_data_buf(enum zio_compress c, void *src, void *dst,
 	if ((uint_t)c >= ZIO_COMPRESS_FUNCTIONS || ci->ci_decompress == NULL)
 		return (SET_ERROR(EINVAL));
 
+	if (zio_accel_decompress(c, src, dst, s_len, d_len, level) == 0)
+		return (0);
+
 	if (ci->ci_decompress_level != NULL && level != NULL)
 		return (ci->ci_decompress_level(src, dst, s_len, d_len, level));
 
@@ -196,9 +289,21 @@ int
 zio_decompress_data(enum zio_compress c, abd_t *src, void *dst,
     size_t s_len, size_t d_len, uint8_t *level)
 {
-	void *tmp = abd_borrow_buf_copy(src, s_len);
-	int ret = zio_decompress_data_buf(c, tmp, dst, s_len, d_len, level);
-	abd_return_buf(src, tmp, s_len);
+	zio_compress_info_t *ci = &zio_compress_table[c];
+	int ret;
+
+	/*
+	 * Decompress straight out of a scatter ABD if we can, rather than
+	 * copying the whole record into a linear buffer first.
+	 */
+	if ((uint_t)c < ZIO_COMPRESS_FUNCTIONS && !abd_is_linear(src) &&
+	    ci->ci_decompress_abd != NULL && zio_decompress_abd) {
+		ret = ci->ci_decompress_abd(src, dst, s_len, d_len, level);
+	} else {
+		void *tmp = abd_borrow_buf_copy(src, s_len);
+		ret = zio_decompress_data_buf(c, tmp, dst, s_len, d_len, level);
+		abd_return_buf(src, tmp, s_len);
+	}
 
 	/*
 	 * Decompression shouldn't fail, because we've already verified
@@ -212,6 +317,215 @@ zio_decompress_data(enum zio_compress c, abd_t *src, void *dst,
 	return (ret);
 }
 
+/*
+ * compression=auto
+ *
+ * The property is stored as zstd with the reserved ZIO_ZSTD_LEVEL_AUTO
+ * level, so it needs the zstd feature like any other zstd level. Each
+ * block is then compressed with one of the candidates below, and its
+ * block pointer and zstd header record what was actually used.
+ *
+ * The choice is made per object. A small direct-mapped table per pool
+ * remembers the compression ratio each candidate achieved on recent
+ * objects, and the pool keeps a running average of how long each
+ * candidate takes per KiB. The first block of an object, and every
+ * zio_compress_auto_sample blocks after that, is compressed with every
+ * candidate to refresh the ratios. Other blocks use the candidate that
+ * best trades CPU time against bytes saved, at an exchange rate of
+ * zio_compress_auto_ns_per_byte nanoseconds per byte saved.
+ */
+static const struct {
+	enum zio_compress	c;
+	uint8_t			level;
+} zio_compress_auto_cands[] = {
+	{ ZIO_COMPRESS_LZ4,	0 },
+	{ ZIO_COMPRESS_ZSTD,	ZIO_ZSTD_LEVEL_3 },
+	{ ZIO_COMPRESS_ZSTD,	ZIO_ZSTD_LEVEL_9 },
+};
+
+#define	ZIO_COMPRESS_AUTO_CANDS	ARRAY_SIZE(zio_compress_auto_cands)
+#define	ZIO_COMPRESS_AUTO_SLOTS		64
+
+typedef struct zio_compress_auto_slot {
+	uint64_t	zas_objset;
+	uint64_t	zas_object;
+	uint32_t	zas_writes;
+	/* psize per KiB of lsize; 0 if not yet measured */
+	uint16_t	zas_ratio[ZIO_COMPRESS_AUTO_CANDS];
+} zio_compress_auto_slot_t;
+
+struct zio_compress_auto {
+	kmutex_t	za_lock;
+	uint64_t	za_ns_per_kb[ZIO_COMPRESS_AUTO_CANDS];
+	zio_compress_auto_slot_t za_slots[ZIO_COMPRESS_AUTO_SLOTS];
+};
+
+zio_compress_auto_t *
+zio_compress_auto_create(void)
+{
+	zio_compress_auto_t *za = kmem_zalloc(sizeof (*za), KM_SLEEP);
+	mutex_init(&za->za_lock, NULL, MUTEX_DEFAULT, NULL);
+	return (za);
+}
+
+void
+zio_compress_auto_destroy(zio_compress_auto_t *za)
+{
+	mutex_destroy(&za->za_lock);
+	kmem_free(za, sizeof (*za));
+}
+
+static boolean_t
+zio_compress_auto_usable(spa_t *spa, uint_t i)
+{
+	return (zio_compress_auto_cands[i].c != ZIO_COMPRESS_LZ4 ||
+	    spa_feature_is_active(spa, SPA_FEATURE_LZ4_COMPRESS));
+}
+
+/*
+ * Value of a candidate per KiB compressed: the bytes it saves, converted
+ * to nanoseconds, less the nanoseconds it costs. Blocks that don't
+ * compress by at least 12.5% are stored uncompressed and save nothing.
+ */
+static int64_t
+zio_compress_auto_score(uint64_t ratio, uint64_t ns_per_kb)
+{
+	uint64_t saved = (ratio < 1024 - (1024 >> 3)) ? 1024 - ratio : 0;
+	return ((int64_t)(saved * zio_compress_auto_ns_per_byte) -
+	    (int64_t)ns_per_kb);
+}
+
+static void
+zio_compress_auto_update(zio_compress_auto_t *za,
+    zio_compress_auto_slot_t *zas, uint_t i, size_t psize, size_t lsize,
+    hrtime_t ns)
+{
+	uint64_t ratio = MAX(MIN(psize, lsize) * 1024 / lsize, 1);
+	uint64_t ns_per_kb = ns * 1024 / lsize;
+
+	ASSERT(MUTEX_HELD(&za->za_lock));
+
+	zas->zas_ratio[i] = (zas->zas_ratio[i] == 0) ? ratio :
+	    (zas->zas_ratio[i] * 3 + ratio) / 4;
+	za->za_ns_per_kb[i] = (za->za_ns_per_kb[i] == 0) ? ns_per_kb :
+	    (za->za_ns_per_kb[i] * 7 + ns_per_kb) / 8;
+}
+
+static zio_compress_auto_slot_t *
+zio_compress_auto_slot(zio_compress_auto_t *za, const zbookmark_phys_t *zb)
+{
+	uint64_t h = cityhash4(zb->zb_objset, zb->zb_object, 0, 0);
+	return (&za->za_slots[h % ZIO_COMPRESS_AUTO_SLOTS]);
+}
+
+/*
+ * Compress a block written with compression=auto. Returns the compressed
+ * size as zio_compress_data() does, and the algorithm and level used.
+ */
+size_t
+zio_compress_auto(spa_t *spa, const zbookmark_phys_t *zb, abd_t *src,
+    void **dst, size_t s_len, enum zio_compress *cp, uint8_t *levelp)
+{
+	zio_compress_auto_t *za = spa->spa_compress_auto;
+	zio_compress_auto_slot_t *zas;
+	void *bufs[ZIO_COMPRESS_AUTO_CANDS] = { NULL };
+	size_t psizes[ZIO_COMPRESS_AUTO_CANDS];
+	hrtime_t times[ZIO_COMPRESS_AUTO_CANDS];
+	boolean_t sample;
+	uint_t best = ZIO_COMPRESS_AUTO_CANDS;
+
+	ASSERT3P(*dst, ==, NULL);
+
+	mutex_enter(&za->za_lock);
+	zas = zio_compress_auto_slot(za, zb);
+	if (zas->zas_objset != zb->zb_objset ||
+	    zas->zas_object != zb->zb_object) {
+		memset(zas, 0, sizeof (*zas));
+		zas->zas_objset = zb->zb_objset;
+		zas->zas_object = zb->zb_object;
+	}
+	sample = (zas->zas_writes == 0);
+	zas->zas_writes = (zas->zas_writes + 1) %
+	    MAX(zio_compress_auto_sample, 1);
+	if (!sample) {
+		int64_t best_score = 0;
+		for (uint_t i = 0; i < ZIO_COMPRESS_AUTO_CANDS; i++) {
+			if (!zio_compress_auto_usable(spa, i) ||
+			    zas->zas_ratio[i] == 0)
+				continue;
+			int64_t score = zio_compress_auto_score(
+			    zas->zas_ratio[i], za->za_ns_per_kb[i]);
+			if (best == ZIO_COMPRESS_AUTO_CANDS ||
+			    score > best_score) {
+				best = i;
+				best_score = score;
+			}
+		}
+		sample = (best == ZIO_COMPRESS_AUTO_CANDS);
+	}
+	mutex_exit(&za->za_lock);
+
+	for (uint_t i = 0; i < ZIO_COMPRESS_AUTO_CANDS; i++) {
+		if (sample ? !zio_compress_auto_usable(spa, i) : i != best)
+			continue;
+
+		hrtime_t start = gethrtime();
+		psizes[i] = zio_compress_data(zio_compress_auto_cands[i].c,
+		    src, &bufs[i], s_len, zio_compress_auto_cands[i].level);
+		times[i] = gethrtime() - start;
+
+		/* All zeroes, which every candidate will agree on */
+		if (psizes[i] == 0) {
+			for (uint_t j = 0; j <= i; j++) {
+				if (bufs[j] != NULL)
+					zio_buf_free(bufs[j], s_len);
+			}
+			*cp = zio_compress_auto_cands[i].c;
+			*levelp = zio_compress_auto_cands[i].level;
+			return (0);
+		}
+	}
+
+	mutex_enter(&za->za_lock);
+	zas = zio_compress_auto_slot(za, zb);
+	boolean_t same = (zas->zas_objset == zb->zb_objset &&
+	    zas->zas_object == zb->zb_object);
+	if (sample) {
+		int64_t best_score = 0;
+		for (uint_t i = 0; i < ZIO_COMPRESS_AUTO_CANDS; i++) {
+			if (bufs[i] == NULL)
+				continue;
+			if (same) {
+				zio_compress_auto_update(za, zas, i, psizes[i],
+				    s_len, times[i]);
+			}
+			int64_t score = zio_compress_auto_score(
+			    MIN(psizes[i], s_len) * 1024 / s_len,
+			    za->za_ns_per_kb[i]);
+			if (best == ZIO_COMPRESS_AUTO_CANDS ||
+			    score > best_score) {
+				best = i;
+				best_score = score;
+			}
+		}
+	} else if (same) {
+		zio_compress_auto_update(za, zas, best, psizes[best], s_len,
+		    times[best]);
+	}
+	mutex_exit(&za->za_lock);
+
+	ASSERT3U(best, <, ZIO_COMPRESS_AUTO_CANDS);
+	for (uint_t i = 0; i < ZIO_COMPRESS_AUTO_CANDS; i++) {
+		if (i != best && bufs[i] != NULL)
+			zio_buf_free(bufs[i], s_len);
+	}
+
+	*dst = bufs[best];
+	*cp = zio_compress_auto_cands[best].c;
+	*levelp = zio_compress_auto_cands[best].level;
+	return (psizes[best]);
+}
+
 int
 zio_compress_to_feature(enum zio_compress comp)
 {
@@ -223,3 +537,12 @@ zio_compress_to_feature(enum zio_compress comp)
 	}
 	return (SPA_FEATURE_NONE);
 }
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, decompress_abd, INT, ZMOD_RW,
+	"Decompress lz4 and zstd directly from scatter ABDs");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, compress_auto_sample, UINT, ZMOD_RW,
+	"compression=auto: blocks per object between samples");
+
+ZFS_MODULE_PARAM(zfs_zio, zio_, compress_auto_ns_per_byte, UINT, ZMOD_RW,
+	"compression=auto: CPU nanoseconds worth spending per byte saved");
@@ -594,27 +594,25 @@ zfs_zstd_compress(void *s_start, void *d_start, size_t s_len, size_t d_len,
 	return (c_len + sizeof (*hdr));
 }
 
-/* Decompress block using zstd and return its stored level */
-int
-zfs_zstd_decompress_level(void *s_start, void *d_start, size_t s_len,
-    size_t d_len, uint8_t *level)
+/*
+ * Validate the header of a compressed block, returning the length of the
+ * zstd frame that follows it and the level it was compressed with.
+ */
+static int
+zfs_zstd_check_header(const zfs_zstdhdr_t *hdr, size_t s_len, size_t d_len,
+    uint32_t *c_len, uint8_t *curlevel)
 {
-	ZSTD_DCtx *dctx;
-	size_t result;
 	int16_t zstd_level;
-	uint32_t c_len;
-	const zfs_zstdhdr_t *hdr;
 	zfs_zstdhdr_t hdr_copy;
 
-	hdr = (const zfs_zstdhdr_t *)s_start;
-	c_len = BE_32(hdr->c_len);
+	*c_len = BE_32(hdr->c_len);
 
 	/*
 	 * Make a copy instead of directly converting the header, since we must
 	 * not modify the original data that may be used again later.
 	 */
 	hdr_copy.raw_version_level = BE_32(hdr->raw_version_level);
-	uint8_t curlevel = zfs_get_hdrlevel(&hdr_copy);
+	*curlevel = zfs_get_hdrlevel(&hdr_copy);
 
 	/*
 	 * NOTE: We ignore the ZSTD version for now. As soon as any
@@ -627,20 +625,38 @@ zfs_zstd_decompress_level(void *s_start, void *d_start, size_t s_len,
 	 * An invalid level is a strong indicator for data corruption! In such
 	 * case return an error so the upper layers can try to fix it.
 	 */
-	if (zstd_enum_to_level(curlevel, &zstd_level)) {
+	if (zstd_enum_to_level(*curlevel, &zstd_level)) {
 		ZSTDSTAT_BUMP(zstd_stat_dec_inval);
 		return (1);
 	}
 
 	ASSERT3U(d_len, >=, s_len);
-	ASSERT3U(curlevel, !=, ZIO_COMPLEVEL_INHERIT);
+	ASSERT3U(*curlevel, !=, ZIO_COMPLEVEL_INHERIT);
 
 	/* Invalid compressed buffer size encoded at start */
-	if (c_len + sizeof (*hdr) > s_len) {
+	if (*c_len + sizeof (*hdr) > s_len) {
 		ZSTDSTAT_BUMP(zstd_stat_dec_header_inval);
 		return (1);
 	}
 
+	return (0);
+}
+
+/* Decompress block using zstd and return its stored level */
+int
+zfs_zstd_decompress_level(void *s_start, void *d_start, size_t s_len,
+    size_t d_len, uint8_t *level)
+{
+	ZSTD_DCtx *dctx;
+	size_t result;
+	uint32_t c_len;
+	uint8_t curlevel;
+	const zfs_zstdhdr_t *hdr;
+
+	hdr = (const zfs_zstdhdr_t *)s_start;
+	if (zfs_zstd_check_header(hdr, s_len, d_len, &c_len, &curlevel) != 0)
+		return (1);
+
 	dctx = ZSTD_createDCtx_advanced(zstd_dctx_malloc);
 	if (!dctx) {
 		ZSTDSTAT_BUMP(zstd_stat_dec_alloc_fail);
@@ -670,6 +686,86 @@ zfs_zstd_decompress_level(void *s_start, void *d_start, size_t s_len,
 	return (0);
 }
 
+typedef struct zfs_zstd_stream {
+	ZSTD_DCtx	*zs_dctx;
+	ZSTD_outBuffer	zs_out;
+	size_t		zs_result;
+} zfs_zstd_stream_t;
+
+static int
+zfs_zstd_decompress_abd_cb(void *buf, size_t size, void *private)
+{
+	zfs_zstd_stream_t *zs = private;
+	ZSTD_inBuffer in = { .src = buf, .size = size, .pos = 0 };
+
+	while (in.pos < in.size && zs->zs_result != 0) {
+		size_t in_pos = in.pos, out_pos = zs->zs_out.pos;
+
+		zs->zs_result = ZSTD_decompressStream(zs->zs_dctx, &zs->zs_out,
+		    &in);
+		if (ZSTD_isError(zs->zs_result))
+			return (1);
+
+		/* The output buffer is full but the frame is not done */
+		if (in.pos == in_pos && zs->zs_out.pos == out_pos)
+			return (1);
+	}
+
+	return (0);
+}
+
+/*
+ * Decompress a block from an ABD. The zstd frame is streamed in one ABD
+ * chunk at a time, so a scatter ABD is never copied into a linear buffer.
+ * The output buffer is stable, so the decompression context does not need
+ * a window buffer of its own.
+ */
+int
+zfs_zstd_decompress_abd(abd_t *src, void *d_start, size_t s_len,
+    size_t d_len, uint8_t *level)
+{
+	uint32_t c_len;
+	uint8_t curlevel;
+	zfs_zstdhdr_t hdr;
+	zfs_zstd_stream_t zs = {
+		.zs_out = { .dst = d_start, .size = d_len, .pos = 0 },
+		.zs_result = 1,
+	};
+
+	if (s_len < sizeof (hdr))
+		return (1);
+	abd_copy_to_buf(&hdr, src, sizeof (hdr));
+	if (zfs_zstd_check_header(&hdr, s_len, d_len, &c_len, &curlevel) != 0)
+		return (1);
+
+	zs.zs_dctx = ZSTD_createDCtx_advanced(zstd_dctx_malloc);
+	if (!zs.zs_dctx) {
+		ZSTDSTAT_BUMP(zstd_stat_dec_alloc_fail);
+		return (1);
+	}
+
+	/* Set header type to "magicless" */
+	ZSTD_DCtx_setParameter(zs.zs_dctx, ZSTD_d_format,
+	    ZSTD_f_zstd1_magicless);
+	ZSTD_DCtx_setParameter(zs.zs_dctx, ZSTD_d_stableOutBuffer, 1);
+
+	int err = abd_iterate_func(src, sizeof (hdr), c_len,
+	    zfs_zstd_decompress_abd_cb, &zs);
+	ZSTD_freeDCtx(zs.zs_dctx);
+
+	/* The frame must have been fully decoded and flushed */
+	if (err != 0 || zs.zs_result != 0) {
+		ZSTDSTAT_BUMP(zstd_stat_dec_fail);
+		return (1);
+	}
+
+	if (level) {
+		*level = curlevel;
+	}
+
+	return (0);
+}
+
 /* Decompress datablock using zstd */
 int
 zfs_zstd_decompress(void *s_start, void *d_start, size_t s_len, size_t d_len,
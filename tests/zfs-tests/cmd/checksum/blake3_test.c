@@ -541,6 +541,40 @@ main(int argc, char *argv[])
 		}
 	}
 
+	(void) printf("Running multi-message tests:\n");
+	for (id = 0; id < blake3->getcnt(); id++) {
+		blake3->setid(id);
+		const char *name = blake3->getname();
+		for (size_t len = 2048; len <= 65536; len *= 2) {
+			const uint8_t *inputs[17];
+			uint8_t digests[17 * BLAKE3_OUT_LEN];
+			uint8_t *cvs = malloc(17 * len / 32);
+			BLAKE3_CTX ctx;
+			uint8_t digest[BLAKE3_OUT_LEN];
+
+			for (i = 0; i < 17; i++)
+				inputs[i] = buffer +
+				    (i * 1031) % (sizeof (buffer) - len);
+
+			Blake3_InitKeyed(&ctx, (const uint8_t *)salt);
+			if (!Blake3_HashMany(&ctx, inputs, 17, len, cvs,
+			    digests))
+				failed = B_TRUE;
+			for (i = 0; i < 17; i++) {
+				Blake3_InitKeyed(&ctx, (const uint8_t *)salt);
+				Blake3_Update(&ctx, inputs[i], len);
+				Blake3_Final(&ctx, digest);
+				if (memcmp(digest, &digests[i * BLAKE3_OUT_LEN],
+				    BLAKE3_OUT_LEN) != 0)
+					failed = B_TRUE;
+			}
+			free(cvs);
+
+			printf("BLAKE3-%s Messages (17 x inlen=%zu)\t"
+			    "Result: %s\n", name, len, failed?"FAILED!":"OK");
+		}
+	}
+
 	if (failed)
 		return (1);
 
@@ -518,6 +518,75 @@ test_send_new(const char *snapshot, int fd)
 	nvlist_free(required);
 }
 
+static void
+test_changed_blocks(const char *from, const char *snapshot, int fd)
+{
+	nvlist_t *required = fnvlist_alloc();
+	nvlist_t *optional = fnvlist_alloc();
+
+	fnvlist_add_int32(required, CHANGED_BLOCKS_FD, fd);
+	fnvlist_add_uint64(required, CHANGED_BLOCKS_OBJECT, 1);
+
+	fnvlist_add_string(optional, CHANGED_BLOCKS_FROMSNAP, from);
+
+	IOC_INPUT_TEST(ZFS_IOC_CHANGED_BLOCKS, snapshot, required, optional,
+	    0);
+
+	nvlist_free(optional);
+	nvlist_free(required);
+}
+
+static void
+test_mount_prefetch(const char *dataset)
+{
+	IOC_INPUT_TEST(ZFS_IOC_MOUNT_PREFETCH, dataset, NULL, NULL, 0);
+}
+
+static void
+test_dataset_list_batch(const char *dataset)
+{
+	nvlist_t *optional = fnvlist_alloc();
+	nvlist_t *props = fnvlist_alloc();
+
+	fnvlist_add_boolean(props, "used");
+	fnvlist_add_uint64(optional, DATASET_LIST_CURSOR, 0);
+	fnvlist_add_uint64(optional, DATASET_LIST_COUNT, 16);
+	fnvlist_add_boolean(optional, DATASET_LIST_SNAPSHOTS);
+	fnvlist_add_nvlist(optional, DATASET_LIST_PROPS, props);
+	fnvlist_add_uint64(optional, SNAP_ITER_MIN_TXG, 1);
+	fnvlist_add_uint64(optional, SNAP_ITER_MAX_TXG, UINT64_MAX);
+
+	IOC_INPUT_TEST(ZFS_IOC_DATASET_LIST_BATCH, dataset, NULL, optional,
+	    0);
+
+	nvlist_free(props);
+	nvlist_free(optional);
+}
+
+static void
+test_dedup_sample(const char *pool)
+{
+	nvlist_t *optional = fnvlist_alloc();
+
+	fnvlist_add_uint64(optional, DEDUP_SAMPLE_COUNT, 100);
+
+	IOC_INPUT_TEST(ZFS_IOC_DEDUP_SAMPLE, pool, NULL, optional, 0);
+
+	nvlist_free(optional);
+}
+
+static void
+test_kstats(void)
+{
+	nvlist_t *optional = fnvlist_alloc();
+
+	fnvlist_add_string(optional, KSTATS_CLASS, "misc");
+
+	IOC_INPUT_TEST(ZFS_IOC_KSTATS, "zfs", NULL, optional, 0);
+
+	nvlist_free(optional);
+}
+
 static void
 test_recv_new(const char *dataset, int fd)
 {
@@ -702,6 +771,15 @@ test_scrub(const char *pool)
 	nvlist_free(required);
 }
 
+static void
+test_ddt_prune(const char *pool)
+{
+	nvlist_t *required = fnvlist_alloc();
+	fnvlist_add_uint64(required, DDT_PRUNE_DAYS, 36500);
+	IOC_INPUT_TEST(ZFS_IOC_DDT_PRUNE, pool, required, NULL, 0);
+	nvlist_free(required);
+}
+
 static int
 zfs_destroy(const char *dataset)
 {
@@ -846,6 +924,9 @@ zfs_ioc_input_tests(const char *pool)
 	test_send_space(snapbase, snapshot);
 	test_send_new(snapshot, tmpfd);
 	test_recv_new(backup, tmpfd);
+	test_changed_blocks(snapbase, snapshot, tmpfd);
+	test_mount_prefetch(dataset);
+	test_dataset_list_batch(dataset);
 
 	test_bookmark(pool, snapshot, bookmark);
 	test_get_bookmarks(dataset);
@@ -884,6 +965,12 @@ zfs_ioc_input_tests(const char *pool)
 
 	test_scrub(pool);
 
+	test_ddt_prune(pool);
+
+	test_dedup_sample(pool);
+
+	test_kstats();
+
 	/*
 	 * cleanup
 	 */
@@ -1039,6 +1126,12 @@ validate_ioc_values(void)
 	CHECK(ZFS_IOC_BASE + 83 == ZFS_IOC_WAIT);
 	CHECK(ZFS_IOC_BASE + 84 == ZFS_IOC_WAIT_FS);
 	CHECK(ZFS_IOC_BASE + 87 == ZFS_IOC_POOL_SCRUB);
+	CHECK(ZFS_IOC_BASE + 88 == ZFS_IOC_DDT_PRUNE);
+	CHECK(ZFS_IOC_BASE + 89 == ZFS_IOC_CHANGED_BLOCKS);
+	CHECK(ZFS_IOC_BASE + 90 == ZFS_IOC_MOUNT_PREFETCH);
+	CHECK(ZFS_IOC_BASE + 91 == ZFS_IOC_DATASET_LIST_BATCH);
+	CHECK(ZFS_IOC_BASE + 92 == ZFS_IOC_DEDUP_SAMPLE);
+	CHECK(ZFS_IOC_BASE + 93 == ZFS_IOC_KSTATS);
 	CHECK(ZFS_IOC_PLATFORM_BASE + 1 == ZFS_IOC_EVENTS_NEXT);
 	CHECK(ZFS_IOC_PLATFORM_BASE + 2 == ZFS_IOC_EVENTS_CLEAR);
 	CHECK(ZFS_IOC_PLATFORM_BASE + 3 == ZFS_IOC_EVENTS_SEEK);